@@ -33,6 +33,8 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include <sys/file.h>
+#include <sys/uio.h>
+#include <pthread.h>
 #include <time.h>
 #include "base.h"
 #include "config_file_names.h"
@@ -71,6 +73,42 @@ static int s_logOnlyErrors = 0;
 static int s_logAddTime = 1;
 static char s_szAdditionalLogFile[128];
 
+// Async log: log calls format the line into a bounded lock-free ring (multiple producers),
+// a writer thread drains it and appends to the log files with batched writev.
+// When the ring is full, lines are dropped and counted, callers never block on file I/O.
+#define LOG_ASYNC_SLOTS 512
+#define LOG_ASYNC_MAX_ENTRY_LENGTH 256
+// Longer lines use several entries
+#define LOG_ASYNC_MAX_LINE_LENGTH (LOG_ASYNC_MAX_ENTRY_LENGTH*32)
+#define LOG_ASYNC_BATCH 64
+#define LOG_ASYNC_WRITER_PERIOD_MS 10
+
+#define LOG_ASYNC_TARGET_SYSTEM 0x01
+#define LOG_ASYNC_TARGET_ERRORS 0x02
+#define LOG_ASYNC_TARGET_ERRORS_SOFT 0x04
+#define LOG_ASYNC_TARGET_WATCHDOG 0x08
+#define LOG_ASYNC_TARGET_COMMANDS 0x10
+#define LOG_ASYNC_TARGET_ADDITIONAL 0x20
+#define LOG_ASYNC_TARGET_STDOUT 0x40
+
+typedef struct
+{
+   volatile u32 uSeq;
+   u16 uTargets;
+   u16 uLength;
+   char szText[LOG_ASYNC_MAX_ENTRY_LENGTH];
+} type_log_async_entry;
+
+static type_log_async_entry* s_pLogAsyncEntries = NULL;
+static volatile u32 s_uLogAsyncWritePos = 0;
+static u32 s_uLogAsyncReadPos = 0;
+static volatile u32 s_uLogAsyncDroppedCount = 0;
+static u32 s_uLogAsyncDroppedReported = 0;
+static volatile int s_iLogAsyncEnabled = 0;
+static volatile int s_iLogAsyncRunning = 0;
+static int s_iLogAsyncAtExitRegistered = 0;
+static pthread_t s_pThreadLogAsyncWriter;
+
 const u32 crc32_table[] = {
 	0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
 	0xe963a535, 0x9e6495a3,	0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
@@ -161,17 +199,239 @@ void reset_counters(type_u32_couters* pCounters)
    pCounters->uValueNow = 0;
 }
 
-u32 base_compute_crc32(u8 *buf, int length)
+// CRC32 (IEEE, reflected 0xEDB88320), same results for all implementations:
+// byte table, slicing-by-8, ARMv8 CRC32 instructions, x86 PCLMUL folding.
+// The best one available is selected on first use.
+
+static u32 s_uCRC32Slices[8][256];
+static u32 (*s_pCRC32Update)(u32 uCRC, const u8* pData, int iLength) = NULL;
+static const char* s_szCRC32ImplName = "table";
+
+static u32 _crc32_update_table(u32 uCRC, const u8* pData, int iLength)
+{
+   while ( iLength-- > 0 )
+      uCRC = crc32_table[(uCRC ^ *pData++) & 0xFF] ^ (uCRC >> 8);
+   return uCRC;
+}
+
+static u32 _crc32_update_slice8(u32 uCRC, const u8* pData, int iLength)
+{
+   #if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+   while ( iLength >= 8 )
+   {
+      u32 uLow, uHigh;
+      memcpy(&uLow, pData, sizeof(u32));
+      memcpy(&uHigh, pData+4, sizeof(u32));
+      uLow ^= uCRC;
+      uCRC = s_uCRC32Slices[7][uLow & 0xFF] ^ s_uCRC32Slices[6][(uLow >> 8) & 0xFF] ^
+             s_uCRC32Slices[5][(uLow >> 16) & 0xFF] ^ s_uCRC32Slices[4][uLow >> 24] ^
+             s_uCRC32Slices[3][uHigh & 0xFF] ^ s_uCRC32Slices[2][(uHigh >> 8) & 0xFF] ^
+             s_uCRC32Slices[1][(uHigh >> 16) & 0xFF] ^ s_uCRC32Slices[0][uHigh >> 24];
+      pData += 8;
+      iLength -= 8;
+   }
+   #endif
+   return _crc32_update_table(uCRC, pData, iLength);
+}
+
+#if defined(__aarch64__) || (defined(__arm__) && defined(__ARM_FEATURE_CRC32))
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#define BASE_HAS_CRC32_ARMV8 1
+
+#if defined(__aarch64__)
+__attribute__((target("+crc")))
+#endif
+static u32 _crc32_update_armv8(u32 uCRC, const u8* pData, int iLength)
+{
+   while ( (iLength > 0) && (((uintptr_t)pData) & 3) )
+   {
+      uCRC = __crc32b(uCRC, *pData++);
+      iLength--;
+   }
+   while ( iLength >= 8 )
+   {
+      u32 uLow, uHigh;
+      memcpy(&uLow, pData, sizeof(u32));
+      memcpy(&uHigh, pData+4, sizeof(u32));
+      uCRC = __crc32w(__crc32w(uCRC, uLow), uHigh);
+      pData += 8;
+      iLength -= 8;
+   }
+   while ( iLength-- > 0 )
+      uCRC = __crc32b(uCRC, *pData++);
+   return uCRC;
+}
+
+static int _crc32_has_armv8()
+{
+   #if defined(__aarch64__)
+   return (getauxval(AT_HWCAP) & (1<<7)) ? 1 : 0; // HWCAP_CRC32
+   #else
+   return (getauxval(AT_HWCAP2) & (1<<4)) ? 1 : 0; // HWCAP2_CRC32
+   #endif
+}
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BASE_HAS_CRC32_PCLMUL 1
+
+// Folds 64 bytes at a time with carry-less multiplies, then Barrett reduction to 32 bits.
+// Needs at least 64 bytes, a multiple of 16 bytes. Constants are for the reflected IEEE polynomial.
+__attribute__((target("pclmul,sse4.1")))
+static u32 _crc32_fold_pclmul(u32 uCRC, const u8* pData, int iLength)
+{
+   static const uint64_t __attribute__((aligned(16))) k1k2[] = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+   static const uint64_t __attribute__((aligned(16))) k3k4[] = { 0x01751997d0ULL, 0x00ccaa009eULL };
+   static const uint64_t __attribute__((aligned(16))) k5k0[] = { 0x0163cd6124ULL, 0x0000000000ULL };
+   static const uint64_t __attribute__((aligned(16))) poly[] = { 0x01db710641ULL, 0x01f7011641ULL };
+   __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+   x1 = _mm_loadu_si128((const __m128i*)(pData + 0x00));
+   x2 = _mm_loadu_si128((const __m128i*)(pData + 0x10));
+   x3 = _mm_loadu_si128((const __m128i*)(pData + 0x20));
+   x4 = _mm_loadu_si128((const __m128i*)(pData + 0x30));
+   x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)uCRC));
+   x0 = _mm_load_si128((const __m128i*)k1k2);
+   pData += 64;
+   iLength -= 64;
+
+   while ( iLength >= 64 )
+   {
+      x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+      x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+      x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+      x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+      x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+      x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+      x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(pData + 0x00)));
+      x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(pData + 0x10)));
+      x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(pData + 0x20)));
+      x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(pData + 0x30)));
+      pData += 64;
+      iLength -= 64;
+   }
+
+   // Fold the 4 lanes into one
+   x0 = _mm_load_si128((const __m128i*)k3k4);
+   x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+   x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+   x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+   while ( iLength >= 16 )
+   {
+      x2 = _mm_loadu_si128((const __m128i*)pData);
+      x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+      pData += 16;
+      iLength -= 16;
+   }
+
+   // 128 bits to 64 bits
+   x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+   x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+   x1 = _mm_srli_si128(x1, 8);
+   x1 = _mm_xor_si128(x1, x2);
+   x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+   x2 = _mm_srli_si128(x1, 4);
+   x1 = _mm_and_si128(x1, x3);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_xor_si128(x1, x2);
+
+   // Barrett reduction to 32 bits
+   x0 = _mm_load_si128((const __m128i*)poly);
+   x2 = _mm_and_si128(x1, x3);
+   x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+   x2 = _mm_and_si128(x2, x3);
+   x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+   x1 = _mm_xor_si128(x1, x2);
+   return (u32)_mm_extract_epi32(x1, 1);
+}
+
+static u32 _crc32_update_pclmul(u32 uCRC, const u8* pData, int iLength)
+{
+   if ( iLength >= 64 )
+   {
+      int iChunk = iLength & ~15;
+      uCRC = _crc32_fold_pclmul(uCRC, pData, iChunk);
+      pData += iChunk;
+      iLength -= iChunk;
+   }
+   return _crc32_update_slice8(uCRC, pData, iLength);
+}
+#endif
+
+static void _crc32_init_slices()
+{
+   for( int i=0; i<256; i++ )
+      s_uCRC32Slices[0][i] = crc32_table[i];
+   for( int k=1; k<8; k++ )
+   for( int i=0; i<256; i++ )
+      s_uCRC32Slices[k][i] = (s_uCRC32Slices[k-1][i] >> 8) ^ crc32_table[s_uCRC32Slices[k-1][i] & 0xFF];
+}
+
+int base_crc32_set_implementation(int iImplementation)
+{
+   _crc32_init_slices();
+
+   u32 (*pUpdate)(u32, const u8*, int) = _crc32_update_table;
+   const char* szName = "table";
+   int iRequested = iImplementation;
+   iImplementation = CRC32_IMPLEMENTATION_TABLE;
+   if ( iRequested >= CRC32_IMPLEMENTATION_SLICE8 )
+   {
+      pUpdate = _crc32_update_slice8;
+      szName = "slice8";
+      iImplementation = CRC32_IMPLEMENTATION_SLICE8;
+   }
+   if ( iRequested >= CRC32_IMPLEMENTATION_HW )
+   {
+   #if defined(BASE_HAS_CRC32_ARMV8)
+   if ( _crc32_has_armv8() )
+   {
+      pUpdate = _crc32_update_armv8;
+      szName = "armv8";
+      iImplementation = CRC32_IMPLEMENTATION_HW;
+   }
+   #elif defined(BASE_HAS_CRC32_PCLMUL)
+   __builtin_cpu_init();
+   if ( __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1") )
+   {
+      pUpdate = _crc32_update_pclmul;
+      szName = "pclmul";
+      iImplementation = CRC32_IMPLEMENTATION_HW;
+   }
+   #endif
+   }
+   s_szCRC32ImplName = szName;
+   __atomic_store_n(&s_pCRC32Update, pUpdate, __ATOMIC_RELEASE);
+   return iImplementation;
+}
+
+const char* base_crc32_get_implementation_name()
 {
-   u8* p = buf;
-   u32 crc;
-   crc = ~0U;
+   return s_szCRC32ImplName;
+}
 
-   while (length--)
+u32 base_compute_crc32(u8 *buf, int length)
+{
+   u32 (*pUpdate)(u32, const u8*, int) = __atomic_load_n(&s_pCRC32Update, __ATOMIC_ACQUIRE);
+   if ( NULL == pUpdate )
    {
-      crc = crc32_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+      base_crc32_set_implementation(CRC32_IMPLEMENTATION_HW);
+      pUpdate = s_pCRC32Update;
    }
-   return crc ^ ~0U;
+   return pUpdate(~0U, buf, length) ^ ~0U;
 } 
 
 u8 base_compute_crc8(u8* pBuffer, int iLength)
@@ -522,6 +782,297 @@ int _log_service_entry_softerror(char* szTime, char* szBuff)
    return 1;
 }
 
+void _log_format_time_mstens(char* szOutTime);
+
+// Lines longer than an entry are split across consecutive entries (reserved together),
+// only the last one ends with a new line, so the writer outputs the full line.
+static int _log_async_push(u32 uTargets, const char* szTime, const char* szPrefix, const char* format, va_list args)
+{
+   if ( ! s_iLogAsyncEnabled )
+      return 0;
+   if ( 0 != s_szAdditionalLogFile[0] )
+      uTargets |= LOG_ASYNC_TARGET_ADDITIONAL;
+   if ( ! s_logDisabledStdout )
+      uTargets |= LOG_ASYNC_TARGET_STDOUT;
+
+   char szLine[LOG_ASYNC_MAX_ENTRY_LENGTH*4];
+   char* pLine = szLine;
+   int iLen = snprintf(szLine, sizeof(szLine), "%s %s: %s", szTime, sszComponentName, szPrefix);
+   if ( (iLen < 0) || (iLen >= (int)sizeof(szLine)) )
+      iLen = sizeof(szLine)-1;
+
+   va_list argsCopy;
+   va_copy(argsCopy, args);
+   int iLenMsg = vsnprintf(szLine + iLen, sizeof(szLine) - iLen, format, args);
+   if ( iLenMsg >= (int)sizeof(szLine) - iLen )
+   {
+      int iTotal = iLen + iLenMsg;
+      if ( iTotal > LOG_ASYNC_MAX_LINE_LENGTH )
+         iTotal = LOG_ASYNC_MAX_LINE_LENGTH;
+      pLine = (char*) malloc(iTotal+1);
+      if ( NULL != pLine )
+      {
+         memcpy(pLine, szLine, iLen);
+         vsnprintf(pLine + iLen, iTotal + 1 - iLen, format, argsCopy);
+         iLenMsg = iTotal - iLen;
+      }
+      else
+      {
+         pLine = szLine;
+         iLenMsg = sizeof(szLine) - 1 - iLen;
+      }
+   }
+   va_end(argsCopy);
+   if ( iLenMsg > 0 )
+      iLen += iLenMsg;
+
+   const int iChunkSize = LOG_ASYNC_MAX_ENTRY_LENGTH-2;
+   int iCountEntries = (iLen + iChunkSize - 1) / iChunkSize;
+   if ( iCountEntries < 1 )
+      iCountEntries = 1;
+
+   // Reserves iCountEntries consecutive entries: the last one being free means all the ones before it are free too,
+   // as the writer releases them in order
+   u32 uPos = __atomic_load_n(&s_uLogAsyncWritePos, __ATOMIC_RELAXED);
+   while ( 1 )
+   {
+      u32 uLastPos = uPos + (u32)iCountEntries - 1;
+      type_log_async_entry* pLast = &s_pLogAsyncEntries[uLastPos % LOG_ASYNC_SLOTS];
+      int iDiff = (int)(__atomic_load_n(&pLast->uSeq, __ATOMIC_ACQUIRE) - uLastPos);
+      if ( 0 == iDiff )
+      {
+         if ( __atomic_compare_exchange_n(&s_uLogAsyncWritePos, &uPos, uPos+(u32)iCountEntries, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+            break;
+      }
+      else if ( iDiff < 0 )
+      {
+         __atomic_add_fetch(&s_uLogAsyncDroppedCount, 1, __ATOMIC_RELAXED);
+         if ( pLine != szLine )
+            free(pLine);
+         return 1;
+      }
+      else
+         uPos = __atomic_load_n(&s_uLogAsyncWritePos, __ATOMIC_RELAXED);
+   }
+
+   int iOffset = 0;
+   for( int k=0; k<iCountEntries; k++ )
+   {
+      type_log_async_entry* pEntry = &s_pLogAsyncEntries[(uPos + (u32)k) % LOG_ASYNC_SLOTS];
+      int iChunk = iLen - iOffset;
+      if ( iChunk > iChunkSize )
+         iChunk = iChunkSize;
+      if ( iChunk < 0 )
+         iChunk = 0;
+      memcpy(pEntry->szText, pLine + iOffset, iChunk);
+      iOffset += iChunk;
+      if ( k == iCountEntries-1 )
+         pEntry->szText[iChunk++] = '\n';
+      pEntry->szText[iChunk] = 0;
+      pEntry->uLength = (u16)iChunk;
+      pEntry->uTargets = (u16)uTargets;
+      __atomic_store_n(&pEntry->uSeq, uPos + (u32)k + 1, __ATOMIC_RELEASE);
+   }
+   if ( pLine != szLine )
+      free(pLine);
+   return 1;
+}
+
+static int _log_async_pushf(u32 uTargets, const char* szTime, const char* szPrefix, const char* format, ...)
+{
+   va_list args;
+   va_start(args, format);
+   int iRes = _log_async_push(uTargets, szTime, szPrefix, format, args);
+   va_end(args);
+   return iRes;
+}
+
+static void _log_async_write(int iFd, struct iovec* pIOV, int iCount)
+{
+   int iStart = 0;
+   while ( iStart < iCount )
+   {
+      ssize_t iRes = writev(iFd, pIOV + iStart, iCount - iStart);
+      if ( iRes <= 0 )
+         return;
+      // Skip the fully written entries; partial writes on regular files are not expected, just drop the rest of that entry
+      while ( (iStart < iCount) && (iRes >= (ssize_t)pIOV[iStart].iov_len) )
+      {
+         iRes -= pIOV[iStart].iov_len;
+         iStart++;
+      }
+      if ( (iStart < iCount) && (iRes > 0) )
+         iStart++;
+   }
+}
+
+static void _log_async_write_target(u32 uTarget, type_log_async_entry** pEntries, int iCount, char* szDroppedInfo)
+{
+   struct iovec iov[LOG_ASYNC_BATCH+1];
+   int iCountIOV = 0;
+   if ( (NULL != szDroppedInfo) && (uTarget & (LOG_ASYNC_TARGET_SYSTEM | LOG_ASYNC_TARGET_STDOUT)) )
+   {
+      iov[iCountIOV].iov_base = szDroppedInfo;
+      iov[iCountIOV].iov_len = strlen(szDroppedInfo);
+      iCountIOV++;
+   }
+   for( int i=0; i<iCount; i++ )
+   {
+      if ( ! (pEntries[i]->uTargets & uTarget) )
+         continue;
+      iov[iCountIOV].iov_base = pEntries[i]->szText;
+      iov[iCountIOV].iov_len = pEntries[i]->uLength;
+      iCountIOV++;
+   }
+   if ( 0 == iCountIOV )
+      return;
+
+   if ( uTarget == LOG_ASYNC_TARGET_STDOUT )
+   {
+      _log_async_write(STDOUT_FILENO, iov, iCountIOV);
+      return;
+   }
+
+   char szFile[MAX_FILE_PATH_SIZE];
+   if ( uTarget == LOG_ASYNC_TARGET_ADDITIONAL )
+   {
+      if ( 0 == s_szAdditionalLogFile[0] )
+         return;
+      strcpy(szFile, s_szAdditionalLogFile);
+   }
+   else
+   {
+      strcpy(szFile, FOLDER_LOGS);
+      if ( uTarget == LOG_ASYNC_TARGET_ERRORS )
+         strcat(szFile, LOG_FILE_ERRORS);
+      else if ( uTarget == LOG_ASYNC_TARGET_ERRORS_SOFT )
+         strcat(szFile, LOG_FILE_ERRORS_SOFT);
+      else if ( uTarget == LOG_ASYNC_TARGET_WATCHDOG )
+         strcat(szFile, LOG_FILE_WATCHDOG);
+      else if ( uTarget == LOG_ASYNC_TARGET_COMMANDS )
+         strcat(szFile, LOG_FILE_COMMANDS);
+      else
+         strcat(szFile, LOG_FILE_SYSTEM);
+   }
+   // Opened for each batch, so that deleted or rotated log files are recreated
+   int iFd = open(szFile, O_WRONLY | O_APPEND | O_CREAT, 0666);
+   if ( iFd < 0 )
+      return;
+   _log_async_write(iFd, iov, iCountIOV);
+   close(iFd);
+}
+
+// Returns the number of log entries written
+
+static int _log_async_drain()
+{
+   type_log_async_entry* pEntries[LOG_ASYNC_BATCH];
+   int iCount = 0;
+   u32 uTargets = 0;
+   while ( iCount < LOG_ASYNC_BATCH )
+   {
+      type_log_async_entry* pEntry = &s_pLogAsyncEntries[(s_uLogAsyncReadPos + iCount) % LOG_ASYNC_SLOTS];
+      if ( __atomic_load_n(&pEntry->uSeq, __ATOMIC_ACQUIRE) != s_uLogAsyncReadPos + iCount + 1 )
+         break;
+      pEntries[iCount++] = pEntry;
+      uTargets |= pEntry->uTargets;
+   }
+
+   char szDroppedInfo[128];
+   char* pDroppedInfo = NULL;
+   u32 uDropped = __atomic_load_n(&s_uLogAsyncDroppedCount, __ATOMIC_RELAXED);
+   if ( uDropped != s_uLogAsyncDroppedReported )
+   {
+      char szTime[64];
+      _log_format_time_mstens(szTime);
+      snprintf(szDroppedInfo, sizeof(szDroppedInfo), "%s %s: Log queue full, dropped %u log lines (%u total).\n", szTime, sszComponentName, uDropped - s_uLogAsyncDroppedReported, uDropped);
+      s_uLogAsyncDroppedReported = uDropped;
+      pDroppedInfo = szDroppedInfo;
+      uTargets |= LOG_ASYNC_TARGET_SYSTEM;
+   }
+   if ( 0 == iCount && (NULL == pDroppedInfo) )
+      return 0;
+
+   for( u32 uTarget = LOG_ASYNC_TARGET_SYSTEM; uTarget <= LOG_ASYNC_TARGET_STDOUT; uTarget <<= 1 )
+   {
+      if ( uTargets & uTarget )
+         _log_async_write_target(uTarget, pEntries, iCount, pDroppedInfo);
+   }
+
+   for( int i=0; i<iCount; i++ )
+      __atomic_store_n(&pEntries[i]->uSeq, s_uLogAsyncReadPos + i + LOG_ASYNC_SLOTS, __ATOMIC_RELEASE);
+   s_uLogAsyncReadPos += iCount;
+   return iCount;
+}
+
+static void* _thread_log_async_writer(void* pParam)
+{
+   while ( s_iLogAsyncRunning )
+   {
+      if ( 0 == _log_async_drain() )
+         hardware_sleep_ms(LOG_ASYNC_WRITER_PERIOD_MS);
+   }
+   while ( _log_async_drain() > 0 ) {}
+   return NULL;
+}
+
+// A forked child has no writer thread, it goes back to synchronous logging
+static void _log_async_on_fork_child()
+{
+   s_iLogAsyncEnabled = 0;
+   s_iLogAsyncRunning = 0;
+}
+
+void log_enable_async()
+{
+   if ( s_iLogAsyncEnabled )
+      return;
+   if ( NULL == s_pLogAsyncEntries )
+   {
+      s_pLogAsyncEntries = (type_log_async_entry*) malloc(LOG_ASYNC_SLOTS * sizeof(type_log_async_entry));
+      if ( NULL == s_pLogAsyncEntries )
+      {
+         log_softerror_and_alarm("Failed to allocate async log buffers. Using regular log.");
+         return;
+      }
+   }
+   s_uLogAsyncWritePos = 0;
+   s_uLogAsyncReadPos = 0;
+   for( int i=0; i<LOG_ASYNC_SLOTS; i++ )
+      s_pLogAsyncEntries[i].uSeq = i;
+
+   s_iLogAsyncRunning = 1;
+   if ( 0 != pthread_create(&s_pThreadLogAsyncWriter, NULL, &_thread_log_async_writer, NULL) )
+   {
+      s_iLogAsyncRunning = 0;
+      log_softerror_and_alarm("Failed to create async log writer thread. Using regular log.");
+      return;
+   }
+   if ( ! s_iLogAsyncAtExitRegistered )
+   {
+      s_iLogAsyncAtExitRegistered = 1;
+      pthread_atfork(NULL, NULL, _log_async_on_fork_child);
+      atexit(log_disable_async);
+   }
+   __atomic_store_n(&s_iLogAsyncEnabled, 1, __ATOMIC_RELEASE);
+   log_line("Async log enabled (%d entries of %d bytes).", LOG_ASYNC_SLOTS, LOG_ASYNC_MAX_ENTRY_LENGTH);
+}
+
+// Stops the writer thread after it writes all pending log lines
+void log_disable_async()
+{
+   if ( ! s_iLogAsyncEnabled )
+      return;
+   __atomic_store_n(&s_iLogAsyncEnabled, 0, __ATOMIC_RELEASE);
+   s_iLogAsyncRunning = 0;
+   pthread_join(s_pThreadLogAsyncWriter, NULL);
+}
+
+u32 log_get_async_dropped_count()
+{
+   return s_uLogAsyncDroppedCount;
+}
+
 void log_init_local_only(const char* component_name)
 {
    s_logServiceMessageQueue = -1;
@@ -708,6 +1259,12 @@ void log_line(const char* format, ...)
       return;
    }
 
+   if ( _log_async_push(LOG_ASYNC_TARGET_SYSTEM, szTime, "", format, args) )
+   {
+      va_end(args);
+      return;
+   }
+
    char szFile[MAX_FILE_PATH_SIZE];
    strcpy(szFile, FOLDER_LOGS);
    strcat(szFile, LOG_FILE_SYSTEM);
@@ -777,6 +1334,14 @@ void log_line_forced_to_file(const char* format, ...)
    if ( s_logAddTime )
       _log_format_time_mstens(szTime);
 
+   if ( s_iLogAsyncEnabled )
+   {
+      strcat(szTime, "(F)");
+      _log_async_push(LOG_ASYNC_TARGET_SYSTEM, szTime, "", format, args);
+      va_end(args);
+      return;
+   }
+
    char szFile[MAX_FILE_PATH_SIZE];
    strcpy(szFile, FOLDER_LOGS);
    strcat(szFile, LOG_FILE_SYSTEM);
@@ -858,6 +1423,12 @@ void log_line_watchdog(const char* format, ...)
       return;
    }
 
+   if ( _log_async_push(LOG_ASYNC_TARGET_SYSTEM | LOG_ASYNC_TARGET_WATCHDOG, szTime, "", format, args) )
+   {
+      va_end(args);
+      return;
+   }
+
    char szFile[MAX_FILE_PATH_SIZE];
    strcpy(szFile, FOLDER_LOGS);
    strcat(szFile, LOG_FILE_SYSTEM);
@@ -924,6 +1495,12 @@ void log_line_commands(const char* format, ...)
       return;
    }
 
+   if ( _log_async_push(LOG_ASYNC_TARGET_SYSTEM | LOG_ASYNC_TARGET_COMMANDS, szTime, "", format, args) )
+   {
+      va_end(args);
+      return;
+   }
+
    char szFile[MAX_FILE_PATH_SIZE];
    strcpy(szFile, FOLDER_LOGS);
    strcat(szFile, LOG_FILE_SYSTEM);
@@ -1279,6 +1856,9 @@ void log_always(const char* szText)
       return;
    }
 
+   if ( _log_async_pushf(LOG_ASYNC_TARGET_SYSTEM, szTime, "", "%s", ((NULL != szText) && (0 != szText[0]))?szText:"NoLog") )
+      return;
+
    char szFile[MAX_FILE_PATH_SIZE];
    strcpy(szFile, FOLDER_LOGS);
    strcat(szFile, LOG_FILE_SYSTEM);
@@ -1373,6 +1953,12 @@ void log_error_and_alarm(const char* format, ...)
       return;
    }
 
+   if ( _log_async_push(LOG_ASYNC_TARGET_SYSTEM | LOG_ASYNC_TARGET_ERRORS, szTime, "ERROR: ", format, args) )
+   {
+      va_end(args);
+      return;
+   }
+
    char szFile[MAX_FILE_PATH_SIZE];
    strcpy(szFile, FOLDER_LOGS);
    strcat(szFile, LOG_FILE_SYSTEM);
@@ -1474,6 +2060,12 @@ void log_softerror_and_alarm(const char* format, ...)
       return;
    }
 
+   if ( _log_async_push(LOG_ASYNC_TARGET_SYSTEM | LOG_ASYNC_TARGET_ERRORS_SOFT, szTime, "SOFT_ERROR: ", format, args) )
+   {
+      va_end(args);
+      return;
+   }
+
    char szFile[MAX_FILE_PATH_SIZE];
    strcpy(szFile, FOLDER_LOGS);
    strcat(szFile, LOG_FILE_SYSTEM);
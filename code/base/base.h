@@ -27,7 +27,6 @@ typedef u32 __le32;
 #define MAX_VEHICLE_NAME_LENGTH 16
 #define MAX_SERVICE_LOG_ENTRY_LENGTH 300
 #define LOGGER_MESSAGE_QUEUE_ID 123
-#define SM_STREAMER_SIZE 512000
 #define SM_STREAMER_NAME "/SSMRVideo"
 #define RUBY_HW_CLOCK_ID CLOCK_MONOTONIC
 
@@ -35,7 +34,7 @@ typedef u32 __le32;
 // dword[3...0]: BB.BB.MM.mm  (BB.BB: build number (highest bytes), MM: major ver, mm: minor ver (lowest byte)) 
 #define SYSTEM_SW_VERSION_MAJOR 11
 #define SYSTEM_SW_VERSION_MINOR 7
-#define SYSTEM_SW_BUILD_NUMBER  11704
+#define SYSTEM_SW_BUILD_NUMBER  11705
 //#define SYSTEM_IS_PRERELEASE 1
 
 #if __BYTE_ORDER == __LITTLE_ENDIAN
@@ -82,6 +81,13 @@ u32 revert_word(u32 input);
 
 void reset_counters(type_u32_couters* pCounters);
 
+#define CRC32_IMPLEMENTATION_TABLE 0
+#define CRC32_IMPLEMENTATION_SLICE8 1
+#define CRC32_IMPLEMENTATION_HW 2
+
+// Selects the best implementation up to the one requested; returns the one selected
+int base_crc32_set_implementation(int iImplementation);
+const char* base_crc32_get_implementation_name();
 u32 base_compute_crc32(u8 *buf, int length);
 u8 base_compute_crc8(u8* pBuffer, int iLength);
 int base_check_crc32(u8* pBuffer, int iLength);
@@ -106,6 +112,9 @@ void log_init_local_only(const char* component_name);
 void log_init(const char* component_name);
 void log_arguments(int argc, char *argv[]);
 void log_add_file(const char* szFileName);
+void log_enable_async();
+void log_disable_async();
+u32 log_get_async_dropped_count();
 void log_disable();
 void log_disable_stdout();
 void log_enable_stdout();
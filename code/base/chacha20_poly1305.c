@@ -0,0 +1,407 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "base.h"
+#include "chacha20_poly1305.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CHACHA20_USE_NEON 1
+#endif
+
+#define POLY1305_MASK26 0x3ffffff
+
+static u32 _chacha_load32(const u8* p)
+{
+   return ((u32)p[0]) | (((u32)p[1]) << 8) | (((u32)p[2]) << 16) | (((u32)p[3]) << 24);
+}
+
+static void _chacha_store32(u8* p, u32 v)
+{
+   p[0] = v & 0xFF;
+   p[1] = (v >> 8) & 0xFF;
+   p[2] = (v >> 16) & 0xFF;
+   p[3] = (v >> 24) & 0xFF;
+}
+
+static void _chacha20_init_state(u32* pState, const u8* pKey, const u8* pNonce, u32 uCounter)
+{
+   pState[0] = 0x61707865;
+   pState[1] = 0x3320646e;
+   pState[2] = 0x79622d32;
+   pState[3] = 0x6b206574;
+   for( int i=0; i<8; i++ )
+      pState[4+i] = _chacha_load32(pKey + 4*i);
+   pState[12] = uCounter;
+   pState[13] = _chacha_load32(pNonce);
+   pState[14] = _chacha_load32(pNonce + 4);
+   pState[15] = _chacha_load32(pNonce + 8);
+}
+
+#ifdef CHACHA20_USE_NEON
+
+#define CHACHA_NEON_ROTL(v, n) vsriq_n_u32(vshlq_n_u32((v), (n)), (v), 32-(n))
+#define CHACHA_NEON_ROTL16(v) vreinterpretq_u32_u16(vrev32q_u16(vreinterpretq_u16_u32(v)))
+
+#define CHACHA_NEON_ROUND(a, b, c, d) \
+   a = vaddq_u32(a, b); d = veorq_u32(d, a); d = CHACHA_NEON_ROTL16(d); \
+   c = vaddq_u32(c, d); b = veorq_u32(b, c); b = CHACHA_NEON_ROTL(b, 12); \
+   a = vaddq_u32(a, b); d = veorq_u32(d, a); d = CHACHA_NEON_ROTL(d, 8); \
+   c = vaddq_u32(c, d); b = veorq_u32(b, c); b = CHACHA_NEON_ROTL(b, 7);
+
+// The four state rows are vectors: the column rounds work on all four columns at once,
+// the diagonal rounds rotate rows b, c, d so that the diagonals line up as columns.
+static void _chacha20_block_state(const u32* pState, u8* pOutput)
+{
+   uint32x4_t a0 = vld1q_u32(pState);
+   uint32x4_t b0 = vld1q_u32(pState + 4);
+   uint32x4_t c0 = vld1q_u32(pState + 8);
+   uint32x4_t d0 = vld1q_u32(pState + 12);
+   uint32x4_t a = a0, b = b0, c = c0, d = d0;
+
+   for( int i=0; i<10; i++ )
+   {
+      CHACHA_NEON_ROUND(a, b, c, d);
+      b = vextq_u32(b, b, 1);
+      c = vextq_u32(c, c, 2);
+      d = vextq_u32(d, d, 3);
+      CHACHA_NEON_ROUND(a, b, c, d);
+      b = vextq_u32(b, b, 3);
+      c = vextq_u32(c, c, 2);
+      d = vextq_u32(d, d, 1);
+   }
+
+   vst1q_u8(pOutput, vreinterpretq_u8_u32(vaddq_u32(a, a0)));
+   vst1q_u8(pOutput + 16, vreinterpretq_u8_u32(vaddq_u32(b, b0)));
+   vst1q_u8(pOutput + 32, vreinterpretq_u8_u32(vaddq_u32(c, c0)));
+   vst1q_u8(pOutput + 48, vreinterpretq_u8_u32(vaddq_u32(d, d0)));
+}
+
+#else
+
+#define CHACHA_ROTL(v, n) (((v) << (n)) | ((v) >> (32-(n))))
+
+#define CHACHA_QUARTER_ROUND(a, b, c, d) \
+   x[a] += x[b]; x[d] ^= x[a]; x[d] = CHACHA_ROTL(x[d], 16); \
+   x[c] += x[d]; x[b] ^= x[c]; x[b] = CHACHA_ROTL(x[b], 12); \
+   x[a] += x[b]; x[d] ^= x[a]; x[d] = CHACHA_ROTL(x[d], 8); \
+   x[c] += x[d]; x[b] ^= x[c]; x[b] = CHACHA_ROTL(x[b], 7);
+
+static void _chacha20_block_state(const u32* pState, u8* pOutput)
+{
+   u32 x[16];
+   memcpy(x, pState, sizeof(x));
+
+   for( int i=0; i<10; i++ )
+   {
+      CHACHA_QUARTER_ROUND(0, 4, 8, 12);
+      CHACHA_QUARTER_ROUND(1, 5, 9, 13);
+      CHACHA_QUARTER_ROUND(2, 6, 10, 14);
+      CHACHA_QUARTER_ROUND(3, 7, 11, 15);
+      CHACHA_QUARTER_ROUND(0, 5, 10, 15);
+      CHACHA_QUARTER_ROUND(1, 6, 11, 12);
+      CHACHA_QUARTER_ROUND(2, 7, 8, 13);
+      CHACHA_QUARTER_ROUND(3, 4, 9, 14);
+   }
+
+   for( int i=0; i<16; i++ )
+      _chacha_store32(pOutput + 4*i, x[i] + pState[i]);
+}
+
+#endif
+
+void chacha20_block(const u8* pKey, const u8* pNonce, u32 uCounter, u8* pOutput)
+{
+   u32 uState[16];
+   _chacha20_init_state(uState, pKey, pNonce, uCounter);
+   _chacha20_block_state(uState, pOutput);
+}
+
+void chacha20_xor(const u8* pKey, const u8* pNonce, u32 uCounter, u8* pData, int iLength)
+{
+   if ( (NULL == pData) || (iLength <= 0) )
+      return;
+
+   u32 uState[16];
+   u8 uStream[CHACHA20_BLOCK_SIZE];
+   _chacha20_init_state(uState, pKey, pNonce, uCounter);
+
+   while ( iLength >= CHACHA20_BLOCK_SIZE )
+   {
+      _chacha20_block_state(uState, uStream);
+      uState[12]++;
+      for( int i=0; i<CHACHA20_BLOCK_SIZE; i += 8 )
+      {
+         uint64_t uData, uKey;
+         memcpy(&uData, pData + i, 8);
+         memcpy(&uKey, uStream + i, 8);
+         uData ^= uKey;
+         memcpy(pData + i, &uData, 8);
+      }
+      pData += CHACHA20_BLOCK_SIZE;
+      iLength -= CHACHA20_BLOCK_SIZE;
+   }
+
+   if ( iLength > 0 )
+   {
+      _chacha20_block_state(uState, uStream);
+      for( int i=0; i<iLength; i++ )
+         pData[i] ^= uStream[i];
+   }
+}
+
+//---------------------------------------------------
+// Poly1305, 26 bits limbs
+
+typedef struct
+{
+   u32 r[5];
+   u32 s[4];
+   u32 h[5];
+   u32 pad[4];
+   u8 uBuffer[16];
+   int iBuffered;
+} t_poly1305_state;
+
+static void _poly1305_init(t_poly1305_state* pState, const u8* pKey)
+{
+   pState->r[0] = (_chacha_load32(pKey + 0)) & 0x3ffffff;
+   pState->r[1] = (_chacha_load32(pKey + 3) >> 2) & 0x3ffff03;
+   pState->r[2] = (_chacha_load32(pKey + 6) >> 4) & 0x3ffc0ff;
+   pState->r[3] = (_chacha_load32(pKey + 9) >> 6) & 0x3f03fff;
+   pState->r[4] = (_chacha_load32(pKey + 12) >> 8) & 0x00fffff;
+   for( int i=0; i<4; i++ )
+   {
+      pState->s[i] = pState->r[i+1] * 5;
+      pState->pad[i] = _chacha_load32(pKey + 16 + 4*i);
+   }
+   memset(pState->h, 0, sizeof(pState->h));
+   pState->iBuffered = 0;
+}
+
+static void _poly1305_blocks(t_poly1305_state* pState, const u8* pData, int iLength, u32 uHiBit)
+{
+   const u32 r0 = pState->r[0], r1 = pState->r[1], r2 = pState->r[2], r3 = pState->r[3], r4 = pState->r[4];
+   const u32 s1 = pState->s[0], s2 = pState->s[1], s3 = pState->s[2], s4 = pState->s[3];
+   u32 h0 = pState->h[0], h1 = pState->h[1], h2 = pState->h[2], h3 = pState->h[3], h4 = pState->h[4];
+
+   while ( iLength >= 16 )
+   {
+      h0 += (_chacha_load32(pData + 0)) & POLY1305_MASK26;
+      h1 += (_chacha_load32(pData + 3) >> 2) & POLY1305_MASK26;
+      h2 += (_chacha_load32(pData + 6) >> 4) & POLY1305_MASK26;
+      h3 += (_chacha_load32(pData + 9) >> 6) & POLY1305_MASK26;
+      h4 += (_chacha_load32(pData + 12) >> 8) | uHiBit;
+
+      uint64_t d0 = ((uint64_t)h0 * r0) + ((uint64_t)h1 * s4) + ((uint64_t)h2 * s3) + ((uint64_t)h3 * s2) + ((uint64_t)h4 * s1);
+      uint64_t d1 = ((uint64_t)h0 * r1) + ((uint64_t)h1 * r0) + ((uint64_t)h2 * s4) + ((uint64_t)h3 * s3) + ((uint64_t)h4 * s2);
+      uint64_t d2 = ((uint64_t)h0 * r2) + ((uint64_t)h1 * r1) + ((uint64_t)h2 * r0) + ((uint64_t)h3 * s4) + ((uint64_t)h4 * s3);
+      uint64_t d3 = ((uint64_t)h0 * r3) + ((uint64_t)h1 * r2) + ((uint64_t)h2 * r1) + ((uint64_t)h3 * r0) + ((uint64_t)h4 * s4);
+      uint64_t d4 = ((uint64_t)h0 * r4) + ((uint64_t)h1 * r3) + ((uint64_t)h2 * r2) + ((uint64_t)h3 * r1) + ((uint64_t)h4 * r0);
+
+      u32 c = (u32)(d0 >> 26); h0 = (u32)d0 & POLY1305_MASK26;
+      d1 += c; c = (u32)(d1 >> 26); h1 = (u32)d1 & POLY1305_MASK26;
+      d2 += c; c = (u32)(d2 >> 26); h2 = (u32)d2 & POLY1305_MASK26;
+      d3 += c; c = (u32)(d3 >> 26); h3 = (u32)d3 & POLY1305_MASK26;
+      d4 += c; c = (u32)(d4 >> 26); h4 = (u32)d4 & POLY1305_MASK26;
+      h0 += c * 5; c = h0 >> 26; h0 &= POLY1305_MASK26;
+      h1 += c;
+
+      pData += 16;
+      iLength -= 16;
+   }
+
+   pState->h[0] = h0; pState->h[1] = h1; pState->h[2] = h2; pState->h[3] = h3; pState->h[4] = h4;
+}
+
+static void _poly1305_update(t_poly1305_state* pState, const u8* pData, int iLength)
+{
+   if ( pState->iBuffered > 0 )
+   {
+      int iCopy = 16 - pState->iBuffered;
+      if ( iCopy > iLength )
+         iCopy = iLength;
+      memcpy(pState->uBuffer + pState->iBuffered, pData, iCopy);
+      pState->iBuffered += iCopy;
+      pData += iCopy;
+      iLength -= iCopy;
+      if ( pState->iBuffered < 16 )
+         return;
+      _poly1305_blocks(pState, pState->uBuffer, 16, 1<<24);
+      pState->iBuffered = 0;
+   }
+
+   int iFull = iLength & ~15;
+   if ( iFull > 0 )
+      _poly1305_blocks(pState, pData, iFull, 1<<24);
+
+   if ( iLength > iFull )
+   {
+      memcpy(pState->uBuffer, pData + iFull, iLength - iFull);
+      pState->iBuffered = iLength - iFull;
+   }
+}
+
+static void _poly1305_finish(t_poly1305_state* pState, u8* pTag)
+{
+   if ( pState->iBuffered > 0 )
+   {
+      pState->uBuffer[pState->iBuffered] = 1;
+      memset(pState->uBuffer + pState->iBuffered + 1, 0, 16 - pState->iBuffered - 1);
+      _poly1305_blocks(pState, pState->uBuffer, 16, 0);
+   }
+
+   u32 h0 = pState->h[0], h1 = pState->h[1], h2 = pState->h[2], h3 = pState->h[3], h4 = pState->h[4];
+   u32 c;
+   c = h1 >> 26; h1 &= POLY1305_MASK26;
+   h2 += c; c = h2 >> 26; h2 &= POLY1305_MASK26;
+   h3 += c; c = h3 >> 26; h3 &= POLY1305_MASK26;
+   h4 += c; c = h4 >> 26; h4 &= POLY1305_MASK26;
+   h0 += c * 5; c = h0 >> 26; h0 &= POLY1305_MASK26;
+   h1 += c;
+
+   // Computes h - p and keeps it if it's not negative
+   u32 g0 = h0 + 5; c = g0 >> 26; g0 &= POLY1305_MASK26;
+   u32 g1 = h1 + c; c = g1 >> 26; g1 &= POLY1305_MASK26;
+   u32 g2 = h2 + c; c = g2 >> 26; g2 &= POLY1305_MASK26;
+   u32 g3 = h3 + c; c = g3 >> 26; g3 &= POLY1305_MASK26;
+   u32 g4 = h4 + c - (1 << 26);
+
+   u32 uMask = (g4 >> 31) - 1;
+   g0 &= uMask; g1 &= uMask; g2 &= uMask; g3 &= uMask; g4 &= uMask;
+   uMask = ~uMask;
+   h0 = (h0 & uMask) | g0;
+   h1 = (h1 & uMask) | g1;
+   h2 = (h2 & uMask) | g2;
+   h3 = (h3 & uMask) | g3;
+   h4 = (h4 & uMask) | g4;
+
+   h0 = h0 | (h1 << 26);
+   h1 = (h1 >> 6) | (h2 << 20);
+   h2 = (h2 >> 12) | (h3 << 14);
+   h3 = (h3 >> 18) | (h4 << 8);
+
+   uint64_t f;
+   f = (uint64_t)h0 + pState->pad[0]; h0 = (u32)f;
+   f = (uint64_t)h1 + pState->pad[1] + (f >> 32); h1 = (u32)f;
+   f = (uint64_t)h2 + pState->pad[2] + (f >> 32); h2 = (u32)f;
+   f = (uint64_t)h3 + pState->pad[3] + (f >> 32); h3 = (u32)f;
+
+   _chacha_store32(pTag, h0);
+   _chacha_store32(pTag + 4, h1);
+   _chacha_store32(pTag + 8, h2);
+   _chacha_store32(pTag + 12, h3);
+
+   memset(pState, 0, sizeof(t_poly1305_state));
+}
+
+void poly1305_mac(const u8* pKey, const u8* pData, int iLength, u8* pTag)
+{
+   t_poly1305_state state;
+   _poly1305_init(&state, pKey);
+   if ( (NULL != pData) && (iLength > 0) )
+      _poly1305_update(&state, pData, iLength);
+   _poly1305_finish(&state, pTag);
+}
+
+//---------------------------------------------------
+// AEAD
+
+static void _chacha20_poly1305_compute_tag(const u8* pKey, const u8* pNonce, const u8* pAAD, int iAADLength, const u8* pData, int iLength, u8* pTag)
+{
+   u8 uOneTimeKey[CHACHA20_BLOCK_SIZE];
+   u8 uPadding[16];
+   u8 uLengths[16];
+   t_poly1305_state state;
+
+   chacha20_block(pKey, pNonce, 0, uOneTimeKey);
+   _poly1305_init(&state, uOneTimeKey);
+   memset(uPadding, 0, sizeof(uPadding));
+
+   if ( iAADLength > 0 )
+   {
+      _poly1305_update(&state, pAAD, iAADLength);
+      if ( iAADLength % 16 )
+         _poly1305_update(&state, uPadding, 16 - (iAADLength % 16));
+   }
+   if ( iLength > 0 )
+   {
+      _poly1305_update(&state, pData, iLength);
+      if ( iLength % 16 )
+         _poly1305_update(&state, uPadding, 16 - (iLength % 16));
+   }
+
+   memset(uLengths, 0, sizeof(uLengths));
+   _chacha_store32(uLengths, (u32)iAADLength);
+   _chacha_store32(uLengths + 8, (u32)iLength);
+   _poly1305_update(&state, uLengths, 16);
+   _poly1305_finish(&state, pTag);
+   memset(uOneTimeKey, 0, sizeof(uOneTimeKey));
+}
+
+void chacha20_poly1305_seal(const u8* pKey, const u8* pNonce, const u8* pAAD, int iAADLength, u8* pData, int iLength, u8* pTag)
+{
+   if ( iAADLength < 0 )
+      iAADLength = 0;
+   if ( iLength < 0 )
+      iLength = 0;
+   chacha20_xor(pKey, pNonce, 1, pData, iLength);
+   _chacha20_poly1305_compute_tag(pKey, pNonce, pAAD, iAADLength, pData, iLength, pTag);
+}
+
+int chacha20_poly1305_open(const u8* pKey, const u8* pNonce, const u8* pAAD, int iAADLength, u8* pData, int iLength, const u8* pTag)
+{
+   if ( (iAADLength < 0) || (iLength < 0) )
+      return 0;
+
+   u8 uTag[CHACHA20_POLY1305_TAG_SIZE];
+   _chacha20_poly1305_compute_tag(pKey, pNonce, pAAD, iAADLength, pData, iLength, uTag);
+
+   // Constant time compare
+   u8 uDiff = 0;
+   for( int i=0; i<CHACHA20_POLY1305_TAG_SIZE; i++ )
+      uDiff |= uTag[i] ^ pTag[i];
+   if ( 0 != uDiff )
+      return 0;
+
+   chacha20_xor(pKey, pNonce, 1, pData, iLength);
+   return 1;
+}
+
+const char* chacha20_get_implementation_name()
+{
+   #ifdef CHACHA20_USE_NEON
+   return "neon";
+   #else
+   return "portable";
+   #endif
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "base.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ChaCha20-Poly1305 authenticated encryption (RFC 8439).
+// The ChaCha20 block function uses NEON on ARM (one block as four row vectors), portable C otherwise.
+// Encryption and decryption are done in place.
+
+#define CHACHA20_POLY1305_KEY_SIZE 32
+#define CHACHA20_POLY1305_NONCE_SIZE 12
+#define CHACHA20_POLY1305_TAG_SIZE 16
+#define CHACHA20_BLOCK_SIZE 64
+
+// One 64 bytes keystream block
+void chacha20_block(const u8* pKey, const u8* pNonce, u32 uCounter, u8* pOutput);
+// XORs the keystream, starting at block uCounter, into the data
+void chacha20_xor(const u8* pKey, const u8* pNonce, u32 uCounter, u8* pData, int iLength);
+
+void poly1305_mac(const u8* pKey, const u8* pData, int iLength, u8* pTag);
+
+// Encrypts pData and computes the tag over pAAD (sent in clear) and the encrypted data
+void chacha20_poly1305_seal(const u8* pKey, const u8* pNonce, const u8* pAAD, int iAADLength, u8* pData, int iLength, u8* pTag);
+// Returns 1 and decrypts pData if the tag is valid; returns 0 and leaves pData unchanged otherwise
+int chacha20_poly1305_open(const u8* pKey, const u8* pNonce, const u8* pAAD, int iAADLength, u8* pData, int iLength, const u8* pTag);
+
+const char* chacha20_get_implementation_name();
+
+#ifdef __cplusplus
+}
+#endif
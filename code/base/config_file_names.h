@@ -60,8 +60,8 @@
 #define FILE_CONFIG_FAST_BOOT_COUNTER "fast_boot_counter.txt"
 
 #define FILE_TEMP_USB_TETHERING_DEVICE "usb_tethering"
-#define FILE_TEMP_VIDEO_MEM_FILE "tmpVideo.h26x"
-#define FILE_TEMP_VIDEO_FILE "tmpVideo.h26x"
+#define FILE_TEMP_VIDEO_MEM_FILE "tmpVideo.mp4"
+#define FILE_TEMP_VIDEO_FILE "tmpVideo.mp4"
 #define FILE_TEMP_VIDEO_FILE_INFO "tmpVideo.info"
 #define FILE_TEMP_VIDEO_FILE_OSD "tmpVideo.osd"
 #define FILE_TEMP_VIDEO_FILE_SRT "tmpVideo.srt"
@@ -49,6 +49,7 @@
 
 #define DEFAULT_USE_PPCAP_FOR_TX 0
 #define DEFAULT_BYPASS_SOCKET_BUFFERS 1
+#define DEFAULT_USE_BATCHED_RX_SOCKET 1
 #define DEFAULT_RADIO_TX_POWER_CONTROLLER 20
 #define DEFAULT_RADIO_TX_POWER 20
 #define DEFAULT_RADIO_SIK_TX_POWER 11
@@ -250,6 +250,8 @@ void controller_rt_info_init(controller_runtime_info* pCRTInfo)
    }
 
    pCRTInfo->uTotalCountOutputSkippedBlocks = 0;
+   pCRTInfo->uTotalFECDecodeMatrixCacheHits = 0;
+   pCRTInfo->uTotalFECDecodeMatrixCacheMisses = 0;
 }
 
 controller_runtime_info_vehicle* controller_rt_info_get_vehicle_info(controller_runtime_info* pRTInfo, u32 uVehicleId)
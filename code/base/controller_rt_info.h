@@ -92,6 +92,8 @@ typedef struct
 
    u32 uFlagsAdaptiveVideo[SYSTEM_RT_INFO_INTERVALS];
    u32 uTotalCountOutputSkippedBlocks;
+   u32 uTotalFECDecodeMatrixCacheHits;
+   u32 uTotalFECDecodeMatrixCacheMisses;
 
    controller_runtime_info_vehicle vehicles[MAX_CONCURENT_VEHICLES];
 } ALIGN_STRUCT_SPEC_INFO controller_runtime_info;
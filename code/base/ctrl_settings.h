@@ -36,7 +36,7 @@ typedef struct
    int iVideoForwardUSBType; // 0 - none, 1 - raw (h264)
    int iVideoForwardUSBPort;
    int iVideoForwardUSBPacketSize;
-   int nVideoForwardETHType; // 0 - none, 1 - raw (h264), 2 - rtp (gstreamer)
+   int nVideoForwardETHType; // 0 - none, 1 - raw (h264), 2 - rtp (gstreamer), 3 - rtp (native, per NAL), 4 - rtp (native) + rtcp sender reports
    int nVideoForwardETHPort;
    int nVideoForwardETHPacketSize;
    int iTelemetryForwardUSBType; // 0 - none, 1 - enabled
@@ -33,14 +33,51 @@
 #include "base.h"
 #include "config.h"
 #include "encr.h"
+#include "chacha20_poly1305.h"
 #include "../radio/radiopackets2.h"
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ENC_HAS_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define ENC_HAS_SSE2 1
+#endif
+
 #define ENC_BLOCK_SIZE 8
 #define ENC_KEY_INIT_SEED 23
 
+// The pass phrase repeated up to (at least) this size, so that epp/dpp XOR a whole packet
+// with no per byte index wrapping. Its length is a multiple of the pass length, so longer buffers
+// just restart from its beginning.
+#define ENC_KEYSTREAM_MIN_SIZE 2048
+#define ENC_AUTH_KDF_ROUNDS 1024
+
 u8 s_epp[MAX_PASS_LENGTH+1];
 u8 s_eppl = 0;
 
+static u8 s_uEncKeyStream[ENC_KEYSTREAM_MIN_SIZE + MAX_PASS_LENGTH] __attribute__((aligned(16)));
+static int s_iEncKeyStreamLength = 0;
+static int s_iEncImplementation = -1;
+
+static u8 s_uEncAuthKey[CHACHA20_POLY1305_KEY_SIZE];
+static u32 s_uEncAuthSession = 0;
+static u32 s_uEncAuthCounter = 0;
+
+static void _encr_update_keys();
+
+// Only the first MAX_PASS_LENGTH bytes of the pass are used: s_epp holds no more and the
+// key stream is built from it.
+static void _encr_set_pass(const char* szPass, int iLength)
+{
+   if ( iLength > MAX_PASS_LENGTH )
+      iLength = MAX_PASS_LENGTH;
+   memcpy(s_epp, szPass, iLength);
+   s_epp[iLength] = 0;
+   s_eppl = (u8)iLength;
+   _encr_update_keys();
+}
+
 int lpp(char* szOutputBuffer, int maxLength)
 {
    char szFile[128];
@@ -88,9 +125,7 @@ int lpp(char* szOutputBuffer, int maxLength)
       return 0;
 
    szBuffer[pos] = 0;
-   s_eppl = pos;
-   strncpy((char*)s_epp, szBuffer, MAX_PASS_LENGTH);
-   s_epp[MAX_PASS_LENGTH] = 0;
+   _encr_set_pass(szBuffer, pos);
 
    if ( NULL != szOutputBuffer )
       strncpy(szOutputBuffer, szBuffer, maxLength);
@@ -110,9 +145,7 @@ int spp(char* szBuffer)
    if ( NULL == fd )
       return 0;
 
-   s_eppl = strlen(szBuffer);
-   strncpy((char*)s_epp, szBuffer, MAX_PASS_LENGTH);
-   s_epp[MAX_PASS_LENGTH] = 0;
+   _encr_set_pass(szBuffer, strlen(szBuffer));
 
    u8 sBlockSeed[ENC_BLOCK_SIZE];
    u8 sBlockInput[ENC_BLOCK_SIZE];
@@ -161,10 +194,19 @@ int spp(char* szBuffer)
    return 1;
 }
 
+int upp(char* szBuffer)
+{
+   if ( NULL == szBuffer || 0 == szBuffer[0] )
+      return 0;
+   _encr_set_pass(szBuffer, strlen(szBuffer));
+   return 1;
+}
+
 void rpp()
 {
    s_eppl = 0;
    s_epp[0] = 0;
+   _encr_update_keys();
 }
 
 u8* gpp(int* pLen)
@@ -181,19 +223,200 @@ int hpp()
    return 0;
 }
 
-int epp(u8* pData, int len)
+static void _encr_new_auth_session()
 {
-   if ( NULL == pData || len <= 0 )
-      return 0;
+   u32 uSession = 0;
+   FILE* fd = fopen("/dev/urandom", "rb");
+   if ( NULL != fd )
+   {
+      if ( 1 != fread(&uSession, sizeof(u32), 1, fd) )
+         uSession = 0;
+      fclose(fd);
+   }
+   if ( 0 == uSession )
+      uSession = get_current_timestamp_micros() ^ (((u32)getpid()) << 16);
+   s_uEncAuthSession = uSession;
+   s_uEncAuthCounter = 0;
+}
+
+// The authenticated mode key is derived from the pass phrase: the pass is absorbed 32 bytes at a time
+// into a key that is then run through the ChaCha20 block function for a number of rounds.
+static void _encr_derive_auth_key()
+{
+   u8 uKey[CHACHA20_POLY1305_KEY_SIZE];
+   u8 uNonce[CHACHA20_POLY1305_NONCE_SIZE];
+   u8 uBlock[CHACHA20_BLOCK_SIZE];
+   memcpy(uKey, "RubyFPV link authenticated key.", CHACHA20_POLY1305_KEY_SIZE);
+   memset(uNonce, 0, sizeof(uNonce));
+
+   int iPassLength = s_eppl;
+   if ( iPassLength > MAX_PASS_LENGTH )
+      iPassLength = MAX_PASS_LENGTH;
+   uNonce[4] = (u8)iPassLength;
+   for( int iPos=0; iPos<iPassLength; iPos += CHACHA20_POLY1305_KEY_SIZE )
+   {
+      for( int i=0; (i<CHACHA20_POLY1305_KEY_SIZE) && (iPos+i < iPassLength); i++ )
+         uKey[i] ^= s_epp[iPos+i];
+      uNonce[0] = (u8)(iPos/CHACHA20_POLY1305_KEY_SIZE);
+      chacha20_block(uKey, uNonce, 0, uBlock);
+      memcpy(uKey, uBlock, CHACHA20_POLY1305_KEY_SIZE);
+   }
+
+   uNonce[8] = 1;
+   for( u32 u=0; u<ENC_AUTH_KDF_ROUNDS; u++ )
+   {
+      chacha20_block(uKey, uNonce, u, uBlock);
+      memcpy(uKey, uBlock, CHACHA20_POLY1305_KEY_SIZE);
+   }
+   memcpy(s_uEncAuthKey, uKey, CHACHA20_POLY1305_KEY_SIZE);
+   memset(uKey, 0, sizeof(uKey));
+   memset(uBlock, 0, sizeof(uBlock));
+}
+
+// Called each time the pass phrase changes
+static void _encr_update_keys()
+{
+   s_iEncKeyStreamLength = 0;
+   memset(s_uEncAuthKey, 0, sizeof(s_uEncAuthKey));
    if ( 0 == s_eppl )
-      return 1;
+      return;
+
+   // Same key byte for each position as s_epp[pos % s_eppl]
+   int iPeriod = s_eppl;
+   if ( iPeriod > MAX_PASS_LENGTH )
+      iPeriod = MAX_PASS_LENGTH;
+   memcpy(s_uEncKeyStream, s_epp, iPeriod);
+   int iLength = iPeriod;
+   while ( iLength < ENC_KEYSTREAM_MIN_SIZE )
+   {
+      memcpy(&s_uEncKeyStream[iLength], s_uEncKeyStream, iPeriod);
+      iLength += iPeriod;
+   }
+   s_iEncKeyStreamLength = iLength;
+
+   _encr_derive_auth_key();
+   _encr_new_auth_session();
+}
 
+static void _encr_xor_bytes(u8* pData, int len)
+{
    for(int pos=0; pos < len; pos++ )
    {
-      //*pData = (*pData)+1;
       *pData = (*pData) ^ s_epp[pos%s_eppl];
       pData++;
    }
+}
+
+static void _encr_xor_words(u8* pData, const u8* pKey, int len)
+{
+   while ( len >= 8 )
+   {
+      uint64_t uData, uKey;
+      memcpy(&uData, pData, 8);
+      memcpy(&uKey, pKey, 8);
+      uData ^= uKey;
+      memcpy(pData, &uData, 8);
+      pData += 8;
+      pKey += 8;
+      len -= 8;
+   }
+   while ( len > 0 )
+   {
+      *pData++ ^= *pKey++;
+      len--;
+   }
+}
+
+static void _encr_xor_simd(u8* pData, const u8* pKey, int len)
+{
+   #if defined(ENC_HAS_NEON)
+   while ( len >= 32 )
+   {
+      vst1q_u8(pData, veorq_u8(vld1q_u8(pData), vld1q_u8(pKey)));
+      vst1q_u8(pData+16, veorq_u8(vld1q_u8(pData+16), vld1q_u8(pKey+16)));
+      pData += 32;
+      pKey += 32;
+      len -= 32;
+   }
+   #elif defined(ENC_HAS_SSE2)
+   while ( len >= 32 )
+   {
+      __m128i d0 = _mm_loadu_si128((const __m128i*)pData);
+      __m128i d1 = _mm_loadu_si128((const __m128i*)(pData+16));
+      d0 = _mm_xor_si128(d0, _mm_loadu_si128((const __m128i*)pKey));
+      d1 = _mm_xor_si128(d1, _mm_loadu_si128((const __m128i*)(pKey+16)));
+      _mm_storeu_si128((__m128i*)pData, d0);
+      _mm_storeu_si128((__m128i*)(pData+16), d1);
+      pData += 32;
+      pKey += 32;
+      len -= 32;
+   }
+   #endif
+   _encr_xor_words(pData, pKey, len);
+}
+
+static void _encr_xor_keystream(u8* pData, int len)
+{
+   if ( s_iEncImplementation < 0 )
+      encr_set_implementation(ENC_IMPLEMENTATION_SIMD);
+
+   if ( (s_iEncImplementation == ENC_IMPLEMENTATION_BYTES) || (0 == s_iEncKeyStreamLength) )
+   {
+      _encr_xor_bytes(pData, len);
+      return;
+   }
+
+   while ( len > 0 )
+   {
+      int iChunk = len;
+      if ( iChunk > s_iEncKeyStreamLength )
+         iChunk = s_iEncKeyStreamLength;
+      if ( s_iEncImplementation == ENC_IMPLEMENTATION_SIMD )
+         _encr_xor_simd(pData, s_uEncKeyStream, iChunk);
+      else
+         _encr_xor_words(pData, s_uEncKeyStream, iChunk);
+      pData += iChunk;
+      len -= iChunk;
+   }
+}
+
+int encr_set_implementation(int iImplementation)
+{
+   int iRequested = iImplementation;
+   iImplementation = ENC_IMPLEMENTATION_BYTES;
+   if ( iRequested >= ENC_IMPLEMENTATION_WORDS )
+      iImplementation = ENC_IMPLEMENTATION_WORDS;
+   #if defined(ENC_HAS_NEON) || defined(ENC_HAS_SSE2)
+   if ( iRequested >= ENC_IMPLEMENTATION_SIMD )
+      iImplementation = ENC_IMPLEMENTATION_SIMD;
+   #endif
+   s_iEncImplementation = iImplementation;
+   return iImplementation;
+}
+
+const char* encr_get_implementation_name()
+{
+   if ( s_iEncImplementation == ENC_IMPLEMENTATION_SIMD )
+   {
+      #if defined(ENC_HAS_NEON)
+      return "neon";
+      #else
+      return "sse2";
+      #endif
+   }
+   if ( s_iEncImplementation == ENC_IMPLEMENTATION_WORDS )
+      return "words";
+   return "bytes";
+}
+
+int epp(u8* pData, int len)
+{
+   if ( NULL == pData || len <= 0 )
+      return 0;
+   if ( 0 == s_eppl )
+      return 1;
+
+   _encr_xor_keystream(pData, len);
    return 1;
 }
 
@@ -204,11 +427,46 @@ int dpp(u8* pData, int len)
    if ( 0 == s_eppl )
       return 1;
 
-   for(int pos=0; pos < len; pos++ )
+   _encr_xor_keystream(pData, len);
+   return 1;
+}
+
+static void _encr_build_auth_nonce(u32 uSenderId, const u8* pTrailer, u8* pNonce)
+{
+   memcpy(pNonce, &uSenderId, sizeof(u32));
+   memcpy(pNonce + sizeof(u32), pTrailer, ENC_AUTH_NONCE_SIZE);
+}
+
+int eppa(u32 uSenderId, u8* pAAD, int iAADLength, u8* pData, int len, u8* pTrailer)
+{
+   if ( (NULL == pData) || (NULL == pTrailer) || (len < 0) )
+      return 0;
+   if ( 0 == s_eppl )
+      return 0;
+
+   s_uEncAuthCounter++;
+   if ( 0 == s_uEncAuthCounter )
    {
-      //*pData = (*pData)-1;
-      *pData = (*pData) ^ s_epp[pos%s_eppl];
-      pData++;
+      _encr_new_auth_session();
+      s_uEncAuthCounter++;
    }
+   memcpy(pTrailer, &s_uEncAuthSession, sizeof(u32));
+   memcpy(pTrailer + sizeof(u32), &s_uEncAuthCounter, sizeof(u32));
+
+   u8 uNonce[CHACHA20_POLY1305_NONCE_SIZE];
+   _encr_build_auth_nonce(uSenderId, pTrailer, uNonce);
+   chacha20_poly1305_seal(s_uEncAuthKey, uNonce, pAAD, iAADLength, pData, len, pTrailer + ENC_AUTH_NONCE_SIZE);
    return 1;
 }
+
+int dppa(u32 uSenderId, u8* pAAD, int iAADLength, u8* pData, int len, const u8* pTrailer)
+{
+   if ( (NULL == pData) || (NULL == pTrailer) || (len < 0) )
+      return 0;
+   if ( 0 == s_eppl )
+      return 0;
+
+   u8 uNonce[CHACHA20_POLY1305_NONCE_SIZE];
+   _encr_build_auth_nonce(uSenderId, pTrailer, uNonce);
+   return chacha20_poly1305_open(s_uEncAuthKey, uNonce, pAAD, iAADLength, pData, len, pTrailer + ENC_AUTH_NONCE_SIZE);
+}
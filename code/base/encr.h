@@ -6,6 +6,20 @@
 
 #define MAX_PASS_LENGTH 64
 
+// Radio packets encryption modes
+#define ENC_MODE_NONE 0
+#define ENC_MODE_OBFUSCATE 1
+#define ENC_MODE_AUTHENTICATED 2
+
+// Authenticated mode (ChaCha20-Poly1305) trailer added to the packets: nonce (session, counter) and tag
+#define ENC_AUTH_NONCE_SIZE 8
+#define ENC_AUTH_TAG_SIZE 16
+#define ENC_AUTH_TRAILER_SIZE (ENC_AUTH_NONCE_SIZE + ENC_AUTH_TAG_SIZE)
+
+#define ENC_IMPLEMENTATION_BYTES 0
+#define ENC_IMPLEMENTATION_WORDS 1
+#define ENC_IMPLEMENTATION_SIMD 2
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,14 +28,26 @@ extern "C" {
 // Load and saves pass phrases
 int lpp(char* szOutputBuffer, int maxLength);
 int spp(char* szBuffer);
+// Uses a pass phrase without saving it
+int upp(char* szBuffer);
 
 void rpp();
 u8* gpp(int* pLen);
 int hpp();
 
+// Selects the best implementation up to the one requested; returns the one selected
+int encr_set_implementation(int iImplementation);
+const char* encr_get_implementation_name();
+
 int epp(u8* pData, int len);
 int dpp(u8* pData, int len);
 
+// Authenticated mode: encrypts pData in place and writes ENC_AUTH_TRAILER_SIZE bytes to pTrailer;
+// pAAD is authenticated but not encrypted. uSenderId keeps the nonces of different senders apart.
+// dppa returns 1 and decrypts pData only if the data and pAAD are authentic.
+int eppa(u32 uSenderId, u8* pAAD, int iAADLength, u8* pData, int len, u8* pTrailer);
+int dppa(u32 uSenderId, u8* pAAD, int iAADLength, u8* pData, int len, const u8* pTrailer);
+
 #ifdef __cplusplus
 }  
 #endif 
\ No newline at end of file
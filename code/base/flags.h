@@ -50,6 +50,13 @@
 #define MODEL_ENC_FLAG_ENC_DATA   ((u32)(((u32)0x01)<<1))
 #define MODEL_ENC_FLAG_ENC_VIDEO  ((u32)(((u32)0x01)<<2))
 #define MODEL_ENC_FLAG_ENC_ALL    ((u32)(((u32)0x01)<<3))
+// Authenticated encryption (ChaCha20-Poly1305) instead of the pass phrase obfuscation, for all the streams (implies MODEL_ENC_FLAG_ENC_ALL).
+// Set with COMMAND_ID_SET_ENCRYPTION_PARAMS, from the vehicle radio menu encryption item (disabled for now).
+// The receivers then drop all the packets that are not authenticated (except the ones from a relayed vehicle, it has its own
+// settings), and the senders drop the packets the trailer does not fit in. A relay vehicle authenticates the packets it relays
+// only if it is in the authenticated mode itself, so a relayed vehicle in the authenticated mode needs its relay vehicle in it too.
+// There is no replay protection: a recorded authentic packet is accepted again if it is sent again.
+#define MODEL_ENC_FLAG_AUTHENTICATED ((u32)(((u32)0x01)<<4))
 
 // raspivid commands
 #define RASPIVID_COMMAND_ID_BRIGHTNESS 1
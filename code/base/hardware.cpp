@@ -1107,37 +1107,19 @@ int hardware_is_joystick_opened(int joystickIndex)
 // Returns the count of new events
 // Return -1 on error
 
-int hardware_read_joystick(int joystickIndex, int miliSec)
+#ifdef HW_PLATFORM_RASPBERRY
+// Reads all the joystick events available now, without blocking. Returns the count of button/axe events, or -1 on error
+static int _hardware_read_joystick_pending_events(int joystickIndex)
 {
-   if ((joystickIndex < 0) || (joystickIndex >= s_iHardwareJoystickCount) )
-      return -1;
-   if ( s_HardwareJoystickInfo[joystickIndex].deviceIndex < 0 )
-      return -1;
-   if ( (-1 == s_HardwareJoystickInfo[joystickIndex].fd) && (NULL == s_HardwareJoystickInfo[joystickIndex].pObject) )
-      return -1;
-
-   memcpy( &s_HardwareJoystickInfo[joystickIndex].buttonsValuesPrev, &s_HardwareJoystickInfo[joystickIndex].buttonsValues, MAX_JOYSTICK_BUTTONS*sizeof(int));
-   memcpy( &s_HardwareJoystickInfo[joystickIndex].axesValuesPrev, &s_HardwareJoystickInfo[joystickIndex].axesValues, MAX_JOYSTICK_AXES*sizeof(int));
-
-   #ifdef HW_PLATFORM_RASPBERRY
-   if ( -1 == s_HardwareJoystickInfo[joystickIndex].fd )
-      return -1;
-
    int countEvents = 0;
-   u32 timeStart = get_current_timestamp_micros();
-   u32 timeEnd = timeStart + miliSec*1000;
-   if ( timeEnd < timeStart )
-      timeEnd = timeStart;
-
-   while ( get_current_timestamp_micros() < timeEnd )
-   { 
-      hardware_sleep_micros(200);
+   while ( true )
+   {
       struct js_event joystickEvent[8];
       int iRead = read(s_HardwareJoystickInfo[joystickIndex].fd, &joystickEvent[0], sizeof(joystickEvent));
       if ( iRead == 0 )
-         continue;
+         break;
       if ( iRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) )
-         continue;
+         break;
       if ( iRead < 0 )
       {
          log_softerror_and_alarm("[Hardware] Error on reading joystick data, joystick index: %d, error: %d", joystickIndex, errno);
@@ -1160,6 +1142,46 @@ int hardware_read_joystick(int joystickIndex, int miliSec)
             countEvents++;
          }
       }
+      if ( iRead < (int)sizeof(joystickEvent) )
+         break;
+   }
+   return countEvents;
+}
+#endif
+
+int hardware_read_joystick(int joystickIndex, int miliSec)
+{
+   if ((joystickIndex < 0) || (joystickIndex >= s_iHardwareJoystickCount) )
+      return -1;
+   if ( s_HardwareJoystickInfo[joystickIndex].deviceIndex < 0 )
+      return -1;
+   if ( (-1 == s_HardwareJoystickInfo[joystickIndex].fd) && (NULL == s_HardwareJoystickInfo[joystickIndex].pObject) )
+      return -1;
+
+   memcpy( &s_HardwareJoystickInfo[joystickIndex].buttonsValuesPrev, &s_HardwareJoystickInfo[joystickIndex].buttonsValues, MAX_JOYSTICK_BUTTONS*sizeof(int));
+   memcpy( &s_HardwareJoystickInfo[joystickIndex].axesValuesPrev, &s_HardwareJoystickInfo[joystickIndex].axesValues, MAX_JOYSTICK_AXES*sizeof(int));
+
+   #ifdef HW_PLATFORM_RASPBERRY
+   if ( -1 == s_HardwareJoystickInfo[joystickIndex].fd )
+      return -1;
+
+   // No waiting: just read what is available now
+   if ( miliSec <= 0 )
+      return _hardware_read_joystick_pending_events(joystickIndex);
+
+   int countEvents = 0;
+   u32 timeStart = get_current_timestamp_micros();
+   u32 timeEnd = timeStart + miliSec*1000;
+   if ( timeEnd < timeStart )
+      timeEnd = timeStart;
+
+   while ( get_current_timestamp_micros() < timeEnd )
+   { 
+      hardware_sleep_micros(200);
+      int iCount = _hardware_read_joystick_pending_events(joystickIndex);
+      if ( iCount < 0 )
+         return -1;
+      countEvents += iCount;
    }
    return countEvents;
    #endif
@@ -1195,6 +1217,18 @@ int hardware_read_joystick(int joystickIndex, int miliSec)
    return -1;
 }
 
+// Fd that becomes readable when there are joystick events to read, or -1 if the joystick can only be polled (SDL)
+int hardware_get_joystick_wait_fd(int joystickIndex)
+{
+   if ((joystickIndex < 0) || (joystickIndex >= s_iHardwareJoystickCount) )
+      return -1;
+   #ifdef HW_PLATFORM_RASPBERRY
+   return s_HardwareJoystickInfo[joystickIndex].fd;
+   #else
+   return -1;
+   #endif
+}
+
 u16 hardware_get_flags()
 {
    u16 retValue = 0xFFFF;
@@ -120,7 +120,9 @@ int hardware_get_joystick_interfaces_count();
 hw_joystick_info_t* hardware_get_joystick_info(int index);
 int hardware_open_joystick(int joystickIndex);
 void hardware_close_joystick(int joystickIndex);
+// miliSec: how long to keep reading events; 0 just reads the events available now
 int hardware_read_joystick(int joystickIndex, int miliSec);
+int hardware_get_joystick_wait_fd(int joystickIndex);
 int hardware_is_joystick_opened(int joystickIndex);
 
 u16 hardware_get_flags();
@@ -50,6 +50,7 @@
 #include "hardware_radio.h"
 #include "hardware_serial.h"
 #include "hardware_radio_sik.h"
+#include "hardware_radio_nl80211.h"
 #include "hardware_procs.h"
 #include "../common/string_utils.h"
 
@@ -1035,84 +1036,112 @@ int _hardware_enumerate_wifi_radios()
       for( int kk=0; kk<(int)(sizeof(sRadioInfo[i].szProductId)/sizeof(sRadioInfo[i].szProductId[0])); kk++ )
          sRadioInfo[i].szProductId[kk] = 0;
 
-      // Find the MAC address
-      sprintf(szComm, "iw dev %s info | grep addr", sRadioInfo[i].szName );
-      if ( 1 != hw_execute_bash_command_raw(szComm, szBuff) )
-      {
-         log_softerror_and_alarm("Failed to find MAC address for %s", sRadioInfo[i].szName);
-      }
-      else if ( 1 != sscanf(szBuff, "%*s %s", szComm) )
+      // Find the MAC address and the physical interface number (phy#), using nl80211 if available
+
+      int iNLPhyIndex = -1;
+      u8 uNLMAC[6];
+      if ( 0 == hardware_radio_nl80211_get_interface_info(sRadioInfo[i].szName, &iNLPhyIndex, uNLMAC) )
       {
-         log_softerror_and_alarm("Failed to find MAC address for %s", sRadioInfo[i].szName);
+         sprintf(sRadioInfo[i].szMAC, "%02X%02X%02X%02X%02X%02X", uNLMAC[0], uNLMAC[1], uNLMAC[2], uNLMAC[3], uNLMAC[4], uNLMAC[5]);
+         sRadioInfo[i].phy_index = iNLPhyIndex;
+         log_line("Found MAC address %s and phy%d for %s (nl80211)", sRadioInfo[i].szMAC, sRadioInfo[i].phy_index, sRadioInfo[i].szName);
       }
       else
       {
-         log_line("Found MAC address %s for %s", szComm, sRadioInfo[i].szName);
-         szComm[MAX_MAC_LENGTH-1] = 0;
-         int iSt = 0;
-         int iEnd = 0;
-         while ( iEnd < (int)strlen(szComm) )
+         sprintf(szComm, "iw dev %s info | grep addr", sRadioInfo[i].szName );
+         if ( 1 != hw_execute_bash_command_raw(szComm, szBuff) )
          {
-            if ( szComm[iEnd] == ':' )
-               iEnd++;
-            else
+            log_softerror_and_alarm("Failed to find MAC address for %s", sRadioInfo[i].szName);
+         }
+         else if ( 1 != sscanf(szBuff, "%*s %s", szComm) )
+         {
+            log_softerror_and_alarm("Failed to find MAC address for %s", sRadioInfo[i].szName);
+         }
+         else
+         {
+            log_line("Found MAC address %s for %s", szComm, sRadioInfo[i].szName);
+            szComm[MAX_MAC_LENGTH-1] = 0;
+            int iSt = 0;
+            int iEnd = 0;
+            while ( iEnd < (int)strlen(szComm) )
             {
-               szComm[iSt] = toupper(szComm[iEnd]);
-               iSt++;
-               iEnd++;
+               if ( szComm[iEnd] == ':' )
+                  iEnd++;
+               else
+               {
+                  szComm[iSt] = toupper(szComm[iEnd]);
+                  iSt++;
+                  iEnd++;
+               }
             }
+            szComm[iSt] = 0;
+            strncpy(sRadioInfo[i].szMAC, szComm, MAX_MAC_LENGTH-1);
+            sRadioInfo[i].szMAC[MAX_MAC_LENGTH-1] = 0;
          }
-         szComm[iSt] = 0;
-         strncpy(sRadioInfo[i].szMAC, szComm, MAX_MAC_LENGTH-1);
-         sRadioInfo[i].szMAC[MAX_MAC_LENGTH-1] = 0;
-      }
 
-      // Find physical interface number, in form phy#0
+         // Find physical interface number, in form phy#0
 
-      sprintf(szComm, "iw dev | grep -B 1 %s", sRadioInfo[i].szName );
-      if ( 1 != hw_execute_bash_command_raw(szComm, szBuff) )
-      {
-         sRadioInfo[i].phy_index = i;
-         log_softerror_and_alarm("Failed to find physical interface index for %s", sRadioInfo[i].szName);
-      }
-      else if ( 1 != sscanf(szBuff, "%s", szComm) )
-      {
-         sRadioInfo[i].phy_index = i;
-         log_softerror_and_alarm("Failed to find physical interface index for %s", sRadioInfo[i].szName);
-      }
-      else
-      {
-         int iPhyStrLen = strlen(szComm);
-         log_line("phy string: [%s], length: %d", szComm, iPhyStrLen);
-         sRadioInfo[i].phy_index = szComm[iPhyStrLen-1] - '0';
-         if ( (iPhyStrLen > 2) && isdigit(szComm[iPhyStrLen-2]) )
+         sprintf(szComm, "iw dev | grep -B 1 %s", sRadioInfo[i].szName );
+         if ( 1 != hw_execute_bash_command_raw(szComm, szBuff) )
          {
-            sRadioInfo[i].phy_index = 10 * (szComm[iPhyStrLen-2] - '0') + sRadioInfo[i].phy_index;
+            sRadioInfo[i].phy_index = i;
+            log_softerror_and_alarm("Failed to find physical interface index for %s", sRadioInfo[i].szName);
+         }
+         else if ( 1 != sscanf(szBuff, "%s", szComm) )
+         {
+            sRadioInfo[i].phy_index = i;
+            log_softerror_and_alarm("Failed to find physical interface index for %s", sRadioInfo[i].szName);
+         }
+         else
+         {
+            int iPhyStrLen = strlen(szComm);
+            log_line("phy string: [%s], length: %d", szComm, iPhyStrLen);
+            sRadioInfo[i].phy_index = szComm[iPhyStrLen-1] - '0';
+            if ( (iPhyStrLen > 2) && isdigit(szComm[iPhyStrLen-2]) )
+            {
+               sRadioInfo[i].phy_index = 10 * (szComm[iPhyStrLen-2] - '0') + sRadioInfo[i].phy_index;
+            }
          }
       }
 
       // Check supported bands
 
       sRadioInfo[i].supportedBands = 0;
-      sprintf(szComm, "iw phy%d info | grep 2377", sRadioInfo[i].phy_index);
-      hw_execute_bash_command_raw(szComm, szBuff);
-      if ( 5 < strlen(szBuff) )
-        sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_23;
-
-      sprintf(szComm, "iw phy%d info | grep 2427", sRadioInfo[i].phy_index);
-      hw_execute_bash_command_raw(szComm, szBuff);
-      if ( 5 < strlen(szBuff) )
-        sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_24;
-
-      sprintf(szComm, "iw phy%d info | grep 2512", sRadioInfo[i].phy_index);
-      hw_execute_bash_command_raw(szComm, szBuff);
-      if ( 5 < strlen(szBuff) )
-        sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_25;
-
-      sprintf(szComm, "iw phy%d info | grep 5745", sRadioInfo[i].phy_index);
-      hw_execute_bash_command_raw(szComm, szBuff);
-      if ( 5 < strlen(szBuff) )
-        sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_58;
+      u32 uNLFrequencies[256];
+      int iNLFrequencies = hardware_radio_nl80211_get_phy_frequencies(sRadioInfo[i].phy_index, uNLFrequencies, 256);
+      for( int k=0; k<iNLFrequencies; k++ )
+      {
+         if ( uNLFrequencies[k] == 2377 )
+            sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_23;
+         if ( uNLFrequencies[k] == 2427 )
+            sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_24;
+         if ( uNLFrequencies[k] == 2512 )
+            sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_25;
+         if ( uNLFrequencies[k] == 5745 )
+            sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_58;
+      }
+      if ( iNLFrequencies <= 0 )
+      {
+         sprintf(szComm, "iw phy%d info | grep 2377", sRadioInfo[i].phy_index);
+         hw_execute_bash_command_raw(szComm, szBuff);
+         if ( 5 < strlen(szBuff) )
+           sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_23;
+
+         sprintf(szComm, "iw phy%d info | grep 2427", sRadioInfo[i].phy_index);
+         hw_execute_bash_command_raw(szComm, szBuff);
+         if ( 5 < strlen(szBuff) )
+           sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_24;
+
+         sprintf(szComm, "iw phy%d info | grep 2512", sRadioInfo[i].phy_index);
+         hw_execute_bash_command_raw(szComm, szBuff);
+         if ( 5 < strlen(szBuff) )
+           sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_25;
+
+         sprintf(szComm, "iw phy%d info | grep 5745", sRadioInfo[i].phy_index);
+         hw_execute_bash_command_raw(szComm, szBuff);
+         if ( 5 < strlen(szBuff) )
+           sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_58;
+      }
 
       if ( sRadioInfo[i].iRadioDriver == RADIO_HW_DRIVER_REALTEK_8812EU )
          sRadioInfo[i].supportedBands &= ~RADIO_HW_SUPPORTED_BAND_24;
@@ -1845,64 +1874,116 @@ void hardware_install_drivers(int iEchoToConsole)
 }
 
 
+static void _hardware_radio_wifi_execute_fallback(const char* szComm, const char* szIfName, int iNLResult)
+{
+   char szOutput[2048];
+   szOutput[0] = 0;
+   if ( -ENOSYS != iNLResult )
+      log_line("[HW-R] nl80211 operation failed on %s (error: %d), using command: [%s]", szIfName, iNLResult, szComm);
+   hw_execute_bash_command(szComm, szOutput);
+   if ( 0 != szOutput[0] )
+      log_softerror_and_alarm("[HW-R] Unexpected result: [%s]", szOutput);
+}
+
+int hardware_radio_wifi_set_link_up(const char* szIfName, int iUp)
+{
+   int iRes = hardware_radio_nl80211_set_link_up(szIfName, iUp);
+   if ( 0 == iRes )
+      return 1;
+   char szComm[128];
+   sprintf(szComm, "ip link set dev %s %s", szIfName, iUp?"up":"down");
+   _hardware_radio_wifi_execute_fallback(szComm, szIfName, iRes);
+   return 0;
+}
+
+int hardware_radio_wifi_set_type_monitor(const char* szIfName, int iMonitor)
+{
+   int iRes = 0;
+   if ( iMonitor )
+      iRes = hardware_radio_nl80211_set_type_monitor(szIfName);
+   else
+      iRes = hardware_radio_nl80211_set_type_managed(szIfName);
+   if ( 0 == iRes )
+      return 1;
+   char szComm[128];
+   sprintf(szComm, "iw dev %s set type %s", szIfName, iMonitor?"monitor":"managed");
+   _hardware_radio_wifi_execute_fallback(szComm, szIfName, iRes);
+   return 0;
+}
+
+int hardware_radio_wifi_set_monitor_flags(const char* szIfName, u32 uFlags)
+{
+   int iRes = hardware_radio_nl80211_set_monitor_flags(szIfName, uFlags);
+   if ( 0 == iRes )
+      return 1;
+   char szComm[128];
+   sprintf(szComm, "iw dev %s set monitor %s", szIfName, (uFlags & NL80211_MONITOR_FLAG_FCSFAIL)?"fcsfail":"none");
+   _hardware_radio_wifi_execute_fallback(szComm, szIfName, iRes);
+   return 0;
+}
+
+int hardware_radio_wifi_set_bitrates_2ghz(const char* szIfName, int iDataRateMb, int iForceLongGuardInterval)
+{
+   int iRes = hardware_radio_nl80211_set_bitrates_2ghz(szIfName, iDataRateMb, iForceLongGuardInterval);
+   if ( 0 == iRes )
+      return 1;
+   char szComm[128];
+   if ( iDataRateMb > 0 )
+      sprintf(szComm, "iw dev %s set bitrates legacy-2.4 %d%s", szIfName, iDataRateMb, iForceLongGuardInterval?" lgi-2.4":"");
+   else
+      sprintf(szComm, "iw dev %s set bitrates ht-mcs-2.4 %d%s", szIfName, -iDataRateMb-1, iForceLongGuardInterval?" lgi-2.4":"");
+   _hardware_radio_wifi_execute_fallback(szComm, szIfName, iRes);
+   return 0;
+}
+
+int hardware_radio_wifi_set_txpower_fixed(const char* szIfName, int iTxPowerMBm)
+{
+   int iRes = hardware_radio_nl80211_set_txpower_fixed(szIfName, iTxPowerMBm);
+   if ( 0 == iRes )
+      return 1;
+   char szComm[128];
+   sprintf(szComm, "iw dev %s set txpower fixed %d", szIfName, iTxPowerMBm);
+   _hardware_radio_wifi_execute_fallback(szComm, szIfName, iRes);
+   return 0;
+}
+
 int _configure_radio_interface_atheros(int iInterfaceIndex, radio_hw_info_t* pRadioHWInfo, u32 uDelayMS)
 {
    if ( (NULL == pRadioHWInfo) || (iInterfaceIndex < 0) || (iInterfaceIndex >= hardware_get_radio_interfaces_count()) )
       return 0;
 
-   char szComm[128];
-   char szOutput[2048];
-
    #ifdef HW_PLATFORM_OPENIPC_CAMERA
 
-   //sprintf(szComm, "iwconfig %s mode monitor", pRadioHWInfo->szName);
-   sprintf(szComm, "iw dev %s set type monitor", pRadioHWInfo->szName);
-   hw_execute_bash_command(szComm, NULL);
+   hardware_radio_wifi_set_type_monitor(pRadioHWInfo->szName, 1);
    hardware_sleep_ms(uDelayMS);
 
-   sprintf(szComm, "iw dev %s set monitor fcsfail", pRadioHWInfo->szName);
-   hw_execute_bash_command(szComm, szOutput);
+   hardware_radio_wifi_set_monitor_flags(pRadioHWInfo->szName, NL80211_MONITOR_FLAG_FCSFAIL);
    hardware_sleep_ms(uDelayMS);
 
-   //sprintf(szComm, "ifconfig %s up", pRadioHWInfo->szName );
-   sprintf(szComm, "ip link set dev %s up", pRadioHWInfo->szName );
-   hw_execute_bash_command(szComm, NULL);
+   hardware_radio_wifi_set_link_up(pRadioHWInfo->szName, 1);
    hardware_sleep_ms(uDelayMS);
 
    return 1;
    #endif
 
-   sprintf(szComm, "iw dev %s set monitor fcsfail", pRadioHWInfo->szName);
-   hw_execute_bash_command(szComm, szOutput);
+   hardware_radio_wifi_set_monitor_flags(pRadioHWInfo->szName, NL80211_MONITOR_FLAG_FCSFAIL);
    hardware_sleep_ms(uDelayMS);
 
-   sprintf(szComm, "ip link set dev %s up", pRadioHWInfo->szName );
-   hw_execute_bash_command(szComm, NULL);
+   hardware_radio_wifi_set_link_up(pRadioHWInfo->szName, 1);
    hardware_sleep_ms(uDelayMS);
    int dataRateMb = DEFAULT_RADIO_DATARATE_VIDEO_ATHEROS/1000/1000;
-   if ( dataRateMb > 0 )
-      sprintf(szComm, "iw dev %s set bitrates legacy-2.4 %d lgi-2.4", pRadioHWInfo->szName, dataRateMb );
-   else
-      sprintf(szComm, "iw dev %s set bitrates ht-mcs-2.4 %d lgi-2.4", pRadioHWInfo->szName, -dataRateMb-1 );
-   hw_execute_bash_command(szComm, NULL);
+   hardware_radio_wifi_set_bitrates_2ghz(pRadioHWInfo->szName, dataRateMb, 1);
    hardware_sleep_ms(uDelayMS);
-   //sprintf(szComm, "ifconfig %s down 2>&1", pRadioHWInfo->szName );
-   sprintf(szComm, "ip link set dev %s down", pRadioHWInfo->szName );
-   hw_execute_bash_command(szComm, NULL);
-   if ( 0 != szOutput[0] )
-      log_softerror_and_alarm("Unexpected result: [%s]", szOutput);
+   hardware_radio_wifi_set_link_up(pRadioHWInfo->szName, 0);
    hardware_sleep_ms(uDelayMS);
    
-   sprintf(szComm, "iw dev %s set monitor none", pRadioHWInfo->szName);
-   hw_execute_bash_command(szComm, NULL);
+   hardware_radio_wifi_set_monitor_flags(pRadioHWInfo->szName, 0);
    hardware_sleep_ms(uDelayMS);
 
-   sprintf(szComm, "iw dev %s set monitor fcsfail", pRadioHWInfo->szName);
-   hw_execute_bash_command(szComm, szOutput);
+   hardware_radio_wifi_set_monitor_flags(pRadioHWInfo->szName, NL80211_MONITOR_FLAG_FCSFAIL);
    hardware_sleep_ms(uDelayMS);
 
-   sprintf(szComm, "ip link set dev %s up", pRadioHWInfo->szName );
-   hw_execute_bash_command(szComm, NULL);
+   hardware_radio_wifi_set_link_up(pRadioHWInfo->szName, 1);
    hardware_sleep_ms(uDelayMS);
    
    pRadioHWInfo->iCurrentDataRateBPS = dataRateMb*1000*1000;
@@ -1915,47 +1996,36 @@ int _configure_radio_interface_realtek(int iInterfaceIndex, radio_hw_info_t* pRa
    if ( (NULL == pRadioHWInfo) || (iInterfaceIndex < 0) || (iInterfaceIndex >= hardware_get_radio_interfaces_count()) )
       return 0;
 
-   char szComm[128];
-   char szOutput[2048];
-
    #ifdef HW_PLATFORM_OPENIPC_CAMERA
    
-   sprintf(szComm, "ip link set dev %s up", pRadioHWInfo->szName );
-   hw_execute_bash_command(szComm, NULL);
+   hardware_radio_wifi_set_link_up(pRadioHWInfo->szName, 1);
    hardware_sleep_ms(uDelayMS);
 
-   sprintf(szComm, "iwconfig %s mode monitor", pRadioHWInfo->szName );
-   hw_execute_bash_command(szComm, NULL);
+   if ( 0 != hardware_radio_nl80211_set_type_monitor(pRadioHWInfo->szName) )
+   {
+      char szComm[128];
+      sprintf(szComm, "iwconfig %s mode monitor", pRadioHWInfo->szName );
+      hw_execute_bash_command(szComm, NULL);
+   }
    hardware_sleep_ms(uDelayMS);
 
-   sprintf(szComm, "iw dev %s set monitor fcsfail", pRadioHWInfo->szName);
-   hw_execute_bash_command(szComm, szOutput);
+   hardware_radio_wifi_set_monitor_flags(pRadioHWInfo->szName, NL80211_MONITOR_FLAG_FCSFAIL);
    hardware_sleep_ms(uDelayMS);
    
    return 1;
 
    #endif
 
-   sprintf(szComm, "ip link set dev %s down", pRadioHWInfo->szName );
-   hw_execute_bash_command(szComm, szOutput);
-   if ( 0 != szOutput[0] )
-      log_softerror_and_alarm("[HW-R] Unexpected result: [%s]", szOutput);
+   hardware_radio_wifi_set_link_up(pRadioHWInfo->szName, 0);
    hardware_sleep_ms(uDelayMS);
 
-   sprintf(szComm, "iw dev %s set monitor none 2>&1", pRadioHWInfo->szName);
-   hw_execute_bash_command(szComm, szOutput);
-   if ( 0 != szOutput[0] )
-      log_softerror_and_alarm("Unexpected result: [%s]", szOutput);
+   hardware_radio_wifi_set_monitor_flags(pRadioHWInfo->szName, 0);
    hardware_sleep_ms(uDelayMS);
 
-   sprintf(szComm, "iw dev %s set monitor fcsfail", pRadioHWInfo->szName);
-   hw_execute_bash_command(szComm, szOutput);
+   hardware_radio_wifi_set_monitor_flags(pRadioHWInfo->szName, NL80211_MONITOR_FLAG_FCSFAIL);
    hardware_sleep_ms(uDelayMS);
 
-   sprintf(szComm, "ip link set dev %s up", pRadioHWInfo->szName );
-   hw_execute_bash_command(szComm, szOutput);
-   if ( 0 != szOutput[0] )
-      log_softerror_and_alarm("Unexpected result: [%s]", szOutput);
+   hardware_radio_wifi_set_link_up(pRadioHWInfo->szName, 1);
    hardware_sleep_ms(uDelayMS);
 
    return 1;
@@ -211,6 +211,14 @@ int hardware_install_driver_rtl8733bu(int iEchoToConsole);
 void hardware_install_drivers(int iEchoToConsole);
 int hardware_initialize_radio_interface(int iInterfaceIndex, u32 uDelayMS);
 
+// Wifi interfaces configuration: done in-process using nl80211, with iw/ip commands as fallback.
+// Return 1 if done using nl80211, 0 if the fallback command was used.
+int hardware_radio_wifi_set_link_up(const char* szIfName, int iUp);
+int hardware_radio_wifi_set_type_monitor(const char* szIfName, int iMonitor);
+int hardware_radio_wifi_set_monitor_flags(const char* szIfName, u32 uFlags);
+int hardware_radio_wifi_set_bitrates_2ghz(const char* szIfName, int iDataRateMb, int iForceLongGuardInterval);
+int hardware_radio_wifi_set_txpower_fixed(const char* szIfName, int iTxPowerMBm);
+
 int hardware_radio_get_driver_id_card_model(int iCardModel);
 
 int hardware_get_radio_interfaces_count();
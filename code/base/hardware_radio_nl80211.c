@@ -0,0 +1,549 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+         * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+       * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+#include <linux/nl80211.h>
+#include "base.h"
+#include "hardware_radio_nl80211.h"
+
+#define NL80211_MSG_BUFFER_SIZE 1024
+#define NL80211_RECV_BUFFER_SIZE 32768
+#define NL80211_RECV_TIMEOUT_MS 1000
+
+typedef struct
+{
+   u32 uBuffer[NL80211_MSG_BUFFER_SIZE/4];
+   int iOverflow;
+} t_nl80211_message;
+
+typedef void (*t_nl80211_message_callback)(struct nlmsghdr* pNLH, void* pContext);
+
+static int s_iNL80211Socket = -1;
+static int s_iNL80211FamilyId = -1;
+static int s_iNL80211InitTried = 0;
+static u32 s_uNL80211Sequence = 0;
+static u32 s_uNL80211RecvBuffer[NL80211_RECV_BUFFER_SIZE/4];
+static pthread_mutex_t s_MutexNL80211 = PTHREAD_MUTEX_INITIALIZER;
+
+static void _nl80211_msg_init(t_nl80211_message* pMsg, u16 uFamily, u16 uFlags, u8 uCommand)
+{
+   memset(pMsg, 0, sizeof(t_nl80211_message));
+   struct nlmsghdr* pNLH = (struct nlmsghdr*)pMsg->uBuffer;
+   pNLH->nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+   pNLH->nlmsg_type = uFamily;
+   pNLH->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | uFlags;
+   pNLH->nlmsg_seq = ++s_uNL80211Sequence;
+   struct genlmsghdr* pGenHdr = (struct genlmsghdr*)NLMSG_DATA(pNLH);
+   pGenHdr->cmd = uCommand;
+   pGenHdr->version = 1;
+}
+
+static struct nlattr* _nl80211_msg_put(t_nl80211_message* pMsg, u16 uType, const void* pData, int iLength)
+{
+   struct nlmsghdr* pNLH = (struct nlmsghdr*)pMsg->uBuffer;
+   int iPos = NLMSG_ALIGN(pNLH->nlmsg_len);
+   if ( iPos + NLA_ALIGN(NLA_HDRLEN + iLength) > (int)sizeof(pMsg->uBuffer) )
+   {
+      pMsg->iOverflow = 1;
+      return NULL;
+   }
+   struct nlattr* pAttr = (struct nlattr*)((u8*)pMsg->uBuffer + iPos);
+   pAttr->nla_type = uType;
+   pAttr->nla_len = NLA_HDRLEN + iLength;
+   if ( iLength > 0 )
+      memcpy((u8*)pAttr + NLA_HDRLEN, pData, iLength);
+   pNLH->nlmsg_len = iPos + NLA_ALIGN(NLA_HDRLEN + iLength);
+   return pAttr;
+}
+
+static void _nl80211_msg_put_u32(t_nl80211_message* pMsg, u16 uType, u32 uValue)
+{
+   _nl80211_msg_put(pMsg, uType, &uValue, sizeof(u32));
+}
+
+static struct nlattr* _nl80211_msg_nest_start(t_nl80211_message* pMsg, u16 uType)
+{
+   return _nl80211_msg_put(pMsg, uType | NLA_F_NESTED, NULL, 0);
+}
+
+static void _nl80211_msg_nest_end(t_nl80211_message* pMsg, struct nlattr* pNest)
+{
+   if ( NULL == pNest )
+      return;
+   struct nlmsghdr* pNLH = (struct nlmsghdr*)pMsg->uBuffer;
+   pNest->nla_len = (u16)(((u8*)pMsg->uBuffer + pNLH->nlmsg_len) - (u8*)pNest);
+}
+
+// Fills pTable[type] with the attributes found in the given attributes stream
+static void _nl80211_parse_attrs(struct nlattr* pAttr, int iLength, struct nlattr** pTable, int iMaxType)
+{
+   memset(pTable, 0, (iMaxType+1) * sizeof(struct nlattr*));
+   while ( (iLength >= NLA_HDRLEN) && (pAttr->nla_len >= NLA_HDRLEN) && (pAttr->nla_len <= iLength) )
+   {
+      int iType = pAttr->nla_type & NLA_TYPE_MASK;
+      if ( iType <= iMaxType )
+         pTable[iType] = pAttr;
+      iLength -= NLA_ALIGN(pAttr->nla_len);
+      pAttr = (struct nlattr*)((u8*)pAttr + NLA_ALIGN(pAttr->nla_len));
+   }
+}
+
+static void _nl80211_parse_message(struct nlmsghdr* pNLH, struct nlattr** pTable, int iMaxType)
+{
+   struct nlattr* pAttr = (struct nlattr*)((u8*)NLMSG_DATA(pNLH) + GENL_HDRLEN);
+   _nl80211_parse_attrs(pAttr, (int)pNLH->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN), pTable, iMaxType);
+}
+
+static void* _nl80211_attr_data(struct nlattr* pAttr)
+{
+   return (u8*)pAttr + NLA_HDRLEN;
+}
+
+static int _nl80211_attr_length(struct nlattr* pAttr)
+{
+   return pAttr->nla_len - NLA_HDRLEN;
+}
+
+static u32 _nl80211_attr_u32(struct nlattr* pAttr)
+{
+   u32 uValue = 0;
+   if ( _nl80211_attr_length(pAttr) >= (int)sizeof(u32) )
+      memcpy(&uValue, _nl80211_attr_data(pAttr), sizeof(u32));
+   return uValue;
+}
+
+// Sends the message and waits for the kernel ack (or the end of the dump)
+// Returns 0 on success or a negative errno value. Must be called with the mutex locked.
+
+static int _nl80211_transact(t_nl80211_message* pMsg, t_nl80211_message_callback pCallback, void* pContext)
+{
+   if ( s_iNL80211Socket < 0 )
+      return -ENOTCONN;
+   if ( pMsg->iOverflow )
+      return -EMSGSIZE;
+
+   struct nlmsghdr* pNLH = (struct nlmsghdr*)pMsg->uBuffer;
+   u32 uSequence = pNLH->nlmsg_seq;
+   if ( send(s_iNL80211Socket, pMsg->uBuffer, pNLH->nlmsg_len, 0) < 0 )
+      return -errno;
+
+   while ( 1 )
+   {
+      int iRead = recv(s_iNL80211Socket, s_uNL80211RecvBuffer, sizeof(s_uNL80211RecvBuffer), 0);
+      if ( iRead < 0 )
+      {
+         if ( (errno == EAGAIN) || (errno == EWOULDBLOCK) )
+            return -ETIMEDOUT;
+         if ( errno == EINTR )
+            continue;
+         return -errno;
+      }
+
+      for( struct nlmsghdr* pRecv = (struct nlmsghdr*)s_uNL80211RecvBuffer; NLMSG_OK(pRecv, (u32)iRead); pRecv = NLMSG_NEXT(pRecv, iRead) )
+      {
+         // Late answers to previous (timed out) requests
+         if ( pRecv->nlmsg_seq != uSequence )
+            continue;
+         if ( pRecv->nlmsg_type == NLMSG_ERROR )
+         {
+            struct nlmsgerr* pError = (struct nlmsgerr*)NLMSG_DATA(pRecv);
+            return pError->error;
+         }
+         if ( pRecv->nlmsg_type == NLMSG_DONE )
+            return 0;
+         if ( NULL != pCallback )
+            pCallback(pRecv, pContext);
+      }
+   }
+   return 0;
+}
+
+static void _nl80211_family_callback(struct nlmsghdr* pNLH, void* pContext)
+{
+   struct nlattr* pTable[CTRL_ATTR_MAX+1];
+   _nl80211_parse_message(pNLH, pTable, CTRL_ATTR_MAX);
+   if ( NULL != pTable[CTRL_ATTR_FAMILY_ID] )
+      *((int*)pContext) = *((u16*)_nl80211_attr_data(pTable[CTRL_ATTR_FAMILY_ID]));
+}
+
+int hardware_radio_nl80211_init()
+{
+   pthread_mutex_lock(&s_MutexNL80211);
+   s_iNL80211InitTried = 1;
+   if ( (s_iNL80211Socket >= 0) && (s_iNL80211FamilyId >= 0) )
+   {
+      pthread_mutex_unlock(&s_MutexNL80211);
+      return 1;
+   }
+
+   s_iNL80211Socket = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+   if ( s_iNL80211Socket < 0 )
+   {
+      log_softerror_and_alarm("[HW-R] nl80211: Failed to create generic netlink socket, error: %d (%s)", errno, strerror(errno));
+      pthread_mutex_unlock(&s_MutexNL80211);
+      return 0;
+   }
+
+   struct sockaddr_nl addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.nl_family = AF_NETLINK;
+   if ( bind(s_iNL80211Socket, (struct sockaddr*)&addr, sizeof(addr)) < 0 )
+   {
+      log_softerror_and_alarm("[HW-R] nl80211: Failed to bind generic netlink socket, error: %d (%s)", errno, strerror(errno));
+      close(s_iNL80211Socket);
+      s_iNL80211Socket = -1;
+      pthread_mutex_unlock(&s_MutexNL80211);
+      return 0;
+   }
+
+   struct timeval tv;
+   tv.tv_sec = 0;
+   tv.tv_usec = NL80211_RECV_TIMEOUT_MS*1000;
+   setsockopt(s_iNL80211Socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+   t_nl80211_message msg;
+   _nl80211_msg_init(&msg, GENL_ID_CTRL, 0, CTRL_CMD_GETFAMILY);
+   _nl80211_msg_put(&msg, CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME, strlen(NL80211_GENL_NAME)+1);
+   int iFamilyId = -1;
+   int iRes = _nl80211_transact(&msg, _nl80211_family_callback, &iFamilyId);
+   if ( (iRes < 0) || (iFamilyId < 0) )
+   {
+      log_softerror_and_alarm("[HW-R] nl80211: Failed to resolve nl80211 generic netlink family, error: %d", iRes);
+      close(s_iNL80211Socket);
+      s_iNL80211Socket = -1;
+      pthread_mutex_unlock(&s_MutexNL80211);
+      return 0;
+   }
+   s_iNL80211FamilyId = iFamilyId;
+   pthread_mutex_unlock(&s_MutexNL80211);
+   log_line("[HW-R] nl80211: Opened generic netlink socket, nl80211 family id: %d", s_iNL80211FamilyId);
+   return 1;
+}
+
+void hardware_radio_nl80211_close()
+{
+   pthread_mutex_lock(&s_MutexNL80211);
+   if ( s_iNL80211Socket >= 0 )
+      close(s_iNL80211Socket);
+   s_iNL80211Socket = -1;
+   s_iNL80211FamilyId = -1;
+   s_iNL80211InitTried = 0;
+   pthread_mutex_unlock(&s_MutexNL80211);
+}
+
+int hardware_radio_nl80211_is_available()
+{
+   if ( (s_iNL80211Socket >= 0) && (s_iNL80211FamilyId >= 0) )
+      return 1;
+   if ( s_iNL80211InitTried )
+      return 0;
+   return hardware_radio_nl80211_init();
+}
+
+// Builds and sends a command for a network interface, returns 0 or negative errno
+
+static int _nl80211_interface_command_begin(t_nl80211_message* pMsg, const char* szIfName, u8 uCommand, u16 uFlags)
+{
+   if ( (NULL == szIfName) || (0 == szIfName[0]) )
+      return -EINVAL;
+   if ( ! hardware_radio_nl80211_is_available() )
+      return -ENOSYS;
+   u32 uIfIndex = if_nametoindex(szIfName);
+   if ( 0 == uIfIndex )
+      return -ENODEV;
+   _nl80211_msg_init(pMsg, (u16)s_iNL80211FamilyId, uFlags, uCommand);
+   _nl80211_msg_put_u32(pMsg, NL80211_ATTR_IFINDEX, uIfIndex);
+   return 0;
+}
+
+static int _nl80211_execute(t_nl80211_message* pMsg, t_nl80211_message_callback pCallback, void* pContext)
+{
+   pthread_mutex_lock(&s_MutexNL80211);
+   // Sequence number is assigned under the lock, so concurrent callers don't mix answers
+   ((struct nlmsghdr*)pMsg->uBuffer)->nlmsg_seq = ++s_uNL80211Sequence;
+   int iRes = _nl80211_transact(pMsg, pCallback, pContext);
+   pthread_mutex_unlock(&s_MutexNL80211);
+   return iRes;
+}
+
+int hardware_radio_nl80211_set_link_up(const char* szIfName, int iUp)
+{
+   if ( (NULL == szIfName) || (0 == szIfName[0]) )
+      return -EINVAL;
+   int iSocket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+   if ( iSocket < 0 )
+      return -errno;
+
+   struct ifreq ifr;
+   memset(&ifr, 0, sizeof(ifr));
+   strncpy(ifr.ifr_name, szIfName, IFNAMSIZ-1);
+   int iRes = 0;
+   if ( ioctl(iSocket, SIOCGIFFLAGS, &ifr) < 0 )
+      iRes = -errno;
+   else
+   {
+      if ( iUp )
+         ifr.ifr_flags |= IFF_UP;
+      else
+         ifr.ifr_flags &= ~IFF_UP;
+      if ( ioctl(iSocket, SIOCSIFFLAGS, &ifr) < 0 )
+         iRes = -errno;
+   }
+   close(iSocket);
+   return iRes;
+}
+
+int hardware_radio_nl80211_set_frequency(const char* szIfName, u32 uFrequencyMhz, int iHT40Plus)
+{
+   t_nl80211_message msg;
+   int iRes = _nl80211_interface_command_begin(&msg, szIfName, NL80211_CMD_SET_WIPHY, 0);
+   if ( iRes < 0 )
+      return iRes;
+   _nl80211_msg_put_u32(&msg, NL80211_ATTR_WIPHY_FREQ, uFrequencyMhz);
+   _nl80211_msg_put_u32(&msg, NL80211_ATTR_WIPHY_CHANNEL_TYPE, iHT40Plus?NL80211_CHAN_HT40PLUS:NL80211_CHAN_NO_HT);
+   return _nl80211_execute(&msg, NULL, NULL);
+}
+
+int hardware_radio_nl80211_set_txpower_fixed(const char* szIfName, int iTxPowerMBm)
+{
+   t_nl80211_message msg;
+   int iRes = _nl80211_interface_command_begin(&msg, szIfName, NL80211_CMD_SET_WIPHY, 0);
+   if ( iRes < 0 )
+      return iRes;
+   _nl80211_msg_put_u32(&msg, NL80211_ATTR_WIPHY_TX_POWER_SETTING, NL80211_TX_POWER_FIXED);
+   // Some drivers use negative values for raw power levels, same as iw does
+   _nl80211_msg_put_u32(&msg, NL80211_ATTR_WIPHY_TX_POWER_LEVEL, (u32)iTxPowerMBm);
+   return _nl80211_execute(&msg, NULL, NULL);
+}
+
+static int _nl80211_set_interface_type(const char* szIfName, u32 uType)
+{
+   t_nl80211_message msg;
+   int iRes = _nl80211_interface_command_begin(&msg, szIfName, NL80211_CMD_SET_INTERFACE, 0);
+   if ( iRes < 0 )
+      return iRes;
+   _nl80211_msg_put_u32(&msg, NL80211_ATTR_IFTYPE, uType);
+   return _nl80211_execute(&msg, NULL, NULL);
+}
+
+int hardware_radio_nl80211_set_type_monitor(const char* szIfName)
+{
+   return _nl80211_set_interface_type(szIfName, NL80211_IFTYPE_MONITOR);
+}
+
+int hardware_radio_nl80211_set_type_managed(const char* szIfName)
+{
+   return _nl80211_set_interface_type(szIfName, NL80211_IFTYPE_STATION);
+}
+
+int hardware_radio_nl80211_set_monitor_flags(const char* szIfName, u32 uFlags)
+{
+   t_nl80211_message msg;
+   int iRes = _nl80211_interface_command_begin(&msg, szIfName, NL80211_CMD_SET_INTERFACE, 0);
+   if ( iRes < 0 )
+      return iRes;
+   _nl80211_msg_put_u32(&msg, NL80211_ATTR_IFTYPE, NL80211_IFTYPE_MONITOR);
+   struct nlattr* pNest = _nl80211_msg_nest_start(&msg, NL80211_ATTR_MNTR_FLAGS);
+   if ( uFlags & NL80211_MONITOR_FLAG_FCSFAIL )
+      _nl80211_msg_put(&msg, NL80211_MNTR_FLAG_FCSFAIL, NULL, 0);
+   if ( uFlags & NL80211_MONITOR_FLAG_PLCPFAIL )
+      _nl80211_msg_put(&msg, NL80211_MNTR_FLAG_PLCPFAIL, NULL, 0);
+   if ( uFlags & NL80211_MONITOR_FLAG_CONTROL )
+      _nl80211_msg_put(&msg, NL80211_MNTR_FLAG_CONTROL, NULL, 0);
+   if ( uFlags & NL80211_MONITOR_FLAG_OTHER_BSS )
+      _nl80211_msg_put(&msg, NL80211_MNTR_FLAG_OTHER_BSS, NULL, 0);
+   _nl80211_msg_nest_end(&msg, pNest);
+   return _nl80211_execute(&msg, NULL, NULL);
+}
+
+int hardware_radio_nl80211_set_bitrates_2ghz(const char* szIfName, int iDataRateMb, int iForceLongGuardInterval)
+{
+   t_nl80211_message msg;
+   int iRes = _nl80211_interface_command_begin(&msg, szIfName, NL80211_CMD_SET_TX_BITRATE_MASK, 0);
+   if ( iRes < 0 )
+      return iRes;
+
+   struct nlattr* pNestRates = _nl80211_msg_nest_start(&msg, NL80211_ATTR_TX_RATES);
+   struct nlattr* pNestBand = _nl80211_msg_nest_start(&msg, NL80211_BAND_2GHZ);
+   if ( iDataRateMb > 0 )
+   {
+      // Legacy rates are in units of 500 kbps
+      u8 uRate = (u8)(iDataRateMb*2);
+      _nl80211_msg_put(&msg, NL80211_TXRATE_LEGACY, &uRate, 1);
+   }
+   else
+   {
+      u8 uMCS = (u8)(-iDataRateMb-1);
+      _nl80211_msg_put(&msg, NL80211_TXRATE_HT, &uMCS, 1);
+   }
+   if ( iForceLongGuardInterval )
+   {
+      u8 uGI = NL80211_TXRATE_FORCE_LGI;
+      _nl80211_msg_put(&msg, NL80211_TXRATE_GI, &uGI, 1);
+   }
+   _nl80211_msg_nest_end(&msg, pNestBand);
+   _nl80211_msg_nest_end(&msg, pNestRates);
+   return _nl80211_execute(&msg, NULL, NULL);
+}
+
+typedef struct
+{
+   int iPhyIndex;
+   u8 uMAC[6];
+   int iFound;
+} t_nl80211_interface_info;
+
+static void _nl80211_interface_info_callback(struct nlmsghdr* pNLH, void* pContext)
+{
+   t_nl80211_interface_info* pInfo = (t_nl80211_interface_info*)pContext;
+   struct nlattr* pTable[NL80211_ATTR_MAX+1];
+   _nl80211_parse_message(pNLH, pTable, NL80211_ATTR_MAX);
+   if ( NULL != pTable[NL80211_ATTR_WIPHY] )
+   {
+      pInfo->iPhyIndex = (int)_nl80211_attr_u32(pTable[NL80211_ATTR_WIPHY]);
+      pInfo->iFound = 1;
+   }
+   if ( (NULL != pTable[NL80211_ATTR_MAC]) && (_nl80211_attr_length(pTable[NL80211_ATTR_MAC]) >= 6) )
+      memcpy(pInfo->uMAC, _nl80211_attr_data(pTable[NL80211_ATTR_MAC]), 6);
+}
+
+int hardware_radio_nl80211_get_interface_info(const char* szIfName, int* piPhyIndex, u8* pMAC)
+{
+   t_nl80211_message msg;
+   int iRes = _nl80211_interface_command_begin(&msg, szIfName, NL80211_CMD_GET_INTERFACE, 0);
+   if ( iRes < 0 )
+      return iRes;
+
+   t_nl80211_interface_info info;
+   memset(&info, 0, sizeof(info));
+   iRes = _nl80211_execute(&msg, _nl80211_interface_info_callback, &info);
+   if ( iRes < 0 )
+      return iRes;
+   if ( ! info.iFound )
+      return -ENODATA;
+   if ( NULL != piPhyIndex )
+      *piPhyIndex = info.iPhyIndex;
+   if ( NULL != pMAC )
+      memcpy(pMAC, info.uMAC, 6);
+   return 0;
+}
+
+typedef struct
+{
+   int iPhyIndex;
+   u32* puFrequencies;
+   int iMaxFrequencies;
+   int iCount;
+} t_nl80211_phy_frequencies;
+
+static void _nl80211_phy_frequencies_callback(struct nlmsghdr* pNLH, void* pContext)
+{
+   t_nl80211_phy_frequencies* pInfo = (t_nl80211_phy_frequencies*)pContext;
+   struct nlattr* pTable[NL80211_ATTR_MAX+1];
+   _nl80211_parse_message(pNLH, pTable, NL80211_ATTR_MAX);
+   if ( (NULL == pTable[NL80211_ATTR_WIPHY]) || ((int)_nl80211_attr_u32(pTable[NL80211_ATTR_WIPHY]) != pInfo->iPhyIndex) )
+      return;
+   if ( NULL == pTable[NL80211_ATTR_WIPHY_BANDS] )
+      return;
+
+   // Bands -> band -> frequencies -> frequency -> attributes
+   struct nlattr* pBand = (struct nlattr*)_nl80211_attr_data(pTable[NL80211_ATTR_WIPHY_BANDS]);
+   int iBandsLength = _nl80211_attr_length(pTable[NL80211_ATTR_WIPHY_BANDS]);
+   while ( (iBandsLength >= NLA_HDRLEN) && (pBand->nla_len >= NLA_HDRLEN) && (pBand->nla_len <= iBandsLength) )
+   {
+      struct nlattr* pBandTable[NL80211_BAND_ATTR_MAX+1];
+      _nl80211_parse_attrs((struct nlattr*)_nl80211_attr_data(pBand), _nl80211_attr_length(pBand), pBandTable, NL80211_BAND_ATTR_MAX);
+      if ( NULL != pBandTable[NL80211_BAND_ATTR_FREQS] )
+      {
+         struct nlattr* pFreq = (struct nlattr*)_nl80211_attr_data(pBandTable[NL80211_BAND_ATTR_FREQS]);
+         int iFreqsLength = _nl80211_attr_length(pBandTable[NL80211_BAND_ATTR_FREQS]);
+         while ( (iFreqsLength >= NLA_HDRLEN) && (pFreq->nla_len >= NLA_HDRLEN) && (pFreq->nla_len <= iFreqsLength) )
+         {
+            struct nlattr* pFreqTable[NL80211_FREQUENCY_ATTR_MAX+1];
+            _nl80211_parse_attrs((struct nlattr*)_nl80211_attr_data(pFreq), _nl80211_attr_length(pFreq), pFreqTable, NL80211_FREQUENCY_ATTR_MAX);
+            if ( NULL != pFreqTable[NL80211_FREQUENCY_ATTR_FREQ] )
+            {
+               u32 uFreq = _nl80211_attr_u32(pFreqTable[NL80211_FREQUENCY_ATTR_FREQ]);
+               int iExists = 0;
+               for( int i=0; i<pInfo->iCount; i++ )
+               {
+                  if ( pInfo->puFrequencies[i] == uFreq )
+                  {
+                     iExists = 1;
+                     break;
+                  }
+               }
+               if ( (! iExists) && (pInfo->iCount < pInfo->iMaxFrequencies) )
+               {
+                  pInfo->puFrequencies[pInfo->iCount] = uFreq;
+                  pInfo->iCount++;
+               }
+            }
+            iFreqsLength -= NLA_ALIGN(pFreq->nla_len);
+            pFreq = (struct nlattr*)((u8*)pFreq + NLA_ALIGN(pFreq->nla_len));
+         }
+      }
+      iBandsLength -= NLA_ALIGN(pBand->nla_len);
+      pBand = (struct nlattr*)((u8*)pBand + NLA_ALIGN(pBand->nla_len));
+   }
+}
+
+int hardware_radio_nl80211_get_phy_frequencies(int iPhyIndex, u32* puFrequenciesMhz, int iMaxFrequencies)
+{
+   if ( (iPhyIndex < 0) || (NULL == puFrequenciesMhz) || (iMaxFrequencies <= 0) )
+      return -EINVAL;
+   if ( ! hardware_radio_nl80211_is_available() )
+      return -ENOSYS;
+
+   t_nl80211_message msg;
+   _nl80211_msg_init(&msg, (u16)s_iNL80211FamilyId, NLM_F_DUMP, NL80211_CMD_GET_WIPHY);
+   _nl80211_msg_put_u32(&msg, NL80211_ATTR_WIPHY, (u32)iPhyIndex);
+   _nl80211_msg_put(&msg, NL80211_ATTR_SPLIT_WIPHY_DUMP, NULL, 0);
+
+   t_nl80211_phy_frequencies info;
+   info.iPhyIndex = iPhyIndex;
+   info.puFrequencies = puFrequenciesMhz;
+   info.iMaxFrequencies = iMaxFrequencies;
+   info.iCount = 0;
+   int iRes = _nl80211_execute(&msg, _nl80211_phy_frequencies_callback, &info);
+   if ( iRes < 0 )
+      return iRes;
+   return info.iCount;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "../base/base.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// In-process nl80211 (generic netlink) control of the wifi radio interfaces.
+// Replaces the iw/ip shell-outs on the time critical paths (frequency switching, tx power).
+// All set/get functions return 0 on success or a negative errno value on failure,
+// so the callers can fall back to the iw/iwconfig commands for drivers that don't support nl80211.
+
+#define NL80211_MONITOR_FLAG_FCSFAIL 0x01
+#define NL80211_MONITOR_FLAG_PLCPFAIL 0x02
+#define NL80211_MONITOR_FLAG_CONTROL 0x04
+#define NL80211_MONITOR_FLAG_OTHER_BSS 0x08
+
+int hardware_radio_nl80211_init();
+void hardware_radio_nl80211_close();
+int hardware_radio_nl80211_is_available();
+
+int hardware_radio_nl80211_set_link_up(const char* szIfName, int iUp);
+int hardware_radio_nl80211_set_frequency(const char* szIfName, u32 uFrequencyMhz, int iHT40Plus);
+// Same as "iw dev x set txpower fixed <mbm>"
+int hardware_radio_nl80211_set_txpower_fixed(const char* szIfName, int iTxPowerMBm);
+int hardware_radio_nl80211_set_type_monitor(const char* szIfName);
+int hardware_radio_nl80211_set_type_managed(const char* szIfName);
+// uFlags: NL80211_MONITOR_FLAG_xxx, 0 for none
+int hardware_radio_nl80211_set_monitor_flags(const char* szIfName, u32 uFlags);
+// Same as "iw dev x set bitrates legacy-2.4 <mbps>" for positive datarates
+// and "iw dev x set bitrates ht-mcs-2.4 <-datarate-1>" for negative (MCS) datarates
+int hardware_radio_nl80211_set_bitrates_2ghz(const char* szIfName, int iDataRateMb, int iForceLongGuardInterval);
+
+// pMAC: 6 bytes
+int hardware_radio_nl80211_get_interface_info(const char* szIfName, int* piPhyIndex, u8* pMAC);
+// Returns the number of frequencies (in Mhz) supported by the phy (including disabled ones), or a negative errno value
+int hardware_radio_nl80211_get_phy_frequencies(int iPhyIndex, u32* puFrequenciesMhz, int iMaxFrequencies);
+
+#ifdef __cplusplus
+}
+#endif
@@ -6,11 +6,10 @@
 
 void hardware_radio_set_txpower_raw_rtl8812au(int iCardIndex, int iTxPower)
 {
-   log_line("Setting radio interface %d RTL8812AU raw tx power to %d using iw dev...", iCardIndex+1, iTxPower);
+   log_line("Setting radio interface %d RTL8812AU raw tx power to %d using nl80211...", iCardIndex+1, iTxPower);
    if ( (iTxPower < 1) || (iTxPower > MAX_TX_POWER) )
       iTxPower = DEFAULT_RADIO_TX_POWER;
 
-   char szComm[256];
    for( int i=0; i<hardware_get_radio_interfaces_count(); i++ )
    {
       if ( (iCardIndex != -1) && (iCardIndex != i) )
@@ -22,9 +21,7 @@ void hardware_radio_set_txpower_raw_rtl8812au(int iCardIndex, int iTxPower)
       if ( (hardware_radio_driver_is_rtl8812au_card(pRadioHWInfo->iRadioDriver)) ||
            (pRadioHWInfo->iRadioType == RADIO_TYPE_RALINK) )
       {
-         sprintf(szComm, "iw dev %s set txpower fixed %d", pRadioHWInfo->szName, -100*iTxPower);
-         //hw_execute_process_wait(szComm);
-         hw_execute_bash_command(szComm, NULL);
+         hardware_radio_wifi_set_txpower_fixed(pRadioHWInfo->szName, -100*iTxPower);
       }
    }
 
@@ -37,7 +34,6 @@ void hardware_radio_set_txpower_raw_rtl8812eu(int iCardIndex, int iTxPower)
    if ( (iTxPower < 1) || (iTxPower > MAX_TX_POWER) )
       iTxPower = DEFAULT_RADIO_TX_POWER;
 
-   char szComm[256];
    for( int i=0; i<hardware_get_radio_interfaces_count(); i++ )
    {
       if ( (iCardIndex != -1) && (iCardIndex != i) )
@@ -47,8 +43,7 @@ void hardware_radio_set_txpower_raw_rtl8812eu(int iCardIndex, int iTxPower)
          continue;
       if ( hardware_radio_driver_is_rtl8812eu_card(pRadioHWInfo->iRadioDriver) )
       {
-         sprintf(szComm, "iw dev %s set txpower fixed %d", pRadioHWInfo->szName, iTxPower*40);
-         hw_execute_bash_command(szComm, NULL);
+         hardware_radio_wifi_set_txpower_fixed(pRadioHWInfo->szName, iTxPower*40);
       }
    }
 
@@ -61,7 +56,6 @@ void hardware_radio_set_txpower_raw_rtl8733bu(int iCardIndex, int iTxPower)
    if ( (iTxPower < 1) || (iTxPower > MAX_TX_POWER) )
       iTxPower = DEFAULT_RADIO_TX_POWER;
 
-   char szComm[256];
    for( int i=0; i<hardware_get_radio_interfaces_count(); i++ )
    {
       if ( (iCardIndex != -1) && (iCardIndex != i) )
@@ -71,8 +65,7 @@ void hardware_radio_set_txpower_raw_rtl8733bu(int iCardIndex, int iTxPower)
          continue;
       if ( hardware_radio_driver_is_rtl8733bu_card(pRadioHWInfo->iRadioDriver) )
       {
-         sprintf(szComm, "iw dev %s set txpower fixed %d", pRadioHWInfo->szName, iTxPower*40);
-         hw_execute_bash_command(szComm, NULL);
+         hardware_radio_wifi_set_txpower_fixed(pRadioHWInfo->szName, iTxPower*40);
       }
    }
 
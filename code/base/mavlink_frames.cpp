@@ -0,0 +1,292 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "mavlink_frames.h"
+#include "../../mavlink/common/mavlink.h"
+
+#define MAVLINK_FRAME_HEADER_LEN_V1 6
+#define MAVLINK_FRAME_HEADER_LEN_V2 10
+
+// CRC-16/MCRF4XX (X.25 as used by MAVLink), table driven version of crc_accumulate()
+static u16 s_uMAVLinkCRCTable[256];
+static bool s_bMAVLinkCRCTableInitialized = false;
+
+static void _mavlink_frames_init_crc_table()
+{
+   for( int i=0; i<256; i++ )
+   {
+      uint16_t uCRC = 0;
+      crc_accumulate((u8)i, &uCRC);
+      // crc_accumulate(x, 0) gives the table entry for the low byte of the CRC xor-ed with x
+      s_uMAVLinkCRCTable[i] = uCRC;
+   }
+   s_bMAVLinkCRCTableInitialized = true;
+}
+
+static inline u16 _mavlink_frames_crc(const u8* pData, int iLength, u16 uCRC)
+{
+   for( int i=0; i<iLength; i++ )
+      uCRC = (uCRC >> 8) ^ s_uMAVLinkCRCTable[(uCRC ^ pData[i]) & 0xFF];
+   return uCRC;
+}
+
+static inline bool _mavlink_frames_is_stx(u8 uByte)
+{
+   return (uByte == MAVLINK_FRAME_STX_V1) || (uByte == MAVLINK_FRAME_STX_V2);
+}
+
+// Returns the frame length if a valid frame starts at pData, 0 if more data is needed, -1 if it's not a valid frame
+static int _mavlink_frames_check(t_mavlink_frames_scanner* pScanner, const u8* pData, int iAvailable)
+{
+   int iHeaderLength = MAVLINK_FRAME_HEADER_LEN_V1;
+   int iFrameLength = 0;
+   if ( pData[0] == MAVLINK_FRAME_STX_V1 )
+   {
+      if ( iAvailable < MAVLINK_FRAME_HEADER_LEN_V1 )
+         return 0;
+      iFrameLength = MAVLINK_FRAME_HEADER_LEN_V1 + pData[1] + MAVLINK_NUM_CHECKSUM_BYTES;
+   }
+   else if ( pData[0] == MAVLINK_FRAME_STX_V2 )
+   {
+      if ( iAvailable < 3 )
+         return 0;
+      if ( pData[2] & (~MAVLINK_IFLAG_SIGNED) )
+         return -1;
+      if ( iAvailable < MAVLINK_FRAME_HEADER_LEN_V2 )
+         return 0;
+      iHeaderLength = MAVLINK_FRAME_HEADER_LEN_V2;
+      iFrameLength = MAVLINK_FRAME_HEADER_LEN_V2 + pData[1] + MAVLINK_NUM_CHECKSUM_BYTES;
+      if ( pData[2] & MAVLINK_IFLAG_SIGNED )
+         iFrameLength += MAVLINK_SIGNATURE_BLOCK_LEN;
+   }
+   else
+      return -1;
+
+   if ( iAvailable < iFrameLength )
+      return 0;
+
+   const mavlink_msg_entry_t* pEntry = mavlink_get_msg_entry(mavlink_frame_get_msgid(pData));
+   if ( NULL == pEntry )
+   {
+      // No CRC to check: wait for the byte after the frame, it must be another frame start
+      if ( iAvailable == iFrameLength )
+         return 0;
+      if ( ! _mavlink_frames_is_stx(pData[iFrameLength]) )
+         return -1;
+      pScanner->uStatsUncheckedFrames++;
+      return iFrameLength;
+   }
+
+   int iCRCOffset = iHeaderLength + pData[1];
+   u16 uCRC = _mavlink_frames_crc(pData+1, iCRCOffset-1, 0xFFFF);
+   uCRC = _mavlink_frames_crc(&pEntry->crc_extra, 1, uCRC);
+   if ( (pData[iCRCOffset] != (uCRC & 0xFF)) || (pData[iCRCOffset+1] != (uCRC >> 8)) )
+   {
+      pScanner->uStatsBadFrames++;
+      return -1;
+   }
+   return iFrameLength;
+}
+
+void mavlink_frames_scanner_init(t_mavlink_frames_scanner* pScanner)
+{
+   if ( NULL == pScanner )
+      return;
+   if ( ! s_bMAVLinkCRCTableInitialized )
+      _mavlink_frames_init_crc_table();
+   memset(pScanner, 0, sizeof(t_mavlink_frames_scanner));
+}
+
+void mavlink_frames_scanner_set_data(t_mavlink_frames_scanner* pScanner, u8* pData, int iLength)
+{
+   if ( NULL == pScanner )
+      return;
+   if ( ! s_bMAVLinkCRCTableInitialized )
+      _mavlink_frames_init_crc_table();
+   pScanner->pData = pData;
+   pScanner->iDataLength = ((NULL == pData) || (iLength < 0))?0:iLength;
+   pScanner->iDataPos = 0;
+}
+
+// Completes the pending frame start with bytes from the data. Returns the frame or NULL.
+static u8* _mavlink_frames_scanner_complete_pending(t_mavlink_frames_scanner* pScanner, int* piFrameLength)
+{
+   while ( pScanner->iPendingBytes > 0 )
+   {
+      int iOwnBytes = pScanner->iPendingBytes;
+      int iCopied = pScanner->iDataLength - pScanner->iDataPos;
+      if ( iCopied > (int)sizeof(pScanner->uPending) - iOwnBytes )
+         iCopied = (int)sizeof(pScanner->uPending) - iOwnBytes;
+      if ( iCopied <= 0 )
+         return NULL;
+      memcpy(&pScanner->uPending[iOwnBytes], pScanner->pData + pScanner->iDataPos, iCopied);
+
+      int iResult = _mavlink_frames_check(pScanner, pScanner->uPending, iOwnBytes + iCopied);
+      if ( iResult > 0 )
+      {
+         // The frame can end inside the pending bytes (if it was found after skipping invalid pending bytes):
+         // then the bytes after it stay pending, and are moved down on the next call, after the frame is used.
+         if ( iResult <= iOwnBytes )
+            pScanner->iPendingFrameLength = iResult;
+         else
+         {
+            pScanner->iDataPos += iResult - iOwnBytes;
+            pScanner->iPendingBytes = 0;
+         }
+         pScanner->uStatsFrames++;
+         *piFrameLength = iResult;
+         return pScanner->uPending;
+      }
+      if ( 0 == iResult )
+      {
+         pScanner->iDataPos += iCopied;
+         pScanner->iPendingBytes += iCopied;
+         return NULL;
+      }
+
+      // Not a frame: look for the next frame start, in the pending bytes first
+      int iNext = 1;
+      while ( (iNext < iOwnBytes + iCopied) && (! _mavlink_frames_is_stx(pScanner->uPending[iNext])) )
+         iNext++;
+      pScanner->uStatsSkippedBytes += iNext;
+      if ( iNext < iOwnBytes )
+      {
+         memmove(pScanner->uPending, &pScanner->uPending[iNext], iOwnBytes - iNext);
+         pScanner->iPendingBytes = iOwnBytes - iNext;
+      }
+      else
+      {
+         pScanner->iDataPos += iNext - iOwnBytes;
+         pScanner->iPendingBytes = 0;
+      }
+   }
+   return NULL;
+}
+
+u8* mavlink_frames_scanner_get_next(t_mavlink_frames_scanner* pScanner, int* piFrameLength)
+{
+   if ( (NULL == pScanner) || (NULL == piFrameLength) )
+      return NULL;
+   *piFrameLength = 0;
+
+   if ( pScanner->iPendingFrameLength > 0 )
+   {
+      pScanner->iPendingBytes -= pScanner->iPendingFrameLength;
+      if ( pScanner->iPendingBytes > 0 )
+         memmove(pScanner->uPending, &pScanner->uPending[pScanner->iPendingFrameLength], pScanner->iPendingBytes);
+      pScanner->iPendingFrameLength = 0;
+   }
+
+   if ( pScanner->iPendingBytes > 0 )
+   {
+      u8* pFrame = _mavlink_frames_scanner_complete_pending(pScanner, piFrameLength);
+      if ( NULL != pFrame )
+         return pFrame;
+      if ( pScanner->iPendingBytes > 0 )
+         return NULL;
+   }
+
+   while ( pScanner->iDataPos < pScanner->iDataLength )
+   {
+      u8* pStart = pScanner->pData + pScanner->iDataPos;
+      int iAvailable = pScanner->iDataLength - pScanner->iDataPos;
+      if ( ! _mavlink_frames_is_stx(*pStart) )
+      {
+         pScanner->iDataPos++;
+         pScanner->uStatsSkippedBytes++;
+         continue;
+      }
+      int iResult = _mavlink_frames_check(pScanner, pStart, iAvailable);
+      if ( iResult > 0 )
+      {
+         pScanner->iDataPos += iResult;
+         pScanner->uStatsFrames++;
+         *piFrameLength = iResult;
+         return pStart;
+      }
+      if ( 0 == iResult )
+      {
+         memcpy(pScanner->uPending, pStart, iAvailable);
+         pScanner->iPendingBytes = iAvailable;
+         pScanner->iDataPos = pScanner->iDataLength;
+         return NULL;
+      }
+      pScanner->iDataPos++;
+      pScanner->uStatsSkippedBytes++;
+   }
+   return NULL;
+}
+
+bool mavlink_frame_is_crc_checked(const u8* pFrame)
+{
+   if ( NULL == pFrame )
+      return false;
+   return (NULL != mavlink_get_msg_entry(mavlink_frame_get_msgid(pFrame)));
+}
+
+bool mavlink_frame_decode(const u8* pFrame, int iFrameLength, struct __mavlink_message* pMsg)
+{
+   if ( (NULL == pFrame) || (NULL == pMsg) || (iFrameLength < MAVLINK_FRAME_HEADER_LEN_V1 + MAVLINK_NUM_CHECKSUM_BYTES) )
+      return false;
+
+   int iHeaderLength = MAVLINK_FRAME_HEADER_LEN_V1;
+   pMsg->magic = pFrame[0];
+   pMsg->len = pFrame[1];
+   if ( pFrame[0] == MAVLINK_FRAME_STX_V1 )
+   {
+      pMsg->incompat_flags = 0;
+      pMsg->compat_flags = 0;
+      pMsg->seq = pFrame[2];
+   }
+   else
+   {
+      iHeaderLength = MAVLINK_FRAME_HEADER_LEN_V2;
+      pMsg->incompat_flags = pFrame[2];
+      pMsg->compat_flags = pFrame[3];
+      pMsg->seq = pFrame[4];
+   }
+   if ( iFrameLength < iHeaderLength + pMsg->len + MAVLINK_NUM_CHECKSUM_BYTES )
+      return false;
+   pMsg->sysid = mavlink_frame_get_sysid(pFrame);
+   pMsg->compid = mavlink_frame_get_compid(pFrame);
+   pMsg->msgid = mavlink_frame_get_msgid(pFrame);
+
+   u8* pPayload = (u8*)pMsg->payload64;
+   memcpy(pPayload, pFrame + iHeaderLength, pMsg->len);
+   const mavlink_msg_entry_t* pEntry = mavlink_get_msg_entry(pMsg->msgid);
+   if ( (NULL != pEntry) && (pEntry->msg_len > pMsg->len) )
+      memset(pPayload + pMsg->len, 0, pEntry->msg_len - pMsg->len);
+   pMsg->ck[0] = pFrame[iHeaderLength + pMsg->len];
+   pMsg->ck[1] = pFrame[iHeaderLength + pMsg->len + 1];
+   pMsg->checksum = ((u16)pMsg->ck[0]) | (((u16)pMsg->ck[1]) << 8);
+   return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "base.h"
+
+// Frame level MAVLink (v1 and v2) scanner: finds the complete frames in bulk serial data,
+// in place, without going through the byte by byte MAVLink parser state machine.
+// Only a frame split between two reads is copied (to the scanner's own buffer).
+// Frames of known messages (CRC extra known) are CRC checked; frames of unknown messages
+// (i.e. other dialects) are accepted only when followed by another frame start, so an unknown
+// frame at the end of the data is returned only after the next data comes in.
+// The scanner only selects the frames to parse: the serial data is forwarded as it is.
+// The frames are returned complete (header, payload, CRC, signature if any), ready to be
+// forwarded; decoding to a mavlink_message_t is done only for the frames that need it.
+
+#define MAVLINK_FRAME_STX_V1 0xFE
+#define MAVLINK_FRAME_STX_V2 0xFD
+#define MAVLINK_FRAME_MAX_LENGTH 280 // 10 header + 255 payload + 2 CRC + 13 signature
+
+struct __mavlink_message;
+
+typedef struct
+{
+   // Start of a frame not complete at the end of the previous data (+1: the byte after an unknown message frame)
+   u8  uPending[MAVLINK_FRAME_MAX_LENGTH+1];
+   int iPendingBytes;
+   // Frame returned from the start of uPending (when bytes left after it are still pending); dropped on the next call
+   int iPendingFrameLength;
+
+   u8* pData;
+   int iDataLength;
+   int iDataPos;
+
+   u32 uStatsFrames;
+   u32 uStatsUncheckedFrames;
+   u32 uStatsBadFrames;
+   u32 uStatsSkippedBytes;
+} t_mavlink_frames_scanner;
+
+void mavlink_frames_scanner_init(t_mavlink_frames_scanner* pScanner);
+
+// The data must stay valid until all the frames in it are read
+void mavlink_frames_scanner_set_data(t_mavlink_frames_scanner* pScanner, u8* pData, int iLength);
+// Returns the next complete frame, or NULL when there are no more frames in the current data.
+// The frame is valid until the next call.
+u8* mavlink_frames_scanner_get_next(t_mavlink_frames_scanner* pScanner, int* piFrameLength);
+
+static inline u32 mavlink_frame_get_msgid(const u8* pFrame)
+{
+   if ( pFrame[0] == MAVLINK_FRAME_STX_V1 )
+      return pFrame[5];
+   return ((u32)pFrame[7]) | (((u32)pFrame[8]) << 8) | (((u32)pFrame[9]) << 16);
+}
+
+static inline u8 mavlink_frame_get_sysid(const u8* pFrame)
+{
+   return (pFrame[0] == MAVLINK_FRAME_STX_V1)?pFrame[3]:pFrame[5];
+}
+
+static inline u8 mavlink_frame_get_compid(const u8* pFrame)
+{
+   return (pFrame[0] == MAVLINK_FRAME_STX_V1)?pFrame[4]:pFrame[6];
+}
+
+// Frames of known messages are returned by the scanner only if their CRC is valid,
+// so a frame is CRC checked if its message is known.
+bool mavlink_frame_is_crc_checked(const u8* pFrame);
+
+// Fills in the message header and payload (zero extended to the full message length,
+// as MAVLink v2 truncates the trailing zero bytes). Returns false for invalid frames.
+bool mavlink_frame_decode(const u8* pFrame, int iFrameLength, struct __mavlink_message* pMsg);
@@ -35,6 +35,7 @@
 #include "models.h"
 #include <stdlib.h>
 #include <math.h>
+#include <sys/stat.h>
 #include "config.h"
 #include "ctrl_preferences.h"
 #include "hardware.h"
@@ -50,6 +51,94 @@
 
 #define MODEL_FILE_STAMP_ID "vXI.5stm"
 
+// Binary model file (.mdb), saved next to the text model file (.mdl) on each save.
+// Loaded with a single read when it matches the text file (same save count, text file size and
+// modification time), else the text file is parsed. The text format stays the export/import format.
+// File: header, then sections (section header + data). Sections not known by the reader are skipped
+// if flagged optional; optional sections of a different size are copied up to the smaller size
+// (the fields not in the file keep their current values) and are not part of the schema hash.
+// Optional: the sections that are not needed to fly and to link with the vehicle (logging, stats,
+// audio, functions, relay, alarms); the structures there can grow without invalidating the binary files.
+#define MODEL_BINARY_FILE_MAGIC 0x42444D52 // "RMDB"
+#define MODEL_BINARY_FILE_VERSION 3
+#define MODEL_BINARY_MAX_FILE_SIZE 512000
+
+#define MODEL_BINARY_SECTION_FLAG_OPTIONAL 0x01
+
+#define MODEL_BINARY_SECTION_IDENTITY 1
+#define MODEL_BINARY_SECTION_HW_CAPABILITIES 2
+#define MODEL_BINARY_SECTION_HW_INTERFACES 3
+#define MODEL_BINARY_SECTION_PROCESSES 4
+#define MODEL_BINARY_SECTION_RADIO_INTERFACES 5
+#define MODEL_BINARY_SECTION_RADIO_LINKS 6
+#define MODEL_BINARY_SECTION_RADIO_CAPABILITIES 7
+#define MODEL_BINARY_SECTION_LOGGING 8
+#define MODEL_BINARY_SECTION_STATS 9
+#define MODEL_BINARY_SECTION_CAMERAS 10
+#define MODEL_BINARY_SECTION_VIDEO 11
+#define MODEL_BINARY_SECTION_VIDEO_PROFILES 12
+#define MODEL_BINARY_SECTION_OSD 13
+#define MODEL_BINARY_SECTION_RC 14
+#define MODEL_BINARY_SECTION_TELEMETRY 15
+#define MODEL_BINARY_SECTION_AUDIO 16
+#define MODEL_BINARY_SECTION_FUNCTIONS 17
+#define MODEL_BINARY_SECTION_RELAY 18
+#define MODEL_BINARY_SECTION_ALARMS 19
+#define MODEL_BINARY_MAX_SECTIONS 24
+
+typedef struct
+{
+   u32 uMagic;
+   u16 uVersion;
+   u16 uHeaderSize;
+   u32 uSchemaHash; // hash of the required sections ids and sizes
+   u32 uTotalSize;
+   u32 uSaveCount;
+   u32 uTextFileSize;
+   u32 uTextFileTime; // modification time of the text file (seconds, nanoseconds)
+   u32 uTextFileTimeNs;
+   u32 uSectionsCount;
+   u32 uCRC; // of everything after the header
+} type_model_binary_header;
+
+typedef struct
+{
+   u16 uId;
+   u16 uFlags;
+   u32 uSize;
+} type_model_binary_section;
+
+typedef struct
+{
+   u32 sw_version;
+   u32 uVehicleId;
+   u32 uControllerId;
+   u32 uControllerBoardType;
+   u32 uModelFlags;
+   u32 uModelPersistentStatusFlags;
+   u32 uDeveloperFlags;
+   u32 alarms;
+   u32 camera_rc_channels;
+   u32 enc_flags;
+   int rxtx_sync_type;
+   int iGPSCount;
+   int iCameraCount;
+   int iCurrentCamera;
+   u8 is_spectator;
+   u8 vehicle_type;
+   u8 enableDHCP;
+   u8 uDummy;
+   char vehicle_name[MAX_VEHICLE_NAME_LENGTH];
+} type_model_binary_identity;
+
+typedef struct
+{
+   u16 uId;
+   u16 uFlags;
+   void* pData;
+   u32 uSize;
+} type_model_binary_section_info;
+
 static const char* s_szModelFlightModeNONE = "NONE";
 static const char* s_szModelFlightModeMAN  = "MAN";
 static const char* s_szModelFlightModeSTAB = "STAB";
@@ -308,7 +397,14 @@ bool Model::loadFromFile(const char* filename, bool bLoadStats)
 
    int iVersionMain = 0;
    int iVersionBackup = 0;
-   FILE* fd = fopen(szFileNormal, "r");
+   FILE* fd = NULL;
+   if ( loadBinaryFile(szFileNormal) )
+   {
+      bMainFileLoadedOk = true;
+      iLoadedFileVersion = 11;
+   }
+   else
+      fd = fopen(szFileNormal, "r");
    if ( NULL != fd )
    {
       if ( 1 != fscanf(fd, "%*s %d", &iVersionMain) )
@@ -332,8 +428,6 @@ bool Model::loadFromFile(const char* filename, bool bLoadStats)
       }
       fclose(fd);
    }
-   else
-      bMainFileLoadedOk = false;
 
    if ( bMainFileLoadedOk )
    {
@@ -348,8 +442,8 @@ bool Model::loadFromFile(const char* filename, bool bLoadStats)
       strcpy(szFreq2, str_format_frequency(radioLinksParams.link_frequency_khz[1]));
       strcpy(szFreq3, str_format_frequency(radioLinksParams.link_frequency_khz[2]));
 
-      log_line("Loaded vehicle (%s) successfully from file: [%s] name: [%s], VID: %u, %s, software: %d.%d (b-%d), has negociated radio: %s, on time: %02d:%02d",
-         bLoadStats?"with stats":"without stats",
+      log_line("Loaded vehicle (%s, %s, %u ms) successfully from file: [%s] name: [%s], VID: %u, %s, software: %d.%d (b-%d), has negociated radio: %s, on time: %02d:%02d",
+         bLoadStats?"with stats":"without stats", (NULL == fd)?"binary":"text", timeStart,
          filename, vehicle_name, uVehicleId, 
          is_spectator?"spectator mode": "control mode",
          get_sw_version_major(this), get_sw_version_minor(this), get_sw_version_build(this),
@@ -1682,17 +1776,7 @@ bool Model::loadVersion11(FILE* fd)
    // End reading file;
    //----------------------------------------
 
-   // Validate settings;
-   validate_settings();
-
-   if ( telemetry_params.vehicle_mavlink_id <= 0 || telemetry_params.vehicle_mavlink_id > 255 )
-      telemetry_params.vehicle_mavlink_id = DEFAULT_MAVLINK_SYS_ID_VEHICLE;
-   if ( telemetry_params.controller_mavlink_id <= 0 || telemetry_params.controller_mavlink_id > 255 )
-      telemetry_params.controller_mavlink_id = DEFAULT_MAVLINK_SYS_ID_CONTROLLER;
-   if ( telemetry_params.flags == 0 )
-      telemetry_params.flags = TELEMETRY_FLAGS_REQUEST_DATA_STREAMS | TELEMETRY_FLAGS_SPECTATOR_ENABLE;
-   if ( rxtx_sync_type < 0 || rxtx_sync_type >= RXTX_SYNC_TYPE_LAST )
-      rxtx_sync_type = RXTX_SYNC_TYPE_BASIC;
+   validateLoadedSettings();
 
    /*
    log_line("---------------------------------------");
@@ -1714,6 +1798,333 @@ bool Model::loadVersion11(FILE* fd)
    return true;
 }
 
+void Model::validateLoadedSettings()
+{
+   validate_settings();
+
+   if ( telemetry_params.vehicle_mavlink_id <= 0 || telemetry_params.vehicle_mavlink_id > 255 )
+      telemetry_params.vehicle_mavlink_id = DEFAULT_MAVLINK_SYS_ID_VEHICLE;
+   if ( telemetry_params.controller_mavlink_id <= 0 || telemetry_params.controller_mavlink_id > 255 )
+      telemetry_params.controller_mavlink_id = DEFAULT_MAVLINK_SYS_ID_CONTROLLER;
+   if ( telemetry_params.flags == 0 )
+      telemetry_params.flags = TELEMETRY_FLAGS_REQUEST_DATA_STREAMS | TELEMETRY_FLAGS_SPECTATOR_ENABLE;
+   if ( rxtx_sync_type < 0 || rxtx_sync_type >= RXTX_SYNC_TYPE_LAST )
+      rxtx_sync_type = RXTX_SYNC_TYPE_BASIC;
+}
+
+static void _model_get_binary_file_name(const char* szTextFile, char* szOutFile)
+{
+   strcpy(szOutFile, szTextFile);
+   int iLen = strlen(szOutFile);
+   if ( iLen > 3 )
+      strcpy(szOutFile + iLen - 3, "mdb");
+   else
+      strcat(szOutFile, ".mdb");
+}
+
+static u32 _model_binary_schema_hash(type_model_binary_section_info* pSections, int iCount)
+{
+   u32 uHash = 2166136261u; // FNV-1a
+   for( int i=0; i<iCount; i++ )
+   {
+      if ( pSections[i].uFlags & MODEL_BINARY_SECTION_FLAG_OPTIONAL )
+         continue;
+      u32 uValues[2] = { pSections[i].uId, pSections[i].uSize };
+      u8* pBytes = (u8*)uValues;
+      for( int k=0; k<(int)sizeof(uValues); k++ )
+      {
+         uHash ^= pBytes[k];
+         uHash *= 16777619u;
+      }
+   }
+   return uHash;
+}
+
+int Model::getBinarySections(void* pSectionsInfo, void* pIdentity)
+{
+   type_model_binary_section_info* pSections = (type_model_binary_section_info*)pSectionsInfo;
+   int iCount = 0;
+   #define MODEL_BIN_ADD_SECTION(id, flags, ptr, size) { pSections[iCount].uId = id; pSections[iCount].uFlags = flags; pSections[iCount].pData = ptr; pSections[iCount].uSize = size; iCount++; }
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_IDENTITY, 0, pIdentity, sizeof(type_model_binary_identity));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_HW_CAPABILITIES, 0, &hwCapabilities, sizeof(hwCapabilities));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_HW_INTERFACES, 0, &hardwareInterfacesInfo, sizeof(hardwareInterfacesInfo));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_PROCESSES, 0, &processesPriorities, sizeof(processesPriorities));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_RADIO_INTERFACES, 0, &radioInterfacesParams, sizeof(radioInterfacesParams));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_RADIO_LINKS, 0, &radioLinksParams, sizeof(radioLinksParams));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_RADIO_CAPABILITIES, 0, &radioRuntimeCapabilities, sizeof(radioRuntimeCapabilities));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_LOGGING, MODEL_BINARY_SECTION_FLAG_OPTIONAL, &loggingParams, sizeof(loggingParams));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_STATS, MODEL_BINARY_SECTION_FLAG_OPTIONAL, &m_Stats, sizeof(m_Stats));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_CAMERAS, 0, &camera_params[0], sizeof(camera_params));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_VIDEO, 0, &video_params, sizeof(video_params));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_VIDEO_PROFILES, 0, &video_link_profiles[0], sizeof(video_link_profiles));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_OSD, 0, &osd_params, sizeof(osd_params));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_RC, 0, &rc_params, sizeof(rc_params));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_TELEMETRY, 0, &telemetry_params, sizeof(telemetry_params));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_AUDIO, MODEL_BINARY_SECTION_FLAG_OPTIONAL, &audio_params, sizeof(audio_params));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_FUNCTIONS, MODEL_BINARY_SECTION_FLAG_OPTIONAL, &functions_params, sizeof(functions_params));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_RELAY, MODEL_BINARY_SECTION_FLAG_OPTIONAL, &relay_params, sizeof(relay_params));
+   MODEL_BIN_ADD_SECTION(MODEL_BINARY_SECTION_ALARMS, MODEL_BINARY_SECTION_FLAG_OPTIONAL, &alarms_params, sizeof(alarms_params));
+   #undef MODEL_BIN_ADD_SECTION
+   return iCount;
+}
+
+bool Model::saveBinaryFile(const char* szTextFile)
+{
+   char szFile[MAX_FILE_PATH_SIZE];
+   _model_get_binary_file_name(szTextFile, szFile);
+
+   struct stat statText;
+   if ( 0 != stat(szTextFile, &statText) )
+      return false;
+
+   type_model_binary_identity identity;
+   memset(&identity, 0, sizeof(identity));
+   identity.sw_version = sw_version;
+   identity.uVehicleId = uVehicleId;
+   identity.uControllerId = uControllerId;
+   identity.uControllerBoardType = uControllerBoardType;
+   identity.uModelFlags = uModelFlags;
+   identity.uModelPersistentStatusFlags = uModelPersistentStatusFlags;
+   identity.uDeveloperFlags = uDeveloperFlags;
+   identity.alarms = alarms;
+   identity.camera_rc_channels = camera_rc_channels;
+   identity.enc_flags = enc_flags;
+   identity.rxtx_sync_type = rxtx_sync_type;
+   identity.iGPSCount = iGPSCount;
+   identity.iCameraCount = iCameraCount;
+   identity.iCurrentCamera = iCurrentCamera;
+   identity.is_spectator = is_spectator?1:0;
+   identity.vehicle_type = vehicle_type;
+   identity.enableDHCP = enableDHCP?1:0;
+   memcpy(identity.vehicle_name, vehicle_name, MAX_VEHICLE_NAME_LENGTH);
+
+   type_model_binary_section_info sections[MODEL_BINARY_MAX_SECTIONS];
+   int iCountSections = getBinarySections(sections, &identity);
+
+   u32 uTotalSize = sizeof(type_model_binary_header);
+   for( int i=0; i<iCountSections; i++ )
+      uTotalSize += sizeof(type_model_binary_section) + sections[i].uSize;
+
+   u8* pBuffer = (u8*) malloc(uTotalSize);
+   if ( NULL == pBuffer )
+      return false;
+
+   type_model_binary_header* pHeader = (type_model_binary_header*)pBuffer;
+   pHeader->uMagic = MODEL_BINARY_FILE_MAGIC;
+   pHeader->uVersion = MODEL_BINARY_FILE_VERSION;
+   pHeader->uHeaderSize = sizeof(type_model_binary_header);
+   pHeader->uSchemaHash = _model_binary_schema_hash(sections, iCountSections);
+   pHeader->uTotalSize = uTotalSize;
+   pHeader->uSaveCount = (u32)iSaveCount;
+   pHeader->uTextFileSize = (u32)statText.st_size;
+   pHeader->uTextFileTime = (u32)statText.st_mtim.tv_sec;
+   pHeader->uTextFileTimeNs = (u32)statText.st_mtim.tv_nsec;
+   pHeader->uSectionsCount = iCountSections;
+
+   u8* pPos = pBuffer + sizeof(type_model_binary_header);
+   for( int i=0; i<iCountSections; i++ )
+   {
+      type_model_binary_section section;
+      section.uId = sections[i].uId;
+      section.uFlags = sections[i].uFlags;
+      section.uSize = sections[i].uSize;
+      memcpy(pPos, &section, sizeof(section));
+      pPos += sizeof(section);
+      memcpy(pPos, sections[i].pData, sections[i].uSize);
+      pPos += sections[i].uSize;
+   }
+   pHeader->uCRC = base_compute_crc32(pBuffer + sizeof(type_model_binary_header), uTotalSize - sizeof(type_model_binary_header));
+
+   // Written to a temporary file that replaces the binary file only once it's complete on disk,
+   // so a power loss while saving leaves either the old or the new binary file, never a truncated one.
+   char szTmpFile[MAX_FILE_PATH_SIZE+8];
+   snprintf(szTmpFile, sizeof(szTmpFile), "%s.tmp", szFile);
+   bool bOk = false;
+   FILE* fd = fopen(szTmpFile, "wb");
+   if ( NULL != fd )
+   {
+      if ( 1 == fwrite(pBuffer, uTotalSize, 1, fd) )
+      if ( 0 == fflush(fd) )
+      if ( 0 == fsync(fileno(fd)) )
+         bOk = true;
+      if ( 0 != fclose(fd) )
+         bOk = false;
+   }
+   free(pBuffer);
+   if ( bOk && (0 != rename(szTmpFile, szFile)) )
+      bOk = false;
+   if ( ! bOk )
+   {
+      log_softerror_and_alarm("Failed to save binary model file: %s, error: %s", szFile, strerror(errno));
+      unlink(szTmpFile);
+      // The existing binary file does not match the text file anymore; it's rejected on load anyway (save count)
+   }
+   return bOk;
+}
+
+// Loads the binary model file only if it was saved together with the current text model file.
+
+bool Model::loadBinaryFile(const char* szTextFile)
+{
+   char szFile[MAX_FILE_PATH_SIZE];
+   _model_get_binary_file_name(szTextFile, szFile);
+
+   FILE* fdText = fopen(szTextFile, "r");
+   if ( NULL == fdText )
+      return false;
+   int iTextVersion = 0;
+   int iTextSaveCount = -1;
+   char szStamp[64];
+   bool bTextOk = false;
+   if ( 1 == fscanf(fdText, "%*s %d", &iTextVersion) )
+   if ( 1 == fscanf(fdText, "%63s", szStamp) )
+   if ( 1 == fscanf(fdText, "%*s %d", &iTextSaveCount) )
+      bTextOk = true;
+   struct stat statText;
+   if ( 0 != fstat(fileno(fdText), &statText) )
+      bTextOk = false;
+   fclose(fdText);
+   if ( (! bTextOk) || (11 != iTextVersion) || (0 != strcmp(szStamp, MODEL_FILE_STAMP_ID)) )
+      return false;
+
+   int fd = open(szFile, O_RDONLY);
+   if ( fd < 0 )
+      return false;
+   struct stat statBin;
+   if ( (0 != fstat(fd, &statBin)) || (statBin.st_size < (off_t)sizeof(type_model_binary_header)) || (statBin.st_size > MODEL_BINARY_MAX_FILE_SIZE) )
+   {
+      close(fd);
+      return false;
+   }
+   u8* pBuffer = (u8*) malloc(statBin.st_size);
+   if ( NULL == pBuffer )
+   {
+      close(fd);
+      return false;
+   }
+   ssize_t iRead = read(fd, pBuffer, statBin.st_size);
+   close(fd);
+
+   type_model_binary_header* pHeader = (type_model_binary_header*)pBuffer;
+   if ( (iRead != statBin.st_size) || (pHeader->uMagic != MODEL_BINARY_FILE_MAGIC) ||
+        (pHeader->uVersion != MODEL_BINARY_FILE_VERSION) || (pHeader->uHeaderSize != sizeof(type_model_binary_header)) ||
+        (pHeader->uTotalSize != (u32)iRead) )
+   {
+      log_line("Binary model file %s is invalid or from a different version. Using text model file.", szFile);
+      free(pBuffer);
+      return false;
+   }
+   // The text file could have been replaced or edited without changing its save count or size (import, manual edit)
+   if ( (pHeader->uSaveCount != (u32)iTextSaveCount) || (pHeader->uTextFileSize != (u32)statText.st_size) ||
+        (pHeader->uTextFileTime != (u32)statText.st_mtim.tv_sec) || (pHeader->uTextFileTimeNs != (u32)statText.st_mtim.tv_nsec) )
+   {
+      log_line("Binary model file %s is older than the text model file (save count %u/%d). Using text model file.", szFile, pHeader->uSaveCount, iTextSaveCount);
+      free(pBuffer);
+      return false;
+   }
+   if ( pHeader->uCRC != base_compute_crc32(pBuffer + sizeof(type_model_binary_header), pHeader->uTotalSize - sizeof(type_model_binary_header)) )
+   {
+      log_softerror_and_alarm("Binary model file %s has invalid CRC. Using text model file.", szFile);
+      free(pBuffer);
+      return false;
+   }
+
+   type_model_binary_identity identity;
+   type_model_binary_section_info sections[MODEL_BINARY_MAX_SECTIONS];
+   int iCountSections = getBinarySections(sections, &identity);
+   if ( pHeader->uSchemaHash != _model_binary_schema_hash(sections, iCountSections) )
+   {
+      log_line("Binary model file %s has a different schema. Using text model file.", szFile);
+      free(pBuffer);
+      return false;
+   }
+
+   // Validate all sections before changing anything in the model
+   u8* pEnd = pBuffer + pHeader->uTotalSize;
+   u8* pSectionsStart = pBuffer + sizeof(type_model_binary_header);
+   bool bFound[MODEL_BINARY_MAX_SECTIONS];
+   memset(bFound, 0, sizeof(bFound));
+   bool bOk = true;
+   for( int iStep=0; (iStep<2) && bOk; iStep++ )
+   {
+      u8* pPos = pSectionsStart;
+      for( u32 u=0; u<pHeader->uSectionsCount; u++ )
+      {
+         type_model_binary_section section;
+         if ( pPos + sizeof(section) > pEnd )
+            { bOk = false; break; }
+         memcpy(&section, pPos, sizeof(section));
+         pPos += sizeof(section);
+         if ( pPos + section.uSize > pEnd )
+            { bOk = false; break; }
+
+         int iIndex = -1;
+         for( int i=0; i<iCountSections; i++ )
+            if ( sections[i].uId == section.uId )
+               iIndex = i;
+
+         if ( -1 == iIndex )
+         {
+            if ( ! (section.uFlags & MODEL_BINARY_SECTION_FLAG_OPTIONAL) )
+               { bOk = false; break; }
+         }
+         else if ( section.uSize != sections[iIndex].uSize )
+         {
+            if ( ! (sections[iIndex].uFlags & MODEL_BINARY_SECTION_FLAG_OPTIONAL) )
+               { bOk = false; break; }
+            if ( 1 == iStep )
+               memcpy(sections[iIndex].pData, pPos, (section.uSize < sections[iIndex].uSize)?section.uSize:sections[iIndex].uSize);
+            bFound[iIndex] = true;
+         }
+         else
+         {
+            if ( 1 == iStep )
+               memcpy(sections[iIndex].pData, pPos, section.uSize);
+            bFound[iIndex] = true;
+         }
+         pPos += section.uSize;
+      }
+      if ( 0 == iStep )
+      for( int i=0; i<iCountSections; i++ )
+         if ( (! bFound[i]) && (! (sections[i].uFlags & MODEL_BINARY_SECTION_FLAG_OPTIONAL)) )
+            bOk = false;
+   }
+   free(pBuffer);
+
+   if ( ! bOk )
+   {
+      log_softerror_and_alarm("Binary model file %s has invalid sections. Using text model file.", szFile);
+      return false;
+   }
+
+   iSaveCount = iTextSaveCount;
+   sw_version = identity.sw_version;
+   uVehicleId = identity.uVehicleId;
+   uControllerId = identity.uControllerId;
+   uControllerBoardType = identity.uControllerBoardType;
+   uModelFlags = identity.uModelFlags;
+   uModelPersistentStatusFlags = identity.uModelPersistentStatusFlags;
+   uDeveloperFlags = identity.uDeveloperFlags;
+   alarms = identity.alarms;
+   camera_rc_channels = identity.camera_rc_channels;
+   enc_flags = identity.enc_flags;
+   rxtx_sync_type = identity.rxtx_sync_type;
+   iGPSCount = identity.iGPSCount;
+   iCameraCount = identity.iCameraCount;
+   iCurrentCamera = identity.iCurrentCamera;
+   is_spectator = (identity.is_spectator != 0);
+   vehicle_type = identity.vehicle_type;
+   enableDHCP = (identity.enableDHCP != 0);
+   memcpy(vehicle_name, identity.vehicle_name, MAX_VEHICLE_NAME_LENGTH);
+   vehicle_name[MAX_VEHICLE_NAME_LENGTH-1] = 0;
+
+   if ( hardware_is_vehicle() )
+      sw_version = (SYSTEM_SW_VERSION_MAJOR * 256 + SYSTEM_SW_VERSION_MINOR) | (SYSTEM_SW_BUILD_NUMBER<<16);
+   str_sanitize_modelname(vehicle_name);
+   validateLoadedSettings();
+   return true;
+}
+
 bool Model::saveToFile(const char* filename, bool isOnController)
 {
    iSaveCount++;
@@ -1745,6 +2156,8 @@ bool Model::saveToFile(const char* filename, bool isOnController)
    fflush(fd);
    fclose(fd);
 
+   saveBinaryFile(filename);
+
    log_line("Saved vehicle successfully to file: [%s] name: [%s], VID: %u, software: %d.%d (b-%d), has negociated radio: %s, is on controller: %s, %s, on time: %02d:%02d",
          filename, vehicle_name, uVehicleId, get_sw_version_major(this), get_sw_version_minor(this), get_sw_version_build(this),
          (radioLinksParams.uGlobalRadioLinksFlags & MODEL_RADIOLINKS_FLAGS_HAS_NEGOCIATED_LINKS)?"yes":"no",
@@ -748,6 +748,10 @@ class Model
       bool loadVersion10(FILE* fd); // from 7.6
       bool loadVersion11(FILE* fd); // from 11.5
       bool saveVersion11(FILE* fd, bool isOnController); // from 11.5
+      void validateLoadedSettings();
+      int  getBinarySections(void* pSectionsInfo, void* pIdentity);
+      bool loadBinaryFile(const char* szTextFile);
+      bool saveBinaryFile(const char* szTextFile);
 };
 
 const char* model_getShortFlightMode(u8 mode);
@@ -0,0 +1,100 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "base.h"
+#include "packets_slab.h"
+
+int packets_slab_alloc(t_packets_slab* pSlab, int iSlotsCount, int iSlotSize, int iTryHugePages)
+{
+   if ( (NULL == pSlab) || (iSlotsCount <= 0) || (iSlotSize <= 0) )
+      return 0;
+
+   memset(pSlab, 0, sizeof(t_packets_slab));
+   pSlab->iSlotsCount = iSlotsCount;
+   pSlab->iSlotSize = ((iSlotSize + PACKETS_SLAB_ALIGNMENT - 1) / PACKETS_SLAB_ALIGNMENT) * PACKETS_SLAB_ALIGNMENT;
+   pSlab->uTotalSize = (u32)pSlab->iSlotsCount * (u32)pSlab->iSlotSize;
+
+   #ifdef MAP_HUGETLB
+   if ( iTryHugePages )
+   {
+      u32 uMappedSize = ((pSlab->uTotalSize + PACKETS_SLAB_HUGE_PAGE_SIZE - 1) / PACKETS_SLAB_HUGE_PAGE_SIZE) * PACKETS_SLAB_HUGE_PAGE_SIZE;
+      void* pMem = mmap(NULL, uMappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if ( MAP_FAILED != pMem )
+      {
+         pSlab->pMemory = (u8*)pMem;
+         pSlab->uMappedSize = uMappedSize;
+         pSlab->iIsHugePages = 1;
+         log_line("[PacketsSlab] Allocated %d slots of %d bytes (%u bytes) in huge pages.", pSlab->iSlotsCount, pSlab->iSlotSize, uMappedSize);
+         return 1;
+      }
+   }
+   #endif
+
+   // Regular memory: an anonymous mapping, so that the slots are zeroed without touching the pages.
+   // Pages are faulted in when a slot is first used, so only the slots actually used take memory.
+   // Aligned to the huge page size (over map, then trim) so that transparent huge pages can back it.
+   u32 uAlign = (u32)sysconf(_SC_PAGESIZE);
+   if ( iTryHugePages || (0 == uAlign) )
+      uAlign = PACKETS_SLAB_HUGE_PAGE_SIZE;
+   u32 uMappedSize = ((pSlab->uTotalSize + uAlign - 1) / uAlign) * uAlign;
+   u8* pMap = (u8*) mmap(NULL, uMappedSize + uAlign, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if ( MAP_FAILED == (void*)pMap )
+   {
+      log_error_and_alarm("[PacketsSlab] Failed to allocate %d slots of %d bytes, error: %s", pSlab->iSlotsCount, pSlab->iSlotSize, strerror(errno));
+      memset(pSlab, 0, sizeof(t_packets_slab));
+      return 0;
+   }
+   u8* pMem = (u8*)((((uintptr_t)pMap) + uAlign - 1) & ~((uintptr_t)uAlign - 1));
+   if ( pMem > pMap )
+      munmap(pMap, pMem - pMap);
+   if ( pMem + uMappedSize < pMap + uMappedSize + uAlign )
+      munmap(pMem + uMappedSize, (pMap + uMappedSize + uAlign) - (pMem + uMappedSize));
+
+   #ifdef MADV_HUGEPAGE
+   if ( iTryHugePages )
+   if ( 0 != madvise(pMem, uMappedSize, MADV_HUGEPAGE) )
+      log_line("[PacketsSlab] Transparent huge pages not available (%s), using regular pages.", strerror(errno));
+   #endif
+
+   pSlab->pMemory = pMem;
+   pSlab->uMappedSize = uMappedSize;
+   log_line("[PacketsSlab] Allocated %d slots of %d bytes (%u bytes).", pSlab->iSlotsCount, pSlab->iSlotSize, uMappedSize);
+   return 1;
+}
+
+void packets_slab_free(t_packets_slab* pSlab)
+{
+   if ( (NULL == pSlab) || (NULL == pSlab->pMemory) )
+      return;
+   munmap(pSlab->pMemory, pSlab->uMappedSize);
+   memset(pSlab, 0, sizeof(t_packets_slab));
+}
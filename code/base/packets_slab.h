@@ -0,0 +1,38 @@
+#pragma once
+
+#include "base.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Single contiguous memory area holding fixed size packet slots, used by the video rx/tx buffers
+// instead of one heap allocation for each packet. Slots are cache line aligned and a slot is found
+// by index arithmetic only. Huge pages are used if the system has them reserved, with fallback to
+// regular (huge page aligned, transparent huge pages advised) memory, faulted in on first use.
+
+#define PACKETS_SLAB_ALIGNMENT 64
+#define PACKETS_SLAB_HUGE_PAGE_SIZE (2*1024*1024)
+
+typedef struct
+{
+   u8* pMemory;
+   u32 uTotalSize;
+   u32 uMappedSize; // uTotalSize rounded up to the pages size
+   int iSlotSize; // rounded up to PACKETS_SLAB_ALIGNMENT
+   int iSlotsCount;
+   int iIsHugePages;
+} t_packets_slab;
+
+// Returns 1 on success. The slots are zeroed.
+int packets_slab_alloc(t_packets_slab* pSlab, int iSlotsCount, int iSlotSize, int iTryHugePages);
+void packets_slab_free(t_packets_slab* pSlab);
+
+static inline u8* packets_slab_get_slot(t_packets_slab* pSlab, int iSlotIndex)
+{
+   return pSlab->pMemory + (u32)iSlotIndex * (u32)pSlab->iSlotSize;
+}
+
+#ifdef __cplusplus
+}  
+#endif
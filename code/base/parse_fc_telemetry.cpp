@@ -34,6 +34,7 @@
 #include "parse_fc_telemetry_ltm.h"
 #include <math.h>
 #include "../../mavlink/common/mavlink.h"
+#include "mavlink_frames.h"
 #include "../base/models.h"
 #include "../radio/radiopackets2.h"
 
@@ -133,11 +134,13 @@ typedef enum ROVER_MODE
 } ROVER_MODE;
 #endif
  
-mavlink_status_t statusMav;
+t_mavlink_frames_scanner s_MAVLinkFramesScanner;
 mavlink_message_t msgMav;
 u32 s_vehicleMavId = 1;
 int s_iAllowAnyVehicleSysId = 0;
 
+static void _build_mav_handlers_lookup();
+
 
 void _rotate_point(float x, float y, float xCenter, float yCenter, float angle, float* px, float* py)
 {
@@ -172,6 +175,9 @@ void parse_telemetry_init(u32 vehicleMavId,  bool bShowLocalVerticalSpeed)
    
    s_iHeartbeatMsgCount = 0;
    s_iSystemMsgCount = 0;
+
+   mavlink_frames_scanner_init(&s_MAVLinkFramesScanner);
+   _build_mav_handlers_lookup();
 }
 
 void parse_telemetry_allow_any_sysid(int iAllow)
@@ -179,6 +185,11 @@ void parse_telemetry_allow_any_sysid(int iAllow)
    s_iAllowAnyVehicleSysId = iAllow;
 }
 
+void parse_telemetry_reset_mavlink_scanner()
+{
+   mavlink_frames_scanner_init(&s_MAVLinkFramesScanner);
+}
+
 void parse_telemetry_set_show_local_vspeed(bool bShowLocalVerticalSpeed)
 {
    s_bShowLocalVerticalSpeed = bShowLocalVerticalSpeed;
@@ -298,418 +309,484 @@ bool _check_add_fc_message(char* szMessage)
    return true;
 }
 
-void _process_mav_message(t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+static void _mav_on_statustext(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
 {
    char szBuff[512];
-   u32 tmp32;
-   u8 tmp8;
-   int tmpi;
-   int imah = 0;
-   //u32 uTmp32;
 
-   if ( 0 == s_iAllowAnyVehicleSysId )
-   if ( (msgMav.sysid != s_vehicleMavId) && (msgMav.sysid != 0) )
-      return;
+   mavlink_msg_statustext_get_text(pMsg, szBuff);
+   if ( _check_add_fc_message(szBuff) )
+      log_line("MAV status text: %s", szBuff);
+}
+
+static void _mav_on_statustext_long(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+{
+   char szBuff[512];
+
+   mavlink_msg_statustext_long_get_text(pMsg, szBuff);
+   if ( _check_add_fc_message(szBuff) )
+      log_line("MAV status text long: %s", szBuff);
+}
 
-   switch (msgMav.msgid)
-   { 
-      case MAVLINK_MSG_ID_STATUSTEXT:
-         mavlink_msg_statustext_get_text(&msgMav, szBuff);
-         if ( _check_add_fc_message(szBuff) )
-            log_line("MAV status text: %s", szBuff);
+static void _mav_on_heartbeat(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+{
+   u32 tmp32 = 0;
+   u8 tmp8 = 0;
+
+   tmp32 = mavlink_msg_heartbeat_get_custom_mode(pMsg);
+   tmp8 = mavlink_msg_heartbeat_get_base_mode(pMsg);
+   pdpfct->flight_mode = 0;
+   /*
+   switch ( tmp8 )
+   {
+      case 0:
+      case 64:
+      case 66:
+      case 81:
+      case 88:
+      case 92:
+         pdpfct->flight_mode &= ~FLIGHT_MODE_ARMED; //disarmed
          break;
 
-      case MAVLINK_MSG_ID_STATUSTEXT_LONG:
-         mavlink_msg_statustext_long_get_text(&msgMav, szBuff);
-         if ( _check_add_fc_message(szBuff) )
-            log_line("MAV status text long: %s", szBuff);
+      case 1:
+      case 192:
+      case 194:
+      case 208:
+      case 209:
+      case 216:
+      case 220:
+         pdpfct->flight_mode |= FLIGHT_MODE_ARMED;
          break;
 
-      case MAVLINK_MSG_ID_HEARTBEAT:
-         tmp32 = mavlink_msg_heartbeat_get_custom_mode(&msgMav);
-         tmp8 = mavlink_msg_heartbeat_get_base_mode(&msgMav);
-         pdpfct->flight_mode = 0;
-         /*
-         switch ( tmp8 )
-         {
-            case 0: 
-            case 64:
-            case 66:
-            case 81:
-            case 88:
-            case 92:
-               pdpfct->flight_mode &= ~FLIGHT_MODE_ARMED; //disarmed
-               break;
-
-            case 1:
-            case 192:
-            case 194:
-            case 208:
-            case 209:
-            case 216:
-            case 220:
-               pdpfct->flight_mode |= FLIGHT_MODE_ARMED;
-               break;
-
-            default:
-               if ( tmp8 > 100 )
-                  pdpfct->flight_mode |= FLIGHT_MODE_ARMED;
-               else if ( tmp8 < 100 )
-                  pdpfct->flight_mode &= ~FLIGHT_MODE_ARMED;
-               break;
-         };
-         */
-         if ( tmp8 & MAV_MODE_FLAG_SAFETY_ARMED )
+      default:
+         if ( tmp8 > 100 )
             pdpfct->flight_mode |= FLIGHT_MODE_ARMED;
-         else
+         else if ( tmp8 < 100 )
             pdpfct->flight_mode &= ~FLIGHT_MODE_ARMED;
+         break;
+   };
+   */
+   if ( tmp8 & MAV_MODE_FLAG_SAFETY_ARMED )
+      pdpfct->flight_mode |= FLIGHT_MODE_ARMED;
+   else
+      pdpfct->flight_mode &= ~FLIGHT_MODE_ARMED;
 
-         if ( s_bTelemetryForceAlwaysArmed )
-            pdpfct->flight_mode |= FLIGHT_MODE_ARMED;
+   if ( s_bTelemetryForceAlwaysArmed )
+      pdpfct->flight_mode |= FLIGHT_MODE_ARMED;
 
-         if ( (vehicleType & MODEL_TYPE_MASK) == MODEL_TYPE_AIRPLANE )
-         {
-         //log_line("plane tmp32: %u", tmp32);
-         switch ( tmp32 )
-         {
-            case PLANE_MODE_MANUAL: pdpfct->flight_mode |= FLIGHT_MODE_MANUAL; break;
-            case PLANE_MODE_CIRCLE: pdpfct->flight_mode |= FLIGHT_MODE_CIRCLE; break;
-            case PLANE_MODE_STABILIZE: pdpfct->flight_mode |= FLIGHT_MODE_STAB; break;
-            case PLANE_MODE_FLY_BY_WIRE_A: pdpfct->flight_mode |= FLIGHT_MODE_FBWA; break;
-            case PLANE_MODE_FLY_BY_WIRE_B: pdpfct->flight_mode |= FLIGHT_MODE_FBWB; break;
-            case PLANE_MODE_ACRO: pdpfct->flight_mode |= FLIGHT_MODE_ACRO; break;
-            case PLANE_MODE_AUTO: pdpfct->flight_mode |= FLIGHT_MODE_AUTO; break;
-            case PLANE_MODE_AUTOTUNE: pdpfct->flight_mode |= FLIGHT_MODE_AUTOTUNE; break;
-            case PLANE_MODE_RTL: pdpfct->flight_mode |= FLIGHT_MODE_RTL; break;
-            case PLANE_MODE_LOITER: pdpfct->flight_mode |= FLIGHT_MODE_LOITER; break;
-            case PLANE_MODE_TAKEOFF: pdpfct->flight_mode |= FLIGHT_MODE_TAKEOFF; break;
-            case PLANE_MODE_CRUISE: pdpfct->flight_mode |= FLIGHT_MODE_CRUISE; break;
-            case PLANE_MODE_QSTABILIZE: pdpfct->flight_mode |= FLIGHT_MODE_QSTAB; break;
-            case PLANE_MODE_QHOVER: pdpfct->flight_mode |= FLIGHT_MODE_QHOVER; break;
-            case PLANE_MODE_QLOITER: pdpfct->flight_mode |= FLIGHT_MODE_QLOITER; break;
-            case PLANE_MODE_QLAND: pdpfct->flight_mode |= FLIGHT_MODE_QLAND; break;
-            case PLANE_MODE_QRTL: pdpfct->flight_mode |= FLIGHT_MODE_QRTL; break;
-         };
-         }
-         else if ( (vehicleType & MODEL_TYPE_MASK) == MODEL_TYPE_CAR )
-         {
-         switch ( tmp32 )
+   if ( (vehicleType & MODEL_TYPE_MASK) == MODEL_TYPE_AIRPLANE )
+   {
+   //log_line("plane tmp32: %u", tmp32);
+   switch ( tmp32 )
+   {
+      case PLANE_MODE_MANUAL: pdpfct->flight_mode |= FLIGHT_MODE_MANUAL; break;
+      case PLANE_MODE_CIRCLE: pdpfct->flight_mode |= FLIGHT_MODE_CIRCLE; break;
+      case PLANE_MODE_STABILIZE: pdpfct->flight_mode |= FLIGHT_MODE_STAB; break;
+      case PLANE_MODE_FLY_BY_WIRE_A: pdpfct->flight_mode |= FLIGHT_MODE_FBWA; break;
+      case PLANE_MODE_FLY_BY_WIRE_B: pdpfct->flight_mode |= FLIGHT_MODE_FBWB; break;
+      case PLANE_MODE_ACRO: pdpfct->flight_mode |= FLIGHT_MODE_ACRO; break;
+      case PLANE_MODE_AUTO: pdpfct->flight_mode |= FLIGHT_MODE_AUTO; break;
+      case PLANE_MODE_AUTOTUNE: pdpfct->flight_mode |= FLIGHT_MODE_AUTOTUNE; break;
+      case PLANE_MODE_RTL: pdpfct->flight_mode |= FLIGHT_MODE_RTL; break;
+      case PLANE_MODE_LOITER: pdpfct->flight_mode |= FLIGHT_MODE_LOITER; break;
+      case PLANE_MODE_TAKEOFF: pdpfct->flight_mode |= FLIGHT_MODE_TAKEOFF; break;
+      case PLANE_MODE_CRUISE: pdpfct->flight_mode |= FLIGHT_MODE_CRUISE; break;
+      case PLANE_MODE_QSTABILIZE: pdpfct->flight_mode |= FLIGHT_MODE_QSTAB; break;
+      case PLANE_MODE_QHOVER: pdpfct->flight_mode |= FLIGHT_MODE_QHOVER; break;
+      case PLANE_MODE_QLOITER: pdpfct->flight_mode |= FLIGHT_MODE_QLOITER; break;
+      case PLANE_MODE_QLAND: pdpfct->flight_mode |= FLIGHT_MODE_QLAND; break;
+      case PLANE_MODE_QRTL: pdpfct->flight_mode |= FLIGHT_MODE_QRTL; break;
+   };
+   }
+   else if ( (vehicleType & MODEL_TYPE_MASK) == MODEL_TYPE_CAR )
+   {
+   switch ( tmp32 )
+   {
+      case ROVER_MODE_MANUAL: pdpfct->flight_mode |= FLIGHT_MODE_MANUAL; break;
+      case ROVER_MODE_ACRO:   pdpfct->flight_mode |= FLIGHT_MODE_ACRO; break;
+      case ROVER_MODE_STEERING: pdpfct->flight_mode |= FLIGHT_MODE_STAB; break;
+      case ROVER_MODE_HOLD:   pdpfct->flight_mode |= FLIGHT_MODE_POSHOLD; break;
+      case ROVER_MODE_LOITER: pdpfct->flight_mode |= FLIGHT_MODE_LOITER; break;
+      case ROVER_MODE_RTL:    pdpfct->flight_mode |= FLIGHT_MODE_RTL; break;
+      case ROVER_MODE_SMART_RTL: pdpfct->flight_mode |= FLIGHT_MODE_RTL; break;
+   };
+   }
+   else
+   {
+   //log_line("drone tmp32: %u", tmp32);
+   switch ( tmp32 )
+   {
+      case COPTER_MODE_STABILIZE: pdpfct->flight_mode |= FLIGHT_MODE_STAB; break;
+      case COPTER_MODE_ALT_HOLD: pdpfct->flight_mode |= FLIGHT_MODE_ALTH; break;
+      case COPTER_MODE_LOITER: pdpfct->flight_mode |= FLIGHT_MODE_LOITER; break;
+      case COPTER_MODE_AUTO: pdpfct->flight_mode |= FLIGHT_MODE_AUTO; break;
+      case COPTER_MODE_LAND: pdpfct->flight_mode |= FLIGHT_MODE_LAND; break;
+      case COPTER_MODE_RTL: pdpfct->flight_mode |= FLIGHT_MODE_RTL; break;
+      case COPTER_MODE_SMART_RTL: pdpfct->flight_mode |= FLIGHT_MODE_RTL; break;
+      case COPTER_MODE_AUTOTUNE: pdpfct->flight_mode |= FLIGHT_MODE_AUTOTUNE; break;
+      case COPTER_MODE_POSHOLD: pdpfct->flight_mode |= FLIGHT_MODE_POSHOLD; break;
+      case COPTER_MODE_ACRO: pdpfct->flight_mode |= FLIGHT_MODE_ACRO; break;
+      case COPTER_MODE_CIRCLE: pdpfct->flight_mode |= FLIGHT_MODE_CIRCLE; break;
+   };
+   }
+   if ( pdpfct->flight_mode & FLIGHT_MODE_ARMED )
+      pdpfct->uFCFlags |= FC_TELE_FLAGS_ARMED;
+   else
+      pdpfct->uFCFlags &= ~FC_TELE_FLAGS_ARMED;
+
+   if ( s_bTelemetryForceAlwaysArmed )
+      pdpfct->flight_mode |= FLIGHT_MODE_ARMED;
+
+   s_bHasReceivedHeartbeat = true;
+   s_iHeartbeatMsgCount++;
+}
+
+static void _mav_on_battery_status(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+{
+   int imah = 0;
+
+   imah = mavlink_msg_battery_status_get_current_consumed(pMsg);
+   pdpfct->mah = (imah<0)?0:imah;
+}
+
+static void _mav_on_sys_status(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+{
+   int imah = 0;
+
+   imah = mavlink_msg_sys_status_get_current_battery(pMsg);
+   pdpfct->voltage = mavlink_msg_sys_status_get_voltage_battery(pMsg);
+   pdpfct->current = (imah<0)?0:(imah*10U);
+   s_iSystemMsgCount++;
+}
+
+static void _mav_on_global_position_int(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+{
+   pdpfct->altitude_abs = mavlink_msg_global_position_int_get_alt(pMsg) / 10.0f + 100000;
+   pdpfct->altitude = mavlink_msg_global_position_int_get_relative_alt(pMsg) / 10.0f + 100000;
+   //log_line("alt: %f, abs: %f", ((int)pdpfct->altitude-100000)/100.0, ((int)pdpfct->altitude_abs-100000)/100.0);
+   {
+      if ( s_bShowLocalVerticalSpeed )
+      {
+         if ( s_TimeLastMAVLink_Altitude == 0 )
          {
-            case ROVER_MODE_MANUAL: pdpfct->flight_mode |= FLIGHT_MODE_MANUAL; break;
-            case ROVER_MODE_ACRO:   pdpfct->flight_mode |= FLIGHT_MODE_ACRO; break;
-            case ROVER_MODE_STEERING: pdpfct->flight_mode |= FLIGHT_MODE_STAB; break;
-            case ROVER_MODE_HOLD:   pdpfct->flight_mode |= FLIGHT_MODE_POSHOLD; break;
-            case ROVER_MODE_LOITER: pdpfct->flight_mode |= FLIGHT_MODE_LOITER; break;
-            case ROVER_MODE_RTL:    pdpfct->flight_mode |= FLIGHT_MODE_RTL; break;
-            case ROVER_MODE_SMART_RTL: pdpfct->flight_mode |= FLIGHT_MODE_RTL; break;
-         };
+            s_TimeLastMAVLink_Altitude = get_current_timestamp_ms();
+            s_LastMAVLink_Altitude = ((long)pdpfct->altitude) - 100000;
+            pdpfct->vspeed = 100000;
          }
          else
          {
-         //log_line("drone tmp32: %u", tmp32);
-         switch ( tmp32 )
-         {
-            case COPTER_MODE_STABILIZE: pdpfct->flight_mode |= FLIGHT_MODE_STAB; break;
-            case COPTER_MODE_ALT_HOLD: pdpfct->flight_mode |= FLIGHT_MODE_ALTH; break;
-            case COPTER_MODE_LOITER: pdpfct->flight_mode |= FLIGHT_MODE_LOITER; break;
-            case COPTER_MODE_AUTO: pdpfct->flight_mode |= FLIGHT_MODE_AUTO; break;
-            case COPTER_MODE_LAND: pdpfct->flight_mode |= FLIGHT_MODE_LAND; break;
-            case COPTER_MODE_RTL: pdpfct->flight_mode |= FLIGHT_MODE_RTL; break;
-            case COPTER_MODE_SMART_RTL: pdpfct->flight_mode |= FLIGHT_MODE_RTL; break;
-            case COPTER_MODE_AUTOTUNE: pdpfct->flight_mode |= FLIGHT_MODE_AUTOTUNE; break;
-            case COPTER_MODE_POSHOLD: pdpfct->flight_mode |= FLIGHT_MODE_POSHOLD; break;
-            case COPTER_MODE_ACRO: pdpfct->flight_mode |= FLIGHT_MODE_ACRO; break;
-            case COPTER_MODE_CIRCLE: pdpfct->flight_mode |= FLIGHT_MODE_CIRCLE; break;
-         };
+            long alt = ((long)pdpfct->altitude) - 100000;
+            if ( get_current_timestamp_ms() > s_TimeLastMAVLink_Altitude )
+            {
+               long dTime = get_current_timestamp_ms() - s_TimeLastMAVLink_Altitude;
+               float vspeed = (float)(alt - s_LastMAVLink_Altitude)*1000.0/(float)dTime;
+               //log_line("alt: %d - %d, %d, %f, dt: %d", alt, s_LastMAVLink_Altitude, (long)vspeed, vspeed, dTime);
+               pdpfct->vspeed = (u32)(vspeed + 100000);
+            }
+            s_TimeLastMAVLink_Altitude = get_current_timestamp_ms();
+            s_LastMAVLink_Altitude = alt;
          }
-         if ( pdpfct->flight_mode & FLIGHT_MODE_ARMED )
-            pdpfct->uFCFlags |= FC_TELE_FLAGS_ARMED;
-         else
-            pdpfct->uFCFlags &= ~FC_TELE_FLAGS_ARMED;
+      }
+   }
+   pdpfct->heading = mavlink_msg_global_position_int_get_hdg(pMsg) / 100.0f;
 
-         if ( s_bTelemetryForceAlwaysArmed )
-            pdpfct->flight_mode |= FLIGHT_MODE_ARMED;
+   pdpfct->latitude = mavlink_msg_global_position_int_get_lat(pMsg);
+   pdpfct->longitude = mavlink_msg_global_position_int_get_lon(pMsg);
+   s_bHasReceivedGPSPos = true;
+}
 
-         s_bHasReceivedHeartbeat = true;
-         s_iHeartbeatMsgCount++;
-         break;
+static void _mav_on_gps_raw_int(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+{
+   pdpfct->gps_fix_type = mavlink_msg_gps_raw_int_get_fix_type(pMsg);
+   pdpfct->satelites = mavlink_msg_gps_raw_int_get_satellites_visible(pMsg);
+   pdpfct->hdop = mavlink_msg_gps_raw_int_get_eph(pMsg);
+   pdpfct->latitude = mavlink_msg_gps_raw_int_get_lat(pMsg);
+   pdpfct->longitude = mavlink_msg_gps_raw_int_get_lon(pMsg);
+   //uTmp32 = mavlink_msg_gps_raw_int_get_alt(pMsg)/1000.0f / 10.0 + 100000;
+   //if ( pdpfct->gps_fix_type >= GPS_FIX_TYPE_3D_FIX )
+   //   pdpfct->altitude_abs = uTmp32;
+
+   s_bHasReceivedGPSInfo = true;
+}
 
-      case MAVLINK_MSG_ID_BATTERY_STATUS:
-         imah = mavlink_msg_battery_status_get_current_consumed(&msgMav);
-         pdpfct->mah = (imah<0)?0:imah;
-         break;
+static void _mav_on_gps2_raw(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+{
+   pdpfct->extra_info[1] = mavlink_msg_gps2_raw_get_satellites_visible(pMsg);
+   pdpfct->extra_info[2] = mavlink_msg_gps2_raw_get_fix_type(pMsg);
+   u16 hdop = mavlink_msg_gps2_raw_get_eph(pMsg);
+   pdpfct->extra_info[3] = (hdop >> 8);
+   pdpfct->extra_info[4] = (hdop & 0xFF);
+   s_bHasReceivedGPSInfo = true;
+}
 
-      case MAVLINK_MSG_ID_SYS_STATUS:
-         imah = mavlink_msg_sys_status_get_current_battery(&msgMav);
-         pdpfct->voltage = mavlink_msg_sys_status_get_voltage_battery(&msgMav);
-         pdpfct->current = (imah<0)?0:(imah*10U);
-         s_iSystemMsgCount++;
-         break;
-      
-      case MAVLINK_MSG_ID_GLOBAL_POSITION_INT:
-         pdpfct->altitude_abs = mavlink_msg_global_position_int_get_alt(&msgMav) / 10.0f + 100000;
-         pdpfct->altitude = mavlink_msg_global_position_int_get_relative_alt(&msgMav) / 10.0f + 100000;
-         //log_line("alt: %f, abs: %f", ((int)pdpfct->altitude-100000)/100.0, ((int)pdpfct->altitude_abs-100000)/100.0);
-         {
-            if ( s_bShowLocalVerticalSpeed )
-            {
-               if ( s_TimeLastMAVLink_Altitude == 0 )
-               {
-                  s_TimeLastMAVLink_Altitude = get_current_timestamp_ms();
-                  s_LastMAVLink_Altitude = ((long)pdpfct->altitude) - 100000;
-                  pdpfct->vspeed = 100000;
-               }
-               else
-               {
-                  long alt = ((long)pdpfct->altitude) - 100000;
-                  if ( get_current_timestamp_ms() > s_TimeLastMAVLink_Altitude )
-                  {
-                     long dTime = get_current_timestamp_ms() - s_TimeLastMAVLink_Altitude; 
-                     float vspeed = (float)(alt - s_LastMAVLink_Altitude)*1000.0/(float)dTime;
-                     //log_line("alt: %d - %d, %d, %f, dt: %d", alt, s_LastMAVLink_Altitude, (long)vspeed, vspeed, dTime);
-                     pdpfct->vspeed = (u32)(vspeed + 100000);
-                  }
-                  s_TimeLastMAVLink_Altitude = get_current_timestamp_ms();
-                  s_LastMAVLink_Altitude = alt;
-               }
-            }
-         }
-         pdpfct->heading = mavlink_msg_global_position_int_get_hdg(&msgMav) / 100.0f;
+static void _mav_on_vfr_hud(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+{
+   u32 tmp32 = 0;
 
-         pdpfct->latitude = mavlink_msg_global_position_int_get_lat(&msgMav);
-         pdpfct->longitude = mavlink_msg_global_position_int_get_lon(&msgMav);
-         s_bHasReceivedGPSPos = true;
-         break;
+   pdpfct->throttle = mavlink_msg_vfr_hud_get_throttle(pMsg);
+   if ( pdpfct->throttle > 200 )
+      pdpfct->throttle = 0;
+   if ( pdpfct->throttle > 100 )
+      pdpfct->throttle = 100;
+   //pdpfct->altitude = mavlink_msg_vfr_hud_get_alt(pMsg)*100 + 100000;
 
-     case MAVLINK_MSG_ID_GPS_RAW_INT:
-         pdpfct->gps_fix_type = mavlink_msg_gps_raw_int_get_fix_type(&msgMav);
-         pdpfct->satelites = mavlink_msg_gps_raw_int_get_satellites_visible(&msgMav);
-         pdpfct->hdop = mavlink_msg_gps_raw_int_get_eph(&msgMav);
-         pdpfct->latitude = mavlink_msg_gps_raw_int_get_lat(&msgMav);
-         pdpfct->longitude = mavlink_msg_gps_raw_int_get_lon(&msgMav);
-         //uTmp32 = mavlink_msg_gps_raw_int_get_alt(&msgMav)/1000.0f / 10.0 + 100000;
-         //if ( pdpfct->gps_fix_type >= GPS_FIX_TYPE_3D_FIX )
-         //   pdpfct->altitude_abs = uTmp32;
-
-         s_bHasReceivedGPSInfo = true;
-         break;
+   if ( ! s_bShowLocalVerticalSpeed )
+      pdpfct->vspeed = mavlink_msg_vfr_hud_get_climb(pMsg)*100 + 100000;
+   pdpfct->hspeed = mavlink_msg_vfr_hud_get_groundspeed(pMsg) * 100.0f + 100000;
 
-      case MAVLINK_MSG_ID_GPS2_RAW:
+   tmp32= mavlink_msg_vfr_hud_get_airspeed(pMsg) * 100.0f + 100000;
+   pdpfct->aspeed = tmp32;
+}
+
+static void _mav_on_attitude(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+{
+   pdpfct->uFCFlags |= FC_TELE_FLAGS_HAS_ATTITUDE;
+   pdpfct->roll = (mavlink_msg_attitude_get_roll(pMsg) + 3.141592653589793)*5700.2958;
+   pdpfct->pitch = (mavlink_msg_attitude_get_pitch(pMsg) + 3.141592653589793)*5700.2958;
+}
+
+static void _mav_on_rc_channels_raw(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+{
+   int tmpi = 0;
+
+   tmpi = (int)((u8)mavlink_msg_rc_channels_raw_get_rssi(pMsg));
+
+   if ( /*(tmpi != 255) &&*/ (NULL != pPHRTE) )
+   {
+      pdpfct->rc_rssi = (tmpi*100)/255;
+      if ( ! (pPHRTE->uRubyFlags & FLAG_RUBY_TELEMETRY_HAS_MAVLINK_RC_RSSI) )
       {
-         pdpfct->extra_info[1] = mavlink_msg_gps2_raw_get_satellites_visible(&msgMav);
-         pdpfct->extra_info[2] = mavlink_msg_gps2_raw_get_fix_type(&msgMav);
-         u16 hdop = mavlink_msg_gps2_raw_get_eph(&msgMav);
-         pdpfct->extra_info[3] = (hdop >> 8);
-         pdpfct->extra_info[4] = (hdop & 0xFF);
-         s_bHasReceivedGPSInfo = true;
-         break;
+         log_line("Received RC RSSI from FC through MAVLink, value: %d", pdpfct->rc_rssi);
+         pPHRTE->uRubyFlags |= FLAG_RUBY_TELEMETRY_HAS_MAVLINK_RC_RSSI;
       }
-      
-      case MAVLINK_MSG_ID_VFR_HUD: 
-         pdpfct->throttle = mavlink_msg_vfr_hud_get_throttle(&msgMav);
-         if ( pdpfct->throttle > 200 )
-            pdpfct->throttle = 0;
-         if ( pdpfct->throttle > 100 )
-            pdpfct->throttle = 100;
-         //pdpfct->altitude = mavlink_msg_vfr_hud_get_alt(&msgMav)*100 + 100000;
-
-         if ( ! s_bShowLocalVerticalSpeed )
-            pdpfct->vspeed = mavlink_msg_vfr_hud_get_climb(&msgMav)*100 + 100000; 
-         pdpfct->hspeed = mavlink_msg_vfr_hud_get_groundspeed(&msgMav) * 100.0f + 100000;
-
-         tmp32= mavlink_msg_vfr_hud_get_airspeed(&msgMav) * 100.0f + 100000;
-         pdpfct->aspeed = tmp32;
-         break;
+      pPHRTE->uplink_mavlink_rc_rssi = pdpfct->rc_rssi;
+   }
+   //if ( NULL != pPHRTE && (pPHRTE->uRubyFlags & FLAG_RUBY_TELEMETRY_HAS_MAVLINK_RC_RSSI) && (tmpi == 255) )
+   //   pPHRTE->uplink_mavlink_rc_rssi = 255;
+
+   s_MAVLinkRCChannels[0] = mavlink_msg_rc_channels_raw_get_chan1_raw(pMsg);
+   s_MAVLinkRCChannels[1] = mavlink_msg_rc_channels_raw_get_chan2_raw(pMsg);
+   s_MAVLinkRCChannels[2] = mavlink_msg_rc_channels_raw_get_chan3_raw(pMsg);
+   s_MAVLinkRCChannels[3] = mavlink_msg_rc_channels_raw_get_chan4_raw(pMsg);
+   s_MAVLinkRCChannels[4] = mavlink_msg_rc_channels_raw_get_chan5_raw(pMsg);
+   s_MAVLinkRCChannels[5] = mavlink_msg_rc_channels_raw_get_chan6_raw(pMsg);
+   s_MAVLinkRCChannels[6] = mavlink_msg_rc_channels_raw_get_chan7_raw(pMsg);
+   s_MAVLinkRCChannels[7] = mavlink_msg_rc_channels_raw_get_chan8_raw(pMsg);
+}
 
-      case MAVLINK_MSG_ID_ATTITUDE: 
-         pdpfct->uFCFlags |= FC_TELE_FLAGS_HAS_ATTITUDE;
-         pdpfct->roll = (mavlink_msg_attitude_get_roll(&msgMav) + 3.141592653589793)*5700.2958;
-         pdpfct->pitch = (mavlink_msg_attitude_get_pitch(&msgMav) + 3.141592653589793)*5700.2958;
-         break;
+static void _mav_on_rc_channels(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+{
+   int tmpi = 0;
 
-      case MAVLINK_MSG_ID_RC_CHANNELS_RAW:
-         tmpi = (int)((u8)mavlink_msg_rc_channels_raw_get_rssi(&msgMav));
-         
-         if ( /*(tmpi != 255) &&*/ (NULL != pPHRTE) )
-         {
-            pdpfct->rc_rssi = (tmpi*100)/255;
-            if ( ! (pPHRTE->uRubyFlags & FLAG_RUBY_TELEMETRY_HAS_MAVLINK_RC_RSSI) )
-            {
-               log_line("Received RC RSSI from FC through MAVLink, value: %d", pdpfct->rc_rssi);
-               pPHRTE->uRubyFlags |= FLAG_RUBY_TELEMETRY_HAS_MAVLINK_RC_RSSI;
-            }
-            pPHRTE->uplink_mavlink_rc_rssi = pdpfct->rc_rssi;
-         }
-         //if ( NULL != pPHRTE && (pPHRTE->uRubyFlags & FLAG_RUBY_TELEMETRY_HAS_MAVLINK_RC_RSSI) && (tmpi == 255) )
-         //   pPHRTE->uplink_mavlink_rc_rssi = 255;
-
-         s_MAVLinkRCChannels[0] = mavlink_msg_rc_channels_raw_get_chan1_raw(&msgMav);
-         s_MAVLinkRCChannels[1] = mavlink_msg_rc_channels_raw_get_chan2_raw(&msgMav);
-         s_MAVLinkRCChannels[2] = mavlink_msg_rc_channels_raw_get_chan3_raw(&msgMav);
-         s_MAVLinkRCChannels[3] = mavlink_msg_rc_channels_raw_get_chan4_raw(&msgMav);
-         s_MAVLinkRCChannels[4] = mavlink_msg_rc_channels_raw_get_chan5_raw(&msgMav);
-         s_MAVLinkRCChannels[5] = mavlink_msg_rc_channels_raw_get_chan6_raw(&msgMav);
-         s_MAVLinkRCChannels[6] = mavlink_msg_rc_channels_raw_get_chan7_raw(&msgMav);
-         s_MAVLinkRCChannels[7] = mavlink_msg_rc_channels_raw_get_chan8_raw(&msgMav);
-         break;
+   tmpi = (int)((u8)mavlink_msg_rc_channels_get_rssi(pMsg));
 
-      case MAVLINK_MSG_ID_RC_CHANNELS:
-         tmpi = (int)((u8)mavlink_msg_rc_channels_get_rssi(&msgMav));
-         
-         if ( /*(tmpi != 255) &&*/ (NULL != pPHRTE) )
-         {
-            pdpfct->rc_rssi = (tmpi*100)/255;
-            if ( ! (pPHRTE->uRubyFlags & FLAG_RUBY_TELEMETRY_HAS_MAVLINK_RC_RSSI) )
-            {
-               log_line("Received RC RSSI from FC through MAVLink, value: %d", pdpfct->rc_rssi);
-               pPHRTE->uRubyFlags |= FLAG_RUBY_TELEMETRY_HAS_MAVLINK_RC_RSSI;
-            }
-            pPHRTE->uplink_mavlink_rc_rssi = pdpfct->rc_rssi;
-         }
-         //if ( NULL != pPHRTE && (pPHRTE->uRubyFlags & FLAG_RUBY_TELEMETRY_HAS_MAVLINK_RC_RSSI) && (tmpi == 255) )
-         //   pPHRTE->uplink_mavlink_rc_rssi = 255;
-
-         s_MAVLinkRCChannels[0] = mavlink_msg_rc_channels_get_chan1_raw(&msgMav);
-         s_MAVLinkRCChannels[1] = mavlink_msg_rc_channels_get_chan2_raw(&msgMav);
-         s_MAVLinkRCChannels[2] = mavlink_msg_rc_channels_get_chan3_raw(&msgMav);
-         s_MAVLinkRCChannels[3] = mavlink_msg_rc_channels_get_chan4_raw(&msgMav);
-         s_MAVLinkRCChannels[4] = mavlink_msg_rc_channels_get_chan5_raw(&msgMav);
-         s_MAVLinkRCChannels[5] = mavlink_msg_rc_channels_get_chan6_raw(&msgMav);
-         s_MAVLinkRCChannels[6] = mavlink_msg_rc_channels_get_chan7_raw(&msgMav);
-         s_MAVLinkRCChannels[7] = mavlink_msg_rc_channels_get_chan8_raw(&msgMav);
-         s_MAVLinkRCChannels[8] = mavlink_msg_rc_channels_get_chan9_raw(&msgMav);
-         s_MAVLinkRCChannels[9] = mavlink_msg_rc_channels_get_chan10_raw(&msgMav);
-         s_MAVLinkRCChannels[10] = mavlink_msg_rc_channels_get_chan11_raw(&msgMav);
-         s_MAVLinkRCChannels[11] = mavlink_msg_rc_channels_get_chan12_raw(&msgMav);
-         s_MAVLinkRCChannels[12] = mavlink_msg_rc_channels_get_chan13_raw(&msgMav);
-         s_MAVLinkRCChannels[13] = mavlink_msg_rc_channels_get_chan14_raw(&msgMav);         
-         break;
+   if ( /*(tmpi != 255) &&*/ (NULL != pPHRTE) )
+   {
+      pdpfct->rc_rssi = (tmpi*100)/255;
+      if ( ! (pPHRTE->uRubyFlags & FLAG_RUBY_TELEMETRY_HAS_MAVLINK_RC_RSSI) )
+      {
+         log_line("Received RC RSSI from FC through MAVLink, value: %d", pdpfct->rc_rssi);
+         pPHRTE->uRubyFlags |= FLAG_RUBY_TELEMETRY_HAS_MAVLINK_RC_RSSI;
+      }
+      pPHRTE->uplink_mavlink_rc_rssi = pdpfct->rc_rssi;
+   }
+   //if ( NULL != pPHRTE && (pPHRTE->uRubyFlags & FLAG_RUBY_TELEMETRY_HAS_MAVLINK_RC_RSSI) && (tmpi == 255) )
+   //   pPHRTE->uplink_mavlink_rc_rssi = 255;
+
+   s_MAVLinkRCChannels[0] = mavlink_msg_rc_channels_get_chan1_raw(pMsg);
+   s_MAVLinkRCChannels[1] = mavlink_msg_rc_channels_get_chan2_raw(pMsg);
+   s_MAVLinkRCChannels[2] = mavlink_msg_rc_channels_get_chan3_raw(pMsg);
+   s_MAVLinkRCChannels[3] = mavlink_msg_rc_channels_get_chan4_raw(pMsg);
+   s_MAVLinkRCChannels[4] = mavlink_msg_rc_channels_get_chan5_raw(pMsg);
+   s_MAVLinkRCChannels[5] = mavlink_msg_rc_channels_get_chan6_raw(pMsg);
+   s_MAVLinkRCChannels[6] = mavlink_msg_rc_channels_get_chan7_raw(pMsg);
+   s_MAVLinkRCChannels[7] = mavlink_msg_rc_channels_get_chan8_raw(pMsg);
+   s_MAVLinkRCChannels[8] = mavlink_msg_rc_channels_get_chan9_raw(pMsg);
+   s_MAVLinkRCChannels[9] = mavlink_msg_rc_channels_get_chan10_raw(pMsg);
+   s_MAVLinkRCChannels[10] = mavlink_msg_rc_channels_get_chan11_raw(pMsg);
+   s_MAVLinkRCChannels[11] = mavlink_msg_rc_channels_get_chan12_raw(pMsg);
+   s_MAVLinkRCChannels[12] = mavlink_msg_rc_channels_get_chan13_raw(pMsg);
+   s_MAVLinkRCChannels[13] = mavlink_msg_rc_channels_get_chan14_raw(pMsg);
+}
 
-      case MAVLINK_MSG_ID_RADIO_STATUS:
-         tmp8 = ((int)mavlink_msg_radio_status_get_rssi(&msgMav))*100/255;
-         //if ( tmp8 != 0xFF )
-         //   pdpfct->rc_rssi = tmp8;
+static void _mav_on_radio_status(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+{
+   u8 tmp8 = 0;
 
-         if ( NULL != pPHRTE )
-         {
-            if ( ! (pPHRTE->uRubyFlags & FLAG_RUBY_TELEMETRY_HAS_MAVLINK_RX_RSSI) )
-            {
-               log_line("Received RX RSSI from FC through MAVLink, value: %d", tmp8);
-               pPHRTE->uRubyFlags |= FLAG_RUBY_TELEMETRY_HAS_MAVLINK_RX_RSSI;
-            }
-            pPHRTE->uplink_mavlink_rx_rssi = tmp8;
-         }
-         break;
+   tmp8 = ((int)mavlink_msg_radio_status_get_rssi(pMsg))*100/255;
+   //if ( tmp8 != 0xFF )
+   //   pdpfct->rc_rssi = tmp8;
 
-      case MAVLINK_MSG_ID_RAW_IMU:
-         //log_line("MSG_RAW_IMU");
-         break;
+   if ( NULL != pPHRTE )
+   {
+      if ( ! (pPHRTE->uRubyFlags & FLAG_RUBY_TELEMETRY_HAS_MAVLINK_RX_RSSI) )
+      {
+         log_line("Received RX RSSI from FC through MAVLink, value: %d", tmp8);
+         pPHRTE->uRubyFlags |= FLAG_RUBY_TELEMETRY_HAS_MAVLINK_RX_RSSI;
+      }
+      pPHRTE->uplink_mavlink_rx_rssi = tmp8;
+   }
+}
 
-      case MAVLINK_MSG_ID_SCALED_IMU:
-         //log_line("MSG_SCALED_IMU");
-         break;
+static void _mav_on_high_latency(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+{
+   //log_line("MSG_HIGH_LAT");
+   int iTemp = mavlink_msg_high_latency_get_temperature(pMsg);
+   if ( iTemp < 100 && iTemp > -100 )
+      pdpfct->temperatureC = 100 + (int) iTemp;
+
+   iTemp = mavlink_msg_high_latency_get_temperature_air(pMsg);
+   if ( iTemp < 100 && iTemp > -100 )
+      pdpfct->temperatureC = 100 + (int) iTemp;
+}
 
-      case MAVLINK_MSG_ID_HIGH_LATENCY:
-         {
-            //log_line("MSG_HIGH_LAT");
-            int iTemp = mavlink_msg_high_latency_get_temperature(&msgMav);
-            if ( iTemp < 100 && iTemp > -100 )
-               pdpfct->temperatureC = 100 + (int) iTemp;
-
-            iTemp = mavlink_msg_high_latency_get_temperature_air(&msgMav);
-            if ( iTemp < 100 && iTemp > -100 )
-               pdpfct->temperatureC = 100 + (int) iTemp;
-         }
-         break;
+static void _mav_on_high_latency2(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+{
+   //log_line("MSG_HIGH_LAT2");
+   int iTemp = mavlink_msg_high_latency2_get_temperature_air(pMsg);
+   if ( iTemp < 100 && iTemp > -100 )
+      pdpfct->temperatureC = 100 + (int) iTemp;
+
+   u16 uDir = 2 * mavlink_msg_high_latency2_get_wind_heading(pMsg);
+   uDir++;
+   pdpfct->extra_info[7] = uDir >> 8;
+   pdpfct->extra_info[8] = uDir & 0xFF;
+
+   u16 uSpeed = 100 * mavlink_msg_high_latency2_get_windspeed(pMsg) / 5;
+   uSpeed++;
+   pdpfct->extra_info[9] = uSpeed >> 8;
+   pdpfct->extra_info[10] = uSpeed & 0xFF;
+}
 
-      case MAVLINK_MSG_ID_HIGH_LATENCY2:
-         {
-            //log_line("MSG_HIGH_LAT2");
-            int iTemp = mavlink_msg_high_latency2_get_temperature_air(&msgMav);
-            if ( iTemp < 100 && iTemp > -100 )
-               pdpfct->temperatureC = 100 + (int) iTemp;
-
-            u16 uDir = 2 * mavlink_msg_high_latency2_get_wind_heading(&msgMav);
-            uDir++;
-            pdpfct->extra_info[7] = uDir >> 8;
-            pdpfct->extra_info[8] = uDir & 0xFF;
-             
-            u16 uSpeed = 100 * mavlink_msg_high_latency2_get_windspeed(&msgMav) / 5;
-            uSpeed++;
-            pdpfct->extra_info[9] = uSpeed >> 8;
-            pdpfct->extra_info[10] = uSpeed & 0xFF;
-         }
-         break;
+static void _mav_on_scaled_pressure(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+{
+   //log_line("SCALED PRESSURE");
+   int iTemp = mavlink_msg_scaled_pressure_get_temperature(pMsg);
+   iTemp = iTemp/100;
+   if ( iTemp < 100 && iTemp > -100 )
+      pdpfct->temperatureC = 100 + (int) iTemp;
+}
 
-      case MAVLINK_MSG_ID_SCALED_PRESSURE:
-         {
-            //log_line("SCALED PRESSURE");
-            int iTemp = mavlink_msg_scaled_pressure_get_temperature(&msgMav);
-            iTemp = iTemp/100;
-            if ( iTemp < 100 && iTemp > -100 )
-               pdpfct->temperatureC = 100 + (int) iTemp;
-         }
+static void _mav_on_wind_cov(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+{
+   //log_line("WIND_COV");
+   float fWindX = mavlink_msg_wind_cov_get_wind_x(pMsg);
+   float fWindY = mavlink_msg_wind_cov_get_wind_x(pMsg);
+   //float fWindZ = mavlink_msg_wind_cov_get_wind_x(pMsg);
+   if ( fabs(fWindX) + fabs(fWindY) > 0.0001 )
+   {
+      float fLen = sqrtf(fWindX*fWindX + fWindY * fWindY);
+      float fAngle = 3.1415*2.0*atan2f(fWindY, fWindX);
+      fAngle -= pdpfct->heading;
+      u16 uDir = (u16)fAngle;
+      uDir++;
+      pdpfct->extra_info[7] = uDir >> 8;
+      pdpfct->extra_info[8] = uDir & 0xFF;
+
+      u16 uSpeed = (u16)(fLen*100.0);
+      uSpeed++;
+      pdpfct->extra_info[9] = uSpeed >> 8;
+      pdpfct->extra_info[10] = uSpeed & 0xFF;
+   }
+   else
+   {
+      pdpfct->extra_info[7] = 0;
+      pdpfct->extra_info[8] = 0;
+      pdpfct->extra_info[9] = 0;
+      pdpfct->extra_info[10] = 0;
+   }
+}
 
-      /*
-      case MAVLINK_MSG_ID_WIND:
-         {
-            log_line("WIND");
-            u16 uDir = mavlink_msg_wind_get_direction(&msgMav);
-            pdpfct->extra_info[7] = uDir >> 8;
-            pdpfct->extra_info[8] = uDir & 0xFF;
-            float fSpeed = mavlink_msg_wind_get_speed(&msgMav);
-            u16 uSpeed = (u16)(fSpeed*100.0);
-            pdpfct->extra_info[9] = uSpeed >> 8;
-            pdpfct->extra_info[10] = uSpeed & 0xFF;
-         }
-      */
-
-      case MAVLINK_MSG_ID_WIND_COV:
-       {
-          //log_line("WIND_COV");
-          float fWindX = mavlink_msg_wind_cov_get_wind_x(&msgMav);
-          float fWindY = mavlink_msg_wind_cov_get_wind_x(&msgMav);
-          //float fWindZ = mavlink_msg_wind_cov_get_wind_x(&msgMav);
-          if ( fabs(fWindX) + fabs(fWindY) > 0.0001 )
-          {
-             float fLen = sqrtf(fWindX*fWindX + fWindY * fWindY);
-             float fAngle = 3.1415*2.0*atan2f(fWindY, fWindX);
-             fAngle -= pdpfct->heading;
-             u16 uDir = (u16)fAngle;
-             uDir++;
-             pdpfct->extra_info[7] = uDir >> 8;
-             pdpfct->extra_info[8] = uDir & 0xFF;
-
-             u16 uSpeed = (u16)(fLen*100.0);
-             uSpeed++;
-             pdpfct->extra_info[9] = uSpeed >> 8;
-             pdpfct->extra_info[10] = uSpeed & 0xFF;
-          }
-          else
-          {
-             pdpfct->extra_info[7] = 0;
-             pdpfct->extra_info[8] = 0;
-             pdpfct->extra_info[9] = 0;
-             pdpfct->extra_info[10] = 0;
-          }
-       }
-      case MAVLINK_MSG_ID_PARAM_VALUE:
-         /*
-         {
-            char szBuff[32];
-            szBuff[0] = '*';
-            szBuff[1] = 0;
-            mavlink_msg_param_value_get_param_id(&msgMav, szBuff);
-            u8 type = mavlink_msg_param_value_get_param_type(&msgMav);
-            //int val = (int)mavlink_msg_param_value_get_param_value(&msgMav);
-            //log_line("recv param '%s' (%d of %d),  value: %d", szBuff, (int)mavlink_msg_param_value_get_param_index(&msgMav), (int)mavlink_msg_param_value_get_param_count(&msgMav), val);
-            float val = (float)mavlink_msg_param_value_get_param_value(&msgMav);
-            log_line("recv param '%s'(%d of %d), type: %d, value: %f", szBuff, (int)mavlink_msg_param_value_get_param_index(&msgMav), (int)mavlink_msg_param_value_get_param_count(&msgMav), type, val);
-         }
-         */
-         break;
-      
+// Only the messages consumed by the OSD are registered (and decoded); all the other frames are
+// just counted (and forwarded as they are by the caller, if needed).
+typedef void (*t_mavlink_msg_handler)(mavlink_message_t* pMsg, t_packet_header_fc_telemetry* pdpfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType);
+
+typedef struct
+{
+   u32 uMsgId;
+   t_mavlink_msg_handler pHandler;
+} t_mavlink_msg_handler_entry;
+
+static const t_mavlink_msg_handler_entry s_MAVLinkMsgHandlers[] =
+{
+   { MAVLINK_MSG_ID_STATUSTEXT, _mav_on_statustext },
+   { MAVLINK_MSG_ID_STATUSTEXT_LONG, _mav_on_statustext_long },
+   { MAVLINK_MSG_ID_HEARTBEAT, _mav_on_heartbeat },
+   { MAVLINK_MSG_ID_BATTERY_STATUS, _mav_on_battery_status },
+   { MAVLINK_MSG_ID_SYS_STATUS, _mav_on_sys_status },
+   { MAVLINK_MSG_ID_GLOBAL_POSITION_INT, _mav_on_global_position_int },
+   { MAVLINK_MSG_ID_GPS_RAW_INT, _mav_on_gps_raw_int },
+   { MAVLINK_MSG_ID_GPS2_RAW, _mav_on_gps2_raw },
+   { MAVLINK_MSG_ID_VFR_HUD, _mav_on_vfr_hud },
+   { MAVLINK_MSG_ID_ATTITUDE, _mav_on_attitude },
+   { MAVLINK_MSG_ID_RC_CHANNELS_RAW, _mav_on_rc_channels_raw },
+   { MAVLINK_MSG_ID_RC_CHANNELS, _mav_on_rc_channels },
+   { MAVLINK_MSG_ID_RADIO_STATUS, _mav_on_radio_status },
+   { MAVLINK_MSG_ID_HIGH_LATENCY, _mav_on_high_latency },
+   { MAVLINK_MSG_ID_HIGH_LATENCY2, _mav_on_high_latency2 },
+   { MAVLINK_MSG_ID_SCALED_PRESSURE, _mav_on_scaled_pressure },
+   { MAVLINK_MSG_ID_WIND_COV, _mav_on_wind_cov }
+};
+
+#define MAVLINK_MSG_HANDLERS_COUNT ((int)(sizeof(s_MAVLinkMsgHandlers)/sizeof(s_MAVLinkMsgHandlers[0])))
+
+// Direct lookup for the message ids below 256: handler index + 1, 0 for none
+static u8 s_uMAVLinkMsgHandlersLookup[256];
+static bool s_bMAVLinkMsgHandlersLookupBuilt = false;
+
+static void _build_mav_handlers_lookup()
+{
+   memset(s_uMAVLinkMsgHandlersLookup, 0, sizeof(s_uMAVLinkMsgHandlersLookup));
+   for( int i=0; i<MAVLINK_MSG_HANDLERS_COUNT; i++ )
+   {
+      if ( s_MAVLinkMsgHandlers[i].uMsgId < 256 )
+         s_uMAVLinkMsgHandlersLookup[s_MAVLinkMsgHandlers[i].uMsgId] = (u8)(i+1);
+   }
+   s_bMAVLinkMsgHandlersLookupBuilt = true;
+}
+
+static t_mavlink_msg_handler _get_mav_handler(u32 uMsgId)
+{
+   if ( ! s_bMAVLinkMsgHandlersLookupBuilt )
+      _build_mav_handlers_lookup();
+
+   if ( uMsgId < 256 )
+   {
+      if ( 0 == s_uMAVLinkMsgHandlersLookup[uMsgId] )
+         return NULL;
+      return s_MAVLinkMsgHandlers[s_uMAVLinkMsgHandlersLookup[uMsgId]-1].pHandler;
    }
+   for( int i=0; i<MAVLINK_MSG_HANDLERS_COUNT; i++ )
+   {
+      if ( s_MAVLinkMsgHandlers[i].uMsgId == uMsgId )
+         return s_MAVLinkMsgHandlers[i].pHandler;
+   }
+   return NULL;
+}
+
+bool parse_telemetry_mavlink_frame(u8* pFrame, int iFrameLength, t_packet_header_fc_telemetry* pphfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType)
+{
+   if ( (NULL == pFrame) || (iFrameLength <= 0) )
+      return false;
+
+   // Frames of unknown messages are not CRC checked (they are only forwarded): they do not tell that the FC link is alive
+   if ( ! mavlink_frame_is_crc_checked(pFrame) )
+      return false;
+
+   if ( 0 == s_uTimeLastMAVLinkMessageFromFC )
+      log_line("Started receiving valid MAVLink telemetry from FC");
+   s_uTimeLastMAVLinkMessageFromFC = get_current_timestamp_ms();
+
+   if ( 0 == s_iAllowAnyVehicleSysId )
+   if ( (mavlink_frame_get_sysid(pFrame) != s_vehicleMavId) && (mavlink_frame_get_sysid(pFrame) != 0) )
+      return true;
+
+   t_mavlink_msg_handler pHandler = _get_mav_handler(mavlink_frame_get_msgid(pFrame));
+   if ( NULL == pHandler )
+      return true;
+   if ( ! mavlink_frame_decode(pFrame, iFrameLength, &msgMav) )
+      return true;
+   pHandler(&msgMav, pphfct, pPHRTE, vehicleType);
+   return true;
 }
 
 bool parse_telemetry_from_fc( u8* buffer, int length, t_packet_header_fc_telemetry* pphfct, t_packet_header_ruby_telemetry_extended_v6* pPHRTE, u8 vehicleType, int telemetry_type )
@@ -718,19 +795,13 @@ bool parse_telemetry_from_fc( u8* buffer, int length, t_packet_header_fc_telemet
       return parse_telemetry_from_fc_ltm(buffer, length, pphfct, pPHRTE, vehicleType);
 
    bool ret = false;
-   uint8_t c;
-   for( int i=0; i<length; i++)
+   int iFrameLength = 0;
+   u8* pFrame = NULL;
+   mavlink_frames_scanner_set_data(&s_MAVLinkFramesScanner, buffer, length);
+   while ( NULL != (pFrame = mavlink_frames_scanner_get_next(&s_MAVLinkFramesScanner, &iFrameLength)) )
    {
-      c = *buffer;
-      buffer++;
-      if (mavlink_parse_char(0, c, &msgMav, &statusMav))
-      {
-         if ( 0 == s_uTimeLastMAVLinkMessageFromFC )
-            log_line("Started receiving valid MAVLink telemetry from FC");
-         s_uTimeLastMAVLinkMessageFromFC = get_current_timestamp_ms();
+      if ( parse_telemetry_mavlink_frame(pFrame, iFrameLength, pphfct, pPHRTE, vehicleType) )
          ret = true;
-         _process_mav_message(pphfct, pPHRTE, vehicleType);
-      }
    }
    return ret;
 }
@@ -5,6 +5,8 @@
 
 void parse_telemetry_init(u32 vehicleMavId, bool bShowLocalVerticalSpeed);
 void parse_telemetry_allow_any_sysid(int iAllow);
+// Drops the partial MAVLink frame kept from the previous data (when the serial port is reopened)
+void parse_telemetry_reset_mavlink_scanner();
 void parse_telemetry_set_show_local_vspeed(bool bShowLocalVerticalSpeed);
 void parse_telemetry_remove_duplicate_messages(bool bRemove);
 void parse_telemetry_force_always_armed(bool bForce);
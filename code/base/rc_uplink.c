@@ -0,0 +1,339 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "base.h"
+#include "shared_mem.h"
+#include "rc_uplink.h"
+#include "ruby_ipc.h"
+#include <sys/mman.h>
+#include <poll.h>
+
+static void _rc_uplink_slot_get_doorbell_name(int iSlotId, char* szName, int iMaxLength)
+{
+   snprintf(szName, iMaxLength, "%s%d", RC_UPLINK_SLOT_DOORBELL_NAME_PREFIX, iSlotId);
+}
+
+int rc_uplink_slot_open(t_rc_uplink_slot_endpoint* pEndpoint, int iSlotId, int bIsReader)
+{
+   if ( NULL == pEndpoint )
+      return 0;
+   memset(pEndpoint, 0, sizeof(t_rc_uplink_slot_endpoint));
+   pEndpoint->iSlotId = iSlotId;
+   pEndpoint->iWaitFd = -1;
+
+   char szName[64];
+   snprintf(szName, sizeof(szName), "%s%d", SHARED_MEM_RC_UPLINK_SLOT, iSlotId);
+   pEndpoint->pSlot = (t_rc_uplink_slot*) open_shared_mem_for_write(szName, sizeof(t_rc_uplink_slot));
+   if ( NULL == pEndpoint->pSlot )
+   {
+      log_softerror_and_alarm("[RCUplink] Failed to open RC slot %d for %s.", iSlotId, bIsReader?"read":"write");
+      return 0;
+   }
+   if ( bIsReader )
+   {
+      pEndpoint->uLastSequence = __atomic_load_n(&pEndpoint->pSlot->uSequence, __ATOMIC_ACQUIRE);
+      rc_uplink_slot_get_wait_fd(pEndpoint);
+   }
+   log_line("[RCUplink] Opened RC slot %d for %s, sequence: %u", iSlotId, bIsReader?"read":"write", pEndpoint->pSlot->uSequence);
+   return 1;
+}
+
+void rc_uplink_slot_close(t_rc_uplink_slot_endpoint* pEndpoint)
+{
+   if ( NULL == pEndpoint )
+      return;
+   if ( NULL != pEndpoint->pSlot )
+   {
+      if ( pEndpoint->iWaitFd >= 0 )
+      {
+         __atomic_store_n(&pEndpoint->pSlot->uReaderWaiting, 0, __ATOMIC_RELAXED);
+         __atomic_store_n(&pEndpoint->pSlot->uTimeReaderAlive, 0, __ATOMIC_RELAXED);
+      }
+      munmap(pEndpoint->pSlot, sizeof(t_rc_uplink_slot));
+   }
+   if ( pEndpoint->iWaitFd >= 0 )
+      close(pEndpoint->iWaitFd);
+   pEndpoint->pSlot = NULL;
+   pEndpoint->iWaitFd = -1;
+}
+
+int rc_uplink_slot_write(t_rc_uplink_slot_endpoint* pEndpoint, u8* pPacket, int iLength, u32 uTimeInputMicros)
+{
+   if ( (NULL == pEndpoint) || (NULL == pEndpoint->pSlot) || (NULL == pPacket) )
+      return 0;
+   if ( (iLength <= 0) || (iLength > RC_UPLINK_SLOT_MAX_PACKET_SIZE) )
+      return 0;
+
+   t_rc_uplink_slot* pSlot = pEndpoint->pSlot;
+   u32 uTimeAlive = __atomic_load_n(&pSlot->uTimeReaderAlive, __ATOMIC_RELAXED);
+   u32 uTimeNow = get_current_timestamp_ms();
+   if ( (0 == uTimeAlive) || (uTimeNow - uTimeAlive > RC_UPLINK_SLOT_READER_TIMEOUT_MS) )
+      return 0;
+
+   u32 uSeq = pSlot->uSequence;
+   if ( uSeq & 0x01 )
+      uSeq++;
+   __atomic_store_n(&pSlot->uSequence, uSeq+1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+
+   memcpy(pSlot->uPacket, pPacket, iLength);
+   pSlot->uPacketLength = (u32)iLength;
+   pSlot->uTimeInputMicros = uTimeInputMicros;
+   pSlot->uTimeWrittenMicros = get_current_timestamp_micros();
+
+   __atomic_store_n(&pSlot->uSequence, uSeq+2, __ATOMIC_RELEASE);
+
+   // The reader sets its waiting flag before checking the sequence (rc_uplink_slot_begin_wait)
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   if ( __atomic_load_n(&pSlot->uReaderWaiting, __ATOMIC_RELAXED) )
+   {
+      char szDoorbell[64];
+      _rc_uplink_slot_get_doorbell_name(pEndpoint->iSlotId, szDoorbell, sizeof(szDoorbell));
+      ruby_ipc_doorbell_ring(szDoorbell);
+   }
+   return 1;
+}
+
+void rc_uplink_slot_mark_reader_alive(t_rc_uplink_slot_endpoint* pEndpoint, u32 uTimeNow)
+{
+   if ( (NULL == pEndpoint) || (NULL == pEndpoint->pSlot) )
+      return;
+   if ( 0 == uTimeNow )
+      uTimeNow = 1;
+   __atomic_store_n(&pEndpoint->pSlot->uTimeReaderAlive, uTimeNow, __ATOMIC_RELAXED);
+}
+
+void rc_uplink_slot_mark_reader_gone(t_rc_uplink_slot_endpoint* pEndpoint)
+{
+   if ( (NULL == pEndpoint) || (NULL == pEndpoint->pSlot) )
+      return;
+   __atomic_store_n(&pEndpoint->pSlot->uTimeReaderAlive, 0, __ATOMIC_RELAXED);
+   // A write in progress ends at the next even sequence
+   u32 uSeq = __atomic_load_n(&pEndpoint->pSlot->uSequence, __ATOMIC_ACQUIRE);
+   if ( uSeq & 0x01 )
+      uSeq++;
+   pEndpoint->uLastSequence = uSeq;
+}
+
+int rc_uplink_slot_get_wait_fd(t_rc_uplink_slot_endpoint* pEndpoint)
+{
+   if ( (NULL == pEndpoint) || (NULL == pEndpoint->pSlot) )
+      return -1;
+   if ( pEndpoint->iWaitFd >= 0 )
+      return pEndpoint->iWaitFd;
+
+   char szDoorbell[64];
+   _rc_uplink_slot_get_doorbell_name(pEndpoint->iSlotId, szDoorbell, sizeof(szDoorbell));
+   int iFd = ruby_ipc_doorbell_create(szDoorbell);
+   if ( iFd < 0 )
+   {
+      log_softerror_and_alarm("[RCUplink] Failed to create doorbell socket for RC slot %d, error: %s", pEndpoint->iSlotId, strerror(errno));
+      return -1;
+   }
+   pEndpoint->iWaitFd = iFd;
+   log_line("[RCUplink] Created doorbell for RC slot %d, fd: %d", pEndpoint->iSlotId, iFd);
+   return iFd;
+}
+
+int rc_uplink_slot_begin_wait(t_rc_uplink_slot_endpoint* pEndpoint)
+{
+   if ( (NULL == pEndpoint) || (NULL == pEndpoint->pSlot) || (pEndpoint->iWaitFd < 0) )
+      return 0;
+
+   __atomic_store_n(&pEndpoint->pSlot->uReaderWaiting, 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+   // A frame written before the flag was visible to the writer did not ring the doorbell
+   if ( __atomic_load_n(&pEndpoint->pSlot->uSequence, __ATOMIC_ACQUIRE) != pEndpoint->uLastSequence )
+      return 1;
+   return 0;
+}
+
+void rc_uplink_slot_end_wait(t_rc_uplink_slot_endpoint* pEndpoint)
+{
+   if ( (NULL == pEndpoint) || (NULL == pEndpoint->pSlot) || (pEndpoint->iWaitFd < 0) )
+      return;
+
+   __atomic_store_n(&pEndpoint->pSlot->uReaderWaiting, 0, __ATOMIC_RELAXED);
+   ruby_ipc_doorbell_clear(pEndpoint->iWaitFd);
+}
+
+void rc_uplink_slot_wait(t_rc_uplink_slot_endpoint* pEndpoint, int iTimeoutMs)
+{
+   if ( iTimeoutMs <= 0 )
+      return;
+   if ( (NULL == pEndpoint) || (NULL == pEndpoint->pSlot) || (pEndpoint->iWaitFd < 0) )
+   {
+      hardware_sleep_ms(iTimeoutMs);
+      return;
+   }
+   if ( ! rc_uplink_slot_begin_wait(pEndpoint) )
+   {
+      struct pollfd pfd;
+      pfd.fd = pEndpoint->iWaitFd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      poll(&pfd, 1, iTimeoutMs);
+   }
+   rc_uplink_slot_end_wait(pEndpoint);
+}
+
+int rc_uplink_slot_read(t_rc_uplink_slot_endpoint* pEndpoint, u8* pOutPacket, u32* puTimeInputMicros)
+{
+   if ( (NULL == pEndpoint) || (NULL == pEndpoint->pSlot) || (NULL == pOutPacket) )
+      return 0;
+
+   t_rc_uplink_slot* pSlot = pEndpoint->pSlot;
+   for( int iRetry=0; iRetry<4; iRetry++ )
+   {
+      u32 uSeq = __atomic_load_n(&pSlot->uSequence, __ATOMIC_ACQUIRE);
+      if ( uSeq == pEndpoint->uLastSequence )
+         return 0;
+      if ( uSeq & 0x01 )
+         continue;
+
+      u32 uLength = pSlot->uPacketLength;
+      u32 uTimeInput = pSlot->uTimeInputMicros;
+      if ( uLength > RC_UPLINK_SLOT_MAX_PACKET_SIZE )
+         uLength = 0;
+      memcpy(pOutPacket, pSlot->uPacket, uLength);
+
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if ( __atomic_load_n(&pSlot->uSequence, __ATOMIC_RELAXED) != uSeq )
+         continue;
+
+      pEndpoint->uLastSequence = uSeq;
+      if ( NULL != puTimeInputMicros )
+         *puTimeInputMicros = uTimeInput;
+      return (int)uLength;
+   }
+   return 0;
+}
+
+
+t_shared_mem_rc_latency* shared_mem_rc_latency_open_for_read()
+{
+   void *retVal = open_shared_mem_for_read(SHARED_MEM_RC_LATENCY, sizeof(t_shared_mem_rc_latency));
+   return (t_shared_mem_rc_latency*)retVal;
+}
+
+t_shared_mem_rc_latency* shared_mem_rc_latency_open_for_write()
+{
+   void *retVal = open_shared_mem_for_write(SHARED_MEM_RC_LATENCY, sizeof(t_shared_mem_rc_latency));
+   t_shared_mem_rc_latency* pLatency = (t_shared_mem_rc_latency*)retVal;
+   if ( NULL != pLatency )
+   {
+      memset(pLatency, 0, sizeof(t_shared_mem_rc_latency));
+      rc_latency_histogram_reset(&pLatency->inputToRadio);
+      rc_latency_histogram_reset(&pLatency->radioToFC);
+      rc_latency_histogram_reset(&pLatency->inputToFC);
+   }
+   return pLatency;
+}
+
+void shared_mem_rc_latency_close(t_shared_mem_rc_latency* pAddress)
+{
+   if ( NULL != pAddress )
+      munmap(pAddress, sizeof(t_shared_mem_rc_latency));
+}
+
+void rc_latency_histogram_reset(t_rc_latency_histogram* pHistogram)
+{
+   if ( NULL == pHistogram )
+      return;
+   memset(pHistogram, 0, sizeof(t_rc_latency_histogram));
+   pHistogram->uMinMicros = MAX_U32;
+}
+
+void rc_latency_histogram_add(t_rc_latency_histogram* pHistogram, u32 uMicros)
+{
+   if ( NULL == pHistogram )
+      return;
+   int iBucket = 0;
+   u32 uLimit = RC_LATENCY_HISTOGRAM_FIRST_BUCKET_MICROS;
+   while ( (iBucket < RC_LATENCY_HISTOGRAM_BUCKETS-1) && (uMicros > uLimit) )
+   {
+      iBucket++;
+      uLimit <<= 1;
+   }
+   pHistogram->uCounts[iBucket]++;
+   pHistogram->uSamples++;
+   pHistogram->uTotalMicros += uMicros;
+   pHistogram->uAverageMicros = (u32)(pHistogram->uTotalMicros / pHistogram->uSamples);
+   if ( uMicros < pHistogram->uMinMicros )
+      pHistogram->uMinMicros = uMicros;
+   if ( uMicros > pHistogram->uMaxMicros )
+      pHistogram->uMaxMicros = uMicros;
+}
+
+u32 rc_latency_histogram_get_percentile(t_rc_latency_histogram* pHistogram, int iPercent)
+{
+   if ( (NULL == pHistogram) || (0 == pHistogram->uSamples) )
+      return 0;
+   u32 uTarget = (u32)(((uint64_t)pHistogram->uSamples * (u32)iPercent + 99) / 100);
+   u32 uCount = 0;
+   u32 uLimit = RC_LATENCY_HISTOGRAM_FIRST_BUCKET_MICROS;
+   for( int i=0; i<RC_LATENCY_HISTOGRAM_BUCKETS-1; i++ )
+   {
+      uCount += pHistogram->uCounts[i];
+      if ( uCount >= uTarget )
+         return uLimit;
+      uLimit <<= 1;
+   }
+   return pHistogram->uMaxMicros;
+}
+
+void rc_latency_histogram_log(t_rc_latency_histogram* pHistogram, const char* szName)
+{
+   if ( (NULL == pHistogram) || (0 == pHistogram->uSamples) )
+      return;
+
+   char szBuckets[256];
+   szBuckets[0] = 0;
+   for( int i=0; i<RC_LATENCY_HISTOGRAM_BUCKETS; i++ )
+   {
+      char szTmp[32];
+      snprintf(szTmp, sizeof(szTmp), "%s%u", (0 == i)?"":" ", pHistogram->uCounts[i]);
+      strcat(szBuckets, szTmp);
+   }
+   log_line("[RCLatency] %s: %u samples, min/avg/max: %u/%u/%u us, p50 <= %u us, p95 <= %u us, buckets: [%s]",
+      (NULL != szName)?szName:"", pHistogram->uSamples, pHistogram->uMinMicros, pHistogram->uAverageMicros, pHistogram->uMaxMicros,
+      rc_latency_histogram_get_percentile(pHistogram, 50), rc_latency_histogram_get_percentile(pHistogram, 95), szBuckets);
+}
+
+u8 rc_latency_to_age_units(u32 uMicros)
+{
+   u32 uUnits = (uMicros + RC_FULL_FRAME_INPUT_AGE_UNIT_MICROS/2) / RC_FULL_FRAME_INPUT_AGE_UNIT_MICROS;
+   if ( uUnits > 255 )
+      uUnits = 255;
+   return (u8)uUnits;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "base.h"
+#include "../radio/radiopackets2.h"
+#include "../radio/radiopackets_rc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Latest value slot for the RC frames, on each side of the link:
+//  * controller: ruby_tx_rc writes each RC frame (a complete radio packet) here, the router sends it right away
+//    on the high priority radio queue (no IPC channel, no tx sync delay);
+//  * vehicle: ruby_rx_rc writes each received RC frame here, the telemetry process forwards it to the FC right away.
+// The slot is guarded by a sequence number (odd while the writer updates it); readers retry if it changed
+// while they copied the slot. A newer frame just overwrites an older one not read yet.
+// The writer rings a doorbell (ruby_ipc_doorbell_*) if the reader waits on it, same as the IPC rings.
+
+#define SHARED_MEM_RC_UPLINK_SLOT "R_SHARED_MEM_RC_UPLINK_SLOT_"
+#define RC_UPLINK_SLOT_DOORBELL_NAME_PREFIX "ruby_rc_bell_"
+
+#define RC_UPLINK_SLOT_CONTROLLER 0
+#define RC_UPLINK_SLOT_VEHICLE 1
+
+#define RC_UPLINK_SLOT_MAX_PACKET_SIZE 128
+// The writer falls back to the regular IPC channels if the reader did not mark itself alive for this long
+#define RC_UPLINK_SLOT_READER_TIMEOUT_MS 500
+
+typedef struct
+{
+   u32 uSequence;
+   u32 uReaderWaiting;
+   u32 uTimeReaderAlive; // ms, set by the reader
+   u32 uPacketLength;
+   u32 uTimeInputMicros; // controller: when the input in the frame was read; vehicle: when the frame was received
+   u32 uTimeWrittenMicros;
+   u8  uPacket[RC_UPLINK_SLOT_MAX_PACKET_SIZE];
+} t_rc_uplink_slot;
+
+typedef struct
+{
+   int iSlotId;
+   t_rc_uplink_slot* pSlot;
+   int iWaitFd; // reader only
+   u32 uLastSequence; // reader only
+} t_rc_uplink_slot_endpoint;
+
+// Both ends open the slot for read/write (the reader marks itself alive and waiting in it)
+int rc_uplink_slot_open(t_rc_uplink_slot_endpoint* pEndpoint, int iSlotId, int bIsReader);
+void rc_uplink_slot_close(t_rc_uplink_slot_endpoint* pEndpoint);
+
+// Writer. Returns 1 if the frame was written, 0 if there is no active reader (the frame should go on the IPC channels)
+int rc_uplink_slot_write(t_rc_uplink_slot_endpoint* pEndpoint, u8* pPacket, int iLength, u32 uTimeInputMicros);
+
+// Reader
+void rc_uplink_slot_mark_reader_alive(t_rc_uplink_slot_endpoint* pEndpoint, u32 uTimeNow);
+// The reader must call this on each loop it does not read the slot: the writer falls back to the IPC channels
+// and the frame in the slot, if any, is skipped, so that waiting on the slot does not return right away for it.
+void rc_uplink_slot_mark_reader_gone(t_rc_uplink_slot_endpoint* pEndpoint);
+int rc_uplink_slot_get_wait_fd(t_rc_uplink_slot_endpoint* pEndpoint);
+// Same as for the IPC channels: begin_wait returns 1 if there is a new frame already (the reader should not block then)
+int rc_uplink_slot_begin_wait(t_rc_uplink_slot_endpoint* pEndpoint);
+void rc_uplink_slot_end_wait(t_rc_uplink_slot_endpoint* pEndpoint);
+// Blocks for at most iTimeoutMs, less if a new frame is written meanwhile
+void rc_uplink_slot_wait(t_rc_uplink_slot_endpoint* pEndpoint, int iTimeoutMs);
+// Returns the length of the newest frame, if it was not read already, or 0
+int rc_uplink_slot_read(t_rc_uplink_slot_endpoint* pEndpoint, u8* pOutPacket, u32* puTimeInputMicros);
+
+
+// End to end RC latency histograms, published in a shared memory on each side of the link.
+// Bucket i counts the samples up to (RC_LATENCY_HISTOGRAM_FIRST_BUCKET_MICROS << i); the last one counts all the rest.
+// The radio air time is not part of any of them (the clocks of the controller and the vehicle are not synchronized):
+// the input to FC one is the input to radio time measured on the controller (carried in the RC frames) plus the
+// radio to FC time measured on the vehicle.
+
+#define SHARED_MEM_RC_LATENCY "R_SHARED_MEM_RC_LATENCY"
+#define RC_LATENCY_HISTOGRAM_BUCKETS 10
+#define RC_LATENCY_HISTOGRAM_FIRST_BUCKET_MICROS 250
+
+typedef struct
+{
+   u32 uCounts[RC_LATENCY_HISTOGRAM_BUCKETS];
+   u32 uSamples;
+   u32 uMinMicros;
+   u32 uMaxMicros;
+   u32 uAverageMicros;
+   uint64_t uTotalMicros;
+} t_rc_latency_histogram;
+
+typedef struct
+{
+   t_rc_latency_histogram inputToRadio; // controller: joystick input read to RC frame sent on the radio interfaces
+   t_rc_latency_histogram radioToFC; // vehicle: RC frame received by the RC process to RC values written to the FC
+   t_rc_latency_histogram inputToFC; // vehicle: input to radio (from the RC frames) + radio to FC
+   u32 uTimeLastUpdate;
+   // controller: the vehicle input to FC median and 95th percentile, as received in the RC info packets
+   u32 uVehicleInputToFCMedianMicros;
+   u32 uVehicleInputToFCP95Micros;
+   u32 uTimeLastVehicleLatencyUpdate;
+} t_shared_mem_rc_latency;
+
+t_shared_mem_rc_latency* shared_mem_rc_latency_open_for_read();
+t_shared_mem_rc_latency* shared_mem_rc_latency_open_for_write();
+void shared_mem_rc_latency_close(t_shared_mem_rc_latency* pAddress);
+
+void rc_latency_histogram_reset(t_rc_latency_histogram* pHistogram);
+void rc_latency_histogram_add(t_rc_latency_histogram* pHistogram, u32 uMicros);
+// Upper bound of the bucket that holds the given percentile, or 0 if there are no samples
+u32 rc_latency_histogram_get_percentile(t_rc_latency_histogram* pHistogram, int iPercent);
+void rc_latency_histogram_log(t_rc_latency_histogram* pHistogram, const char* szName);
+// To RC_FULL_FRAME_INPUT_AGE_UNIT_MICROS units, as carried in the RC frames and RC info packets
+u8 rc_latency_to_age_units(u32 uMicros);
+
+#ifdef __cplusplus
+}  
+#endif
@@ -0,0 +1,230 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "base.h"
+#include "reactor.h"
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+int reactor_init(t_reactor* pReactor, u32 uTimerIntervalMicros)
+{
+   if ( NULL == pReactor )
+      return 0;
+
+   memset(pReactor, 0, sizeof(t_reactor));
+   pReactor->iEpollFd = -1;
+   pReactor->iTimerFd = -1;
+   pReactor->uTimerIntervalMicros = uTimerIntervalMicros;
+   if ( pReactor->uTimerIntervalMicros < 100 )
+      pReactor->uTimerIntervalMicros = 100;
+
+   pReactor->iEpollFd = epoll_create1(EPOLL_CLOEXEC);
+   if ( pReactor->iEpollFd < 0 )
+   {
+      log_softerror_and_alarm("[Reactor] Failed to create epoll fd, error: %s", strerror(errno));
+      return 0;
+   }
+
+   pReactor->iTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+   if ( pReactor->iTimerFd < 0 )
+   {
+      log_softerror_and_alarm("[Reactor] Failed to create timer fd, error: %s", strerror(errno));
+      reactor_uninit(pReactor);
+      return 0;
+   }
+
+   if ( ! reactor_set_timer_interval(pReactor, pReactor->uTimerIntervalMicros) )
+   {
+      reactor_uninit(pReactor);
+      return 0;
+   }
+
+   struct epoll_event ev;
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN;
+   ev.data.u64 = ((uint64_t)REACTOR_SOURCE_TIMER << 32) | (u32)pReactor->iTimerFd;
+   if ( 0 != epoll_ctl(pReactor->iEpollFd, EPOLL_CTL_ADD, pReactor->iTimerFd, &ev) )
+   {
+      log_softerror_and_alarm("[Reactor] Failed to add timer to epoll set, error: %s", strerror(errno));
+      reactor_uninit(pReactor);
+      return 0;
+   }
+   log_line("[Reactor] Initialized, timer interval: %u microsec.", pReactor->uTimerIntervalMicros);
+   return 1;
+}
+
+void reactor_uninit(t_reactor* pReactor)
+{
+   if ( NULL == pReactor )
+      return;
+   if ( pReactor->iEpollFd >= 0 )
+      log_line("[Reactor] Uninit. Wakeups: %u, on timer only: %u", pReactor->uStatsWakeups, pReactor->uStatsTimerOnlyWakeups);
+   if ( pReactor->iTimerFd >= 0 )
+      close(pReactor->iTimerFd);
+   if ( pReactor->iEpollFd >= 0 )
+      close(pReactor->iEpollFd);
+   pReactor->iTimerFd = -1;
+   pReactor->iEpollFd = -1;
+   pReactor->iSourcesCount = 0;
+}
+
+int reactor_add_source(t_reactor* pReactor, int iFd, u32 uSourceType)
+{
+   if ( (NULL == pReactor) || (pReactor->iEpollFd < 0) || (iFd < 0) )
+      return 0;
+   if ( pReactor->iSourcesCount >= REACTOR_MAX_SOURCES )
+   {
+      log_softerror_and_alarm("[Reactor] Too many sources, can't add fd %d", iFd);
+      return 0;
+   }
+   for( int i=0; i<pReactor->iSourcesCount; i++ )
+   {
+      if ( pReactor->iSourcesFd[i] == iFd )
+         return 1;
+   }
+
+   struct epoll_event ev;
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN;
+   ev.data.u64 = ((uint64_t)uSourceType << 32) | (u32)iFd;
+   if ( 0 != epoll_ctl(pReactor->iEpollFd, EPOLL_CTL_ADD, iFd, &ev) )
+   {
+      log_softerror_and_alarm("[Reactor] Failed to add fd %d (type %u) to epoll set, error: %s", iFd, uSourceType, strerror(errno));
+      return 0;
+   }
+   pReactor->iSourcesFd[pReactor->iSourcesCount] = iFd;
+   pReactor->uSourcesType[pReactor->iSourcesCount] = uSourceType;
+   pReactor->iSourcesCount++;
+   return 1;
+}
+
+void reactor_remove_source(t_reactor* pReactor, int iFd)
+{
+   if ( (NULL == pReactor) || (pReactor->iEpollFd < 0) || (iFd < 0) )
+      return;
+   for( int i=0; i<pReactor->iSourcesCount; i++ )
+   {
+      if ( pReactor->iSourcesFd[i] != iFd )
+         continue;
+      // The fd could be closed already, that removes it from the epoll set too
+      epoll_ctl(pReactor->iEpollFd, EPOLL_CTL_DEL, iFd, NULL);
+      for( int k=i; k<pReactor->iSourcesCount-1; k++ )
+      {
+         pReactor->iSourcesFd[k] = pReactor->iSourcesFd[k+1];
+         pReactor->uSourcesType[k] = pReactor->uSourcesType[k+1];
+      }
+      pReactor->iSourcesCount--;
+      return;
+   }
+}
+
+void reactor_set_source_of_type(t_reactor* pReactor, int iFd, u32 uSourceType)
+{
+   if ( (NULL == pReactor) || (pReactor->iEpollFd < 0) )
+      return;
+   for( int i=0; i<pReactor->iSourcesCount; i++ )
+   {
+      if ( pReactor->uSourcesType[i] != uSourceType )
+         continue;
+      if ( pReactor->iSourcesFd[i] == iFd )
+      {
+         // Same fd number, but it could have been closed and reopened (that drops it from the epoll set)
+         struct epoll_event ev;
+         memset(&ev, 0, sizeof(ev));
+         ev.events = EPOLLIN;
+         ev.data.u64 = ((uint64_t)uSourceType << 32) | (u32)iFd;
+         if ( (0 != epoll_ctl(pReactor->iEpollFd, EPOLL_CTL_MOD, iFd, &ev)) && (errno == ENOENT) )
+            epoll_ctl(pReactor->iEpollFd, EPOLL_CTL_ADD, iFd, &ev);
+         return;
+      }
+      reactor_remove_source(pReactor, pReactor->iSourcesFd[i]);
+      break;
+   }
+   if ( iFd >= 0 )
+      reactor_add_source(pReactor, iFd, uSourceType);
+}
+
+int reactor_set_timer_interval(t_reactor* pReactor, u32 uTimerIntervalMicros)
+{
+   if ( NULL == pReactor )
+      return 0;
+   if ( uTimerIntervalMicros < 100 )
+      uTimerIntervalMicros = 100;
+   // Without a timer, reactor_wait() sleeps for this interval
+   pReactor->uTimerIntervalMicros = uTimerIntervalMicros;
+   if ( pReactor->iTimerFd < 0 )
+      return 0;
+
+   struct itimerspec timerSpec;
+   timerSpec.it_interval.tv_sec = uTimerIntervalMicros / 1000000;
+   timerSpec.it_interval.tv_nsec = (uTimerIntervalMicros % 1000000) * 1000;
+   timerSpec.it_value = timerSpec.it_interval;
+   if ( 0 != timerfd_settime(pReactor->iTimerFd, 0, &timerSpec, NULL) )
+   {
+      log_softerror_and_alarm("[Reactor] Failed to set timer interval, error: %s", strerror(errno));
+      return 0;
+   }
+   return 1;
+}
+
+u32 reactor_wait(t_reactor* pReactor)
+{
+   if ( (NULL == pReactor) || (pReactor->iEpollFd < 0) )
+   {
+      hardware_sleep_micros((NULL != pReactor)?pReactor->uTimerIntervalMicros:1000);
+      return REACTOR_SOURCE_TIMER;
+   }
+
+   struct epoll_event events[REACTOR_MAX_SOURCES+1];
+   // The timer ticks periodically, the timeout is only a guard
+   int iTimeoutMs = (int)(pReactor->uTimerIntervalMicros/1000) * 4 + 10;
+   int iCount = epoll_wait(pReactor->iEpollFd, events, REACTOR_MAX_SOURCES+1, iTimeoutMs);
+   if ( iCount <= 0 )
+      return (iCount == 0)?REACTOR_SOURCE_TIMER:0;
+
+   u32 uReady = 0;
+   for( int i=0; i<iCount; i++ )
+   {
+      u32 uType = (u32)(events[i].data.u64 >> 32);
+      if ( uType == REACTOR_SOURCE_TIMER )
+      {
+         uint64_t uExpirations = 0;
+         if ( read(pReactor->iTimerFd, &uExpirations, sizeof(uExpirations)) != sizeof(uExpirations) )
+            uExpirations = 0;
+      }
+      uReady |= uType;
+   }
+   pReactor->uStatsWakeups++;
+   if ( uReady == REACTOR_SOURCE_TIMER )
+      pReactor->uStatsTimerOnlyWakeups++;
+   return uReady;
+}
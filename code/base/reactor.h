@@ -0,0 +1,52 @@
+#pragma once
+
+#include "base.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Wakes a main loop only when there is work to do: radio packets queued by the rx thread, input events,
+// IPC messages, camera data, or the periodic timer tick (for the time based periodic work).
+// Sources are fds registered in an epoll set (level triggered); the periodic tick is a timerfd.
+// Each source type is reported as a bit in the value returned by reactor_wait().
+
+#define REACTOR_MAX_SOURCES 16
+
+#define REACTOR_SOURCE_TIMER    0x01
+#define REACTOR_SOURCE_RADIO_RX 0x02
+#define REACTOR_SOURCE_IPC      0x04
+#define REACTOR_SOURCE_CAMERA   0x08
+#define REACTOR_SOURCE_INPUT    0x10
+
+typedef struct
+{
+   int iEpollFd;
+   int iTimerFd;
+   u32 uTimerIntervalMicros;
+   int iSourcesCount;
+   int iSourcesFd[REACTOR_MAX_SOURCES];
+   u32 uSourcesType[REACTOR_MAX_SOURCES];
+
+   u32 uStatsWakeups;
+   u32 uStatsTimerOnlyWakeups;
+} t_reactor;
+
+// Returns 1 on success. On failure, reactor_wait() just sleeps for the timer interval.
+int reactor_init(t_reactor* pReactor, u32 uTimerIntervalMicros);
+void reactor_uninit(t_reactor* pReactor);
+
+// Returns 1 on success
+int reactor_add_source(t_reactor* pReactor, int iFd, u32 uSourceType);
+void reactor_remove_source(t_reactor* pReactor, int iFd);
+// For sources that can change their fd (i.e. the camera input): keeps at most one fd of that type registered
+void reactor_set_source_of_type(t_reactor* pReactor, int iFd, u32 uSourceType);
+// Changes the timer tick; the next tick is one (new) interval from now. Returns 1 on success
+int reactor_set_timer_interval(t_reactor* pReactor, u32 uTimerIntervalMicros);
+
+// Blocks until at least one source is ready or the timer ticks. Returns the ready source types.
+u32 reactor_wait(t_reactor* pReactor);
+
+#ifdef __cplusplus
+}  
+#endif
@@ -40,11 +40,32 @@
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/msg.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <stddef.h>
 #include <errno.h>
+#include <signal.h>
 
 //#define RUBY_USE_FIFO_PIPES 1
 #define RUBY_USES_MSGQUEUES 1
 
+// Shared memory ring channels: one ring per channel type, writers reserve a slot,
+// fill it in place and commit it; the reader copies it out and releases it.
+// Channel level CRC is optional (the packet CRC in the message header is always set).
+#define IPC_SHM_RING_NAME_PREFIX "/SYSTEM_SHARED_MEM_RUBY_IPC_"
+#define IPC_SHM_RING_MAGIC 0x52494E01
+#define IPC_SHM_RING_SLOTS 64
+#define IPC_SHM_RING_CHECK_CRC 0
+#define IPC_SHM_RING_SLOT_FLAG_HAS_CRC 0x01
+// At most one log line per channel in this interval about messages dropped because the ring is full
+#define IPC_SHM_RING_DROP_LOG_INTERVAL_MS 1000
+
+// Doorbells: a reader that wants to block until a message arrives (instead of polling the ring) marks the ring
+// as waited on and waits on its doorbell socket; writers send a datagram to it after committing a message.
+// Abstract namespace unix datagram sockets: nothing to clean up, and no SIGPIPE if the reader is gone.
+#define IPC_SHM_RING_DOORBELL_NAME_PREFIX "ruby_ipc_bell_"
+
 #define FIFO_RUBY_ROUTER_TO_CENTRAL "/tmp/ruby/fiforoutercentral"
 #define FIFO_RUBY_CENTRAL_TO_ROUTER "/tmp/ruby/fifocentralrouter"
 #define FIFO_RUBY_ROUTER_TO_COMMANDS "/tmp/ruby/fiforoutercommands"
@@ -60,15 +81,49 @@
 
 #define MAX_CHANNELS 16
 
+typedef struct
+{
+   _ATOMIC_PREFIX u32 uSeq; // position + 1 once the message in this slot is committed
+   u16 uLength;
+   u8 uMsgId;
+   u8 uFlags;
+   u32 uCRC;
+   u8 uData[IPC_CHANNEL_MAX_MSG_SIZE];
+} ALIGN_STRUCT_SPEC_INFO type_ipc_shm_ring_slot;
+
+typedef struct
+{
+   _ATOMIC_PREFIX u32 uMagic;
+   _ATOMIC_PREFIX u32 uInitState;
+   u32 uSlotsCount;
+   u32 uSlotSize;
+   _ATOMIC_PREFIX u32 uWriteLock; // pid of the writer holding it, 0 if free
+   _ATOMIC_PREFIX u32 uWritePos; // next position to reserve; changed only while holding the write lock
+   _ATOMIC_PREFIX u32 uDroppedMessages;
+   _ATOMIC_PREFIX u32 uReaderWaiting; // set by the reader while it waits on the ring doorbell
+   u8 uPadding1[32];
+   _ATOMIC_PREFIX u32 uReadPos; // next position to read; changed only by the reader
+   u8 uPadding2[60];
+   type_ipc_shm_ring_slot slots[IPC_SHM_RING_SLOTS];
+} ALIGN_STRUCT_SPEC_INFO type_ipc_shm_ring;
+
 int s_iRubyIPCChannelsUniqueIds[MAX_CHANNELS];
 int s_iRubyIPCChannelsFd[MAX_CHANNELS];
 int s_iRubyIPCChannelsType[MAX_CHANNELS];
 u8  s_uRubyIPCChannelsMsgId[MAX_CHANNELS];
 key_t s_uRubyIPCChannelsKeys[MAX_CHANNELS];
+type_ipc_shm_ring* s_pRubyIPCChannelsRing[MAX_CHANNELS];
+u32 s_uRubyIPCChannelsReservedPos[MAX_CHANNELS];
+u32 s_uRubyIPCChannelsTimeLastDropLog[MAX_CHANNELS];
+u32 s_uRubyIPCChannelsDropsNotLogged[MAX_CHANNELS];
+int s_iRubyIPCChannelsDoorbellFd[MAX_CHANNELS];
+static int s_iRubyIPCDoorbellSendSocket = -1;
 
 static int s_iRubyIPCChannelsUniqueIdCounter = 1;
 
 int s_iRubyIPCChannelsCount = 0;
+int s_iRubyIPCLastChannelIndex = 0;
+int s_iRubyIPCBackend = IPC_BACKEND_DEFAULT;
 
 static int s_iRubyIPCCountReadErrors = 0;
 
@@ -164,6 +219,8 @@ void _ruby_ipc_log_channel_info(int iChannelType, int iChannelId, int iChannelFd
 {
    if ( iChannelFd < 0 )
       return;
+   if ( IPC_BACKEND_SHM_RING == s_iRubyIPCBackend )
+      return;
    struct msqid_ds msg_stats;
    if ( 0 != msgctl(iChannelFd, IPC_STAT, &msg_stats) )
       log_softerror_and_alarm("[IPC] Failed to get statistics on ICP message queue %s, id %d, fd %d",
@@ -181,6 +238,7 @@ void _check_ruby_ipc_consistency()
       for ( int k=i+1; k<s_iRubyIPCChannelsCount; k++ )
       {
          #ifdef RUBY_USES_MSGQUEUES
+         if ( IPC_BACKEND_MSGQUEUE == s_iRubyIPCBackend )
          if ( s_uRubyIPCChannelsKeys[i] == s_uRubyIPCChannelsKeys[k] )
             log_error_and_alarm("[IPC] Duplicate key for IPC channels %d and %d, %s and %s.", i, k, _ruby_ipc_get_pipe_name(s_iRubyIPCChannelsType[i]), _ruby_ipc_get_pipe_name(s_iRubyIPCChannelsType[k]));
          #endif
@@ -193,6 +251,203 @@ void _check_ruby_ipc_consistency()
 }
 
 
+// Returns the index in the channels list or -1
+
+int _ruby_ipc_get_channel_index(int iChannelUniqueId)
+{
+   // Read the cache once: other threads of the process update it while resolving their own channels
+   int iLastIndex = __atomic_load_n(&s_iRubyIPCLastChannelIndex, __ATOMIC_RELAXED);
+   if ( (iLastIndex >= 0) && (iLastIndex < s_iRubyIPCChannelsCount) && (s_iRubyIPCChannelsUniqueIds[iLastIndex] == iChannelUniqueId) )
+      return iLastIndex;
+
+   for( int i=0; i<s_iRubyIPCChannelsCount; i++ )
+   {
+      if ( s_iRubyIPCChannelsUniqueIds[i] == iChannelUniqueId )
+      {
+         __atomic_store_n(&s_iRubyIPCLastChannelIndex, i, __ATOMIC_RELAXED);
+         return i;
+      }
+   }
+   return -1;
+}
+
+void _ruby_ipc_get_doorbell_address(const char* szName, struct sockaddr_un* pAddr, socklen_t* pAddrLen)
+{
+   memset(pAddr, 0, sizeof(struct sockaddr_un));
+   pAddr->sun_family = AF_UNIX;
+   // Abstract namespace: the path starts with a 0 byte
+   int iLen = snprintf(pAddr->sun_path+1, sizeof(pAddr->sun_path)-1, "%s", szName);
+   *pAddrLen = offsetof(struct sockaddr_un, sun_path) + 1 + iLen;
+}
+
+void _ruby_ipc_get_channel_doorbell_name(int nChannelType, char* szName, int iMaxLength)
+{
+   snprintf(szName, iMaxLength, "%s%d", IPC_SHM_RING_DOORBELL_NAME_PREFIX, nChannelType);
+}
+
+int ruby_ipc_doorbell_create(const char* szName)
+{
+   int iFd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+   if ( iFd < 0 )
+      return -1;
+   struct sockaddr_un addr;
+   socklen_t addrLen = 0;
+   _ruby_ipc_get_doorbell_address(szName, &addr, &addrLen);
+   if ( 0 != bind(iFd, (struct sockaddr*)&addr, addrLen) )
+   {
+      int iError = errno;
+      close(iFd);
+      errno = iError;
+      return -1;
+   }
+   return iFd;
+}
+
+void ruby_ipc_doorbell_ring(const char* szName)
+{
+   // Several writer threads may ring doorbells: the first socket published wins, the others are closed
+   int iSocket = __atomic_load_n(&s_iRubyIPCDoorbellSendSocket, __ATOMIC_ACQUIRE);
+   if ( iSocket < 0 )
+   {
+      int iNewSocket = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      if ( iNewSocket < 0 )
+         return;
+      if ( __atomic_compare_exchange_n(&s_iRubyIPCDoorbellSendSocket, &iSocket, iNewSocket, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) )
+         iSocket = iNewSocket;
+      else
+         close(iNewSocket);
+   }
+   struct sockaddr_un addr;
+   socklen_t addrLen = 0;
+   _ruby_ipc_get_doorbell_address(szName, &addr, &addrLen);
+   u8 uByte = 1;
+   // Fails silently if the reader is gone or its doorbell has pending datagrams already
+   sendto(iSocket, &uByte, 1, MSG_DONTWAIT | MSG_NOSIGNAL, (struct sockaddr*)&addr, addrLen);
+}
+
+void ruby_ipc_doorbell_clear(int iFd)
+{
+   if ( iFd < 0 )
+      return;
+   u8 uBuffer[16];
+   while ( recv(iFd, uBuffer, sizeof(uBuffer), MSG_DONTWAIT) > 0 )
+   {
+   }
+}
+
+type_ipc_shm_ring* _ruby_ipc_shm_ring_open(int nChannelType, int* piOutFd)
+{
+   char szName[128];
+   sprintf(szName, "%s%d", IPC_SHM_RING_NAME_PREFIX, nChannelType);
+   *piOutFd = -1;
+
+   int fd = shm_open(szName, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+   if ( fd < 0 )
+   {
+      log_softerror_and_alarm("[IPC] Failed to open shared memory ring for channel %s, error: %s", _ruby_ipc_get_channel_name(nChannelType), strerror(errno));
+      return NULL;
+   }
+
+   // Size mismatch means a ring left over from a different build; recreate it zeroed
+   struct stat statBuf;
+   if ( (0 != fstat(fd, &statBuf)) || (statBuf.st_size != (off_t)sizeof(type_ipc_shm_ring)) )
+   {
+      if ( (0 != ftruncate(fd, 0)) || (0 != ftruncate(fd, sizeof(type_ipc_shm_ring))) )
+      {
+         log_softerror_and_alarm("[IPC] Failed to size shared memory ring for channel %s, error: %s", _ruby_ipc_get_channel_name(nChannelType), strerror(errno));
+         close(fd);
+         return NULL;
+      }
+   }
+
+   type_ipc_shm_ring* pRing = (type_ipc_shm_ring*) mmap(NULL, sizeof(type_ipc_shm_ring), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if ( MAP_FAILED == (void*)pRing )
+   {
+      log_softerror_and_alarm("[IPC] Failed to map shared memory ring for channel %s, error: %s", _ruby_ipc_get_channel_name(nChannelType), strerror(errno));
+      close(fd);
+      return NULL;
+   }
+
+   // First endpoint to get here initializes the ring, the other one waits for it
+   u32 uExpected = 0;
+   if ( __atomic_compare_exchange_n(&pRing->uInitState, &uExpected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) )
+   {
+      pRing->uSlotsCount = IPC_SHM_RING_SLOTS;
+      pRing->uSlotSize = sizeof(type_ipc_shm_ring_slot);
+      pRing->uWriteLock = 0;
+      pRing->uWritePos = 0;
+      pRing->uReadPos = 0;
+      pRing->uDroppedMessages = 0;
+      pRing->uReaderWaiting = 0;
+      for( int i=0; i<IPC_SHM_RING_SLOTS; i++ )
+         pRing->slots[i].uSeq = 0;
+      __atomic_store_n(&pRing->uMagic, IPC_SHM_RING_MAGIC, __ATOMIC_RELEASE);
+      log_line("[IPC] Created shared memory ring for channel %s: %d slots of %d bytes", _ruby_ipc_get_channel_name(nChannelType), IPC_SHM_RING_SLOTS, (int)sizeof(type_ipc_shm_ring_slot));
+   }
+   else
+   {
+      for( int i=0; i<100; i++ )
+      {
+         if ( IPC_SHM_RING_MAGIC == __atomic_load_n(&pRing->uMagic, __ATOMIC_ACQUIRE) )
+            break;
+         hardware_sleep_ms(1);
+      }
+      if ( IPC_SHM_RING_MAGIC != __atomic_load_n(&pRing->uMagic, __ATOMIC_ACQUIRE) )
+      {
+         log_softerror_and_alarm("[IPC] Shared memory ring for channel %s was not initialized.", _ruby_ipc_get_channel_name(nChannelType));
+         munmap(pRing, sizeof(type_ipc_shm_ring));
+         close(fd);
+         return NULL;
+      }
+      log_line("[IPC] Opened existing shared memory ring for channel %s, read pos: %u, write pos: %u, dropped messages: %u",
+         _ruby_ipc_get_channel_name(nChannelType), pRing->uReadPos, pRing->uWritePos, pRing->uDroppedMessages);
+   }
+   *piOutFd = fd;
+   return pRing;
+}
+
+// The write lock holds the pid of the writer that owns it. It is taken over only if that process
+// no longer exists; a live writer (i.e. descheduled while holding it) is always waited for.
+void _ruby_ipc_shm_ring_lock_writer(type_ipc_shm_ring* pRing, int iChannelType)
+{
+   u32 uOwnPid = (u32)getpid();
+   int iRetries = 0;
+   int iLoggedWait = 0;
+   u32 uOwner = 0;
+   while ( ! __atomic_compare_exchange_n(&pRing->uWriteLock, &uOwner, uOwnPid, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) )
+   {
+      iRetries++;
+      if ( iRetries < 100 )
+      {
+         uOwner = 0;
+         continue;
+      }
+
+      // Check if the owner is still alive every thousand retries
+      if ( (iRetries % 1000) == 0 )
+      if ( (0 != kill((pid_t)uOwner, 0)) && (errno == ESRCH) )
+      {
+         if ( __atomic_compare_exchange_n(&pRing->uWriteLock, &uOwner, uOwnPid, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) )
+         {
+            log_softerror_and_alarm("[IPC] Writer process %u died while holding the write lock on channel %s. Took over the lock.", uOwner, _ruby_ipc_get_channel_name(iChannelType));
+            return;
+         }
+      }
+      if ( (iRetries > 100000) && (! iLoggedWait) )
+      {
+         log_softerror_and_alarm("[IPC] Waiting for a long time for the write lock on channel %s, held by process %u.", _ruby_ipc_get_channel_name(iChannelType), uOwner);
+         iLoggedWait = 1;
+      }
+      hardware_sleep_micros(10);
+      uOwner = 0;
+   }
+}
+
+void _ruby_ipc_shm_ring_unlock_writer(type_ipc_shm_ring* pRing)
+{
+   __atomic_store_n(&pRing->uWriteLock, 0, __ATOMIC_RELEASE);
+}
+
 int ruby_init_ipc_channels()
 {
    #if defined(HW_PLATFORM_RASPBERRY) || defined(HW_PLATFORM_RADXA)
@@ -254,6 +509,26 @@ void ruby_clear_all_ipc_channels()
 {
    log_line("[IPC] Clearing all IPC channels...");
    
+   if ( IPC_BACKEND_SHM_RING == s_iRubyIPCBackend )
+   {
+      for( int i=0; i<s_iRubyIPCChannelsCount; i++ )
+      {
+         char szName[128];
+         sprintf(szName, "%s%d", IPC_SHM_RING_NAME_PREFIX, s_iRubyIPCChannelsType[i]);
+         if ( NULL != s_pRubyIPCChannelsRing[i] )
+            munmap(s_pRubyIPCChannelsRing[i], sizeof(type_ipc_shm_ring));
+         s_pRubyIPCChannelsRing[i] = NULL;
+         close(s_iRubyIPCChannelsFd[i]);
+         if ( s_iRubyIPCChannelsDoorbellFd[i] >= 0 )
+            close(s_iRubyIPCChannelsDoorbellFd[i]);
+         s_iRubyIPCChannelsDoorbellFd[i] = -1;
+         if ( 0 != shm_unlink(szName) )
+            log_softerror_and_alarm("[IPC] Failed to remove shared memory ring [%s], error code: %d, error: %s",
+             _ruby_ipc_get_channel_name(s_iRubyIPCChannelsType[i]), errno, strerror(errno));
+      }
+      s_iRubyIPCChannelsCount = 0;
+   }
+
    #ifdef RUBY_USES_MSGQUEUES
 
    for( int i=0; i<s_iRubyIPCChannelsCount; i++ )
@@ -286,7 +561,23 @@ int ruby_open_ipc_channel_write_endpoint(int nChannelType)
 
    s_iRubyIPCChannelsType[s_iRubyIPCChannelsCount] = nChannelType;
    s_uRubyIPCChannelsMsgId[s_iRubyIPCChannelsCount] = 0;
+   s_pRubyIPCChannelsRing[s_iRubyIPCChannelsCount] = NULL;
+   s_iRubyIPCChannelsDoorbellFd[s_iRubyIPCChannelsCount] = -1;
+   s_uRubyIPCChannelsTimeLastDropLog[s_iRubyIPCChannelsCount] = 0;
+   s_uRubyIPCChannelsDropsNotLogged[s_iRubyIPCChannelsCount] = 0;
 
+   if ( IPC_BACKEND_SHM_RING == s_iRubyIPCBackend )
+   {
+      s_uRubyIPCChannelsKeys[s_iRubyIPCChannelsCount] = 0;
+      s_pRubyIPCChannelsRing[s_iRubyIPCChannelsCount] = _ruby_ipc_shm_ring_open(nChannelType, &s_iRubyIPCChannelsFd[s_iRubyIPCChannelsCount]);
+      if ( NULL == s_pRubyIPCChannelsRing[s_iRubyIPCChannelsCount] )
+      {
+         log_softerror_and_alarm("[IPC] Failed to create IPC ring write endpoint for channel %s", _ruby_ipc_get_channel_name(nChannelType));
+         return -1;
+      }
+   }
+   else
+   {
    #ifdef RUBY_USE_FIFO_PIPES
 
    char* szPipeName = _ruby_ipc_get_pipe_name(nChannelType);
@@ -346,6 +637,7 @@ int ruby_open_ipc_channel_write_endpoint(int nChannelType)
    //   log_line("[IPC] IPC channels pools max: %u bytes, max msg size: %u bytes, max msg queue total size: %u bytes", (u32)msg_info.msgpool, (u32)msg_info.msgmax, (u32)msg_info.msgmnb);
 
    #endif
+   }
 
    s_iRubyIPCChannelsUniqueIds[s_iRubyIPCChannelsCount] = s_iRubyIPCChannelsUniqueIdCounter;
    s_iRubyIPCChannelsUniqueIdCounter++;
@@ -376,7 +668,23 @@ int ruby_open_ipc_channel_read_endpoint(int nChannelType)
 
    s_iRubyIPCChannelsType[s_iRubyIPCChannelsCount] = nChannelType;
    s_uRubyIPCChannelsMsgId[s_iRubyIPCChannelsCount] = 0;
+   s_pRubyIPCChannelsRing[s_iRubyIPCChannelsCount] = NULL;
+   s_iRubyIPCChannelsDoorbellFd[s_iRubyIPCChannelsCount] = -1;
+   s_uRubyIPCChannelsTimeLastDropLog[s_iRubyIPCChannelsCount] = 0;
+   s_uRubyIPCChannelsDropsNotLogged[s_iRubyIPCChannelsCount] = 0;
 
+   if ( IPC_BACKEND_SHM_RING == s_iRubyIPCBackend )
+   {
+      s_uRubyIPCChannelsKeys[s_iRubyIPCChannelsCount] = 0;
+      s_pRubyIPCChannelsRing[s_iRubyIPCChannelsCount] = _ruby_ipc_shm_ring_open(nChannelType, &s_iRubyIPCChannelsFd[s_iRubyIPCChannelsCount]);
+      if ( NULL == s_pRubyIPCChannelsRing[s_iRubyIPCChannelsCount] )
+      {
+         log_softerror_and_alarm("[IPC] Failed to create IPC ring read endpoint for channel %s", _ruby_ipc_get_channel_name(nChannelType));
+         return -1;
+      }
+   }
+   else
+   {
    #ifdef RUBY_USE_FIFO_PIPES
 
    char* szPipeName = _ruby_ipc_get_pipe_name(nChannelType);
@@ -432,6 +740,7 @@ int ruby_open_ipc_channel_read_endpoint(int nChannelType)
    //else
    //   log_line("[IPC] IPC channels pools max: %u bytes, max msg size: %u bytes, max msg queue total size: %u bytes", (u32)msg_info.msgpool, (u32)msg_info.msgmax, (u32)msg_info.msgmnb);
    #endif
+   }
 
    s_iRubyIPCChannelsUniqueIds[s_iRubyIPCChannelsCount] = s_iRubyIPCChannelsUniqueIdCounter;
    s_iRubyIPCChannelsUniqueIdCounter++;
@@ -449,16 +758,9 @@ int ruby_open_ipc_channel_read_endpoint(int nChannelType)
 int ruby_close_ipc_channel(int iChannelUniqueId)
 {
    int fdToClose = 0;
-   int iChannelIndex = -1;
-   for( int i=0; i<s_iRubyIPCChannelsCount; i++ )
-   {
-      if ( s_iRubyIPCChannelsUniqueIds[i] == iChannelUniqueId )
-      {
-         fdToClose = s_iRubyIPCChannelsFd[i];
-         iChannelIndex = i;
-         break;
-      }
-   }
+   int iChannelIndex = _ruby_ipc_get_channel_index(iChannelUniqueId);
+   if ( -1 != iChannelIndex )
+      fdToClose = s_iRubyIPCChannelsFd[iChannelIndex];
 
    if ( (iChannelUniqueId < 0) || (fdToClose < 0) || (-1 == iChannelIndex) )
    {
@@ -470,6 +772,18 @@ int ruby_close_ipc_channel(int iChannelUniqueId)
       log_softerror_and_alarm("[IPC] Warning: closing invalid fd 0 for unique channel %d, channel index %d, (%s)",
        iChannelUniqueId, iChannelIndex, _ruby_ipc_get_channel_name(s_iRubyIPCChannelsType[iChannelIndex]));
 
+   // Ring stays in shared memory (the other endpoint may still use it), it's removed on clear all channels
+   if ( NULL != s_pRubyIPCChannelsRing[iChannelIndex] )
+   {
+      munmap(s_pRubyIPCChannelsRing[iChannelIndex], sizeof(type_ipc_shm_ring));
+      s_pRubyIPCChannelsRing[iChannelIndex] = NULL;
+      close(fdToClose);
+      if ( s_iRubyIPCChannelsDoorbellFd[iChannelIndex] >= 0 )
+         close(s_iRubyIPCChannelsDoorbellFd[iChannelIndex]);
+      s_iRubyIPCChannelsDoorbellFd[iChannelIndex] = -1;
+   }
+   else
+   {
    #ifdef RUBY_USE_FIFO_PIPES
    close(fdToClose);
    #endif
@@ -477,6 +791,7 @@ int ruby_close_ipc_channel(int iChannelUniqueId)
    #ifdef RUBY_USES_MSGQUEUES
    msgctl(fdToClose,IPC_RMID,NULL);
    #endif
+   }
 
 
    log_line("[IPC] Closed IPC channel %s, channel index %d, unique id %d, fd %d",
@@ -489,9 +804,15 @@ int ruby_close_ipc_channel(int iChannelUniqueId)
       s_iRubyIPCChannelsType[k] = s_iRubyIPCChannelsType[k+1];
       s_iRubyIPCChannelsUniqueIds[k] = s_iRubyIPCChannelsUniqueIds[k+1];
       s_uRubyIPCChannelsMsgId[k] = s_uRubyIPCChannelsMsgId[k+1];
+      s_pRubyIPCChannelsRing[k] = s_pRubyIPCChannelsRing[k+1];
+      s_uRubyIPCChannelsReservedPos[k] = s_uRubyIPCChannelsReservedPos[k+1];
+      s_iRubyIPCChannelsDoorbellFd[k] = s_iRubyIPCChannelsDoorbellFd[k+1];
+      s_uRubyIPCChannelsTimeLastDropLog[k] = s_uRubyIPCChannelsTimeLastDropLog[k+1];
+      s_uRubyIPCChannelsDropsNotLogged[k] = s_uRubyIPCChannelsDropsNotLogged[k+1];
 
    }
    s_iRubyIPCChannelsCount--;
+   __atomic_store_n(&s_iRubyIPCLastChannelIndex, 0, __ATOMIC_RELAXED);
   
    _ruby_ipc_log_channels();
    return 1;
@@ -505,21 +826,10 @@ int ruby_ipc_channel_send_message(int iChannelUniqueId, u8* pMessage, int iLengt
       return 0;
    }
 
-   int iFoundIndex = -1;
    int iChannelFd = 0;
-   //int iChannelType = 0;
-   //u8 uChannelMsgId = 0;
-   for( int i=0; i<s_iRubyIPCChannelsCount; i++ )
-   {
-      if ( s_iRubyIPCChannelsUniqueIds[i] == iChannelUniqueId )
-      {
-         iChannelFd = s_iRubyIPCChannelsFd[i];
-         //iChannelType = s_iRubyIPCChannelsType[i];
-         //uChannelMsgId = s_uRubyIPCChannelsMsgId[i];
-         iFoundIndex = i;
-         break;
-      }
-   }
+   int iFoundIndex = _ruby_ipc_get_channel_index(iChannelUniqueId);
+   if ( -1 != iFoundIndex )
+      iChannelFd = s_iRubyIPCChannelsFd[iFoundIndex];
 
    if ( iFoundIndex == -1 )
    {
@@ -545,6 +855,19 @@ int ruby_ipc_channel_send_message(int iChannelUniqueId, u8* pMessage, int iLengt
       return 0;
    }
 
+   if ( NULL != s_pRubyIPCChannelsRing[iFoundIndex] )
+   {
+      u8* pSlotData = ruby_ipc_channel_reserve_message(iChannelUniqueId, iLength);
+      if ( NULL == pSlotData )
+         return 0;
+      memcpy(pSlotData, pMessage, iLength);
+      if ( ! ruby_ipc_channel_commit_message(iChannelUniqueId, iLength) )
+         return 0;
+      // Callers expect the message CRC to be set in their buffer too
+      memcpy(pMessage, pSlotData, sizeof(u32));
+      return iLength;
+   }
+
    u32 crc = base_compute_crc32(pMessage + sizeof(u32), iLength-sizeof(u32)); 
    u32* pTmp = (u32*)pMessage;
    *pTmp = crc;
@@ -676,18 +999,13 @@ u8* ruby_ipc_try_read_message(int iChannelUniqueId, u8* pTempBuffer, int* pTempB
       return NULL;
    }
 
-   int iFoundIndex = -1;
    int iChannelFd = 0;
    int iChannelType = 0;
-   for( int i=0; i<s_iRubyIPCChannelsCount; i++ )
+   int iFoundIndex = _ruby_ipc_get_channel_index(iChannelUniqueId);
+   if ( -1 != iFoundIndex )
    {
-      if ( s_iRubyIPCChannelsUniqueIds[i] == iChannelUniqueId )
-      {
-         iChannelFd = s_iRubyIPCChannelsFd[i];
-         iChannelType = s_iRubyIPCChannelsType[i];
-         iFoundIndex = i;
-         break;
-      }
+      iChannelFd = s_iRubyIPCChannelsFd[iFoundIndex];
+      iChannelType = s_iRubyIPCChannelsType[iFoundIndex];
    }
 
    if ( iFoundIndex == -1 )
@@ -702,6 +1020,29 @@ u8* ruby_ipc_try_read_message(int iChannelUniqueId, u8* pTempBuffer, int* pTempB
       return NULL;
    }
 
+   if ( NULL != s_pRubyIPCChannelsRing[iFoundIndex] )
+   {
+      type_ipc_shm_ring* pRing = s_pRubyIPCChannelsRing[iFoundIndex];
+      u32 uPos = pRing->uReadPos;
+      type_ipc_shm_ring_slot* pSlot = &(pRing->slots[uPos % IPC_SHM_RING_SLOTS]);
+      if ( __atomic_load_n(&pSlot->uSeq, __ATOMIC_ACQUIRE) != uPos + 1 )
+         return NULL;
+
+      u8* pRingReturn = NULL;
+      int iMsgLen = (int)pSlot->uLength;
+      if ( (iMsgLen <= 0) || (iMsgLen >= IPC_CHANNEL_MAX_MSG_SIZE - 6) )
+         log_softerror_and_alarm("[IPC] Received invalid message on channel %s, id: %d, length: %d", _ruby_ipc_get_channel_name(iChannelType), pSlot->uMsgId, iMsgLen );
+      else if ( (pSlot->uFlags & IPC_SHM_RING_SLOT_FLAG_HAS_CRC) && (pSlot->uCRC != base_compute_crc32(pSlot->uData, iMsgLen)) )
+         log_softerror_and_alarm("[IPC] Received invalid CRC on channel %s on message id: %d, msg length: %d", _ruby_ipc_get_channel_name(iChannelType), pSlot->uMsgId, iMsgLen );
+      else
+      {
+         memcpy(pOutputBuffer, pSlot->uData, iMsgLen);
+         pRingReturn = pOutputBuffer;
+      }
+      __atomic_store_n(&pRing->uReadPos, uPos + 1, __ATOMIC_RELEASE);
+      return pRingReturn;
+   }
+
    u8* pReturn = NULL;
    int lenReadIPCMsgQueue = 0;
 
@@ -831,6 +1172,156 @@ u8* ruby_ipc_try_read_message(int iChannelUniqueId, u8* pTempBuffer, int* pTempB
    return pReturn;
 }
 
+// Reserves the next slot on a ring channel and returns a pointer to its data, to be filled in place.
+// Must be followed by ruby_ipc_channel_commit_message on the same channel.
+// Returns NULL if the channel is not a ring channel or the ring is full.
+
+u8* ruby_ipc_channel_reserve_message(int iChannelUniqueId, int iLength)
+{
+   int iIndex = _ruby_ipc_get_channel_index(iChannelUniqueId);
+   if ( (-1 == iIndex) || (NULL == s_pRubyIPCChannelsRing[iIndex]) )
+      return NULL;
+   if ( (iLength <= 0) || (iLength >= IPC_CHANNEL_MAX_MSG_SIZE-6) )
+   {
+      log_softerror_and_alarm("[IPC] Tried to reserve a message too big (%d bytes) on channel %s, channel unique id %d", iLength, _ruby_ipc_get_channel_name(s_iRubyIPCChannelsType[iIndex]), iChannelUniqueId );
+      return NULL;
+   }
+
+   type_ipc_shm_ring* pRing = s_pRubyIPCChannelsRing[iIndex];
+   _ruby_ipc_shm_ring_lock_writer(pRing, s_iRubyIPCChannelsType[iIndex]);
+
+   u32 uPos = pRing->uWritePos;
+   if ( uPos - __atomic_load_n(&pRing->uReadPos, __ATOMIC_ACQUIRE) >= IPC_SHM_RING_SLOTS )
+   {
+      pRing->uDroppedMessages++;
+      _ruby_ipc_shm_ring_unlock_writer(pRing);
+      // The ring stays full for a while when the reader is stuck: don't log each dropped message
+      s_uRubyIPCChannelsDropsNotLogged[iIndex]++;
+      u32 uTimeNow = get_current_timestamp_ms();
+      if ( (0 == s_uRubyIPCChannelsTimeLastDropLog[iIndex]) || (uTimeNow - s_uRubyIPCChannelsTimeLastDropLog[iIndex] >= IPC_SHM_RING_DROP_LOG_INTERVAL_MS) )
+      {
+         log_softerror_and_alarm("[IPC] Failed to write to IPC %s, ring is full (%d messages pending). Dropped %u messages since last log, %u dropped so far.",
+            _ruby_ipc_get_channel_name(s_iRubyIPCChannelsType[iIndex]), IPC_SHM_RING_SLOTS, s_uRubyIPCChannelsDropsNotLogged[iIndex], pRing->uDroppedMessages);
+         s_uRubyIPCChannelsTimeLastDropLog[iIndex] = uTimeNow;
+         s_uRubyIPCChannelsDropsNotLogged[iIndex] = 0;
+      }
+      return NULL;
+   }
+   s_uRubyIPCChannelsReservedPos[iIndex] = uPos;
+   return pRing->slots[uPos % IPC_SHM_RING_SLOTS].uData;
+}
+
+// Publishes the message reserved with ruby_ipc_channel_reserve_message. Sets the message CRC (first 4 bytes).
+// Returns 1 on success
+
+int ruby_ipc_channel_commit_message(int iChannelUniqueId, int iLength)
+{
+   int iIndex = _ruby_ipc_get_channel_index(iChannelUniqueId);
+   if ( (-1 == iIndex) || (NULL == s_pRubyIPCChannelsRing[iIndex]) )
+      return 0;
+
+   type_ipc_shm_ring* pRing = s_pRubyIPCChannelsRing[iIndex];
+   u32 uPos = s_uRubyIPCChannelsReservedPos[iIndex];
+   type_ipc_shm_ring_slot* pSlot = &(pRing->slots[uPos % IPC_SHM_RING_SLOTS]);
+
+   u32 uCRC = base_compute_crc32(pSlot->uData + sizeof(u32), iLength-sizeof(u32));
+   memcpy(pSlot->uData, (u8*)&uCRC, sizeof(u32));
+
+   s_uRubyIPCChannelsMsgId[iIndex]++;
+   pSlot->uLength = (u16)iLength;
+   pSlot->uMsgId = s_uRubyIPCChannelsMsgId[iIndex];
+   pSlot->uFlags = 0;
+   if ( IPC_SHM_RING_CHECK_CRC )
+   {
+      pSlot->uFlags |= IPC_SHM_RING_SLOT_FLAG_HAS_CRC;
+      pSlot->uCRC = base_compute_crc32(pSlot->uData, iLength);
+   }
+
+   __atomic_store_n(&pSlot->uSeq, uPos + 1, __ATOMIC_RELEASE);
+   __atomic_store_n(&pRing->uWritePos, uPos + 1, __ATOMIC_RELEASE);
+   _ruby_ipc_shm_ring_unlock_writer(pRing);
+
+   // Pairs with the reader publishing its waiting flag and then checking the ring (ruby_ipc_channel_begin_wait)
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   if ( __atomic_load_n(&pRing->uReaderWaiting, __ATOMIC_RELAXED) )
+   {
+      char szDoorbell[64];
+      _ruby_ipc_get_channel_doorbell_name(s_iRubyIPCChannelsType[iIndex], szDoorbell, sizeof(szDoorbell));
+      ruby_ipc_doorbell_ring(szDoorbell);
+   }
+   return 1;
+}
+
+// Returns a fd that becomes readable when a message is sent on the channel, or -1 if the channel does not support it
+// (message queues channels). Only for read endpoints of shared memory ring channels.
+
+int ruby_ipc_channel_get_wait_fd(int iChannelUniqueId)
+{
+   int iIndex = _ruby_ipc_get_channel_index(iChannelUniqueId);
+   if ( (-1 == iIndex) || (NULL == s_pRubyIPCChannelsRing[iIndex]) )
+      return -1;
+   if ( s_iRubyIPCChannelsDoorbellFd[iIndex] >= 0 )
+      return s_iRubyIPCChannelsDoorbellFd[iIndex];
+
+   char szDoorbell[64];
+   _ruby_ipc_get_channel_doorbell_name(s_iRubyIPCChannelsType[iIndex], szDoorbell, sizeof(szDoorbell));
+   int iFd = ruby_ipc_doorbell_create(szDoorbell);
+   if ( iFd < 0 )
+   {
+      log_softerror_and_alarm("[IPC] Failed to create doorbell socket for channel %s, error: %s", _ruby_ipc_get_channel_name(s_iRubyIPCChannelsType[iIndex]), strerror(errno));
+      return -1;
+   }
+   s_iRubyIPCChannelsDoorbellFd[iIndex] = iFd;
+   log_line("[IPC] Created doorbell for channel %s, fd: %d", _ruby_ipc_get_channel_name(s_iRubyIPCChannelsType[iIndex]), iFd);
+   return iFd;
+}
+
+// Marks the channel as waited on by the reader, so that writers ring its doorbell.
+// Returns 1 if there are messages to read already (the reader should not block then).
+
+int ruby_ipc_channel_begin_wait(int iChannelUniqueId)
+{
+   int iIndex = _ruby_ipc_get_channel_index(iChannelUniqueId);
+   if ( (-1 == iIndex) || (NULL == s_pRubyIPCChannelsRing[iIndex]) || (s_iRubyIPCChannelsDoorbellFd[iIndex] < 0) )
+      return 0;
+
+   type_ipc_shm_ring* pRing = s_pRubyIPCChannelsRing[iIndex];
+   __atomic_store_n(&pRing->uReaderWaiting, 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+   // Check again after publishing the waiting flag, so that a message committed right now is not missed
+   u32 uPos = pRing->uReadPos;
+   if ( __atomic_load_n(&(pRing->slots[uPos % IPC_SHM_RING_SLOTS].uSeq), __ATOMIC_ACQUIRE) == uPos + 1 )
+      return 1;
+   return 0;
+}
+
+void ruby_ipc_channel_end_wait(int iChannelUniqueId)
+{
+   int iIndex = _ruby_ipc_get_channel_index(iChannelUniqueId);
+   if ( (-1 == iIndex) || (NULL == s_pRubyIPCChannelsRing[iIndex]) || (s_iRubyIPCChannelsDoorbellFd[iIndex] < 0) )
+      return;
+
+   __atomic_store_n(&(s_pRubyIPCChannelsRing[iIndex]->uReaderWaiting), 0, __ATOMIC_RELAXED);
+   ruby_ipc_doorbell_clear(s_iRubyIPCChannelsDoorbellFd[iIndex]);
+}
+
+void ruby_ipc_set_backend(int iBackend)
+{
+   if ( s_iRubyIPCChannelsCount > 0 )
+   {
+      log_softerror_and_alarm("[IPC] Can't change IPC backend while %d channels are opened.", s_iRubyIPCChannelsCount);
+      return;
+   }
+   s_iRubyIPCBackend = iBackend;
+   log_line("[IPC] Set IPC backend to: %s", (IPC_BACKEND_SHM_RING == s_iRubyIPCBackend)?"shared memory rings":"message queues");
+}
+
+int ruby_ipc_get_backend()
+{
+   return s_iRubyIPCBackend;
+}
+
 int ruby_ipc_get_read_continous_error_count()
 {
    return s_iRubyIPCCountReadErrors;
@@ -14,6 +14,10 @@
 
 #define IPC_CHANNEL_MAX_MSG_SIZE 1600
 
+#define IPC_BACKEND_MSGQUEUE 0
+#define IPC_BACKEND_SHM_RING 1
+#define IPC_BACKEND_DEFAULT IPC_BACKEND_SHM_RING
+
 #define RUBY_PIPES_EXTRA_FLAGS O_NONBLOCK
 
 #ifdef __cplusplus
@@ -33,6 +37,27 @@ int ruby_close_ipc_channel(int iChannelUniqueId);
 int ruby_ipc_channel_send_message(int iChannelUniqueId, u8* pMessage, int iLength);
 u8* ruby_ipc_try_read_message(int iChannelUniqueId, u8* pTempBuffer, int* pTempBufferPos, u8* pOutputBuffer);
 
+// Zero copy send, only on shared memory ring channels
+u8* ruby_ipc_channel_reserve_message(int iChannelUniqueId, int iLength);
+int ruby_ipc_channel_commit_message(int iChannelUniqueId, int iLength);
+
+// Blocking wait support, only on shared memory ring channels read endpoints:
+// the wait fd becomes readable when a message is sent while the reader is between begin_wait and end_wait.
+// begin_wait returns 1 if there are messages to read already.
+int ruby_ipc_channel_get_wait_fd(int iChannelUniqueId);
+int ruby_ipc_channel_begin_wait(int iChannelUniqueId);
+void ruby_ipc_channel_end_wait(int iChannelUniqueId);
+
+// Doorbells by name (abstract unix datagram sockets), also used by other shared memory channels (RC uplink slots):
+// the reader creates and waits on it, writers ring it. Create returns the fd, or -1 (errno is set).
+int ruby_ipc_doorbell_create(const char* szName);
+void ruby_ipc_doorbell_ring(const char* szName);
+void ruby_ipc_doorbell_clear(int iFd);
+
+// Must be set (the same) in all processes, before opening any channel
+void ruby_ipc_set_backend(int iBackend);
+int ruby_ipc_get_backend();
+
 int ruby_ipc_get_read_continous_error_count();
 
 #ifdef __cplusplus
@@ -0,0 +1,227 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "base.h"
+#include "shared_mem.h"
+#include "shared_mem_video_frames.h"
+
+static shared_mem_video_frames* _shared_mem_video_frames_open(const char* szName, int iReadOnly)
+{
+   u8* pMem = NULL;
+   if ( iReadOnly )
+      pMem = (u8*) open_shared_mem_for_read(szName, SM_VIDEO_FRAMES_TOTAL_SIZE);
+   else
+      pMem = (u8*) open_shared_mem_for_write(szName, SM_VIDEO_FRAMES_TOTAL_SIZE);
+   if ( NULL == pMem )
+      return NULL;
+
+   shared_mem_video_frames* pFrames = (shared_mem_video_frames*) malloc(sizeof(shared_mem_video_frames));
+   if ( NULL == pFrames )
+   {
+      munmap(pMem, SM_VIDEO_FRAMES_TOTAL_SIZE);
+      return NULL;
+   }
+   memset(pFrames, 0, sizeof(shared_mem_video_frames));
+   pFrames->pHeader = (shared_mem_video_frames_header*)pMem;
+   pFrames->pData = pMem + SM_VIDEO_FRAMES_HEADER_SIZE;
+   pFrames->iReadOnly = iReadOnly;
+
+   if ( ! iReadOnly )
+   {
+      pFrames->pHeader->uDataSize = SM_VIDEO_FRAMES_DATA_SIZE;
+      pFrames->pHeader->uFramesWritten = 0;
+      pFrames->pHeader->uStreamPosition = 0;
+      __sync_synchronize();
+      pFrames->pHeader->uMagic = SM_VIDEO_FRAMES_MAGIC;
+   }
+   else
+   {
+      if ( pFrames->pHeader->uMagic != SM_VIDEO_FRAMES_MAGIC )
+         log_softerror_and_alarm("[SharedMemVideoFrames] Shared memory %s is not initialized yet.", szName);
+      // Start with the new frames only
+      pFrames->uFramesRead = pFrames->pHeader->uFramesWritten;
+   }
+   return pFrames;
+}
+
+shared_mem_video_frames* shared_mem_video_frames_open_write(const char* szName)
+{
+   return _shared_mem_video_frames_open(szName, 0);
+}
+
+shared_mem_video_frames* shared_mem_video_frames_open_read(const char* szName)
+{
+   return _shared_mem_video_frames_open(szName, 1);
+}
+
+void shared_mem_video_frames_close(const char* szName, shared_mem_video_frames* pFrames)
+{
+   if ( NULL == pFrames )
+      return;
+   if ( NULL != pFrames->pHeader )
+      munmap(pFrames->pHeader, SM_VIDEO_FRAMES_TOTAL_SIZE);
+   log_line("[SharedMemVideoFrames] Closed shared memory %s (%s), %u frames skipped by reader.", szName, pFrames->iReadOnly?"read":"write", pFrames->uFramesSkipped);
+   free(pFrames);
+}
+
+u8* shared_mem_video_frames_reserve(shared_mem_video_frames* pFrames, u32 uFrameIndex, int iLength, u32 uTimeNow)
+{
+   if ( (NULL == pFrames) || pFrames->iReadOnly || (iLength <= 0) )
+      return NULL;
+
+   shared_mem_video_frames_header* pHeader = pFrames->pHeader;
+
+   // New frame started before the end of the previous one was received?
+   if ( pFrames->iHasFrame && (uFrameIndex != pFrames->uFrameIndex) )
+   {
+      pFrames->uFrameFlags |= SM_VIDEO_FRAME_FLAG_END_MISSING;
+      shared_mem_video_frames_end_frame(pFrames);
+   }
+
+   if ( ! pFrames->iHasFrame )
+   {
+      pFrames->iHasFrame = 1;
+      pFrames->uFrameIndex = uFrameIndex;
+      pFrames->uFrameFlags = 0;
+      pFrames->uFrameArrivalTimeMs = uTimeNow;
+      pFrames->uFrameDataOffset = pHeader->uStreamPosition % SM_VIDEO_FRAMES_DATA_SIZE;
+      pFrames->uFrameDataLength = 0;
+   }
+
+   if ( pFrames->uFrameDataLength + (u32)iLength > SM_VIDEO_FRAMES_DATA_SIZE/2 )
+   {
+      log_softerror_and_alarm("[SharedMemVideoFrames] Video frame too big (%u bytes), discard it.", pFrames->uFrameDataLength + (u32)iLength);
+      shared_mem_video_frames_discard_frame(pFrames);
+      return NULL;
+   }
+
+   // Frames are kept contiguous: if the frame would go past the end of the data area, move it to the start.
+   // The stream position is advanced before writing, so that the reader can detect overwrites.
+   if ( pFrames->uFrameDataOffset + pFrames->uFrameDataLength + (u32)iLength > SM_VIDEO_FRAMES_DATA_SIZE )
+   {
+      u32 uSkip = SM_VIDEO_FRAMES_DATA_SIZE - (pFrames->uFrameDataOffset + pFrames->uFrameDataLength);
+      pHeader->uStreamPosition += uSkip + pFrames->uFrameDataLength + (u32)iLength;
+      __sync_synchronize();
+      if ( pFrames->uFrameDataLength > 0 )
+         memmove(pFrames->pData, pFrames->pData + pFrames->uFrameDataOffset, pFrames->uFrameDataLength);
+      pFrames->uFrameDataOffset = 0;
+   }
+   else
+   {
+      pHeader->uStreamPosition += (u32)iLength;
+      __sync_synchronize();
+   }
+
+   u8* pWrite = pFrames->pData + pFrames->uFrameDataOffset + pFrames->uFrameDataLength;
+   pFrames->uFrameDataLength += (u32)iLength;
+   return pWrite;
+}
+
+void shared_mem_video_frames_add_flags(shared_mem_video_frames* pFrames, u32 uFlags)
+{
+   if ( (NULL != pFrames) && pFrames->iHasFrame )
+      pFrames->uFrameFlags |= uFlags;
+}
+
+int shared_mem_video_frames_end_frame(shared_mem_video_frames* pFrames)
+{
+   if ( (NULL == pFrames) || pFrames->iReadOnly || (! pFrames->iHasFrame) )
+      return 0;
+   pFrames->iHasFrame = 0;
+   if ( 0 == pFrames->uFrameDataLength )
+      return 0;
+
+   shared_mem_video_frames_header* pHeader = pFrames->pHeader;
+   shared_mem_video_frame_slot* pSlot = &(pHeader->slots[pHeader->uFramesWritten % SM_VIDEO_FRAMES_SLOTS]);
+   pSlot->uDataOffset = pFrames->uFrameDataOffset;
+   pSlot->uDataLength = pFrames->uFrameDataLength;
+   pSlot->uStreamPosition = pHeader->uStreamPosition - pFrames->uFrameDataLength;
+   pSlot->uFrameIndex = pFrames->uFrameIndex;
+   pSlot->uFlags = pFrames->uFrameFlags;
+   pSlot->uArrivalTimeMs = pFrames->uFrameArrivalTimeMs;
+   __sync_synchronize();
+   pHeader->uFramesWritten++;
+   return 1;
+}
+
+void shared_mem_video_frames_discard_frame(shared_mem_video_frames* pFrames)
+{
+   if ( NULL == pFrames )
+      return;
+   pFrames->iHasFrame = 0;
+   pFrames->uFrameDataLength = 0;
+}
+
+int shared_mem_video_frames_read_next(shared_mem_video_frames* pFrames, shared_mem_video_frame_slot* pSlot, u8** ppData)
+{
+   if ( (NULL == pFrames) || (NULL == pSlot) || (NULL == ppData) )
+      return 0;
+   shared_mem_video_frames_header* pHeader = pFrames->pHeader;
+   if ( pHeader->uMagic != SM_VIDEO_FRAMES_MAGIC )
+      return 0;
+
+   u32 uFramesWritten = pHeader->uFramesWritten;
+   __sync_synchronize();
+   if ( uFramesWritten == pFrames->uFramesRead )
+      return 0;
+
+   // Writer restarted or reader too far behind: skip to the most recent frames
+   if ( (uFramesWritten - pFrames->uFramesRead) > SM_VIDEO_FRAMES_SLOTS/2 )
+   {
+      pFrames->uFramesSkipped += uFramesWritten - 1 - pFrames->uFramesRead;
+      pFrames->uFramesRead = uFramesWritten - 1;
+   }
+
+   memcpy(pSlot, &(pHeader->slots[pFrames->uFramesRead % SM_VIDEO_FRAMES_SLOTS]), sizeof(shared_mem_video_frame_slot));
+   pFrames->uFramesRead++;
+
+   if ( (pSlot->uDataLength == 0) || (pSlot->uDataOffset + pSlot->uDataLength > SM_VIDEO_FRAMES_DATA_SIZE) ||
+        (! shared_mem_video_frames_is_still_valid(pFrames, pSlot)) )
+   {
+      pFrames->uFramesSkipped++;
+      return 0;
+   }
+   *ppData = pFrames->pData + pSlot->uDataOffset;
+   return 1;
+}
+
+int shared_mem_video_frames_is_still_valid(shared_mem_video_frames* pFrames, shared_mem_video_frame_slot* pSlot)
+{
+   if ( (NULL == pFrames) || (NULL == pSlot) )
+      return 0;
+   __sync_synchronize();
+   // Writing at stream position X overwrites the data at stream position X - data size
+   u32 uWriterAdvance = pFrames->pHeader->uStreamPosition - pSlot->uStreamPosition;
+   if ( uWriterAdvance > SM_VIDEO_FRAMES_DATA_SIZE )
+      return 0;
+   return 1;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "base.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Shared memory frame ring used to hand over the received video stream from the router to the local video player.
+// The router writes each video frame (access unit) contiguously in the data area and then publishes a slot
+// descriptor for it; the player reads the frames in place and feeds them to the decoder as whole frames.
+// In low latency mode (not waiting for full frames) each received video segment is published as soon as it is
+// written, as its own slot, flagged as partial unless it ends the frame.
+// Single writer, single reader. No locks: a slot is published by incrementing uFramesWritten after the slot is filled in,
+// and the reader checks after using a frame that the writer did not overwrite its data in the meantime.
+
+#define SM_VIDEO_FRAMES_MAGIC 0x52564652
+#define SM_VIDEO_FRAMES_SLOTS 512
+#define SM_VIDEO_FRAMES_DATA_SIZE (2*1024*1024)
+#define SM_VIDEO_FRAMES_HEADER_SIZE (16*1024)
+#define SM_VIDEO_FRAMES_TOTAL_SIZE (SM_VIDEO_FRAMES_HEADER_SIZE + SM_VIDEO_FRAMES_DATA_SIZE)
+
+#define SM_VIDEO_FRAME_FLAG_KEYFRAME ((u32)0x01)
+#define SM_VIDEO_FRAME_FLAG_H265 ((u32)0x02)
+#define SM_VIDEO_FRAME_FLAG_END_MISSING ((u32)0x04)
+#define SM_VIDEO_FRAME_FLAG_PARTIAL ((u32)0x08)
+
+typedef struct
+{
+   u32 uDataOffset; // in the data area
+   u32 uDataLength;
+   u32 uStreamPosition; // absolute stream position of the first byte (wraps), used to detect overwrites
+   u32 uFrameIndex;
+   u32 uFlags; // SM_VIDEO_FRAME_FLAG_*
+   u32 uArrivalTimeMs; // when the first data of the frame was received
+} shared_mem_video_frame_slot;
+
+typedef struct
+{
+   u32 uMagic;
+   u32 uDataSize;
+   volatile u32 uFramesWritten; // total published frames; frame n is in slot n % SM_VIDEO_FRAMES_SLOTS
+   volatile u32 uStreamPosition; // absolute stream position of the next byte to be written
+   shared_mem_video_frame_slot slots[SM_VIDEO_FRAMES_SLOTS];
+} shared_mem_video_frames_header;
+
+typedef struct
+{
+   shared_mem_video_frames_header* pHeader;
+   u8* pData;
+   int iReadOnly;
+
+   // Writer state: the frame being written
+   u32 uFrameDataOffset;
+   u32 uFrameDataLength;
+   u32 uFrameIndex;
+   u32 uFrameFlags;
+   u32 uFrameArrivalTimeMs;
+   int iHasFrame;
+
+   // Reader state
+   u32 uFramesRead;
+   u32 uFramesSkipped;
+} shared_mem_video_frames;
+
+shared_mem_video_frames* shared_mem_video_frames_open_write(const char* szName);
+shared_mem_video_frames* shared_mem_video_frames_open_read(const char* szName);
+void shared_mem_video_frames_close(const char* szName, shared_mem_video_frames* pFrames);
+
+// Writer
+
+// Starts a new frame if needed (publishing the previous one if it was not ended) and
+// returns a pointer where iLength bytes can be written for the current frame, or NULL if the frame does not fit.
+u8* shared_mem_video_frames_reserve(shared_mem_video_frames* pFrames, u32 uFrameIndex, int iLength, u32 uTimeNow);
+void shared_mem_video_frames_add_flags(shared_mem_video_frames* pFrames, u32 uFlags);
+// Publishes the current frame. Returns 1 if a frame was published.
+int  shared_mem_video_frames_end_frame(shared_mem_video_frames* pFrames);
+// Drops the frame being written
+void shared_mem_video_frames_discard_frame(shared_mem_video_frames* pFrames);
+
+// Reader
+
+// Returns 1 and the next frame (slot and pointer to its data) if one is available, 0 otherwise.
+// If the reader fell behind the writer by more than the slots count, it skips to the most recent frames.
+int shared_mem_video_frames_read_next(shared_mem_video_frames* pFrames, shared_mem_video_frame_slot* pSlot, u8** ppData);
+// Returns 1 if the data of a frame read is still valid (was not overwritten by the writer), 0 otherwise.
+int shared_mem_video_frames_is_still_valid(shared_mem_video_frames* pFrames, shared_mem_video_frame_slot* pSlot);
+
+#ifdef __cplusplus
+}  
+#endif
@@ -35,6 +35,7 @@
 #include "../base/config.h"
 #include "../base/models.h"
 #include "../base/hardware_procs.h"
+#include "../base/hardware_radio_nl80211.h"
 #include "../common/string_utils.h"
 #include "../radio/radioflags.h"
 
@@ -710,78 +711,108 @@ bool radio_utils_set_interface_frequency(Model* pModel, int iRadioIndex, int iAs
                   bTryHT40 = true;
          }
 
-         if ( bTryHT40 )
+         // Switch the frequency in-process using nl80211, fallback to iw/iwconfig commands if it fails
+         int iNLResult = -ENOSYS;
+         if ( bTryHT40 || pRadioInfo->isHighCapacityInterface )
          {
+            int iNLHT40 = 0;
             #if defined(HW_PLATFORM_RASPBERRY)
-            if ( pRadioInfo->iRadioType == RADIO_TYPE_ATHEROS )
+            if ( bTryHT40 )
+               iNLHT40 = 1;
+            #endif
+            iNLResult = hardware_radio_nl80211_set_frequency(pRadioInfo->szName, uFreqWifi, iNLHT40);
+            if ( (iNLResult == -EINVAL) && iNLHT40 && pRadioInfo->isHighCapacityInterface )
             {
-               sprintf(cmd, "iw dev %s set freq %u HT40+", pRadioInfo->szName, uFreqWifi);
-               bUsedHT40 = true;
+               log_softerror_and_alarm("Failed to switch radio interface %d (%s, %s) to frequency %s in HT40 mode, nl80211 error: %d. Retry operation.", i+1, pRadioInfo->szName, str_get_radio_driver_description(pRadioInfo->iRadioDriver), str_format_frequency(uFrequencyKhz), iNLResult);
+               hardware_sleep_ms(delayMs);
+               iNLHT40 = 0;
+               iNLResult = hardware_radio_nl80211_set_frequency(pRadioInfo->szName, uFreqWifi, iNLHT40);
             }
-            else
+            if ( (iNLResult == -EBUSY) || (iNLResult == -ENODEV) || (iNLResult == -ENETDOWN) )
             {
-               sprintf(cmd, "iw dev %s set freq %u HT40+", pRadioInfo->szName, uFreqWifi);
-               bUsedHT40 = true;
+               hardware_initialize_radio_interface(i, delayMs);
+               hardware_sleep_ms(delayMs);
+               iNLResult = hardware_radio_nl80211_set_frequency(pRadioInfo->szName, uFreqWifi, iNLHT40);
             }
-            #else
-               sprintf(cmd, "iwconfig %s freq %u000", pRadioInfo->szName, uFrequencyKhz);            
-            #endif
+            if ( (0 != iNLResult) && (-ENOSYS != iNLResult) )
+               log_softerror_and_alarm("Failed to switch radio interface %d (%s, %s) to frequency %s using nl80211, error: %d. Using iw instead.", i+1, pRadioInfo->szName, str_get_radio_driver_description(pRadioInfo->iRadioDriver), str_format_frequency(uFrequencyKhz), iNLResult);
          }
-         else if ( pRadioInfo->isHighCapacityInterface )
+
+         if ( 0 != iNLResult )
          {
-            #if defined(HW_PLATFORM_RASPBERRY)
-            sprintf(cmd, "iw dev %s set freq %u", pRadioInfo->szName, uFreqWifi);
-            #else
-            sprintf(cmd, "iwconfig %s freq %u000", pRadioInfo->szName, uFrequencyKhz);            
-            #endif
-         }
-         hw_execute_process(cmd, 0, szOutput, sizeof(szOutput)/sizeof(szOutput[0]));
+            if ( bTryHT40 )
+            {
+               #if defined(HW_PLATFORM_RASPBERRY)
+               if ( pRadioInfo->iRadioType == RADIO_TYPE_ATHEROS )
+               {
+                  sprintf(cmd, "iw dev %s set freq %u HT40+", pRadioInfo->szName, uFreqWifi);
+                  bUsedHT40 = true;
+               }
+               else
+               {
+                  sprintf(cmd, "iw dev %s set freq %u HT40+", pRadioInfo->szName, uFreqWifi);
+                  bUsedHT40 = true;
+               }
+               #else
+                  sprintf(cmd, "iwconfig %s freq %u000", pRadioInfo->szName, uFrequencyKhz);            
+               #endif
+            }
+            else if ( pRadioInfo->isHighCapacityInterface )
+            {
+               #if defined(HW_PLATFORM_RASPBERRY)
+               sprintf(cmd, "iw dev %s set freq %u", pRadioInfo->szName, uFreqWifi);
+               #else
+               sprintf(cmd, "iwconfig %s freq %u000", pRadioInfo->szName, uFrequencyKhz);            
+               #endif
+            }
+            hw_execute_process(cmd, 0, szOutput, sizeof(szOutput)/sizeof(szOutput[0]));
          
-         if ( 5 < strlen(szOutput) )
-            log_softerror_and_alarm("Received a response from set freq command: [%s]", szOutput);
+            if ( 5 < strlen(szOutput) )
+               log_softerror_and_alarm("Received a response from set freq command: [%s]", szOutput);
            
-         if ( NULL != strstr( szOutput, "Invalid argument" ) )
-         if ( bUsedHT40 )
-         if ( pRadioInfo->isHighCapacityInterface )
-         {
-            int len = strlen(szOutput);
-            for( int k=0; k<len; k++ )
+            if ( NULL != strstr( szOutput, "Invalid argument" ) )
+            if ( bUsedHT40 )
+            if ( pRadioInfo->isHighCapacityInterface )
             {
-               if ( szOutput[k] == 10 || szOutput[k] == 13 )
-                  szOutput[k] = '.';
+               int len = strlen(szOutput);
+               for( int k=0; k<len; k++ )
+               {
+                  if ( szOutput[k] == 10 || szOutput[k] == 13 )
+                     szOutput[k] = '.';
+               }
+               log_softerror_and_alarm("Failed to switch radio interface %d (%s, %s) to frequency %s in HT40 mode, returned error: [%s]. Retry operation.", i+1, pRadioInfo->szName, str_get_radio_driver_description(pRadioInfo->iRadioDriver), str_format_frequency(uFrequencyKhz), szOutput);
+               hardware_sleep_ms(delayMs);
+               szOutput[0] = 0;
+               #if defined(HW_PLATFORM_RASPBERRY)
+               sprintf(cmd, "iw dev %s set freq %u", pRadioInfo->szName, uFreqWifi);
+               #else
+               sprintf(cmd, "iwconfig %s freq %u000", pRadioInfo->szName, uFrequencyKhz);
+               #endif
+               hw_execute_bash_command_raw(cmd, szOutput);
             }
-            log_softerror_and_alarm("Failed to switch radio interface %d (%s, %s) to frequency %s in HT40 mode, returned error: [%s]. Retry operation.", i+1, pRadioInfo->szName, str_get_radio_driver_description(pRadioInfo->iRadioDriver), str_format_frequency(uFrequencyKhz), szOutput);
-            hardware_sleep_ms(delayMs);
-            szOutput[0] = 0;
-            #if defined(HW_PLATFORM_RASPBERRY)
-            sprintf(cmd, "iw dev %s set freq %u", pRadioInfo->szName, uFreqWifi);
-            #else
-            sprintf(cmd, "iwconfig %s freq %u000", pRadioInfo->szName, uFrequencyKhz);
-            #endif
-            hw_execute_bash_command_raw(cmd, szOutput);
-         }
 
-         if ( (NULL != strstr(szOutput, "busy")) || (NULL != strstr(szOutput, "such device")) )
-         {
-             hardware_initialize_radio_interface(i, delayMs);
-             hardware_sleep_ms(delayMs);
-             hw_execute_process(cmd, 0, szOutput, sizeof(szOutput)/sizeof(szOutput[0]));
-         }
-         if ( NULL != strstr(szOutput, "failed") )
-         {
-            pRadioInfo->lastFrequencySetFailed = 1;
-            pRadioInfo->uFailedFrequencyKhz = uFrequencyKhz;
-            pRadioInfo->uCurrentFrequencyKhz = 0;
-            failed = true;
-            int len = strlen(szOutput);
-            for( int k=0; k<len; k++ )
+            if ( (NULL != strstr(szOutput, "busy")) || (NULL != strstr(szOutput, "such device")) )
             {
-               if ( szOutput[k] == 10 || szOutput[k] == 13 )
-                  szOutput[k] = '.';
+                hardware_initialize_radio_interface(i, delayMs);
+                hardware_sleep_ms(delayMs);
+                hw_execute_process(cmd, 0, szOutput, sizeof(szOutput)/sizeof(szOutput[0]));
+            }
+            if ( NULL != strstr(szOutput, "failed") )
+            {
+               pRadioInfo->lastFrequencySetFailed = 1;
+               pRadioInfo->uFailedFrequencyKhz = uFrequencyKhz;
+               pRadioInfo->uCurrentFrequencyKhz = 0;
+               failed = true;
+               int len = strlen(szOutput);
+               for( int k=0; k<len; k++ )
+               {
+                  if ( szOutput[k] == 10 || szOutput[k] == 13 )
+                     szOutput[k] = '.';
+               }
+               log_softerror_and_alarm("Failed to switch radio interface %d (%s, %s) to frequency %s, returned error: [%s]", i+1, pRadioInfo->szName, str_get_radio_driver_description(pRadioInfo->iRadioDriver), str_format_frequency(uFrequencyKhz), szOutput);
+               hardware_sleep_ms(delayMs);
+               continue;
             }
-            log_softerror_and_alarm("Failed to switch radio interface %d (%s, %s) to frequency %s, returned error: [%s]", i+1, pRadioInfo->szName, str_get_radio_driver_description(pRadioInfo->iRadioDriver), str_format_frequency(uFrequencyKhz), szOutput);
-            hardware_sleep_ms(delayMs);
-            continue;
          }
       }
       
@@ -838,45 +869,31 @@ bool radio_utils_set_datarate_atheros(Model* pModel, int iCard, int dataRate_bps
       return true;
    }
 
-   char cmd[1024];
-
-   //sprintf(cmd, "ifconfig %s down", pRadioHWInfo->szName );
-   sprintf(cmd, "ip link set dev %s down", pRadioHWInfo->szName);
-   hw_execute_bash_command(cmd, NULL);
+   hardware_radio_wifi_set_link_up(pRadioHWInfo->szName, 0);
    hardware_sleep_ms(delayMs);
 
-   sprintf(cmd, "iw dev %s set type managed", pRadioHWInfo->szName );
-   hw_execute_bash_command(cmd, NULL);
+   hardware_radio_wifi_set_type_monitor(pRadioHWInfo->szName, 0);
    hardware_sleep_ms(delayMs);
 
-   //sprintf(cmd, "ifconfig %s up", pRadioHWInfo->szName );
-   sprintf(cmd, "ip link set dev %s up", pRadioHWInfo->szName);
-   hw_execute_bash_command(cmd, NULL);
+   hardware_radio_wifi_set_link_up(pRadioHWInfo->szName, 1);
    hardware_sleep_ms(delayMs);
 
    if ( dataRate_bps > 0 )
-      sprintf(cmd, "iw dev %s set bitrates legacy-2.4 %d", pRadioHWInfo->szName, dataRate_bps/1000/1000 );
+      hardware_radio_wifi_set_bitrates_2ghz(pRadioHWInfo->szName, dataRate_bps/1000/1000, 0);
    else
-      sprintf(cmd, "iw dev %s set bitrates ht-mcs-2.4 %d", pRadioHWInfo->szName, -dataRate_bps-1 );
-   hw_execute_bash_command(cmd, NULL);
+      hardware_radio_wifi_set_bitrates_2ghz(pRadioHWInfo->szName, dataRate_bps, 0);
    hardware_sleep_ms(delayMs);
 
-   //sprintf(cmd, "ifconfig %s down", pRadioHWInfo->szName );
-   sprintf(cmd, "ip link set dev %s down", pRadioHWInfo->szName);
-   hw_execute_bash_command(cmd, NULL);
+   hardware_radio_wifi_set_link_up(pRadioHWInfo->szName, 0);
    hardware_sleep_ms(delayMs);
 
-   sprintf(cmd, "iw dev %s set monitor none", pRadioHWInfo->szName );
-   hw_execute_bash_command(cmd, NULL);
+   hardware_radio_wifi_set_monitor_flags(pRadioHWInfo->szName, 0);
    hardware_sleep_ms(delayMs);
 
-   sprintf(cmd, "iw dev %s set monitor fcsfail", pRadioHWInfo->szName );
-   hw_execute_bash_command(cmd, NULL);
+   hardware_radio_wifi_set_monitor_flags(pRadioHWInfo->szName, NL80211_MONITOR_FLAG_FCSFAIL);
    hardware_sleep_ms(delayMs);
 
-   //sprintf(cmd, "ifconfig %s up", pRadioHWInfo->szName );
-   sprintf(cmd, "ip link set dev %s up", pRadioHWInfo->szName);
-   hw_execute_bash_command(cmd, NULL);
+   hardware_radio_wifi_set_link_up(pRadioHWInfo->szName, 1);
    hardware_sleep_ms(delayMs);
 
    pRadioHWInfo->iCurrentDataRateBPS = dataRate_bps;
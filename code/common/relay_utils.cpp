@@ -48,6 +48,15 @@ bool relay_controller_is_vehicle_id_relayed_vehicle(Model* pMainModel, u32 uVehi
    return true;
 }
 
+u32 relay_get_relayed_vehicle_id(Model* pMainModel)
+{
+   if ( NULL == pMainModel )
+      return 0;
+   if ( (pMainModel->relay_params.isRelayEnabledOnRadioLinkId < 0) || (pMainModel->relay_params.uRelayedVehicleId == pMainModel->uVehicleId) )
+      return 0;
+   return pMainModel->relay_params.uRelayedVehicleId;
+}
+
 bool relay_controller_must_display_video_from(Model* pMainModel, u32 uRelayedVehicleId)
 {
    if ( (NULL == pMainModel) || (0 == uRelayedVehicleId) )
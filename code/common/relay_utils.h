@@ -1,6 +1,8 @@
 #pragma once
 
 bool relay_controller_is_vehicle_id_relayed_vehicle(Model* pMainModel, u32 uVehicleId);
+// The relayed vehicle id, or 0 if the model does not relay a vehicle
+u32 relay_get_relayed_vehicle_id(Model* pMainModel);
 
 bool relay_controller_must_display_video_from(Model* pMainModel, u32 uRelayedVehicleId);
 bool relay_controller_must_display_remote_video(Model* pMainModel);
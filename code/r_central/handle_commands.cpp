@@ -956,6 +956,9 @@ bool handle_last_command_result()
 
       case COMMAND_ID_SET_ENCRYPTION_PARAMS:
          g_pCurrentModel->enc_flags = s_CommandBuffer[0];
+         // Same as on the vehicle: the authenticated mode applies to all the streams
+         if ( g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_AUTHENTICATED )
+            g_pCurrentModel->enc_flags |= MODEL_ENC_FLAG_ENC_ALL;
          saveControllerModel(g_pCurrentModel);
          send_model_changed_message_to_router(MODEL_CHANGED_GENERIC, 0);
          break;
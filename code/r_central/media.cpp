@@ -102,6 +102,11 @@ void _media_remove_invalid_files()
          snprintf(szComm, sizeof(szComm)/sizeof(szComm[0]), "rm -rf %s%s", FOLDER_MEDIA, szFile);
          hw_execute_bash_command(szComm, NULL);
 
+         szFile[pos] = 0;
+         strcat(szFile, "mp4");
+         snprintf(szComm, sizeof(szComm)/sizeof(szComm[0]), "rm -rf %s%s", FOLDER_MEDIA, szFile);
+         hw_execute_bash_command(szComm, NULL);
+
          szFile[pos] = 0;
          strcat(szFile, "info");
          snprintf(szComm, sizeof(szComm)/sizeof(szComm[0]), "rm -rf %s%s", FOLDER_MEDIA, szFile);
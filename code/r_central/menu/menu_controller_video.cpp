@@ -207,6 +207,8 @@ MenuControllerVideo::MenuControllerVideo(void)
    m_pItemsSelect[10]->addSelection(L("Disabled"));
    m_pItemsSelect[10]->addSelection("Raw (H264)");
    m_pItemsSelect[10]->addSelection("RTP Stream");
+   m_pItemsSelect[10]->addSelection("RTP (H264/H265)");
+   m_pItemsSelect[10]->addSelection("RTP + RTCP");
    m_pItemsSelect[10]->setIsEditable();
    m_IndexVideoETHForward = addMenuItem(m_pItemsSelect[10]);
 
@@ -802,6 +802,10 @@ bool MenuStorage::moveVideos(bool bDelete)
          strcpy(szComm2, szCommand);
          strcat(szComm2, " 2>/dev/null");
          hw_execute_bash_command(szComm2, NULL);
+         hardware_file_replace_extension(szCommand, "mp4");
+         strcpy(szComm2, szCommand);
+         strcat(szComm2, " 2>/dev/null");
+         hw_execute_bash_command(szComm2, NULL);
          hardware_file_replace_extension(szCommand, "osd");
          strcpy(szComm2, szCommand);
          strcat(szComm2, " 2>/dev/null");
@@ -174,6 +174,7 @@ void MenuVehicleRadioConfig::populate()
    m_pItemsSelect[2]->addSelection("Data Streams Only");
    m_pItemsSelect[2]->addSelection("Video and Data Streams");
    m_pItemsSelect[2]->addSelection("All Streams and Data");
+   m_pItemsSelect[2]->addSelection("All Streams and Data, Authenticated");
    m_pItemsSelect[2]->setIsEditable();
    m_IndexEncryption = addMenuItem(m_pItemsSelect[2]);
    */
@@ -195,6 +196,9 @@ void MenuVehicleRadioConfig::populate()
       if ( g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_ENC_ALL )
          m_pItemsSelect[2]->setSelectedIndex(4); 
 
+      if ( g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_AUTHENTICATED )
+         m_pItemsSelect[2]->setSelectedIndex(5); 
+
       if ( ! m_bControllerHasKey )
       {
          m_pItemsSelect[2]->setSelectedIndex(0);
@@ -726,6 +730,8 @@ void MenuVehicleRadioConfig::onSelectItem()
          params[0] = MODEL_ENC_FLAG_ENC_VIDEO | MODEL_ENC_FLAG_ENC_DATA;
       if ( 4 == m_pItemsSelect[2]->getSelectedIndex() )
          params[0] = MODEL_ENC_FLAG_ENC_ALL;
+      if ( 5 == m_pItemsSelect[2]->getSelectedIndex() )
+         params[0] = MODEL_ENC_FLAG_ENC_ALL | MODEL_ENC_FLAG_AUTHENTICATED;
 
       if ( 0 != m_pItemsSelect[2]->getSelectedIndex() )
       {
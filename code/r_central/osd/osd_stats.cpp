@@ -862,6 +862,10 @@ float osd_render_stats_video_decode(float xPos, float yPos, int iDeveloperMode,
          snprintf(szBuff, sizeof(szBuff)/sizeof(szBuff[0]), "%u (%u)", g_SMControllerRTInfo.uTotalCountOutputSkippedBlocks, g_uTotalLocalAlarmDevRetransmissions);
          g_pRenderEngine->setColors(get_Color_Dev());
          _osd_stats_draw_line(xPos, rightMargin, y, s_idFontStatsSmall, L("Dropped video blocks (total alarms):"), szBuff);
+         y += height_text_small*s_OSDStatsLineSpacing;
+
+         snprintf(szBuff, sizeof(szBuff)/sizeof(szBuff[0]), "%u / %u", g_SMControllerRTInfo.uTotalFECDecodeMatrixCacheHits, g_SMControllerRTInfo.uTotalFECDecodeMatrixCacheMisses);
+         _osd_stats_draw_line(xPos, rightMargin, y, s_idFontStatsSmall, L("EC decode cache hits / misses:"), szBuff);
          osd_set_colors();
          y += height_text_small*s_OSDStatsLineSpacing;
       }
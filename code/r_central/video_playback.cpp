@@ -129,6 +129,18 @@ void video_playback_play_file(const char* szVideoInfoFile)
    snprintf(szComm, sizeof(szComm)/sizeof(szComm[0]), "./%s -file %s%s -fps %d", VIDEO_PLAYER_OFFLINE, FOLDER_MEDIA, szFile, iFPS);
    #endif
 
+   // mp4 recordings: the players take a raw stream, extracted from the mp4 file while playing
+   int iFileNameLen = strlen(szFile);
+   if ( (iFileNameLen > 4) && (0 == strcmp(szFile + iFileNameLen - 4, ".mp4")) )
+   {
+      snprintf(szComm, sizeof(szComm)/sizeof(szComm[0]), "./ruby_video_proc -annexb %s%s | ./%s -file /dev/stdin -fps %d", FOLDER_MEDIA, szFile, VIDEO_PLAYER_OFFLINE, iFPS);
+      // The player can't tell the codec from the stdin file name, use the type from the info file
+      #ifdef HW_PLATFORM_RADXA
+      if ( iType == VIDEO_TYPE_H265 )
+         strcat(szComm, " -h265");
+      #endif
+   }
+
    if ( g_pControllerSettings->iCoresAdjustment )
    {
       char szTmp[32];
@@ -61,6 +61,7 @@ bool g_bMPPFramesBuffersInitialised = false;
 bool g_bMPPFrameEOS = false;
 bool g_bMPPStreamChangedFlag = false;
 bool g_bMPPEnableVSync = true;
+bool g_bMPPInputIsCompleteFrames = false;
 
 u32 g_uMPPCPUAffinityMask = 0;
 int g_iMPPCPUAffinityCoreIndex = -1;
@@ -418,6 +419,11 @@ int mpp_start_decoding_thread()
 }
 
 
+void mpp_set_input_is_complete_frames(bool bCompleteFrames)
+{
+   g_bMPPInputIsCompleteFrames = bCompleteFrames;
+}
+
 int mpp_init(bool bUseH265Decoder, int iMPPBuffersSize, u32 uCPUAffinityMask, int iRawPriority)
 {
    log_line("[MPP] Doing MPP Initialization (for codec %s, buffers size: %d, cpu affinity mask: %u, raw priority: %d)...", (bUseH265Decoder?"H265":"H264"), iMPPBuffersSize, uCPUAffinityMask, iRawPriority);
@@ -534,7 +540,9 @@ int mpp_init(bool bUseH265Decoder, int iMPPBuffersSize, u32 uCPUAffinityMask, in
       return -4;
    }
 
-   RK_U32 split_video_input = 1;
+   // Complete frames as input: no need for the parser to split the input stream into frames
+   RK_U32 split_video_input = g_bMPPInputIsCompleteFrames?0:1;
+   log_line("[MPP] Input is %s.", g_bMPPInputIsCompleteFrames?"complete frames":"a byte stream, split it into frames");
    iRes = mpp_dec_cfg_set_u32(pMPPConfig, "base:split_parse", split_video_input);
    if ( iRes )
    {
@@ -548,7 +556,8 @@ int mpp_init(bool bUseH265Decoder, int iMPPBuffersSize, u32 uCPUAffinityMask, in
       return -6;
    }
 
-   _mpp_send_command(MPP_DEC_SET_PARSER_SPLIT_MODE, 0xffff);
+   if ( ! g_bMPPInputIsCompleteFrames )
+      _mpp_send_command(MPP_DEC_SET_PARSER_SPLIT_MODE, 0xffff);
    _mpp_send_command(MPP_DEC_SET_DISABLE_ERROR, 0xffff);
    _mpp_send_command(MPP_DEC_SET_IMMEDIATE_OUT, 0xffff);
    _mpp_send_command(MPP_DEC_SET_ENABLE_FAST_PLAY, 0xffff);
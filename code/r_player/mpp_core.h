@@ -16,6 +16,8 @@
 
 extern shared_mem_process_stats* g_pSMProcessStats;
 
+// Must be called before mpp_init. When true, each input data fed to the decoder is a complete frame (access unit)
+void mpp_set_input_is_complete_frames(bool bCompleteFrames);
 int mpp_init(bool bUseH265Decoder, int iMPPBuffersSize, u32 uCPUAffinityMask, int iRawPriority);
 int mpp_uninit();
 void mpp_enable_vsync(bool bEnableVSync);
@@ -60,6 +60,7 @@
 #include "../base/hardware.h"
 #include "../base/hardware_procs.h"
 #include "../base/hdmi.h"
+#include "../base/shared_mem_video_frames.h"
 #include "../base/parser_h264.h"
 #include "../renderer/drm_core.h"
 #include <ctype.h>
@@ -598,6 +599,10 @@ void _do_stream_mode_sm()
    log_line("HDMI mode to use: %d (%d x %d @ %d)", iHDMIIndex, hdmi_get_current_resolution_width(), hdmi_get_current_resolution_height(), hdmi_get_current_resolution_refresh() );
    ruby_drm_core_init(1, DRM_FORMAT_NV12, hdmi_get_current_resolution_width(), hdmi_get_current_resolution_height(), hdmi_get_current_resolution_refresh());
 
+   // The router hands over whole frames, no need for the decoder to split the input stream,
+   // unless it is in low latency mode (not waiting for full frames): then it publishes each video segment as it arrives
+   bool bInputIsCompleteFrames = pCS->iWaitFullFrameForOutput?true:false;
+   mpp_set_input_is_complete_frames(bInputIsCompleteFrames);
    if ( mpp_init(g_bUseH265Decoder, pCS->iVideoMPPBuffersSize, g_uCPUAffinityMask, g_iRawPriority) != 0 )
    {
       if ( NULL != s_pSemaphoreSMData )
@@ -607,33 +612,10 @@ void _do_stream_mode_sm()
       return;
    }
 
-   int fdSMem = -1;
-   unsigned char* pSMem = NULL;
-   uint32_t uSharedMemReadPos = 0;
-
-   fdSMem = shm_open(SM_STREAMER_NAME, O_RDONLY, S_IRUSR | S_IWUSR);
-
-   if( fdSMem < 0 )
+   shared_mem_video_frames* pSMFrames = shared_mem_video_frames_open_read(SM_STREAMER_NAME);
+   if ( NULL == pSMFrames )
    {
-      log_softerror_and_alarm("Failed to open shared memory for read: %s, error: %d %s", SM_STREAMER_NAME, errno, strerror(errno));
-      
-      if ( NULL != s_pSemaphoreSMData )
-           sem_close(s_pSemaphoreSMData);
-      s_pSemaphoreSMData = NULL;
-      mpp_uninit();
-      ruby_drm_core_uninit();
-      return;
-   }
-   
-   pSMem = (unsigned char*) mmap(NULL, SM_STREAMER_SIZE, PROT_READ, MAP_SHARED, fdSMem, 0);
-   if ( (pSMem == MAP_FAILED) || (pSMem == NULL) )
-   {
-      log_softerror_and_alarm("Failed to map shared memory: %s, error: %d %s", SM_STREAMER_NAME, errno, strerror(errno));
-      if ( NULL != pSMem )
-      {
-         munmap(pSMem, SM_STREAMER_SIZE);
-         log_line("Unmapped shared mem: %s", SM_STREAMER_NAME);
-      }
+      log_softerror_and_alarm("Failed to open shared memory frames ring for read: %s", SM_STREAMER_NAME);
       if ( NULL != s_pSemaphoreSMData )
            sem_close(s_pSemaphoreSMData);
       s_pSemaphoreSMData = NULL;
@@ -641,113 +623,110 @@ void _do_stream_mode_sm()
       ruby_drm_core_uninit();
       return;
    }
-   close(fdSMem); 
-   log_line("Mapped shared mem: %s", SM_STREAMER_NAME);
+   log_line("Mapped shared mem frames ring: %s", SM_STREAMER_NAME);
 
    mpp_enable_vsync(pCS->iHDMIVSync?true:false);
    mpp_start_decoding_thread();
 
    u32 uTimeLastCheck = get_current_timestamp_ms();
-   int nRead = 1;
    int iCount =0;
    int iTotalRead = 0;
+   u32 uFramesOverwritten = 0;
    bool bAnyInputEver = false;
    u32 uTimeStartReceivingStream = 0;
+   shared_mem_video_frame_slot frameSlot;
+   u8* pFrameData = NULL;
+
+   // The router can still publish segments of frames (when it skips missing data to catch up),
+   // they are put back together here if the decoder expects whole frames
+   u8* pAssembledFrame = NULL;
+   int iAssembledLength = 0;
+   u32 uAssembledFrameIndex = 0;
+   if ( bInputIsCompleteFrames )
+      pAssembledFrame = (u8*) malloc(SM_VIDEO_FRAMES_DATA_SIZE/2);
   
    while ( !g_bQuit )
    {
-      u32* pTmp1 = (u32*)pSMem;
-      u32* pTmp2 = (u32*)(&(pSMem[sizeof(u32)]));
-      u32 uWritePos1 = 0;
-      u32 uWritePos2 = 0;
-      u32 uBytesToRead = 0;
-
-      while ((uBytesToRead == 0) && (!g_bQuit))
+      g_pSMProcessStats->lastActiveTime = get_current_timestamp_ms();
+      if ( ! shared_mem_video_frames_read_next(pSMFrames, &frameSlot, &pFrameData) )
       {
-         g_pSMProcessStats->lastActiveTime = get_current_timestamp_ms();
-         uWritePos1 = *pTmp1;
-         uWritePos2 = *pTmp2;
-         if ( (uSharedMemReadPos == uWritePos1) || (uWritePos1 != uWritePos2) )
+         struct timespec ts;
+         clock_gettime(CLOCK_REALTIME, &ts);
+         ts.tv_nsec += 1000LL*(long long)10000; // 10 milisec
+         if ( ts.tv_nsec >= 1000000000LL )
          {
-            struct timespec ts;
-            clock_gettime(CLOCK_REALTIME, &ts);
-            ts.tv_nsec += 1000LL*(long long)10000; // 10 milisec
-            int iResSem = sem_timedwait(s_pSemaphoreSMData, &ts);
-            if ( 0 != iResSem )
-            {
-               if ( errno != ETIMEDOUT )
-                  log_softerror_and_alarm("Failed to timewait on semaphore. Error: %d, %s", errno, strerror(errno));
-               continue;
-            }
-            is_semaphore_signaled_clear_logok(s_pSemaphoreSMData, SEMAPHORE_SM_VIDEO_DATA_AVAILABLE, 0);
-
-            uWritePos1 = *pTmp1;
-            uWritePos2 = *pTmp2;
-            if ( (uSharedMemReadPos == uWritePos1) || (uWritePos1 != uWritePos2) )
-               continue;
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000LL;
          }
-         if ( uWritePos1 > uSharedMemReadPos )
+         int iResSem = sem_timedwait(s_pSemaphoreSMData, &ts);
+         if ( 0 != iResSem )
          {
-            uBytesToRead = uWritePos1 - uSharedMemReadPos;
-            if ( uBytesToRead > PIPE_BUFFER_SIZE )
-               uBytesToRead = PIPE_BUFFER_SIZE;
-            memcpy(g_uPipeBuffer, &pSMem[uSharedMemReadPos], uBytesToRead);
-            uSharedMemReadPos += uBytesToRead;
-            if ( uSharedMemReadPos >= SM_STREAMER_SIZE )
-               uSharedMemReadPos = 2*sizeof(u32);
+            if ( errno != ETIMEDOUT )
+               log_softerror_and_alarm("Failed to timewait on semaphore. Error: %d, %s", errno, strerror(errno));
          }
          else
-         {
-            uBytesToRead = (SM_STREAMER_SIZE - uSharedMemReadPos);
-            if ( uBytesToRead > PIPE_BUFFER_SIZE )
-               uBytesToRead = PIPE_BUFFER_SIZE;
-            memcpy(g_uPipeBuffer, &pSMem[uSharedMemReadPos], uBytesToRead);
-            uSharedMemReadPos += uBytesToRead;
-            if ( uSharedMemReadPos >= SM_STREAMER_SIZE )
-               uSharedMemReadPos = 2*sizeof(u32);
-            if ( (PIPE_BUFFER_SIZE- uBytesToRead > 0) && (uWritePos1 > 0) )
-            {
-               unsigned char* pTmpB = &(g_uPipeBuffer[0]) + uBytesToRead;
-
-               u32 uBytesToRead2 = uWritePos1 - 2*sizeof(u32);
-               if ( uBytesToRead2 + uBytesToRead > PIPE_BUFFER_SIZE )
-                  uBytesToRead2 = PIPE_BUFFER_SIZE - uBytesToRead;
-               memcpy(pTmpB, &pSMem[uSharedMemReadPos], uBytesToRead2);
-               uSharedMemReadPos += uBytesToRead2;
-               uBytesToRead += uBytesToRead2;
-            }
-         }
-      } 
-      if ( g_bQuit )
-         break;
+            is_semaphore_signaled_clear_logok(s_pSemaphoreSMData, SEMAPHORE_SM_VIDEO_DATA_AVAILABLE, 0);
+         continue;
+      }
 
       g_pSMProcessStats->lastIPCIncomingTime = get_current_timestamp_ms();
 
       if ( ! bAnyInputEver )
       {
-         log_line("Start receiving video stream data through pipe (%d bytes)", nRead);
+         log_line("Start receiving video stream frames through shared mem (%u bytes, frame %u, %s)", frameSlot.uDataLength, frameSlot.uFrameIndex, (frameSlot.uFlags & SM_VIDEO_FRAME_FLAG_KEYFRAME)?"keyframe":"not keyframe");
          bAnyInputEver = true;
          uTimeStartReceivingStream = get_current_timestamp_ms();
       }
 
-      nRead = uBytesToRead;
       iCount++;
-      iTotalRead += nRead;
+      iTotalRead += frameSlot.uDataLength;
       if ( (iCount % 10) == 0 )
       {
          u32 uTime = get_current_timestamp_ms();
          if ( uTime >= uTimeLastCheck + 4000 )
          {
             uTimeLastCheck = uTime;
-            log_line("Video player alive, reading %d kbits/sec", iTotalRead*8/4/1000);
+            log_line("Video player alive, reading %d kbits/sec, %u frames skipped, %u frames overwritten while decoding", iTotalRead*8/4/1000, pSMFrames->uFramesSkipped, uFramesOverwritten);
             iTotalRead = 0;
          }
       }
 
-      int iRes = mpp_feed_data_to_decoder(g_uPipeBuffer, nRead);
+      int iRes = 0;
+      if ( (NULL != pAssembledFrame) && ((iAssembledLength > 0) || (frameSlot.uFlags & SM_VIDEO_FRAME_FLAG_PARTIAL)) )
+      {
+         // Flush the segments of a previous frame whose end was lost
+         if ( (iAssembledLength > 0) && (frameSlot.uFrameIndex != uAssembledFrameIndex) )
+         {
+            iRes = mpp_feed_data_to_decoder(pAssembledFrame, iAssembledLength);
+            iAssembledLength = 0;
+         }
+         if ( iAssembledLength + (int)frameSlot.uDataLength <= SM_VIDEO_FRAMES_DATA_SIZE/2 )
+         {
+            memcpy(pAssembledFrame + iAssembledLength, pFrameData, frameSlot.uDataLength);
+            if ( shared_mem_video_frames_is_still_valid(pSMFrames, &frameSlot) )
+            {
+               iAssembledLength += (int)frameSlot.uDataLength;
+               uAssembledFrameIndex = frameSlot.uFrameIndex;
+            }
+            else
+               uFramesOverwritten++;
+         }
+         if ( (iAssembledLength > 0) && (! (frameSlot.uFlags & SM_VIDEO_FRAME_FLAG_PARTIAL)) )
+         {
+            iRes = mpp_feed_data_to_decoder(pAssembledFrame, iAssembledLength);
+            iAssembledLength = 0;
+         }
+      }
+      else
+      {
+         // The frame (or segment, in low latency mode) is fed in place, from the shared memory
+         iRes = mpp_feed_data_to_decoder(pFrameData, (int)frameSlot.uDataLength);
+         if ( ! shared_mem_video_frames_is_still_valid(pSMFrames, &frameSlot) )
+            uFramesOverwritten++;
+      }
       if ( iRes > 5 )
       {
-         log_line("Stalled consuming %d bytes, stall for %d ms. Signaling alarm", nRead, iRes);
+         log_line("Stalled consuming %u bytes, stall for %d ms. Signaling alarm", frameSlot.uDataLength, iRes);
          if ( get_current_timestamp_ms() > uTimeStartReceivingStream + 5000 )
          {
             sem_t* ps = sem_open(SEMAPHORE_VIDEO_STREAMER_OVERLOAD, O_CREAT, S_IWUSR | S_IRUSR, 0);
@@ -768,11 +747,9 @@ void _do_stream_mode_sm()
    mpp_mark_end_of_stream();
    mpp_uninit();
 
-   if ( NULL != pSMem )
-   {
-      munmap(pSMem, SM_STREAMER_SIZE);
-      log_line("Unmapped shared mem: %s", SM_STREAMER_NAME);
-   }
+   shared_mem_video_frames_close(SM_STREAMER_NAME, pSMFrames);
+   if ( NULL != pAssembledFrame )
+      free(pAssembledFrame);
    if ( NULL != s_pSemaphoreSMData )
         sem_close(s_pSemaphoreSMData);
    s_pSemaphoreSMData = NULL;
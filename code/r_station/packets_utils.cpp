@@ -619,9 +619,15 @@ bool _send_packet_to_wifi_radio_interface(int iLocalRadioLinkId, int iRadioInter
    if ( (g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_ENC_DATA) || (g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_ENC_ALL) )
    if ( hpp() )
       be = 1;
+   // The authenticated mode applies to all the streams: the vehicle drops the packets that are not authenticated
+   if ( (g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_AUTHENTICATED) && hpp() )
+      be = ENC_MODE_AUTHENTICATED;
 
    int iDataRateTx = _compute_packet_uplink_datarate_radioflags_tx_power(iVehicleRadioLinkId, iRadioInterfaceIndex, pPacketData);
    int totalLength = radio_build_new_raw_ieee_packet(iLocalRadioLinkId, s_RadioRawPacket, pPacketData, nPacketLength, RADIO_PORT_ROUTER_UPLINK, be);
+   // Not built (no pass phrase, or too big for the authenticated encryption); already logged
+   if ( totalLength <= 0 )
+      return false;
 
    bool bShouldDuplicate = false;
 
@@ -244,6 +244,7 @@ bool _switch_to_vehicle(Model* pTmp)
    g_pCurrentModel = getCurrentModel();
    if ( ! reloadCurrentModel() )
       log_softerror_and_alarm("Failed to load current model.");
+   update_radio_auth_encryption_requirement();
 
    reasign_radio_links(true);
    video_processors_init();
@@ -299,6 +300,7 @@ void _process_local_notification_model_changed(t_packet_header* pPH, u8 uChangeT
    // Reload new model state
    if ( ! reloadCurrentModel() )
       log_softerror_and_alarm("Failed to load current model.");
+   update_radio_auth_encryption_requirement();
 
    if ( uChangeType == MODEL_CHANGED_DEVELOPER_FLAGS )
    {
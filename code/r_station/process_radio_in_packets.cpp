@@ -1219,6 +1219,9 @@ void process_received_single_radio_packet(int iInterfaceIndex, u8* pData, int iD
             ruby_ipc_channel_send_message(g_fIPCToTelemetry, pData, iDataLength);
       }
 
+      if ( (uPacketType == PACKET_TYPE_RC_TELEMETRY) && (! bIsRelayedPacket) )
+         process_rc_info_from_vehicle(pData, iDataLength);
+
       if ( is_sw_version_atleast(pModel, 11, 6) )
       {
          if ( uPacketType == PACKET_TYPE_FC_TELEMETRY )
@@ -74,8 +74,7 @@
 #include "ruby_rt_station.h"
 #include "test_link_params.h"
 #include "adaptive_video.h"
-
-#define DEFAULT_RETRANSMISSION_MIN_REQUEST_INTERVAL_MS 5
+#include "retr_scheduler.h"
 
 extern t_packet_queue s_QueueRadioPacketsHighPrio;
 
@@ -129,6 +128,7 @@ ProcessorRxVideo::ProcessorRxVideo(u32 uVehicleId, u8 uVideoStreamIndex)
    m_bMustParseStream = false;
    m_bWasParsingStream = false;
    m_ParserH264.init();
+   retr_scheduler_init(&m_RetrScheduler, DEFAULT_VIDEO_RETRANS_MINIMUM_RETRY_INTERVAL, DEFAULT_VIDEO_RETRANS_MINIMUM_RETRY_INTERVAL*10);
 
    m_pVideoRxBuffer = new VideoRxPacketsBuffer(uVideoStreamIndex, 0);
    Model* pModel = findModelWithId(uVehicleId, 201);
@@ -189,6 +189,7 @@ bool ProcessorRxVideo::init()
 
    m_uRetryRetransmissionAfterTimeoutMiliseconds = g_pControllerSettings->nRetryRetransmissionAfterTimeoutMS;
    log_line("[ProcessorRxVideo] Using timers: Retransmission retry after timeout of %d ms; Request retransmission after video silence (no video packets) timeout of %d ms", m_uRetryRetransmissionAfterTimeoutMiliseconds, g_pControllerSettings->nRequestRetransmissionsOnVideoSilenceMs);
+   retr_scheduler_init(&m_RetrScheduler, m_uRetryRetransmissionAfterTimeoutMiliseconds, m_uRetryRetransmissionAfterTimeoutMiliseconds*10);
       
    fullResetState("init");
   
@@ -215,18 +216,17 @@ void ProcessorRxVideo::resetReceiveState()
    controller_debug_video_rt_info_init(&g_SMControllerDebugVideoRTInfo);
 
    m_uRetryRetransmissionAfterTimeoutMiliseconds = g_pControllerSettings->nRetryRetransmissionAfterTimeoutMS;
-   m_uTimeIntervalMsForRequestingRetransmissions = DEFAULT_RETRANSMISSION_MIN_REQUEST_INTERVAL_MS;
 
    log_line("[ProcessorRxVideo] Using timers: Retransmission retry after timeout of %d ms; Request retransmission after video silence (no video packets) timeout of %d ms", m_uRetryRetransmissionAfterTimeoutMiliseconds, g_pControllerSettings->nRequestRetransmissionsOnVideoSilenceMs);
    
    if ( NULL != m_pVideoRxBuffer )
       m_pVideoRxBuffer->emptyBuffers("Reset receiver state.");
+   retr_scheduler_reset(&m_RetrScheduler);
 
    m_uTimeLastVideoStreamChanged = g_TimeNow;
 
    m_uLastTimeCheckedForMissingPackets = g_TimeNow;
    m_uLastTopBlockIdRequested = MAX_U32;
-   m_iMaxRecvPacketTopBlockWhenRequested = -1;
 
    m_uRequestRetransmissionUniqueId = 0;
    m_uLastVideoBlockIndexResolutionChange = 0;
@@ -268,6 +268,7 @@ void ProcessorRxVideo::onControllerSettingsChanged()
 
    m_uRetryRetransmissionAfterTimeoutMiliseconds = g_pControllerSettings->nRetryRetransmissionAfterTimeoutMS;
    log_line("[ProcessorRxVideo]: Using timers: Retransmission retry after timeout of %d ms; Request retransmission after video silence (no video packets) timeout of %d ms", m_uRetryRetransmissionAfterTimeoutMiliseconds, g_pControllerSettings->nRequestRetransmissionsOnVideoSilenceMs);
+   retr_scheduler_init(&m_RetrScheduler, m_uRetryRetransmissionAfterTimeoutMiliseconds, m_uRetryRetransmissionAfterTimeoutMiliseconds*10);
    fullResetState("controller settings changed");
 }
 
@@ -476,6 +477,8 @@ void ProcessorRxVideo::handleReceivedVideoRetrPacket(int interfaceNb, u8* pBuffe
 
    m_uLastTimeReceivedRetransmission = g_TimeNow;
    pCtrlRTInfo->uCountAckRetransmissions[g_SMControllerRTInfo.iCurrentIndex]++;
+   if ( pPHVS->uStreamInfoFlags == VIDEO_STREAM_INFO_FLAG_RETRANSMISSION_ID )
+      retr_scheduler_on_retransmission_response(&m_RetrScheduler, pPHVS->uStreamInfo, g_TimeNow);
    if ( pPHVS->uStreamInfoFlags == VIDEO_STREAM_INFO_FLAG_RETRANSMISSION_ID )
    if ( pPHVS->uStreamInfo == m_uRequestRetransmissionUniqueId )
    {
@@ -561,6 +564,7 @@ void ProcessorRxVideo::handleReceivedVideoRetrPacket(int interfaceNb, u8* pBuffe
             pPHVS->uStreamInfo);
    }
 
+   retr_scheduler_on_packet(&m_RetrScheduler, pPHVS->uCurrentBlockIndex, pPHVS->uCurrentBlockPacketIndex, pPHVS->uCurrentBlockDataPackets, pPHVS->uCurrentBlockECPackets, g_TimeNow);
    if ( ! m_pVideoRxBuffer->checkAddVideoPacket(pBuffer, iBufferLength) )
       return;
 
@@ -646,6 +650,7 @@ void ProcessorRxVideo::handleReceivedVideoPacket(int interfaceNb, u8* pBuffer, i
    }
    #endif
 
+   retr_scheduler_on_packet(&m_RetrScheduler, pPHVS->uCurrentBlockIndex, pPHVS->uCurrentBlockPacketIndex, pPHVS->uCurrentBlockDataPackets, pPHVS->uCurrentBlockECPackets, g_TimeNow);
 
    if ( ! m_pVideoRxBuffer->checkAddVideoPacket(pBuffer, iBufferLength) )
    {
@@ -698,7 +703,7 @@ void ProcessorRxVideo::_checkAndOutputAvailablePackets(type_global_state_vehicle
       pVideoPacket = m_pVideoRxBuffer->getBottomBlockAndPacketInBuffer(&pVideoBlock);
       
       // Reached an empty packet?
-      if ( (0 == pVideoBlock->uReceivedTime) || pVideoPacket->bEmpty )
+      if ( (0 == pVideoBlock->uReceivedTime) || (! RX_VIDEO_BLOCK_HAS_PACKET(pVideoBlock, (int)(pVideoPacket - pVideoBlock->packets))) )
             break;
 
       // Output and advance to next video packet, even if empty
@@ -714,11 +719,12 @@ void ProcessorRxVideo::processAndOutputVideoPacket(type_rx_video_block_info* pVi
    t_packet_header_video_segment_important* pPHVSImp = pVideoPacket->pPHVSImp;
    u8* pVideoRawStreamData = pVideoPacket->pVideoData;
    pVideoRawStreamData += sizeof(t_packet_header_video_segment_important);
+   bool bReconstructed = RX_VIDEO_BLOCK_IS_PACKET_RECONSTRUCTED(pVideoBlock, (int)(pVideoPacket - pVideoBlock->packets))?true:false;
 
 
    if ( g_pControllerSettings->iEnableDebugStats ||
         ((NULL != g_pCurrentModel) && (g_pCurrentModel->osd_params.osd_flags2[g_pCurrentModel->osd_params.iCurrentOSDScreen] & OSD_FLAG2_SHOW_VIDEO_FRAMES_STATS)) )
-      _updateDebugStatsOnVideoPacket(pVideoPacket);
+      _updateDebugStatsOnVideoPacket(pVideoPacket, bReconstructed);
 
    memcpy(&m_LastOutputedVideoPacketInfo, pPHVS, sizeof(t_packet_header_video_segment));
    memcpy(&m_CopyLastOutputedVideoRxBlockInfo, pVideoBlock, sizeof(type_rx_video_block_info));
@@ -805,7 +811,7 @@ void ProcessorRxVideo::processAndOutputVideoPacket(type_rx_video_block_info* pVi
    }
 
    static u32 s_uLastOutputedVideoBlockIdReconstructed = 0;
-   if ( pVideoPacket->bReconstructed )
+   if ( bReconstructed )
    if ( s_uLastOutputedVideoBlockIdReconstructed != pVideoBlock->uVideoBlockIndex )
    {
       s_uLastOutputedVideoBlockIdReconstructed = pVideoBlock->uVideoBlockIndex;
@@ -904,7 +910,7 @@ void ProcessorRxVideo::updateControllerRTInfoAndVideoDecodingStats(u8* pRadioPac
    }
 }
 
-void ProcessorRxVideo::_updateDebugStatsOnVideoPacket(type_rx_video_packet_info* pVideoPacket)
+void ProcessorRxVideo::_updateDebugStatsOnVideoPacket(type_rx_video_packet_info* pVideoPacket, bool bReconstructed)
 {
    u8* pRadioPacket = pVideoPacket->pRawData;
    t_packet_header* pPH = (t_packet_header*)pRadioPacket;
@@ -941,7 +947,7 @@ void ProcessorRxVideo::_updateDebugStatsOnVideoPacket(type_rx_video_packet_info*
       return;
 
 
-   if ( pVideoPacket->bReconstructed )
+   if ( bReconstructed )
    {
       u8 uPckts = (g_SMControllerDebugVideoRTInfo.uOutputFramePackets[g_SMControllerDebugVideoRTInfo.iCurrentFrameBufferIndex] >> 16) & 0xFF;
       uPckts++;
@@ -1086,8 +1092,6 @@ int ProcessorRxVideo::checkAndRequestMissingPackets(bool bForceSyncNow)
    if ( m_bPauseTempRetrUntillANewVideoPacket )
       return -1;
 
-   if ( (!bForceSyncNow) && (! router_is_eof()) )
-      return -1;
    checkUpdateRetransmissionsState();
 
    m_iMilisecondsMaxRetransmissionWindow = pModel->getCurrentVideoProfileMaxRetransmissionWindow();
@@ -1124,29 +1128,27 @@ int ProcessorRxVideo::checkAndRequestMissingPackets(bool bForceSyncNow)
          return -1;
    }
 
-   if ( (!bForceSyncNow) && (g_TimeNow < m_uLastTimeRequestedRetransmission + m_uTimeIntervalMsForRequestingRetransmissions) )
-      return -1;
-
    int iCountBlocks = m_pVideoRxBuffer->getCountBlocksInBuffer();
    if ( 0 == iCountBlocks )
       return -1;
 
-   type_rx_video_block_info* pVideoBlockDbg = m_pVideoRxBuffer->getBlockInBufferFromBottom(0);
-   /*
-   log_line("DBG retr check: video buffer has %d blocks to check. Bottom block: f%d blk %u, scheme %d/%d, recv %d/%d pckts, frame has %d pckts, this block has %d to %d f pckts",
-       iCountBlocks, pVideoBlockDbg->uH264FrameIndex,
-       pVideoBlockDbg->uVideoBlockIndex,
-       pVideoBlockDbg->iBlockDataPackets, pVideoBlockDbg->iBlockECPackets,
-       pVideoBlockDbg->iRecvDataPackets, pVideoBlockDbg->iRecvECPackets,
-       pVideoBlockDbg->iTotalFramePackets,
-       pVideoBlockDbg->iFramePacketStart, pVideoBlockDbg->iFramePacketEnd
-       );
-   */
+   // The retransmissions scheduler keeps the missing packets set; sync it with the rx buffer and
+   // close the top block if the frame ended (nothing else will be received for it)
 
-   if ( g_TimeNow >= m_uLastTimeRequestedRetransmission + m_iMilisecondsMaxRetransmissionWindow )
-      m_uTimeIntervalMsForRequestingRetransmissions = DEFAULT_RETRANSMISSION_MIN_REQUEST_INTERVAL_MS;
+   bool bIsEOF = bForceSyncNow || router_is_eof();
+   retr_scheduler_set_max_retry_timeout(&m_RetrScheduler, (u32)m_iMilisecondsMaxRetransmissionWindow/3);
+   retr_scheduler_discard_blocks_before(&m_RetrScheduler, m_pVideoRxBuffer->getBufferBottomVideoBlockIndex());
+   if ( bIsEOF )
+      retr_scheduler_on_frame_end(&m_RetrScheduler, g_TimeNow);
 
-   // Request all missing packets except current block which is requested only on some cases
+   // Requests are sent at the end of the video frame, when the uplink is not competing with the video stream,
+   // unless a due block would get past the retransmission window before the response could arrive.
+
+   u32 uDeadline = retr_scheduler_get_due_deadline(&m_RetrScheduler, g_TimeNow, (u32)m_iMilisecondsMaxRetransmissionWindow, bIsEOF);
+   if ( 0 == uDeadline )
+      return 0;
+   if ( (! bIsEOF) && (uDeadline > g_TimeNow + 2*retr_scheduler_get_retry_timeout_ms(&m_RetrScheduler)) )
+      return 0;
 
    //#define PACKET_TYPE_VIDEO_REQ_MULTIPLE_PACKETS 20
    // params after header:
@@ -1156,8 +1158,10 @@ int ProcessorRxVideo::checkAndRequestMissingPackets(bool bForceSyncNow)
    //         bit 0: contains re-requested packets
    //         bit 1: contains request for start of video frame packets at the end
    //         bit 2: contains request for end of video frame packets at the end
-   //   u8: number of individual video packets requested
+   //         bit 3: requests are packet ranges
+   //   u8: number of individual video packets (or ranges) requested
    //   (u32+u8)*n = each (video block index + video packet index) requested
+   //   or (u32+u8+u8)*n = each (video block index + first video packet index + packets count) requested
    //   (u16+u8) frame id and frame packets from start to get
    //   (u16+u8) frame id and frame packets to EOF to get
 
@@ -1175,218 +1179,101 @@ int ProcessorRxVideo::checkAndRequestMissingPackets(bool bForceSyncNow)
       log_softerror_and_alarm("[ProcessorRxVideo] Tried to request retransmissions before having received a video packet.");
    }
 
-   u8 packet[MAX_PACKET_TOTAL_SIZE];
-   u8* pDataInfo = packet + sizeof(t_packet_header) + sizeof(u32) + 3*sizeof(u8);
-   u32 uTopVideoBlockIdInBuffer = 0;
-   int iTopVideoBlockPacketIndexInBuffer = -1;
-   //u32 uTopVideoBlockLastRecvTime = 0;
-   u32 uLastRequestedVideoBlockIndex = 0;
-   int iLastRequestedVideoBlockPacketIndex = 0;
-
-   char szBufferBlocks[128];
-   szBufferBlocks[0] = 0;
-
+   u8 uRanges[DEFAULT_VIDEO_RETRANS_MAX_PCOUNT * RETR_SCHED_RANGE_SIZE];
    int iCountPacketsRequested = 0;
-   type_rx_video_block_info* pVideoBlock = NULL;
    bool bContainsReRequestedPackets = false;
+   int iCountRanges = retr_scheduler_build_request(&m_RetrScheduler, g_TimeNow, (u32)m_iMilisecondsMaxRetransmissionWindow, bIsEOF,
+      uRanges, DEFAULT_VIDEO_RETRANS_MAX_PCOUNT, DEFAULT_VIDEO_RETRANS_MAX_PCOUNT, &iCountPacketsRequested, &bContainsReRequestedPackets);
+   if ( (0 == iCountRanges) || (0 == iCountPacketsRequested) )
+      return 0;
 
-   for( int i=0; i<iCountBlocks-1; i++ )
-   {
-      pVideoBlock = m_pVideoRxBuffer->getBlockInBufferFromBottom(i);
-      if ( i < 2 )
-      {
-         if ( 0 != szBufferBlocks[0] )
-            strcat(szBufferBlocks, ", ");
-         char szTmp[128];
-         sprintf(szTmp, "[f%d %u %d/%d pckts of %d/%d, eof %d]", pVideoBlock->uH264FrameIndex, pVideoBlock->uVideoBlockIndex, pVideoBlock->iRecvDataPackets, pVideoBlock->iRecvECPackets, pVideoBlock->iBlockDataPackets, pVideoBlock->iBlockECPackets, pVideoBlock->iLastRecordedEOF);
-         strcat(szBufferBlocks, szTmp);
-      }
+   // Older vehicles only understand individual packets requests
 
-      if ( 0 == (pVideoBlock->iRecvDataPackets + pVideoBlock->iRecvECPackets) )
+   bool bUseRanges = (get_sw_version_build(pModel) >= 11705);
+   u8 packet[MAX_PACKET_TOTAL_SIZE];
+   u8* pDataInfo = packet + sizeof(t_packet_header) + sizeof(u32) + 3*sizeof(u8);
+   u32 uTopVideoBlockIndex = m_pVideoRxBuffer->getBufferTopVideoBlockIndex();
+   m_uLastTopBlockIdRequested = MAX_U32;
+
+   for( int i=0; i<iCountRanges; i++ )
+   {
+      u8* pRange = uRanges + i*RETR_SCHED_RANGE_SIZE;
+      u32 uBlockIndex = 0;
+      memcpy(&uBlockIndex, pRange, sizeof(u32));
+      if ( uBlockIndex == uTopVideoBlockIndex )
+         m_uLastTopBlockIdRequested = uBlockIndex;
+      if ( bUseRanges )
       {
-         memcpy(pDataInfo, &pVideoBlock->uVideoBlockIndex, sizeof(u32));
-         pDataInfo += sizeof(u32);
-         u8 uPacketIndex = 0xFF;
-         memcpy(pDataInfo, &uPacketIndex, sizeof(u8));
-         pDataInfo += sizeof(u8);
-         iCountPacketsRequested++;
-         //log_line("DBG will request full block [%u]", pVideoBlock->uVideoBlockIndex);
+         memcpy(pDataInfo, pRange, RETR_SCHED_RANGE_SIZE);
+         pDataInfo += RETR_SCHED_RANGE_SIZE;
          continue;
       }
-
-      int iCountToRequestFromBlock = pVideoBlock->iBlockDataPackets - pVideoBlock->iRecvDataPackets - pVideoBlock->iRecvECPackets;
-      if ( pVideoBlock->iBlockDataPackets == 0 )
-         iCountToRequestFromBlock = 1;
-      if ( iCountToRequestFromBlock <= 0 )
-         continue;
-
-      for( int k=0; k<pVideoBlock->iBlockDataPackets+1; k++ )
+      int iCount = (0xFF == pRange[sizeof(u32)])?1:(int)pRange[sizeof(u32)+1];
+      for( int k=0; k<iCount; k++ )
       {
-         if ( NULL == pVideoBlock->packets[k].pRawData )
-            continue;
-         if ( ! pVideoBlock->packets[k].bEmpty )
-            continue;
-
-         if ( 0 != pVideoBlock->packets[k].uRequestedTime )
-            bContainsReRequestedPackets = true;
-         pVideoBlock->packets[k].uRequestedTime = g_TimeNow;
-         uLastRequestedVideoBlockIndex = pVideoBlock->uVideoBlockIndex;
-         iLastRequestedVideoBlockPacketIndex = k;
-         memcpy(pDataInfo, &pVideoBlock->uVideoBlockIndex, sizeof(u32));
+         memcpy(pDataInfo, &uBlockIndex, sizeof(u32));
          pDataInfo += sizeof(u32);
-         u8 uPacketIndex = k;
-         memcpy(pDataInfo, &uPacketIndex, sizeof(u8));
-         pDataInfo += sizeof(u8);
-
-         iCountToRequestFromBlock--;
-         iCountPacketsRequested++;
-         if ( iCountToRequestFromBlock == 0 )
-            break;
-         if ( iCountPacketsRequested >= DEFAULT_VIDEO_RETRANS_MAX_PCOUNT )
-           break;
-      }
-   
-      if ( iCountPacketsRequested >= DEFAULT_VIDEO_RETRANS_MAX_PCOUNT )
-        break;
-   }
-
-   // Check and handle top block. Frame ended at this point, so request data if missing
-
-   pVideoBlock = m_pVideoRxBuffer->getBlockInBufferFromBottom(iCountBlocks-1);
-   int iCountToRequestFromBlock = pVideoBlock->iBlockDataPackets - pVideoBlock->iRecvDataPackets - pVideoBlock->iRecvECPackets;
-
-   m_uLastTopBlockIdRequested = MAX_U32;
-   m_iMaxRecvPacketTopBlockWhenRequested = -1;
-
-   if ( (0 != pVideoBlock->iBlockDataPackets) && (pVideoBlock->iMaxReceivedDataOrECPacketIndex >= 0) && (iCountToRequestFromBlock > 0) )
-   {
-      /*log_line("DBG rx video check top block f%d [%u-%d/%d] for retransmissions, recv %d + %d packets, EOF computed as %u ms ago for frame %d",
-        pVideoBlock->uH264FrameIndex, pVideoBlock->uVideoBlockIndex, pVideoBlock->iBlockDataPackets, pVideoBlock->iBlockECPackets,
-        pVideoBlock->iRecvDataPackets, pVideoBlock->iRecvECPackets, g_TimeNow - radio_rx_get_current_frame_end_time(), radio_rx_get_current_frame_number());
-      */
-      uTopVideoBlockIdInBuffer = pVideoBlock->uVideoBlockIndex;
-      iTopVideoBlockPacketIndexInBuffer = pVideoBlock->iMaxReceivedDataOrECPacketIndex;
-      //uTopVideoBlockLastRecvTime = pVideoBlock->uReceivedTime;
-
-      if ( 0 != szBufferBlocks[0] )
-         strcat(szBufferBlocks, ", ");
-      char szTmp[128];
-      sprintf(szTmp, "t[f%d %u %d/%d pckts of %d/%d, eof %d]", pVideoBlock->uH264FrameIndex, pVideoBlock->uVideoBlockIndex, pVideoBlock->iRecvDataPackets, pVideoBlock->iRecvECPackets, pVideoBlock->iBlockDataPackets, pVideoBlock->iBlockECPackets, pVideoBlock->iLastRecordedEOF);
-      strcat(szBufferBlocks, szTmp);
-
-      bool bRequestData = false;
-
-      // Not enough EC packets to reconstruct
-      if ( (pVideoBlock->iRecvDataPackets + pVideoBlock->iRecvECPackets) < pVideoBlock->iBlockDataPackets )
-      {
-         for( int k=0; k<pVideoBlock->iBlockDataPackets; k++ )
-         {
-            if ( NULL == pVideoBlock->packets[k].pRawData )
-               continue;
-            if ( ! pVideoBlock->packets[k].bEmpty )
-               continue;
-
-            if ( 0 != pVideoBlock->packets[k].uRequestedTime )
-               bContainsReRequestedPackets = true;
-            pVideoBlock->packets[k].uRequestedTime = g_TimeNow;
-            uLastRequestedVideoBlockIndex = pVideoBlock->uVideoBlockIndex;
-            iLastRequestedVideoBlockPacketIndex = k;
-            memcpy(pDataInfo, &pVideoBlock->uVideoBlockIndex, sizeof(u32));
-            pDataInfo += sizeof(u32);
-            u8 uPacketIndex = k;
-            memcpy(pDataInfo, &uPacketIndex, sizeof(u8));
-            pDataInfo += sizeof(u8);
-
-            iCountToRequestFromBlock--;
-            iCountPacketsRequested++;
-            if ( iCountToRequestFromBlock == 0 )
-               break;
-            if ( iCountPacketsRequested >= DEFAULT_VIDEO_RETRANS_MAX_PCOUNT )
-              break;
-         }
-         m_uLastTopBlockIdRequested = pVideoBlock->uVideoBlockIndex;
-         m_iMaxRecvPacketTopBlockWhenRequested = pVideoBlock->iMaxReceivedDataOrECPacketIndex;
-         log_line("[ProcessorRxVideo] Will request top block (%u, scheme %d/%d, %d blocks in Rx buffer, bottom block is: %u) has %d/%d recv data/ec packets, max recv index: %d, last recv packet %u ms ago, last retr check %u ms ago, last check for video rx %u ms ago, will request %d packets.",
-             pVideoBlock->uVideoBlockIndex, pVideoBlock->iBlockDataPackets, pVideoBlock->iBlockECPackets,
-             iCountBlocks, m_pVideoRxBuffer->getBufferBottomVideoBlockIndex(),
-             pVideoBlock->iRecvDataPackets, pVideoBlock->iRecvECPackets, pVideoBlock->iMaxReceivedDataOrECPacketIndex,
-             g_TimeNow - pVideoBlock->uReceivedTime, g_TimeNow - uTimePrevCheck, g_TimeNow - router_get_last_time_checked_for_video_packets(),
-             iCountPacketsRequested);
+         *pDataInfo = (0xFF == pRange[sizeof(u32)])?0xFF:(pRange[sizeof(u32)] + k);
+         pDataInfo++;
       }
    }
 
    // Do we have full missing blocks at the end of frame?
-   pVideoBlock = m_pVideoRxBuffer->getBlockInBufferFromBottom(iCountBlocks-1);
+   type_rx_video_block_info* pVideoBlock = m_pVideoRxBuffer->getBlockInBufferFromBottom(iCountBlocks-1);
    bool bMissingEnd = false;
+   if ( bIsEOF )
    if ( pVideoBlock->iFramePacketEnd < pVideoBlock->iTotalFramePackets-1 )
    {
-      //log_line("DBG we have missing full blocks at end of f%d. Blocks in rx-buffer: %d, last block: [%u], frame total packets: %d, last received block end frame packet: %d",
-      //   pVideoBlock->uH264FrameIndex, iCountBlocks, pVideoBlock->uVideoBlockIndex, pVideoBlock->iTotalFramePackets, pVideoBlock->iFramePacketEnd);
       bMissingEnd = true;
       memcpy(pDataInfo, &(pVideoBlock->uH264FrameIndex), sizeof(u16));
       pDataInfo += sizeof(u16);
       *pDataInfo = pVideoBlock->iFramePacketEnd + 1;
       pDataInfo++;
    }
-   if ( iCountPacketsRequested == 0 )
-      return 0;
 
    u8 uFlags = 0;
-   u8 uCount = iCountPacketsRequested;
+   u8 uCount = bUseRanges?iCountRanges:iCountPacketsRequested;
    m_uRequestRetransmissionUniqueId++;
 
    if ( bContainsReRequestedPackets )
       uFlags |= 0x01;
    if ( bMissingEnd )
       uFlags |= 0x01<<2;
+   if ( bUseRanges )
+      uFlags |= 0x01<<3;
    memcpy(packet + sizeof(t_packet_header), (u8*)&m_uRequestRetransmissionUniqueId, sizeof(u32));
    memcpy(packet + sizeof(t_packet_header) + sizeof(u32), (u8*)&m_uVideoStreamIndex, sizeof(u8));
    memcpy(packet + sizeof(t_packet_header) + sizeof(u32) + sizeof(u8), (u8*)&uFlags, sizeof(u8));
    memcpy(packet + sizeof(t_packet_header) + sizeof(u32) + 2*sizeof(u8), (u8*)&uCount, sizeof(u8));
-   PH.total_length = sizeof(t_packet_header) + sizeof(u32) + 3*sizeof(u8);
-   PH.total_length += iCountPacketsRequested*(sizeof(u32) + sizeof(u8)); 
-   if ( bMissingEnd )
-      PH.total_length += sizeof(u16) + sizeof(u8);
-
+   PH.total_length = (u16)(pDataInfo - packet);
    memcpy(packet, (u8*)&PH, sizeof(t_packet_header));
 
-   if ( g_TimeNow < m_uLastTimeRequestedRetransmission + m_iMilisecondsMaxRetransmissionWindow )
-   if ( m_uTimeIntervalMsForRequestingRetransmissions < 10 )
-       m_uTimeIntervalMsForRequestingRetransmissions++;
-
    u32 uLastRetransmissionRequestTime = m_uLastTimeRequestedRetransmission;
    m_uLastTimeRequestedRetransmission = g_TimeNow;
+   retr_scheduler_on_request_sent(&m_RetrScheduler, m_uRequestRetransmissionUniqueId, g_TimeNow);
 
    controller_runtime_info_vehicle* pRTInfo = controller_rt_info_get_vehicle_info(&g_SMControllerRTInfo, m_uVehicleId);
    if ( NULL != pRTInfo )
    {
       pRTInfo->uCountReqRetransmissions[g_SMControllerRTInfo.iCurrentIndex]++;
-      if ( pRTInfo->uCountReqRetrPackets[g_SMControllerRTInfo.iCurrentIndex] + uCount > 255 )
+      if ( pRTInfo->uCountReqRetrPackets[g_SMControllerRTInfo.iCurrentIndex] + iCountPacketsRequested > 255 )
          pRTInfo->uCountReqRetrPackets[g_SMControllerRTInfo.iCurrentIndex] = 255;
       else
-         pRTInfo->uCountReqRetrPackets[g_SMControllerRTInfo.iCurrentIndex] += uCount;
+         pRTInfo->uCountReqRetrPackets[g_SMControllerRTInfo.iCurrentIndex] += iCountPacketsRequested;
    }
 
-   pDataInfo = packet + sizeof(t_packet_header) + sizeof(u32) + 3*sizeof(u8);
-   u32 uFirstReqBlockIndex =0;
-   memcpy(&uFirstReqBlockIndex, pDataInfo, sizeof(u32));
-   if ( 1 == iCountPacketsRequested )
-      log_line("[ProcessorRxVideo] * Requested retr id %u from vehicle for 1 packet ([%u/%d]) (%s%s), last retr req was %u ms ago, EOF was detected %u ms ago for frame %d",
-         m_uRequestRetransmissionUniqueId, uFirstReqBlockIndex, (int)pDataInfo[sizeof(u32)],
-         bContainsReRequestedPackets?"has re-requested packets":"no re-requests",
-         bMissingEnd?", has missing frame end":"", g_TimeNow - uLastRetransmissionRequestTime, g_TimeNow - radio_rx_get_current_frame_end_time(), radio_rx_get_current_frame_number() );
-   else
-      log_line("[ProcessorRxVideo] * Requested retr id %u from vehicle for %d packets ([%u/%d]...[%u/%d]) (%s%s), last retr req was %u ms ago, EOF was detected %u ms ago for frame %d",
-         m_uRequestRetransmissionUniqueId, iCountPacketsRequested,
-         uFirstReqBlockIndex, (int)pDataInfo[sizeof(u32)], uLastRequestedVideoBlockIndex, iLastRequestedVideoBlockPacketIndex,
-         bContainsReRequestedPackets?"has re-requested packets":"no re-requests",
-         bMissingEnd?", has missing frame end":"", g_TimeNow - uLastRetransmissionRequestTime, g_TimeNow - radio_rx_get_current_frame_end_time(), radio_rx_get_current_frame_number());
-   
-   log_line("[ProcessorRxVideo] * Video blocks in buffer: %d (%s), top/max video block in buffer: [%u/pkt %d] / [%u/pkt %d], last recv video pkt [f%d %u/%u eof %d], received %u ms ago",
-      iCountBlocks, szBufferBlocks, uTopVideoBlockIdInBuffer, iTopVideoBlockPacketIndexInBuffer, m_pVideoRxBuffer->getBufferTopVideoBlockIndex(), m_pVideoRxBuffer->getTopBufferMaxReceivedVideoBlockPacketIndex(),
+   u32 uFirstReqBlockIndex = 0;
+   memcpy(&uFirstReqBlockIndex, uRanges, sizeof(u32));
+   log_line("[ProcessorRxVideo] * Requested retr id %u from vehicle for %d packets in %d ranges (first: [%u/%d]) (%s%s)%s, last retr req was %u ms ago (last check %u ms ago), EOF %s, retry timeout: %u ms, smoothed RTT: %u ms",
+      m_uRequestRetransmissionUniqueId, iCountPacketsRequested, iCountRanges, uFirstReqBlockIndex, (int)uRanges[sizeof(u32)],
+      bContainsReRequestedPackets?"has re-requested packets":"no re-requests",
+      bMissingEnd?", has missing frame end":"", bUseRanges?"":" (as individual packets)",
+      g_TimeNow - uLastRetransmissionRequestTime, g_TimeNow - uTimePrevCheck,
+      bIsEOF?"detected":"not detected, request is urgent",
+      retr_scheduler_get_retry_timeout_ms(&m_RetrScheduler), retr_scheduler_get_smoothed_rtt_ms(&m_RetrScheduler));
+   log_line("[ProcessorRxVideo] * Video blocks in buffer: %d, bottom/top video block in buffer: [%u] / [%u/pkt %d], last recv video pkt [f%d %u/%u eof %d], received %u ms ago",
+      iCountBlocks, m_pVideoRxBuffer->getBufferBottomVideoBlockIndex(), uTopVideoBlockIndex, m_pVideoRxBuffer->getTopBufferMaxReceivedVideoBlockPacketIndex(),
       m_NewestReceivedVideoPacketInfo.uH264FrameIndex, m_NewestReceivedVideoPacketInfo.uCurrentBlockIndex, m_NewestReceivedVideoPacketInfo.uCurrentBlockPacketIndex, m_NewestReceivedVideoPacketInfo.uVideoStatusFlags2 & VIDEO_STATUS_FLAGS2_MASK_EOF_COUNTER, g_TimeNow - m_uNewestReceivedVideoPacketTime);
-   //log_line("[ProcessorRxVideo] Max Video block packet received: [%u/%d], top video block last recv time: %u ms ago",
-   //   m_pVideoRxBuffer->getBufferTopVideoBlockIndex(), m_pVideoRxBuffer->getTopBufferMaxReceivedVideoBlockPacketIndex(), g_TimeNow - uTopVideoBlockLastRecvTime);
 
    packets_queue_add_packet_mark_time(&s_QueueRadioPacketsHighPrio, packet);
    return iCountPacketsRequested;
@@ -5,6 +5,7 @@
 #include "../base/parser_h264.h"
 #include "video_rx_buffers.h"
 #include "shared_vars_state.h"
+#include "retr_scheduler.h"
 
 #define MAX_RETRANSMISSION_BUFFER_HISTORY_LENGTH 20
 
@@ -107,7 +108,7 @@ class ProcessorRxVideo
       
       void updateControllerRTInfoAndVideoDecodingStats(u8* pRadioPacket, int iPacketLength);
       
-      void _updateDebugStatsOnVideoPacket(type_rx_video_packet_info* pVideoPacket);
+      void _updateDebugStatsOnVideoPacket(type_rx_video_packet_info* pVideoPacket, bool bReconstructed);
       void _checkUpdateRetransmissionsState();
       void checkUpdateRetransmissionsState();
       // Returns how many retransmission packets where requested, if any
@@ -128,7 +129,6 @@ class ProcessorRxVideo
 
       u32 m_uRetryRetransmissionAfterTimeoutMiliseconds;
       int m_iMilisecondsMaxRetransmissionWindow;
-      u32 m_uTimeIntervalMsForRequestingRetransmissions;
 
       // Output state
       t_packet_header_video_segment m_LastOutputedVideoPacketInfo;
@@ -152,7 +152,7 @@ class ProcessorRxVideo
       u32 m_uLastTimeReceivedRetransmission;
 
       u32 m_uLastTopBlockIdRequested;
-      int m_iMaxRecvPacketTopBlockWhenRequested;
+      t_retr_scheduler m_RetrScheduler;
 
       u32 m_uEncodingsChangeCount;
       u32 m_uTimeLastVideoStreamChanged;
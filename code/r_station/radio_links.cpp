@@ -36,6 +36,7 @@
 #include "../base/ctrl_interfaces.h"
 #include "../base/ctrl_preferences.h"
 #include "../base/hardware_radio.h"
+#include "../base/hardware_radio_nl80211.h"
 #include "../base/hardware_radio_sik.h"
 #include "../base/hardware_radio_serial.h"
 #include "../base/hardware_procs.h"
@@ -647,28 +648,22 @@ void radio_links_set_monitor_mode()
          continue;
 
       #ifdef HW_PLATFORM_RADXA
-      char szComm[128];
       //sprintf(szComm, "iwconfig %s mode monitor 2>&1", pRadioHWInfo->szName );
       //hw_execute_bash_command(szComm, NULL);
       //hardware_sleep_ms(uDelayMS);
 
-      sprintf(szComm, "iw dev %s set monitor none 2>&1", pRadioHWInfo->szName);
-      hw_execute_bash_command(szComm, NULL);
+      hardware_radio_wifi_set_monitor_flags(pRadioHWInfo->szName, 0);
       hardware_sleep_ms(uDelayMS);
 
-      sprintf(szComm, "iw dev %s set monitor fcsfail 2>&1", pRadioHWInfo->szName);
-      hw_execute_bash_command(szComm, NULL);
+      hardware_radio_wifi_set_monitor_flags(pRadioHWInfo->szName, NL80211_MONITOR_FLAG_FCSFAIL);
       hardware_sleep_ms(uDelayMS);
       #endif
 
       #ifdef HW_PLATFORM_RASPBERRY
-      char szComm[128];
-      sprintf(szComm, "iw dev %s set monitor none 2>&1", pRadioHWInfo->szName);
-      hw_execute_bash_command(szComm, NULL);
+      hardware_radio_wifi_set_monitor_flags(pRadioHWInfo->szName, 0);
       hardware_sleep_ms(uDelayMS);
 
-      sprintf(szComm, "iw dev %s set monitor fcsfail 2>&1", pRadioHWInfo->szName);
-      hw_execute_bash_command(szComm, NULL);
+      hardware_radio_wifi_set_monitor_flags(pRadioHWInfo->szName, NL80211_MONITOR_FLAG_FCSFAIL);
       hardware_sleep_ms(uDelayMS);
       #endif
    }
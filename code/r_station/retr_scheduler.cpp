@@ -0,0 +1,412 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "../base/base.h"
+#include "../base/config.h"
+#include "retr_scheduler.h"
+
+static t_retr_sched_block* _retr_scheduler_get_block(t_retr_scheduler* pScheduler, u32 uBlockIndex)
+{
+   t_retr_sched_block* pBlock = &(pScheduler->blocks[uBlockIndex % RETR_SCHED_MAX_BLOCKS]);
+   if ( pBlock->uBlockIndex != uBlockIndex )
+      return NULL;
+   return pBlock;
+}
+
+static t_retr_sched_block* _retr_scheduler_add_block(t_retr_scheduler* pScheduler, u32 uBlockIndex, u32 uTimeNow)
+{
+   t_retr_sched_block* pBlock = &(pScheduler->blocks[uBlockIndex % RETR_SCHED_MAX_BLOCKS]);
+   memset(pBlock, 0, sizeof(t_retr_sched_block));
+   pBlock->uBlockIndex = uBlockIndex;
+   pBlock->uTimeFirstSeen = uTimeNow;
+   return pBlock;
+}
+
+static void _retr_scheduler_close_block(t_retr_sched_block* pBlock, u32 uTimeNow)
+{
+   if ( (NULL == pBlock) || pBlock->bClosed )
+      return;
+   pBlock->bClosed = true;
+   pBlock->uTimeClosed = uTimeNow;
+}
+
+// Returns how many packets are still needed to be able to reconstruct the block, or -1 if the block size is not known
+static int _retr_scheduler_get_block_deficit(t_retr_sched_block* pBlock)
+{
+   if ( 0 == pBlock->uDataPackets )
+      return -1;
+   if ( pBlock->uRecvPackets >= pBlock->uDataPackets )
+      return 0;
+   return (int)pBlock->uDataPackets - (int)pBlock->uRecvPackets;
+}
+
+static u32 _retr_scheduler_get_first_tracked_block(t_retr_scheduler* pScheduler)
+{
+   u32 uFirst = pScheduler->uOldestBlockIndex;
+   if ( pScheduler->uNewestBlockIndex >= RETR_SCHED_MAX_BLOCKS )
+   if ( uFirst < pScheduler->uNewestBlockIndex - (RETR_SCHED_MAX_BLOCKS-1) )
+      uFirst = pScheduler->uNewestBlockIndex - (RETR_SCHED_MAX_BLOCKS-1);
+   return uFirst;
+}
+
+static bool _retr_scheduler_is_block_due(t_retr_scheduler* pScheduler, t_retr_sched_block* pBlock, u32 uTimeNow, u32 uMaxAgeMs, u32 uCoalesceMs)
+{
+   if ( (NULL == pBlock) || (! pBlock->bClosed) )
+      return false;
+   if ( 0 == _retr_scheduler_get_block_deficit(pBlock) )
+      return false;
+   if ( uTimeNow >= pBlock->uTimeFirstSeen + uMaxAgeMs )
+      return false;
+   if ( 0 == pBlock->uTimeLastRequested )
+      return (uTimeNow >= pBlock->uTimeClosed + uCoalesceMs);
+   return (uTimeNow >= pBlock->uTimeLastRequested + retr_scheduler_get_retry_timeout_ms(pScheduler));
+}
+
+void retr_scheduler_init(t_retr_scheduler* pScheduler, u32 uInitialRetryTimeoutMs, u32 uMaxRetryTimeoutMs)
+{
+   if ( NULL == pScheduler )
+      return;
+   memset(pScheduler, 0, sizeof(t_retr_scheduler));
+   if ( uInitialRetryTimeoutMs < RETR_SCHED_MIN_RETRY_TIMEOUT_MS )
+      uInitialRetryTimeoutMs = RETR_SCHED_MIN_RETRY_TIMEOUT_MS;
+   if ( uMaxRetryTimeoutMs < uInitialRetryTimeoutMs )
+      uMaxRetryTimeoutMs = uInitialRetryTimeoutMs;
+   pScheduler->uInitialRetryTimeoutMs = uInitialRetryTimeoutMs;
+   pScheduler->uMaxRetryTimeoutMs = uMaxRetryTimeoutMs;
+   pScheduler->uMinRTTMs = MAX_U32;
+   for( int i=0; i<RETR_SCHED_MAX_PENDING_REQUESTS; i++ )
+      pScheduler->bPendingRequestsAnswered[i] = true;
+   retr_scheduler_reset(pScheduler);
+}
+
+void retr_scheduler_reset(t_retr_scheduler* pScheduler)
+{
+   if ( NULL == pScheduler )
+      return;
+   for( int i=0; i<RETR_SCHED_MAX_BLOCKS; i++ )
+   {
+      memset(&(pScheduler->blocks[i]), 0, sizeof(t_retr_sched_block));
+      pScheduler->blocks[i].uBlockIndex = MAX_U32;
+   }
+   pScheduler->bHasNewestBlock = false;
+   pScheduler->uNewestBlockIndex = 0;
+   pScheduler->uOldestBlockIndex = 0;
+
+   // Responses to requests sent before the reset are not matched anymore
+   for( int i=0; i<RETR_SCHED_MAX_PENDING_REQUESTS; i++ )
+      pScheduler->bPendingRequestsAnswered[i] = true;
+}
+
+void retr_scheduler_on_packet(t_retr_scheduler* pScheduler, u32 uBlockIndex, u32 uPacketIndex, int iDataPackets, int iECPackets, u32 uTimeNow)
+{
+   if ( (NULL == pScheduler) || (uPacketIndex >= MAX_TOTAL_PACKETS_IN_BLOCK) || (MAX_U32 == uBlockIndex) )
+      return;
+
+   if ( ! pScheduler->bHasNewestBlock )
+   {
+      pScheduler->bHasNewestBlock = true;
+      pScheduler->uNewestBlockIndex = uBlockIndex;
+      pScheduler->uOldestBlockIndex = uBlockIndex;
+      _retr_scheduler_add_block(pScheduler, uBlockIndex, uTimeNow);
+   }
+   else if ( uBlockIndex > pScheduler->uNewestBlockIndex )
+   {
+      // All the previous blocks were sent by now; the blocks in between were fully lost
+      _retr_scheduler_close_block(_retr_scheduler_get_block(pScheduler, pScheduler->uNewestBlockIndex), uTimeNow);
+      u32 uStart = pScheduler->uNewestBlockIndex + 1;
+      if ( uBlockIndex - uStart > RETR_SCHED_MAX_BLOCKS - 1 )
+         uStart = uBlockIndex - (RETR_SCHED_MAX_BLOCKS - 1);
+      for( u32 u=uStart; u<uBlockIndex; u++ )
+         _retr_scheduler_close_block(_retr_scheduler_add_block(pScheduler, u, uTimeNow), uTimeNow);
+      pScheduler->uNewestBlockIndex = uBlockIndex;
+      _retr_scheduler_add_block(pScheduler, uBlockIndex, uTimeNow);
+   }
+   else if ( (uBlockIndex < pScheduler->uOldestBlockIndex) || (uBlockIndex < _retr_scheduler_get_first_tracked_block(pScheduler)) )
+      return;
+
+   t_retr_sched_block* pBlock = _retr_scheduler_get_block(pScheduler, uBlockIndex);
+   if ( NULL == pBlock )
+   {
+      pBlock = _retr_scheduler_add_block(pScheduler, uBlockIndex, uTimeNow);
+      if ( uBlockIndex < pScheduler->uNewestBlockIndex )
+         _retr_scheduler_close_block(pBlock, uTimeNow);
+   }
+
+   if ( (0 == pBlock->uDataPackets) && (iDataPackets > 0) )
+   {
+      if ( iDataPackets > MAX_TOTAL_PACKETS_IN_BLOCK )
+         iDataPackets = MAX_TOTAL_PACKETS_IN_BLOCK;
+      if ( iECPackets < 0 )
+         iECPackets = 0;
+      if ( iDataPackets + iECPackets > MAX_TOTAL_PACKETS_IN_BLOCK )
+         iECPackets = MAX_TOTAL_PACKETS_IN_BLOCK - iDataPackets;
+      pBlock->uDataPackets = (u8)iDataPackets;
+      pBlock->uECPackets = (u8)iECPackets;
+   }
+
+   u32 uBit = ((u32)1) << uPacketIndex;
+   if ( ! (pBlock->uReceivedMask & uBit) )
+   {
+      pBlock->uReceivedMask |= uBit;
+      pBlock->uRecvPackets++;
+   }
+
+   // Last packet of the block: nothing else will come for it
+   if ( 0 != pBlock->uDataPackets )
+   if ( uPacketIndex + 1 >= (u32)pBlock->uDataPackets + (u32)pBlock->uECPackets )
+      _retr_scheduler_close_block(pBlock, uTimeNow);
+}
+
+void retr_scheduler_on_frame_end(t_retr_scheduler* pScheduler, u32 uTimeNow)
+{
+   if ( (NULL == pScheduler) || (! pScheduler->bHasNewestBlock) )
+      return;
+   _retr_scheduler_close_block(_retr_scheduler_get_block(pScheduler, pScheduler->uNewestBlockIndex), uTimeNow);
+}
+
+void retr_scheduler_discard_blocks_before(t_retr_scheduler* pScheduler, u32 uBlockIndex)
+{
+   if ( (NULL == pScheduler) || (! pScheduler->bHasNewestBlock) )
+      return;
+   if ( uBlockIndex <= pScheduler->uOldestBlockIndex )
+      return;
+
+   u32 uStart = _retr_scheduler_get_first_tracked_block(pScheduler);
+   for( u32 u=uStart; (u<uBlockIndex) && (u<=pScheduler->uNewestBlockIndex); u++ )
+   {
+      t_retr_sched_block* pBlock = _retr_scheduler_get_block(pScheduler, u);
+      if ( NULL != pBlock )
+         pBlock->uBlockIndex = MAX_U32;
+   }
+   pScheduler->uOldestBlockIndex = uBlockIndex;
+}
+
+void retr_scheduler_on_request_sent(t_retr_scheduler* pScheduler, u32 uRetrId, u32 uTimeNow)
+{
+   if ( NULL == pScheduler )
+      return;
+   int iIndex = pScheduler->iPendingRequestsIndex;
+   pScheduler->uPendingRequestsIds[iIndex] = uRetrId;
+   pScheduler->uPendingRequestsTimes[iIndex] = uTimeNow;
+   pScheduler->bPendingRequestsAnswered[iIndex] = false;
+   pScheduler->iPendingRequestsIndex = (iIndex + 1) % RETR_SCHED_MAX_PENDING_REQUESTS;
+}
+
+void retr_scheduler_on_retransmission_response(t_retr_scheduler* pScheduler, u32 uRetrId, u32 uTimeNow)
+{
+   if ( NULL == pScheduler )
+      return;
+
+   // Only the first packet of a response measures the round trip; the next ones also include their tx time
+   int iIndex = -1;
+   for( int i=0; i<RETR_SCHED_MAX_PENDING_REQUESTS; i++ )
+   {
+      if ( (! pScheduler->bPendingRequestsAnswered[i]) && (pScheduler->uPendingRequestsIds[i] == uRetrId) )
+      {
+         iIndex = i;
+         break;
+      }
+   }
+   if ( -1 == iIndex )
+      return;
+   pScheduler->bPendingRequestsAnswered[iIndex] = true;
+   if ( uTimeNow < pScheduler->uPendingRequestsTimes[iIndex] )
+      return;
+
+   u32 uRTT = uTimeNow - pScheduler->uPendingRequestsTimes[iIndex];
+   pScheduler->uLastRTTMs = uRTT;
+   if ( uRTT < pScheduler->uMinRTTMs )
+      pScheduler->uMinRTTMs = uRTT;
+
+   int iRTT8 = (int)uRTT * 8;
+   if ( 0 == pScheduler->uRTTSamples )
+   {
+      pScheduler->iSmoothedRTT8 = iRTT8;
+      pScheduler->iRTTVariance8 = iRTT8/2;
+   }
+   else
+   {
+      int iDelta = iRTT8 - pScheduler->iSmoothedRTT8;
+      pScheduler->iSmoothedRTT8 += iDelta/8;
+      if ( iDelta < 0 )
+         iDelta = -iDelta;
+      pScheduler->iRTTVariance8 += (iDelta - pScheduler->iRTTVariance8)/4;
+   }
+   pScheduler->uRTTSamples++;
+}
+
+u32 retr_scheduler_get_retry_timeout_ms(t_retr_scheduler* pScheduler)
+{
+   if ( NULL == pScheduler )
+      return RETR_SCHED_MIN_RETRY_TIMEOUT_MS;
+   u32 uTimeout = pScheduler->uInitialRetryTimeoutMs;
+   if ( 0 != pScheduler->uRTTSamples )
+      uTimeout = (u32)((pScheduler->iSmoothedRTT8 + 4*pScheduler->iRTTVariance8 + 7)/8);
+   if ( uTimeout < RETR_SCHED_MIN_RETRY_TIMEOUT_MS )
+      uTimeout = RETR_SCHED_MIN_RETRY_TIMEOUT_MS;
+   if ( uTimeout > pScheduler->uMaxRetryTimeoutMs )
+      uTimeout = pScheduler->uMaxRetryTimeoutMs;
+   return uTimeout;
+}
+
+u32 retr_scheduler_get_smoothed_rtt_ms(t_retr_scheduler* pScheduler)
+{
+   if ( (NULL == pScheduler) || (0 == pScheduler->uRTTSamples) )
+      return 0;
+   return (u32)((pScheduler->iSmoothedRTT8 + 4)/8);
+}
+
+void retr_scheduler_set_max_retry_timeout(t_retr_scheduler* pScheduler, u32 uMaxRetryTimeoutMs)
+{
+   if ( NULL == pScheduler )
+      return;
+   if ( uMaxRetryTimeoutMs < RETR_SCHED_MIN_RETRY_TIMEOUT_MS )
+      uMaxRetryTimeoutMs = RETR_SCHED_MIN_RETRY_TIMEOUT_MS;
+   pScheduler->uMaxRetryTimeoutMs = uMaxRetryTimeoutMs;
+}
+
+u32 retr_scheduler_get_due_deadline(t_retr_scheduler* pScheduler, u32 uTimeNow, u32 uMaxAgeMs, bool bForce)
+{
+   if ( (NULL == pScheduler) || (! pScheduler->bHasNewestBlock) )
+      return 0;
+
+   u32 uCoalesceMs = bForce?0:RETR_SCHED_COALESCE_MS;
+   u32 uDeadline = 0;
+   for( u32 u=_retr_scheduler_get_first_tracked_block(pScheduler); u<=pScheduler->uNewestBlockIndex; u++ )
+   {
+      t_retr_sched_block* pBlock = _retr_scheduler_get_block(pScheduler, u);
+      if ( ! _retr_scheduler_is_block_due(pScheduler, pBlock, uTimeNow, uMaxAgeMs, uCoalesceMs) )
+         continue;
+      if ( (0 == uDeadline) || (pBlock->uTimeFirstSeen + uMaxAgeMs < uDeadline) )
+         uDeadline = pBlock->uTimeFirstSeen + uMaxAgeMs;
+   }
+   return uDeadline;
+}
+
+int retr_scheduler_build_request(t_retr_scheduler* pScheduler, u32 uTimeNow, u32 uMaxAgeMs, bool bForce, u8* pOutput, int iMaxRanges, int iMaxPackets, int* piOutPacketsCount, bool* pbOutHasReRequested)
+{
+   if ( NULL != piOutPacketsCount )
+      *piOutPacketsCount = 0;
+   if ( NULL != pbOutHasReRequested )
+      *pbOutHasReRequested = false;
+   if ( (NULL == pScheduler) || (NULL == pOutput) || (! pScheduler->bHasNewestBlock) )
+      return 0;
+
+   int iCountRanges = 0;
+   int iCountPackets = 0;
+
+   for( u32 u=_retr_scheduler_get_first_tracked_block(pScheduler); u<=pScheduler->uNewestBlockIndex; u++ )
+   {
+      if ( (iCountRanges >= iMaxRanges) || (iCountPackets >= iMaxPackets) )
+         break;
+
+      // Once a block becomes due, the newer closed blocks go in the same request, without waiting for their coalescing time
+      t_retr_sched_block* pBlock = _retr_scheduler_get_block(pScheduler, u);
+      if ( ! _retr_scheduler_is_block_due(pScheduler, pBlock, uTimeNow, uMaxAgeMs, ((0 == iCountRanges) && (! bForce))?RETR_SCHED_COALESCE_MS:0) )
+         continue;
+
+      int iBlockPackets = 0;
+      int iDeficit = _retr_scheduler_get_block_deficit(pBlock);
+      if ( iDeficit < 0 )
+      {
+         u8* pRange = pOutput + iCountRanges * RETR_SCHED_RANGE_SIZE;
+         memcpy(pRange, &u, sizeof(u32));
+         pRange[sizeof(u32)] = 0xFF;
+         pRange[sizeof(u32)+1] = 1;
+         iCountRanges++;
+         iBlockPackets = 1;
+      }
+      else
+      {
+         // Request the first missing data packets, just enough to be able to reconstruct the block
+         int iRangeStart = -1;
+         for( int k=0; k<=(int)pBlock->uDataPackets; k++ )
+         {
+            bool bMissing = (k < (int)pBlock->uDataPackets) && (iDeficit > 0) && (iCountPackets + iBlockPackets < iMaxPackets) && (! (pBlock->uReceivedMask & (((u32)1) << k)));
+            if ( bMissing )
+            {
+               if ( -1 == iRangeStart )
+               {
+                  if ( iCountRanges >= iMaxRanges )
+                     break;
+                  iRangeStart = k;
+               }
+               iDeficit--;
+               iBlockPackets++;
+               continue;
+            }
+            if ( -1 == iRangeStart )
+               continue;
+            u8* pRange = pOutput + iCountRanges * RETR_SCHED_RANGE_SIZE;
+            memcpy(pRange, &u, sizeof(u32));
+            pRange[sizeof(u32)] = (u8)iRangeStart;
+            pRange[sizeof(u32)+1] = (u8)(k - iRangeStart);
+            iCountRanges++;
+            iRangeStart = -1;
+         }
+      }
+      if ( 0 == iBlockPackets )
+         continue;
+
+      if ( 0 != pBlock->uRequestCount )
+      {
+         if ( NULL != pbOutHasReRequested )
+            *pbOutHasReRequested = true;
+         pScheduler->uTotalReRequestedPackets += iBlockPackets;
+      }
+      pBlock->uTimeLastRequested = uTimeNow;
+      if ( pBlock->uRequestCount < 255 )
+         pBlock->uRequestCount++;
+      iCountPackets += iBlockPackets;
+   }
+
+   pScheduler->uTotalRequestedPackets += iCountPackets;
+   if ( NULL != piOutPacketsCount )
+      *piOutPacketsCount = iCountPackets;
+   return iCountRanges;
+}
+
+int retr_scheduler_get_missing_packets_count(t_retr_scheduler* pScheduler)
+{
+   if ( (NULL == pScheduler) || (! pScheduler->bHasNewestBlock) )
+      return 0;
+   int iCount = 0;
+   for( u32 u=_retr_scheduler_get_first_tracked_block(pScheduler); u<=pScheduler->uNewestBlockIndex; u++ )
+   {
+      t_retr_sched_block* pBlock = _retr_scheduler_get_block(pScheduler, u);
+      if ( (NULL == pBlock) || (! pBlock->bClosed) )
+         continue;
+      int iDeficit = _retr_scheduler_get_block_deficit(pBlock);
+      iCount += (iDeficit < 0)?1:iDeficit;
+   }
+   return iCount;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../radio/radiopackets2.h"
+
+// Video retransmissions scheduler (controller side).
+// Keeps the set of missing video packets updated as packets are received (instead of walking the
+// rx buffer on each check), estimates the link round trip time from the retransmitted packets
+// (each one carries the retransmission request id it answers) and decides, per video block,
+// when its missing packets must be requested:
+//  * a block is requested once it is closed: a later block was received, its last EC packet was
+//    received or the end of the video frame was detected; before that, the missing packets could
+//    still come in or be recovered from EC packets;
+//  * only as many data packets as needed to be able to reconstruct the block are requested;
+//  * a requested block is requested again only after the retry timeout (smoothed RTT + 4 * RTT variance);
+//  * a closed block waits RETR_SCHED_COALESCE_MS before its first request, for packets reordered between
+//    radio interfaces; all the blocks due at that time are coalesced into a single request, as packet ranges.
+
+#define RETR_SCHED_MAX_BLOCKS 128
+#define RETR_SCHED_MAX_PENDING_REQUESTS 16
+#define RETR_SCHED_MIN_RETRY_TIMEOUT_MS 5
+#define RETR_SCHED_COALESCE_MS 2
+
+// A range, as sent in the retransmission request: u32 block index, u8 first packet index, u8 packets count
+// First packet index 0xFF: request the full video block
+#define RETR_SCHED_RANGE_SIZE (sizeof(u32) + 2*sizeof(u8))
+
+typedef struct
+{
+   u32 uBlockIndex; // MAX_U32 if unused
+   u32 uReceivedMask; // one bit for each received block packet (data and EC)
+   u8 uDataPackets; // 0 if not known yet (no packet from this block was received)
+   u8 uECPackets;
+   u8 uRecvPackets;
+   u8 uRequestCount;
+   bool bClosed;
+   u32 uTimeFirstSeen;
+   u32 uTimeClosed;
+   u32 uTimeLastRequested;
+}
+t_retr_sched_block;
+
+typedef struct
+{
+   t_retr_sched_block blocks[RETR_SCHED_MAX_BLOCKS];
+   bool bHasNewestBlock;
+   u32 uNewestBlockIndex;
+   u32 uOldestBlockIndex; // blocks before this one are no longer tracked (outputed or discarded)
+
+   // Round trip time estimation (as in RFC 6298): smoothed RTT and RTT variance, in 1/8 ms
+   int iSmoothedRTT8;
+   int iRTTVariance8;
+   u32 uRTTSamples;
+   u32 uLastRTTMs;
+   u32 uMinRTTMs;
+   u32 uInitialRetryTimeoutMs;
+   u32 uMaxRetryTimeoutMs;
+
+   // Last requests sent, to match the responses to them
+   u32 uPendingRequestsIds[RETR_SCHED_MAX_PENDING_REQUESTS];
+   u32 uPendingRequestsTimes[RETR_SCHED_MAX_PENDING_REQUESTS];
+   bool bPendingRequestsAnswered[RETR_SCHED_MAX_PENDING_REQUESTS];
+   int iPendingRequestsIndex;
+
+   // Stats
+   u32 uTotalRequestedPackets;
+   u32 uTotalReRequestedPackets;
+}
+t_retr_scheduler;
+
+// uInitialRetryTimeoutMs is used until there are RTT samples, uMaxRetryTimeoutMs caps the computed retry timeout
+void retr_scheduler_init(t_retr_scheduler* pScheduler, u32 uInitialRetryTimeoutMs, u32 uMaxRetryTimeoutMs);
+// Clears the missing packets set, keeps the RTT estimation
+void retr_scheduler_reset(t_retr_scheduler* pScheduler);
+
+// Updates the missing set for a received video packet (original or retransmitted)
+void retr_scheduler_on_packet(t_retr_scheduler* pScheduler, u32 uBlockIndex, u32 uPacketIndex, int iDataPackets, int iECPackets, u32 uTimeNow);
+// End of the current video frame was detected: no more packets are expected for the newest block
+void retr_scheduler_on_frame_end(t_retr_scheduler* pScheduler, u32 uTimeNow);
+// Blocks before uBlockIndex were outputed or discarded by the rx buffer
+void retr_scheduler_discard_blocks_before(t_retr_scheduler* pScheduler, u32 uBlockIndex);
+
+void retr_scheduler_on_request_sent(t_retr_scheduler* pScheduler, u32 uRetrId, u32 uTimeNow);
+// Adds a RTT sample if this is the first packet received as response to that request id
+void retr_scheduler_on_retransmission_response(t_retr_scheduler* pScheduler, u32 uRetrId, u32 uTimeNow);
+u32  retr_scheduler_get_retry_timeout_ms(t_retr_scheduler* pScheduler);
+u32  retr_scheduler_get_smoothed_rtt_ms(t_retr_scheduler* pScheduler);
+
+void retr_scheduler_set_max_retry_timeout(t_retr_scheduler* pScheduler, u32 uMaxRetryTimeoutMs);
+
+// If there are blocks that must be requested now, returns the earliest time one of them gets past
+// the retransmission window (uMaxAgeMs since first seen), so that the caller can decide if it can
+// wait for a better moment to send the request (i.e. the end of the video frame). Returns 0 if nothing is due.
+// bForce: skip the coalescing delay (i.e. on end of frame)
+u32  retr_scheduler_get_due_deadline(t_retr_scheduler* pScheduler, u32 uTimeNow, u32 uMaxAgeMs, bool bForce);
+// Writes the ranges to request (RETR_SCHED_RANGE_SIZE bytes each) to pOutput and marks them as requested.
+// Blocks older than uMaxAgeMs (since first seen) are skipped, they are past the retransmission window.
+// Returns the number of ranges written; piOutPacketsCount gets the number of packets requested (full blocks count as 1)
+int  retr_scheduler_build_request(t_retr_scheduler* pScheduler, u32 uTimeNow, u32 uMaxAgeMs, bool bForce, u8* pOutput, int iMaxRanges, int iMaxPackets, int* piOutPacketsCount, bool* pbOutHasReRequested);
+// Returns the count of data packets missing from the closed blocks that are not recoverable from EC packets
+int  retr_scheduler_get_missing_packets_count(t_retr_scheduler* pScheduler);
@@ -48,6 +48,9 @@
 #include "../base/hardware_files.h"
 #include "../base/hardware_procs.h"
 #include "../base/ruby_ipc.h"
+#include "../base/reactor.h"
+#include "../base/rc_uplink.h"
+#include "../common/relay_utils.h"
 #include "../base/parse_fc_telemetry.h"
 #include "../base/utils.h"
 #include "../common/string_utils.h"
@@ -94,6 +97,12 @@ u8 s_BufferRCUplink[MAX_PACKET_TOTAL_SIZE];
 u8 s_PipeBufferRCUplink[MAX_PACKET_TOTAL_SIZE];
 int s_PipeBufferRCUplinkPos = 0;  
 
+// RC frames from ruby_tx_rc through the RC slot, sent right away on the high priority queue
+t_rc_uplink_slot_endpoint s_RCUplinkSlot;
+bool s_bRCUplinkSlotOpened = false;
+u8 s_BufferRCUplinkSlot[MAX_PACKET_TOTAL_SIZE];
+t_shared_mem_rc_latency* s_pSMRCLatency = NULL;
+
 t_packet_queue s_QueueRadioPacketsHighPrio;
 t_packet_queue s_QueueRadioPacketsRegPrio;
 t_packet_queue s_QueueControlPackets;
@@ -1329,6 +1338,9 @@ int open_pipes()
    g_fIPCToRC = ruby_open_ipc_channel_write_endpoint(IPC_CHANNEL_TYPE_ROUTER_TO_RC);
    if ( g_fIPCToRC < 0 )
       return -1;
+
+   s_bRCUplinkSlotOpened = (1 == rc_uplink_slot_open(&s_RCUplinkSlot, RC_UPLINK_SLOT_CONTROLLER, 1));
+   s_pSMRCLatency = shared_mem_rc_latency_open_for_write();
    
    g_fIPCFromCentral = ruby_open_ipc_channel_read_endpoint(IPC_CHANNEL_TYPE_CENTRAL_TO_ROUTER);
    if ( g_fIPCFromCentral < 0 )
@@ -1434,6 +1446,83 @@ void _check_send_packets(bool bDoTxSync)
    _process_and_send_packets_individually(&s_QueueRadioPacketsRegPrio);
 }
 
+// Sends the new RC frame from the RC slot, if any, right away (not delayed by the tx sync).
+// The RC process uses the slot only while the router marks itself alive in it, the IPC channel otherwise.
+// Called on every main loop, so the slot is also marked as not used on each loop it is not read.
+void _check_rc_uplink_slot()
+{
+   if ( ! s_bRCUplinkSlotOpened )
+      return;
+   if ( g_bQuit || g_bSearching || (NULL == g_pCurrentModel) || g_pCurrentModel->is_spectator )
+   {
+      rc_uplink_slot_mark_reader_gone(&s_RCUplinkSlot);
+      return;
+   }
+   rc_uplink_slot_mark_reader_alive(&s_RCUplinkSlot, g_TimeNow);
+
+   static u32 s_uTimeLastRCLatencyLog = 0;
+   if ( (NULL != s_pSMRCLatency) && (g_TimeNow > s_uTimeLastRCLatencyLog + 20000) )
+   {
+      s_uTimeLastRCLatencyLog = g_TimeNow;
+      rc_latency_histogram_log(&s_pSMRCLatency->inputToRadio, "RC input to radio tx");
+      if ( 0 != s_pSMRCLatency->uTimeLastVehicleLatencyUpdate )
+         log_line("[RCUplink] Vehicle RC input to FC latency (air time not included): median %u us, 95th percentile %u us",
+            s_pSMRCLatency->uVehicleInputToFCMedianMicros, s_pSMRCLatency->uVehicleInputToFCP95Micros);
+   }
+
+   u32 uTimeInputMicros = 0;
+   int iLength = rc_uplink_slot_read(&s_RCUplinkSlot, s_BufferRCUplinkSlot, &uTimeInputMicros);
+   if ( iLength < (int)sizeof(t_packet_header) )
+      return;
+   t_packet_header* pPH = (t_packet_header*)s_BufferRCUplinkSlot;
+   if ( (pPH->total_length != iLength) || (! isPairingDoneWithVehicle(pPH->vehicle_id_dest)) )
+      return;
+
+   t_packet_header_rc_full_frame_upstream* pPHRCF = NULL;
+   if ( pPH->packet_type == PACKET_TYPE_RC_FULL_FRAME )
+   if ( iLength >= (int)(sizeof(t_packet_header) + sizeof(t_packet_header_rc_full_frame_upstream)) )
+      pPHRCF = (t_packet_header_rc_full_frame_upstream*)(s_BufferRCUplinkSlot + sizeof(t_packet_header));
+
+   // Update the input age to now (the CRC is computed again on radio tx)
+   if ( (NULL != pPHRCF) && (pPHRCF->flags & RC_FULL_FRAME_FLAGS_HAS_INPUT_AGE) )
+      pPHRCF->extra_info1 = rc_latency_to_age_units(get_current_timestamp_micros() - uTimeInputMicros);
+
+   packets_queue_add_packet(&s_QueueRadioPacketsHighPrio, s_BufferRCUplinkSlot);
+   _process_and_send_packets_individually(&s_QueueRadioPacketsHighPrio);
+
+   if ( (NULL != pPHRCF) && (pPHRCF->flags & RC_FULL_FRAME_FLAGS_HAS_INPUT) && (NULL != s_pSMRCLatency) )
+   {
+      rc_latency_histogram_add(&s_pSMRCLatency->inputToRadio, get_current_timestamp_micros() - uTimeInputMicros);
+      s_pSMRCLatency->uTimeLastUpdate = g_TimeNow;
+   }
+}
+
+void update_radio_auth_encryption_requirement()
+{
+   if ( NULL == g_pCurrentModel )
+   {
+      radio_set_require_auth_encryption(0, 0);
+      return;
+   }
+   radio_set_require_auth_encryption((g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_AUTHENTICATED)?1:0, relay_get_relayed_vehicle_id(g_pCurrentModel));
+}
+
+// Publishes the vehicle side RC latency carried in the RC info packets
+void process_rc_info_from_vehicle(u8* pPacket, int iLength)
+{
+   if ( (NULL == s_pSMRCLatency) || (iLength < (int)(sizeof(t_packet_header) + sizeof(t_packet_header_rc_info_downstream))) )
+      return;
+   t_packet_header_rc_info_downstream* pPHRCInfo = (t_packet_header_rc_info_downstream*)(pPacket + sizeof(t_packet_header));
+   if ( ! (pPHRCInfo->extra_flags & RC_INFO_EXTRA_FLAGS_HAS_LATENCY) )
+      return;
+   s_pSMRCLatency->uVehicleInputToFCMedianMicros = (pPHRCInfo->extra_flags & 0xFF) * RC_FULL_FRAME_INPUT_AGE_UNIT_MICROS;
+   s_pSMRCLatency->uVehicleInputToFCP95Micros = ((pPHRCInfo->extra_flags >> 8) & 0xFF) * RC_FULL_FRAME_INPUT_AGE_UNIT_MICROS;
+   s_pSMRCLatency->uTimeLastVehicleLatencyUpdate = g_TimeNow;
+}
+
+void _main_loop_init_reactor();
+void _main_loop_uninit_reactor();
+u32 _main_loop_wait_for_work();
 void _main_loop_searching();
 void _main_loop_simple(bool bDoBasicTxSync);
 void _main_loop_adv_sync();
@@ -1462,6 +1551,7 @@ int main(int argc, char *argv[])
          
    log_init("Router");
    log_arguments(argc, argv);
+   log_enable_async();
    log_line_forced_to_file("Linux mem page size: %d bytes", getpagesize());
    
    hardware_detectBoardAndSystemType();
@@ -1562,6 +1652,7 @@ int main(int argc, char *argv[])
       g_pCurrentModel = getCurrentModel();
       if ( g_pCurrentModel->enc_flags != MODEL_ENC_FLAGS_NONE )
          lpp(NULL, 0);
+      update_radio_auth_encryption_requirement();
       g_pCurrentModel->logVehicleRadioInfo();
 
       g_uAcceptedFirmwareType = g_pCurrentModel->getVehicleFirmwareType();
@@ -1698,6 +1789,7 @@ int main(int argc, char *argv[])
 
    radio_duplicate_detection_init();
    radio_rx_start_rx_thread(&g_SM_RadioStats, (int)g_bSearching, g_uAcceptedFirmwareType);
+   _main_loop_init_reactor();
    
    log_line("Broadcasting that router is ready.");
    broadcast_router_ready();
@@ -1737,6 +1829,11 @@ int main(int argc, char *argv[])
 
    while ( !g_bQuit )
    {
+      // Sleep until there is work to do; the time waiting is not part of the loop duration
+      u32 uTimeWaitStart = get_current_timestamp_ms();
+      _main_loop_wait_for_work();
+      uLastLoopTime += get_current_timestamp_ms() - uTimeWaitStart;
+
       g_TimeNow = get_current_timestamp_ms();
       g_pProcessStats->lastActiveTime = g_TimeNow;
       g_pProcessStats->uLoopCounter++;
@@ -1762,6 +1859,8 @@ int main(int argc, char *argv[])
   
       uLastLoopTime = g_TimeNow;
 
+      _check_rc_uplink_slot();
+
       if ( g_bSearching )
       {
          static u32 s_uTimeLastSearchAliveLog = 0;
@@ -1794,6 +1893,7 @@ int main(int argc, char *argv[])
    log_line("Stopping...");
 
    packet_utils_uninit();
+   _main_loop_uninit_reactor();
    radio_rx_stop_rx_thread();
    radio_link_cleanup();
    unload_CorePlugins();
@@ -1825,6 +1925,11 @@ int main(int argc, char *argv[])
    ruby_close_ipc_channel(g_fIPCToTelemetry);
    ruby_close_ipc_channel(g_fIPCFromRC);
    ruby_close_ipc_channel(g_fIPCToRC);
+   if ( s_bRCUplinkSlotOpened )
+      rc_uplink_slot_close(&s_RCUplinkSlot);
+   s_bRCUplinkSlotOpened = false;
+   shared_mem_rc_latency_close(s_pSMRCLatency);
+   s_pSMRCLatency = NULL;
 
    if ( NULL != g_pCurrentModel )
    if ( g_pCurrentModel->relay_params.isRelayEnabledOnRadioLinkId >= 0 )
@@ -1886,6 +1991,67 @@ void video_processors_cleanup()
 
 static u32 uMaxLoopTime = DEFAULT_MAX_LOOP_TIME_MILISECONDS;
 
+// The main loop sleeps in the reactor until there are radio packets or IPC messages to process.
+// The reactor timer tick keeps the time based periodic work (video output, retransmissions, stats) going.
+#define ROUTER_REACTOR_TICK_MICROS 2000
+
+static t_reactor s_RouterReactor;
+static bool s_bRouterReactorInitialized = false;
+static bool s_bMainLoopWaitedForWork = false;
+
+void _main_loop_init_reactor()
+{
+   s_bRouterReactorInitialized = (1 == reactor_init(&s_RouterReactor, ROUTER_REACTOR_TICK_MICROS));
+   if ( ! s_bRouterReactorInitialized )
+   {
+      log_softerror_and_alarm("Failed to initialize main loop reactor. Will poll for work.");
+      return;
+   }
+   reactor_add_source(&s_RouterReactor, radio_rx_get_wait_event_fd(1), REACTOR_SOURCE_RADIO_RX);
+   reactor_add_source(&s_RouterReactor, radio_rx_get_wait_event_fd(0), REACTOR_SOURCE_RADIO_RX);
+   reactor_add_source(&s_RouterReactor, ruby_ipc_channel_get_wait_fd(g_fIPCFromCentral), REACTOR_SOURCE_IPC);
+   reactor_add_source(&s_RouterReactor, ruby_ipc_channel_get_wait_fd(g_fIPCFromTelemetry), REACTOR_SOURCE_IPC);
+   reactor_add_source(&s_RouterReactor, ruby_ipc_channel_get_wait_fd(g_fIPCFromRC), REACTOR_SOURCE_IPC);
+   if ( s_bRCUplinkSlotOpened )
+      reactor_add_source(&s_RouterReactor, rc_uplink_slot_get_wait_fd(&s_RCUplinkSlot), REACTOR_SOURCE_IPC);
+   log_line("Main loop reactor initialized, %d sources.", s_RouterReactor.iSourcesCount);
+}
+
+void _main_loop_uninit_reactor()
+{
+   if ( ! s_bRouterReactorInitialized )
+      return;
+   reactor_uninit(&s_RouterReactor);
+   s_bRouterReactorInitialized = false;
+}
+
+// Returns the ready sources (REACTOR_SOURCE_*), or 0 if the reactor is not used
+u32 _main_loop_wait_for_work()
+{
+   s_bMainLoopWaitedForWork = false;
+   if ( ! s_bRouterReactorInitialized )
+      return 0;
+
+   int iHasWork = radio_rx_begin_wait();
+   iHasWork |= ruby_ipc_channel_begin_wait(g_fIPCFromCentral);
+   iHasWork |= ruby_ipc_channel_begin_wait(g_fIPCFromTelemetry);
+   iHasWork |= ruby_ipc_channel_begin_wait(g_fIPCFromRC);
+   iHasWork |= rc_uplink_slot_begin_wait(&s_RCUplinkSlot);
+
+   u32 uReady = REACTOR_SOURCE_RADIO_RX | REACTOR_SOURCE_IPC;
+   if ( ! iHasWork )
+      uReady = reactor_wait(&s_RouterReactor);
+
+   radio_rx_end_wait();
+   ruby_ipc_channel_end_wait(g_fIPCFromCentral);
+   ruby_ipc_channel_end_wait(g_fIPCFromTelemetry);
+   ruby_ipc_channel_end_wait(g_fIPCFromRC);
+   rc_uplink_slot_end_wait(&s_RCUplinkSlot);
+   g_TimeNow = get_current_timestamp_ms();
+   s_bMainLoopWaitedForWork = true;
+   return uReady;
+}
+
 void _main_loop_try_recevive_data()
 {
    g_pProcessStats->uLoopCounter2 = g_pProcessStats->uLoopCounter3 = 0;
@@ -1898,6 +2064,13 @@ void _main_loop_try_recevive_data()
    u32 uReadTimeoutMicrosVideo = 200;
    u32 uReadTimeoutMicrosHigh = 200;
 
+   // Waited already for packets in the reactor, don't block again on each queue
+   if ( s_bMainLoopWaitedForWork )
+   {
+      uReadTimeoutMicrosVideo = 0;
+      uReadTimeoutMicrosHigh = 0;
+   }
+
    do
    {
       s_uTimeLastCheckForVideoPackets = g_TimeNow;
@@ -13,6 +13,9 @@ void reasign_radio_links(bool bSilent);
 void video_processors_init();
 void video_processors_cleanup();
 
+void process_rc_info_from_vehicle(u8* pPacket, int iLength);
+void update_radio_auth_encryption_requirement();
+
 void log_ipc_send_central_error(u8* pPacket, int iLength);
 u32  router_get_last_time_checked_for_video_packets();
 bool router_is_eof();
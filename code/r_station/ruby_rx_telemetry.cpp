@@ -199,8 +199,7 @@ void process_data_telemetry_raw_download(u8* pBuffer, int length)
          sendto(s_TelemetryUSBOutputInfo.socketUSBOutput, s_TelemetryUSBOutputInfo.usbBuffer, s_TelemetryUSBOutputInfo.usbBlockSize,
                0, (struct sockaddr *)&s_TelemetryUSBOutputInfo.sockAddrUSBDevice, sizeof(s_TelemetryUSBOutputInfo.sockAddrUSBDevice) );
          //log_line("Sent USB temeletry packet, size: %d", s_TelemetryUSBOutputInfo.usbBlockSize);
-         for( int i=0; i<(s_TelemetryUSBOutputInfo.usbBufferPos-s_TelemetryUSBOutputInfo.usbBlockSize); i++ )
-            s_TelemetryUSBOutputInfo.usbBuffer[i] = s_TelemetryUSBOutputInfo.usbBuffer[i+s_TelemetryUSBOutputInfo.usbBlockSize];
+         memmove(s_TelemetryUSBOutputInfo.usbBuffer, &(s_TelemetryUSBOutputInfo.usbBuffer[s_TelemetryUSBOutputInfo.usbBlockSize]), s_TelemetryUSBOutputInfo.usbBufferPos-s_TelemetryUSBOutputInfo.usbBlockSize);
          s_TelemetryUSBOutputInfo.usbBufferPos -= s_TelemetryUSBOutputInfo.usbBlockSize;
       }
    }
@@ -57,6 +57,8 @@
 #include "../base/ctrl_settings.h"
 #include "../utils/utils_controller.h"
 #include "../base/ruby_ipc.h"
+#include "../base/reactor.h"
+#include "../base/rc_uplink.h"
 #include "../common/string_utils.h"
 
 #include "timers.h"
@@ -68,6 +70,14 @@
 
 #define MAX_SERIAL_BUFFER_SIZE 512
 
+// The loop sleeps until there are joystick events or IPC messages, or until the next RC frame is due.
+// A change of at least RC_TX_SIGNIFICANT_CHANGE (on any channel) is sent right away, but not more often
+// than RC_TX_MIN_FRAME_INTERVAL_MICROS; the regular frames keep going at the model RC frame rate.
+// Inputs that can't be waited on (SDL joysticks, SBUS/IBUS input) are polled at RC_TX_MIN_FRAME_INTERVAL_MICROS.
+#define RC_TX_SIGNIFICANT_CHANGE 4
+#define RC_TX_MIN_FRAME_INTERVAL_MICROS 4000
+#define RC_TX_IDLE_TICK_MICROS 50000
+
 u32 g_iFPSFramesCount = 0;
 int g_iFPSMaxJoystickEvents = 0;
 int g_iFPSTotalJoystickEvents = 0;
@@ -87,16 +97,34 @@ t_shared_mem_i2c_controller_rc_in* s_pSM_RCIn = NULL;
 t_packet_header gPH;
 t_packet_header_rc_full_frame_upstream g_PHRCFUpstream;
 t_packet_header_rc_full_frame_upstream* s_pPHRCFUpstream = NULL;
-hw_joystick_info_t s_JoystickLocalInfo;
 hw_joystick_info_t* s_pJoystick = NULL;
 t_ControllerInputInterface* s_pCII = NULL;
+int s_iJoystickWaitFd = -1;
+// Kept as float: the relative move (camera) channels add small increments on each computation
+float s_fComputedRCValues[MAX_RC_CHANNELS];
 u16 s_ComputedRCValues[MAX_RC_CHANNELS];
+u16 s_LastSentRCValues[MAX_RC_CHANNELS];
+u8 s_uLastSentRCFlags = 0;
 
 u32 s_uLastTimeStampRCInFrame = 0;
 u8 s_uLastFrameIndexRCIn = 0;
+u32 s_uTimeLastRCCompute = 0;
+u32 s_uTimeInputReadMicros = 0;
+u32 s_uTimeInputChangedMicros = 0;
+bool s_bInputChangePending = false;
 u32 s_uTimeLastRCFrameSent = 0;
+u32 s_uTimeLastRCFrameSentMicros = 0;
 u32 s_uTimeBetweenRCFramesOutput = 100000;
 
+t_reactor s_RCReactor;
+t_rc_uplink_slot_endpoint s_RCUplinkSlot;
+bool s_bRCUplinkSlotOpened = false;
+
+u32 s_uCountFramesSentOnChange = 0;
+u32 s_uCountFramesSentOnSchedule = 0;
+u32 s_uCountFramesSentOnIPC = 0;
+u32 s_uTimeLastStatsLog = 0;
+
 void populate_rc_data( t_packet_header_rc_full_frame_upstream* pPHRCF )
 {
    pPHRCF->rc_frame_index++;
@@ -143,6 +171,8 @@ bool _check_open_joystick()
    {
       if ( 0 == hardware_open_joystick(s_pCII->currentHardwareIndex) )
          s_pJoystick = NULL;
+      else
+         s_iJoystickWaitFd = -2; // Register it again in the reactor, it could have the same fd as before
    }
 
    if ( (NULL != s_pJoystick) && (NULL != s_pCII) )
@@ -155,7 +185,8 @@ bool handle_joysticks()
    if ( ! _check_open_joystick() )
       return false;
    
-   int countEvents = hardware_read_joystick(s_pCII->currentHardwareIndex, 5);
+   // Just the events available now, the loop waits on the joystick fd
+   int countEvents = hardware_read_joystick(s_pCII->currentHardwareIndex, 0);
    if ( countEvents < 0 )
    {
       log_line("Hardware: failed to read joystick.");
@@ -167,11 +198,22 @@ bool handle_joysticks()
    g_iFPSTotalJoystickEvents += countEvents;
    if ( countEvents > g_iFPSMaxJoystickEvents )
       g_iFPSMaxJoystickEvents = countEvents;
-
-   memcpy(&s_JoystickLocalInfo, s_pJoystick, sizeof(hw_joystick_info_t));
    return true;
 }
 
+// The reactor is level triggered: the joystick fd must be removed from it whenever the loop
+// stops reading the joystick (idle, other input type), or the wait returns right away.
+void _update_joystick_wait_fd(bool bReadingJoystick)
+{
+   int iFd = -1;
+   if ( bReadingJoystick && (NULL != s_pCII) && (NULL != s_pJoystick) && hardware_is_joystick_opened(s_pCII->currentHardwareIndex) )
+      iFd = hardware_get_joystick_wait_fd(s_pCII->currentHardwareIndex);
+   if ( iFd == s_iJoystickWaitFd )
+      return;
+   reactor_set_source_of_type(&s_RCReactor, iFd, REACTOR_SOURCE_INPUT);
+   s_iJoystickWaitFd = iFd;
+   log_line("Joystick wait fd: %d", iFd);
+}
 
 void try_read_pipes()
 {
@@ -243,6 +285,167 @@ void _update_loop_info(u32 tTime0)
    }
 }
 
+// Reads the input (joystick or SBUS/IBUS) and computes the RC channels values.
+// Marks an input change pending if any channel moved significantly since the last sent frame.
+void _compute_rc_values()
+{
+   u32 miliSec = g_TimeNow - s_uTimeLastRCCompute;
+   s_uTimeLastRCCompute = g_TimeNow;
+   int iCountChannels = (int)(g_pCurrentModel->rc_params.channelsCount);
+   if ( iCountChannels > MAX_RC_CHANNELS )
+      iCountChannels = MAX_RC_CHANNELS;
+
+   if ( g_pCurrentModel->rc_params.inputType == RC_INPUT_TYPE_USB )
+   {
+      if ( handle_joysticks() )
+         g_PHRCFUpstream.flags |= RC_FULL_FRAME_FLAGS_HAS_INPUT;
+      else
+         g_PHRCFUpstream.flags &= (~RC_FULL_FRAME_FLAGS_HAS_INPUT);
+      _update_joystick_wait_fd(true);
+
+      for( int i=0; i<iCountChannels; i++ )
+         s_fComputedRCValues[i] = compute_controller_rc_value(g_pCurrentModel, i, s_fComputedRCValues[i], NULL, s_pJoystick, s_pCII, miliSec);
+   }
+   else
+      _update_joystick_wait_fd(false);
+
+   if ( g_pCurrentModel->rc_params.inputType == RC_INPUT_TYPE_RC_IN_SBUS_IBUS )
+   {
+      g_PHRCFUpstream.flags &= (~RC_FULL_FRAME_FLAGS_HAS_INPUT);
+
+      if ( NULL == s_pSM_RCIn )
+         s_pSM_RCIn = shared_mem_i2c_controller_rc_in_open_for_read();
+      if ( NULL != s_pSM_RCIn )
+      if ( s_pSM_RCIn->uFlags & RC_IN_FLAG_HAS_INPUT )
+      {
+         g_PHRCFUpstream.flags |= RC_FULL_FRAME_FLAGS_HAS_INPUT;
+         if ( (s_uLastTimeStampRCInFrame != s_pSM_RCIn->uTimeStamp) && (s_uLastFrameIndexRCIn != s_pSM_RCIn->uFrameIndex) )
+         {
+            s_uLastTimeStampRCInFrame = s_pSM_RCIn->uTimeStamp;
+            s_uLastFrameIndexRCIn = s_pSM_RCIn->uFrameIndex;
+            int nCh = iCountChannels;
+            if ( nCh > (int)(s_pSM_RCIn->uChannelsCount) )
+               nCh = (int)(s_pSM_RCIn->uChannelsCount);
+            for( int i=0; i<nCh; i++ )
+               s_fComputedRCValues[i] = compute_controller_rc_value(g_pCurrentModel, i, s_fComputedRCValues[i], NULL, NULL, NULL, miliSec);
+         }
+      }
+
+      if ( s_uLastTimeStampRCInFrame + g_pCurrentModel->rc_params.rc_failsafe_timeout_ms < g_TimeNow )
+         g_PHRCFUpstream.flags &= ~RC_FULL_FRAME_FLAGS_HAS_INPUT;
+   }
+
+   s_uTimeInputReadMicros = get_current_timestamp_micros();
+
+   bool bChanged = ((g_PHRCFUpstream.flags & RC_FULL_FRAME_FLAGS_HAS_INPUT) != (s_uLastSentRCFlags & RC_FULL_FRAME_FLAGS_HAS_INPUT));
+   for( int i=0; i<iCountChannels; i++ )
+   {
+      s_ComputedRCValues[i] = (u16) s_fComputedRCValues[i];
+      int iDelta = (int)s_ComputedRCValues[i] - (int)s_LastSentRCValues[i];
+      if ( (iDelta >= RC_TX_SIGNIFICANT_CHANGE) || (iDelta <= -RC_TX_SIGNIFICANT_CHANGE) )
+         bChanged = true;
+   }
+   if ( bChanged && (! s_bInputChangePending) )
+   {
+      s_bInputChangePending = true;
+      s_uTimeInputChangedMicros = s_uTimeInputReadMicros;
+   }
+}
+
+void _send_rc_frame(bool bOnInputChange)
+{
+   // The age of the oldest input change in this frame, or of the input read just now for the regular frames
+   u32 uTimeInputMicros = s_uTimeInputReadMicros;
+   if ( s_bInputChangePending )
+      uTimeInputMicros = s_uTimeInputChangedMicros;
+
+   populate_rc_data(&g_PHRCFUpstream);
+
+   u32 uTimeNowMicros = get_current_timestamp_micros();
+   g_PHRCFUpstream.flags &= ~RC_FULL_FRAME_FLAGS_HAS_INPUT_AGE;
+   g_PHRCFUpstream.extra_info1 = 0;
+   if ( g_PHRCFUpstream.flags & RC_FULL_FRAME_FLAGS_HAS_INPUT )
+   {
+      g_PHRCFUpstream.flags |= RC_FULL_FRAME_FLAGS_HAS_INPUT_AGE;
+      g_PHRCFUpstream.extra_info1 = rc_latency_to_age_units(uTimeNowMicros - uTimeInputMicros);
+   }
+
+   if ( NULL != s_pPHRCFUpstream )
+      memcpy(s_pPHRCFUpstream, &g_PHRCFUpstream, sizeof(t_packet_header_rc_full_frame_upstream) );
+
+   radio_packet_init(&gPH, PACKET_COMPONENT_RC, PACKET_TYPE_RC_FULL_FRAME, STREAM_ID_DATA);
+   gPH.vehicle_id_src = g_uControllerId;
+   gPH.vehicle_id_dest = g_pCurrentModel->uVehicleId;
+   gPH.total_length = sizeof(t_packet_header)+sizeof(t_packet_header_rc_full_frame_upstream);
+   
+   u8 buffer[MAX_PACKET_TOTAL_SIZE];
+   memcpy(buffer, &gPH, sizeof(t_packet_header));
+   memcpy(buffer+sizeof(t_packet_header), (u8*)&g_PHRCFUpstream, sizeof(t_packet_header_rc_full_frame_upstream));
+   radio_packet_compute_crc(buffer, gPH.total_length);
+
+   // Straight to the router radio tx if it reads the RC slot, through the IPC channel otherwise
+   if ( (! s_bRCUplinkSlotOpened) || (! rc_uplink_slot_write(&s_RCUplinkSlot, buffer, gPH.total_length, uTimeInputMicros)) )
+   {
+      ruby_ipc_channel_send_message(s_fIPCToRouter, buffer, gPH.total_length);
+      s_uCountFramesSentOnIPC++;
+   }
+   if ( bOnInputChange )
+      s_uCountFramesSentOnChange++;
+   else
+      s_uCountFramesSentOnSchedule++;
+
+   s_uTimeLastRCFrameSent = g_TimeNow;
+   s_uTimeLastRCFrameSentMicros = uTimeNowMicros;
+   s_bInputChangePending = false;
+   s_uLastSentRCFlags = g_PHRCFUpstream.flags;
+   memcpy(s_LastSentRCValues, s_ComputedRCValues, sizeof(s_LastSentRCValues));
+}
+
+// Sends a RC frame if one is due or if there is an input change to send. Returns the time until it has to run again.
+u32 _process_rc()
+{
+   _compute_rc_values();
+
+   u32 uTimeNowMicros = get_current_timestamp_micros();
+   u32 uTimeSinceLastFrameMicros = uTimeNowMicros - s_uTimeLastRCFrameSentMicros;
+   if ( g_TimeNow >= s_uTimeLastRCFrameSent + s_uTimeBetweenRCFramesOutput )
+      _send_rc_frame(false);
+   else if ( s_bInputChangePending && (uTimeSinceLastFrameMicros >= RC_TX_MIN_FRAME_INTERVAL_MICROS) )
+      _send_rc_frame(true);
+
+   u32 uNextMicros = RC_TX_IDLE_TICK_MICROS;
+   if ( s_uTimeLastRCFrameSent + s_uTimeBetweenRCFramesOutput > g_TimeNow )
+      uNextMicros = (s_uTimeLastRCFrameSent + s_uTimeBetweenRCFramesOutput - g_TimeNow)*1000;
+   else
+      uNextMicros = 1000;
+
+   if ( s_bInputChangePending )
+   {
+      uTimeSinceLastFrameMicros = get_current_timestamp_micros() - s_uTimeLastRCFrameSentMicros;
+      u32 uMicros = 100;
+      if ( uTimeSinceLastFrameMicros < RC_TX_MIN_FRAME_INTERVAL_MICROS )
+         uMicros = RC_TX_MIN_FRAME_INTERVAL_MICROS - uTimeSinceLastFrameMicros;
+      if ( uMicros < uNextMicros )
+         uNextMicros = uMicros;
+   }
+   if ( s_iJoystickWaitFd < 0 )
+   if ( uNextMicros > RC_TX_MIN_FRAME_INTERVAL_MICROS )
+      uNextMicros = RC_TX_MIN_FRAME_INTERVAL_MICROS;
+   if ( uNextMicros > RC_TX_IDLE_TICK_MICROS )
+      uNextMicros = RC_TX_IDLE_TICK_MICROS;
+   return uNextMicros;
+}
+
+u32 _wait_for_work()
+{
+   int iHasWork = ruby_ipc_channel_begin_wait(s_fIPCFromRouter);
+   u32 uReady = REACTOR_SOURCE_IPC;
+   if ( ! iHasWork )
+      uReady = reactor_wait(&s_RCReactor);
+   ruby_ipc_channel_end_wait(s_fIPCFromRouter);
+   return uReady;
+}
+
 void handle_sigint(int sig) 
 { 
    log_line("--------------------------");
@@ -300,6 +503,8 @@ int main(int argc, char *argv[])
    if ( s_fIPCFromRouter < 0 )
       return -1;
 
+   s_bRCUplinkSlotOpened = (1 == rc_uplink_slot_open(&s_RCUplinkSlot, RC_UPLINK_SLOT_CONTROLLER, 0));
+
    s_pProcessStats = shared_mem_process_stats_open_write(SHARED_MEM_WATCHDOG_RC_TX);
    if ( NULL == s_pProcessStats )
       log_softerror_and_alarm("Failed to open shared mem for RC tx process watchdog stats for writing: %s", SHARED_MEM_WATCHDOG_TELEMETRY_RX);
@@ -339,7 +544,9 @@ int main(int argc, char *argv[])
    g_PHRCFUpstream.flags = 0;
    for( int i=0; i<MAX_RC_CHANNELS; i++ )
    {
+      s_fComputedRCValues[i] = 0.0;
       s_ComputedRCValues[i] = 0;
+      s_LastSentRCValues[i] = 0;
       packet_header_rc_full_set_rc_channel_value(&g_PHRCFUpstream, i, 1000);
    }
 
@@ -347,16 +554,16 @@ int main(int argc, char *argv[])
       memcpy(s_pPHRCFUpstream, &g_PHRCFUpstream, sizeof(t_packet_header_rc_full_frame_upstream) );
 
    g_TimeStart = get_current_timestamp_ms(); 
+   s_uTimeLastRCCompute = g_TimeStart;
 
-   int iSleepTime = 50;
-   #ifdef FEATURE_ENABLE_RC
-   iSleepTime = 10;
-   #endif
+   if ( 1 != reactor_init(&s_RCReactor, RC_TX_IDLE_TICK_MICROS) )
+      log_softerror_and_alarm("Failed to initialize the main loop reactor. Will poll for work.");
+   reactor_add_source(&s_RCReactor, ruby_ipc_channel_get_wait_fd(s_fIPCFromRouter), REACTOR_SOURCE_IPC);
 
    while ( !g_bQuit )
    { 
       g_iFPSFramesCount++;
-      hardware_sleep_ms(iSleepTime);
+      _wait_for_work();
 
       g_uLoopCounter++;
       g_TimeNow = get_current_timestamp_ms();
@@ -376,98 +583,38 @@ int main(int argc, char *argv[])
          g_iFPSTotalJoystickEvents = 0;
       }
 
-      if ( (g_pCurrentModel->rc_params.rc_enabled && (!g_pCurrentModel->is_spectator)) || ((g_iFPSFramesCount % 3) == 0) )
-         try_read_pipes();
-
-      if ( g_bSearching || g_bUpdateInProgress )
+      if ( g_TimeNow > s_uTimeLastStatsLog + 20000 )
       {
-         _update_loop_info(tTime0);
-         continue;
+         s_uTimeLastStatsLog = g_TimeNow;
+         if ( 0 != s_uCountFramesSentOnChange + s_uCountFramesSentOnSchedule )
+            log_line("RC frames sent in the last 20 sec: %u on input change, %u on schedule, %u of them through IPC. Reactor wakeups: %u",
+               s_uCountFramesSentOnChange, s_uCountFramesSentOnSchedule, s_uCountFramesSentOnIPC, s_RCReactor.uStatsWakeups);
+         s_uCountFramesSentOnChange = 0;
+         s_uCountFramesSentOnSchedule = 0;
+         s_uCountFramesSentOnIPC = 0;
       }
-      if ( NULL == g_pCurrentModel )
+
+      try_read_pipes();
+
+      if ( g_bSearching || g_bUpdateInProgress || (NULL == g_pCurrentModel) )
       {
+         _update_joystick_wait_fd(false);
+         reactor_set_timer_interval(&s_RCReactor, RC_TX_IDLE_TICK_MICROS);
          _update_loop_info(tTime0);
          continue;
       }
       if ( (! g_pCurrentModel->rc_params.rc_enabled) || g_pCurrentModel->is_spectator )
       {
+         _update_joystick_wait_fd(false);
+         reactor_set_timer_interval(&s_RCReactor, RC_TX_IDLE_TICK_MICROS);
          _update_loop_info(tTime0);
          continue;
       }
    
       #ifdef FEATURE_ENABLE_RC
-
-      if ( g_TimeNow < s_uTimeLastRCFrameSent + s_uTimeBetweenRCFramesOutput )
-      {
-         _update_loop_info(tTime0);
-
-         u32 uDelta = s_uTimeLastRCFrameSent + s_uTimeBetweenRCFramesOutput - g_TimeNow;
-         if ( uDelta > 40 )
-            uDelta = 40;
-         hardware_sleep_ms(uDelta/2);
-         continue;
-      }
-
-      u32 miliSec = g_TimeNow - s_uTimeLastRCFrameSent;
-
-      if ( g_pCurrentModel->rc_params.inputType == RC_INPUT_TYPE_USB )
-      {
-         if ( handle_joysticks() )
-            g_PHRCFUpstream.flags |= RC_FULL_FRAME_FLAGS_HAS_INPUT;
-         else
-            g_PHRCFUpstream.flags &= (~RC_FULL_FRAME_FLAGS_HAS_INPUT);
-
-         for( int i=0; i<(int)(g_pCurrentModel->rc_params.channelsCount); i++ )
-            s_ComputedRCValues[i] = (u16) compute_controller_rc_value(g_pCurrentModel, i, (float)(s_ComputedRCValues[i]), NULL, &s_JoystickLocalInfo, s_pCII, miliSec);
-      }
-
-      if ( g_pCurrentModel->rc_params.inputType == RC_INPUT_TYPE_RC_IN_SBUS_IBUS )
-      {
-         g_PHRCFUpstream.flags &= (~RC_FULL_FRAME_FLAGS_HAS_INPUT);
-
-         if ( NULL == s_pSM_RCIn )
-            s_pSM_RCIn = shared_mem_i2c_controller_rc_in_open_for_read();
-         if ( NULL != s_pSM_RCIn )
-         if ( s_pSM_RCIn->uFlags & RC_IN_FLAG_HAS_INPUT )
-         {
-            g_PHRCFUpstream.flags |= RC_FULL_FRAME_FLAGS_HAS_INPUT;
-            if ( (s_uLastTimeStampRCInFrame != s_pSM_RCIn->uTimeStamp) && (s_uLastFrameIndexRCIn != s_pSM_RCIn->uFrameIndex) )
-            {
-               s_uLastTimeStampRCInFrame = s_pSM_RCIn->uTimeStamp;
-               s_uLastFrameIndexRCIn = s_pSM_RCIn->uFrameIndex;
-               int nCh = g_pCurrentModel->rc_params.channelsCount;
-               if ( nCh > (int)(s_pSM_RCIn->uChannelsCount) )
-                  nCh = (int)(s_pSM_RCIn->uChannelsCount);
-               for( int i=0; i<nCh; i++ )
-               {
-                  //s_ComputedRCValues[i] = s_pSM_RCIn->uChannels[i];
-                  s_ComputedRCValues[i] = compute_controller_rc_value(g_pCurrentModel, i, (float)(s_ComputedRCValues[i]), NULL, NULL, NULL, miliSec);
-               }
-               //log_line("%d %d %d", s_pSM_RCIn->uChannels[0], s_pSM_RCIn->uChannels[1], s_pSM_RCIn->uChannels[2] );
-            }
-         }
-
-         if ( s_uLastTimeStampRCInFrame + g_pCurrentModel->rc_params.rc_failsafe_timeout_ms < g_TimeNow )
-            g_PHRCFUpstream.flags &= ~RC_FULL_FRAME_FLAGS_HAS_INPUT;
-      }
-
-      s_uTimeLastRCFrameSent = g_TimeNow;
-
-      populate_rc_data(&g_PHRCFUpstream);
-
-      if ( NULL != s_pPHRCFUpstream )
-         memcpy(s_pPHRCFUpstream, &g_PHRCFUpstream, sizeof(t_packet_header_rc_full_frame_upstream) );
-
-      radio_packet_init(&gPH, PACKET_COMPONENT_RC, PACKET_TYPE_RC_FULL_FRAME, STREAM_ID_DATA);
-      gPH.vehicle_id_src = g_uControllerId;
-      gPH.vehicle_id_dest = g_pCurrentModel->uVehicleId;
-      gPH.total_length = sizeof(t_packet_header)+sizeof(t_packet_header_rc_full_frame_upstream);
-      
-      u8 buffer[MAX_PACKET_TOTAL_SIZE];
-      memcpy(buffer, &gPH, sizeof(t_packet_header));
-      memcpy(buffer+sizeof(t_packet_header), (u8*)&g_PHRCFUpstream, sizeof(t_packet_header_rc_full_frame_upstream));
-      radio_packet_compute_crc(buffer, gPH.total_length);
-      ruby_ipc_channel_send_message(s_fIPCToRouter, buffer, gPH.total_length);
+      reactor_set_timer_interval(&s_RCReactor, _process_rc());
+      #else
+      reactor_set_timer_interval(&s_RCReactor, RC_TX_IDLE_TICK_MICROS);
       #endif
 
       _update_loop_info(tTime0);
@@ -476,6 +623,11 @@ int main(int argc, char *argv[])
    if ( NULL != s_pCII )
       hardware_close_joystick(s_pCII->currentHardwareIndex);
 
+   reactor_uninit(&s_RCReactor);
+   if ( s_bRCUplinkSlotOpened )
+      rc_uplink_slot_close(&s_RCUplinkSlot);
+   s_bRCUplinkSlotOpened = false;
+
    ruby_close_ipc_channel(s_fIPCFromRouter);
    ruby_close_ipc_channel(s_fIPCToRouter);
    s_fIPCFromRouter = -1;
@@ -43,6 +43,7 @@
 #include <netdb.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <arpa/inet.h>
 
 #include "../radio/fec.h" 
@@ -51,6 +52,7 @@
 #include "../base/config.h"
 #include "../base/ctrl_settings.h"
 #include "../base/shared_mem.h"
+#include "../base/shared_mem_video_frames.h"
 #include "../base/models.h"
 #include "../base/models_list.h"
 #include "../base/radio_utils.h"
@@ -66,6 +68,7 @@
 #include "shared_vars.h"
 #include "rx_video_output.h"
 #include "rx_video_recording.h"
+#include "rx_video_rtp.h"
 #include "packets_utils.h"
 #include "timers.h"
 #include "ruby_rt_station.h"
@@ -89,8 +92,7 @@ int s_iPipeVideoOutputPos = 0;
 
 shared_mem_process_stats* s_pSMProcessStatsMPPPlayer = NULL;
 sem_t* s_pSemaphoreSMData = NULL;
-u8* s_pSMVideoStreamerWrite = NULL;
-u32 s_uSMVideoStreamWritePosition = 0;
+shared_mem_video_frames* s_pSMVideoFramesWrite = NULL;
 bool s_bEnableVideoStreamerOutput = false;
 bool s_bDidSentAnyDataToVideoStreamerSM = false;
 bool s_bDidSentAnyDataToVideoStreamerPipe = false;
@@ -111,8 +113,6 @@ typedef struct
    struct sockaddr_in sockAddrUSBDevice;
    int socketUSBOutput;
    int usbBlockSize;
-   u8 usbBuffer[2050];
-   int usbBufferPos;
 } t_video_usb_output_info;
 
 t_video_usb_output_info s_VideoUSBOutputInfo;
@@ -126,9 +126,15 @@ typedef struct
    int s_ForwardETHSocketVideo;
 
    struct sockaddr_in s_ForwardETHSockAddr;
-   u8 s_BufferETH[2050];
-   int s_nBufferETHPos;
    int s_BufferETHPacketSize;
+
+   // RTP output: uses the same socket, one or more RTP packets per NAL
+   bool s_bForwardETHRTPEnabled;
+   bool s_bForwardETHRTCPEnabled;
+   t_rtp_packetizer s_RTPPacketizer;
+   struct sockaddr_in s_ForwardETHRTCPSockAddr;
+   u32 s_uTimeFirstPendingRTPPacket;
+   u32 s_uTimeLastRTCPSenderReport;
 } t_video_eth_forward_info;
 
 t_video_eth_forward_info s_VideoETHOutputInfo;
@@ -143,6 +149,36 @@ u32 s_uLastVideoFrameTime = MAX_U32;
 int s_iLocalVideoPlayerUDPSocket = -1;
 struct sockaddr_in s_LocalVideoPlayuerUDPSocketAddr;
 
+// UDP video outputs (local player, ETH, USB): the video data of a frame is staged once
+// and sent to all the UDP destinations at the end of the frame, using sendmmsg and UDP GSO.
+// With only the local player output, the video data is sent as it comes, with no staging copy.
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#define VIDEO_EGRESS_BUFFER_SIZE (256*1024)
+#define VIDEO_EGRESS_MAX_MESSAGES 64
+#define VIDEO_EGRESS_GSO_MAX_BYTES 63000
+#define VIDEO_EGRESS_GSO_MAX_SEGMENTS 64
+#define VIDEO_EGRESS_MAX_DELAY_MS 20
+#define VIDEO_EGRESS_LOCAL_PLAYER_PACKET_SIZE 2048
+
+#define VIDEO_EGRESS_DEST_LOCAL_PLAYER 0
+#define VIDEO_EGRESS_DEST_ETH 1
+#define VIDEO_EGRESS_DEST_USB 2
+#define VIDEO_EGRESS_DESTINATIONS 3
+
+typedef struct
+{
+   u8* pBuffer;
+   int iBufferPos;
+   u32 uTimeFirstData;
+   bool bUseGSO[VIDEO_EGRESS_DESTINATIONS];
+} t_video_udp_egress;
+
+t_video_udp_egress s_VideoUDPEgress;
+
 u32 s_uTimeStartLocalVideoPlayer = 0;
 u32 s_uTimeLastOutputDataToLocalVideoPlayer = 0;
 u32 s_uLastTimeComputedOutputBitrate = 0;
@@ -407,16 +443,9 @@ static void * _thread_rx_video_output_streamer_watchdog(void *argument)
       rx_video_output_stop_video_streamer();
       if ( s_bRxVideoOutputUseSM )
       {
-         s_uSMVideoStreamWritePosition = 2*sizeof(u32);
-         if ( NULL != s_pSMVideoStreamerWrite )
-         {
-            u32* pTmp1 = (u32*)(&(s_pSMVideoStreamerWrite[0]));
-            u32* pTmp2 = (u32*)(&(s_pSMVideoStreamerWrite[sizeof(u32)]));
-            *pTmp1 = s_uSMVideoStreamWritePosition;
-            *pTmp2 = s_uSMVideoStreamWritePosition;
-         }
+         shared_mem_video_frames_discard_frame(s_pSMVideoFramesWrite);
          s_bDidSentAnyDataToVideoStreamerSM = false;
-         log_line("[VideoOutputThread] Reseted SM video output position.");
+         log_line("[VideoOutputThread] Reseted SM video output frame.");
       }
 
       if ( ! s_bRxVideoOutputStreamerThreadMustStop )
@@ -500,7 +529,6 @@ void _processor_rx_video_forward_create_eth_socket()
    s_VideoETHOutputInfo.s_ForwardETHSockAddr.sin_addr.s_addr = htonl(INADDR_BROADCAST);
    //s_ForwardETHSockAddr.sin_addr.s_addr = inet_addr("192.168.1.255");
 
-   s_VideoETHOutputInfo.s_nBufferETHPos = 0;
    s_VideoETHOutputInfo.s_BufferETHPacketSize = g_pControllerSettings->nVideoForwardETHPacketSize;
    if ( s_VideoETHOutputInfo.s_BufferETHPacketSize < 100 || s_VideoETHOutputInfo.s_BufferETHPacketSize > 2048 )
       s_VideoETHOutputInfo.s_BufferETHPacketSize = 2048;
@@ -509,6 +537,132 @@ void _processor_rx_video_forward_create_eth_socket()
    s_VideoETHOutputInfo.s_bForwardIsETHForwardEnabled = true;
 }
 
+// Sends all the messages, resuming after partial sends and interrupted calls.
+// Returns the number of messages sent; on error it is less than iCount and errno is set.
+
+int _rx_video_output_sendmmsg(int iSocket, struct mmsghdr* pMsgs, int iCount)
+{
+   int iSent = 0;
+   while ( iSent < iCount )
+   {
+      int iRes = sendmmsg(iSocket, &pMsgs[iSent], iCount - iSent, 0);
+      if ( iRes > 0 )
+      {
+         iSent += iRes;
+         continue;
+      }
+      if ( (iRes < 0) && (errno == EINTR) )
+         continue;
+      break;
+   }
+   return iSent;
+}
+
+// Sends all the RTP packets built so far, in one sendmmsg call (one message per RTP packet)
+
+void _rx_video_output_rtp_send_packets(t_rtp_packetizer* pPacketizer)
+{
+   struct mmsghdr msgs[RTP_MAX_OUT_PACKETS];
+   struct iovec iovs[RTP_MAX_OUT_PACKETS];
+
+   int iCount = pPacketizer->iOutPacketsCount;
+   if ( (0 == iCount) || (-1 == s_VideoETHOutputInfo.s_ForwardETHSocketVideo) )
+   {
+      rx_video_rtp_clear_packets(pPacketizer);
+      return;
+   }
+
+   u8* pPacket = pPacketizer->pOutBuffer;
+   for( int i=0; i<iCount; i++ )
+   {
+      iovs[i].iov_base = pPacket;
+      iovs[i].iov_len = pPacketizer->iOutPacketsLengths[i];
+      memset(&msgs[i], 0, sizeof(struct mmsghdr));
+      msgs[i].msg_hdr.msg_name = &s_VideoETHOutputInfo.s_ForwardETHSockAddr;
+      msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      pPacket += pPacketizer->iOutPacketsLengths[i];
+   }
+
+   int iSent = _rx_video_output_sendmmsg(s_VideoETHOutputInfo.s_ForwardETHSocketVideo, msgs, iCount);
+   if ( iSent < iCount )
+   {
+      log_line("[VideoOutput] Failed to send %d RTP packets to ETH, [fd=%d], error: %d (%s)", iCount - iSent, s_VideoETHOutputInfo.s_ForwardETHSocketVideo, errno, strerror(errno));
+      close(s_VideoETHOutputInfo.s_ForwardETHSocketVideo);
+      s_VideoETHOutputInfo.s_ForwardETHSocketVideo = -1;
+   }
+   rx_video_rtp_clear_packets(pPacketizer);
+}
+
+void _rx_video_output_rtp_send_sender_report()
+{
+   if ( -1 == s_VideoETHOutputInfo.s_ForwardETHSocketVideo )
+      return;
+   u8 uPacket[RTCP_SR_PACKET_SIZE];
+   int iLength = rx_video_rtp_build_sender_report(&s_VideoETHOutputInfo.s_RTPPacketizer, uPacket, g_TimeNow);
+   if ( iLength > 0 )
+      sendto(s_VideoETHOutputInfo.s_ForwardETHSocketVideo, uPacket, iLength, 0, (struct sockaddr *)&s_VideoETHOutputInfo.s_ForwardETHRTCPSockAddr, sizeof(struct sockaddr_in));
+   s_VideoETHOutputInfo.s_uTimeLastRTCPSenderReport = g_TimeNow;
+}
+
+void _rx_video_output_rtp_disable()
+{
+   if ( s_VideoETHOutputInfo.s_bForwardETHRTPEnabled )
+      rx_video_rtp_uninit(&s_VideoETHOutputInfo.s_RTPPacketizer);
+   s_VideoETHOutputInfo.s_bForwardETHRTPEnabled = false;
+   s_VideoETHOutputInfo.s_bForwardETHRTCPEnabled = false;
+}
+
+// RTP video goes to the configured ETH port, RTCP sender reports (if enabled) to the next port, as in RFC 3550
+
+void _rx_video_output_rtp_enable(bool bSendRTCP)
+{
+   _rx_video_output_rtp_disable();
+   _processor_rx_video_forward_create_eth_socket();
+   // Raw forward uses the same socket; it stays disabled
+   s_VideoETHOutputInfo.s_bForwardIsETHForwardEnabled = false;
+   if ( -1 == s_VideoETHOutputInfo.s_ForwardETHSocketVideo )
+      return;
+
+   u8 uVideoStreamType = (s_uCurrentReceivedVideoStreamType != 0)?s_uCurrentReceivedVideoStreamType:VIDEO_TYPE_H264;
+   if ( ! rx_video_rtp_init(&s_VideoETHOutputInfo.s_RTPPacketizer, uVideoStreamType, s_VideoETHOutputInfo.s_BufferETHPacketSize, _rx_video_output_rtp_send_packets) )
+      return;
+
+   memcpy(&s_VideoETHOutputInfo.s_ForwardETHRTCPSockAddr, &s_VideoETHOutputInfo.s_ForwardETHSockAddr, sizeof(struct sockaddr_in));
+   s_VideoETHOutputInfo.s_ForwardETHRTCPSockAddr.sin_port = (in_port_t)htons(g_pControllerSettings->nVideoForwardETHPort + 1);
+   s_VideoETHOutputInfo.s_uTimeFirstPendingRTPPacket = 0;
+   s_VideoETHOutputInfo.s_uTimeLastRTCPSenderReport = 0;
+   s_VideoETHOutputInfo.s_bForwardETHRTPEnabled = true;
+   s_VideoETHOutputInfo.s_bForwardETHRTCPEnabled = bSendRTCP;
+   log_line("[VideoOutput] Video ETH forwarding as RTP on port %d%s.", g_pControllerSettings->nVideoForwardETHPort, bSendRTCP?", with RTCP sender reports on the next port":"");
+}
+
+void _rx_video_output_to_rtp(t_packet_header_video_segment* pPHVS, u8* pBuffer, int iLength)
+{
+   t_rtp_packetizer* pPacketizer = &s_VideoETHOutputInfo.s_RTPPacketizer;
+   u8 uVideoStreamType = (pPHVS->uVideoStreamIndexAndType >> 4) & 0x0F;
+   if ( uVideoStreamType != pPacketizer->uVideoStreamType )
+   {
+      log_line("[VideoOutput] RTP output: video codec changed to %s.", (uVideoStreamType == VIDEO_TYPE_H265)?"H265":"H264");
+      rx_video_rtp_reset_stream(pPacketizer, uVideoStreamType);
+   }
+
+   int iFPS = (NULL != g_pCurrentModel)?g_pCurrentModel->video_params.iVideoFPS:0;
+   rx_video_rtp_set_frame_info(pPacketizer, pPHVS->uH264FrameIndex, pPHVS->uRuntimeMetrics & 0xFF, iFPS, g_TimeNow);
+
+   bool bIsEndOfFrame = (pPHVS->uVideoStatusFlags2 & VIDEO_STATUS_FLAGS2_IS_END_OF_FRAME)?true:false;
+   rx_video_rtp_add_data(pPacketizer, pBuffer, iLength, bIsEndOfFrame);
+
+   if ( bIsEndOfFrame )
+   {
+      _rx_video_output_rtp_send_packets(pPacketizer);
+      s_VideoETHOutputInfo.s_uTimeFirstPendingRTPPacket = 0;
+   }
+   else if ( (pPacketizer->iOutPacketsCount > 0) && (0 == s_VideoETHOutputInfo.s_uTimeFirstPendingRTPPacket) )
+      s_VideoETHOutputInfo.s_uTimeFirstPendingRTPPacket = g_TimeNow;
+}
+
 
 void _rx_video_output_open_pipe_to_streamer()
 {
@@ -598,44 +752,15 @@ void rx_video_output_init()
    s_ParserH264StreamOutput.init();
    s_ParserH264VideoOutput.init();
    
-   s_uSMVideoStreamWritePosition = 2*sizeof(u32);
-   s_pSMVideoStreamerWrite = NULL;
+   s_pSMVideoFramesWrite = NULL;
 
    if ( s_bRxVideoOutputUseSM )
    {
-      int fdSM = shm_open(SM_STREAMER_NAME, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
-
-      if( fdSM < 0 )
-         log_softerror_and_alarm("[VideoOutput] Failed to open shared memory for write: %s, error: %d %s", SM_STREAMER_NAME, errno, strerror(errno));
+      s_pSMVideoFramesWrite = shared_mem_video_frames_open_write(SM_STREAMER_NAME);
+      if ( NULL == s_pSMVideoFramesWrite )
+         log_softerror_and_alarm("[VideoOutput] Failed to open shared memory frames ring for video output: %s", SM_STREAMER_NAME);
       else
-      {
-         if ( ftruncate(fdSM, SM_STREAMER_SIZE) == -1 )
-         {
-            log_softerror_and_alarm("[VideoOutput] Failed to init (ftruncate) shared memory: %s, error: %d %s", SM_STREAMER_NAME, errno, strerror(errno));
-            close(fdSM);
-         }
-         else
-         {
-            s_pSMVideoStreamerWrite = (u8*) mmap(NULL, SM_STREAMER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fdSM, 0);
-            if ( (s_pSMVideoStreamerWrite == MAP_FAILED) || (s_pSMVideoStreamerWrite == NULL) )
-            {
-               log_softerror_and_alarm("[VideoOutput] Failed to map shared memory %s, error: %d %s", SM_STREAMER_NAME, errno, strerror(errno));
-               close(fdSM);
-               s_pSMVideoStreamerWrite = NULL;
-            }
-            else
-            {
-               memset(s_pSMVideoStreamerWrite, 0, SM_STREAMER_SIZE);
-               close(fdSM);
-               s_uSMVideoStreamWritePosition = 2*sizeof(u32);
-               u32* pTmp1 = (u32*)(&(s_pSMVideoStreamerWrite[0]));
-               u32* pTmp2 = (u32*)(&(s_pSMVideoStreamerWrite[sizeof(u32)]));
-               *pTmp1 = s_uSMVideoStreamWritePosition;
-               *pTmp2 = s_uSMVideoStreamWritePosition;
-               log_line("[VideoOutput] Successfully opened and cleared SM for video output: %s", SM_STREAMER_NAME);
-            }
-         }
-      }
+         log_line("[VideoOutput] Successfully opened and cleared SM frames ring for video output: %s", SM_STREAMER_NAME);
    }
    s_pSemaphoreVideoStreamerOverloadAlarm = sem_open(SEMAPHORE_VIDEO_STREAMER_OVERLOAD, O_CREAT, S_IWUSR | S_IRUSR, 0);
    if ( (NULL == s_pSemaphoreVideoStreamerOverloadAlarm) || (SEM_FAILED == s_pSemaphoreVideoStreamerOverloadAlarm) )
@@ -643,12 +768,20 @@ void rx_video_output_init()
    else
       log_line("[VideoOutput] Opened semaphore for video streamer to signal alarms.");
 
+   if ( NULL == s_VideoUDPEgress.pBuffer )
+      s_VideoUDPEgress.pBuffer = (u8*) malloc(VIDEO_EGRESS_BUFFER_SIZE);
+   if ( NULL == s_VideoUDPEgress.pBuffer )
+      log_error_and_alarm("[VideoOutput] Failed to allocate buffer for UDP video outputs.");
+   s_VideoUDPEgress.iBufferPos = 0;
+   s_VideoUDPEgress.uTimeFirstData = 0;
+   for( int i=0; i<VIDEO_EGRESS_DESTINATIONS; i++ )
+      s_VideoUDPEgress.bUseGSO[i] = true;
+
    s_VideoUSBOutputInfo.bVideoUSBTethering = false;
    s_VideoUSBOutputInfo.TimeLastVideoUSBTetheringCheck = 0;
    s_VideoUSBOutputInfo.szIPUSBVideo[0] = 0;
    s_VideoUSBOutputInfo.socketUSBOutput = -1;
    s_VideoUSBOutputInfo.usbBlockSize = 1024;
-   s_VideoUSBOutputInfo.usbBufferPos = 0;
    
    if ( NULL != g_pControllerSettings )
    {
@@ -659,8 +792,9 @@ void rx_video_output_init()
    s_VideoETHOutputInfo.s_bForwardIsETHForwardEnabled = false;
    s_VideoETHOutputInfo.s_ForwardETHVideoPipeFile = -1;
    s_VideoETHOutputInfo.s_ForwardETHSocketVideo = -1;
-   s_VideoETHOutputInfo.s_nBufferETHPos = 0;
    s_VideoETHOutputInfo.s_BufferETHPacketSize = 1024;
+   s_VideoETHOutputInfo.s_bForwardETHRTPEnabled = false;
+   s_VideoETHOutputInfo.s_bForwardETHRTCPEnabled = false;
 
    if ( (NULL != g_pControllerSettings) && ( g_pControllerSettings->nVideoForwardETHType == 1 ) )
       s_VideoETHOutputInfo.s_bForwardIsETHForwardEnabled = true;
@@ -677,6 +811,11 @@ void rx_video_output_init()
       log_line("[VideoOutput] Video ETH forwarding is enabled, type RTS.");
       _processor_rx_video_forward_create_eth_socket();
    }
+   if ( (NULL != g_pControllerSettings) && ( (g_pControllerSettings->nVideoForwardETHType == 3) || (g_pControllerSettings->nVideoForwardETHType == 4) ) )
+   {
+      log_line("[VideoOutput] Video ETH forwarding is enabled, type RTP%s.", (g_pControllerSettings->nVideoForwardETHType == 4)?" + RTCP":"");
+      _rx_video_output_rtp_enable(g_pControllerSettings->nVideoForwardETHType == 4);
+   }
    
    s_pRxVideoSemaphoreRestartVideoStreamer = sem_open(SEMAPHORE_RESTART_VIDEO_STREAMER, O_CREAT, S_IWUSR | S_IRUSR, 0);
    if ( (NULL == s_pRxVideoSemaphoreRestartVideoStreamer) || (SEM_FAILED == s_pRxVideoSemaphoreRestartVideoStreamer) )
@@ -755,6 +894,7 @@ void rx_video_output_uninit()
       hw_stop_process("gst-launch-1.0");
    s_VideoETHOutputInfo.s_bForwardIsETHForwardEnabled = false;
    s_VideoETHOutputInfo.s_bForwardETHPipeEnabled = false;
+   _rx_video_output_rtp_disable();
 
    if ( -1 != s_fPipeVideoOutToStreamer )
    {
@@ -774,7 +914,11 @@ void rx_video_output_uninit()
       close(s_VideoUSBOutputInfo.socketUSBOutput);
    s_VideoUSBOutputInfo.socketUSBOutput = -1;
    s_VideoUSBOutputInfo.bVideoUSBTethering = false;
-   s_VideoUSBOutputInfo.usbBufferPos = 0;
+
+   if ( NULL != s_VideoUDPEgress.pBuffer )
+      free(s_VideoUDPEgress.pBuffer);
+   s_VideoUDPEgress.pBuffer = NULL;
+   s_VideoUDPEgress.iBufferPos = 0;
 
    rx_video_recording_uninit();
 
@@ -782,12 +926,11 @@ void rx_video_output_uninit()
       sem_close(s_pSemaphoreVideoStreamerOverloadAlarm);
    s_pSemaphoreVideoStreamerOverloadAlarm = NULL;
 
-   if ( NULL != s_pSMVideoStreamerWrite )
+   if ( NULL != s_pSMVideoFramesWrite )
    {
-      munmap(s_pSMVideoStreamerWrite, SM_STREAMER_SIZE);
-      s_pSMVideoStreamerWrite = NULL;
-      s_uSMVideoStreamWritePosition = 2*sizeof(u32);
-      log_line("[VideoOutput] Closes streamer SM for video output: %S", SM_STREAMER_NAME);
+      shared_mem_video_frames_close(SM_STREAMER_NAME, s_pSMVideoFramesWrite);
+      s_pSMVideoFramesWrite = NULL;
+      log_line("[VideoOutput] Closed streamer SM for video output: %s", SM_STREAMER_NAME);
    }
    log_line("[VideoOutput] Uninit complete.");
 }
@@ -798,12 +941,8 @@ void rx_video_output_enable_streamer_output()
 
    if ( s_bRxVideoOutputUseSM )
    {
-      s_uSMVideoStreamWritePosition = 2*sizeof(u32);
-      u32* pTmp1 = (u32*)(&(s_pSMVideoStreamerWrite[0]));
-      u32* pTmp2 = (u32*)(&(s_pSMVideoStreamerWrite[sizeof(u32)]));
-      *pTmp1 = s_uSMVideoStreamWritePosition;
-      *pTmp2 = s_uSMVideoStreamWritePosition;
-      log_line("[VideoOutput] Reseted SM video output position.");
+      shared_mem_video_frames_discard_frame(s_pSMVideoFramesWrite);
+      log_line("[VideoOutput] Reseted SM video output frame.");
    }
 
    _rx_video_output_check_start_streamer();
@@ -922,9 +1061,14 @@ void _rx_video_output_parse_h264_stream(u32 uVehicleId, u8* pBuffer, int iLength
    */
 }
 
-void _rx_video_output_to_sharedmem(u8* pBuffer, u32 uLength, bool bWaitFullFrame, bool bIsEndOfNALFrame)
+// Each video frame is written contiguously in the shared memory frames ring and published at the end of the frame,
+// so the player can feed whole frames to the decoder, in place, without parsing the stream.
+// In low latency mode (bWaitFullFrame false) each segment is published right away, as it was when the
+// output was a byte stream, so the player does not wait for the end of the frame.
+
+void _rx_video_output_to_sharedmem(t_packet_header_video_segment* pPHVS, u8* pBuffer, u32 uLength, bool bWaitFullFrame)
 {
-   if ( (NULL == pBuffer) || (uLength == 0 ) || (NULL == s_pSMVideoStreamerWrite) || (!s_bEnableVideoStreamerOutput) || s_bRxVideoOutputStreamerMustReinitialize )
+   if ( (NULL == pBuffer) || (uLength == 0 ) || (NULL == s_pSMVideoFramesWrite) || (!s_bEnableVideoStreamerOutput) || s_bRxVideoOutputStreamerMustReinitialize )
       return;
 
    s_uTimeLastOutputDataToLocalVideoPlayer = g_TimeNow;
@@ -934,38 +1078,30 @@ void _rx_video_output_to_sharedmem(u8* pBuffer, u32 uLength, bool bWaitFullFrame
       s_bDidSentAnyDataToVideoStreamerSM = true;
    }
 
-   if ( uLength <= (SM_STREAMER_SIZE-s_uSMVideoStreamWritePosition) )
-   {
-      memcpy(&(s_pSMVideoStreamerWrite[s_uSMVideoStreamWritePosition]), pBuffer, uLength);
-      s_uSMVideoStreamWritePosition += uLength;
-      if ( s_uSMVideoStreamWritePosition >= SM_STREAMER_SIZE )
-         s_uSMVideoStreamWritePosition = 2*sizeof(u32);
-   }
-   else
+   u32 uFramesBefore = s_pSMVideoFramesWrite->pHeader->uFramesWritten;
+   u8* pWrite = shared_mem_video_frames_reserve(s_pSMVideoFramesWrite, pPHVS->uH264FrameIndex, (int)uLength, g_TimeNow);
+   if ( NULL != pWrite )
    {
-      u32 uLeft = SM_STREAMER_SIZE-s_uSMVideoStreamWritePosition;
-      memcpy(&(s_pSMVideoStreamerWrite[s_uSMVideoStreamWritePosition]), pBuffer, uLeft);
-      u8* pTmp = pBuffer + uLeft;
-      s_uSMVideoStreamWritePosition = 2*sizeof(u32);
-
-      memcpy(&(s_pSMVideoStreamerWrite[s_uSMVideoStreamWritePosition]), pTmp, uLength-uLeft);
-      s_uSMVideoStreamWritePosition += uLength-uLeft;
-      if ( s_uSMVideoStreamWritePosition >= SM_STREAMER_SIZE )
-         s_uSMVideoStreamWritePosition = 2*sizeof(u32);
+      memcpy(pWrite, pBuffer, uLength);
+      u32 uFlags = 0;
+      if ( pPHVS->uVideoStatusFlags2 & VIDEO_STATUS_FLAGS2_IS_NAL_I )
+         uFlags |= SM_VIDEO_FRAME_FLAG_KEYFRAME;
+      if ( ((pPHVS->uVideoStreamIndexAndType >> 4) & 0x0F) == VIDEO_TYPE_H265 )
+         uFlags |= SM_VIDEO_FRAME_FLAG_H265;
+      bool bIsEndOfFrame = (pPHVS->uVideoStatusFlags2 & VIDEO_STATUS_FLAGS2_IS_END_OF_FRAME)?true:false;
+      if ( (! bWaitFullFrame) && (! bIsEndOfFrame) )
+         uFlags |= SM_VIDEO_FRAME_FLAG_PARTIAL;
+      shared_mem_video_frames_add_flags(s_pSMVideoFramesWrite, uFlags);
+      if ( (! bWaitFullFrame) || bIsEndOfFrame )
+         shared_mem_video_frames_end_frame(s_pSMVideoFramesWrite);
    }
 
-   if ( (! bWaitFullFrame) || (bWaitFullFrame && bIsEndOfNALFrame) )
+   // A frame or segment was published (this one, or the previous frame if its end was lost)
+   if ( s_pSMVideoFramesWrite->pHeader->uFramesWritten != uFramesBefore )
+   if ( NULL != s_pSemaphoreSMData )
    {
-      u32* pTmp1 = (u32*)(&(s_pSMVideoStreamerWrite[0]));
-      u32* pTmp2 = (u32*)(&(s_pSMVideoStreamerWrite[sizeof(u32)]));
-      *pTmp1 = s_uSMVideoStreamWritePosition;
-      *pTmp2 = s_uSMVideoStreamWritePosition;
-
-      if ( NULL != s_pSemaphoreSMData )
-      {
-         if ( 0 != sem_post(s_pSemaphoreSMData) )
-            log_softerror_and_alarm("[VideoOutput] Failed to set semaphore for SM data.");
-      }
+      if ( 0 != sem_post(s_pSemaphoreSMData) )
+         log_softerror_and_alarm("[VideoOutput] Failed to set semaphore for SM data.");
    }
 }
 
@@ -1070,95 +1206,163 @@ void _rx_video_output_to_video_streamer_pipe(u8* pBuffer, int iLength, bool bWai
    }
 }
 
-void _rx_video_output_to_local_video_player_udp(u8* pData, int iLength)
+// ETH or USB outputs
+bool _rx_video_output_egress_has_network_destinations()
 {
-   s_uOutputBitrateToLocalVideoPlayerUDP += iLength*8;
-   
-   sendto(s_iLocalVideoPlayerUDPSocket, pData, iLength, 0, (struct sockaddr *)&s_LocalVideoPlayuerUDPSocketAddr, sizeof(s_LocalVideoPlayuerUDPSocketAddr) );
-   /*
-   struct iovec iov;
-   struct msghdr msghdr;
-   iov.iov_base = pData;
-   iov.iov_len = iLength;
-   
-   memset(&msghdr, 0, sizeof(msghdr));
-   msghdr.msg_iov = &iov;
-   msghdr.msg_iovlen = 1;
+   if ( s_VideoETHOutputInfo.s_bForwardIsETHForwardEnabled && (-1 != s_VideoETHOutputInfo.s_ForwardETHSocketVideo) )
+      return true;
+   if ( s_VideoUSBOutputInfo.bVideoUSBTethering && (-1 != s_VideoUSBOutputInfo.socketUSBOutput) && (0 != s_VideoUSBOutputInfo.szIPUSBVideo[0]) )
+      return true;
+   return false;
+}
 
-   sendmsg(s_iLocalVideoPlayerUDPSocket, &msghdr, MSG_DONTWAIT);
-   */
+// Sends the data to one destination, as datagrams of iPacketSize bytes (last one can be shorter).
+// Returns 0 on success, -1 on socket error.
+
+int _rx_video_output_egress_send(int iDestination, int iSocket, struct sockaddr_in* pAddr, int iPacketSize, u8* pData, int iDataLength)
+{
+   struct mmsghdr msgs[VIDEO_EGRESS_MAX_MESSAGES];
+   struct iovec iovs[VIDEO_EGRESS_MAX_MESSAGES];
+   u8 uControl[VIDEO_EGRESS_MAX_MESSAGES][CMSG_SPACE(sizeof(u16))];
+
+   if ( iPacketSize <= 0 )
+      iPacketSize = 1024;
+   int iMaxSegments = VIDEO_EGRESS_GSO_MAX_BYTES / iPacketSize;
+   if ( iMaxSegments > VIDEO_EGRESS_GSO_MAX_SEGMENTS )
+      iMaxSegments = VIDEO_EGRESS_GSO_MAX_SEGMENTS;
+
+   int iPos = 0;
+   while ( iPos < iDataLength )
+   {
+      // One message per datagram, or per group of datagrams when using UDP GSO
+      int iCount = 0;
+      while ( (iPos < iDataLength) && (iCount < VIDEO_EGRESS_MAX_MESSAGES) )
+      {
+         int iLength = iDataLength - iPos;
+         bool bGSO = s_VideoUDPEgress.bUseGSO[iDestination] && (iMaxSegments > 1) && (iLength > iPacketSize);
+         if ( bGSO && (iLength > iMaxSegments * iPacketSize) )
+            iLength = iMaxSegments * iPacketSize;
+         if ( (! bGSO) && (iLength > iPacketSize) )
+            iLength = iPacketSize;
+
+         iovs[iCount].iov_base = pData + iPos;
+         iovs[iCount].iov_len = iLength;
+         memset(&msgs[iCount], 0, sizeof(struct mmsghdr));
+         msgs[iCount].msg_hdr.msg_name = pAddr;
+         msgs[iCount].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+         msgs[iCount].msg_hdr.msg_iov = &iovs[iCount];
+         msgs[iCount].msg_hdr.msg_iovlen = 1;
+         if ( bGSO )
+         {
+            msgs[iCount].msg_hdr.msg_control = uControl[iCount];
+            msgs[iCount].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(u16));
+            struct cmsghdr* pCMsg = CMSG_FIRSTHDR(&msgs[iCount].msg_hdr);
+            pCMsg->cmsg_level = SOL_UDP;
+            pCMsg->cmsg_type = UDP_SEGMENT;
+            pCMsg->cmsg_len = CMSG_LEN(sizeof(u16));
+            u16 uSegmentSize = (u16)iPacketSize;
+            memcpy(CMSG_DATA(pCMsg), &uSegmentSize, sizeof(u16));
+         }
+         iPos += iLength;
+         iCount++;
+      }
+
+      int iSent = _rx_video_output_sendmmsg(iSocket, msgs, iCount);
+      if ( iSent < iCount )
+      {
+         // UDP GSO not supported by the kernel or the interface? Resend the remaining data without it
+         if ( s_VideoUDPEgress.bUseGSO[iDestination] &&
+              ((errno == EIO) || (errno == EINVAL) || (errno == ENOPROTOOPT) || (errno == EOPNOTSUPP)) )
+         {
+            log_line("[VideoOutput] UDP GSO not supported for video output %d (error: %d, %s), using one message per packet.", iDestination, errno, strerror(errno));
+            s_VideoUDPEgress.bUseGSO[iDestination] = false;
+            iPos = (int)((u8*)iovs[iSent].iov_base - pData);
+            continue;
+         }
+         return -1;
+      }
+   }
+   return 0;
 }
 
-void _rx_video_output_to_eth(u8* pData, int iLength)
+void _rx_video_output_egress_flush()
 {
-   int dataLen = iLength;
-   while ( dataLen > 0 )
-   {
-       int maxCopy = dataLen;
-       if ( maxCopy > s_VideoETHOutputInfo.s_BufferETHPacketSize - s_VideoETHOutputInfo.s_nBufferETHPos )
-          maxCopy = s_VideoETHOutputInfo.s_BufferETHPacketSize - s_VideoETHOutputInfo.s_nBufferETHPos;
-       memcpy( &(s_VideoETHOutputInfo.s_BufferETH[s_VideoETHOutputInfo.s_nBufferETHPos]), pData, maxCopy );
-       pData += maxCopy;
-       dataLen -= maxCopy;
-       s_VideoETHOutputInfo.s_nBufferETHPos += maxCopy;
-       if ( s_VideoETHOutputInfo.s_nBufferETHPos >= s_VideoETHOutputInfo.s_BufferETHPacketSize )
-       {
-          int res = sendto(s_VideoETHOutputInfo.s_ForwardETHSocketVideo, s_VideoETHOutputInfo.s_BufferETH, s_VideoETHOutputInfo.s_nBufferETHPos,
-                        0, (struct sockaddr *)&s_VideoETHOutputInfo.s_ForwardETHSockAddr, sizeof(s_VideoETHOutputInfo.s_ForwardETHSockAddr) );
-          if ( res < 0 )
-          {
-             log_line("[VideoOutput] Failed to send to ETH Port %d bytes, [fd=%d]", iLength, s_VideoETHOutputInfo.s_ForwardETHSocketVideo);
-             close(s_VideoETHOutputInfo.s_ForwardETHSocketVideo);
-             s_VideoETHOutputInfo.s_ForwardETHSocketVideo = -1;
-          }
-          //else
-          //   log_line("Sent %d bytes to port %d", video_data_length, g_pControllerSettings->nVideoForwardETHPort);
-          s_VideoETHOutputInfo.s_nBufferETHPos = 0;
-       }
+   if ( (NULL == s_VideoUDPEgress.pBuffer) || (0 == s_VideoUDPEgress.iBufferPos) )
+      return;
+
+   if ( -1 != s_iLocalVideoPlayerUDPSocket )
+   {
+      s_uOutputBitrateToLocalVideoPlayerUDP += s_VideoUDPEgress.iBufferPos*8;
+      // Errors are ignored, as the local player might not be listening yet
+      _rx_video_output_egress_send(VIDEO_EGRESS_DEST_LOCAL_PLAYER, s_iLocalVideoPlayerUDPSocket, &s_LocalVideoPlayuerUDPSocketAddr, VIDEO_EGRESS_LOCAL_PLAYER_PACKET_SIZE, s_VideoUDPEgress.pBuffer, s_VideoUDPEgress.iBufferPos);
+   }
+
+   if ( s_VideoETHOutputInfo.s_bForwardIsETHForwardEnabled && (-1 != s_VideoETHOutputInfo.s_ForwardETHSocketVideo) )
+   if ( 0 != _rx_video_output_egress_send(VIDEO_EGRESS_DEST_ETH, s_VideoETHOutputInfo.s_ForwardETHSocketVideo, &s_VideoETHOutputInfo.s_ForwardETHSockAddr, s_VideoETHOutputInfo.s_BufferETHPacketSize, s_VideoUDPEgress.pBuffer, s_VideoUDPEgress.iBufferPos) )
+   {
+      log_line("[VideoOutput] Failed to send to ETH Port %d bytes, [fd=%d]", s_VideoUDPEgress.iBufferPos, s_VideoETHOutputInfo.s_ForwardETHSocketVideo);
+      close(s_VideoETHOutputInfo.s_ForwardETHSocketVideo);
+      s_VideoETHOutputInfo.s_ForwardETHSocketVideo = -1;
    }
+
+   if ( s_VideoUSBOutputInfo.bVideoUSBTethering && (-1 != s_VideoUSBOutputInfo.socketUSBOutput) && (0 != s_VideoUSBOutputInfo.szIPUSBVideo[0]) )
+   if ( 0 != _rx_video_output_egress_send(VIDEO_EGRESS_DEST_USB, s_VideoUSBOutputInfo.socketUSBOutput, &s_VideoUSBOutputInfo.sockAddrUSBDevice, s_VideoUSBOutputInfo.usbBlockSize, s_VideoUDPEgress.pBuffer, s_VideoUDPEgress.iBufferPos) )
+   {
+      log_line("[VideoOutput] Failed to send to USB socket");
+      close(s_VideoUSBOutputInfo.socketUSBOutput);
+      s_VideoUSBOutputInfo.socketUSBOutput = -1;
+      s_VideoUSBOutputInfo.bVideoUSBTethering = false;
+      log_line("[VideoOutput] Video Output to USB disabled.");
+   }
+
+   s_VideoUDPEgress.iBufferPos = 0;
 }
 
-void _rx_video_output_to_usb(u8* pData, int iLength)
+void _rx_video_output_egress_add(u8* pData, int iLength, bool bIsEndOfFrame)
 {
-   int dataLen = iLength;
-   while ( dataLen > 0 )
-   {
-      int maxCopy = dataLen;
-      if ( maxCopy > s_VideoUSBOutputInfo.usbBlockSize - s_VideoUSBOutputInfo.usbBufferPos )
-          maxCopy = s_VideoUSBOutputInfo.usbBlockSize - s_VideoUSBOutputInfo.usbBufferPos;
-      memcpy( &(s_VideoUSBOutputInfo.usbBuffer[s_VideoUSBOutputInfo.usbBufferPos]), pData, maxCopy );
-      pData += maxCopy;
-      dataLen -= maxCopy;
-      s_VideoUSBOutputInfo.usbBufferPos += maxCopy;
-      if ( s_VideoUSBOutputInfo.usbBufferPos >= s_VideoUSBOutputInfo.usbBlockSize )
+   if ( (NULL == s_VideoUDPEgress.pBuffer) || (iLength <= 0) )
+      return;
+   if ( ! _rx_video_output_egress_has_network_destinations() )
+   {
+      // Data staged before the ETH/USB outputs went away still goes to the local player first
+      if ( 0 != s_VideoUDPEgress.iBufferPos )
+         _rx_video_output_egress_flush();
+      if ( -1 != s_iLocalVideoPlayerUDPSocket )
       {
-         int res = sendto(s_VideoUSBOutputInfo.socketUSBOutput, s_VideoUSBOutputInfo.usbBuffer, s_VideoUSBOutputInfo.usbBlockSize,
-               0, (struct sockaddr *)&s_VideoUSBOutputInfo.sockAddrUSBDevice, sizeof(s_VideoUSBOutputInfo.sockAddrUSBDevice) );
-         if ( res < 0 )
-         {
-           log_line("[VideoOutput] Failed to send to USB socket");
-           if ( -1 != s_VideoUSBOutputInfo.socketUSBOutput )
-              close(s_VideoUSBOutputInfo.socketUSBOutput);
-           s_VideoUSBOutputInfo.socketUSBOutput = -1;
-           s_VideoUSBOutputInfo.bVideoUSBTethering = false;
-           s_VideoUSBOutputInfo.usbBufferPos = 0;
-           log_line("[VideoOutput] Video Output to USB disabled.");
-           break;
-         }
-         s_VideoUSBOutputInfo.usbBufferPos = 0;
+         s_uOutputBitrateToLocalVideoPlayerUDP += iLength*8;
+         _rx_video_output_egress_send(VIDEO_EGRESS_DEST_LOCAL_PLAYER, s_iLocalVideoPlayerUDPSocket, &s_LocalVideoPlayuerUDPSocketAddr, VIDEO_EGRESS_LOCAL_PLAYER_PACKET_SIZE, pData, iLength);
       }
+      return;
    }
+
+   if ( s_VideoUDPEgress.iBufferPos + iLength > VIDEO_EGRESS_BUFFER_SIZE )
+      _rx_video_output_egress_flush();
+   if ( iLength > VIDEO_EGRESS_BUFFER_SIZE )
+      iLength = VIDEO_EGRESS_BUFFER_SIZE;
+   if ( 0 == s_VideoUDPEgress.iBufferPos )
+      s_VideoUDPEgress.uTimeFirstData = g_TimeNow;
+
+   memcpy(s_VideoUDPEgress.pBuffer + s_VideoUDPEgress.iBufferPos, pData, iLength);
+   s_VideoUDPEgress.iBufferPos += iLength;
+
+   if ( bIsEndOfFrame )
+      _rx_video_output_egress_flush();
 }
 
 void rx_video_output_discard_cached_data()
 {
    if ( s_bEnableVideoStreamerOutput && s_bRxVideoOutputUseSM )
-   if ( NULL != s_pSMVideoStreamerWrite )
-   {
-      s_uSMVideoStreamWritePosition = s_pSMVideoStreamerWrite[0];
-   }
+      shared_mem_video_frames_discard_frame(s_pSMVideoFramesWrite);
 
    s_iPipeVideoOutputPos = 0;
+   s_VideoUDPEgress.iBufferPos = 0;
+
+   if ( s_VideoETHOutputInfo.s_bForwardETHRTPEnabled )
+   {
+      rx_video_rtp_reset_stream(&s_VideoETHOutputInfo.s_RTPPacketizer, s_VideoETHOutputInfo.s_RTPPacketizer.uVideoStreamType);
+      rx_video_rtp_clear_packets(&s_VideoETHOutputInfo.s_RTPPacketizer);
+      s_VideoETHOutputInfo.s_uTimeFirstPendingRTPPacket = 0;
+   }
 }
 
 void rx_video_output_video_data(u32 uVehicleId, t_packet_header_video_segment* pPHVS, int width, int height, u8* pBuffer, int video_data_length, int packet_length, bool bWaitFullFrame)
@@ -1258,24 +1462,21 @@ void rx_video_output_video_data(u32 uVehicleId, t_packet_header_video_segment* p
    }
 
    if ( s_bEnableVideoStreamerOutput && s_bRxVideoOutputUseSM )
-      _rx_video_output_to_sharedmem(pBuffer, (u32)video_data_length, bWaitFullFrame, (pPHVS->uVideoStatusFlags2 & VIDEO_STATUS_FLAGS2_IS_NAL_END)?true:false);
+      _rx_video_output_to_sharedmem(pPHVS, pBuffer, (u32)video_data_length, bWaitFullFrame);
 
    if ( (-1 != s_fPipeVideoOutToStreamer) && s_bEnableVideoStreamerOutput && s_bRxVideoOutputUsePipe )
       _rx_video_output_to_video_streamer_pipe(pBuffer, video_data_length, bWaitFullFrame, (pPHVS->uVideoStatusFlags2 & VIDEO_STATUS_FLAGS2_IS_NAL_END)?true:false);
 
-   if ( -1 != s_iLocalVideoPlayerUDPSocket )
-      _rx_video_output_to_local_video_player_udp(pBuffer, video_data_length);
-
    if ( s_VideoETHOutputInfo.s_bForwardETHPipeEnabled && (-1 != s_VideoETHOutputInfo.s_ForwardETHVideoPipeFile) )
       write(s_VideoETHOutputInfo.s_ForwardETHVideoPipeFile, pBuffer, video_data_length);
 
-   rx_video_recording_on_new_data(pBuffer, video_data_length);
+   rx_video_recording_on_new_data(pPHVS, pBuffer, video_data_length);
 
-   if ( s_VideoETHOutputInfo.s_bForwardIsETHForwardEnabled && (-1 != s_VideoETHOutputInfo.s_ForwardETHSocketVideo ) )
-      _rx_video_output_to_eth(pBuffer, video_data_length);
+   if ( s_VideoETHOutputInfo.s_bForwardETHRTPEnabled && (-1 != s_VideoETHOutputInfo.s_ForwardETHSocketVideo) )
+      _rx_video_output_to_rtp(pPHVS, pBuffer, video_data_length);
 
-   if ( s_VideoUSBOutputInfo.bVideoUSBTethering && 0 != s_VideoUSBOutputInfo.szIPUSBVideo[0] )
-      _rx_video_output_to_usb(pBuffer, video_data_length);
+   // Local player UDP, ETH and USB outputs
+   _rx_video_output_egress_add(pBuffer, video_data_length, (pPHVS->uVideoStatusFlags2 & VIDEO_STATUS_FLAGS2_IS_END_OF_FRAME)?true:false);
 }
 
 
@@ -1304,6 +1505,7 @@ void rx_video_output_on_controller_settings_changed()
 
       s_VideoETHOutputInfo.s_bForwardETHPipeEnabled = false;
       s_VideoETHOutputInfo.s_bForwardIsETHForwardEnabled = false;
+      _rx_video_output_rtp_disable();
       log_line("[VideoOutput] Video ETH forwarding was disabled.");
    }
    else if ( g_pControllerSettings->nVideoForwardETHType == 1 )
@@ -1315,6 +1517,7 @@ void rx_video_output_on_controller_settings_changed()
          hw_stop_process("gst-launch-1.0");
       s_VideoETHOutputInfo.s_bForwardETHPipeEnabled = false;
       s_VideoETHOutputInfo.s_bForwardIsETHForwardEnabled = true;
+      _rx_video_output_rtp_disable();
 
       log_line("[VideoOutput] Video ETH forwarding is enabled, type Raw.");
       _processor_rx_video_forward_create_eth_socket();
@@ -1325,11 +1528,24 @@ void rx_video_output_on_controller_settings_changed()
          close(s_VideoETHOutputInfo.s_ForwardETHSocketVideo);
       s_VideoETHOutputInfo.s_ForwardETHSocketVideo = -1;
       s_VideoETHOutputInfo.s_bForwardIsETHForwardEnabled = false;
+      _rx_video_output_rtp_disable();
 
       s_VideoETHOutputInfo.s_bForwardETHPipeEnabled = true;
       log_line("[VideoOutput] Video ETH forwarding is enabled, type RTS.");
       _processor_rx_video_forward_open_eth_pipe();
    }
+   else if ( (g_pControllerSettings->nVideoForwardETHType == 3) || (g_pControllerSettings->nVideoForwardETHType == 4) )
+   {
+      if ( -1 != s_VideoETHOutputInfo.s_ForwardETHVideoPipeFile )
+         close(s_VideoETHOutputInfo.s_ForwardETHVideoPipeFile);
+      s_VideoETHOutputInfo.s_ForwardETHVideoPipeFile = -1;
+      if ( s_VideoETHOutputInfo.s_bForwardETHPipeEnabled )
+         hw_stop_process("gst-launch-1.0");
+      s_VideoETHOutputInfo.s_bForwardETHPipeEnabled = false;
+
+      log_line("[VideoOutput] Video ETH forwarding is enabled, type RTP%s.", (g_pControllerSettings->nVideoForwardETHType == 4)?" + RTCP":"");
+      _rx_video_output_rtp_enable(g_pControllerSettings->nVideoForwardETHType == 4);
+   }
 
    s_iLastUSBVideoForwardPort = g_pControllerSettings->iVideoForwardUSBPort;
    s_iLastUSBVideoForwardPacketSize = g_pControllerSettings->iVideoForwardUSBPacketSize;
@@ -1413,6 +1629,22 @@ void rx_video_output_periodic_loop()
 {
    rx_video_recording_periodic_loop();
 
+   // End of frame not received (lost)? Don't hold the staged video data
+   if ( s_VideoUDPEgress.iBufferPos > 0 )
+   if ( g_TimeNow > s_VideoUDPEgress.uTimeFirstData + VIDEO_EGRESS_MAX_DELAY_MS )
+      _rx_video_output_egress_flush();
+
+   if ( s_VideoETHOutputInfo.s_bForwardETHRTPEnabled )
+   {
+      if ( (0 != s_VideoETHOutputInfo.s_uTimeFirstPendingRTPPacket) && (g_TimeNow > s_VideoETHOutputInfo.s_uTimeFirstPendingRTPPacket + VIDEO_EGRESS_MAX_DELAY_MS) )
+      {
+         _rx_video_output_rtp_send_packets(&s_VideoETHOutputInfo.s_RTPPacketizer);
+         s_VideoETHOutputInfo.s_uTimeFirstPendingRTPPacket = 0;
+      }
+      if ( s_VideoETHOutputInfo.s_bForwardETHRTCPEnabled && (g_TimeNow >= s_VideoETHOutputInfo.s_uTimeLastRTCPSenderReport + 1000) )
+         _rx_video_output_rtp_send_sender_report();
+   }
+
    #if defined(HW_PLATFORM_RADXA)
    _rx_video_output_watchdog_mpp_player();
    #endif
@@ -1468,7 +1700,6 @@ void rx_video_output_periodic_loop()
             s_VideoUSBOutputInfo.sockAddrUSBDevice.sin_port = htons( g_pControllerSettings->iVideoForwardUSBPort );
          }
          s_VideoUSBOutputInfo.usbBlockSize = g_pControllerSettings->iVideoForwardUSBPacketSize;
-         s_VideoUSBOutputInfo.usbBufferPos = 0;
          s_VideoUSBOutputInfo.bVideoUSBTethering = true;
          return;
          }
@@ -1480,7 +1711,6 @@ void rx_video_output_periodic_loop()
             if ( -1 != s_VideoUSBOutputInfo.socketUSBOutput )
                close(s_VideoUSBOutputInfo.socketUSBOutput);
             s_VideoUSBOutputInfo.socketUSBOutput = -1;
-            s_VideoUSBOutputInfo.usbBufferPos = 0;
             s_VideoUSBOutputInfo.bVideoUSBTethering = false;
          }
       }
@@ -40,6 +40,8 @@
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#include <limits.h>
+#include <sys/statvfs.h>
 #include <netdb.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -68,6 +70,31 @@
 #include "timers.h"
 #include "ruby_rt_station.h"
 #include "rx_video_recording_data.h"
+#include "rx_video_recording_mp4.h"
+
+// The video data goes from the router main loop to the recording thread, through the recording pipe,
+// as pieces of video frames, each with a header. A piece (header included) is at most PIPE_BUF bytes,
+// so a non blocking write of it is atomic: the whole piece or nothing (EAGAIN). The pipe never holds
+// partial pieces and the router never waits for the recording thread; when it is behind, the rest of
+// the current frame is dropped, the next frame is flagged as a discontinuity and the recording
+// continues from the next keyframe.
+
+#define RECORDING_PIECE_MAGIC 0x52564652
+#define RECORDING_PIECE_MAX_SIZE PIPE_BUF
+#define RECORDING_PIECE_FLAG_FRAME_START ((u32)0x01)
+#define RECORDING_PIECE_FLAG_FRAME_END ((u32)0x02)
+#define RECORDING_PIECE_FLAG_DISCONTINUITY ((u32)0x04)
+#define RECORDING_MAX_FRAME_SIZE (2*1024*1024)
+
+typedef struct
+{
+   u32 uMagic;
+   u32 uLength; // video data bytes after this header
+   u32 uFlags;
+   u16 uFrameIndex;
+   u16 uFrameDistanceMs;
+   u32 uTimeMs;
+} t_recording_piece_header;
 
 bool s_bIsRecording = false;
 bool s_bRequestedStopRecording = false;
@@ -79,21 +106,37 @@ int s_iPipeRecordingThreadWrite = 0;
 int s_iPipeRecordingThreadRead = 0;
 u32 s_TimeStartRecording = MAX_U32;
 char s_szFileRecordingOutput[MAX_FILE_PATH_SIZE];
-int s_iFileVideoRecordingOutput = -1;
+t_mp4_writer s_RecordingMP4Writer;
+bool s_bRecordingMP4WriterOpen = false;
+int s_iRecordingPipeSize = 0;
 u32 s_uRecordingFileSize = 0;
 int s_iRecordingWidth = 0;
 int s_iRecordingHeight = 0;
 int s_iRecordingFPS = 0;
 int s_iRecordingType = 0;
 
-u8 s_uTempRecordingBuffer[64000];
+// Router side: current piece (header followed by video data)
+u8 s_uTempRecordingBuffer[RECORDING_PIECE_MAX_SIZE];
 int s_iTempRecordingBufferFilledInBytes = 0;
-
-u32 s_uRecordingStreamCurrentParsedToken = 0x11111111;
-u32 s_uRecordingStreamPrevParsedToken = 0x11111111;
-bool s_bRecordingFoundStartOfFirstNAL = false;
+u32 s_uRecordingPieceFlags = 0;
+u16 s_uRecordingFrameIndex = 0;
+u16 s_uRecordingFrameDistanceMs = 0;
+bool s_bRecordingHasFrameIndex = false;
+bool s_bRecordingLastWasEndOfFrame = false;
+bool s_bRecordingInsideFrame = false;
+bool s_bRecordingDroppingFrame = false;
+bool s_bRecordingPendingDiscontinuity = false;
+u32 s_uRecordingDroppedPieces = 0;
+
+bool s_bRecordingFoundStartOfFirstFrame = false;
 bool s_bRecordingThreadReadyForData = false;
 
+// Recording thread side: video frame being assembled from pieces
+u8* s_pRecordingFrameBuffer = NULL;
+int s_iRecordingFrameSize = 0;
+bool s_bRecordingFrameStarted = false;
+bool s_bRecordingFrameDiscontinuity = false;
+
 void _recording_send_status_to_central(u8 uStatus, u8 uErrorLevel, const char* szError)
 {
    t_packet_header PH;
@@ -214,6 +257,43 @@ void _recording_cleanp_temp_recording_data()
    hw_execute_bash_command(szComm, NULL );
 }
 
+// Recording thread: assembles the video frames from the pieces read from the pipe
+bool _recording_on_piece(t_recording_piece_header* pHeader, u8* pData)
+{
+   if ( pHeader->uFlags & RECORDING_PIECE_FLAG_FRAME_START )
+   {
+      // End of the previous frame was dropped
+      if ( s_bRecordingFrameStarted )
+         s_bRecordingFrameDiscontinuity = true;
+      if ( pHeader->uFlags & RECORDING_PIECE_FLAG_DISCONTINUITY )
+         s_bRecordingFrameDiscontinuity = true;
+      s_bRecordingFrameStarted = true;
+      s_iRecordingFrameSize = 0;
+   }
+   if ( ! s_bRecordingFrameStarted )
+      return true;
+
+   if ( s_iRecordingFrameSize + (int)pHeader->uLength > RECORDING_MAX_FRAME_SIZE )
+   {
+      log_softerror_and_alarm("[VideoRecording-Th] Video frame too big (more than %d bytes). Skip it.", RECORDING_MAX_FRAME_SIZE);
+      s_bRecordingFrameStarted = false;
+      s_bRecordingFrameDiscontinuity = true;
+      return true;
+   }
+   memcpy(s_pRecordingFrameBuffer + s_iRecordingFrameSize, pData, pHeader->uLength);
+   s_iRecordingFrameSize += pHeader->uLength;
+
+   if ( ! (pHeader->uFlags & RECORDING_PIECE_FLAG_FRAME_END) )
+      return true;
+
+   bool bRes = rx_video_mp4_add_frame(&s_RecordingMP4Writer, s_pRecordingFrameBuffer, s_iRecordingFrameSize,
+      pHeader->uFrameIndex, pHeader->uFrameDistanceMs, pHeader->uTimeMs, s_bRecordingFrameDiscontinuity);
+   s_bRecordingFrameStarted = false;
+   s_bRecordingFrameDiscontinuity = false;
+   s_iRecordingFrameSize = 0;
+   return bRes;
+}
+
 void* _thread_video_recording(void *argument)
 {
    log_line("[VideoRecording-Th] Thread to record started.");
@@ -273,12 +353,16 @@ void* _thread_video_recording(void *argument)
    snprintf(szComm, sizeof(szComm)/sizeof(szComm[0]), "chmod 777 %s", s_szFileRecordingOutput);
    hw_execute_bash_command(szComm, NULL);
 
-   int iOpenFlags = O_CREAT | O_WRONLY;
-   //if ( RUBY_PIPES_EXTRA_FLAGS & O_NONBLOCK )
-   //   iOpenFlags |= O_NONBLOCK;
-   s_iFileVideoRecordingOutput = open(s_szFileRecordingOutput, iOpenFlags, 0666);
-   if ( -1 == s_iFileVideoRecordingOutput )
+   s_pRecordingFrameBuffer = (u8*)malloc(RECORDING_MAX_FRAME_SIZE);
+   s_bRecordingMP4WriterOpen = false;
+   if ( NULL != s_pRecordingFrameBuffer )
+      s_bRecordingMP4WriterOpen = rx_video_mp4_open(&s_RecordingMP4Writer, s_szFileRecordingOutput, (u8)s_iRecordingType, s_iRecordingWidth, s_iRecordingHeight, s_iRecordingFPS);
+   if ( ! s_bRecordingMP4WriterOpen )
    {
+      if ( NULL != s_pRecordingFrameBuffer )
+         free(s_pRecordingFrameBuffer);
+      s_pRecordingFrameBuffer = NULL;
+
       close(s_iPipeRecordingThreadRead);
       s_iPipeRecordingThreadRead = -1;
       close(s_iPipeRecordingThreadWrite);
@@ -299,21 +383,24 @@ void* _thread_video_recording(void *argument)
    if ( g_pControllerSettings->iRecordOSD )
       rx_video_recording_data_start_osd();
 
-   //if ( RUBY_PIPES_EXTRA_FLAGS & O_NONBLOCK )
-   //if ( 0 != fcntl(s_iFileVideoRecordingOutput, F_SETFL, O_NONBLOCK) )
-   //   log_softerror_and_alarm("[VideoRecording] Failed to set nonblock flag on video recording file");
-
-   log_line("[VideoRecording-Th] Video recording file flags: %s", str_get_pipe_flags(fcntl(s_iFileVideoRecordingOutput, F_GETFL)));
-
    s_TimeStartRecording = 0;
    s_uRecordingFileSize = 0;
-   s_uRecordingStreamCurrentParsedToken = 0x11111111;
-   s_uRecordingStreamPrevParsedToken = 0x11111111;
-   s_bRecordingFoundStartOfFirstNAL = false;
+   s_iTempRecordingBufferFilledInBytes = 0;
+   s_bRecordingHasFrameIndex = false;
+   s_bRecordingLastWasEndOfFrame = false;
+   s_bRecordingInsideFrame = false;
+   s_bRecordingDroppingFrame = false;
+   s_bRecordingPendingDiscontinuity = false;
+   s_uRecordingDroppedPieces = 0;
+   s_bRecordingFoundStartOfFirstFrame = false;
+   s_iRecordingFrameSize = 0;
+   s_bRecordingFrameStarted = false;
+   s_bRecordingFrameDiscontinuity = false;
 
    fd_set fdSet;
-   u8 uRecBuffer[64000];
-   u32 uTimeLastVideoMemoryFreeCheck = get_current_timestamp_ms();
+   u8 uRecBuffer[2*sizeof(s_uTempRecordingBuffer)];
+   int iRecBufferPos = 0;
+   u32 uTimeLastFreeSpaceCheck = get_current_timestamp_ms();
    u32 uTimeLastInfoFileWrite = 0;
    bool bFirstWrite = true;
    s_bRecordingThreadReadyForData = true;
@@ -323,21 +410,21 @@ void* _thread_video_recording(void *argument)
    while ( (! g_bQuit) && (! s_bRequestedStopRecording) )
    {
       u32 uTimeNow = get_current_timestamp_ms();
-      if ( s_bIsRecordingToRAM )
+      if ( uTimeNow > uTimeLastFreeSpaceCheck + 4000 )
       {
-         if ( uTimeNow > uTimeLastVideoMemoryFreeCheck + 4000 )
+         uTimeLastFreeSpaceCheck = uTimeNow;
+         struct statvfs fsInfo;
+         if ( 0 == statvfs(s_bIsRecordingToRAM?FOLDER_TEMP_VIDEO_MEM:FOLDER_RUBY_TEMP, &fsInfo) )
          {
-            uTimeLastVideoMemoryFreeCheck = uTimeNow;
-            char szBuff[2048];
-            char szTemp[64];
-            sprintf(szComm, "df %s | sed -n 2p", FOLDER_TEMP_VIDEO_MEM);
-            hw_execute_bash_command_raw(szComm, szBuff);
-            long lu, lf, lt;
-            sscanf(szBuff, "%s %ld %ld %ld", szTemp, &lt, &lu, &lf);
-            log_line("[VideoRecording-Th] Free mem disk: %d kb", lf );
-            if ( lf/1000 < 20 )
+            u32 uFreeKb = (u32)(((uint64_t)fsInfo.f_bavail * (uint64_t)fsInfo.f_frsize)/1024);
+            if ( s_bIsRecordingToRAM )
+               log_line("[VideoRecording-Th] Free mem disk: %u kb", uFreeKb);
+            if ( uFreeKb/1000 < 20 )
             {
-               _recording_send_status_to_central(0xFF, 1, "Video recording RAM cache is full. Stopping recording...");
+               if ( s_bIsRecordingToRAM )
+                  _recording_send_status_to_central(0xFF, 1, "Video recording RAM cache is full. Stopping recording...");
+               else
+                  _recording_send_status_to_central(0xFF, 1, "Storage is full. Stopping recording...");
                s_bRecordingThreadReadyForData = false;
                break;
             }
@@ -352,6 +439,7 @@ void* _thread_video_recording(void *argument)
       }
 
       rx_video_recording_periodic_data_loop();
+      rx_video_mp4_periodic_loop(&s_RecordingMP4Writer, uTimeNow);
 
       FD_ZERO(&fdSet);
       FD_SET(s_iPipeRecordingThreadRead, &fdSet);
@@ -380,7 +468,7 @@ void* _thread_video_recording(void *argument)
          continue;
 
 
-      int iRead = read(s_iPipeRecordingThreadRead, uRecBuffer, sizeof(uRecBuffer)/sizeof(uRecBuffer[0]));
+      int iRead = read(s_iPipeRecordingThreadRead, uRecBuffer + iRecBufferPos, sizeof(uRecBuffer) - iRecBufferPos);
       if ( iRead < 0 )
       {
          log_line("[VideoRecording-Th] Read recording pipe failed. Exit recording thread.");
@@ -391,16 +479,51 @@ void* _thread_video_recording(void *argument)
          hardware_sleep_ms(10);
          continue;
       }
+      iRecBufferPos += iRead;
 
       if ( bFirstWrite )
          log_line("[VideoRecording-Th] Start receiving data to write to file (%d bytes). Start writing to recording file...", iRead);
       bFirstWrite = false;
-      int iRes = write(s_iFileVideoRecordingOutput, uRecBuffer, iRead);
-      if ( iRes == iRead )
-         continue;
 
-      // Error writing to recording file
-      log_softerror_and_alarm("[VideoRecording-Th] Recording thread failed to write %d bytes to recording file, result: %d , error: %d (%s)", iRead, iRes, errno, strerror(errno));
+      // Parse the complete pieces
+      bool bWriteFailed = false;
+      int iParsePos = 0;
+      while ( iRecBufferPos - iParsePos >= (int)sizeof(t_recording_piece_header) )
+      {
+         t_recording_piece_header header;
+         memcpy(&header, uRecBuffer + iParsePos, sizeof(t_recording_piece_header));
+         if ( (header.uMagic != RECORDING_PIECE_MAGIC) || (header.uLength > sizeof(s_uTempRecordingBuffer) - sizeof(t_recording_piece_header)) )
+         {
+            // Lost sync with the pieces; should not happen
+            if ( ! s_bRecordingFrameDiscontinuity )
+               log_softerror_and_alarm("[VideoRecording-Th] Invalid data in the recording pipe. Skip it.");
+            s_bRecordingFrameStarted = false;
+            s_bRecordingFrameDiscontinuity = true;
+            iParsePos++;
+            continue;
+         }
+         if ( iRecBufferPos - iParsePos < (int)(sizeof(t_recording_piece_header) + header.uLength) )
+            break;
+         if ( ! _recording_on_piece(&header, uRecBuffer + iParsePos + sizeof(t_recording_piece_header)) )
+         {
+            bWriteFailed = true;
+            break;
+         }
+         iParsePos += sizeof(t_recording_piece_header) + header.uLength;
+      }
+      if ( iParsePos > 0 )
+      {
+         if ( iParsePos < iRecBufferPos )
+            memmove(uRecBuffer, uRecBuffer + iParsePos, iRecBufferPos - iParsePos);
+         iRecBufferPos -= iParsePos;
+      }
+
+      if ( bWriteFailed )
+      {
+         _recording_send_status_to_central(0xFF, 2, "Recording error. Failed to write to recording file. Stopping recording...");
+         s_bRecordingThreadReadyForData = false;
+         break;
+      }
    }
    s_bRecordingThreadReadyForData = false;
    log_line("[VideoRecording-Th] Finishing recording...");
@@ -411,8 +534,12 @@ void* _thread_video_recording(void *argument)
    close( s_iPipeRecordingThreadRead );
    s_iPipeRecordingThreadRead = -1;
 
-   close(s_iFileVideoRecordingOutput);
-   s_iFileVideoRecordingOutput = -1;
+   if ( s_uRecordingDroppedPieces > 0 )
+      log_line("[VideoRecording-Th] Dropped %u video pieces as the recording was behind.", s_uRecordingDroppedPieces);
+   rx_video_mp4_close(&s_RecordingMP4Writer);
+   s_bRecordingMP4WriterOpen = false;
+   free(s_pRecordingFrameBuffer);
+   s_pRecordingFrameBuffer = NULL;
 
    rx_video_recording_data_stop_osd();
    rx_video_recording_data_stop_srt();
@@ -532,10 +659,8 @@ void rx_video_recording_init()
    s_bIsRecording = false;
    s_bRequestedStopRecording = false;
    s_uRecordingFileSize = 0;
-   s_iFileVideoRecordingOutput = -1;
-   s_uRecordingStreamCurrentParsedToken = 0x11111111;
-   s_uRecordingStreamPrevParsedToken = 0x11111111;
-   s_bRecordingFoundStartOfFirstNAL = false;
+   s_bRecordingMP4WriterOpen = false;
+   s_bRecordingFoundStartOfFirstFrame = false;
    s_bRecordingThreadReadyForData = false;
 
    char szComm[MAX_FILE_PATH_SIZE];
@@ -667,7 +792,8 @@ void rx_video_recording_start()
    log_line("[VideoRecording] Video recording FIFO write default size: %d bytes", fcntl(s_iPipeRecordingThreadWrite, F_GETPIPE_SZ));
 
    fcntl(s_iPipeRecordingThreadWrite, F_SETPIPE_SZ, 512000*4);
-   log_line("[VideoRecording] Video recording FIFO write new size: %d bytes", fcntl(s_iPipeRecordingThreadWrite, F_GETPIPE_SZ));
+   s_iRecordingPipeSize = fcntl(s_iPipeRecordingThreadWrite, F_GETPIPE_SZ);
+   log_line("[VideoRecording] Video recording FIFO write new size: %d bytes", s_iRecordingPipeSize);
 
    pthread_attr_t attr;
    ControllerSettings* pCS = get_ControllerSettings();
@@ -726,47 +852,111 @@ u32  rx_video_recording_get_last_start_stop_time()
    return s_uRecordingLastStartStopTime;
 }
 
-void rx_video_recording_on_new_data(u8* pData, int iLength)
+// Writes the current piece to the recording pipe, if it fits in the pipe; otherwise drops the rest of the current frame.
+// Never blocks: the piece is at most PIPE_BUF bytes, so the write is all or nothing.
+void _recording_send_piece(bool bIsEndOfFrame)
 {
-   if ( (! s_bIsRecording) || s_bRequestedStopRecording || (-1 == s_iFileVideoRecordingOutput) || (NULL == pData) || (iLength <= 0) || (s_iPipeRecordingThreadWrite <= 0) || (! s_bRecordingThreadReadyForData) )
+   if ( s_bRecordingDroppingFrame )
+   {
+      s_iTempRecordingBufferFilledInBytes = 0;
+      return;
+   }
+
+   t_recording_piece_header* pHeader = (t_recording_piece_header*)s_uTempRecordingBuffer;
+   pHeader->uMagic = RECORDING_PIECE_MAGIC;
+   pHeader->uLength = (u32)s_iTempRecordingBufferFilledInBytes;
+   pHeader->uFlags = s_uRecordingPieceFlags;
+   if ( bIsEndOfFrame )
+      pHeader->uFlags |= RECORDING_PIECE_FLAG_FRAME_END;
+   pHeader->uFrameIndex = s_uRecordingFrameIndex;
+   pHeader->uFrameDistanceMs = s_uRecordingFrameDistanceMs;
+   pHeader->uTimeMs = g_TimeNow;
+
+   int iLength = (int)sizeof(t_recording_piece_header) + s_iTempRecordingBufferFilledInBytes;
+   s_iTempRecordingBufferFilledInBytes = 0;
+   s_uRecordingPieceFlags = 0;
+
+   int iRes = write(s_iPipeRecordingThreadWrite, s_uTempRecordingBuffer, iLength);
+   if ( (iRes < 0) && (errno == EINTR) )
+      iRes = write(s_iPipeRecordingThreadWrite, s_uTempRecordingBuffer, iLength);
+   if ( iRes == iLength )
       return;
 
-   while ( ! s_bRecordingFoundStartOfFirstNAL )
+   s_bRecordingDroppingFrame = true;
+   s_bRecordingPendingDiscontinuity = true;
+   if ( (iRes < 0) && (errno == EAGAIN) )
    {
-      s_uRecordingStreamPrevParsedToken = (s_uRecordingStreamPrevParsedToken << 8) | (s_uRecordingStreamCurrentParsedToken & 0xFF);
-      s_uRecordingStreamCurrentParsedToken = (s_uRecordingStreamCurrentParsedToken << 8) | (*pData);
-      pData++;
-      iLength--;
-      if ( s_uRecordingStreamCurrentParsedToken == 0x00000001 )
-      {
-         log_line("[VideoRecording] Found start of first NAL at position %u (bytes) in recording stream.", s_uRecordingFileSize);
-         s_bRecordingFoundStartOfFirstNAL = true;
-         s_TimeStartRecording = get_current_timestamp_ms();
-         s_uRecordingFileSize = 4;
-         u8 uHeader[5];
-         uHeader[0] = 0; uHeader[1] = 0; uHeader[2] = 0; uHeader[3] = 0x01;
-         int iRes = write(s_iPipeRecordingThreadWrite, uHeader, 4);
-         if ( iRes != 4 )
-            log_softerror_and_alarm("[VideoRecording] Failed to write initial NAL header to recording file (%s), result: %d, error: %d (%s)", s_szFileRecordingOutput, iRes, errno, strerror(errno));
-         break;
-      }
+      // Recording thread is behind
+      s_uRecordingDroppedPieces++;
+      return;
    }
-   if ( iLength <= 0 )
+   log_softerror_and_alarm("[VideoRecording] Failed to write to recorder pipe %d bytes. Ret code: %d, Error code: %d, err string: (%s)",
+      iLength, iRes, errno, strerror(errno));
+}
+
+void rx_video_recording_on_new_data(t_packet_header_video_segment* pPHVS, u8* pData, int iLength)
+{
+   if ( (! s_bIsRecording) || s_bRequestedStopRecording || (! s_bRecordingMP4WriterOpen) || (NULL == pPHVS) || (NULL == pData) || (iLength <= 0) || (s_iPipeRecordingThreadWrite <= 0) || (! s_bRecordingThreadReadyForData) )
       return;
 
-   s_uRecordingFileSize += iLength;
+   bool bIsEndOfFrame = (pPHVS->uVideoStatusFlags2 & VIDEO_STATUS_FLAGS2_IS_END_OF_FRAME)?true:false;
+   bool bIsNewFrame = s_bRecordingHasFrameIndex && (s_bRecordingLastWasEndOfFrame || (pPHVS->uH264FrameIndex != s_uRecordingFrameIndex));
+   s_bRecordingHasFrameIndex = true;
+   s_bRecordingLastWasEndOfFrame = bIsEndOfFrame;
+
+   if ( ! s_bRecordingFoundStartOfFirstFrame )
+   {
+      // Start recording from the start of a video frame
+      s_uRecordingFrameIndex = pPHVS->uH264FrameIndex;
+      if ( ! bIsNewFrame )
+         return;
+      log_line("[VideoRecording] Found start of first video frame (frame index %u) in recording stream.", pPHVS->uH264FrameIndex);
+      s_bRecordingFoundStartOfFirstFrame = true;
+      s_TimeStartRecording = get_current_timestamp_ms();
+      s_uRecordingFileSize = 0;
+   }
 
-   if ( s_iTempRecordingBufferFilledInBytes + iLength > (int)sizeof(s_uTempRecordingBuffer)/(int)sizeof(s_uTempRecordingBuffer[0]) )
+   if ( bIsNewFrame )
    {
-      int iRes = write(s_iPipeRecordingThreadWrite, s_uTempRecordingBuffer, s_iTempRecordingBufferFilledInBytes);
-      if ( iRes != s_iTempRecordingBufferFilledInBytes )
-         log_softerror_and_alarm("[VideoRecording] Failed to write to recorder pipe %d bytes. Ret code: %d, Error code: %d, err string: (%s)",
-            s_iTempRecordingBufferFilledInBytes, iRes, errno, strerror(errno));
+      // End of the previous frame was lost
+      if ( s_bRecordingInsideFrame )
+         _recording_send_piece(true);
+
+      s_bRecordingInsideFrame = true;
+      s_bRecordingDroppingFrame = false;
       s_iTempRecordingBufferFilledInBytes = 0;
+      s_uRecordingPieceFlags = RECORDING_PIECE_FLAG_FRAME_START;
+      if ( s_bRecordingPendingDiscontinuity )
+         s_uRecordingPieceFlags |= RECORDING_PIECE_FLAG_DISCONTINUITY;
+      s_bRecordingPendingDiscontinuity = false;
+      s_uRecordingFrameIndex = pPHVS->uH264FrameIndex;
+      s_uRecordingFrameDistanceMs = pPHVS->uRuntimeMetrics & 0xFF;
    }
+   if ( ! s_bRecordingInsideFrame )
+      return;
 
-   memcpy(&(s_uTempRecordingBuffer[s_iTempRecordingBufferFilledInBytes]), pData, iLength);
-   s_iTempRecordingBufferFilledInBytes += iLength;
+   s_uRecordingFileSize += iLength;
+
+   const int iMaxPieceData = (int)sizeof(s_uTempRecordingBuffer) - (int)sizeof(t_recording_piece_header);
+   while ( iLength > 0 )
+   {
+      if ( s_iTempRecordingBufferFilledInBytes >= iMaxPieceData )
+         _recording_send_piece(false);
+      int iCopy = iMaxPieceData - s_iTempRecordingBufferFilledInBytes;
+      if ( iCopy > iLength )
+         iCopy = iLength;
+      if ( ! s_bRecordingDroppingFrame )
+         memcpy(&(s_uTempRecordingBuffer[sizeof(t_recording_piece_header) + s_iTempRecordingBufferFilledInBytes]), pData, iCopy);
+      s_iTempRecordingBufferFilledInBytes += iCopy;
+      pData += iCopy;
+      iLength -= iCopy;
+   }
+
+   if ( bIsEndOfFrame )
+   {
+      _recording_send_piece(true);
+      s_bRecordingInsideFrame = false;
+   }
 }
 
 void rx_video_recording_periodic_loop()
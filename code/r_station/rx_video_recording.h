@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../base/base.h"
+#include "../radio/radiopackets2.h"
 
 void rx_video_recording_init();
 void rx_video_recording_uninit();
@@ -10,7 +11,8 @@ bool rx_video_recording_stop();
 bool rx_video_is_recording();
 u32  rx_video_recording_get_last_start_stop_time();
 
-void rx_video_recording_on_new_data(u8* pData, int iLength);
+// Video data as output by the video processor; the frame boundaries and timing come from the video packet header
+void rx_video_recording_on_new_data(t_packet_header_video_segment* pPHVS, u8* pData, int iLength);
 
 void rx_video_recording_periodic_loop();
 
@@ -0,0 +1,928 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/flags_video.h"
+#include "rx_video_recording_mp4.h"
+
+#define MP4_MAX_BOX_DEPTH 12
+#define MP4_TRACK_ID 1
+
+#define MP4_SAMPLE_FLAGS_SYNC 0x02000000
+#define MP4_SAMPLE_FLAGS_NON_SYNC 0x01010000
+
+typedef struct
+{
+   u8* pBuffer;
+   int iSize;
+   int iPos;
+   int iBoxStart[MP4_MAX_BOX_DEPTH];
+   int iDepth;
+   bool bOverflow;
+} t_mp4_box_writer;
+
+static void _mp4_bw_init(t_mp4_box_writer* pBW, u8* pBuffer, int iSize)
+{
+   pBW->pBuffer = pBuffer;
+   pBW->iSize = iSize;
+   pBW->iPos = 0;
+   pBW->iDepth = 0;
+   pBW->bOverflow = false;
+}
+
+static void _mp4_bw_bytes(t_mp4_box_writer* pBW, const u8* pData, int iLength)
+{
+   if ( pBW->iPos + iLength > pBW->iSize )
+   {
+      pBW->bOverflow = true;
+      return;
+   }
+   if ( NULL == pData )
+      memset(pBW->pBuffer + pBW->iPos, 0, iLength);
+   else
+      memcpy(pBW->pBuffer + pBW->iPos, pData, iLength);
+   pBW->iPos += iLength;
+}
+
+static void _mp4_bw_u8(t_mp4_box_writer* pBW, u8 uValue)
+{
+   _mp4_bw_bytes(pBW, &uValue, 1);
+}
+
+static void _mp4_bw_u16(t_mp4_box_writer* pBW, u16 uValue)
+{
+   u8 uTmp[2] = { (u8)(uValue >> 8), (u8)uValue };
+   _mp4_bw_bytes(pBW, uTmp, 2);
+}
+
+static void _mp4_bw_u32(t_mp4_box_writer* pBW, u32 uValue)
+{
+   u8 uTmp[4] = { (u8)(uValue >> 24), (u8)(uValue >> 16), (u8)(uValue >> 8), (u8)uValue };
+   _mp4_bw_bytes(pBW, uTmp, 4);
+}
+
+static void _mp4_bw_u64(t_mp4_box_writer* pBW, uint64_t uValue)
+{
+   _mp4_bw_u32(pBW, (u32)(uValue >> 32));
+   _mp4_bw_u32(pBW, (u32)(uValue & 0xFFFFFFFF));
+}
+
+static void _mp4_bw_begin_box(t_mp4_box_writer* pBW, const char* szType)
+{
+   if ( pBW->iDepth >= MP4_MAX_BOX_DEPTH )
+   {
+      pBW->bOverflow = true;
+      return;
+   }
+   pBW->iBoxStart[pBW->iDepth++] = pBW->iPos;
+   _mp4_bw_u32(pBW, 0);
+   _mp4_bw_bytes(pBW, (const u8*)szType, 4);
+}
+
+static void _mp4_bw_begin_full_box(t_mp4_box_writer* pBW, const char* szType, u8 uVersion, u32 uFlags)
+{
+   _mp4_bw_begin_box(pBW, szType);
+   _mp4_bw_u32(pBW, (((u32)uVersion) << 24) | (uFlags & 0xFFFFFF));
+}
+
+static void _mp4_bw_end_box(t_mp4_box_writer* pBW)
+{
+   if ( (pBW->iDepth <= 0) || pBW->bOverflow )
+      return;
+   int iStart = pBW->iBoxStart[--pBW->iDepth];
+   u32 uSize = (u32)(pBW->iPos - iStart);
+   pBW->pBuffer[iStart] = (u8)(uSize >> 24);
+   pBW->pBuffer[iStart+1] = (u8)(uSize >> 16);
+   pBW->pBuffer[iStart+2] = (u8)(uSize >> 8);
+   pBW->pBuffer[iStart+3] = (u8)uSize;
+}
+
+static void _mp4_bw_matrix(t_mp4_box_writer* pBW)
+{
+   static const u32 s_uMatrix[9] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+   for( int i=0; i<9; i++ )
+      _mp4_bw_u32(pBW, s_uMatrix[i]);
+}
+
+// Finds the next NAL unit in an Annex-B buffer, starting at *piPos. Returns false if there are no more NALs.
+static bool _mp4_next_nal(u8* pData, int iLength, int* piPos, u8** ppNAL, int* piNALSize)
+{
+   int iPos = *piPos;
+   while ( iPos + 3 <= iLength )
+   {
+      if ( (pData[iPos] == 0) && (pData[iPos+1] == 0) && (pData[iPos+2] == 1) )
+         break;
+      iPos++;
+   }
+   if ( iPos + 3 > iLength )
+   {
+      *piPos = iLength;
+      return false;
+   }
+   iPos += 3;
+   int iStart = iPos;
+   while ( iPos + 3 <= iLength )
+   {
+      if ( (pData[iPos] == 0) && (pData[iPos+1] == 0) && (pData[iPos+2] == 1) )
+         break;
+      iPos++;
+   }
+   if ( iPos + 3 > iLength )
+      iPos = iLength;
+   *piPos = iPos;
+
+   // Trailing zeros belong to the next start code (or are padding)
+   int iEnd = iPos;
+   while ( (iEnd > iStart) && (pData[iEnd-1] == 0) )
+      iEnd--;
+   *ppNAL = pData + iStart;
+   *piNALSize = iEnd - iStart;
+   return true;
+}
+
+static u32 _mp4_get_nal_type(t_mp4_writer* pWriter, u8* pNAL)
+{
+   if ( pWriter->uVideoStreamType == VIDEO_TYPE_H265 )
+      return (pNAL[0] >> 1) & 0x3F;
+   return pNAL[0] & 0x1F;
+}
+
+static bool _mp4_is_keyframe_nal(t_mp4_writer* pWriter, u32 uNALType)
+{
+   if ( pWriter->uVideoStreamType == VIDEO_TYPE_H265 )
+      return (uNALType >= 16) && (uNALType <= 23);
+   return (uNALType == 5);
+}
+
+static void _mp4_store_param_set(u8* pDest, int* piDestSize, u8* pNAL, int iNALSize)
+{
+   if ( (iNALSize <= 0) || (iNALSize > MP4_MAX_PARAM_SET_SIZE) )
+      return;
+   memcpy(pDest, pNAL, iNALSize);
+   *piDestSize = iNALSize;
+}
+
+static void _mp4_write_avcc(t_mp4_writer* pWriter, t_mp4_box_writer* pBW)
+{
+   _mp4_bw_begin_box(pBW, "avcC");
+   _mp4_bw_u8(pBW, 1);
+   _mp4_bw_u8(pBW, pWriter->uSPS[1]); // profile
+   _mp4_bw_u8(pBW, pWriter->uSPS[2]); // profile compatibility
+   _mp4_bw_u8(pBW, pWriter->uSPS[3]); // level
+   _mp4_bw_u8(pBW, 0xFF); // 4 bytes NAL lengths
+   _mp4_bw_u8(pBW, 0xE1);
+   _mp4_bw_u16(pBW, (u16)pWriter->iSPSSize);
+   _mp4_bw_bytes(pBW, pWriter->uSPS, pWriter->iSPSSize);
+   _mp4_bw_u8(pBW, 1);
+   _mp4_bw_u16(pBW, (u16)pWriter->iPPSSize);
+   _mp4_bw_bytes(pBW, pWriter->uPPS, pWriter->iPPSSize);
+   _mp4_bw_end_box(pBW);
+}
+
+static void _mp4_write_hvcc(t_mp4_writer* pWriter, t_mp4_box_writer* pBW)
+{
+   // profile_tier_level() from the SPS: NAL header (2 bytes), 1 byte of ids, then 12 bytes
+   u8 uPTL[12];
+   memset(uPTL, 0, sizeof(uPTL));
+   int iZeros = 0;
+   int iOut = 0;
+   for( int i=3; (i<pWriter->iSPSSize) && (iOut < 12); i++ )
+   {
+      if ( (iZeros >= 2) && (pWriter->uSPS[i] == 3) )
+      {
+         iZeros = 0;
+         continue;
+      }
+      iZeros = (pWriter->uSPS[i] == 0)?(iZeros+1):0;
+      uPTL[iOut++] = pWriter->uSPS[i];
+   }
+
+   _mp4_bw_begin_box(pBW, "hvcC");
+   _mp4_bw_u8(pBW, 1);
+   _mp4_bw_bytes(pBW, uPTL, 12); // profile space/tier/idc, compatibility flags, constraint flags, level
+   _mp4_bw_u16(pBW, 0xF000); // min spatial segmentation
+   _mp4_bw_u8(pBW, 0xFC); // parallelism type
+   _mp4_bw_u8(pBW, 0xFD); // chroma format 4:2:0
+   _mp4_bw_u8(pBW, 0xF8); // luma bit depth 8
+   _mp4_bw_u8(pBW, 0xF8); // chroma bit depth 8
+   _mp4_bw_u16(pBW, 0); // average frame rate
+   _mp4_bw_u8(pBW, 0x0F); // 1 temporal layer, temporal id nested, 4 bytes NAL lengths
+   _mp4_bw_u8(pBW, 3);
+
+   u8* pSets[3] = { pWriter->uVPS, pWriter->uSPS, pWriter->uPPS };
+   int iSizes[3] = { pWriter->iVPSSize, pWriter->iSPSSize, pWriter->iPPSSize };
+   u8 uTypes[3] = { 32, 33, 34 };
+   for( int i=0; i<3; i++ )
+   {
+      _mp4_bw_u8(pBW, 0x80 | uTypes[i]);
+      _mp4_bw_u16(pBW, 1);
+      _mp4_bw_u16(pBW, (u16)iSizes[i]);
+      _mp4_bw_bytes(pBW, pSets[i], iSizes[i]);
+   }
+   _mp4_bw_end_box(pBW);
+}
+
+static void _mp4_preallocate(t_mp4_writer* pWriter, uint64_t uEndOffset)
+{
+   if ( pWriter->bPreallocateFailed || (uEndOffset <= pWriter->uFileAllocated) )
+      return;
+   uint64_t uNewAllocated = pWriter->uFileAllocated;
+   while ( uNewAllocated < uEndOffset )
+      uNewAllocated += MP4_PREALLOCATE_STEP;
+
+   // Keep the file size as written: a file cut by a power loss has no zeros at the end
+   if ( 0 != fallocate(pWriter->iFd, FALLOC_FL_KEEP_SIZE, (off_t)pWriter->uFileAllocated, (off_t)(uNewAllocated - pWriter->uFileAllocated)) )
+   {
+      log_line("[VideoRecordingMP4] Can't preallocate recording file space (error %d: %s), continue without preallocation.", errno, strerror(errno));
+      pWriter->bPreallocateFailed = true;
+      return;
+   }
+   pWriter->uFileAllocated = uNewAllocated;
+}
+
+// Writes the buffered data: only whole blocks (so that the file writes stay block aligned) or all of it
+static bool _mp4_write_buffer(t_mp4_writer* pWriter, bool bAll)
+{
+   int iToWrite = pWriter->iWriteBufferPos;
+   if ( ! bAll )
+   {
+      uint64_t uEnd = ((pWriter->uFileOffset + (uint64_t)pWriter->iWriteBufferPos) / MP4_WRITE_BLOCK_SIZE) * MP4_WRITE_BLOCK_SIZE;
+      if ( uEnd <= pWriter->uFileOffset )
+         return true;
+      iToWrite = (int)(uEnd - pWriter->uFileOffset);
+   }
+   if ( iToWrite <= 0 )
+      return true;
+
+   _mp4_preallocate(pWriter, pWriter->uFileOffset + (uint64_t)iToWrite);
+
+   int iWritten = 0;
+   while ( iWritten < iToWrite )
+   {
+      int iRes = write(pWriter->iFd, pWriter->pWriteBuffer + iWritten, iToWrite - iWritten);
+      if ( (iRes < 0) && (errno == EINTR) )
+         continue;
+      if ( iRes <= 0 )
+      {
+         log_softerror_and_alarm("[VideoRecordingMP4] Failed to write %d bytes to recording file, error: %d (%s)", iToWrite - iWritten, errno, strerror(errno));
+         return false;
+      }
+      iWritten += iRes;
+   }
+
+   if ( iToWrite < pWriter->iWriteBufferPos )
+      memmove(pWriter->pWriteBuffer, pWriter->pWriteBuffer + iToWrite, pWriter->iWriteBufferPos - iToWrite);
+   pWriter->iWriteBufferPos -= iToWrite;
+   pWriter->uFileOffset += (uint64_t)iToWrite;
+   pWriter->uTimeLastWrite = get_current_timestamp_ms();
+   pWriter->uStatsWrites++;
+   return true;
+}
+
+static bool _mp4_append(t_mp4_writer* pWriter, const u8* pData, int iLength)
+{
+   while ( iLength > 0 )
+   {
+      if ( pWriter->iWriteBufferPos >= MP4_WRITE_BUFFER_SIZE )
+      {
+         if ( ! _mp4_write_buffer(pWriter, false) )
+            return false;
+      }
+
+      int iCopy = MP4_WRITE_BUFFER_SIZE - pWriter->iWriteBufferPos;
+      if ( iCopy > iLength )
+         iCopy = iLength;
+      memcpy(pWriter->pWriteBuffer + pWriter->iWriteBufferPos, pData, iCopy);
+      pWriter->iWriteBufferPos += iCopy;
+      pData += iCopy;
+      iLength -= iCopy;
+   }
+   if ( pWriter->iWriteBufferPos >= MP4_WRITE_BLOCK_SIZE )
+      return _mp4_write_buffer(pWriter, false);
+   return true;
+}
+
+static bool _mp4_write_init_segment(t_mp4_writer* pWriter)
+{
+   u8 uBuffer[2048];
+   t_mp4_box_writer bw;
+   _mp4_bw_init(&bw, uBuffer, sizeof(uBuffer));
+   bool bH265 = (pWriter->uVideoStreamType == VIDEO_TYPE_H265);
+
+   _mp4_bw_begin_box(&bw, "ftyp");
+   _mp4_bw_bytes(&bw, (const u8*)"isom", 4);
+   _mp4_bw_u32(&bw, 0x200);
+   _mp4_bw_bytes(&bw, (const u8*)"isom", 4);
+   _mp4_bw_bytes(&bw, (const u8*)"iso6", 4);
+   _mp4_bw_bytes(&bw, (const u8*)(bH265?"hvc1":"avc1"), 4);
+   _mp4_bw_bytes(&bw, (const u8*)"mp41", 4);
+   _mp4_bw_end_box(&bw);
+
+   _mp4_bw_begin_box(&bw, "moov");
+
+   _mp4_bw_begin_full_box(&bw, "mvhd", 0, 0);
+   _mp4_bw_u32(&bw, 0); // creation time
+   _mp4_bw_u32(&bw, 0); // modification time
+   _mp4_bw_u32(&bw, 1000); // timescale
+   _mp4_bw_u32(&bw, 0); // duration: unknown, in fragments
+   _mp4_bw_u32(&bw, 0x00010000); // rate
+   _mp4_bw_u16(&bw, 0x0100); // volume
+   _mp4_bw_bytes(&bw, NULL, 10);
+   _mp4_bw_matrix(&bw);
+   _mp4_bw_bytes(&bw, NULL, 24);
+   _mp4_bw_u32(&bw, MP4_TRACK_ID + 1); // next track id
+   _mp4_bw_end_box(&bw);
+
+   _mp4_bw_begin_box(&bw, "trak");
+   _mp4_bw_begin_full_box(&bw, "tkhd", 0, 0x03); // enabled, in movie
+   _mp4_bw_u32(&bw, 0);
+   _mp4_bw_u32(&bw, 0);
+   _mp4_bw_u32(&bw, MP4_TRACK_ID);
+   _mp4_bw_u32(&bw, 0);
+   _mp4_bw_u32(&bw, 0); // duration
+   _mp4_bw_bytes(&bw, NULL, 8);
+   _mp4_bw_u16(&bw, 0); // layer
+   _mp4_bw_u16(&bw, 0); // alternate group
+   _mp4_bw_u16(&bw, 0); // volume
+   _mp4_bw_u16(&bw, 0);
+   _mp4_bw_matrix(&bw);
+   _mp4_bw_u32(&bw, ((u32)pWriter->iWidth) << 16);
+   _mp4_bw_u32(&bw, ((u32)pWriter->iHeight) << 16);
+   _mp4_bw_end_box(&bw);
+
+   _mp4_bw_begin_box(&bw, "mdia");
+   _mp4_bw_begin_full_box(&bw, "mdhd", 0, 0);
+   _mp4_bw_u32(&bw, 0);
+   _mp4_bw_u32(&bw, 0);
+   _mp4_bw_u32(&bw, MP4_TIMESCALE);
+   _mp4_bw_u32(&bw, 0);
+   _mp4_bw_u16(&bw, 0x55C4); // "und"
+   _mp4_bw_u16(&bw, 0);
+   _mp4_bw_end_box(&bw);
+
+   _mp4_bw_begin_full_box(&bw, "hdlr", 0, 0);
+   _mp4_bw_u32(&bw, 0);
+   _mp4_bw_bytes(&bw, (const u8*)"vide", 4);
+   _mp4_bw_bytes(&bw, NULL, 12);
+   _mp4_bw_bytes(&bw, (const u8*)"VideoHandler", 13);
+   _mp4_bw_end_box(&bw);
+
+   _mp4_bw_begin_box(&bw, "minf");
+   _mp4_bw_begin_full_box(&bw, "vmhd", 0, 0x01);
+   _mp4_bw_bytes(&bw, NULL, 8);
+   _mp4_bw_end_box(&bw);
+
+   _mp4_bw_begin_box(&bw, "dinf");
+   _mp4_bw_begin_full_box(&bw, "dref", 0, 0);
+   _mp4_bw_u32(&bw, 1);
+   _mp4_bw_begin_full_box(&bw, "url ", 0, 0x01); // data in this file
+   _mp4_bw_end_box(&bw);
+   _mp4_bw_end_box(&bw);
+   _mp4_bw_end_box(&bw);
+
+   _mp4_bw_begin_box(&bw, "stbl");
+   _mp4_bw_begin_full_box(&bw, "stsd", 0, 0);
+   _mp4_bw_u32(&bw, 1);
+   _mp4_bw_begin_box(&bw, bH265?"hvc1":"avc1");
+   _mp4_bw_bytes(&bw, NULL, 6);
+   _mp4_bw_u16(&bw, 1); // data reference index
+   _mp4_bw_bytes(&bw, NULL, 16);
+   _mp4_bw_u16(&bw, (u16)pWriter->iWidth);
+   _mp4_bw_u16(&bw, (u16)pWriter->iHeight);
+   _mp4_bw_u32(&bw, 0x00480000); // 72 dpi
+   _mp4_bw_u32(&bw, 0x00480000);
+   _mp4_bw_u32(&bw, 0);
+   _mp4_bw_u16(&bw, 1); // frames per sample
+   _mp4_bw_bytes(&bw, NULL, 32); // compressor name
+   _mp4_bw_u16(&bw, 0x0018); // depth
+   _mp4_bw_u16(&bw, 0xFFFF);
+   if ( bH265 )
+      _mp4_write_hvcc(pWriter, &bw);
+   else
+      _mp4_write_avcc(pWriter, &bw);
+   _mp4_bw_end_box(&bw);
+   _mp4_bw_end_box(&bw);
+
+   // Empty sample tables, the samples are in the fragments
+   _mp4_bw_begin_full_box(&bw, "stts", 0, 0);
+   _mp4_bw_u32(&bw, 0);
+   _mp4_bw_end_box(&bw);
+   _mp4_bw_begin_full_box(&bw, "stsc", 0, 0);
+   _mp4_bw_u32(&bw, 0);
+   _mp4_bw_end_box(&bw);
+   _mp4_bw_begin_full_box(&bw, "stsz", 0, 0);
+   _mp4_bw_u32(&bw, 0);
+   _mp4_bw_u32(&bw, 0);
+   _mp4_bw_end_box(&bw);
+   _mp4_bw_begin_full_box(&bw, "stco", 0, 0);
+   _mp4_bw_u32(&bw, 0);
+   _mp4_bw_end_box(&bw);
+   _mp4_bw_end_box(&bw); // stbl
+   _mp4_bw_end_box(&bw); // minf
+   _mp4_bw_end_box(&bw); // mdia
+   _mp4_bw_end_box(&bw); // trak
+
+   _mp4_bw_begin_box(&bw, "mvex");
+   _mp4_bw_begin_full_box(&bw, "trex", 0, 0);
+   _mp4_bw_u32(&bw, MP4_TRACK_ID);
+   _mp4_bw_u32(&bw, 1); // sample description index
+   _mp4_bw_u32(&bw, 0);
+   _mp4_bw_u32(&bw, 0);
+   _mp4_bw_u32(&bw, 0);
+   _mp4_bw_end_box(&bw);
+   _mp4_bw_end_box(&bw);
+
+   _mp4_bw_end_box(&bw); // moov
+
+   if ( bw.bOverflow )
+   {
+      log_softerror_and_alarm("[VideoRecordingMP4] Init segment does not fit the buffer.");
+      return false;
+   }
+   if ( ! _mp4_append(pWriter, uBuffer, bw.iPos) )
+      return false;
+
+   pWriter->bInitSegmentWritten = true;
+   log_line("[VideoRecordingMP4] Wrote init segment (%d bytes): %s %dx%d, SPS: %d bytes, PPS: %d bytes, VPS: %d bytes",
+      bw.iPos, bH265?"H265":"H264", pWriter->iWidth, pWriter->iHeight, pWriter->iSPSSize, pWriter->iPPSSize, pWriter->iVPSSize);
+   return true;
+}
+
+static u32 _mp4_get_frame_duration(t_mp4_writer* pWriter)
+{
+   if ( pWriter->iFPS > 0 )
+      return MP4_TIMESCALE / (u32)pWriter->iFPS;
+   return MP4_TIMESCALE / 30;
+}
+
+static bool _mp4_write_fragment(t_mp4_writer* pWriter, uint64_t uEndDecodeTime)
+{
+   if ( pWriter->iFragmentFrames <= 0 )
+      return true;
+
+   u8 uBuffer[256 + MP4_FRAGMENT_MAX_FRAMES * 12];
+   t_mp4_box_writer bw;
+   _mp4_bw_init(&bw, uBuffer, sizeof(uBuffer));
+
+   pWriter->uFragmentSequence++;
+   _mp4_bw_begin_box(&bw, "moof");
+   _mp4_bw_begin_full_box(&bw, "mfhd", 0, 0);
+   _mp4_bw_u32(&bw, pWriter->uFragmentSequence);
+   _mp4_bw_end_box(&bw);
+
+   _mp4_bw_begin_box(&bw, "traf");
+   _mp4_bw_begin_full_box(&bw, "tfhd", 0, 0x020000); // default base is moof
+   _mp4_bw_u32(&bw, MP4_TRACK_ID);
+   _mp4_bw_end_box(&bw);
+
+   _mp4_bw_begin_full_box(&bw, "tfdt", 1, 0);
+   _mp4_bw_u64(&bw, pWriter->uFragmentDecodeTimes[0]);
+   _mp4_bw_end_box(&bw);
+
+   _mp4_bw_begin_full_box(&bw, "trun", 0, 0x000701); // data offset, samples durations, sizes and flags
+   _mp4_bw_u32(&bw, (u32)pWriter->iFragmentFrames);
+   int iDataOffsetPos = bw.iPos;
+   _mp4_bw_u32(&bw, 0);
+   for( int i=0; i<pWriter->iFragmentFrames; i++ )
+   {
+      uint64_t uNext = (i < pWriter->iFragmentFrames-1)?pWriter->uFragmentDecodeTimes[i+1]:uEndDecodeTime;
+      uint64_t uDuration = (uNext > pWriter->uFragmentDecodeTimes[i])?(uNext - pWriter->uFragmentDecodeTimes[i]):1;
+      if ( uDuration > 0xFFFFFFFF )
+         uDuration = _mp4_get_frame_duration(pWriter);
+      _mp4_bw_u32(&bw, (u32)uDuration);
+      _mp4_bw_u32(&bw, pWriter->uFragmentFramesSizes[i]);
+      _mp4_bw_u32(&bw, pWriter->bFragmentFramesKey[i]?MP4_SAMPLE_FLAGS_SYNC:MP4_SAMPLE_FLAGS_NON_SYNC);
+   }
+   _mp4_bw_end_box(&bw); // trun
+   _mp4_bw_end_box(&bw); // traf
+   _mp4_bw_end_box(&bw); // moof
+
+   int iMoofSize = bw.iPos;
+   _mp4_bw_u32(&bw, (u32)(8 + pWriter->iFragmentDataSize));
+   _mp4_bw_bytes(&bw, (const u8*)"mdat", 4);
+   if ( bw.bOverflow )
+      return false;
+
+   u32 uDataOffset = (u32)(iMoofSize + 8);
+   uBuffer[iDataOffsetPos] = (u8)(uDataOffset >> 24);
+   uBuffer[iDataOffsetPos+1] = (u8)(uDataOffset >> 16);
+   uBuffer[iDataOffsetPos+2] = (u8)(uDataOffset >> 8);
+   uBuffer[iDataOffsetPos+3] = (u8)uDataOffset;
+
+   bool bOk = _mp4_append(pWriter, uBuffer, bw.iPos);
+   if ( bOk )
+      bOk = _mp4_append(pWriter, pWriter->pFragmentData, pWriter->iFragmentDataSize);
+
+   pWriter->uMinDecodeTime = uEndDecodeTime;
+   pWriter->iFragmentFrames = 0;
+   pWriter->iFragmentDataSize = 0;
+   pWriter->uStatsFragments++;
+   return bOk;
+}
+
+bool rx_video_mp4_open(t_mp4_writer* pWriter, const char* szFile, u8 uVideoStreamType, int iWidth, int iHeight, int iFPS)
+{
+   if ( (NULL == pWriter) || (NULL == szFile) )
+      return false;
+   memset(pWriter, 0, sizeof(t_mp4_writer));
+   pWriter->iFd = -1;
+   pWriter->uVideoStreamType = uVideoStreamType;
+   pWriter->iWidth = iWidth;
+   pWriter->iHeight = iHeight;
+   pWriter->iFPS = iFPS;
+   pWriter->bWaitKeyframe = true;
+
+   pWriter->pFragmentData = (u8*)malloc(MP4_FRAGMENT_MAX_SIZE);
+   if ( 0 != posix_memalign((void**)&pWriter->pWriteBuffer, 4096, MP4_WRITE_BUFFER_SIZE) )
+      pWriter->pWriteBuffer = NULL;
+   if ( (NULL == pWriter->pFragmentData) || (NULL == pWriter->pWriteBuffer) )
+   {
+      log_softerror_and_alarm("[VideoRecordingMP4] Failed to allocate buffers.");
+      rx_video_mp4_close(pWriter);
+      return false;
+   }
+
+   pWriter->iFd = open(szFile, O_CREAT | O_WRONLY | O_TRUNC, 0666);
+   if ( -1 == pWriter->iFd )
+   {
+      log_softerror_and_alarm("[VideoRecordingMP4] Failed to create recording file [%s], error: %d (%s)", szFile, errno, strerror(errno));
+      rx_video_mp4_close(pWriter);
+      return false;
+   }
+   pWriter->uTimeLastWrite = get_current_timestamp_ms();
+   pWriter->uTimeLastSync = pWriter->uTimeLastWrite;
+   log_line("[VideoRecordingMP4] Opened recording file [%s], %s %dx%d@%d", szFile, (uVideoStreamType == VIDEO_TYPE_H265)?"H265":"H264", iWidth, iHeight, iFPS);
+   return true;
+}
+
+void rx_video_mp4_close(t_mp4_writer* pWriter)
+{
+   if ( NULL == pWriter )
+      return;
+
+   if ( -1 != pWriter->iFd )
+   {
+      _mp4_write_fragment(pWriter, pWriter->uLastDecodeTime + _mp4_get_frame_duration(pWriter));
+      _mp4_write_buffer(pWriter, true);
+      // Releases the preallocated blocks past the end of the file
+      if ( pWriter->uFileAllocated > pWriter->uFileOffset )
+      {
+         if ( 0 != ftruncate(pWriter->iFd, (off_t)pWriter->uFileOffset) )
+            log_softerror_and_alarm("[VideoRecordingMP4] Failed to release the unused preallocated space, error: %d (%s)", errno, strerror(errno));
+      }
+      fdatasync(pWriter->iFd);
+      close(pWriter->iFd);
+      log_line("[VideoRecordingMP4] Closed recording file: %llu bytes, %u frames (%u skipped), %u fragments, %u writes.",
+         (unsigned long long)pWriter->uFileOffset, pWriter->uStatsFrames, pWriter->uStatsSkippedFrames, pWriter->uStatsFragments, pWriter->uStatsWrites);
+   }
+   pWriter->iFd = -1;
+
+   if ( NULL != pWriter->pFragmentData )
+      free(pWriter->pFragmentData);
+   pWriter->pFragmentData = NULL;
+   if ( NULL != pWriter->pWriteBuffer )
+      free(pWriter->pWriteBuffer);
+   pWriter->pWriteBuffer = NULL;
+}
+
+bool rx_video_mp4_add_frame(t_mp4_writer* pWriter, u8* pFrame, int iLength, u16 uFrameIndex, u32 uFrameDistanceMs, u32 uTimeNow, bool bDiscontinuity)
+{
+   if ( (NULL == pWriter) || (-1 == pWriter->iFd) || (NULL == pFrame) || (iLength <= 0) )
+      return false;
+
+   // Decode time, as for the RTP output: from the frame index and the vehicle frame distance
+   uint64_t uDecodeTime = pWriter->uLastDecodeTime;
+   if ( pWriter->bHasFrameIndex )
+   {
+      u16 uDeltaFrames = uFrameIndex - pWriter->uLastFrameIndex;
+      uint64_t uDelta = 0;
+      if ( (1 == uDeltaFrames) && (uFrameDistanceMs > 0) )
+         uDelta = (uint64_t)uFrameDistanceMs * (MP4_TIMESCALE/1000);
+      else if ( (pWriter->iFPS > 0) && (uDeltaFrames > 0) && (uDeltaFrames < 1000) )
+         uDelta = ((uint64_t)uDeltaFrames * MP4_TIMESCALE) / (uint64_t)pWriter->iFPS;
+      else
+         uDelta = (uint64_t)(uTimeNow - pWriter->uTimeLastFrame) * (MP4_TIMESCALE/1000);
+      if ( 0 == uDelta )
+         uDelta = _mp4_get_frame_duration(pWriter);
+      uDecodeTime += uDelta;
+   }
+   if ( uDecodeTime < pWriter->uMinDecodeTime )
+      uDecodeTime = pWriter->uMinDecodeTime;
+   pWriter->bHasFrameIndex = true;
+   pWriter->uLastFrameIndex = uFrameIndex;
+   pWriter->uTimeLastFrame = uTimeNow;
+   pWriter->uLastDecodeTime = uDecodeTime;
+
+   // Find the frame type, the parameter sets and the stored size
+   bool bKeyframe = false;
+   int iSampleSize = 0;
+   int iPos = 0;
+   u8* pNAL = NULL;
+   int iNALSize = 0;
+   while ( _mp4_next_nal(pFrame, iLength, &iPos, &pNAL, &iNALSize) )
+   {
+      if ( iNALSize <= 0 )
+         continue;
+      iSampleSize += 4 + iNALSize;
+      u32 uNALType = _mp4_get_nal_type(pWriter, pNAL);
+      if ( _mp4_is_keyframe_nal(pWriter, uNALType) )
+         bKeyframe = true;
+      if ( pWriter->uVideoStreamType == VIDEO_TYPE_H265 )
+      {
+         if ( uNALType == 32 )
+            _mp4_store_param_set(pWriter->uVPS, &pWriter->iVPSSize, pNAL, iNALSize);
+         else if ( uNALType == 33 )
+            _mp4_store_param_set(pWriter->uSPS, &pWriter->iSPSSize, pNAL, iNALSize);
+         else if ( uNALType == 34 )
+            _mp4_store_param_set(pWriter->uPPS, &pWriter->iPPSSize, pNAL, iNALSize);
+      }
+      else
+      {
+         if ( uNALType == 7 )
+            _mp4_store_param_set(pWriter->uSPS, &pWriter->iSPSSize, pNAL, iNALSize);
+         else if ( uNALType == 8 )
+            _mp4_store_param_set(pWriter->uPPS, &pWriter->iPPSSize, pNAL, iNALSize);
+      }
+   }
+
+   if ( bDiscontinuity )
+      pWriter->bWaitKeyframe = true;
+   if ( bKeyframe )
+      pWriter->bWaitKeyframe = false;
+
+   if ( pWriter->bWaitKeyframe || (0 == iSampleSize) )
+   {
+      pWriter->uStatsSkippedFrames++;
+      return true;
+   }
+   if ( iSampleSize > MP4_FRAGMENT_MAX_SIZE )
+   {
+      log_softerror_and_alarm("[VideoRecordingMP4] Video frame too big (%d bytes), skip it.", iSampleSize);
+      pWriter->uStatsSkippedFrames++;
+      pWriter->bWaitKeyframe = true;
+      return true;
+   }
+
+   if ( ! pWriter->bInitSegmentWritten )
+   {
+      bool bHasParams = (pWriter->iSPSSize > 3) && (pWriter->iPPSSize > 0);
+      if ( pWriter->uVideoStreamType == VIDEO_TYPE_H265 )
+         bHasParams = bHasParams && (pWriter->iVPSSize > 0);
+      if ( ! bHasParams )
+      {
+         pWriter->uStatsSkippedFrames++;
+         pWriter->bWaitKeyframe = true;
+         return true;
+      }
+      if ( ! _mp4_write_init_segment(pWriter) )
+         return false;
+      // The recording starts at time 0
+      pWriter->uMinDecodeTime = 0;
+      pWriter->uLastDecodeTime = 0;
+      uDecodeTime = 0;
+   }
+
+   // A fragment starts at each keyframe, or when the current one is full or too long
+   if ( pWriter->iFragmentFrames > 0 )
+   {
+      if ( bKeyframe || (pWriter->iFragmentFrames >= MP4_FRAGMENT_MAX_FRAMES) ||
+           (pWriter->iFragmentDataSize + iSampleSize > MP4_FRAGMENT_MAX_SIZE) ||
+           (uTimeNow >= pWriter->uFragmentTimeStart + MP4_FRAGMENT_MAX_DURATION_MS) )
+      {
+         if ( ! _mp4_write_fragment(pWriter, uDecodeTime) )
+            return false;
+      }
+   }
+   if ( 0 == pWriter->iFragmentFrames )
+      pWriter->uFragmentTimeStart = uTimeNow;
+
+   // Store the NALs length prefixed
+   u8* pOut = pWriter->pFragmentData + pWriter->iFragmentDataSize;
+   iPos = 0;
+   while ( _mp4_next_nal(pFrame, iLength, &iPos, &pNAL, &iNALSize) )
+   {
+      if ( iNALSize <= 0 )
+         continue;
+      pOut[0] = (u8)(iNALSize >> 24);
+      pOut[1] = (u8)(iNALSize >> 16);
+      pOut[2] = (u8)(iNALSize >> 8);
+      pOut[3] = (u8)iNALSize;
+      memcpy(pOut + 4, pNAL, iNALSize);
+      pOut += 4 + iNALSize;
+   }
+   pWriter->uFragmentDecodeTimes[pWriter->iFragmentFrames] = uDecodeTime;
+   pWriter->uFragmentFramesSizes[pWriter->iFragmentFrames] = (u32)iSampleSize;
+   pWriter->bFragmentFramesKey[pWriter->iFragmentFrames] = bKeyframe;
+   pWriter->iFragmentFrames++;
+   pWriter->iFragmentDataSize += iSampleSize;
+   pWriter->uStatsFrames++;
+   return true;
+}
+
+void rx_video_mp4_periodic_loop(t_mp4_writer* pWriter, u32 uTimeNow)
+{
+   if ( (NULL == pWriter) || (-1 == pWriter->iFd) )
+      return;
+
+   // No more frames for a while: write what was received so far
+   if ( (pWriter->iFragmentFrames > 0) && (uTimeNow >= pWriter->uFragmentTimeStart + 2*MP4_FRAGMENT_MAX_DURATION_MS) )
+      _mp4_write_fragment(pWriter, pWriter->uLastDecodeTime + _mp4_get_frame_duration(pWriter));
+
+   if ( uTimeNow < pWriter->uTimeLastSync + MP4_SYNC_INTERVAL_MS )
+      return;
+   pWriter->uTimeLastSync = uTimeNow;
+   if ( pWriter->iWriteBufferPos > 0 )
+      _mp4_write_buffer(pWriter, true);
+   fdatasync(pWriter->iFd);
+}
+
+uint64_t rx_video_mp4_get_file_size(t_mp4_writer* pWriter)
+{
+   if ( NULL == pWriter )
+      return 0;
+   return pWriter->uFileOffset + (uint64_t)pWriter->iWriteBufferPos;
+}
+
+static bool _mp4_quit_requested(volatile bool* pbQuit)
+{
+   return (NULL != pbQuit) && (*pbQuit);
+}
+
+bool rx_video_mp4_to_annexb(const char* szFileIn, FILE* pOut, volatile bool* pbQuit)
+{
+   FILE* fd = fopen(szFileIn, "rb");
+   if ( NULL == fd )
+   {
+      log_softerror_and_alarm("[VideoRecordingMP4] Failed to open mp4 file [%s]", szFileIn);
+      return false;
+   }
+
+   const u8 uStartCode[4] = { 0, 0, 0, 1 };
+   int iNALBufferSize = 1024*1024;
+   u8* pNAL = (u8*)malloc(iNALBufferSize);
+   u8 uHeader[16];
+   u32 uNALs = 0;
+   bool bOk = (NULL != pNAL);
+
+   while ( bOk && (! _mp4_quit_requested(pbQuit)) && (8 == fread(uHeader, 1, 8, fd)) )
+   {
+      uint64_t uBoxSize = ((u32)uHeader[0] << 24) | ((u32)uHeader[1] << 16) | ((u32)uHeader[2] << 8) | (u32)uHeader[3];
+      u32 uHeaderSize = 8;
+      if ( 1 == uBoxSize )
+      {
+         if ( 8 != fread(uHeader + 8, 1, 8, fd) )
+            break;
+         uBoxSize = 0;
+         for( int i=8; i<16; i++ )
+            uBoxSize = (uBoxSize << 8) | uHeader[i];
+         uHeaderSize = 16;
+      }
+      // Size 0: up to the end of the file
+      uint64_t uPayloadSize = (0 == uBoxSize)?UINT64_MAX:(uBoxSize - uHeaderSize);
+      if ( (0 != uBoxSize) && (uBoxSize < uHeaderSize) )
+         break;
+
+      if ( 0 == memcmp(uHeader + 4, "moov", 4) )
+      {
+         if ( uPayloadSize > 64*1024 )
+            break;
+         u8* pMoov = (u8*)malloc(uPayloadSize);
+         if ( (NULL == pMoov) || (uPayloadSize != fread(pMoov, 1, uPayloadSize, fd)) )
+         {
+            free(pMoov);
+            break;
+         }
+         // Parameter sets from the avcC or hvcC box
+         for( u32 i=4; i+8<uPayloadSize; i++ )
+         {
+            if ( 0 == memcmp(pMoov + i, "avcC", 4) )
+            {
+               u8* p = pMoov + i + 4 + 5;
+               u8* pEnd = pMoov + uPayloadSize;
+               for( int iSet=0; iSet<2; iSet++ )
+               {
+                  if ( p >= pEnd )
+                     break;
+                  int iCount = (iSet == 0)?((*p) & 0x1F):(*p);
+                  p++;
+                  for( int k=0; (k<iCount) && (p+2 <= pEnd); k++ )
+                  {
+                     int iLen = ((int)p[0] << 8) | p[1];
+                     p += 2;
+                     if ( p + iLen > pEnd )
+                        break;
+                     fwrite(uStartCode, 1, 4, pOut);
+                     fwrite(p, 1, iLen, pOut);
+                     p += iLen;
+                  }
+               }
+               break;
+            }
+            if ( 0 == memcmp(pMoov + i, "hvcC", 4) )
+            {
+               u8* p = pMoov + i + 4 + 22;
+               u8* pEnd = pMoov + uPayloadSize;
+               int iArrays = (p < pEnd)?(*p):0;
+               p++;
+               for( int a=0; (a<iArrays) && (p+3 <= pEnd); a++ )
+               {
+                  int iCount = ((int)p[1] << 8) | p[2];
+                  p += 3;
+                  for( int k=0; (k<iCount) && (p+2 <= pEnd); k++ )
+                  {
+                     int iLen = ((int)p[0] << 8) | p[1];
+                     p += 2;
+                     if ( p + iLen > pEnd )
+                        break;
+                     fwrite(uStartCode, 1, 4, pOut);
+                     fwrite(p, 1, iLen, pOut);
+                     p += iLen;
+                  }
+               }
+               break;
+            }
+         }
+         free(pMoov);
+         continue;
+      }
+
+      if ( 0 != memcmp(uHeader + 4, "mdat", 4) )
+      {
+         if ( 0 != fseeko(fd, (off_t)uPayloadSize, SEEK_CUR) )
+            break;
+         continue;
+      }
+
+      // Samples: 4 bytes length prefixed NALs
+      uint64_t uRead = 0;
+      while ( (uRead + 4 <= uPayloadSize) && (! _mp4_quit_requested(pbQuit)) )
+      {
+         u8 uLen[4];
+         if ( 4 != fread(uLen, 1, 4, fd) )
+            break;
+         int iLen = (int)(((u32)uLen[0] << 24) | ((u32)uLen[1] << 16) | ((u32)uLen[2] << 8) | (u32)uLen[3]);
+         if ( (iLen <= 0) || (iLen > iNALBufferSize) )
+         {
+            log_softerror_and_alarm("[VideoRecordingMP4] Invalid NAL size (%d bytes) in mp4 file [%s]", iLen, szFileIn);
+            bOk = false;
+            break;
+         }
+         if ( iLen != (int)fread(pNAL, 1, iLen, fd) )
+            break;
+         uRead += 4 + iLen;
+         if ( (4 != fwrite(uStartCode, 1, 4, pOut)) || (iLen != (int)fwrite(pNAL, 1, iLen, pOut)) )
+         {
+            // Video player closed
+            bOk = false;
+            break;
+         }
+         uNALs++;
+      }
+      if ( uRead + 4 <= uPayloadSize )
+         break;
+   }
+
+   log_line("[VideoRecordingMP4] Output %u NALs from mp4 file [%s]", uNALs, szFileIn);
+   if ( NULL != pNAL )
+      free(pNAL);
+   fclose(fd);
+   fflush(pOut);
+   return bOk;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "../base/base.h"
+
+// Fragmented MP4 (ISO BMFF) writer for the video recordings:
+// the init segment (ftyp + moov, with the avcC/hvcC from the first keyframe) is followed by
+// self contained fragments (moof + mdat), one per GOP or per second at most. The file can be
+// played at any time while recording and, after a power loss, up to the last synced fragment.
+// The input is one complete Annex-B video frame at a time; the NALs are stored length prefixed
+// (4 bytes), parameter sets are kept in band too. Timestamps use a 90 kHz timescale.
+// The output is written in large, block aligned, chunks and the file is preallocated in steps.
+
+#define MP4_TIMESCALE 90000
+#define MP4_WRITE_BLOCK_SIZE (256*1024)
+#define MP4_WRITE_BUFFER_SIZE (2*1024*1024)
+#define MP4_PREALLOCATE_STEP (32*1024*1024)
+#define MP4_FRAGMENT_MAX_FRAMES 128
+#define MP4_FRAGMENT_MAX_SIZE (3*1024*1024)
+#define MP4_FRAGMENT_MAX_DURATION_MS 1000
+#define MP4_SYNC_INTERVAL_MS 2000
+#define MP4_MAX_PARAM_SET_SIZE 256
+
+typedef struct
+{
+   u8  uVideoStreamType; // VIDEO_TYPE_H264 or VIDEO_TYPE_H265
+   int iWidth;
+   int iHeight;
+   int iFPS;
+   int iFd;
+
+   u8  uVPS[MP4_MAX_PARAM_SET_SIZE];
+   u8  uSPS[MP4_MAX_PARAM_SET_SIZE];
+   u8  uPPS[MP4_MAX_PARAM_SET_SIZE];
+   int iVPSSize;
+   int iSPSSize;
+   int iPPSSize;
+   bool bInitSegmentWritten;
+   bool bWaitKeyframe;
+
+   // Frame timing
+   bool bHasFrameIndex;
+   u16 uLastFrameIndex;
+   u32 uTimeLastFrame;
+   uint64_t uLastDecodeTime;
+   uint64_t uMinDecodeTime; // end of the last written fragment
+
+   // Current fragment (samples data, length prefixed NALs)
+   u8* pFragmentData;
+   int iFragmentDataSize;
+   int iFragmentFrames;
+   uint64_t uFragmentDecodeTimes[MP4_FRAGMENT_MAX_FRAMES];
+   u32 uFragmentFramesSizes[MP4_FRAGMENT_MAX_FRAMES];
+   bool bFragmentFramesKey[MP4_FRAGMENT_MAX_FRAMES];
+   u32 uFragmentTimeStart;
+   u32 uFragmentSequence;
+
+   // Output
+   u8* pWriteBuffer; // block aligned
+   int iWriteBufferPos;
+   uint64_t uFileOffset; // bytes written to the file
+   uint64_t uFileAllocated;
+   bool bPreallocateFailed;
+   u32 uTimeLastWrite;
+   u32 uTimeLastSync;
+
+   u32 uStatsFrames;
+   u32 uStatsSkippedFrames;
+   u32 uStatsFragments;
+   u32 uStatsWrites;
+} t_mp4_writer;
+
+bool rx_video_mp4_open(t_mp4_writer* pWriter, const char* szFile, u8 uVideoStreamType, int iWidth, int iHeight, int iFPS);
+// Writes the last fragment, releases the unused preallocated space and closes the file
+void rx_video_mp4_close(t_mp4_writer* pWriter);
+
+// Timing info as sent by the vehicle: the video frame index and the distance to the previous frame (ms, 0 if unknown)
+// bDiscontinuity: frames were lost before this one; frames are skipped until the next keyframe
+bool rx_video_mp4_add_frame(t_mp4_writer* pWriter, u8* pFrame, int iLength, u16 uFrameIndex, u32 uFrameDistanceMs, u32 uTimeNow, bool bDiscontinuity);
+
+// Closes the current fragment if it's too old (i.e. no more frames received) and writes
+// (and syncs) the buffered data not written for too long.
+void rx_video_mp4_periodic_loop(t_mp4_writer* pWriter, u32 uTimeNow);
+
+uint64_t rx_video_mp4_get_file_size(t_mp4_writer* pWriter);
+
+// Outputs the video stream of a recording mp4 file as a raw (Annex-B) stream, for the local video players:
+// the parameter sets from the avcC/hvcC box first, then the samples NALs from the mdat boxes, in file order.
+// Works on recordings cut short too (i.e. by a power loss). pbQuit (can be NULL) stops the output when set.
+bool rx_video_mp4_to_annexb(const char* szFileIn, FILE* pOut, volatile bool* pbQuit);
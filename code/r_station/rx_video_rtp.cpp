@@ -0,0 +1,390 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <time.h>
+#include <unistd.h>
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/flags_video.h"
+#include "rx_video_rtp.h"
+
+#define RTP_OUT_BUFFER_SIZE (RTP_MAX_OUT_PACKETS * RTP_MAX_PACKET_SIZE)
+#define RTP_NAL_TYPE_FU_A 28
+#define RTP_H265_NAL_TYPE_FU 49
+
+bool rx_video_rtp_init(t_rtp_packetizer* pPacketizer, u8 uVideoStreamType, int iMaxPacketSize, t_rtp_packets_ready_callback pCallback)
+{
+   if ( NULL == pPacketizer )
+      return false;
+   memset(pPacketizer, 0, sizeof(t_rtp_packetizer));
+
+   if ( (iMaxPacketSize < 100) || (iMaxPacketSize > RTP_MAX_PACKET_SIZE) )
+      iMaxPacketSize = 1400;
+   pPacketizer->iMaxPacketSize = iMaxPacketSize;
+   pPacketizer->uVideoStreamType = uVideoStreamType;
+   pPacketizer->pCallbackPacketsReady = pCallback;
+
+   u32 uRandom = get_current_timestamp_micros() ^ (((u32)getpid()) << 16) ^ (u32)rand();
+   pPacketizer->uSSRC = uRandom;
+   pPacketizer->uSequence = (u16)(rand() & 0xFFFF);
+   pPacketizer->uTimestamp = (u32)rand();
+
+   pPacketizer->pNALBuffer = (u8*) malloc(RTP_NAL_BUFFER_SIZE);
+   pPacketizer->pOutBuffer = (u8*) malloc(RTP_OUT_BUFFER_SIZE);
+   if ( (NULL == pPacketizer->pNALBuffer) || (NULL == pPacketizer->pOutBuffer) )
+   {
+      log_softerror_and_alarm("[VideoRTP] Failed to allocate RTP packetizer buffers.");
+      rx_video_rtp_uninit(pPacketizer);
+      return false;
+   }
+   log_line("[VideoRTP] Initialized RTP packetizer for %s, max packet size: %d bytes, SSRC: %u",
+      (uVideoStreamType == VIDEO_TYPE_H265)?"H265":"H264", iMaxPacketSize, pPacketizer->uSSRC);
+   return true;
+}
+
+void rx_video_rtp_uninit(t_rtp_packetizer* pPacketizer)
+{
+   if ( NULL == pPacketizer )
+      return;
+   if ( NULL != pPacketizer->pNALBuffer )
+      free(pPacketizer->pNALBuffer);
+   if ( NULL != pPacketizer->pOutBuffer )
+      free(pPacketizer->pOutBuffer);
+   pPacketizer->pNALBuffer = NULL;
+   pPacketizer->pOutBuffer = NULL;
+   pPacketizer->iNALBufferPos = 0;
+   pPacketizer->iOutPacketsCount = 0;
+   pPacketizer->iOutBufferPos = 0;
+}
+
+void rx_video_rtp_reset_stream(t_rtp_packetizer* pPacketizer, u8 uVideoStreamType)
+{
+   if ( NULL == pPacketizer )
+      return;
+   pPacketizer->uVideoStreamType = uVideoStreamType;
+   pPacketizer->iNALBufferPos = 0;
+   pPacketizer->iNALScanPos = 0;
+   pPacketizer->bInsideNAL = false;
+   pPacketizer->bNALFragmentsSent = false;
+}
+
+u8* rx_video_rtp_get_packet(t_rtp_packetizer* pPacketizer, int iIndex)
+{
+   if ( (NULL == pPacketizer) || (iIndex < 0) || (iIndex >= pPacketizer->iOutPacketsCount) )
+      return NULL;
+   int iPos = 0;
+   for( int i=0; i<iIndex; i++ )
+      iPos += pPacketizer->iOutPacketsLengths[i];
+   return pPacketizer->pOutBuffer + iPos;
+}
+
+void rx_video_rtp_clear_packets(t_rtp_packetizer* pPacketizer)
+{
+   if ( NULL == pPacketizer )
+      return;
+   pPacketizer->iOutPacketsCount = 0;
+   pPacketizer->iOutBufferPos = 0;
+}
+
+// Returns the start of a new output packet, with the RTP header filled in
+
+static u8* _rx_video_rtp_begin_packet(t_rtp_packetizer* pPacketizer, bool bMarker)
+{
+   if ( (pPacketizer->iOutPacketsCount >= RTP_MAX_OUT_PACKETS) ||
+        (pPacketizer->iOutBufferPos + pPacketizer->iMaxPacketSize > RTP_OUT_BUFFER_SIZE) )
+   {
+      if ( NULL != pPacketizer->pCallbackPacketsReady )
+         pPacketizer->pCallbackPacketsReady(pPacketizer);
+      if ( pPacketizer->iOutPacketsCount > 0 )
+      {
+         log_softerror_and_alarm("[VideoRTP] Output packets not consumed. Discard %d packets.", pPacketizer->iOutPacketsCount);
+         rx_video_rtp_clear_packets(pPacketizer);
+      }
+   }
+
+   u8* pPacket = pPacketizer->pOutBuffer + pPacketizer->iOutBufferPos;
+   pPacket[0] = 0x80; // Version 2, no padding, no extension, no CSRC
+   pPacket[1] = (bMarker?0x80:0x00) | RTP_VIDEO_PAYLOAD_TYPE;
+   pPacket[2] = (pPacketizer->uSequence >> 8) & 0xFF;
+   pPacket[3] = pPacketizer->uSequence & 0xFF;
+   pPacket[4] = (pPacketizer->uTimestamp >> 24) & 0xFF;
+   pPacket[5] = (pPacketizer->uTimestamp >> 16) & 0xFF;
+   pPacket[6] = (pPacketizer->uTimestamp >> 8) & 0xFF;
+   pPacket[7] = pPacketizer->uTimestamp & 0xFF;
+   pPacket[8] = (pPacketizer->uSSRC >> 24) & 0xFF;
+   pPacket[9] = (pPacketizer->uSSRC >> 16) & 0xFF;
+   pPacket[10] = (pPacketizer->uSSRC >> 8) & 0xFF;
+   pPacket[11] = pPacketizer->uSSRC & 0xFF;
+   pPacketizer->uSequence++;
+   return pPacket;
+}
+
+static void _rx_video_rtp_end_packet(t_rtp_packetizer* pPacketizer, int iLength)
+{
+   pPacketizer->iOutPacketsLengths[pPacketizer->iOutPacketsCount] = iLength;
+   pPacketizer->iOutPacketsCount++;
+   pPacketizer->iOutBufferPos += iLength;
+   pPacketizer->uTotalPacketsSent++;
+   pPacketizer->uTotalOctetsSent += iLength - RTP_HEADER_SIZE;
+}
+
+// Packetizes a NAL (without start code), or a part of a NAL when the NAL is larger than the NAL buffer.
+// A NAL that fits in one packet goes as a single NAL unit packet, otherwise as FU-A (H264) or FU (H265) fragments.
+
+static void _rx_video_rtp_send_nal_part(t_rtp_packetizer* pPacketizer, u8* pData, int iLength, bool bStartOfNAL, bool bEndOfNAL, bool bMarker)
+{
+   bool bH265 = (pPacketizer->uVideoStreamType == VIDEO_TYPE_H265);
+   int iNALHeaderSize = bH265?2:1;
+   int iMaxPayload = pPacketizer->iMaxPacketSize - RTP_HEADER_SIZE;
+
+   if ( bStartOfNAL )
+   {
+      if ( iLength < iNALHeaderSize )
+         return;
+      pPacketizer->uNALHeader[0] = pData[0];
+      pPacketizer->uNALHeader[1] = bH265?pData[1]:0;
+
+      if ( bEndOfNAL && (iLength <= iMaxPayload) )
+      {
+         u8* pPacket = _rx_video_rtp_begin_packet(pPacketizer, bMarker);
+         memcpy(pPacket + RTP_HEADER_SIZE, pData, iLength);
+         _rx_video_rtp_end_packet(pPacketizer, RTP_HEADER_SIZE + iLength);
+         return;
+      }
+      // The NAL header is carried in the fragmentation headers
+      pData += iNALHeaderSize;
+      iLength -= iNALHeaderSize;
+   }
+
+   int iFUHeaderSize = bH265?3:2;
+   int iMaxChunk = iMaxPayload - iFUHeaderSize;
+   bool bFirstFragment = bStartOfNAL;
+   u8 uHeader0 = pPacketizer->uNALHeader[0];
+
+   while ( iLength > 0 )
+   {
+      int iChunk = iLength;
+      if ( iChunk > iMaxChunk )
+         iChunk = iMaxChunk;
+      bool bLastFragment = bEndOfNAL && (iChunk == iLength);
+
+      u8* pPacket = _rx_video_rtp_begin_packet(pPacketizer, bMarker && bLastFragment);
+      u8 uFUFlags = (bFirstFragment?0x80:0x00) | (bLastFragment?0x40:0x00);
+      if ( bH265 )
+      {
+         pPacket[RTP_HEADER_SIZE] = (uHeader0 & 0x81) | (RTP_H265_NAL_TYPE_FU << 1);
+         pPacket[RTP_HEADER_SIZE+1] = pPacketizer->uNALHeader[1];
+         pPacket[RTP_HEADER_SIZE+2] = uFUFlags | ((uHeader0 >> 1) & 0x3F);
+      }
+      else
+      {
+         pPacket[RTP_HEADER_SIZE] = (uHeader0 & 0xE0) | RTP_NAL_TYPE_FU_A;
+         pPacket[RTP_HEADER_SIZE+1] = uFUFlags | (uHeader0 & 0x1F);
+      }
+      memcpy(pPacket + RTP_HEADER_SIZE + iFUHeaderSize, pData, iChunk);
+      _rx_video_rtp_end_packet(pPacketizer, RTP_HEADER_SIZE + iFUHeaderSize + iChunk);
+
+      pData += iChunk;
+      iLength -= iChunk;
+      bFirstFragment = false;
+   }
+}
+
+// Finds the start codes in the NAL buffer and packetizes all the complete NALs.
+// The last (incomplete) NAL is kept in the buffer, unless it gets too big, when its first part is sent as fragments.
+
+static void _rx_video_rtp_process_nals(t_rtp_packetizer* pPacketizer)
+{
+   u8* pBuffer = pPacketizer->pNALBuffer;
+   int iBufferPos = pPacketizer->iNALBufferPos;
+   int iStart = 0;
+   int i = pPacketizer->iNALScanPos;
+
+   while ( i + 2 < iBufferPos )
+   {
+      if ( pBuffer[i+2] > 1 )
+      {
+         i += 3;
+         continue;
+      }
+      if ( (pBuffer[i+2] != 1) || (pBuffer[i+1] != 0) || (pBuffer[i] != 0) )
+      {
+         i++;
+         continue;
+      }
+
+      // Start code found. Trailing zero bytes (from 4 bytes start codes) are not part of the NAL
+      if ( pPacketizer->bInsideNAL )
+      {
+         int iEnd = i;
+         while ( (iEnd > iStart) && (0 == pBuffer[iEnd-1]) )
+            iEnd--;
+         if ( iEnd > iStart )
+            _rx_video_rtp_send_nal_part(pPacketizer, pBuffer + iStart, iEnd - iStart, !pPacketizer->bNALFragmentsSent, true, false);
+      }
+      pPacketizer->bInsideNAL = true;
+      pPacketizer->bNALFragmentsSent = false;
+      i += 3;
+      iStart = i;
+   }
+
+   // Data before the first start code is dropped, except the bytes that could be the start of a start code
+   if ( (! pPacketizer->bInsideNAL) && (iStart < iBufferPos - 3) )
+      iStart = iBufferPos - 3;
+
+   if ( iStart > 0 )
+   {
+      if ( iBufferPos > iStart )
+         memmove(pBuffer, pBuffer + iStart, iBufferPos - iStart);
+      iBufferPos -= iStart;
+      i -= iStart;
+   }
+   if ( i < 0 )
+      i = 0;
+
+   // NAL too big for the buffer: send the first part now, keep the bytes that could be part of the next start code
+   // and at least one byte of the NAL, so that the last fragment is never empty.
+   if ( pPacketizer->bInsideNAL && (iBufferPos > RTP_NAL_BUFFER_SIZE/2) )
+   {
+      int iSend = iBufferPos - 3;
+      while ( (iSend > 0) && (0 == pBuffer[iSend-1]) )
+         iSend--;
+      iSend--;
+      if ( iSend > 2 )
+      {
+         _rx_video_rtp_send_nal_part(pPacketizer, pBuffer, iSend, !pPacketizer->bNALFragmentsSent, false, false);
+         pPacketizer->bNALFragmentsSent = true;
+         memmove(pBuffer, pBuffer + iSend, iBufferPos - iSend);
+         iBufferPos -= iSend;
+         i = 0;
+      }
+   }
+
+   pPacketizer->iNALBufferPos = iBufferPos;
+   pPacketizer->iNALScanPos = i;
+}
+
+// Sends the last NAL of the current frame, with the marker bit set
+
+static void _rx_video_rtp_end_frame(t_rtp_packetizer* pPacketizer)
+{
+   _rx_video_rtp_process_nals(pPacketizer);
+
+   if ( pPacketizer->bInsideNAL )
+   {
+      int iEnd = pPacketizer->iNALBufferPos;
+      while ( (iEnd > 0) && (0 == pPacketizer->pNALBuffer[iEnd-1]) )
+         iEnd--;
+      if ( iEnd > 0 )
+         _rx_video_rtp_send_nal_part(pPacketizer, pPacketizer->pNALBuffer, iEnd, !pPacketizer->bNALFragmentsSent, true, true);
+   }
+   pPacketizer->iNALBufferPos = 0;
+   pPacketizer->iNALScanPos = 0;
+   pPacketizer->bInsideNAL = false;
+   pPacketizer->bNALFragmentsSent = false;
+}
+
+void rx_video_rtp_set_frame_info(t_rtp_packetizer* pPacketizer, u16 uFrameIndex, u32 uFrameDistanceMs, int iFPS, u32 uTimeNow)
+{
+   if ( (NULL == pPacketizer) || (NULL == pPacketizer->pNALBuffer) )
+      return;
+   if ( pPacketizer->bHasFrameIndex && (uFrameIndex == pPacketizer->uLastFrameIndex) )
+      return;
+
+   if ( pPacketizer->bHasFrameIndex )
+   {
+      // End of previous frame was lost
+      if ( pPacketizer->bInsideNAL || (pPacketizer->iNALBufferPos > 0) )
+         _rx_video_rtp_end_frame(pPacketizer);
+
+      u16 uDeltaFrames = uFrameIndex - pPacketizer->uLastFrameIndex;
+      if ( (1 == uDeltaFrames) && (uFrameDistanceMs > 0) )
+         pPacketizer->uTimestamp += uFrameDistanceMs * (RTP_VIDEO_CLOCK_RATE/1000);
+      else if ( (iFPS > 0) && (uDeltaFrames < 1000) )
+         pPacketizer->uTimestamp += ((u32)uDeltaFrames * RTP_VIDEO_CLOCK_RATE) / (u32)iFPS;
+      else
+         pPacketizer->uTimestamp += (uTimeNow - pPacketizer->uTimeLastFrame) * (RTP_VIDEO_CLOCK_RATE/1000);
+   }
+   pPacketizer->bHasFrameIndex = true;
+   pPacketizer->uLastFrameIndex = uFrameIndex;
+   pPacketizer->uTimeLastFrame = uTimeNow;
+}
+
+void rx_video_rtp_add_data(t_rtp_packetizer* pPacketizer, u8* pData, int iLength, bool bIsEndOfFrame)
+{
+   if ( (NULL == pPacketizer) || (NULL == pPacketizer->pNALBuffer) || (NULL == pData) )
+      return;
+
+   while ( iLength > 0 )
+   {
+      int iCopy = RTP_NAL_BUFFER_SIZE - pPacketizer->iNALBufferPos;
+      if ( iCopy > iLength )
+         iCopy = iLength;
+      memcpy(pPacketizer->pNALBuffer + pPacketizer->iNALBufferPos, pData, iCopy);
+      pPacketizer->iNALBufferPos += iCopy;
+      pData += iCopy;
+      iLength -= iCopy;
+      _rx_video_rtp_process_nals(pPacketizer);
+   }
+
+   if ( bIsEndOfFrame )
+      _rx_video_rtp_end_frame(pPacketizer);
+}
+
+int rx_video_rtp_build_sender_report(t_rtp_packetizer* pPacketizer, u8* pOutput, u32 uTimeNow)
+{
+   if ( (NULL == pPacketizer) || (NULL == pOutput) )
+      return 0;
+
+   // NTP time: seconds since 1900 and fraction of second
+   struct timespec ts;
+   clock_gettime(CLOCK_REALTIME, &ts);
+   u32 uNTPSeconds = (u32)ts.tv_sec + 2208988800U;
+   u32 uNTPFraction = (u32)(((unsigned long long)ts.tv_nsec << 32) / 1000000000ULL);
+   // RTP time matching the NTP time above
+   u32 uRTPTime = pPacketizer->uTimestamp + (uTimeNow - pPacketizer->uTimeLastFrame) * (RTP_VIDEO_CLOCK_RATE/1000);
+
+   u32 uValues[6] = { pPacketizer->uSSRC, uNTPSeconds, uNTPFraction, uRTPTime, pPacketizer->uTotalPacketsSent, pPacketizer->uTotalOctetsSent };
+   pOutput[0] = 0x80; // Version 2, no reception reports
+   pOutput[1] = 200; // SR
+   pOutput[2] = 0;
+   pOutput[3] = RTCP_SR_PACKET_SIZE/4 - 1;
+   for( int i=0; i<6; i++ )
+   {
+      pOutput[4+i*4] = (uValues[i] >> 24) & 0xFF;
+      pOutput[5+i*4] = (uValues[i] >> 16) & 0xFF;
+      pOutput[6+i*4] = (uValues[i] >> 8) & 0xFF;
+      pOutput[7+i*4] = uValues[i] & 0xFF;
+   }
+   return RTCP_SR_PACKET_SIZE;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "../base/base.h"
+
+// RTP packetizer for the forwarded video stream:
+// H264 as in RFC 6184 (single NAL unit packets and FU-A fragments),
+// H265 as in RFC 7798 (single NAL unit packets and FU fragments).
+// The input is the Annex-B video stream, in chunks of any size; the NALs boundaries are found
+// in the stream and each NAL is sent as one or more RTP packets.
+// The marker bit is set on the last packet of each video frame.
+
+#define RTP_VIDEO_PAYLOAD_TYPE 96
+#define RTP_VIDEO_CLOCK_RATE 90000
+#define RTP_HEADER_SIZE 12
+#define RTCP_SR_PACKET_SIZE 28
+
+#define RTP_MAX_OUT_PACKETS 128
+#define RTP_MAX_PACKET_SIZE 2048
+#define RTP_NAL_BUFFER_SIZE (256*1024)
+
+typedef struct t_rtp_packetizer t_rtp_packetizer;
+
+// Called when the output packets list is full; it must consume the packets and call rx_video_rtp_clear_packets()
+typedef void (*t_rtp_packets_ready_callback)(t_rtp_packetizer* pPacketizer);
+
+struct t_rtp_packetizer
+{
+   u8  uVideoStreamType; // VIDEO_TYPE_H264 or VIDEO_TYPE_H265
+   u32 uSSRC;
+   u16 uSequence;
+   int iMaxPacketSize; // including the RTP header
+   t_rtp_packets_ready_callback pCallbackPacketsReady;
+
+   // Current frame timestamp
+   u32 uTimestamp;
+   u16 uLastFrameIndex;
+   bool bHasFrameIndex;
+   u32 uTimeLastFrame; // local time (ms) when the current frame timestamp was set
+
+   // Current (incomplete) NAL
+   u8* pNALBuffer;
+   int iNALBufferPos;
+   int iNALScanPos;
+   bool bInsideNAL;
+   bool bNALFragmentsSent;
+   u8  uNALHeader[2];
+
+   // Output RTP packets, stored back to back
+   u8* pOutBuffer;
+   int iOutPacketsCount;
+   int iOutPacketsLengths[RTP_MAX_OUT_PACKETS];
+   int iOutBufferPos;
+
+   // For RTCP sender reports
+   u32 uTotalPacketsSent;
+   u32 uTotalOctetsSent;
+};
+
+bool rx_video_rtp_init(t_rtp_packetizer* pPacketizer, u8 uVideoStreamType, int iMaxPacketSize, t_rtp_packets_ready_callback pCallback);
+void rx_video_rtp_uninit(t_rtp_packetizer* pPacketizer);
+// Drops any partial NAL (i.e. on stream discontinuity or codec change)
+void rx_video_rtp_reset_stream(t_rtp_packetizer* pPacketizer, u8 uVideoStreamType);
+
+// Sets the RTP timestamp (90 kHz clock) for the data that follows, from the video frame index and
+// the vehicle side frame distance (ms, 0 if unknown). If the frame changed before the end of the previous
+// frame was received (end of frame lost), the pending NAL of the previous frame is sent first.
+void rx_video_rtp_set_frame_info(t_rtp_packetizer* pPacketizer, u16 uFrameIndex, u32 uFrameDistanceMs, int iFPS, u32 uTimeNow);
+void rx_video_rtp_add_data(t_rtp_packetizer* pPacketizer, u8* pData, int iLength, bool bIsEndOfFrame);
+
+u8*  rx_video_rtp_get_packet(t_rtp_packetizer* pPacketizer, int iIndex);
+void rx_video_rtp_clear_packets(t_rtp_packetizer* pPacketizer);
+
+// Builds a RTCP sender report (RFC 3550) into pOutput (RTCP_SR_PACKET_SIZE bytes). Returns the length.
+int rx_video_rtp_build_sender_report(t_rtp_packetizer* pPacketizer, u8* pOutput, u32 uTimeNow);
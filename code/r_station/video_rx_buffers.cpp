@@ -47,6 +47,7 @@ VideoRxPacketsBuffer::VideoRxPacketsBuffer(int iVideoStreamIndex, int iCameraInd
    m_iVideoStreamIndex = iVideoStreamIndex;
    m_iCameraIndex = iCameraIndex;
 
+   memset(&m_PacketsSlab, 0, sizeof(t_packets_slab));
    for( int i=0; i<MAX_RXTX_BLOCKS_BUFFER; i++ )
    {
       _empty_block_buffer_index(i);
@@ -69,12 +70,11 @@ VideoRxPacketsBuffer::~VideoRxPacketsBuffer()
 {
    uninit();
 
+   packets_slab_free(&m_PacketsSlab);
+
    for( int i=0; i<MAX_RXTX_BLOCKS_BUFFER; i++ )
    for( int k=0; k<MAX_TOTAL_PACKETS_IN_BLOCK; k++ )
    {
-      if ( NULL != m_VideoBlocks[i].packets[k].pRawData )
-         free(m_VideoBlocks[i].packets[k].pRawData);
-
       m_VideoBlocks[i].packets[k].pRawData = NULL;
       m_VideoBlocks[i].packets[k].pVideoData = NULL;
       m_VideoBlocks[i].packets[k].pPH = NULL;
@@ -96,6 +96,25 @@ bool VideoRxPacketsBuffer::init(Model* pModel)
       return false;
    }
    log_line("[VideoRXBuffer] Initialize video Rx buffer instance number %d.", m_iInstanceIndex+1);
+
+   if ( NULL == m_PacketsSlab.pMemory )
+   {
+      if ( ! packets_slab_alloc(&m_PacketsSlab, MAX_RXTX_BLOCKS_BUFFER * MAX_TOTAL_PACKETS_IN_BLOCK, MAX_PACKET_TOTAL_SIZE, 1) )
+      {
+         log_error_and_alarm("[VideoRXBuffer] Failed to allocate video packets buffer.");
+         return false;
+      }
+      for( int i=0; i<MAX_RXTX_BLOCKS_BUFFER; i++ )
+      for( int k=0; k<MAX_TOTAL_PACKETS_IN_BLOCK; k++ )
+      {
+         u8* pRawData = packets_slab_get_slot(&m_PacketsSlab, i*MAX_TOTAL_PACKETS_IN_BLOCK + k);
+         m_VideoBlocks[i].packets[k].pRawData = pRawData;
+         m_VideoBlocks[i].packets[k].pVideoData = pRawData + sizeof(t_packet_header) + sizeof(t_packet_header_video_segment);
+         m_VideoBlocks[i].packets[k].pPH = (t_packet_header*)pRawData;
+         m_VideoBlocks[i].packets[k].pPHVS = (t_packet_header_video_segment*)(pRawData + sizeof(t_packet_header));
+         m_VideoBlocks[i].packets[k].pPHVSImp = (t_packet_header_video_segment_important*)(pRawData + sizeof(t_packet_header) + sizeof(t_packet_header_video_segment));
+      }
+   }
    _empty_buffers("init", NULL, NULL);
    m_bInitialized = true;
    log_line("[VideoRXBuffer] Initialized video Tx buffer instance number %d.", m_iInstanceIndex+1);
@@ -118,43 +137,6 @@ void VideoRxPacketsBuffer::emptyBuffers(const char* szReason)
    _empty_buffers(szReason, NULL, NULL);
 }
 
-bool VideoRxPacketsBuffer::_check_allocate_video_block_in_buffer(int iBufferIndex)
-{
-   if ( (iBufferIndex < 0) || (iBufferIndex >= MAX_RXTX_BLOCKS_BUFFER) )
-      return false;
-
-   for( int i=0; i<m_VideoBlocks[iBufferIndex].iBlockDataPackets + m_VideoBlocks[iBufferIndex].iBlockECPackets; i++ )
-   {
-      if ( NULL != m_VideoBlocks[iBufferIndex].packets[i].pRawData )
-         continue;
-
-      u8* pRawData = (u8*)malloc(MAX_PACKET_TOTAL_SIZE);
-      if ( NULL == pRawData )
-      {
-         log_error_and_alarm("[VideoRXBuffer] Failed to allocate packet, buffer index: %d, packet index %d", iBufferIndex, i);
-         return false;
-      }
-      m_VideoBlocks[iBufferIndex].packets[i].pRawData = pRawData;
-      m_VideoBlocks[iBufferIndex].packets[i].pVideoData = pRawData + sizeof(t_packet_header) + sizeof(t_packet_header_video_segment);
-      m_VideoBlocks[iBufferIndex].packets[i].pPH = (t_packet_header*)pRawData;
-      m_VideoBlocks[iBufferIndex].packets[i].pPHVS = (t_packet_header_video_segment*)(pRawData + sizeof(t_packet_header));
-      m_VideoBlocks[iBufferIndex].packets[i].pPHVSImp = (t_packet_header_video_segment_important*)(pRawData + sizeof(t_packet_header) + sizeof(t_packet_header_video_segment));
-
-      m_VideoBlocks[iBufferIndex].packets[i].pPHVS->uCurrentBlockDataPackets = m_VideoBlocks[iBufferIndex].iBlockDataPackets;
-      m_VideoBlocks[iBufferIndex].packets[i].pPHVS->uCurrentBlockECPackets = m_VideoBlocks[iBufferIndex].iBlockECPackets;
-      _empty_block_buffer_packet_index(iBufferIndex, i);
-   }
-   return true;
-}
-
-void VideoRxPacketsBuffer::_empty_block_buffer_packet_index(int iBufferIndex, int iPacketIndex)
-{
-   m_VideoBlocks[iBufferIndex].packets[iPacketIndex].uReceivedTime = 0;
-   m_VideoBlocks[iBufferIndex].packets[iPacketIndex].uRequestedTime = 0;
-   m_VideoBlocks[iBufferIndex].packets[iPacketIndex].bEmpty = true;
-   m_VideoBlocks[iBufferIndex].packets[iPacketIndex].bReconstructed = false;
-}
-
 void VideoRxPacketsBuffer::_empty_block_buffer_index(int iBufferIndex)
 {
    m_VideoBlocks[iBufferIndex].uH264FrameIndex = 0;
@@ -171,9 +153,12 @@ void VideoRxPacketsBuffer::_empty_block_buffer_index(int iBufferIndex)
    m_VideoBlocks[iBufferIndex].iRecvDataPackets = 0;
    m_VideoBlocks[iBufferIndex].iRecvECPackets = 0;
    m_VideoBlocks[iBufferIndex].iReconstructedECUsed = 0;
+   m_VideoBlocks[iBufferIndex].uReceivedPacketsMask = 0;
+   m_VideoBlocks[iBufferIndex].uReconstructedPacketsMask = 0;
    for( int k=0; k<MAX_TOTAL_PACKETS_IN_BLOCK; k++ )
    {
-      _empty_block_buffer_packet_index(iBufferIndex, k);
+      m_VideoBlocks[iBufferIndex].packets[k].uReceivedTime = 0;
+      m_VideoBlocks[iBufferIndex].packets[k].uRequestedTime = 0;
    }
 }
 
@@ -241,50 +226,49 @@ void VideoRxPacketsBuffer::_check_do_ec_for_video_block(int iBufferIndex)
 
    m_VideoBlocks[iBufferIndex].iReconstructedECUsed = m_VideoBlocks[iBufferIndex].iBlockDataPackets - m_VideoBlocks[iBufferIndex].iRecvDataPackets;
 
-   int iPacketIndexGood = -1;
+   // Missing data packets and available EC packets, from the block packets bitmap:
+   // bits [0, data packets) are the data packets, bits [data packets, data+ec packets) are the EC packets
+
+   u32 uDataMask = (m_VideoBlocks[iBufferIndex].iBlockDataPackets >= 32)?0xFFFFFFFF:((((u32)1) << m_VideoBlocks[iBufferIndex].iBlockDataPackets) - 1);
+   u32 uMissingDataMask = (~m_VideoBlocks[iBufferIndex].uReceivedPacketsMask) & uDataMask;
+   u32 uAvailableECMask = m_VideoBlocks[iBufferIndex].uReceivedPacketsMask & (~uDataMask);
+
+   if ( (0 == uMissingDataMask) || (0 == m_VideoBlocks[iBufferIndex].uReceivedPacketsMask) )
+      return;
 
-   // Add existing data packets, mark and count the ones that are missing
    // Find a good PH, PHVS and video-debug-info (if any) in the block to reuse it in reconstruction
+   int iPacketIndexGood = __builtin_ctz(m_VideoBlocks[iBufferIndex].uReceivedPacketsMask);
 
-   m_ECRxInfo.missing_packets_count = 0;
+   // Data packets of a block are contiguous in the slab, at a fixed stride
+   u8* pBlockVideoData = m_VideoBlocks[iBufferIndex].packets[0].pVideoData;
    for( int i=0; i<m_VideoBlocks[iBufferIndex].iBlockDataPackets; i++ )
-   {
-      m_ECRxInfo.p_decode_data_packets_pointers[i] = m_VideoBlocks[iBufferIndex].packets[i].pVideoData;
+      m_ECRxInfo.p_decode_data_packets_pointers[i] = pBlockVideoData + i*m_PacketsSlab.iSlotSize;
 
-      if ( m_VideoBlocks[iBufferIndex].packets[i].bEmpty )
-      {
-         m_ECRxInfo.decode_missing_packets_indexes[m_ECRxInfo.missing_packets_count] = i;
-         m_ECRxInfo.missing_packets_count++;
-      }
-      else if ( -1 == iPacketIndexGood )
-         iPacketIndexGood = i;
+   m_ECRxInfo.missing_packets_count = 0;
+   while ( 0 != uMissingDataMask )
+   {
+      m_ECRxInfo.decode_missing_packets_indexes[m_ECRxInfo.missing_packets_count] = __builtin_ctz(uMissingDataMask);
+      m_ECRxInfo.missing_packets_count++;
+      uMissingDataMask &= uMissingDataMask - 1;
    }
 
    // Add the needed FEC packets to the list
    int pos = 0;
    int iECDelta = m_VideoBlocks[iBufferIndex].iBlockDataPackets;
-   for( int i=0; i<m_VideoBlocks[iBufferIndex].iBlockECPackets; i++ )
+   while ( (0 != uAvailableECMask) && (pos < (int)(m_ECRxInfo.missing_packets_count)) )
    {
-      if ( ! m_VideoBlocks[iBufferIndex].packets[i+iECDelta].bEmpty )
-      {
-         if ( -1 == iPacketIndexGood )
-            iPacketIndexGood = i+iECDelta;
-
-         m_ECRxInfo.p_decode_ec_packets_pointers[pos] = m_VideoBlocks[iBufferIndex].packets[i+iECDelta].pVideoData;
-         m_ECRxInfo.decode_ec_packets_indexes[pos] = i;
-         pos++;
-         if ( pos == (int)(m_ECRxInfo.missing_packets_count) )
-            break;
-      }
+      int iPacketIndex = __builtin_ctz(uAvailableECMask);
+      uAvailableECMask &= uAvailableECMask - 1;
+      m_ECRxInfo.p_decode_ec_packets_pointers[pos] = pBlockVideoData + iPacketIndex*m_PacketsSlab.iSlotSize;
+      m_ECRxInfo.decode_ec_packets_indexes[pos] = iPacketIndex - iECDelta;
+      pos++;
    }
 
-   if ( -1 == iPacketIndexGood )
-      return;
-
    t_packet_header* pPHGood = m_VideoBlocks[iBufferIndex].packets[iPacketIndexGood].pPH;
    t_packet_header_video_segment* pPHVSGood = m_VideoBlocks[iBufferIndex].packets[iPacketIndexGood].pPHVS;
 
    int iRes = fec_decode(m_VideoBlocks[iBufferIndex].iBlockDataSize, m_ECRxInfo.p_decode_data_packets_pointers, m_VideoBlocks[iBufferIndex].iBlockDataPackets, m_ECRxInfo.p_decode_ec_packets_pointers, m_ECRxInfo.decode_ec_packets_indexes, m_ECRxInfo.decode_missing_packets_indexes, m_ECRxInfo.missing_packets_count);
+   fec_get_decode_cache_stats(&g_SMControllerRTInfo.uTotalFECDecodeMatrixCacheHits, &g_SMControllerRTInfo.uTotalFECDecodeMatrixCacheMisses);
    if ( iRes < 0 )
    {
       log_softerror_and_alarm("[VideoRXBuffer] Failed to decode video block [%u], type %d/%d/%d bytes; max data recv index: %d, max data/ec received index: %d, recv: %d/%d packets, missing count: %d",
@@ -301,8 +285,8 @@ void VideoRxPacketsBuffer::_check_do_ec_for_video_block(int iBufferIndex)
    for( int i=0; i<(int)(m_ECRxInfo.missing_packets_count); i++ )
    {
       int iPacketIndexToFix = m_ECRxInfo.decode_missing_packets_indexes[i];
-      m_VideoBlocks[iBufferIndex].packets[iPacketIndexToFix].bEmpty = false;
-      m_VideoBlocks[iBufferIndex].packets[iPacketIndexToFix].bReconstructed = true;
+      m_VideoBlocks[iBufferIndex].uReceivedPacketsMask |= ((u32)1) << iPacketIndexToFix;
+      m_VideoBlocks[iBufferIndex].uReconstructedPacketsMask |= ((u32)1) << iPacketIndexToFix;
       m_VideoBlocks[iBufferIndex].packets[iPacketIndexToFix].uReceivedTime = g_TimeNow;
       m_VideoBlocks[iBufferIndex].iRecvDataPackets++;
       if ( iPacketIndexToFix > m_VideoBlocks[iBufferIndex].iMaxReceivedDataPacketIndex )
@@ -350,8 +334,9 @@ bool VideoRxPacketsBuffer::_add_video_packet_to_buffer(int iBufferIndex, u8* pPa
    t_packet_header_video_segment* pPHVS = (t_packet_header_video_segment*)(pPacket + sizeof(t_packet_header));
    t_packet_header_video_segment_important* pPHVSImp = (t_packet_header_video_segment_important*)(pPacket + sizeof(t_packet_header) + sizeof(t_packet_header_video_segment));
 
-   if ( NULL != m_VideoBlocks[iBufferIndex].packets[pPHVS->uCurrentBlockPacketIndex].pRawData )
-   if ( ! m_VideoBlocks[iBufferIndex].packets[pPHVS->uCurrentBlockPacketIndex].bEmpty )
+   if ( (NULL == m_PacketsSlab.pMemory) || (pPHVS->uCurrentBlockPacketIndex >= MAX_TOTAL_PACKETS_IN_BLOCK) )
+      return false;
+   if ( RX_VIDEO_BLOCK_HAS_PACKET(&m_VideoBlocks[iBufferIndex], pPHVS->uCurrentBlockPacketIndex) )
       return false;
 
    // Set basic video block size info before check allocate block in buffer as it needs block info about packets
@@ -392,17 +377,11 @@ bool VideoRxPacketsBuffer::_add_video_packet_to_buffer(int iBufferIndex, u8* pPa
 
       for(u8 u=0; u<pPHVS->uCurrentBlockDataPackets+pPHVS->uCurrentBlockECPackets; u++)
       {
-         if ( NULL != m_VideoBlocks[iBufferIndex].packets[u].pRawData )
-         {
-            m_VideoBlocks[iBufferIndex].packets[u].pPHVS->uCurrentBlockDataPackets = pPHVS->uCurrentBlockDataPackets;
-            m_VideoBlocks[iBufferIndex].packets[u].pPHVS->uCurrentBlockECPackets = pPHVS->uCurrentBlockECPackets;
-         }
+         m_VideoBlocks[iBufferIndex].packets[u].pPHVS->uCurrentBlockDataPackets = pPHVS->uCurrentBlockDataPackets;
+         m_VideoBlocks[iBufferIndex].packets[u].pPHVS->uCurrentBlockECPackets = pPHVS->uCurrentBlockECPackets;
       }
    }
 
-   if ( ! _check_allocate_video_block_in_buffer(iBufferIndex) )
-      return false;
-
    if ( m_bBuffersEmpty )
       log_line("[VRXBuffers] Start adding video packets to empty buffer. Adding [%u/%u] at buffer index %d",
          pPHVS->uCurrentBlockIndex, pPHVS->uCurrentBlockPacketIndex, m_iTopBufferIndex);
@@ -426,8 +405,8 @@ bool VideoRxPacketsBuffer::_add_video_packet_to_buffer(int iBufferIndex, u8* pPa
    }
 
    m_VideoBlocks[iBufferIndex].packets[pPHVS->uCurrentBlockPacketIndex].uReceivedTime = g_TimeNow;
-   m_VideoBlocks[iBufferIndex].packets[pPHVS->uCurrentBlockPacketIndex].bEmpty = false;
-   m_VideoBlocks[iBufferIndex].packets[pPHVS->uCurrentBlockPacketIndex].bReconstructed = false;
+   m_VideoBlocks[iBufferIndex].uReceivedPacketsMask |= ((u32)1) << pPHVS->uCurrentBlockPacketIndex;
+   m_VideoBlocks[iBufferIndex].uReconstructedPacketsMask &= ~(((u32)1) << pPHVS->uCurrentBlockPacketIndex);
    
    memcpy(m_VideoBlocks[iBufferIndex].packets[pPHVS->uCurrentBlockPacketIndex].pRawData, pPacket, iPacketLength);
    
@@ -459,9 +438,11 @@ bool VideoRxPacketsBuffer::hasVideoPacket(u32 uVideoBlockIndex, u32 uVideoBlockP
    int iBufferIndex = m_iBottomBufferIndex + (int) uDiffBlocks;
    iBufferIndex = iBufferIndex % MAX_RXTX_BLOCKS_BUFFER;
 
-   if ( m_VideoBlocks[iBufferIndex].packets[uVideoBlockPacketIndex].bEmpty )
+   if ( uVideoBlockPacketIndex >= MAX_TOTAL_PACKETS_IN_BLOCK )
       return false;
-   return true;
+   if ( RX_VIDEO_BLOCK_HAS_PACKET(&m_VideoBlocks[iBufferIndex], uVideoBlockPacketIndex) )
+      return true;
+   return false;
 }
 
 // Returns true if the packet was added
@@ -532,9 +513,6 @@ bool VideoRxPacketsBuffer::checkAddVideoPacket(u8* pPacket, int iPacketLength)
       if ( iNextTop >= MAX_RXTX_BLOCKS_BUFFER )
          iNextTop = 0;
 
-      if ( ! _check_allocate_video_block_in_buffer(iNextTop) )
-         return false;
-
       _empty_block_buffer_index(iNextTop);
       m_VideoBlocks[iNextTop].uH264FrameIndex = 0;
       m_VideoBlocks[iNextTop].iTotalFramePackets = 0;
@@ -3,6 +3,7 @@
 #include "../base/base.h"
 #include "../base/config.h"
 #include "../base/models.h"
+#include "../base/packets_slab.h"
 #include "../radio/radiopackets2.h"
 
 
@@ -12,17 +13,19 @@
 //                                       [    <- video block packet size ->          ]
 //                                                                   [-vid size-]
 
+// Packets raw data is in the buffer slab: packet k of buffer block i is slot i*MAX_TOTAL_PACKETS_IN_BLOCK + k,
+// so the packets of a block (data, then EC) are contiguous, at a fixed stride.
+// The pointers are set once, when the slab is allocated.
+
 typedef struct
 {
-   u8* pRawData;
+   u8* pRawData; // pointer inside the buffer slab
    u8* pVideoData; // pointer inside pRawData
    t_packet_header* pPH; // pointer inside pRawData
    t_packet_header_video_segment* pPHVS; // pointer inside pRawData
    t_packet_header_video_segment_important* pPHVSImp; // pointer inside pRawData
    u32 uReceivedTime;
    u32 uRequestedTime; // non zero if it was requested for retransmission
-   bool bEmpty;
-   bool bReconstructed;
 }
 type_rx_video_packet_info;
 
@@ -44,9 +47,14 @@ typedef struct
    int iRecvDataPackets;
    int iRecvECPackets;
    int iReconstructedECUsed;
+   u32 uReceivedPacketsMask; // bit k set: block packet k (data or EC) is present, received or reconstructed
+   u32 uReconstructedPacketsMask; // bit k set: block data packet k was reconstructed using EC packets
 }
 type_rx_video_block_info;
 
+#define RX_VIDEO_BLOCK_HAS_PACKET(pBlock, iPacketIndex) ((pBlock)->uReceivedPacketsMask & (((u32)1) << (iPacketIndex)))
+#define RX_VIDEO_BLOCK_IS_PACKET_RECONSTRUCTED(pBlock, iPacketIndex) ((pBlock)->uReconstructedPacketsMask & (((u32)1) << (iPacketIndex)))
+
 typedef struct
 {
    unsigned int decode_missing_packets_indexes[MAX_TOTAL_PACKETS_IN_BLOCK];
@@ -87,8 +95,6 @@ class VideoRxPacketsBuffer
 
    protected:
 
-      bool _check_allocate_video_block_in_buffer(int iBufferIndex);
-      void _empty_block_buffer_packet_index(int iBufferIndex, int iPacketIndex);
       void _empty_block_buffer_index(int iBufferIndex);
       void _empty_buffers(const char* szReason, t_packet_header* pPH, t_packet_header_video_segment* pPHVS);
       void _check_do_ec_for_video_block(int iBufferIndex);
@@ -101,6 +107,7 @@ class VideoRxPacketsBuffer
       int m_iCameraIndex;
 
       // Buffers state
+      t_packets_slab m_PacketsSlab;
       type_rx_video_block_info m_VideoBlocks[MAX_RXTX_BLOCKS_BUFFER];
       u8 m_TempVideoBuffer[MAX_PACKET_TOTAL_SIZE];
       bool m_bBuffersEmpty;
@@ -0,0 +1,195 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../renderer/fbg_blend.h"
+
+// Checks that the vector blend kernels (SSE2/NEON) give the exact same pixels as the scalar kernels
+// and as a per pixel reference (fbg_pixela_fast math) for all lengths, alignments, skip modes and
+// random colors, then benchmarks them on a typical glyph row and a full screen row.
+
+#define TEST_MAX_PIXELS 80
+#define BENCH_MIN_DURATION_MICROS 50000
+
+u8 s_uSrc[(TEST_MAX_PIXELS+4)*4];
+u8 s_uDest[(TEST_MAX_PIXELS+4)*4];
+u8 s_uDestScalar[(TEST_MAX_PIXELS+4)*4];
+u8 s_uDestRef[(TEST_MAX_PIXELS+4)*4];
+
+void _reference_blend_pixel(u8* pDest, u8 r, u8 g, u8 b, u8 a, int iUpdateAlpha)
+{
+   if ( (pDest[3] == 255) || (0 == iUpdateAlpha) )
+   {
+      pDest[0] = ((a * r + (255 - a) * pDest[0]) >> 8);
+      pDest[1] = ((a * g + (255 - a) * pDest[1]) >> 8);
+      pDest[2] = ((a * b + (255 - a) * pDest[2]) >> 8);
+   }
+   else
+   {
+      pDest[0] = ((a * r + (255 - a) * pDest[0]) >> 8);
+      pDest[1] = ((a * g + (255 - a) * pDest[1]) >> 8);
+      pDest[2] = ((a * b + (255 - a) * pDest[2]) >> 8);
+      pDest[3] = pDest[3] + (((255 - pDest[3]) * a) >> 8);
+   }
+}
+
+void _reference_blend_row_tinted(u8* pDest, u8* pSrc, int iCount, u8* pMix, int iUpdateAlpha, int iSkipMode, bool bOpaque)
+{
+   for( int i=0; i<iCount; i++, pDest += 4, pSrc += 4 )
+   {
+      if ( ((iSkipMode == FBG_BLEND_SKIP_LOW_ALPHA) || bOpaque) && (pSrc[3] < 120) )
+         continue;
+      if ( (iSkipMode == FBG_BLEND_SKIP_DARK) && (pSrc[0] + pSrc[1] + pSrc[2] < 120) )
+         continue;
+      u8 r = (pSrc[0]*pMix[0])>>8;
+      u8 g = (pSrc[1]*pMix[1])>>8;
+      u8 b = (pSrc[2]*pMix[2])>>8;
+      u8 a = (pSrc[3]*pMix[3])>>8;
+      if ( bOpaque )
+      {
+         pDest[0] = r; pDest[1] = g; pDest[2] = b; pDest[3] = 0xFF;
+      }
+      else
+         _reference_blend_pixel(pDest, r, g, b, a, iUpdateAlpha);
+   }
+}
+
+void _randomize(u8* pBuffer, int iLength)
+{
+   for( int i=0; i<iLength; i++ )
+   {
+      int iRand = rand() % 8;
+      // Plenty of fully transparent, fully opaque and dark pixels, as in the font images
+      if ( iRand == 0 )
+         pBuffer[i] = 0;
+      else if ( iRand == 1 )
+         pBuffer[i] = 255;
+      else if ( iRand == 2 )
+         pBuffer[i] = 30 + rand() % 30;
+      else
+         pBuffer[i] = rand() & 0xFF;
+   }
+}
+
+// iKernel: 0 tinted, 1 tinted opaque, 2 color, 3 fill
+void _run_kernel(int iKernel, u8* pDest, int iCount, u8* pMix, int iUpdateAlpha, int iSkipMode, int iOffset)
+{
+   if ( 0 == iKernel )
+      fbg_blend_row_tinted(pDest, s_uSrc + iOffset*4, iCount, pMix, iUpdateAlpha, iSkipMode);
+   else if ( 1 == iKernel )
+      fbg_blend_row_tinted_opaque(pDest, s_uSrc + iOffset*4, iCount, pMix);
+   else if ( 2 == iKernel )
+      fbg_blend_row_color(pDest, iCount, pMix[0], pMix[1], pMix[2], pMix[3], iUpdateAlpha);
+   else
+      fbg_fill_row(pDest, iCount, ((u32)pMix[3] << 24) | ((u32)pMix[2] << 16) | ((u32)pMix[1] << 8) | pMix[0]);
+}
+
+void _run_reference(int iKernel, u8* pDest, int iCount, u8* pMix, int iUpdateAlpha, int iSkipMode, int iOffset)
+{
+   if ( 0 == iKernel )
+      _reference_blend_row_tinted(pDest, s_uSrc + iOffset*4, iCount, pMix, iUpdateAlpha, iSkipMode, false);
+   else if ( 1 == iKernel )
+      _reference_blend_row_tinted(pDest, s_uSrc + iOffset*4, iCount, pMix, 0, FBG_BLEND_SKIP_NONE, true);
+   else if ( 2 == iKernel )
+   {
+      for( int i=0; i<iCount; i++ )
+         _reference_blend_pixel(pDest + i*4, pMix[0], pMix[1], pMix[2], pMix[3], iUpdateAlpha);
+   }
+   else
+   {
+      for( int i=0; i<iCount; i++ )
+         memcpy(pDest + i*4, pMix, 4);
+   }
+}
+
+int _test_kernels()
+{
+   const char* szKernels[] = { "tinted", "tinted opaque", "color", "fill" };
+   int iErrors = 0;
+   for( int iKernel=0; iKernel<4; iKernel++ )
+   {
+      int iKernelErrors = 0;
+      for( int iRun=0; iRun<40; iRun++ )
+      for( int iSkipMode=FBG_BLEND_SKIP_NONE; iSkipMode<=FBG_BLEND_SKIP_DARK; iSkipMode++ )
+      for( int iUpdateAlpha=0; iUpdateAlpha<2; iUpdateAlpha++ )
+      for( int iOffset=0; iOffset<3; iOffset++ )
+      for( int iCount=0; iCount<=TEST_MAX_PIXELS; iCount++ )
+      {
+         u8 uMix[4];
+         _randomize(uMix, 4);
+         _randomize(s_uSrc, sizeof(s_uSrc));
+         _randomize(s_uDest, sizeof(s_uDest));
+         memcpy(s_uDestScalar, s_uDest, sizeof(s_uDest));
+         memcpy(s_uDestRef, s_uDest, sizeof(s_uDest));
+
+         fbg_blend_set_use_simd(1);
+         _run_kernel(iKernel, s_uDest + iOffset*4, iCount, uMix, iUpdateAlpha, iSkipMode, iOffset);
+         fbg_blend_set_use_simd(0);
+         _run_kernel(iKernel, s_uDestScalar + iOffset*4, iCount, uMix, iUpdateAlpha, iSkipMode, iOffset);
+         _run_reference(iKernel, s_uDestRef + iOffset*4, iCount, uMix, iUpdateAlpha, iSkipMode, iOffset);
+
+         if ( (0 != memcmp(s_uDest, s_uDestScalar, sizeof(s_uDest))) || (0 != memcmp(s_uDest, s_uDestRef, sizeof(s_uDest))) )
+            iKernelErrors++;
+      }
+      printf(" %s: %s\n", szKernels[iKernel], iKernelErrors?"MISMATCH":"ok");
+      iErrors += iKernelErrors;
+   }
+   return iErrors;
+}
+
+// Returns Mpixels/sec
+float _bench_kernel(int iKernel, u8* pDest, u8* pSrc, int iCount)
+{
+   u8 uMix[4] = { 200, 180, 255, 230 };
+   u32 uCount = 0;
+   u32 uTimeStart = get_current_timestamp_micros();
+   u32 uTimeNow = uTimeStart;
+   while ( uTimeNow - uTimeStart < BENCH_MIN_DURATION_MICROS )
+   {
+      for( int i=0; i<64; i++ )
+      {
+         if ( 0 == iKernel )
+            fbg_blend_row_tinted(pDest, pSrc, iCount, uMix, 1, FBG_BLEND_SKIP_DARK);
+         else
+            fbg_blend_row_color(pDest, iCount, uMix[0], uMix[1], uMix[2], uMix[3], 1);
+      }
+      uCount += 64;
+      uTimeNow = get_current_timestamp_micros();
+   }
+   return (float)uCount * (float)iCount / (float)(uTimeNow - uTimeStart);
+}
+
+int main(int argc, char *argv[])
+{
+   printf("\nTesting fbgraphics blend kernels\n");
+
+   fbg_blend_set_use_simd(1);
+   printf(" vector kernels: %s\n", fbg_blend_get_kernels_name());
+   int iErrors = _test_kernels();
+
+   int iBenchPixels[] = { 16, 1920 };
+   u8* pSrc = (u8*)malloc(1920*4);
+   u8* pDest = (u8*)malloc(1920*4);
+   _randomize(pSrc, 1920*4);
+   _randomize(pDest, 1920*4);
+   printf("\n  pixels |  glyph scalar  glyph simd |  rect scalar  rect simd  (Mpix/s)\n");
+   for( int k=0; k<2; k++ )
+   {
+      printf("  %6d |", iBenchPixels[k]);
+      for( int iKernel=0; iKernel<2; iKernel++ )
+      {
+         fbg_blend_set_use_simd(0);
+         float fScalar = _bench_kernel(iKernel, pDest, pSrc, iBenchPixels[k]);
+         fbg_blend_set_use_simd(1);
+         float fSIMD = _bench_kernel(iKernel, pDest, pSrc, iBenchPixels[k]);
+         printf(" %12.1f %10.1f |", fScalar, fSIMD);
+      }
+      printf("\n");
+   }
+   free(pSrc);
+   free(pDest);
+
+   if ( iErrors )
+      printf("\nBlend test failed: %d mismatches.\n", iErrors);
+   else
+      printf("\nBlend test passed.\n");
+   return (iErrors?1:0);
+}
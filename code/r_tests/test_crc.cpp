@@ -0,0 +1,91 @@
+#include "../base/base.h"
+#include "../base/config.h"
+
+// Checks that all CRC32 implementations match a bitwise reference CRC32
+// for all lengths and alignments, then benchmarks them on typical packet sizes.
+
+#define BENCH_MIN_DURATION_MICROS 50000
+
+int s_iBenchSizes[] = { 16, 64, 256, 1024, 1500, 4096 };
+const char* s_szImplementations[] = { "table", "slice8", "hw" };
+
+u32 _reference_crc32(u8* pData, int iLength)
+{
+   u32 uCRC = ~0U;
+   for( int i=0; i<iLength; i++ )
+   {
+      uCRC ^= pData[i];
+      for( int k=0; k<8; k++ )
+         uCRC = (uCRC >> 1) ^ (0xEDB88320 & (0 - (uCRC & 1)));
+   }
+   return ~uCRC;
+}
+
+// Returns MB/sec
+float _bench_crc(u8* pData, int iLength)
+{
+   u32 uCount = 0;
+   u32 uSum = 0;
+   u32 uTimeStart = get_current_timestamp_micros();
+   u32 uTimeNow = uTimeStart;
+   while ( uTimeNow - uTimeStart < BENCH_MIN_DURATION_MICROS )
+   {
+      for( int i=0; i<64; i++ )
+         uSum += base_compute_crc32(pData, iLength);
+      uCount += 64;
+      uTimeNow = get_current_timestamp_micros();
+   }
+   if ( uSum == 0x12345678 )
+      printf(" ");
+   return (float)uCount * (float)iLength / (float)(uTimeNow - uTimeStart);
+}
+
+int main(int argc, char *argv[])
+{
+   printf("\nTesting CRC32 implementations\n");
+
+   u8* pData = (u8*)malloc(8192);
+   for( int i=0; i<8192; i++ )
+      pData[i] = (u8)(rand() & 0xFF);
+
+   int iErrors = 0;
+   for( int iImpl=CRC32_IMPLEMENTATION_TABLE; iImpl<=CRC32_IMPLEMENTATION_HW; iImpl++ )
+   {
+      int iUsed = base_crc32_set_implementation(iImpl);
+      if ( iUsed != iImpl )
+      {
+         printf(" %s: not available, skipped\n", s_szImplementations[iImpl]);
+         continue;
+      }
+      int iImplErrors = 0;
+      for( int iOffset=0; iOffset<16; iOffset++ )
+      for( int iLength=0; iLength<=2100; iLength++ )
+      {
+         if ( base_compute_crc32(pData + iOffset, iLength) != _reference_crc32(pData + iOffset, iLength) )
+            iImplErrors++;
+      }
+      printf(" %s (%s): %s\n", s_szImplementations[iImpl], base_crc32_get_implementation_name(), iImplErrors?"MISMATCH":"ok");
+      iErrors += iImplErrors;
+   }
+
+   printf("\n  size |      table     slice8         hw  (MB/s)\n");
+   for( int k=0; k<(int)(sizeof(s_iBenchSizes)/sizeof(s_iBenchSizes[0])); k++ )
+   {
+      printf("  %4d |", s_iBenchSizes[k]);
+      for( int iImpl=CRC32_IMPLEMENTATION_TABLE; iImpl<=CRC32_IMPLEMENTATION_HW; iImpl++ )
+      {
+         if ( base_crc32_set_implementation(iImpl) != iImpl )
+            printf("          -");
+         else
+            printf(" %10.1f", _bench_crc(pData, s_iBenchSizes[k]));
+      }
+      printf("\n");
+   }
+
+   free(pData);
+   if ( iErrors )
+      printf("\nCRC32 test failed: %d mismatches.\n", iErrors);
+   else
+      printf("\nCRC32 test passed.\n");
+   return (iErrors?1:0);
+}
@@ -0,0 +1,306 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/encr.h"
+#include "../base/chacha20_poly1305.h"
+#include "../radio/radiolink.h"
+
+// Checks that all the packet obfuscation implementations (epp/dpp) match the reference
+// byte loop for all lengths and alignments and checks the authenticated mode (eppa/dppa),
+// and that the radio link rx requires it when told to, then benchmarks them on typical packet sizes.
+
+#define BENCH_MIN_DURATION_MICROS 50000
+
+int s_iBenchSizes[] = { 16, 64, 256, 1024, 1500, 4096 };
+const char* s_szImplementations[] = { "bytes", "words", "simd" };
+char* s_szPasses[] = { (char*)"a", (char*)"pass", (char*)"ruby_fpv_7", (char*)"0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopq",
+   (char*)"longer than the max pass length, only the first MAX_PASS_LENGTH bytes are used. 0123456789abcdefghijklmnopqrstuvwxyz" };
+
+void _reference_epp(u8* pData, int iLength, const char* szPass)
+{
+   int iPassLength = strlen(szPass);
+   if ( iPassLength > MAX_PASS_LENGTH )
+      iPassLength = MAX_PASS_LENGTH;
+   for( int i=0; i<iLength; i++ )
+      pData[i] ^= (u8)szPass[i % iPassLength];
+}
+
+// Returns MB/sec
+float _bench_epp(u8* pData, int iLength)
+{
+   u32 uCount = 0;
+   u32 uTimeStart = get_current_timestamp_micros();
+   u32 uTimeNow = uTimeStart;
+   while ( uTimeNow - uTimeStart < BENCH_MIN_DURATION_MICROS )
+   {
+      for( int i=0; i<64; i++ )
+         epp(pData, iLength);
+      uCount += 64;
+      uTimeNow = get_current_timestamp_micros();
+   }
+   return (float)uCount * (float)iLength / (float)(uTimeNow - uTimeStart);
+}
+
+// Returns MB/sec
+float _bench_eppa(u8* pData, int iLength)
+{
+   u8 uHeader[20];
+   u8 uTrailer[ENC_AUTH_TRAILER_SIZE];
+   memset(uHeader, 0, sizeof(uHeader));
+   u32 uCount = 0;
+   u32 uTimeStart = get_current_timestamp_micros();
+   u32 uTimeNow = uTimeStart;
+   while ( uTimeNow - uTimeStart < BENCH_MIN_DURATION_MICROS )
+   {
+      for( int i=0; i<16; i++ )
+         eppa(1, uHeader, sizeof(uHeader), pData, iLength, uTrailer);
+      uCount += 16;
+      uTimeNow = get_current_timestamp_micros();
+   }
+   return (float)uCount * (float)iLength / (float)(uTimeNow - uTimeStart);
+}
+
+// Test vectors from RFC 8439 (ChaCha20 and Poly1305 for IETF Protocols)
+static const char* s_szRFCPolyKey = "85d6be7857556d337f4452fe42d506a80103808afb0db2fd4abff6af4149f51b";
+static const char* s_szRFCPolyMessage = "Cryptographic Forum Research Group";
+static const char* s_szRFCPolyTag = "a8061dc1305136c6c22b8baf0c0127a9";
+
+static const char* s_szRFCAEADKey = "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f";
+static const char* s_szRFCAEADNonce = "070000004041424344454647";
+static const char* s_szRFCAEADAAD = "50515253c0c1c2c3c4c5c6c7";
+static const char* s_szRFCAEADPlaintext = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it.";
+static const char* s_szRFCAEADCiphertext =
+   "d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6"
+   "3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36"
+   "92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+   "3ff4def08e4b7a9de576d26586cec64b6116";
+static const char* s_szRFCAEADTag = "1ae10b594f09e26a7e902ecbd0600691";
+
+int _hex_to_bytes(const char* szHex, u8* pOutput)
+{
+   int iLength = strlen(szHex)/2;
+   for( int i=0; i<iLength; i++ )
+   {
+      unsigned int uByte = 0;
+      sscanf(szHex + 2*i, "%2x", &uByte);
+      pOutput[i] = (u8)uByte;
+   }
+   return iLength;
+}
+
+// RFC 8439 section 2.5.2 (Poly1305) and section 2.8.2 (AEAD): exact bytes
+int _test_rfc8439_vectors()
+{
+   int iErrors = 0;
+   u8 uKey[CHACHA20_POLY1305_KEY_SIZE];
+   u8 uNonce[CHACHA20_POLY1305_NONCE_SIZE];
+   u8 uAAD[16];
+   u8 uData[256];
+   u8 uExpected[256];
+   u8 uTag[CHACHA20_POLY1305_TAG_SIZE];
+   u8 uExpectedTag[CHACHA20_POLY1305_TAG_SIZE];
+
+   _hex_to_bytes(s_szRFCPolyKey, uKey);
+   _hex_to_bytes(s_szRFCPolyTag, uExpectedTag);
+   poly1305_mac(uKey, (const u8*)s_szRFCPolyMessage, strlen(s_szRFCPolyMessage), uTag);
+   if ( 0 != memcmp(uTag, uExpectedTag, CHACHA20_POLY1305_TAG_SIZE) )
+      iErrors++;
+
+   _hex_to_bytes(s_szRFCAEADKey, uKey);
+   _hex_to_bytes(s_szRFCAEADNonce, uNonce);
+   int iAADLength = _hex_to_bytes(s_szRFCAEADAAD, uAAD);
+   int iLength = strlen(s_szRFCAEADPlaintext);
+   if ( _hex_to_bytes(s_szRFCAEADCiphertext, uExpected) != iLength )
+      iErrors++;
+   _hex_to_bytes(s_szRFCAEADTag, uExpectedTag);
+   memcpy(uData, s_szRFCAEADPlaintext, iLength);
+   chacha20_poly1305_seal(uKey, uNonce, uAAD, iAADLength, uData, iLength, uTag);
+   if ( 0 != memcmp(uData, uExpected, iLength) )
+      iErrors++;
+   if ( 0 != memcmp(uTag, uExpectedTag, CHACHA20_POLY1305_TAG_SIZE) )
+      iErrors++;
+   if ( ! chacha20_poly1305_open(uKey, uNonce, uAAD, iAADLength, uData, iLength, uTag) )
+      iErrors++;
+   else if ( 0 != memcmp(uData, s_szRFCAEADPlaintext, iLength) )
+      iErrors++;
+   return iErrors;
+}
+
+int _test_authenticated()
+{
+   int iErrors = 0;
+   u8 uHeader[20];
+   u8 uData[1500];
+   u8 uCopy[1500];
+   u8 uTrailer[ENC_AUTH_TRAILER_SIZE];
+   for( int i=0; i<(int)sizeof(uHeader); i++ )
+      uHeader[i] = (u8)i;
+   for( int i=0; i<(int)sizeof(uData); i++ )
+      uData[i] = (u8)(rand() & 0xFF);
+
+   for( int iLength=0; iLength<=(int)sizeof(uData); iLength += 37 )
+   {
+      memcpy(uCopy, uData, iLength);
+      eppa(7, uHeader, sizeof(uHeader), uCopy, iLength, uTrailer);
+      if ( (iLength > 16) && (0 == memcmp(uCopy, uData, iLength)) )
+         iErrors++;
+      if ( ! dppa(7, uHeader, sizeof(uHeader), uCopy, iLength, uTrailer) )
+         iErrors++;
+      else if ( 0 != memcmp(uCopy, uData, iLength) )
+         iErrors++;
+
+      // Tampered header, data, sender and nonce must be rejected
+      eppa(7, uHeader, sizeof(uHeader), uCopy, iLength, uTrailer);
+      uHeader[3] ^= 0x01;
+      if ( dppa(7, uHeader, sizeof(uHeader), uCopy, iLength, uTrailer) )
+         iErrors++;
+      uHeader[3] ^= 0x01;
+      if ( dppa(8, uHeader, sizeof(uHeader), uCopy, iLength, uTrailer) )
+         iErrors++;
+      uTrailer[0] ^= 0x80;
+      if ( dppa(7, uHeader, sizeof(uHeader), uCopy, iLength, uTrailer) )
+         iErrors++;
+      uTrailer[0] ^= 0x80;
+      if ( iLength > 0 )
+      {
+         uCopy[iLength-1] ^= 0x01;
+         if ( dppa(7, uHeader, sizeof(uHeader), uCopy, iLength, uTrailer) )
+            iErrors++;
+      }
+   }
+   return iErrors;
+}
+
+// Builds a radio packet of the given length, authenticated as the radio link tx does it
+int _build_packet(u8* pPacket, int iLength, bool bAuthenticated)
+{
+   t_packet_header* pPH = (t_packet_header*)pPacket;
+   radio_packet_init(pPH, PACKET_COMPONENT_RUBY, PACKET_TYPE_RUBY_PING_CLOCK, STREAM_ID_DATA);
+   pPH->vehicle_id_src = 7;
+   pPH->total_length = iLength;
+   for( int i=sizeof(t_packet_header); i<iLength; i++ )
+      pPacket[i] = (u8)(rand() & 0xFF);
+   radio_packet_compute_crc(pPacket, iLength);
+   if ( ! bAuthenticated )
+      return iLength;
+   int dx = sizeof(t_packet_header);
+   pPH->total_length += ENC_AUTH_TRAILER_SIZE;
+   pPH->packet_flags |= PACKET_FLAGS_BIT_HAS_AUTH_ENCRYPTION;
+   eppa(pPH->vehicle_id_src, pPacket, dx, pPacket+dx, iLength-dx, pPacket+iLength);
+   return pPH->total_length;
+}
+
+int _test_radio_require_auth()
+{
+   int iErrors = 0;
+   u8 uPacket[MAX_PACKET_TOTAL_SIZE + 512];
+   u8 uRawPacket[MAX_PACKET_TOTAL_SIZE + 512];
+   int iCRCOk = 0;
+
+   radio_set_require_auth_encryption(0, 0);
+   int iLength = _build_packet(uPacket, 200, false);
+   if ( (iLength != packet_process_and_check(0, uPacket, iLength, &iCRCOk)) || (! iCRCOk) )
+      iErrors++;
+   iLength = _build_packet(uPacket, 200, true);
+   if ( (200 != packet_process_and_check(0, uPacket, iLength, &iCRCOk)) || (! iCRCOk) )
+      iErrors++;
+
+   radio_set_require_auth_encryption(1, 9);
+   iLength = _build_packet(uPacket, 200, false);
+   if ( (0 != packet_process_and_check(0, uPacket, iLength, &iCRCOk)) || (get_last_processing_error_code() != RADIO_PROCESSING_ERROR_CODE_AUTHENTICATION_FAILED) )
+      iErrors++;
+   iLength = _build_packet(uPacket, 200, false);
+   ((t_packet_header*)uPacket)->packet_flags |= PACKET_FLAGS_BIT_HAS_ENCRYPTION;
+   if ( 0 != packet_process_and_check(0, uPacket, iLength, &iCRCOk) )
+      iErrors++;
+   iLength = _build_packet(uPacket, 200, true);
+   if ( (200 != packet_process_and_check(0, uPacket, iLength, &iCRCOk)) || (! iCRCOk) )
+      iErrors++;
+   // The relayed vehicle (9) has its own encryption settings
+   iLength = _build_packet(uPacket, 200, false);
+   ((t_packet_header*)uPacket)->vehicle_id_src = 9;
+   radio_packet_compute_crc(uPacket, iLength);
+   if ( (iLength != packet_process_and_check(0, uPacket, iLength, &iCRCOk)) || (! iCRCOk) )
+      iErrors++;
+   radio_set_require_auth_encryption(0, 0);
+
+   // The tx drops the packets the trailer does not fit in, it does not send them obfuscated
+   _build_packet(uPacket, MAX_PACKET_TOTAL_SIZE - 10, false);
+   if ( 0 != radio_build_new_raw_ieee_packet(0, uRawPacket, uPacket, MAX_PACKET_TOTAL_SIZE - 10, RADIO_PORT_ROUTER_DOWNLINK, ENC_MODE_AUTHENTICATED) )
+      iErrors++;
+   _build_packet(uPacket, 1000, false);
+   if ( radio_build_new_raw_ieee_packet(0, uRawPacket, uPacket, 1000, RADIO_PORT_ROUTER_DOWNLINK, ENC_MODE_AUTHENTICATED) <= 1000 + ENC_AUTH_TRAILER_SIZE )
+      iErrors++;
+   return iErrors;
+}
+
+int main(int argc, char *argv[])
+{
+   printf("\nTesting packets encryption implementations\n");
+
+   u8* pData = (u8*)malloc(8192);
+   u8* pCopy = (u8*)malloc(8192);
+   for( int i=0; i<8192; i++ )
+      pData[i] = (u8)(rand() & 0xFF);
+
+   int iErrors = 0;
+   for( int iImpl=ENC_IMPLEMENTATION_BYTES; iImpl<=ENC_IMPLEMENTATION_SIMD; iImpl++ )
+   {
+      int iUsed = encr_set_implementation(iImpl);
+      if ( iUsed != iImpl )
+      {
+         printf(" %s: not available, skipped\n", s_szImplementations[iImpl]);
+         continue;
+      }
+      int iImplErrors = 0;
+      for( int iPass=0; iPass<(int)(sizeof(s_szPasses)/sizeof(s_szPasses[0])); iPass++ )
+      {
+         upp(s_szPasses[iPass]);
+         for( int iOffset=0; iOffset<16; iOffset++ )
+         for( int iLength=0; iLength<=4200; iLength += ((iLength < 300)?1:7) )
+         {
+            memcpy(pCopy, pData + iOffset, iLength);
+            epp(pCopy, iLength);
+            _reference_epp(pCopy, iLength, s_szPasses[iPass]);
+            if ( 0 != memcmp(pCopy, pData + iOffset, iLength) )
+               iImplErrors++;
+         }
+      }
+      printf(" %s (%s): %s\n", s_szImplementations[iImpl], encr_get_implementation_name(), iImplErrors?"MISMATCH":"ok");
+      iErrors += iImplErrors;
+   }
+
+   upp(s_szPasses[2]);
+   int iRFCErrors = _test_rfc8439_vectors();
+   printf(" RFC 8439 poly1305 and aead vectors (%s): %s\n", chacha20_get_implementation_name(), iRFCErrors?"FAILED":"ok");
+   iErrors += iRFCErrors;
+
+   int iAuthErrors = _test_authenticated();
+   printf(" authenticated (chacha20-poly1305, %s): %s\n", chacha20_get_implementation_name(), iAuthErrors?"FAILED":"ok");
+   iErrors += iAuthErrors;
+
+   int iRadioErrors = _test_radio_require_auth();
+   printf(" radio link requires authentication: %s\n", iRadioErrors?"FAILED":"ok");
+   iErrors += iRadioErrors;
+
+   printf("\n  size |      bytes      words       simd  chacha-poly  (MB/s)\n");
+   for( int k=0; k<(int)(sizeof(s_iBenchSizes)/sizeof(s_iBenchSizes[0])); k++ )
+   {
+      printf("  %4d |", s_iBenchSizes[k]);
+      for( int iImpl=ENC_IMPLEMENTATION_BYTES; iImpl<=ENC_IMPLEMENTATION_SIMD; iImpl++ )
+      {
+         if ( encr_set_implementation(iImpl) != iImpl )
+            printf("          -");
+         else
+            printf(" %10.1f", _bench_epp(pData, s_iBenchSizes[k]));
+      }
+      printf(" %12.1f\n", _bench_eppa(pData, s_iBenchSizes[k]));
+   }
+
+   free(pData);
+   free(pCopy);
+   if ( iErrors )
+      printf("\nEncryption test failed: %d errors.\n", iErrors);
+   else
+      printf("\nEncryption test passed.\n");
+   return (iErrors?1:0);
+}
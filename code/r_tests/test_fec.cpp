@@ -6,90 +6,202 @@
 
 #include "../radio/fec.h"
 
-int packet_length = 32;
-int packets_per_block = 6;
-int fecs_per_block = 3;
+// Benchmarks FEC encode/decode for every (data packets, EC packets, block size)
+// combination the video profiles can use, for both scalar and vector kernels,
+// and checks that the decoded data matches the original data.
+// Also checks that the scalar and vector kernels are interchangeable (a vehicle and a
+// station can use different ones): same parity bytes, and each one decodes the other's blocks.
 
-#define MAX_PACKETS 64
+#define BENCH_MIN_DURATION_MICROS 20000
 
+int s_iBlockSizes[] = { 256, 512, 768, DEFAULT_VIDEO_DATA_LENGTH, MAX_VIDEO_PACKET_DATA_SIZE };
 
-u8* packetsArray[MAX_PACKETS];
-u8* fecsArray[MAX_PACKETS];
-u8* fecsForDecode[MAX_PACKETS];
+u8* packetsArray[MAX_TOTAL_PACKETS_IN_BLOCK];
+u8* packetsOriginal[MAX_TOTAL_PACKETS_IN_BLOCK];
+u8* fecsArray[MAX_TOTAL_PACKETS_IN_BLOCK];
+u8* fecsForDecode[MAX_TOTAL_PACKETS_IN_BLOCK];
+u8* fecsScalar[MAX_TOTAL_PACKETS_IN_BLOCK];
 
-void print_all()
+// Returns MB/sec of data packets processed
+float _bench_encode(int iPacketLength, int iDataPackets, int iECPackets)
 {
-   for( int i=0; i<packets_per_block; i++ )
+   u32 uCount = 0;
+   u32 uTimeStart = get_current_timestamp_micros();
+   u32 uTimeNow = uTimeStart;
+   while ( uTimeNow - uTimeStart < BENCH_MIN_DURATION_MICROS )
    {
-      printf("\nPacket %d: ", i);
-      for( int j=0; j<packet_length; j++ )
-         printf("%d,", packetsArray[i][j]); 
+      for( int i=0; i<16; i++ )
+         fec_encode(iPacketLength, packetsArray, iDataPackets, fecsArray, iECPackets);
+      uCount += 16;
+      uTimeNow = get_current_timestamp_micros();
    }
-   printf("\n");
-   for( int i=0; i<fecs_per_block; i++ )
-   {
-      printf("\nFEC %d: ", i);
-      for( int j=0; j<packet_length; j++ )
-         printf("%d,", fecsArray[i][j]); 
-   }
-   printf("\n");
+   float fBytes = (float)uCount * (float)iPacketLength * (float)iDataPackets;
+   return fBytes / (float)(uTimeNow - uTimeStart);
 }
 
-int main(int argc, char *argv[])
+// Decodes the worst case (as many missing data packets as EC packets)
+// Returns MB/sec of data packets processed, or -1 on decode mismatch
+float _bench_decode(int iPacketLength, int iDataPackets, int iECPackets)
 {
-   printf("\nTesting FEC encode/decode\n");
+   unsigned int fec_block_nos[MAX_TOTAL_PACKETS_IN_BLOCK];
+   unsigned int erased_blocks[MAX_TOTAL_PACKETS_IN_BLOCK];
+   int iMissing = (iECPackets < iDataPackets)?iECPackets:iDataPackets;
 
-   fec_init();
+   fec_encode(iPacketLength, packetsArray, iDataPackets, fecsArray, iECPackets);
 
-   for( int i=0; i<packets_per_block; i++ )
+   for( int i=0; i<iMissing; i++ )
    {
-      packetsArray[i] = (u8*)malloc(packet_length);
-      for( int j=0; j<packet_length; j++ )
-         packetsArray[i][j] = 32 + i + j;
+      erased_blocks[i] = (u32)(i * iDataPackets / iMissing);
+      fec_block_nos[i] = (u32)(iECPackets - 1 - i);
    }
-   for( int i=0; i<fecs_per_block; i++ )
+
+   u32 uCount = 0;
+   u32 uTimeStart = get_current_timestamp_micros();
+   u32 uTimeNow = uTimeStart;
+   while ( uTimeNow - uTimeStart < BENCH_MIN_DURATION_MICROS )
    {
-      fecsArray[i] = (u8*)malloc(packet_length);
+      for( int i=0; i<iMissing; i++ )
+      {
+         // fec_decode overwrites the EC packets it uses, so work on a copy
+         memcpy(fecsForDecode[i], fecsArray[fec_block_nos[i]], iPacketLength);
+         memset(packetsArray[erased_blocks[i]], 0, iPacketLength);
+      }
+      fec_decode(iPacketLength, packetsArray, iDataPackets, fecsForDecode, fec_block_nos, erased_blocks, iMissing);
+      uCount++;
+      uTimeNow = get_current_timestamp_micros();
    }
 
-   print_all();
-
-   fec_encode(packet_length, packetsArray, packets_per_block, fecsArray, fecs_per_block);
+   for( int i=0; i<iDataPackets; i++ )
+   {
+      if ( 0 != memcmp(packetsArray[i], packetsOriginal[i], iPacketLength) )
+         return -1.0;
+   }
+   float fBytes = (float)uCount * (float)iPacketLength * (float)iDataPackets;
+   return fBytes / (float)(uTimeNow - uTimeStart);
+}
 
-   printf("\nEncode result:\n");
-   print_all();
+// Decodes the worst case using the EC packets in pFECs with the current kernels.
+// Returns true if the decoded data matches the original data
+bool _decode_with(u8** pFECs, int iPacketLength, int iDataPackets, int iECPackets)
+{
+   unsigned int fec_block_nos[MAX_TOTAL_PACKETS_IN_BLOCK];
+   unsigned int erased_blocks[MAX_TOTAL_PACKETS_IN_BLOCK];
+   int iMissing = (iECPackets < iDataPackets)?iECPackets:iDataPackets;
 
+   for( int i=0; i<iMissing; i++ )
+   {
+      erased_blocks[i] = (u32)(i * iDataPackets / iMissing);
+      fec_block_nos[i] = (u32)(iECPackets - 1 - i);
+      memcpy(fecsForDecode[i], pFECs[fec_block_nos[i]], iPacketLength);
+      memset(packetsArray[erased_blocks[i]], 0, iPacketLength);
+   }
+   fec_decode(iPacketLength, packetsArray, iDataPackets, fecsForDecode, fec_block_nos, erased_blocks, iMissing);
 
-   for( int j=0; j<packet_length; j++ )
-    {
-      packetsArray[2][j] = 0;
-      packetsArray[4][j] = 0;
-      fecsArray[1][j] = 0;
-    }
+   bool bOk = true;
+   for( int i=0; i<iDataPackets; i++ )
+   {
+      if ( 0 != memcmp(packetsArray[i], packetsOriginal[i], iPacketLength) )
+         bOk = false;
+      memcpy(packetsArray[i], packetsOriginal[i], iPacketLength);
+   }
+   return bOk;
+}
 
-   printf("\nRandomised data:\n");
-   print_all();
+// Returns the number of interoperability errors between the scalar and vector kernels
+int _check_kernels_interop(int iPacketLength, int iDataPackets, int iECPackets)
+{
+   int iErrors = 0;
+   fec_set_use_simd(0);
+   fec_encode(iPacketLength, packetsArray, iDataPackets, fecsScalar, iECPackets);
+   fec_set_use_simd(1);
+   fec_encode(iPacketLength, packetsArray, iDataPackets, fecsArray, iECPackets);
 
-   //the following three fields are infos for fec_decode
-    unsigned int fec_block_nos[MAX_PACKETS];
-    unsigned int erased_blocks[MAX_PACKETS];
-    unsigned int nr_fec_blocks = 0;
+   for( int i=0; i<iECPackets; i++ )
+   {
+      if ( 0 != memcmp(fecsScalar[i], fecsArray[i], iPacketLength) )
+      {
+         printf("  %2d  %2d  %4d : parity packet %d differs between scalar and %s kernels\n", iDataPackets, iECPackets, iPacketLength, i, fec_get_kernels_name());
+         iErrors++;
+      }
+   }
 
-    erased_blocks[0] = 2;
-    fec_block_nos[0] = 0;
-    fecsForDecode[0] = fecsArray[0];
+   // Vector encoded, scalar decoded and the other way around
+   fec_set_use_simd(0);
+   if ( ! _decode_with(fecsArray, iPacketLength, iDataPackets, iECPackets) )
+   {
+      printf("  %2d  %2d  %4d : %s encoded block failed scalar decode\n", iDataPackets, iECPackets, iPacketLength, fec_get_kernels_name());
+      iErrors++;
+   }
+   fec_set_use_simd(1);
+   if ( ! _decode_with(fecsScalar, iPacketLength, iDataPackets, iECPackets) )
+   {
+      printf("  %2d  %2d  %4d : scalar encoded block failed %s decode\n", iDataPackets, iECPackets, iPacketLength, fec_get_kernels_name());
+      iErrors++;
+   }
+   return iErrors;
+}
 
-    erased_blocks[1] = 4;
-    fec_block_nos[1] = 2;
-    fecsForDecode[1] = fecsArray[2];
+int main(int argc, char *argv[])
+{
+   printf("\nBenchmarking FEC encode/decode\n");
 
-    nr_fec_blocks = 2;
+   fec_init();
 
-   fec_decode(packet_length, packetsArray, packets_per_block, fecsForDecode, fec_block_nos, erased_blocks, nr_fec_blocks );
+   for( int i=0; i<MAX_TOTAL_PACKETS_IN_BLOCK; i++ )
+   {
+      packetsArray[i] = (u8*)malloc(MAX_PACKET_TOTAL_SIZE);
+      packetsOriginal[i] = (u8*)malloc(MAX_PACKET_TOTAL_SIZE);
+      fecsArray[i] = (u8*)malloc(MAX_PACKET_TOTAL_SIZE);
+      fecsForDecode[i] = (u8*)malloc(MAX_PACKET_TOTAL_SIZE);
+      fecsScalar[i] = (u8*)malloc(MAX_PACKET_TOTAL_SIZE);
+      for( int j=0; j<MAX_PACKET_TOTAL_SIZE; j++ )
+         packetsOriginal[i][j] = (u8)(rand() & 0xFF);
+      memcpy(packetsArray[i], packetsOriginal[i], MAX_PACKET_TOTAL_SIZE);
+   }
 
-   printf("\nDecoded data:\n");
-   print_all();
+   int iErrors = 0;
+   int iInteropErrors = 0;
+   printf("\nChecking scalar and %s kernels interoperability\n", fec_get_kernels_name());
+   for( int iData=1; iData<=MAX_DATA_PACKETS_IN_BLOCK; iData++ )
+   for( int iEC=1; iEC<=MAX_FECS_PACKETS_IN_BLOCK; iEC++ )
+   {
+      if ( iData + iEC > MAX_TOTAL_PACKETS_IN_BLOCK )
+         continue;
+      for( int k=0; k<(int)(sizeof(s_iBlockSizes)/sizeof(s_iBlockSizes[0])); k++ )
+         iInteropErrors += _check_kernels_interop(s_iBlockSizes[k], iData, iEC);
+      // Sizes that are not a multiple of the vector width
+      iInteropErrors += _check_kernels_interop(37, iData, iEC);
+      iInteropErrors += _check_kernels_interop(1001, iData, iEC);
+   }
+   printf(" %s\n", iInteropErrors?"MISMATCH":"ok");
+   iErrors += iInteropErrors;
 
+   printf("\n data  ec  size | enc scalar  enc %-6s | dec scalar  dec %-6s  (MB/s)\n", fec_get_kernels_name(), fec_get_kernels_name());
+   for( int iData=1; iData<=MAX_DATA_PACKETS_IN_BLOCK; iData++ )
+   for( int iEC=1; iEC<=MAX_FECS_PACKETS_IN_BLOCK; iEC++ )
+   {
+      if ( iData + iEC > MAX_TOTAL_PACKETS_IN_BLOCK )
+         continue;
+      for( int k=0; k<(int)(sizeof(s_iBlockSizes)/sizeof(s_iBlockSizes[0])); k++ )
+      {
+         int iSize = s_iBlockSizes[k];
+         fec_set_use_simd(0);
+         float fEncScalar = _bench_encode(iSize, iData, iEC);
+         float fDecScalar = _bench_decode(iSize, iData, iEC);
+         fec_set_use_simd(1);
+         float fEncSIMD = _bench_encode(iSize, iData, iEC);
+         float fDecSIMD = _bench_decode(iSize, iData, iEC);
+         if ( (fDecScalar < 0.0) || (fDecSIMD < 0.0) )
+            iErrors++;
+         printf("  %2d  %2d  %4d | %10.1f  %10.1f | %10.1f  %10.1f %s\n",
+            iData, iEC, iSize, fEncScalar, fEncSIMD, fDecScalar, fDecSIMD,
+            ((fDecScalar < 0.0) || (fDecSIMD < 0.0))?"DECODE FAILED":"");
+      }
+   }
 
-   return (0);
-} 
+   if ( iErrors )
+      printf("\nFEC test failed: %d decode/interoperability mismatches.\n", iErrors);
+   else
+      printf("\nFEC test passed.\n");
+   return (iErrors?1:0);
+}
@@ -0,0 +1,178 @@
+#include <sys/wait.h>
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/ruby_ipc.h"
+#include "../radio/radiopackets2.h"
+#include "../radio/local_packets.h"
+
+// Benchmarks IPC round trip latency and one way throughput between two processes,
+// for both the message queues and the shared memory rings backends.
+
+#define BENCH_PING_PONG_COUNT 5000
+#define BENCH_THROUGHPUT_COUNT 50000
+#define BENCH_MSG_SIZE 1200
+#define BENCH_WAIT_TIMEOUT_MS 2000
+
+u8 s_uBuffer[MAX_PACKET_TOTAL_SIZE];
+u8 s_uTempBuffer[MAX_PACKET_TOTAL_SIZE];
+int s_iTempBufferPos = 0;
+
+void _build_message(u32 uIndex, int iLength)
+{
+   t_packet_header* pPH = (t_packet_header*)s_uBuffer;
+   radio_packet_init(pPH, PACKET_COMPONENT_LOCAL_CONTROL, PACKET_TYPE_LOCAL_CONTROL_PREFERENCES_UPDATED, STREAM_ID_DATA);
+   pPH->total_length = iLength;
+   memcpy(s_uBuffer + sizeof(t_packet_header), &uIndex, sizeof(u32));
+}
+
+// Returns NULL if nothing was received in BENCH_WAIT_TIMEOUT_MS
+u8* _wait_message(int iChannel)
+{
+   u32 uTimeStart = get_current_timestamp_ms();
+   while ( get_current_timestamp_ms() < uTimeStart + BENCH_WAIT_TIMEOUT_MS )
+   {
+      u8* pMsg = ruby_ipc_try_read_message(iChannel, s_uTempBuffer, &s_iTempBufferPos, s_uBuffer);
+      if ( NULL != pMsg )
+         return pMsg;
+   }
+   return NULL;
+}
+
+// Returns false if the channel stayed full for BENCH_WAIT_TIMEOUT_MS
+bool _send_message(int iChannel, u8* pMsg, int iLength)
+{
+   u32 uTimeStart = get_current_timestamp_ms();
+   while ( ! ruby_ipc_channel_send_message(iChannel, pMsg, iLength) )
+   {
+      if ( get_current_timestamp_ms() >= uTimeStart + BENCH_WAIT_TIMEOUT_MS )
+         return false;
+      hardware_sleep_micros(10);
+   }
+   return true;
+}
+
+// Reader process: echoes the ping pong messages back, then consumes the throughput messages
+void _run_child()
+{
+   int iRead = ruby_open_ipc_channel_read_endpoint(IPC_CHANNEL_TYPE_ROUTER_TO_TELEMETRY);
+   int iWrite = ruby_open_ipc_channel_write_endpoint(IPC_CHANNEL_TYPE_TELEMETRY_TO_ROUTER);
+   if ( (iRead <= 0) || (iWrite <= 0) )
+      exit(1);
+
+   for( int i=0; i<BENCH_PING_PONG_COUNT; i++ )
+   {
+      u8* pMsg = _wait_message(iRead);
+      if ( NULL == pMsg )
+         exit(1);
+      t_packet_header* pPH = (t_packet_header*)pMsg;
+      if ( ! _send_message(iWrite, pMsg, pPH->total_length) )
+         exit(1);
+   }
+
+   int iErrors = 0;
+   for( u32 i=0; i<BENCH_THROUGHPUT_COUNT; i++ )
+   {
+      u8* pMsg = _wait_message(iRead);
+      if ( NULL == pMsg )
+         exit(1);
+      u32 uIndex = 0;
+      memcpy(&uIndex, pMsg + sizeof(t_packet_header), sizeof(u32));
+      if ( (uIndex != i) || (! radio_packet_check_crc(pMsg, ((t_packet_header*)pMsg)->total_length)) )
+         iErrors++;
+   }
+   _build_message((u32)iErrors, sizeof(t_packet_header) + sizeof(u32));
+   _send_message(iWrite, s_uBuffer, sizeof(t_packet_header) + sizeof(u32));
+
+   ruby_close_ipc_channel(iRead);
+   ruby_close_ipc_channel(iWrite);
+   exit(0);
+}
+
+int _bench_failed(pid_t pid, int iRead, int iWrite, const char* szError)
+{
+   printf(" %-14s | %s\n", "", szError);
+   kill(pid, SIGKILL);
+   waitpid(pid, NULL, 0);
+   if ( iRead > 0 )
+      ruby_close_ipc_channel(iRead);
+   if ( iWrite > 0 )
+      ruby_close_ipc_channel(iWrite);
+   ruby_clear_all_ipc_channels();
+   return 1;
+}
+
+int _bench_backend(int iBackend)
+{
+   ruby_ipc_set_backend(iBackend);
+   ruby_init_ipc_channels();
+   ruby_clear_all_ipc_channels();
+
+   fflush(stdout);
+   pid_t pid = fork();
+   if ( 0 == pid )
+      _run_child();
+
+   int iWrite = ruby_open_ipc_channel_write_endpoint(IPC_CHANNEL_TYPE_ROUTER_TO_TELEMETRY);
+   int iRead = ruby_open_ipc_channel_read_endpoint(IPC_CHANNEL_TYPE_TELEMETRY_TO_ROUTER);
+   if ( (iRead <= 0) || (iWrite <= 0) )
+      return _bench_failed(pid, iRead, iWrite, "Failed to open IPC channels.");
+
+   u32 uTimeStart = get_current_timestamp_micros();
+   for( u32 i=0; i<BENCH_PING_PONG_COUNT; i++ )
+   {
+      _build_message(i, BENCH_MSG_SIZE);
+      if ( ! _send_message(iWrite, s_uBuffer, BENCH_MSG_SIZE) )
+         return _bench_failed(pid, iRead, iWrite, "Timed out sending ping message.");
+      if ( NULL == _wait_message(iRead) )
+         return _bench_failed(pid, iRead, iWrite, "Timed out waiting for pong message.");
+   }
+   u32 uTimePingPong = get_current_timestamp_micros() - uTimeStart;
+
+   uTimeStart = get_current_timestamp_micros();
+   for( u32 i=0; i<BENCH_THROUGHPUT_COUNT; i++ )
+   {
+      _build_message(i, BENCH_MSG_SIZE);
+      if ( ! _send_message(iWrite, s_uBuffer, BENCH_MSG_SIZE) )
+         return _bench_failed(pid, iRead, iWrite, "Timed out sending throughput message.");
+   }
+   u8* pMsg = _wait_message(iRead);
+   if ( NULL == pMsg )
+      return _bench_failed(pid, iRead, iWrite, "Timed out waiting for the reader result.");
+   u32 uTimeThroughput = get_current_timestamp_micros() - uTimeStart;
+   u32 uErrors = 0;
+   memcpy(&uErrors, pMsg + sizeof(t_packet_header), sizeof(u32));
+
+   int iStatus = 0;
+   waitpid(pid, &iStatus, 0);
+   if ( (! WIFEXITED(iStatus)) || (0 != WEXITSTATUS(iStatus)) )
+      uErrors++;
+   ruby_close_ipc_channel(iRead);
+   ruby_close_ipc_channel(iWrite);
+   ruby_clear_all_ipc_channels();
+
+   printf(" %-14s | %8.2f us | %10.0f msg/s | %8.1f MB/s | %u errors\n",
+      (IPC_BACKEND_SHM_RING == iBackend)?"shm ring":"msg queue",
+      (float)uTimePingPong/(float)BENCH_PING_PONG_COUNT,
+      (float)BENCH_THROUGHPUT_COUNT * 1000000.0/(float)uTimeThroughput,
+      (float)BENCH_THROUGHPUT_COUNT * (float)BENCH_MSG_SIZE / (float)uTimeThroughput,
+      uErrors);
+   return (uErrors > 0)?1:0;
+}
+
+int main(int argc, char *argv[])
+{
+   printf("\nBenchmarking IPC channels (%d bytes messages)\n", BENCH_MSG_SIZE);
+   log_init("TestIPC");
+   log_disable_stdout();
+
+   printf("\n backend        | round trip  | throughput\n");
+   int iErrors = 0;
+   iErrors += _bench_backend(IPC_BACKEND_MSGQUEUE);
+   iErrors += _bench_backend(IPC_BACKEND_SHM_RING);
+
+   if ( iErrors )
+      printf("\nIPC test failed.\n");
+   else
+      printf("\nIPC test passed.\n");
+   return (iErrors?1:0);
+}
@@ -0,0 +1,233 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/mavlink_frames.h"
+#include "../../mavlink/common/mavlink.h"
+
+// Feeds MAVLink frames mixed with garbage to the frames scanner, split in different ways
+// across the feeds, and checks that every frame comes out once, whole and in order.
+
+#define TEST_FRAMES 2000
+
+u8 s_uStream[TEST_FRAMES * (MAVLINK_FRAME_MAX_LENGTH + 64)];
+int s_iStreamLength = 0;
+int s_iFramesOffsets[TEST_FRAMES];
+int s_iFramesLengths[TEST_FRAMES];
+int s_iFramesCount = 0;
+
+int _add_frame(u8 uSeq)
+{
+   mavlink_message_t msg;
+   mavlink_msg_heartbeat_pack(1, 1, &msg, MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_ARDUPILOTMEGA, 0, uSeq, MAV_STATE_ACTIVE);
+   int iLength = mavlink_msg_to_send_buffer(&s_uStream[s_iStreamLength], &msg);
+   s_iFramesOffsets[s_iFramesCount] = s_iStreamLength;
+   s_iFramesLengths[s_iFramesCount] = iLength;
+   s_iFramesCount++;
+   s_iStreamLength += iLength;
+   return iLength;
+}
+
+void _add_bytes(const u8* pData, int iLength)
+{
+   memcpy(&s_uStream[s_iStreamLength], pData, iLength);
+   s_iStreamLength += iLength;
+}
+
+// Frame of a message not in the dialect (so not CRC checked), max payload, signed or not
+int _add_unknown_frame(bool bSigned)
+{
+   u8* pFrame = &s_uStream[s_iStreamLength];
+   int iLength = MAVLINK_FRAME_MAX_LENGTH - (bSigned?0:MAVLINK_SIGNATURE_BLOCK_LEN);
+   for( int i=0; i<iLength; i++ )
+      pFrame[i] = (u8)(i*7 + 3);
+   pFrame[0] = MAVLINK_FRAME_STX_V2;
+   pFrame[1] = 255;
+   pFrame[2] = bSigned?MAVLINK_IFLAG_SIGNED:0;
+   pFrame[3] = 0;
+   pFrame[7] = 0x56;
+   pFrame[8] = 0x34;
+   pFrame[9] = 0x12;
+   s_iFramesOffsets[s_iFramesCount] = s_iStreamLength;
+   s_iFramesLengths[s_iFramesCount] = iLength;
+   s_iFramesCount++;
+   s_iStreamLength += iLength;
+   return iLength;
+}
+
+// Returns the number of errors. Each frame found must be one of the next expected frames, in order
+// (frames can be missed if garbage hides them, but never returned altered, twice or out of order).
+int _read_frames(t_mavlink_frames_scanner* pScanner, u8* pData, int iLength, int* piNextFrame, int* piFramesFound)
+{
+   int iErrors = 0;
+   int iFrameLength = 0;
+   u8* pFrame = NULL;
+   // Each feed in its own buffer, as for reads from the serial port
+   u8* pFeed = (u8*)malloc(iLength);
+   memcpy(pFeed, pData, iLength);
+   mavlink_frames_scanner_set_data(pScanner, pFeed, iLength);
+   while ( NULL != (pFrame = mavlink_frames_scanner_get_next(pScanner, &iFrameLength)) )
+   {
+      int iIndex = *piNextFrame;
+      while ( (iIndex < s_iFramesCount) && ((iFrameLength != s_iFramesLengths[iIndex]) ||
+              (0 != memcmp(pFrame, &s_uStream[s_iFramesOffsets[iIndex]], iFrameLength))) )
+         iIndex++;
+      if ( iIndex >= s_iFramesCount )
+      {
+         iErrors++;
+         continue;
+      }
+      *piNextFrame = iIndex + 1;
+      (*piFramesFound)++;
+   }
+   free(pFeed);
+   return iErrors;
+}
+
+// Garbage, then the start of a frame that never completes (its length covers the next frames),
+// then a complete frame and a frame split across the two feeds: the complete frame ends
+// inside the scanner's pending bytes.
+int _test_partial_frame_then_split_frame()
+{
+   s_iStreamLength = 0;
+   s_iFramesCount = 0;
+   u8 uGarbage[] = { 0x11, 0x22, 0x33, 0x44, 0x55 };
+   u8 uPartialFrame[] = { MAVLINK_FRAME_STX_V1, 0x30, 0x01, 0x01, 0x01, 0x00 };
+   _add_bytes(uGarbage, sizeof(uGarbage));
+   _add_bytes(uPartialFrame, sizeof(uPartialFrame));
+   _add_frame(1);
+   int iSplitFrameLength = _add_frame(2);
+   _add_frame(3);
+   int iSplit = s_iFramesOffsets[1] + iSplitFrameLength/2;
+
+   t_mavlink_frames_scanner scanner;
+   mavlink_frames_scanner_init(&scanner);
+   int iNext = 0;
+   int iFound = 0;
+   int iErrors = _read_frames(&scanner, s_uStream, iSplit, &iNext, &iFound);
+   if ( 0 != iFound )
+      iErrors++;
+   iErrors += _read_frames(&scanner, &s_uStream[iSplit], s_iStreamLength - iSplit, &iNext, &iFound);
+   if ( iFound != s_iFramesCount )
+      iErrors++;
+   return iErrors;
+}
+
+// A frame of an unknown message that ends with the feed is returned only once the next feed
+// starts with another frame; one followed by garbage is not returned.
+int _test_unknown_frames()
+{
+   s_iStreamLength = 0;
+   s_iFramesCount = 0;
+   int iFeeds[4];
+   iFeeds[0] = _add_unknown_frame(true);
+   iFeeds[1] = _add_unknown_frame(false);
+   iFeeds[2] = _add_frame(1);
+   // Not a frame: followed by garbage
+   int iNotAFrame = s_iStreamLength;
+   _add_unknown_frame(false);
+   s_iFramesCount--;
+   u8 uGarbage[] = { 0x11, 0x22, 0x33 };
+   _add_bytes(uGarbage, sizeof(uGarbage));
+   _add_frame(2);
+   iFeeds[3] = s_iStreamLength - iNotAFrame;
+
+   t_mavlink_frames_scanner scanner;
+   mavlink_frames_scanner_init(&scanner);
+   int iNext = 0;
+   int iFound = 0;
+   int iPos = 0;
+   int iErrors = 0;
+   int iExpectedFound[4] = { 0, 1, 3, 4 };
+   for( int i=0; i<4; i++ )
+   {
+      iErrors += _read_frames(&scanner, &s_uStream[iPos], iFeeds[i], &iNext, &iFound);
+      iPos += iFeeds[i];
+      if ( iFound != iExpectedFound[i] )
+         iErrors++;
+   }
+   return iErrors;
+}
+
+// Random garbage and corrupted frames (bad CRC) between the frames, fed in random sized chunks
+// (including one byte at a time). All the valid frames must be found.
+int _test_random_splits(int iMaxChunk)
+{
+   s_iStreamLength = 0;
+   s_iFramesCount = 0;
+   for( int i=0; i<TEST_FRAMES; i++ )
+   {
+      int iGarbage = rand() % 40;
+      for( int k=0; k<iGarbage; k++ )
+      {
+         u8 uByte = (u8)(rand() & 0xFF);
+         if ( (uByte == MAVLINK_FRAME_STX_V1) || (uByte == MAVLINK_FRAME_STX_V2) )
+            uByte = 0;
+         _add_bytes(&uByte, 1);
+      }
+      // Corrupt the payload or the CRC (a corrupted header is just garbage that can hide the next frames).
+      // The scanner resyncs inside the bad frame, so keep it free of frame start bytes.
+      if ( (rand() % 4) == 0 )
+      {
+         int iLength = _add_frame((u8)i);
+         s_iFramesCount--;
+         u8* pBadFrame = &s_uStream[s_iStreamLength - iLength];
+         pBadFrame[10 + rand() % (iLength-10)] ^= 0x5A;
+         for( int k=1; k<iLength; k++ )
+         {
+            if ( (pBadFrame[k] == MAVLINK_FRAME_STX_V1) || (pBadFrame[k] == MAVLINK_FRAME_STX_V2) )
+            {
+               s_iStreamLength -= iLength;
+               break;
+            }
+         }
+      }
+      _add_frame((u8)i);
+   }
+
+   t_mavlink_frames_scanner scanner;
+   mavlink_frames_scanner_init(&scanner);
+   int iNext = 0;
+   int iFound = 0;
+   int iErrors = 0;
+   int iPos = 0;
+   while ( iPos < s_iStreamLength )
+   {
+      int iChunk = 1 + rand() % iMaxChunk;
+      if ( iPos + iChunk > s_iStreamLength )
+         iChunk = s_iStreamLength - iPos;
+      iErrors += _read_frames(&scanner, &s_uStream[iPos], iChunk, &iNext, &iFound);
+      iPos += iChunk;
+   }
+   if ( iFound != s_iFramesCount )
+      iErrors++;
+   return iErrors;
+}
+
+int main(int argc, char *argv[])
+{
+   printf("\nTesting MAVLink frames scanner\n");
+   log_init("TestMAVLinkFrames");
+   log_disable_stdout();
+
+   int iErrors = 0;
+   int iErr = _test_partial_frame_then_split_frame();
+   printf(" partial frame, then frame split across feeds: %s\n", iErr?"FAILED":"ok");
+   iErrors += iErr;
+
+   iErr = _test_unknown_frames();
+   printf(" unknown message frames at the end of feeds: %s\n", iErr?"FAILED":"ok");
+   iErrors += iErr;
+
+   int iChunks[] = { 1, 7, 64, 300, 2048 };
+   for( int i=0; i<(int)(sizeof(iChunks)/sizeof(iChunks[0])); i++ )
+   {
+      iErr = _test_random_splits(iChunks[i]);
+      printf(" garbage and corrupted frames, chunks up to %d bytes: %s\n", iChunks[i], iErr?"FAILED":"ok");
+      iErrors += iErr;
+   }
+
+   if ( iErrors )
+      printf("\nMAVLink frames scanner test failed.\n");
+   else
+      printf("\nMAVLink frames scanner test passed.\n");
+   return (iErrors?1:0);
+}
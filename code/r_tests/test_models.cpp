@@ -0,0 +1,168 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/models.h"
+#include <sys/stat.h>
+
+// Saves a model (text and binary model files) and loads it back, checking that the binary file
+// is used only while it matches the text file: a text file changed with the same save count and size
+// (by an import or a manual edit) must be loaded from the text, not from the stale binary file.
+
+#define TEST_MODEL_FILE "/tmp/test_model.mdl"
+#define TEST_MODEL_FILE_BINARY "/tmp/test_model.mdb"
+#define TEST_MODEL_FILE_BACKUP "/tmp/test_model.bak"
+
+#define TEST_VEHICLE_ID_SAVED 1234567
+#define TEST_VEHICLE_ID_EDITED 7654321
+
+int _save_test_model()
+{
+   Model model;
+   model.resetToDefaults(false);
+   model.uVehicleId = TEST_VEHICLE_ID_SAVED;
+   strcpy(model.vehicle_name, "TestBinary");
+   model.video_params.iVideoWidth = 1280;
+   if ( ! model.saveToFile(TEST_MODEL_FILE, false) )
+      return 1;
+   struct stat statBin;
+   if ( 0 != stat(TEST_MODEL_FILE_BINARY, &statBin) )
+      return 1;
+   return 0;
+}
+
+// Replaces the vehicle id in the text model file with one of the same length (same file size).
+// Returns 0 on success.
+int _edit_text_model_file(struct timespec* pTimeModified)
+{
+   FILE* fd = fopen(TEST_MODEL_FILE, "r+b");
+   if ( NULL == fd )
+      return 1;
+   static char s_szText[64000];
+   int iLength = (int)fread(s_szText, 1, sizeof(s_szText)-1, fd);
+   s_szText[iLength] = 0;
+   char szOld[32];
+   char szNew[32];
+   sprintf(szOld, "%u", TEST_VEHICLE_ID_SAVED);
+   sprintf(szNew, "%u", TEST_VEHICLE_ID_EDITED);
+   char* pId = strstr(s_szText, szOld);
+   if ( NULL == pId )
+   {
+      fclose(fd);
+      return 1;
+   }
+   fseek(fd, (long)(pId - s_szText), SEEK_SET);
+   fwrite(szNew, 1, strlen(szNew), fd);
+   fclose(fd);
+
+   if ( NULL != pTimeModified )
+   {
+      struct timespec times[2];
+      times[0] = *pTimeModified;
+      times[1] = *pTimeModified;
+      utimensat(AT_FDCWD, TEST_MODEL_FILE, times, 0);
+   }
+   return 0;
+}
+
+// Nothing changed since the save: loads from the binary file
+int _test_load_saved()
+{
+   if ( 0 != _save_test_model() )
+      return 1;
+   Model model;
+   if ( ! model.loadFromFile(TEST_MODEL_FILE) )
+      return 1;
+   if ( (model.uVehicleId != TEST_VEHICLE_ID_SAVED) || (0 != strcmp(model.vehicle_name, "TestBinary")) || (model.video_params.iVideoWidth != 1280) )
+      return 1;
+   return 0;
+}
+
+// The text file is edited but keeps its size, save count and modification time: the binary file
+// is still taken as matching, so the loaded vehicle id is the saved one. This checks the binary file is used.
+int _test_binary_used_if_text_time_unchanged()
+{
+   if ( 0 != _save_test_model() )
+      return 1;
+   struct stat statText;
+   if ( 0 != stat(TEST_MODEL_FILE, &statText) )
+      return 1;
+   struct timespec timeSaved = statText.st_mtim;
+   if ( 0 != _edit_text_model_file(&timeSaved) )
+      return 1;
+   Model model;
+   if ( ! model.loadFromFile(TEST_MODEL_FILE) )
+      return 1;
+   if ( model.uVehicleId != TEST_VEHICLE_ID_SAVED )
+      return 1;
+   return 0;
+}
+
+// The text file is edited (same size and save count, new modification time): the binary file is stale
+// and the model must be reloaded from the text file.
+int _test_reload_from_edited_text()
+{
+   if ( 0 != _save_test_model() )
+      return 1;
+   struct stat statText;
+   if ( 0 != stat(TEST_MODEL_FILE, &statText) )
+      return 1;
+   struct timespec timeEdited = statText.st_mtim;
+   timeEdited.tv_sec += 2;
+   if ( 0 != _edit_text_model_file(&timeEdited) )
+      return 1;
+   if ( (0 != stat(TEST_MODEL_FILE, &statText)) || (statText.st_mtim.tv_sec != timeEdited.tv_sec) )
+      return 1;
+   Model model;
+   if ( ! model.loadFromFile(TEST_MODEL_FILE) )
+      return 1;
+   if ( (model.uVehicleId != TEST_VEHICLE_ID_EDITED) || (0 != strcmp(model.vehicle_name, "TestBinary")) )
+      return 1;
+   return 0;
+}
+
+// No binary file: loads from the text file
+int _test_load_without_binary()
+{
+   if ( 0 != _save_test_model() )
+      return 1;
+   unlink(TEST_MODEL_FILE_BINARY);
+   Model model;
+   if ( ! model.loadFromFile(TEST_MODEL_FILE) )
+      return 1;
+   if ( (model.uVehicleId != TEST_VEHICLE_ID_SAVED) || (model.video_params.iVideoWidth != 1280) )
+      return 1;
+   return 0;
+}
+
+int main(int argc, char *argv[])
+{
+   printf("\nTesting model files load\n");
+   log_init("TestModels");
+   log_disable_stdout();
+
+   int iErrors = 0;
+   int iErr = _test_load_saved();
+   printf(" load saved model: %s\n", iErr?"FAILED":"ok");
+   iErrors += iErr;
+
+   iErr = _test_binary_used_if_text_time_unchanged();
+   printf(" binary file used while it matches the text file: %s\n", iErr?"FAILED":"ok");
+   iErrors += iErr;
+
+   iErr = _test_reload_from_edited_text();
+   printf(" text file edited (same size and save count), reloaded from text: %s\n", iErr?"FAILED":"ok");
+   iErrors += iErr;
+
+   iErr = _test_load_without_binary();
+   printf(" no binary file, loaded from text: %s\n", iErr?"FAILED":"ok");
+   iErrors += iErr;
+
+   unlink(TEST_MODEL_FILE);
+   unlink(TEST_MODEL_FILE_BINARY);
+   unlink(TEST_MODEL_FILE_BACKUP);
+
+   if ( iErrors )
+      printf("\nModel files test failed.\n");
+   else
+      printf("\nModel files test passed.\n");
+   return (iErrors?1:0);
+}
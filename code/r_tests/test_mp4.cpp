@@ -0,0 +1,216 @@
+#include <unistd.h>
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/flags_video.h"
+#include "../r_station/rx_video_recording_mp4.h"
+
+// Writes a generated H264/H265 stream (keyframes with in band parameter sets, frames lost before
+// a keyframe) to a fragmented MP4 recording, reads it back as Annex-B and checks that the parameter
+// sets from the init segment and the NALs of all the recorded frames come out, in order.
+// Then cuts the file (as a power loss would) and checks that the complete NALs still come out.
+
+#define TEST_FRAMES 300
+#define TEST_GOP 30
+#define TEST_MAX_NALS_PER_FRAME 3
+#define TEST_LOST_FRAMES_START 100
+#define TEST_LOST_FRAMES_END 110 // next keyframe is at 120
+#define TEST_FILE "/tmp/test_mp4.mp4"
+
+u8* s_pFrame = NULL;
+u8* s_pExpected = NULL;
+int s_iExpectedLength = 0;
+u8* s_pOutput = NULL;
+int s_iOutputLength = 0;
+
+// Parameter sets: the same all the recording long
+u8 s_uParams[3][32];
+int s_iParamsSizes[3];
+int s_iParamsCount = 0;
+
+void _fill_nal(u8* pNAL, u8 uType, int iSize, bool bH265)
+{
+   // No zero bytes in the payload, so no start code emulation
+   for( int i=0; i<iSize; i++ )
+      pNAL[i] = 1 + rand() % 255;
+   if ( bH265 )
+   {
+      pNAL[0] = uType << 1;
+      pNAL[1] = 1;
+   }
+   else
+      pNAL[0] = 0x60 | uType;
+}
+
+// Adds a NAL to the frame (3 or 4 bytes start code) and, if the frame gets recorded, to the expected output (4 bytes start code)
+int _add_nal(int iFrameLength, const u8* pNAL, int iSize, bool bExpected)
+{
+   if ( rand() % 2 )
+      s_pFrame[iFrameLength++] = 0;
+   s_pFrame[iFrameLength++] = 0;
+   s_pFrame[iFrameLength++] = 0;
+   s_pFrame[iFrameLength++] = 1;
+   memcpy(s_pFrame + iFrameLength, pNAL, iSize);
+
+   if ( bExpected )
+   {
+      const u8 uStartCode[4] = { 0, 0, 0, 1 };
+      memcpy(s_pExpected + s_iExpectedLength, uStartCode, 4);
+      memcpy(s_pExpected + s_iExpectedLength + 4, pNAL, iSize);
+      s_iExpectedLength += 4 + iSize;
+   }
+   return iFrameLength + iSize;
+}
+
+bool _read_annexb(const char* szFile)
+{
+   s_iOutputLength = 0;
+   FILE* pOut = tmpfile();
+   if ( NULL == pOut )
+      return false;
+   bool bRes = rx_video_mp4_to_annexb(szFile, pOut, NULL);
+   long lSize = ftell(pOut);
+   fseek(pOut, 0, SEEK_SET);
+   if ( (lSize > 0) && (lSize <= 2*s_iExpectedLength) )
+      s_iOutputLength = fread(s_pOutput, 1, lSize, pOut);
+   fclose(pOut);
+   return bRes;
+}
+
+int _test_codec(bool bH265)
+{
+   int iErrors = 0;
+   s_iExpectedLength = 0;
+
+   t_mp4_writer writer;
+   if ( ! rx_video_mp4_open(&writer, TEST_FILE, bH265?VIDEO_TYPE_H265:VIDEO_TYPE_H264, 1280, 720, 30) )
+   {
+      printf(" %s: failed to open the mp4 writer\n", bH265?"H265":"H264");
+      return 1;
+   }
+
+   // Parameter sets, in the order the init segment stores them (VPS, SPS, PPS); they come first in the output
+   u8 uTypesParams[3] = { 32, 33, 34 };
+   int iSizesParams[3] = { 20, 24, 8 };
+   if ( ! bH265 )
+   {
+      uTypesParams[1] = 7;
+      uTypesParams[2] = 8;
+   }
+   s_iParamsCount = 0;
+   for( int i=(bH265?0:1); i<3; i++ )
+   {
+      s_iParamsSizes[s_iParamsCount] = iSizesParams[i];
+      _fill_nal(s_uParams[s_iParamsCount], uTypesParams[i], iSizesParams[i], bH265);
+      _add_nal(0, s_uParams[s_iParamsCount], s_iParamsSizes[s_iParamsCount], true);
+      s_iParamsCount++;
+   }
+   int iParamsLength = s_iExpectedLength;
+
+   u8* pNAL = (u8*) malloc(64*1024);
+   u32 uTimeNow = 1000;
+   for( int iFrame=0; iFrame<TEST_FRAMES; iFrame++ )
+   {
+      bool bKeyframe = (0 == (iFrame % TEST_GOP));
+      bool bLost = (iFrame >= TEST_LOST_FRAMES_START) && (iFrame < TEST_LOST_FRAMES_END);
+      bool bDiscontinuity = (iFrame == TEST_LOST_FRAMES_END);
+      // Frames after a discontinuity are not recorded until the next keyframe
+      bool bRecorded = (iFrame < TEST_LOST_FRAMES_START) || (iFrame >= ((TEST_LOST_FRAMES_END + TEST_GOP - 1)/TEST_GOP)*TEST_GOP);
+      if ( bLost )
+         bRecorded = false;
+
+      int iLength = 0;
+      if ( bKeyframe )
+      {
+         for( int i=0; i<s_iParamsCount; i++ )
+            iLength = _add_nal(iLength, s_uParams[i], s_iParamsSizes[i], bRecorded);
+         int iSize = 1000 + rand() % 60000;
+         _fill_nal(pNAL, bH265?19:5, iSize, bH265);
+         iLength = _add_nal(iLength, pNAL, iSize, bRecorded);
+      }
+      else
+      {
+         int iNALs = 1 + rand() % TEST_MAX_NALS_PER_FRAME;
+         for( int i=0; i<iNALs; i++ )
+         {
+            int iSize = 2 + rand() % 8000;
+            _fill_nal(pNAL, 1, iSize, bH265);
+            iLength = _add_nal(iLength, pNAL, iSize, bRecorded);
+         }
+      }
+
+      uTimeNow += 33;
+      if ( bLost )
+         continue;
+      if ( ! rx_video_mp4_add_frame(&writer, s_pFrame, iLength, (u16)iFrame, 33, uTimeNow, bDiscontinuity) )
+      {
+         printf(" %s: failed to add frame %d\n", bH265?"H265":"H264", iFrame);
+         iErrors++;
+         break;
+      }
+      rx_video_mp4_periodic_loop(&writer, uTimeNow);
+   }
+   free(pNAL);
+   u32 uFragments = writer.uStatsFragments;
+   rx_video_mp4_close(&writer);
+
+   // Whole file
+   if ( ! _read_annexb(TEST_FILE) )
+      iErrors++;
+   if ( (s_iOutputLength != s_iExpectedLength) || (0 != memcmp(s_pOutput, s_pExpected, s_iExpectedLength)) )
+   {
+      printf(" %s: Annex-B output differs from the input (%d bytes, expected %d)\n", bH265?"H265":"H264", s_iOutputLength, s_iExpectedLength);
+      iErrors++;
+   }
+   int iFullLength = s_iOutputLength;
+
+   // Cut in the middle of the last fragment: the NALs before the cut still come out
+   FILE* fd = fopen(TEST_FILE, "rb");
+   long lFileSize = 0;
+   if ( NULL != fd )
+   {
+      fseek(fd, 0, SEEK_END);
+      lFileSize = ftell(fd);
+      fclose(fd);
+   }
+   if ( (lFileSize < 1000) || (0 != truncate(TEST_FILE, lFileSize - 777)) )
+   {
+      printf(" %s: failed to cut the mp4 file\n", bH265?"H265":"H264");
+      iErrors++;
+   }
+   _read_annexb(TEST_FILE);
+   if ( (s_iOutputLength <= iParamsLength) || (s_iOutputLength >= iFullLength) || (0 != memcmp(s_pOutput, s_pExpected, s_iOutputLength)) )
+   {
+      printf(" %s: Annex-B output of the cut file is not a prefix of the input (%d bytes)\n", bH265?"H265":"H264", s_iOutputLength);
+      iErrors++;
+   }
+   unlink(TEST_FILE);
+
+   printf(" %s: %d fragments, %d bytes of NALs, %s\n", bH265?"H265":"H264", uFragments, iFullLength, iErrors?"FAILED":"ok");
+   return iErrors;
+}
+
+int main(int argc, char *argv[])
+{
+   printf("\nTesting MP4 recording writer and reader\n");
+   log_init("TestMP4");
+   log_disable_stdout();
+
+   int iMaxSize = TEST_FRAMES * (TEST_MAX_NALS_PER_FRAME * 8100 + 62000);
+   s_pFrame = (u8*) malloc(128*1024);
+   s_pExpected = (u8*) malloc(iMaxSize);
+   s_pOutput = (u8*) malloc(2*iMaxSize);
+
+   int iErrors = 0;
+   iErrors += _test_codec(false);
+   iErrors += _test_codec(true);
+
+   free(s_pFrame);
+   free(s_pExpected);
+   free(s_pOutput);
+
+   if ( iErrors )
+      printf("\nMP4 test failed.\n");
+   else
+      printf("\nMP4 test passed.\n");
+   return (iErrors?1:0);
+}
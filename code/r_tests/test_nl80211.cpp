@@ -0,0 +1,90 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/hardware_procs.h"
+#include "../base/hardware_radio_nl80211.h"
+
+// Checks the nl80211 control of a wifi interface and compares the time it takes
+// to switch frequencies and tx power against the iw shell commands.
+// Can be run against mac80211_hwsim: modprobe mac80211_hwsim radios=1; test_nl80211 wlan0
+
+#define SWITCH_COUNT 20
+
+int main(int argc, char *argv[])
+{
+   if ( argc < 2 )
+   {
+      printf("\nUsage: test_nl80211 [wifi interface name]\n");
+      return 1;
+   }
+   log_init("TestNL80211");
+   log_enable_stdout();
+   const char* szIfName = argv[1];
+
+   if ( ! hardware_radio_nl80211_is_available() )
+   {
+      printf("\nnl80211 is not available.\n");
+      return 1;
+   }
+
+   int iPhy = -1;
+   u8 uMAC[6];
+   int iRes = hardware_radio_nl80211_get_interface_info(szIfName, &iPhy, uMAC);
+   if ( iRes < 0 )
+   {
+      printf("\nFailed to get info for interface %s, error: %d\n", szIfName, iRes);
+      return 1;
+   }
+   printf("\nInterface %s: phy%d, MAC %02X:%02X:%02X:%02X:%02X:%02X\n", szIfName, iPhy, uMAC[0], uMAC[1], uMAC[2], uMAC[3], uMAC[4], uMAC[5]);
+
+   u32 uFrequencies[256];
+   int iCountFreq = hardware_radio_nl80211_get_phy_frequencies(iPhy, uFrequencies, 256);
+   printf("Supported frequencies: %d\n", iCountFreq);
+   if ( iCountFreq <= 1 )
+      return 1;
+
+   int iErrors = 0;
+   hardware_radio_nl80211_set_link_up(szIfName, 0);
+   if ( 0 != (iRes = hardware_radio_nl80211_set_type_monitor(szIfName)) )
+   {
+      printf("Failed to set monitor mode, error: %d\n", iRes);
+      iErrors++;
+   }
+   if ( 0 != (iRes = hardware_radio_nl80211_set_monitor_flags(szIfName, NL80211_MONITOR_FLAG_FCSFAIL)) )
+   {
+      printf("Failed to set monitor flags, error: %d\n", iRes);
+      iErrors++;
+   }
+   hardware_radio_nl80211_set_link_up(szIfName, 1);
+
+   u32 uTimeStart = get_current_timestamp_micros();
+   for( int i=0; i<SWITCH_COUNT; i++ )
+   {
+      if ( 0 != (iRes = hardware_radio_nl80211_set_frequency(szIfName, uFrequencies[i % 2], 0)) )
+      {
+         printf("Failed to set frequency %u Mhz, error: %d\n", uFrequencies[i % 2], iRes);
+         iErrors++;
+         break;
+      }
+   }
+   u32 uTimeNL = get_current_timestamp_micros() - uTimeStart;
+
+   char szComm[256];
+   uTimeStart = get_current_timestamp_micros();
+   for( int i=0; i<SWITCH_COUNT; i++ )
+   {
+      sprintf(szComm, "iw dev %s set freq %u", szIfName, uFrequencies[i % 2]);
+      hw_execute_bash_command(szComm, NULL);
+   }
+   u32 uTimeIW = get_current_timestamp_micros() - uTimeStart;
+   printf("\nSet frequency: nl80211 %u us, iw %u us\n", uTimeNL/SWITCH_COUNT, uTimeIW/SWITCH_COUNT);
+
+   uTimeStart = get_current_timestamp_micros();
+   iRes = hardware_radio_nl80211_set_txpower_fixed(szIfName, 1000);
+   printf("Set tx power: nl80211 %u us, result: %d\n", get_current_timestamp_micros() - uTimeStart, iRes);
+
+   if ( iErrors )
+      printf("\nnl80211 test failed.\n");
+   else
+      printf("\nnl80211 test passed.\n");
+   return (iErrors?1:0);
+}
@@ -0,0 +1,349 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/rc_uplink.h"
+#include <pthread.h>
+#include <sys/mman.h>
+
+// Writes RC frames to the RC uplink slot from a thread while reading them back, checking that a read
+// never returns a frame torn by a concurrent write (the reader retries) and that frames come in order.
+// Also checks the reads while a write is in progress, a reader that stops reading the slot, the wrap
+// around of the slot sequence number and the edges of the RC latency histogram buckets.
+
+#define TEST_SLOT_ID 9
+#define TEST_WRITES 1000000
+
+volatile int s_bWriterDone = 0;
+volatile int s_bReaderReady = 0;
+
+int _get_frame_length(u32 uFrame)
+{
+   return 8 + (int)(uFrame % (RC_UPLINK_SLOT_MAX_PACKET_SIZE-8));
+}
+
+void _fill_frame(u32 uFrame, u8* pFrame)
+{
+   int iLength = _get_frame_length(uFrame);
+   memcpy(pFrame, &uFrame, sizeof(u32));
+   for( int i=sizeof(u32); i<iLength; i++ )
+      pFrame[i] = (u8)((uFrame * 31 + i) & 0xFF);
+}
+
+// Returns the frame number, or MAX_U32 if the frame is not a whole frame
+u32 _check_frame(u8* pFrame, int iLength, u32 uTimeInput)
+{
+   u32 uFrame = 0;
+   if ( iLength < (int)sizeof(u32) )
+      return MAX_U32;
+   memcpy(&uFrame, pFrame, sizeof(u32));
+   if ( (iLength != _get_frame_length(uFrame)) || (uTimeInput != uFrame) )
+      return MAX_U32;
+   for( int i=sizeof(u32); i<iLength; i++ )
+      if ( pFrame[i] != (u8)((uFrame * 31 + i) & 0xFF) )
+         return MAX_U32;
+   return uFrame;
+}
+
+static void* _thread_writer(void* pArg)
+{
+   t_rc_uplink_slot_endpoint writer;
+   rc_uplink_slot_open(&writer, TEST_SLOT_ID, 0);
+   while ( ! s_bReaderReady )
+      hardware_sleep_ms(1);
+
+   u8 uFrame[RC_UPLINK_SLOT_MAX_PACKET_SIZE];
+   for( u32 u=1; u<=TEST_WRITES; u++ )
+   {
+      _fill_frame(u, uFrame);
+      rc_uplink_slot_write(&writer, uFrame, _get_frame_length(u), u);
+      // Varying gaps between the writes, so that the reads land before, inside and after the writes
+      for( volatile int k=0; k<(int)(u % 200); k++ )
+      {
+      }
+   }
+   rc_uplink_slot_close(&writer);
+   s_bWriterDone = 1;
+   return NULL;
+}
+
+int _test_concurrent_writer(u32* puReads)
+{
+   t_rc_uplink_slot_endpoint reader;
+   if ( ! rc_uplink_slot_open(&reader, TEST_SLOT_ID, 1) )
+      return 1;
+   rc_uplink_slot_mark_reader_alive(&reader, get_current_timestamp_ms());
+
+   pthread_t thWriter;
+   s_bWriterDone = 0;
+   s_bReaderReady = 1;
+   pthread_create(&thWriter, NULL, &_thread_writer, NULL);
+
+   int iErrors = 0;
+   u32 uLastFrame = 0;
+   u32 uReads = 0;
+   u8 uFrame[RC_UPLINK_SLOT_MAX_PACKET_SIZE];
+   while ( true )
+   {
+      // The writer stops writing to the slot if the reader is not alive
+      rc_uplink_slot_mark_reader_alive(&reader, get_current_timestamp_ms());
+      int bDone = s_bWriterDone;
+      u32 uTimeInput = 0;
+      int iLength = rc_uplink_slot_read(&reader, uFrame, &uTimeInput);
+      if ( iLength > 0 )
+      {
+         u32 uFrameNumber = _check_frame(uFrame, iLength, uTimeInput);
+         if ( (MAX_U32 == uFrameNumber) || (uFrameNumber <= uLastFrame) )
+            iErrors++;
+         else
+            uLastFrame = uFrameNumber;
+         uReads++;
+      }
+      else if ( bDone )
+         break;
+   }
+   pthread_join(thWriter, NULL);
+   s_bReaderReady = 0;
+
+   // The last frame written is always read
+   if ( uLastFrame != TEST_WRITES )
+      iErrors++;
+   rc_uplink_slot_close(&reader);
+   *puReads = uReads;
+   return iErrors;
+}
+
+// A write in progress (odd sequence) is not read; the frame is read once the write completes.
+// A new frame is read once, then there is nothing new to read.
+int _test_write_in_progress()
+{
+   t_rc_uplink_slot_endpoint writer;
+   t_rc_uplink_slot_endpoint reader;
+   if ( ! rc_uplink_slot_open(&reader, TEST_SLOT_ID, 1) )
+      return 1;
+   if ( ! rc_uplink_slot_open(&writer, TEST_SLOT_ID, 0) )
+      return 1;
+   rc_uplink_slot_mark_reader_alive(&reader, get_current_timestamp_ms());
+
+   int iErrors = 0;
+   u8 uFrame[RC_UPLINK_SLOT_MAX_PACKET_SIZE];
+   u8 uRead[RC_UPLINK_SLOT_MAX_PACKET_SIZE];
+   u32 uTimeInput = 0;
+   _fill_frame(1000, uFrame);
+   if ( ! rc_uplink_slot_write(&writer, uFrame, _get_frame_length(1000), 1000) )
+      iErrors++;
+
+   u32 uSeq = writer.pSlot->uSequence;
+   writer.pSlot->uSequence = uSeq + 1;
+   if ( 0 != rc_uplink_slot_read(&reader, uRead, &uTimeInput) )
+      iErrors++;
+   writer.pSlot->uSequence = uSeq;
+   int iLength = rc_uplink_slot_read(&reader, uRead, &uTimeInput);
+   if ( 1000 != _check_frame(uRead, iLength, uTimeInput) )
+      iErrors++;
+   if ( 0 != rc_uplink_slot_read(&reader, uRead, &uTimeInput) )
+      iErrors++;
+
+   // A writer that stopped in the middle of a write (odd sequence) does not block the next writes
+   writer.pSlot->uSequence = uSeq + 1;
+   _fill_frame(1001, uFrame);
+   rc_uplink_slot_write(&writer, uFrame, _get_frame_length(1001), 1001);
+   iLength = rc_uplink_slot_read(&reader, uRead, &uTimeInput);
+   if ( 1001 != _check_frame(uRead, iLength, uTimeInput) )
+      iErrors++;
+
+   rc_uplink_slot_close(&writer);
+   rc_uplink_slot_close(&reader);
+   return iErrors;
+}
+
+// A reader that stops reading the slot (mark_reader_gone) is not woken up by the frame left in it,
+// nor by a write that was in progress; the writer falls back to the IPC channels until the reader is back.
+int _test_reader_gone()
+{
+   t_rc_uplink_slot_endpoint writer;
+   t_rc_uplink_slot_endpoint reader;
+   if ( ! rc_uplink_slot_open(&reader, TEST_SLOT_ID, 1) )
+      return 1;
+   if ( ! rc_uplink_slot_open(&writer, TEST_SLOT_ID, 0) )
+      return 1;
+   if ( rc_uplink_slot_get_wait_fd(&reader) < 0 )
+      return 1;
+   rc_uplink_slot_mark_reader_alive(&reader, get_current_timestamp_ms());
+
+   int iErrors = 0;
+   u8 uFrame[RC_UPLINK_SLOT_MAX_PACKET_SIZE];
+   u8 uRead[RC_UPLINK_SLOT_MAX_PACKET_SIZE];
+   u32 uTimeInput = 0;
+   _fill_frame(2000, uFrame);
+   if ( ! rc_uplink_slot_write(&writer, uFrame, _get_frame_length(2000), 2000) )
+      iErrors++;
+   if ( ! rc_uplink_slot_begin_wait(&reader) )
+      iErrors++;
+   rc_uplink_slot_end_wait(&reader);
+
+   rc_uplink_slot_mark_reader_gone(&reader);
+   if ( rc_uplink_slot_begin_wait(&reader) )
+      iErrors++;
+   rc_uplink_slot_end_wait(&reader);
+   if ( 0 != rc_uplink_slot_read(&reader, uRead, &uTimeInput) )
+      iErrors++;
+   if ( rc_uplink_slot_write(&writer, uFrame, _get_frame_length(2000), 2000) )
+      iErrors++;
+
+   // Write in progress when the reader leaves, completed after
+   u32 uSeq = writer.pSlot->uSequence;
+   writer.pSlot->uSequence = uSeq + 1;
+   rc_uplink_slot_mark_reader_gone(&reader);
+   writer.pSlot->uSequence = uSeq + 2;
+   if ( rc_uplink_slot_begin_wait(&reader) )
+      iErrors++;
+   rc_uplink_slot_end_wait(&reader);
+
+   // Reader back
+   rc_uplink_slot_mark_reader_alive(&reader, get_current_timestamp_ms());
+   _fill_frame(2001, uFrame);
+   if ( ! rc_uplink_slot_write(&writer, uFrame, _get_frame_length(2001), 2001) )
+      iErrors++;
+   int iLength = rc_uplink_slot_read(&reader, uRead, &uTimeInput);
+   if ( 2001 != _check_frame(uRead, iLength, uTimeInput) )
+      iErrors++;
+
+   rc_uplink_slot_close(&writer);
+   rc_uplink_slot_close(&reader);
+   return iErrors;
+}
+
+// The slot sequence number wraps around: each frame written before and after the wrap is read once.
+int _test_sequence_wrap(u32 uStartSequence)
+{
+   t_rc_uplink_slot_endpoint writer;
+   t_rc_uplink_slot_endpoint reader;
+   if ( ! rc_uplink_slot_open(&reader, TEST_SLOT_ID, 1) )
+      return 1;
+   if ( ! rc_uplink_slot_open(&writer, TEST_SLOT_ID, 0) )
+      return 1;
+   // Opening the slot clears it
+   writer.pSlot->uSequence = uStartSequence;
+   reader.uLastSequence = uStartSequence;
+   rc_uplink_slot_mark_reader_alive(&reader, get_current_timestamp_ms());
+
+   int iErrors = 0;
+   u8 uFrame[RC_UPLINK_SLOT_MAX_PACKET_SIZE];
+   u8 uRead[RC_UPLINK_SLOT_MAX_PACKET_SIZE];
+   bool bWrapped = false;
+   for( u32 u=1; u<=8; u++ )
+   {
+      u32 uSeqBefore = writer.pSlot->uSequence;
+      _fill_frame(u, uFrame);
+      if ( ! rc_uplink_slot_write(&writer, uFrame, _get_frame_length(u), u) )
+         iErrors++;
+      if ( writer.pSlot->uSequence < uSeqBefore )
+         bWrapped = true;
+      if ( writer.pSlot->uSequence & 0x01 )
+         iErrors++;
+      u32 uTimeInput = 0;
+      int iLength = rc_uplink_slot_read(&reader, uRead, &uTimeInput);
+      if ( u != _check_frame(uRead, iLength, uTimeInput) )
+         iErrors++;
+      if ( 0 != rc_uplink_slot_read(&reader, uRead, &uTimeInput) )
+         iErrors++;
+   }
+   if ( ! bWrapped )
+      iErrors++;
+
+   rc_uplink_slot_close(&writer);
+   rc_uplink_slot_close(&reader);
+   return iErrors;
+}
+
+// Bucket i counts the samples up to (first bucket limit << i), the last bucket all the rest
+int _test_histogram_buckets()
+{
+   int iErrors = 0;
+   t_rc_latency_histogram histogram;
+   u32 uLimit = RC_LATENCY_HISTOGRAM_FIRST_BUCKET_MICROS;
+   for( int i=0; i<RC_LATENCY_HISTOGRAM_BUCKETS; i++ )
+   {
+      int iExpectedAbove = (i < RC_LATENCY_HISTOGRAM_BUCKETS-1)?(i+1):i;
+      u32 uValues[3] = { uLimit-1, uLimit, uLimit+1 };
+      int iExpected[3] = { i, i, iExpectedAbove };
+      if ( 0 == i )
+         uValues[0] = 0;
+      for( int k=0; k<3; k++ )
+      {
+         rc_latency_histogram_reset(&histogram);
+         rc_latency_histogram_add(&histogram, uValues[k]);
+         for( int b=0; b<RC_LATENCY_HISTOGRAM_BUCKETS; b++ )
+            if ( histogram.uCounts[b] != ((b == iExpected[k])?1u:0u) )
+               iErrors++;
+      }
+      uLimit <<= 1;
+   }
+
+   rc_latency_histogram_reset(&histogram);
+   rc_latency_histogram_add(&histogram, MAX_U32);
+   if ( histogram.uCounts[RC_LATENCY_HISTOGRAM_BUCKETS-1] != 1 )
+      iErrors++;
+
+   // Percentiles: the upper limit of the bucket that holds them, the max value for the last bucket
+   rc_latency_histogram_reset(&histogram);
+   if ( 0 != rc_latency_histogram_get_percentile(&histogram, 50) )
+      iErrors++;
+   for( int i=0; i<50; i++ )
+      rc_latency_histogram_add(&histogram, RC_LATENCY_HISTOGRAM_FIRST_BUCKET_MICROS);
+   for( int i=0; i<45; i++ )
+      rc_latency_histogram_add(&histogram, RC_LATENCY_HISTOGRAM_FIRST_BUCKET_MICROS+1);
+   for( int i=0; i<5; i++ )
+      rc_latency_histogram_add(&histogram, 10000000);
+   if ( rc_latency_histogram_get_percentile(&histogram, 50) != RC_LATENCY_HISTOGRAM_FIRST_BUCKET_MICROS )
+      iErrors++;
+   if ( rc_latency_histogram_get_percentile(&histogram, 95) != RC_LATENCY_HISTOGRAM_FIRST_BUCKET_MICROS*2 )
+      iErrors++;
+   if ( rc_latency_histogram_get_percentile(&histogram, 96) != 10000000 )
+      iErrors++;
+   if ( (histogram.uSamples != 100) || (histogram.uMinMicros != RC_LATENCY_HISTOGRAM_FIRST_BUCKET_MICROS) || (histogram.uMaxMicros != 10000000) )
+      iErrors++;
+   return iErrors;
+}
+
+int main(int argc, char *argv[])
+{
+   printf("\nTesting RC uplink slot and latency histograms\n");
+   log_init("TestRCUplink");
+   log_disable_stdout();
+
+   int iErrors = 0;
+   u32 uReads = 0;
+   int iErr = _test_concurrent_writer(&uReads);
+   printf(" concurrent writer, %u frames written, %u read: %s\n", TEST_WRITES, uReads, iErr?"FAILED":"ok");
+   iErrors += iErr;
+
+   iErr = _test_write_in_progress();
+   printf(" read while a write is in progress: %s\n", iErr?"FAILED":"ok");
+   iErrors += iErr;
+
+   iErr = _test_reader_gone();
+   printf(" reader not reading the slot: %s\n", iErr?"FAILED":"ok");
+   iErrors += iErr;
+
+   u32 uStartSequences[] = { 0xFFFFFFF8, 0xFFFFFFF9, 0xFFFFFFFF };
+   for( int i=0; i<(int)(sizeof(uStartSequences)/sizeof(uStartSequences[0])); i++ )
+   {
+      iErr = _test_sequence_wrap(uStartSequences[i]);
+      printf(" sequence wrap, starting from 0x%08X: %s\n", uStartSequences[i], iErr?"FAILED":"ok");
+      iErrors += iErr;
+   }
+
+   iErr = _test_histogram_buckets();
+   printf(" latency histogram buckets edges and percentiles: %s\n", iErr?"FAILED":"ok");
+   iErrors += iErr;
+
+   char szName[64];
+   snprintf(szName, sizeof(szName), "%s%d", SHARED_MEM_RC_UPLINK_SLOT, TEST_SLOT_ID);
+   shm_unlink(szName);
+
+   if ( iErrors )
+      printf("\nRC uplink test failed.\n");
+   else
+      printf("\nRC uplink test passed.\n");
+   return (iErrors?1:0);
+}
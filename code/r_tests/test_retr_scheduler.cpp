@@ -0,0 +1,257 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../r_station/retr_scheduler.h"
+
+// Simulates a video link with random packet loss (also on the retransmissions) and a fixed round trip time,
+// checks that the requests only contain packets that are missing and needed, that closed blocks get
+// recovered, that blocks are not requested again before the retry timeout and that the RTT estimation converges.
+
+#define TEST_BLOCKS 3000
+#define TEST_DATA_PACKETS 8
+#define TEST_EC_PACKETS 4
+#define TEST_RTT_MS 14
+#define TEST_WINDOW_MS 200
+#define TEST_MAX_PENDING 4096
+
+typedef struct
+{
+   u32 uTimeArrive;
+   u32 uBlockIndex;
+   u32 uPacketIndex;
+   u32 uRetrId;
+} t_test_pending_packet;
+
+t_test_pending_packet s_Pending[TEST_MAX_PENDING];
+int s_iPendingCount = 0;
+
+u32 s_uReceivedMask[TEST_BLOCKS];
+u32 s_uTimeLastRequested[TEST_BLOCKS];
+int s_iErrors = 0;
+
+int _count_bits(u32 uMask)
+{
+   int iCount = 0;
+   for( int i=0; i<32; i++ )
+      if ( uMask & (((u32)1) << i) )
+         iCount++;
+   return iCount;
+}
+
+void _add_pending(u32 uTime, u32 uBlockIndex, u32 uPacketIndex, u32 uRetrId)
+{
+   if ( s_iPendingCount >= TEST_MAX_PENDING )
+      return;
+   s_Pending[s_iPendingCount].uTimeArrive = uTime;
+   s_Pending[s_iPendingCount].uBlockIndex = uBlockIndex;
+   s_Pending[s_iPendingCount].uPacketIndex = uPacketIndex;
+   s_Pending[s_iPendingCount].uRetrId = uRetrId;
+   s_iPendingCount++;
+}
+
+int _test_basic()
+{
+   int iErrors = 0;
+   t_retr_scheduler sched;
+   retr_scheduler_init(&sched, 10, 100);
+   u8 uRanges[64*RETR_SCHED_RANGE_SIZE];
+   int iPackets = 0;
+   bool bReRequested = false;
+
+   // Block 100: packets 1,2 and 5 lost; block 101 fully lost; block 102 open
+   for( int k=0; k<TEST_DATA_PACKETS+TEST_EC_PACKETS; k++ )
+      if ( (k != 1) && (k != 2) && (k != 5) && (k < 10) )
+         retr_scheduler_on_packet(&sched, 100, k, TEST_DATA_PACKETS, TEST_EC_PACKETS, 1000);
+   // Block 100 not closed yet: nothing to request
+   if ( 0 != retr_scheduler_get_due_deadline(&sched, 1010, TEST_WINDOW_MS, true) )
+      iErrors++;
+   retr_scheduler_on_packet(&sched, 102, 0, TEST_DATA_PACKETS, TEST_EC_PACKETS, 1001);
+   // Coalescing delay
+   if ( 0 != retr_scheduler_get_due_deadline(&sched, 1001, TEST_WINDOW_MS, false) )
+      iErrors++;
+   if ( 1000 + TEST_WINDOW_MS != retr_scheduler_get_due_deadline(&sched, 1001 + RETR_SCHED_COALESCE_MS, TEST_WINDOW_MS, false) )
+      iErrors++;
+
+   // Block 100 received 7 of 12 packets (6 data + 1 EC): needs 1 more, the first missing data packet
+   int iCount = retr_scheduler_build_request(&sched, 1005, TEST_WINDOW_MS, false, uRanges, 64, 64, &iPackets, &bReRequested);
+   u32 uBlock = 0;
+   memcpy(&uBlock, uRanges, sizeof(u32));
+   if ( (iCount != 2) || (iPackets != 2) || bReRequested || (uBlock != 100) || (uRanges[4] != 1) || (uRanges[5] != 1) )
+      iErrors++;
+   memcpy(&uBlock, uRanges + RETR_SCHED_RANGE_SIZE, sizeof(u32));
+   if ( (uBlock != 101) || (uRanges[RETR_SCHED_RANGE_SIZE+4] != 0xFF) )
+      iErrors++;
+
+   // Nothing due until the retry timeout
+   if ( 0 != retr_scheduler_get_due_deadline(&sched, 1005 + 9, TEST_WINDOW_MS, true) )
+      iErrors++;
+   if ( 0 == retr_scheduler_get_due_deadline(&sched, 1005 + 10, TEST_WINDOW_MS, true) )
+      iErrors++;
+
+   // Two consecutive missing packets are sent as one range
+   retr_scheduler_on_packet(&sched, 101, 8, TEST_DATA_PACKETS, TEST_EC_PACKETS, 1010);
+   for( int k=3; k<TEST_DATA_PACKETS; k++ )
+      retr_scheduler_on_packet(&sched, 101, k, TEST_DATA_PACKETS, TEST_EC_PACKETS, 1010);
+   retr_scheduler_on_packet(&sched, 100, 1, TEST_DATA_PACKETS, TEST_EC_PACKETS, 1010);
+   iCount = retr_scheduler_build_request(&sched, 1020, TEST_WINDOW_MS, true, uRanges, 64, 64, &iPackets, &bReRequested);
+   memcpy(&uBlock, uRanges, sizeof(u32));
+   if ( (iCount != 1) || (iPackets != 2) || (! bReRequested) || (uBlock != 101) || (uRanges[4] != 0) || (uRanges[5] != 2) )
+      iErrors++;
+
+   // Past the retransmission window
+   if ( 0 != retr_scheduler_get_due_deadline(&sched, 1001 + TEST_WINDOW_MS, TEST_WINDOW_MS, true) )
+      iErrors++;
+
+   // Discarded blocks are not tracked anymore
+   retr_scheduler_discard_blocks_before(&sched, 102);
+   if ( 0 != retr_scheduler_get_missing_packets_count(&sched) )
+      iErrors++;
+
+   printf(" basic: %s\n", iErrors?"FAILED":"ok");
+   return iErrors;
+}
+
+int _test_link(int iLossPercent)
+{
+   t_retr_scheduler sched;
+   retr_scheduler_init(&sched, 10, 100);
+   memset(s_uReceivedMask, 0, sizeof(s_uReceivedMask));
+   memset(s_uTimeLastRequested, 0, sizeof(s_uTimeLastRequested));
+   s_iPendingCount = 0;
+   s_iErrors = 0;
+
+   u32 uRetrId = 0;
+   int iCountRequests = 0;
+   int iCountRequestedPackets = 0;
+   u8 uRanges[DEFAULT_VIDEO_RETRANS_MAX_PCOUNT * RETR_SCHED_RANGE_SIZE];
+   u32 uTimeEnd = 1000 + TEST_BLOCKS + TEST_WINDOW_MS;
+
+   // One block each ms, one packet each 1/12 ms
+   for( u32 uTime=1000; uTime<uTimeEnd; uTime++ )
+   {
+      u32 uBlock = uTime - 1000;
+      if ( uBlock < TEST_BLOCKS )
+      for( int k=0; k<TEST_DATA_PACKETS+TEST_EC_PACKETS; k++ )
+      {
+         if ( (rand() % 100) < iLossPercent )
+            continue;
+         retr_scheduler_on_packet(&sched, uBlock, k, TEST_DATA_PACKETS, TEST_EC_PACKETS, uTime);
+         s_uReceivedMask[uBlock] |= ((u32)1) << k;
+      }
+
+      // Retransmitted packets arriving now
+      for( int i=0; i<s_iPendingCount; i++ )
+      {
+         if ( s_Pending[i].uTimeArrive != uTime )
+            continue;
+         retr_scheduler_on_retransmission_response(&sched, s_Pending[i].uRetrId, uTime);
+         retr_scheduler_on_packet(&sched, s_Pending[i].uBlockIndex, s_Pending[i].uPacketIndex, TEST_DATA_PACKETS, TEST_EC_PACKETS, uTime);
+         s_uReceivedMask[s_Pending[i].uBlockIndex] |= ((u32)1) << s_Pending[i].uPacketIndex;
+         s_Pending[i] = s_Pending[s_iPendingCount-1];
+         s_iPendingCount--;
+         i--;
+      }
+
+      // End of frame every 4 blocks
+      bool bEOF = ((uTime % 4) == 3);
+      if ( bEOF )
+         retr_scheduler_on_frame_end(&sched, uTime);
+      if ( uBlock > 150 )
+         retr_scheduler_discard_blocks_before(&sched, uBlock - 150);
+
+      u32 uDeadline = retr_scheduler_get_due_deadline(&sched, uTime, TEST_WINDOW_MS, bEOF);
+      if ( 0 == uDeadline )
+         continue;
+      if ( (! bEOF) && (uDeadline > uTime + 2*retr_scheduler_get_retry_timeout_ms(&sched)) )
+         continue;
+
+      int iPackets = 0;
+      bool bReRequested = false;
+      int iCount = retr_scheduler_build_request(&sched, uTime, TEST_WINDOW_MS, bEOF, uRanges, DEFAULT_VIDEO_RETRANS_MAX_PCOUNT, DEFAULT_VIDEO_RETRANS_MAX_PCOUNT, &iPackets, &bReRequested);
+      if ( 0 == iCount )
+         continue;
+      uRetrId++;
+      iCountRequests++;
+      iCountRequestedPackets += iPackets;
+      retr_scheduler_on_request_sent(&sched, uRetrId, uTime);
+      if ( (rand() % 100) < iLossPercent )
+         continue;
+
+      int iTotal = 0;
+      for( int r=0; r<iCount; r++ )
+      {
+         u8* pRange = uRanges + r*RETR_SCHED_RANGE_SIZE;
+         u32 uReqBlock = 0;
+         memcpy(&uReqBlock, pRange, sizeof(u32));
+         if ( uReqBlock >= TEST_BLOCKS )
+         {
+            s_iErrors++;
+            continue;
+         }
+         // Not before the retry timeout (a block can have several ranges in the same request)
+         if ( (0 != s_uTimeLastRequested[uReqBlock]) && (uTime != s_uTimeLastRequested[uReqBlock]) && (uTime < s_uTimeLastRequested[uReqBlock] + RETR_SCHED_MIN_RETRY_TIMEOUT_MS) )
+            s_iErrors++;
+         s_uTimeLastRequested[uReqBlock] = uTime;
+
+         int iFirst = pRange[4];
+         int iCountPackets = pRange[5];
+         if ( 0xFF == iFirst )
+         {
+            iTotal++;
+            if ( 0 != s_uReceivedMask[uReqBlock] )
+               s_iErrors++;
+            for( int k=0; k<TEST_DATA_PACKETS; k++ )
+            if ( (rand() % 100) >= iLossPercent )
+               _add_pending(uTime + TEST_RTT_MS + k/4, uReqBlock, k, uRetrId);
+            continue;
+         }
+         iTotal += iCountPackets;
+         // Only missing data packets, and no more than needed
+         if ( _count_bits(s_uReceivedMask[uReqBlock]) + iCountPackets > TEST_DATA_PACKETS )
+            s_iErrors++;
+         for( int k=iFirst; k<iFirst+iCountPackets; k++ )
+         {
+            if ( (k >= TEST_DATA_PACKETS) || (s_uReceivedMask[uReqBlock] & (((u32)1) << k)) )
+               s_iErrors++;
+            if ( (rand() % 100) >= iLossPercent )
+               _add_pending(uTime + TEST_RTT_MS + (k-iFirst)/4, uReqBlock, k, uRetrId);
+         }
+      }
+      if ( iTotal != iPackets )
+         s_iErrors++;
+   }
+
+   int iUnrecoverable = 0;
+   for( int i=0; i<TEST_BLOCKS; i++ )
+      if ( _count_bits(s_uReceivedMask[i]) < TEST_DATA_PACKETS )
+         iUnrecoverable++;
+
+   u32 uRTT = retr_scheduler_get_smoothed_rtt_ms(&sched);
+   if ( (uRTT < TEST_RTT_MS - 1) || (uRTT > TEST_RTT_MS + 2) )
+      s_iErrors++;
+   // Retransmissions are lost too, but a block stays lost only if several retries fail
+   if ( iUnrecoverable > TEST_BLOCKS/200 )
+      s_iErrors++;
+
+   printf(" loss %d%%: %d requests, %d packets requested, %d unrecoverable blocks of %d, RTT: %u ms, retry timeout: %u ms: %s\n",
+      iLossPercent, iCountRequests, iCountRequestedPackets, iUnrecoverable, TEST_BLOCKS, uRTT,
+      retr_scheduler_get_retry_timeout_ms(&sched), s_iErrors?"FAILED":"ok");
+   return s_iErrors;
+}
+
+int main(int argc, char *argv[])
+{
+   printf("\nTesting video retransmissions scheduler\n");
+   log_init("TestRetrScheduler");
+   log_disable_stdout();
+
+   int iErrors = 0;
+   iErrors += _test_basic();
+   iErrors += _test_link(5);
+   iErrors += _test_link(20);
+
+   if ( iErrors )
+      printf("\nRetransmissions scheduler test failed.\n");
+   else
+      printf("\nRetransmissions scheduler test passed.\n");
+   return (iErrors?1:0);
+}
@@ -0,0 +1,262 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/flags_video.h"
+#include "../r_station/rx_video_rtp.h"
+
+// Packetizes a generated H264/H265 Annex-B stream (NALs of many sizes, 3 and 4 bytes start codes,
+// fed in random sized chunks), then depacketizes the RTP packets and checks that the same NALs,
+// sequence numbers, timestamps and frame markers come out.
+
+#define TEST_FRAMES 60
+#define TEST_MAX_NALS_PER_FRAME 4
+#define TEST_PACKET_SIZE 1200
+
+u8* s_pStream = NULL;
+int s_iStreamLength = 0;
+int s_iFramesEnd[TEST_FRAMES];
+
+u8* s_pNALs = NULL;
+int s_iNALsLength = 0;
+int s_iNALsCount = 0;
+
+u8* s_pDepacketized = NULL;
+int s_iDepacketizedLength = 0;
+int s_iDepacketizedNALs = 0;
+int s_iMarkers = 0;
+int s_iErrors = 0;
+bool s_bHasLastSequence = false;
+u16 s_uLastSequence = 0;
+u32 s_uFrameTimestamp = 0;
+bool s_bInsideFU = false;
+
+int _get_nal_size(int iFrame, int iNAL)
+{
+   // Some small NALs, some fragmented ones, and one larger than the packetizer NAL buffer
+   if ( (iFrame == 10) && (iNAL == 1) )
+      return RTP_NAL_BUFFER_SIZE + 12345;
+   int iRand = rand() % 10;
+   if ( iRand < 3 )
+      return 2 + rand() % 20;
+   if ( iRand < 6 )
+      return TEST_PACKET_SIZE - 20 + rand() % 40;
+   return 100 + rand() % 30000;
+}
+
+void _generate_stream(bool bH265)
+{
+   s_iStreamLength = 0;
+   s_iNALsLength = 0;
+   s_iNALsCount = 0;
+   for( int iFrame=0; iFrame<TEST_FRAMES; iFrame++ )
+   {
+      int iNALs = 1 + rand() % TEST_MAX_NALS_PER_FRAME;
+      if ( (iFrame == 10) && (iNALs < 2) )
+         iNALs = 2;
+      for( int iNAL=0; iNAL<iNALs; iNAL++ )
+      {
+         if ( rand() % 2 )
+            s_pStream[s_iStreamLength++] = 0;
+         s_pStream[s_iStreamLength++] = 0;
+         s_pStream[s_iStreamLength++] = 0;
+         s_pStream[s_iStreamLength++] = 1;
+
+         int iSize = _get_nal_size(iFrame, iNAL);
+         u8* pNAL = s_pStream + s_iStreamLength;
+         // No zero bytes in the payload, so no start code emulation
+         for( int i=0; i<iSize; i++ )
+            pNAL[i] = 1 + rand() % 255;
+         if ( bH265 )
+         {
+            pNAL[0] = ((rand() % 40) << 1);
+            pNAL[1] = 1;
+         }
+         else
+            pNAL[0] = 0x60 | (1 + rand() % 23);
+
+         // Length prefixed copy of the NAL, for comparison
+         memcpy(s_pNALs + s_iNALsLength, &iSize, sizeof(int));
+         memcpy(s_pNALs + s_iNALsLength + sizeof(int), pNAL, iSize);
+         s_iNALsLength += sizeof(int) + iSize;
+         s_iNALsCount++;
+         s_iStreamLength += iSize;
+      }
+      s_iFramesEnd[iFrame] = s_iStreamLength;
+   }
+}
+
+void _add_depacketized_nal_start(u8* pHeader, int iHeaderLength)
+{
+   memset(s_pDepacketized + s_iDepacketizedLength, 0, sizeof(int));
+   s_iDepacketizedLength += sizeof(int);
+   memcpy(s_pDepacketized + s_iDepacketizedLength, pHeader, iHeaderLength);
+   s_iDepacketizedLength += iHeaderLength;
+   s_iDepacketizedNALs++;
+}
+
+void _add_depacketized_nal_data(u8* pData, int iLength)
+{
+   memcpy(s_pDepacketized + s_iDepacketizedLength, pData, iLength);
+   s_iDepacketizedLength += iLength;
+}
+
+void _set_depacketized_nal_end(int iNALStart)
+{
+   int iSize = s_iDepacketizedLength - iNALStart - sizeof(int);
+   memcpy(s_pDepacketized + iNALStart, &iSize, sizeof(int));
+}
+
+int s_iCurrentNALStart = 0;
+
+void _depacketize(u8* pPacket, int iLength, bool bH265)
+{
+   if ( (pPacket[0] != 0x80) || ((pPacket[1] & 0x7F) != RTP_VIDEO_PAYLOAD_TYPE) || (iLength > TEST_PACKET_SIZE) )
+      s_iErrors++;
+   u16 uSequence = (((u16)pPacket[2]) << 8) | pPacket[3];
+   if ( s_bHasLastSequence && (uSequence != (u16)(s_uLastSequence+1)) )
+      s_iErrors++;
+   s_bHasLastSequence = true;
+   s_uLastSequence = uSequence;
+
+   u32 uTimestamp = (((u32)pPacket[4]) << 24) | (((u32)pPacket[5]) << 16) | (((u32)pPacket[6]) << 8) | pPacket[7];
+   if ( uTimestamp != s_uFrameTimestamp )
+      s_iErrors++;
+
+   u8* pPayload = pPacket + RTP_HEADER_SIZE;
+   int iPayload = iLength - RTP_HEADER_SIZE;
+   int iType = bH265?((pPayload[0] >> 1) & 0x3F):(pPayload[0] & 0x1F);
+   int iFUType = bH265?49:28;
+   if ( iType != iFUType )
+   {
+      if ( s_bInsideFU )
+         s_iErrors++;
+      s_iCurrentNALStart = s_iDepacketizedLength;
+      _add_depacketized_nal_start(pPayload, 0);
+      _add_depacketized_nal_data(pPayload, iPayload);
+      _set_depacketized_nal_end(s_iCurrentNALStart);
+   }
+   else
+   {
+      int iFUHeaderSize = bH265?3:2;
+      u8 uFUHeader = pPayload[iFUHeaderSize-1];
+      if ( uFUHeader & 0x80 )
+      {
+         if ( s_bInsideFU )
+            s_iErrors++;
+         s_bInsideFU = true;
+         u8 uNALHeader[2];
+         if ( bH265 )
+         {
+            uNALHeader[0] = (pPayload[0] & 0x81) | ((uFUHeader & 0x3F) << 1);
+            uNALHeader[1] = pPayload[1];
+         }
+         else
+            uNALHeader[0] = (pPayload[0] & 0xE0) | (uFUHeader & 0x1F);
+         s_iCurrentNALStart = s_iDepacketizedLength;
+         _add_depacketized_nal_start(uNALHeader, bH265?2:1);
+      }
+      else if ( ! s_bInsideFU )
+         s_iErrors++;
+      _add_depacketized_nal_data(pPayload + iFUHeaderSize, iPayload - iFUHeaderSize);
+      if ( uFUHeader & 0x40 )
+      {
+         s_bInsideFU = false;
+         _set_depacketized_nal_end(s_iCurrentNALStart);
+      }
+   }
+   if ( pPacket[1] & 0x80 )
+      s_iMarkers++;
+}
+
+bool s_bTestH265 = false;
+
+void _consume_packets(t_rtp_packetizer* pPacketizer)
+{
+   u8* pPacket = pPacketizer->pOutBuffer;
+   for( int i=0; i<pPacketizer->iOutPacketsCount; i++ )
+   {
+      _depacketize(pPacket, pPacketizer->iOutPacketsLengths[i], s_bTestH265);
+      pPacket += pPacketizer->iOutPacketsLengths[i];
+   }
+   rx_video_rtp_clear_packets(pPacketizer);
+}
+
+int _test_codec(bool bH265)
+{
+   s_bTestH265 = bH265;
+   _generate_stream(bH265);
+
+   s_iDepacketizedLength = 0;
+   s_iDepacketizedNALs = 0;
+   s_iMarkers = 0;
+   s_iErrors = 0;
+   s_bHasLastSequence = false;
+   s_bInsideFU = false;
+
+   t_rtp_packetizer packetizer;
+   if ( ! rx_video_rtp_init(&packetizer, bH265?VIDEO_TYPE_H265:VIDEO_TYPE_H264, TEST_PACKET_SIZE, _consume_packets) )
+      return 1;
+
+   u32 uTimeStart = get_current_timestamp_micros();
+   int iPos = 0;
+   u32 uLastTimestamp = 0;
+   for( int iFrame=0; iFrame<TEST_FRAMES; iFrame++ )
+   {
+      rx_video_rtp_set_frame_info(&packetizer, (u16)(iFrame + 65500), 33, 30, iFrame*33);
+      if ( (iFrame > 0) && (packetizer.uTimestamp - uLastTimestamp != 33*90) )
+         s_iErrors++;
+      uLastTimestamp = packetizer.uTimestamp;
+      s_uFrameTimestamp = packetizer.uTimestamp;
+      while ( iPos < s_iFramesEnd[iFrame] )
+      {
+         int iChunk = 1 + rand() % 1500;
+         if ( iPos + iChunk > s_iFramesEnd[iFrame] )
+            iChunk = s_iFramesEnd[iFrame] - iPos;
+         rx_video_rtp_add_data(&packetizer, s_pStream + iPos, iChunk, (iPos + iChunk == s_iFramesEnd[iFrame]));
+         iPos += iChunk;
+      }
+      _consume_packets(&packetizer);
+   }
+   u32 uTime = get_current_timestamp_micros() - uTimeStart;
+
+   u8 uSR[RTCP_SR_PACKET_SIZE];
+   if ( (RTCP_SR_PACKET_SIZE != rx_video_rtp_build_sender_report(&packetizer, uSR, TEST_FRAMES*33)) || (uSR[1] != 200) )
+      s_iErrors++;
+   u32 uPackets = packetizer.uTotalPacketsSent;
+   rx_video_rtp_uninit(&packetizer);
+
+   if ( s_iMarkers != TEST_FRAMES )
+      s_iErrors++;
+   if ( (s_iDepacketizedNALs != s_iNALsCount) || (s_iDepacketizedLength != s_iNALsLength) ||
+        (0 != memcmp(s_pDepacketized, s_pNALs, s_iNALsLength)) )
+      s_iErrors++;
+
+   printf(" %s: %d NALs, %u RTP packets, %.1f MB/s: %s\n", bH265?"H265":"H264", s_iNALsCount, uPackets,
+      (float)s_iStreamLength/(float)(uTime?uTime:1), s_iErrors?"FAILED":"ok");
+   return s_iErrors;
+}
+
+int main(int argc, char *argv[])
+{
+   printf("\nTesting RTP video packetizer\n");
+   log_init("TestRTP");
+   log_disable_stdout();
+
+   int iMaxSize = TEST_FRAMES * TEST_MAX_NALS_PER_FRAME * 40000 + 2*RTP_NAL_BUFFER_SIZE;
+   s_pStream = (u8*) malloc(iMaxSize);
+   s_pNALs = (u8*) malloc(iMaxSize);
+   s_pDepacketized = (u8*) malloc(iMaxSize);
+
+   int iErrors = 0;
+   iErrors += _test_codec(false);
+   iErrors += _test_codec(true);
+
+   free(s_pStream);
+   free(s_pNALs);
+   free(s_pDepacketized);
+
+   if ( iErrors )
+      printf("\nRTP test failed.\n");
+   else
+      printf("\nRTP test passed.\n");
+   return (iErrors?1:0);
+}
@@ -0,0 +1,190 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/shared_mem_video_frames.h"
+
+// Writes video frames of random sizes (in random sized chunks) to the shared memory frames ring
+// and reads them back from a reader mapping, checking the frames content, order and flags,
+// the wrap around of the data area, the detection of frames overwritten by a faster writer
+// and the per segment publishing used in low latency mode.
+
+#define TEST_SM_NAME "/SSMRVideoTest"
+#define TEST_FRAMES 5000
+
+u8 s_uFrame[SM_VIDEO_FRAMES_DATA_SIZE/2];
+#define TEST_FRAMES_BEHIND SM_VIDEO_FRAMES_SLOTS
+#define TEST_FRAMES_SEGMENTS 100
+
+u8 s_uAssembled[SM_VIDEO_FRAMES_DATA_SIZE/2];
+int s_iFramesSizes[TEST_FRAMES+TEST_FRAMES_BEHIND+TEST_FRAMES_SEGMENTS];
+
+int _get_frame_size(u32 uFrame)
+{
+   if ( (uFrame % 60) == 0 )
+      return 100000 + rand() % 150000;
+   return 500 + rand() % 30000;
+}
+
+void _fill_frame(u32 uFrame, int iSize)
+{
+   for( int i=0; i<iSize; i++ )
+      s_uFrame[i] = (u8)((uFrame * 31 + i) & 0xFF);
+}
+
+bool _check_frame(u32 uFrame, u8* pData, int iSize)
+{
+   for( int i=0; i<iSize; i++ )
+      if ( pData[i] != (u8)((uFrame * 31 + i) & 0xFF) )
+         return false;
+   return true;
+}
+
+// Low latency mode: each chunk is published as its own slot, flagged as partial, except the last one.
+// The reader keeps up, reading each segment as it is published, and joins them back in s_uAssembled.
+// Returns the number of errors.
+int _write_read_frame_segments(shared_mem_video_frames* pWriter, shared_mem_video_frames* pReader, u32 uFrame)
+{
+   int iErrors = 0;
+   int iSize = _get_frame_size(uFrame);
+   s_iFramesSizes[uFrame] = iSize;
+   _fill_frame(uFrame, iSize);
+   int iPos = 0;
+   int iAssembled = 0;
+   shared_mem_video_frame_slot slot;
+   u8* pData = NULL;
+   while ( iPos < iSize )
+   {
+      int iChunk = 1 + rand() % 1400;
+      if ( iPos + iChunk > iSize )
+         iChunk = iSize - iPos;
+      u8* pWrite = shared_mem_video_frames_reserve(pWriter, uFrame, iChunk, uFrame);
+      if ( NULL != pWrite )
+         memcpy(pWrite, s_uFrame + iPos, iChunk);
+      iPos += iChunk;
+      if ( iPos < iSize )
+         shared_mem_video_frames_add_flags(pWriter, SM_VIDEO_FRAME_FLAG_PARTIAL);
+      shared_mem_video_frames_end_frame(pWriter);
+
+      if ( ! shared_mem_video_frames_read_next(pReader, &slot, &pData) )
+         return iErrors+1;
+      if ( (slot.uFrameIndex != uFrame) || ((int)slot.uDataLength != iChunk) ||
+           ((iPos < iSize) != ((slot.uFlags & SM_VIDEO_FRAME_FLAG_PARTIAL) != 0)) )
+         iErrors++;
+      memcpy(s_uAssembled + iAssembled, pData, iChunk);
+      iAssembled += iChunk;
+   }
+   if ( ! _check_frame(uFrame, s_uAssembled, iAssembled) )
+      iErrors++;
+   return iErrors;
+}
+
+void _write_frame(shared_mem_video_frames* pWriter, u32 uFrame, bool bEndFrame)
+{
+   int iSize = _get_frame_size(uFrame);
+   s_iFramesSizes[uFrame] = iSize;
+   _fill_frame(uFrame, iSize);
+   int iPos = 0;
+   while ( iPos < iSize )
+   {
+      int iChunk = 1 + rand() % 1400;
+      if ( iPos + iChunk > iSize )
+         iChunk = iSize - iPos;
+      u8* pWrite = shared_mem_video_frames_reserve(pWriter, uFrame, iChunk, uFrame);
+      if ( NULL != pWrite )
+         memcpy(pWrite, s_uFrame + iPos, iChunk);
+      iPos += iChunk;
+   }
+   if ( (uFrame % 60) == 0 )
+      shared_mem_video_frames_add_flags(pWriter, SM_VIDEO_FRAME_FLAG_KEYFRAME);
+   if ( bEndFrame )
+      shared_mem_video_frames_end_frame(pWriter);
+}
+
+int main(int argc, char *argv[])
+{
+   printf("\nTesting shared memory video frames ring\n");
+   log_init("TestSMFrames");
+   log_disable_stdout();
+
+   shared_mem_video_frames* pWriter = shared_mem_video_frames_open_write(TEST_SM_NAME);
+   shared_mem_video_frames* pReader = shared_mem_video_frames_open_read(TEST_SM_NAME);
+   if ( (NULL == pWriter) || (NULL == pReader) )
+   {
+      printf("Failed to open the shared memory.\n");
+      return 1;
+   }
+
+   int iErrors = 0;
+   u32 uFramesRead = 0;
+   u32 uBytesRead = 0;
+   shared_mem_video_frame_slot slot;
+   u8* pData = NULL;
+
+   // Reader keeps up with the writer; every 10th frame has its end of frame lost
+   u32 uTimeStart = get_current_timestamp_micros();
+   for( u32 uFrame=0; uFrame<TEST_FRAMES; uFrame++ )
+   {
+      _write_frame(pWriter, uFrame, (uFrame % 10) != 9);
+      while ( shared_mem_video_frames_read_next(pReader, &slot, &pData) )
+      {
+         bool bEndMissing = (slot.uFrameIndex % 10) == 9;
+         if ( (slot.uFrameIndex != uFramesRead) || ((int)slot.uDataLength != s_iFramesSizes[slot.uFrameIndex]) ||
+              (! _check_frame(slot.uFrameIndex, pData, slot.uDataLength)) ||
+              (((slot.uFrameIndex % 60) == 0) != ((slot.uFlags & SM_VIDEO_FRAME_FLAG_KEYFRAME) != 0)) ||
+              (bEndMissing != ((slot.uFlags & SM_VIDEO_FRAME_FLAG_END_MISSING) != 0)) ||
+              (! shared_mem_video_frames_is_still_valid(pReader, &slot)) )
+            iErrors++;
+         uFramesRead++;
+         uBytesRead += slot.uDataLength;
+      }
+   }
+   u32 uTime = get_current_timestamp_micros() - uTimeStart;
+   // The last frame is published by the next frame start or end of frame
+   if ( uFramesRead != TEST_FRAMES - 1 )
+      iErrors++;
+   printf(" in order: %u frames, %.1f MB/s: %s\n", uFramesRead, (float)uBytesRead/(float)(uTime?uTime:1), iErrors?"FAILED":"ok");
+
+   // Reader holds a frame while the writer goes on: the overwrite must be detected
+   int iErrorsOverwrite = 0;
+   shared_mem_video_frames_end_frame(pWriter);
+   while ( shared_mem_video_frames_read_next(pReader, &slot, &pData) );
+   _write_frame(pWriter, TEST_FRAMES, true);
+   if ( ! shared_mem_video_frames_read_next(pReader, &slot, &pData) )
+      iErrorsOverwrite++;
+   for( u32 uFrame=TEST_FRAMES+1; uFrame<TEST_FRAMES+TEST_FRAMES_BEHIND; uFrame++ )
+      _write_frame(pWriter, uFrame, true);
+   if ( shared_mem_video_frames_is_still_valid(pReader, &slot) )
+      iErrorsOverwrite++;
+
+   // Reader too far behind: skips to the most recent frames
+   if ( ! shared_mem_video_frames_read_next(pReader, &slot, &pData) )
+      iErrorsOverwrite++;
+   if ( (slot.uFrameIndex != TEST_FRAMES+TEST_FRAMES_BEHIND-1) || (! _check_frame(slot.uFrameIndex, pData, slot.uDataLength)) || (0 == pReader->uFramesSkipped) )
+      iErrorsOverwrite++;
+   printf(" overwrite detection: %s\n", iErrorsOverwrite?"FAILED":"ok");
+   iErrors += iErrorsOverwrite;
+
+   // Per segment publishing: the reader gets the frames back by joining the partial slots
+   int iErrorsSegments = 0;
+   u32 uFrameStart = TEST_FRAMES+TEST_FRAMES_BEHIND;
+   u32 uFramesJoined = 0;
+   while ( shared_mem_video_frames_read_next(pReader, &slot, &pData) );
+   for( u32 uFrame=uFrameStart; uFrame<uFrameStart+TEST_FRAMES_SEGMENTS; uFrame++ )
+   {
+      int iErr = _write_read_frame_segments(pWriter, pReader, uFrame);
+      if ( 0 == iErr )
+         uFramesJoined++;
+      iErrorsSegments += iErr;
+   }
+   printf(" per segment publishing: %u frames: %s\n", uFramesJoined, iErrorsSegments?"FAILED":"ok");
+   iErrors += iErrorsSegments;
+
+   shared_mem_video_frames_close(TEST_SM_NAME, pReader);
+   shared_mem_video_frames_close(TEST_SM_NAME, pWriter);
+   shm_unlink(TEST_SM_NAME);
+
+   if ( iErrors )
+      printf("\nShared memory frames test failed.\n");
+   else
+      printf("\nShared memory frames test passed.\n");
+   return (iErrors?1:0);
+}
@@ -38,6 +38,7 @@
 #include "../base/models.h"
 #include "../base/flags_video.h"
 #include "../common/string_utils.h"
+#include "../r_station/rx_video_recording_mp4.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <sys/resource.h>
@@ -78,6 +79,12 @@ void _store_error(const char* szErrorMsg)
       log_softerror_and_alarm("Failed to store error in file: [%s], [%s]", szFileError, szErrorMsg);
 }
 
+bool _is_mp4_file(const char* szFile)
+{
+   int iLen = strlen(szFile);
+   return (iLen > 4) && (0 == strcmp(szFile + iLen - 4, ".mp4"));
+}
+
 bool store_video()
 {
    char szFileInInfo[MAX_FILE_PATH_SIZE];
@@ -189,7 +196,9 @@ bool store_video()
    sprintf(szOutFileInfo, FILE_FORMAT_VIDEO_INFO, vehicle_name, g_iBootCount, (int)timeNow/1000, (int)timeNow%1000 );
 
    strncpy(szOutFileVideo, szOutFileInfo, sizeof(szOutFileVideo)/sizeof(szOutFileVideo[0]));
-   if ( iVideoType == VIDEO_TYPE_H265 )
+   if ( _is_mp4_file(szFileInVideo) )
+      hardware_file_replace_extension(szOutFileVideo, "mp4");
+   else if ( iVideoType == VIDEO_TYPE_H265 )
       hardware_file_replace_extension(szOutFileVideo, "h265");
    else
       hardware_file_replace_extension(szOutFileVideo, "h264");
@@ -272,8 +281,11 @@ bool process_video(char* szFileInfo, char* szFileOut)
       return true;
    }
 
-   // Convert input file to output file
-   snprintf(szComm, sizeof(szComm)/sizeof(szComm[0]), "ffmpeg -framerate %d -y -i %s%s -c:v copy %s 2>&1 1>/dev/null", fps, FOLDER_MEDIA, szFileInVideo, szFileOut);
+   // Recordings are already mp4 files; raw streams (older recordings) are converted to mp4
+   if ( _is_mp4_file(szFileInVideo) )
+      snprintf(szComm, sizeof(szComm)/sizeof(szComm[0]), "nice -n %d cp -f %s%s %s 2>&1 1>/dev/null", niceValue, FOLDER_MEDIA, szFileInVideo, szFileOut);
+   else
+      snprintf(szComm, sizeof(szComm)/sizeof(szComm[0]), "ffmpeg -framerate %d -y -i %s%s -c:v copy %s 2>&1 1>/dev/null", fps, FOLDER_MEDIA, szFileInVideo, szFileOut);
    log_line("Execute conversion: %s", szComm);
    //hw_execute_bash_command(szComm, NULL);
    //launcher_set_proc_priority("ffmpeg", 10,0,1);
@@ -310,6 +322,12 @@ int main(int argc, char *argv[])
 
    log_init("RubyVideoProcessor");
 
+   if ( (argc >= 3) && (0 == strcmp(argv[1], "-annexb")) )
+   {
+      rx_video_mp4_to_annexb(argv[2], stdout, &gbQuit);
+      return 0;
+   }
+
    hardware_detectBoardAndSystemType();
 
    g_pCurrentModel = new Model();
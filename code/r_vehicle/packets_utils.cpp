@@ -950,6 +950,9 @@ bool _send_packet_to_wifi_radio_interface(int iLocalRadioLinkId, int iRadioInter
          if ( (g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_ENC_DATA) || (g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_ENC_ALL) )
             be = 1;
       }
+      // The authenticated mode applies to all the streams: the controller drops the packets that are not authenticated
+      if ( g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_AUTHENTICATED )
+         be = ENC_MODE_AUTHENTICATED;
    }
 
    int iDataRateTx = _compute_packet_downlink_datarate_radioflags_tx_power(pPacketData, iVehicleRadioLinkId, iRadioInterfaceIndex);
@@ -966,6 +969,9 @@ bool _send_packet_to_wifi_radio_interface(int iLocalRadioLinkId, int iRadioInter
    }
 
    int totalLength = radio_build_new_raw_ieee_packet(iLocalRadioLinkId, s_RadioRawPacket, pPacketData, nPacketLength, RADIO_PORT_ROUTER_DOWNLINK, be);
+   // Not built (no pass phrase, or too big for the authenticated encryption); already logged
+   if ( totalLength <= 0 )
+      return false;
 
    int iRepeatCount = 0;
    if ( pPH->packet_type == PACKET_TYPE_VIDEO_ADAPTIVE_VIDEO_PARAMS_ACK )
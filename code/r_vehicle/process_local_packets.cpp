@@ -625,6 +625,7 @@ void _process_local_notification_model_changed(t_packet_header* pPH, int changeT
    if ( changeType == MODEL_CHANGED_RELAY_PARAMS )
    {
       log_line("Received notification from commands that relay params or mode changed.");
+      update_radio_auth_encryption_requirement();
       log_line("Old relay params: VID: %u, freq: %s, on vehicle's radio link %d, relay flags: (%s)", oldRelayParams.uRelayedVehicleId, str_format_frequency(oldRelayParams.uRelayFrequencyKhz), oldRelayParams.isRelayEnabledOnRadioLinkId, str_format_relay_flags(oldRelayParams.uRelayCapabilitiesFlags));
       log_line("New relay params: VID: %u, freq: %s, on vehicle's radio link %d, relay flags: (%s)", g_pCurrentModel->relay_params.uRelayedVehicleId, str_format_frequency(g_pCurrentModel->relay_params.uRelayFrequencyKhz), g_pCurrentModel->relay_params.isRelayEnabledOnRadioLinkId, str_format_relay_flags(g_pCurrentModel->relay_params.uRelayCapabilitiesFlags));
       u8 uOldRelayMode = oldRelayParams.uCurrentRelayMode;
@@ -886,6 +887,7 @@ void _process_local_notification_model_changed(t_packet_header* pPH, int changeT
             saveCurrentModel();
          }
       }
+      update_radio_auth_encryption_requirement();
       bMustSignalOtherComponents = false;
    }
 
@@ -34,6 +34,7 @@
 #include "../base/config.h"
 #include "../base/models_list.h"
 #include "../base/ruby_ipc.h"
+#include "../base/encr.h"
 #include "../common/radio_stats.h"
 #include "../common/string_utils.h"
 #include "../common/relay_utils.h"
@@ -273,6 +274,15 @@ void relay_on_relay_flags_changed(u32 uNewFlags)
    log_line("[Relay] Relay flags changed to: %u, %s", uNewFlags, str_format_relay_flags(uNewFlags));
 }
 
+// A relay vehicle in the authenticated mode authenticates the packets it relays (the controller uplink packets
+// relayed to a vehicle in the authenticated mode must be authenticated, or that vehicle drops them)
+int _relay_get_encryption_mode()
+{
+   if ( (g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_AUTHENTICATED) && hpp() )
+      return ENC_MODE_AUTHENTICATED;
+   return 0;
+}
+
 void relay_send_packet_to_controller(u8* pBufferData, int iBufferLength)
 {
    if ( iBufferLength <= 0 )
@@ -357,7 +367,7 @@ void relay_send_packet_to_controller(u8* pBufferData, int iBufferLength)
       u32 radioFlags = g_pCurrentModel->radioInterfacesParams.interface_current_radio_flags[iRadioInterfaceIndex];
       radio_set_frames_flags(radioFlags, g_TimeNow);
 
-      int totalLength = radio_build_new_raw_ieee_packet(iRadioLinkId, s_RadioRawPacketRelayed, pBufferData, iBufferLength, RADIO_PORT_ROUTER_DOWNLINK, 0);
+      int totalLength = radio_build_new_raw_ieee_packet(iRadioLinkId, s_RadioRawPacketRelayed, pBufferData, iBufferLength, RADIO_PORT_ROUTER_DOWNLINK, _relay_get_encryption_mode());
 
       if ( (totalLength >0) && radio_write_raw_ieee_packet(iRadioInterfaceIndex, s_RadioRawPacketRelayed, totalLength, 0) )
       {           
@@ -365,7 +375,7 @@ void relay_send_packet_to_controller(u8* pBufferData, int iBufferLength)
          g_SM_RadioStats.radio_links[iRadioLinkId].totalTxPackets++;
          g_SM_RadioStats.radio_links[iRadioLinkId].totalTxBytes += iBufferLength;
       }
-      else
+      else if ( totalLength > 0 )
          log_softerror_and_alarm("[RelayTX] Failed to write to radio interface %d.", iRadioInterfaceIndex+1);
    }
 
@@ -445,7 +455,7 @@ void relay_send_single_packet_to_relayed_vehicle(u8* pBufferData, int iBufferLen
       u32 radioFlags = g_pCurrentModel->radioInterfacesParams.interface_current_radio_flags[iRadioInterfaceIndex];
       radio_set_frames_flags(radioFlags, g_TimeNow);
 
-      int totalLength = radio_build_new_raw_ieee_packet(iRadioLinkId, s_RadioRawPacketRelayed, pBufferData, iBufferLength, RADIO_PORT_ROUTER_UPLINK, 0);
+      int totalLength = radio_build_new_raw_ieee_packet(iRadioLinkId, s_RadioRawPacketRelayed, pBufferData, iBufferLength, RADIO_PORT_ROUTER_UPLINK, _relay_get_encryption_mode());
 
       if ( (totalLength>0) && radio_write_raw_ieee_packet(iRadioInterfaceIndex, s_RadioRawPacketRelayed, totalLength, 0) )
       {           
@@ -453,7 +463,7 @@ void relay_send_single_packet_to_relayed_vehicle(u8* pBufferData, int iBufferLen
          g_SM_RadioStats.radio_links[iRadioLinkId].totalTxPackets++;
          g_SM_RadioStats.radio_links[iRadioLinkId].totalTxBytes += iBufferLength;
       }
-      else
+      else if ( totalLength > 0 )
          log_softerror_and_alarm("[RelayTX] Failed to write to radio interface %d.", iRadioInterfaceIndex+1);
    }
 
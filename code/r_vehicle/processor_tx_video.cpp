@@ -264,32 +264,80 @@ bool process_data_tx_video_command(int iRadioInterface, u8* pPacketBuffer)
    {
       static u32 s_uLastRecvRetransmissionId = 0;
       static u32 s_uTimeLastRetransmissionRequest = 0;
+      if ( pPH->total_length < sizeof(t_packet_header) + sizeof(u32) + 3*sizeof(u8) )
+         return false;
       u32 uRetrId = 0;
       memcpy(&uRetrId, &pPacketBuffer[sizeof(t_packet_header)], sizeof(u32));
       u8 uFlags = pPacketBuffer[sizeof(t_packet_header) + sizeof(u32) + sizeof(u8)];
       u8 uCount = pPacketBuffer[sizeof(t_packet_header) + sizeof(u32) + 2*sizeof(u8)];
-      
+
+      // Entries: (block index, first packet index, packets count) for ranges, (block index, packet index) otherwise;
+      // then the end of frame request (frame index, packets count), if flagged
+      int iEntrySize = (uFlags & (0x01<<3))?(sizeof(u32) + 2*sizeof(u8)):(sizeof(u32) + sizeof(u8));
+      int iRequestLength = sizeof(t_packet_header) + sizeof(u32) + 3*sizeof(u8) + (int)uCount * iEntrySize;
+      if ( uFlags & (0x01<<2) )
+         iRequestLength += sizeof(u16) + sizeof(u8);
+      if ( iRequestLength > (int)pPH->total_length )
+      {
+         log_softerror_and_alarm("[TxVideoProc] Received invalid retr request id %u: %d entries need %d bytes, packet has %d bytes. Ignored.",
+            uRetrId, (int)uCount, iRequestLength, (int)pPH->total_length);
+         return false;
+      }
+
       if ( uRetrId == s_uLastRecvRetransmissionId )
       {
-         log_line("[TxVideoProc] Received duplicate retr request id %u from controller for %d packets, flags: %s %s, last request was %u ms ago. Ignored.",
-            uRetrId, (int)uCount, (uFlags & 0x01)?"has re-requested packets":"", (uFlags & (0x01<<2))?"has frame eof request":"",
+         log_line("[TxVideoProc] Received duplicate retr request id %u from controller for %d %s, flags: %s %s, last request was %u ms ago. Ignored.",
+            uRetrId, (int)uCount, (uFlags & (0x01<<3))?"packet ranges":"packets", (uFlags & 0x01)?"has re-requested packets":"", (uFlags & (0x01<<2))?"has frame eof request":"",
             g_TimeNow - s_uTimeLastRetransmissionRequest);
          s_uTimeLastRetransmissionRequest = g_TimeNow;
          return false;
       }
 
-      log_line("[TxVideoProc] Received retr request id %u from controller for %d packets, flags: %s %s, lost retransmissions requests: %d, last request was %u ms ago.",
-         uRetrId, (int)uCount, (uFlags & 0x01)?"has re-requested packets":"", (uFlags & (0x01<<2))?"has frame eof request":"",
+      log_line("[TxVideoProc] Received retr request id %u from controller for %d %s, flags: %s %s, lost retransmissions requests: %d, last request was %u ms ago.",
+         uRetrId, (int)uCount, (uFlags & (0x01<<3))?"packet ranges":"packets", (uFlags & 0x01)?"has re-requested packets":"", (uFlags & (0x01<<2))?"has frame eof request":"",
          uRetrId - s_uLastRecvRetransmissionId - 1, g_TimeNow - s_uTimeLastRetransmissionRequest);
       s_uTimeLastRetransmissionRequest = g_TimeNow;
 
+      // Number of packets requested (uCount is the number of ranges when ranges are used; a full block request counts as one)
+      int iCountRequested = (int)uCount;
+      if ( uFlags & (0x01<<3) )
+      {
+         iCountRequested = 0;
+         u8* pRanges = pPacketBuffer + sizeof(t_packet_header) + sizeof(u32) + 3*sizeof(u8);
+         for( int i=0; i<(int)uCount; i++ )
+         {
+            u8 uFirstPacketIndex = pRanges[sizeof(u32)];
+            u8 uPacketsCount = pRanges[sizeof(u32)+1];
+            pRanges += sizeof(u32) + 2*sizeof(u8);
+            iCountRequested += (uFirstPacketIndex == 0xFF)?1:(int)uPacketsCount;
+         }
+      }
+
       int iCounter = 0;
       while ( iCounter < 3 )
       {
          if ( iCounter > 0 )
             log_line("[TxVideoProc] Duplicate the retransmission id %u", uRetrId);
          u8* pDataPackets = pPacketBuffer + sizeof(t_packet_header) + sizeof(u32) + 3*sizeof(u8);
-         for( int i=0; i<(int)uCount; i++ )
+         // Packet ranges: (block index, first packet index, packets count)
+         for( int i=0; (uFlags & (0x01<<3)) && (i<(int)uCount); i++ )
+         {
+            u32 uBlockId = 0;
+            memcpy(&uBlockId, pDataPackets, sizeof(u32));
+            pDataPackets += sizeof(u32);
+            u8 uFirstPacketIndex = pDataPackets[0];
+            u8 uPacketsCount = pDataPackets[1];
+            pDataPackets += 2*sizeof(u8);
+            if ( uFirstPacketIndex == 0xFF )
+            {
+               log_line("[TxVideoProc] Received request for full video block [%u] in retr id %u", uBlockId, uRetrId);
+               g_pVideoTxBuffers->resendVideoPacket(uRetrId, uBlockId, 0xFF);
+               continue;
+            }
+            for( int k=0; (k<(int)uPacketsCount) && ((int)uFirstPacketIndex + k < MAX_TOTAL_PACKETS_IN_BLOCK); k++ )
+               g_pVideoTxBuffers->resendVideoPacket(uRetrId, uBlockId, (u32)uFirstPacketIndex + k);
+         }
+         for( int i=0; (!(uFlags & (0x01<<3))) && (i<(int)uCount); i++ )
          {
             u32 uBlockId = 0;
             u8 uPacketIndex = 0;
@@ -320,9 +368,9 @@ bool process_data_tx_video_command(int iRadioInterface, u8* pPacketBuffer)
             iMaxCountThreshold = 8;
 
          if ( (g_pCurrentModel->video_link_profiles[g_pCurrentModel->video_params.iCurrentVideoProfile].uProfileFlags & VIDEO_PROFILE_FLAG_RETRANSMISSIONS_AGGRESIVE) || (uFlags & 0x01) )
-         if ( (s_uLastRecvRetransmissionId != uRetrId) && (uCount < iMaxCountThreshold) )
+         if ( (s_uLastRecvRetransmissionId != uRetrId) && (iCountRequested < iMaxCountThreshold) )
             bDuplicate = true;
-         if ( uCount < iMaxCountThreshold )
+         if ( iCountRequested < iMaxCountThreshold )
          if ( uFlags & 0x01 )
             bDuplicate = true;
 
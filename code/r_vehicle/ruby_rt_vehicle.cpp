@@ -64,6 +64,7 @@
 #include "../base/radio_utils.h"
 #include "../base/encr.h"
 #include "../base/ruby_ipc.h"
+#include "../base/reactor.h"
 #include "../base/utils.h"
 #include "../base/camera_utils.h"
 #include "../base/vehicle_settings.h"
@@ -189,6 +190,11 @@ void signal_end_long_op()
 }
 
 
+void update_radio_auth_encryption_requirement()
+{
+   radio_set_require_auth_encryption((g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_AUTHENTICATED)?1:0, relay_get_relayed_vehicle_id(g_pCurrentModel));
+}
+
 void checkDeveloperFlagsChanges(u32 uOldDeveloperFlags, u32 uNewDeveloperFlags)
 {
    if ( uOldDeveloperFlags == uNewDeveloperFlags )
@@ -971,6 +977,78 @@ void _broadcast_router_ready()
    log_line("Broadcasted that router is ready.");
 }
 
+// The main loop sleeps in the reactor until there is camera data, radio packets or IPC messages to process.
+// The reactor timer tick keeps the time based periodic work going.
+#define ROUTER_REACTOR_TICK_MICROS 5000
+
+static t_reactor s_RouterReactor;
+static bool s_bRouterReactorInitialized = false;
+static bool s_bMainLoopWaitedForWork = false;
+static u32 s_uMainLoopReadySources = 0;
+
+void _main_loop_init_reactor()
+{
+   s_bRouterReactorInitialized = (1 == reactor_init(&s_RouterReactor, ROUTER_REACTOR_TICK_MICROS));
+   if ( ! s_bRouterReactorInitialized )
+   {
+      log_softerror_and_alarm("Failed to initialize main loop reactor. Will poll for work.");
+      return;
+   }
+   reactor_add_source(&s_RouterReactor, ruby_ipc_channel_get_wait_fd(s_fIPCRouterFromRC), REACTOR_SOURCE_IPC);
+   reactor_add_source(&s_RouterReactor, ruby_ipc_channel_get_wait_fd(s_fIPCRouterFromCommands), REACTOR_SOURCE_IPC);
+   reactor_add_source(&s_RouterReactor, ruby_ipc_channel_get_wait_fd(s_fIPCRouterFromTelemetry), REACTOR_SOURCE_IPC);
+   log_line("Main loop reactor initialized.");
+}
+
+void _main_loop_uninit_reactor()
+{
+   if ( ! s_bRouterReactorInitialized )
+      return;
+   reactor_uninit(&s_RouterReactor);
+   s_bRouterReactorInitialized = false;
+}
+
+// Returns the ready sources (REACTOR_SOURCE_*), or 0 if the main loop did not wait (the reactor is not used)
+u32 _main_loop_wait_for_work()
+{
+   s_bMainLoopWaitedForWork = false;
+   if ( ! s_bRouterReactorInitialized )
+      return 0;
+
+   int iCameraFd = -1;
+   if ( g_pCurrentModel->hasCamera() )
+   {
+      iCameraFd = video_sources_get_input_fd();
+      // No fd to wait on for this camera (USB camera using ffmpeg): keep polling it
+      if ( iCameraFd < 0 )
+         return 0;
+   }
+   reactor_set_source_of_type(&s_RouterReactor, iCameraFd, REACTOR_SOURCE_CAMERA);
+   // The rx queues eventfds are created on the first rx thread start
+   reactor_add_source(&s_RouterReactor, radio_rx_get_wait_event_fd(1), REACTOR_SOURCE_RADIO_RX);
+   reactor_add_source(&s_RouterReactor, radio_rx_get_wait_event_fd(0), REACTOR_SOURCE_RADIO_RX);
+
+   u32 uReady = 0;
+   if ( radio_rx_begin_wait() )
+      uReady |= REACTOR_SOURCE_RADIO_RX;
+   if ( ruby_ipc_channel_begin_wait(s_fIPCRouterFromRC) | ruby_ipc_channel_begin_wait(s_fIPCRouterFromCommands) | ruby_ipc_channel_begin_wait(s_fIPCRouterFromTelemetry) )
+      uReady |= REACTOR_SOURCE_IPC;
+
+   // Pending camera data is reported right away by the reactor (level triggered)
+   if ( 0 == uReady )
+      uReady = reactor_wait(&s_RouterReactor);
+   else // Did not wait, so the camera was not checked: let the main loop read it too
+      uReady |= REACTOR_SOURCE_CAMERA;
+
+   radio_rx_end_wait();
+   ruby_ipc_channel_end_wait(s_fIPCRouterFromRC);
+   ruby_ipc_channel_end_wait(s_fIPCRouterFromCommands);
+   ruby_ipc_channel_end_wait(s_fIPCRouterFromTelemetry);
+   g_TimeNow = get_current_timestamp_ms();
+   s_bMainLoopWaitedForWork = true;
+   return uReady;
+}
+
 void _try_receive_packets(u32 uReadFrameDuration)
 {
    // Receive any high priority packets, if any
@@ -992,6 +1070,9 @@ void _try_receive_packets(u32 uReadFrameDuration)
       if ( uTimeoutMicros > 2000 )
          uTimeoutMicros = 2000;
    }
+   // Waited already for packets in the reactor
+   if ( s_bMainLoopWaitedForWork )
+      uTimeoutMicros = 0;
 
    while ( (iCountConsumedHighPrio < 10) && (!g_bQuit) )
    {
@@ -1109,6 +1190,7 @@ int main(int argc, char *argv[])
 
    log_init("Router");
    log_arguments(argc, argv);
+   log_enable_async();
    log_line_forced_to_file("Linux mem page size: %d bytes", getpagesize());
 
    utils_log_radio_packets_sizes();
@@ -1145,6 +1227,7 @@ int main(int argc, char *argv[])
       g_pCurrentModel->enc_flags = MODEL_ENC_FLAGS_NONE;
       saveCurrentModel();
    }
+   update_radio_auth_encryption_requirement();
   
    log_line_forced_to_file("Start sequence: Loaded model. Developer flags: live log: %s, enable radio silence failsafe: %s, log only errors: %s, radio config guard interval: %d ms",
          (g_pCurrentModel->uDeveloperFlags & DEVELOPER_FLAGS_BIT_LIVE_LOG)?"yes":"no",
@@ -1393,9 +1476,15 @@ int main(int argc, char *argv[])
    int iLoopTimeErrorsCount = 0;
    u32 uLastLoopTime = g_TimeNow;
    g_pProcessStats->uLoopTimer1 = g_pProcessStats->uLoopTimer2 = g_pProcessStats->uLoopTimer3 = g_pProcessStats->uLoopTimer4 = g_TimeNow;
+   _main_loop_init_reactor();
 
    while ( !g_bQuit )
    {
+      // Sleep until there is work to do; the time waiting is not part of the loop duration
+      u32 uTimeWaitStart = get_current_timestamp_ms();
+      s_uMainLoopReadySources = _main_loop_wait_for_work();
+      uLastLoopTime += get_current_timestamp_ms() - uTimeWaitStart;
+
       g_TimeNow = get_current_timestamp_ms();
       g_pProcessStats->lastActiveTime = g_TimeNow;
       g_pProcessStats->uLoopSubStep = 0;
@@ -1463,6 +1552,7 @@ int main(int argc, char *argv[])
    sem_unlink(SEMAPHORE_STOP_VEHICLE_ROUTER);
 
    packet_utils_uninit();
+   _main_loop_uninit_reactor();
    radio_rx_stop_rx_thread();
    radio_link_cleanup();
 
@@ -1630,6 +1720,7 @@ void _main_loop2()
    u32 uLastVideoFrameSendVideoDuration = 0;
    u32 uLastVideoFrameSendOtherDuration = 0;
    u32 uLastVideoFrameReadAndSendAllDuration = 0;
+   u32 uReadySources = s_uMainLoopReadySources;
    u32 uTimeStartFrame = g_TimeNow;
 
    //--------------------------------------------
@@ -1637,7 +1728,13 @@ void _main_loop2()
    g_pProcessStats->uLoopCounter1 = 0;
    g_pProcessStats->uLoopCounter4 = 0;
    g_pProcessStats->uLoopCounter5 = 0;
-   if ( bHasCamera )
+   // Woken up by the reactor for other sources than the camera: don't wait on the camera read
+   if ( bHasCamera && (0 != uReadySources) && (!(uReadySources & REACTOR_SOURCE_CAMERA)) )
+   {
+      bReadAnyCameraFrameData = false;
+      bEndOfFrame = false;
+   }
+   else if ( bHasCamera )
    {
       g_pProcessStats->uLoopCounter1 = get_current_timestamp_ms();
 
@@ -1759,7 +1856,7 @@ void _main_loop2()
    // Process IPCs
 
    static u32 s_uMainLoopIPCCheckLastTime = 0;
-   if ( g_TimeNow >= s_uMainLoopIPCCheckLastTime + 10 )
+   if ( (g_TimeNow >= s_uMainLoopIPCCheckLastTime + 10) || (uReadySources & REACTOR_SOURCE_IPC) )
    {
       s_uMainLoopIPCCheckLastTime = g_TimeNow;
 
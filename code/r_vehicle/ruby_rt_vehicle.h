@@ -8,6 +8,7 @@ void reinit_radio_interfaces();
 void send_radio_config_to_controller();
 void send_radio_reinitialized_message();
 void checkDeveloperFlagsChanges(u32 uOldDeveloperFlags, u32 uNewDeveloperFlags);
+void update_radio_auth_encryption_requirement();
 int process_and_send_packets(bool bIsEndOfTransmissionFrame);
 
 void signal_start_long_op();
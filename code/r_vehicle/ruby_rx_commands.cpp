@@ -796,6 +796,9 @@ bool process_command(u8* pBuffer, int length)
       u8 len = *pData;
       pData++;
       log_line("Received e flags %d, len: %d", (int)flags, (int)len);
+      // The authenticated mode applies to all the streams
+      if ( flags & MODEL_ENC_FLAG_AUTHENTICATED )
+         flags |= MODEL_ENC_FLAG_ENC_ALL;
       if ( flags == MODEL_ENC_FLAGS_NONE )
       {
          char szComm[128];
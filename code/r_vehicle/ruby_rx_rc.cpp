@@ -43,18 +43,23 @@
 #include "../base/models.h"
 #include "../base/models_list.h"
 #include "../base/ruby_ipc.h"
+#include "../base/rc_uplink.h"
 #include "../common/string_utils.h"
 #include "../utils/utils_vehicle.h"
 #include "timers.h"
 #include "shared_vars.h"
 
 #include <time.h>
+#include <poll.h>
 #include <sys/resource.h>
 #include <semaphore.h>
 
 Model sModelVehicle; 
 
 int s_fIPC_FromRouter = -1;
+// Each received RC frame also goes to the telemetry process through the RC slot, so it's forwarded to the FC right away
+t_rc_uplink_slot_endpoint s_RCUplinkSlot;
+bool s_bRCUplinkSlotOpened = false;
 
 u8 s_BufferRCFromRouter[MAX_PACKET_TOTAL_SIZE];
 u8 s_PipeTmpBufferRCFromRouter[MAX_PACKET_TOTAL_SIZE];
@@ -117,6 +122,26 @@ void process_data_rc_full_frame(u8* pBuffer, int length)
    s_pPHDownstreamInfoRC->history[s_LastHistorySlice] = (cReceived & 0x0F) | ((cGap & 0x0F) << 4);
 }
 
+// Sleeps for at most iTimeoutMs, less if the router sends a message meanwhile
+void _wait_for_router_messages(int iTimeoutMs)
+{
+   int iFd = ruby_ipc_channel_get_wait_fd(s_fIPC_FromRouter);
+   if ( iFd < 0 )
+   {
+      hardware_sleep_ms(iTimeoutMs);
+      return;
+   }
+   if ( ! ruby_ipc_channel_begin_wait(s_fIPC_FromRouter) )
+   {
+      struct pollfd pfd;
+      pfd.fd = iFd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      poll(&pfd, 1, iTimeoutMs);
+   }
+   ruby_ipc_channel_end_wait(s_fIPC_FromRouter);
+}
+
 void on_failsafe_triggered()
 {
    log_line("Triggered a RC failsafe due to Rx timeout: %d ms", sModelVehicle.rc_params.rc_failsafe_timeout_ms);
@@ -189,6 +214,8 @@ int r_start_rx_rc(int argc, char *argv[])
    if ( NULL != s_pPHDownstreamInfoRC )
       memset((u8*)s_pPHDownstreamInfoRC, 0, sizeof(t_packet_header_rc_info_downstream));
 
+   s_bRCUplinkSlotOpened = (1 == rc_uplink_slot_open(&s_RCUplinkSlot, RC_UPLINK_SLOT_VEHICLE, 0));
+
    g_pProcessStats = shared_mem_process_stats_open_write(SHARED_MEM_WATCHDOG_RC_RX);
    if ( NULL == g_pProcessStats )
       log_softerror_and_alarm("Failed to open shared mem for RC Rx process watchdog for writing: %s", SHARED_MEM_WATCHDOG_RC_RX);
@@ -228,7 +255,7 @@ int r_start_rx_rc(int argc, char *argv[])
    while (!g_bQuit) 
    {
       g_uLoopCounter++;
-      hardware_sleep_ms(iSleepIntervalMS);
+      _wait_for_router_messages(iSleepIntervalMS);
       if ( iSleepIntervalMS < 50 )
          iSleepIntervalMS += 10;
 
@@ -368,7 +395,12 @@ int r_start_rx_rc(int argc, char *argv[])
 
          #ifdef FEATURE_ENABLE_RC
          if ( g_bReceivedPairingRequest && (pPH->packet_type == PACKET_TYPE_RC_FULL_FRAME) )
+         {
+            u32 uTimeReceivedMicros = get_current_timestamp_micros();
             process_data_rc_full_frame(s_BufferRCFromRouter, pPH->total_length);
+            if ( s_bRCUplinkSlotOpened )
+               rc_uplink_slot_write(&s_RCUplinkSlot, s_BufferRCFromRouter, pPH->total_length, uTimeReceivedMicros);
+         }
          #endif
       }
 
@@ -424,6 +456,9 @@ int r_start_rx_rc(int argc, char *argv[])
    
    shared_mem_rc_downstream_info_close(s_pPHDownstreamInfoRC);
    shared_mem_process_stats_close(SHARED_MEM_WATCHDOG_RC_RX, g_pProcessStats);
+   if ( s_bRCUplinkSlotOpened )
+      rc_uplink_slot_close(&s_RCUplinkSlot);
+   s_bRCUplinkSlotOpened = false;
 
    ruby_close_ipc_channel(s_fIPC_FromRouter);
    s_fIPC_FromRouter = -1;
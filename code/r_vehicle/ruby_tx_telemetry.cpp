@@ -62,6 +62,7 @@
 #include "../base/commands.h"
 #include "../base/utils.h"
 #include "../base/ruby_ipc.h"
+#include "../base/rc_uplink.h"
 #include "../base/vehicle_settings.h"
 #include "../common/string_utils.h"
 #include "../common/relay_utils.h"
@@ -116,6 +117,18 @@ u32 s_uLastTotalPacketsReceived = 0;
 
 t_packet_header_rc_info_downstream* s_pPHDownstreamInfoRC = NULL; // Info to send back to ground
 
+// New RC frames from the RC process are sent to the FC right away, but not more often than this
+#define RC_TO_FC_MIN_INTERVAL_MS 5
+
+t_rc_uplink_slot_endpoint s_RCUplinkSlot;
+bool s_bRCUplinkSlotOpened = false;
+u8 s_BufferRCUplinkSlot[MAX_PACKET_TOTAL_SIZE];
+bool s_bRCFramePendingToFC = false;
+u32 s_uTimePendingRCFrameReceivedMicros = 0;
+u8 s_uPendingRCFrameFlags = 0;
+u8 s_uPendingRCFrameInputAge = 0;
+t_shared_mem_rc_latency* s_pSMRCLatency = NULL;
+
 //shared_mem_video_frames_stats* s_pSM_VideoInfoStats = NULL;
 //shared_mem_video_frames_stats* s_pSM_VideoInfoStatsRadioOut = NULL;
 shared_mem_radio_stats_rx_hist* s_pSM_HistoryRxStats = NULL;
@@ -392,6 +405,8 @@ void _send_rc_data_to_FC()
       bSend = true;
    if ( g_TimeNow >= g_TimeLastRCSentToFC + 1000/g_pCurrentModel->rc_params.rc_frames_per_second )
       bSend = true;
+   if ( s_bRCFramePendingToFC && (g_TimeNow >= g_TimeLastRCSentToFC + RC_TO_FC_MIN_INTERVAL_MS) )
+      bSend = true;
 
    if ( ! bSend )
       return;
@@ -401,6 +416,8 @@ void _send_rc_data_to_FC()
 
    g_TimeLastRCSentToFC = g_TimeNow;
    s_is_failsafe = s_pPHDownstreamInfoRC->is_failsafe;
+   bool bIsNewFrame = s_bRCFramePendingToFC;
+   s_bRCFramePendingToFC = false;
   
    int count = g_pCurrentModel->rc_params.channelsCount;
    if ( count > 18 )
@@ -451,6 +468,44 @@ void _send_rc_data_to_FC()
    len = mavlink_msg_to_send_buffer(serialBufferOut, &msg);
    if ( len != write(telemetry_get_serial_port_file(), serialBufferOut, len) )
       log_softerror_and_alarm("Failed to write to serial port to FC");
+
+   if ( bIsNewFrame && (NULL != s_pSMRCLatency) )
+   {
+      u32 uRadioToFCMicros = get_current_timestamp_micros() - s_uTimePendingRCFrameReceivedMicros;
+      rc_latency_histogram_add(&s_pSMRCLatency->radioToFC, uRadioToFCMicros);
+      if ( (s_uPendingRCFrameFlags & RC_FULL_FRAME_FLAGS_HAS_INPUT_AGE) && (s_uPendingRCFrameInputAge < 255) )
+         rc_latency_histogram_add(&s_pSMRCLatency->inputToFC, uRadioToFCMicros + (u32)s_uPendingRCFrameInputAge * RC_FULL_FRAME_INPUT_AGE_UNIT_MICROS);
+      s_pSMRCLatency->uTimeLastUpdate = g_TimeNow;
+   }
+}
+
+// Checks for a new RC frame from the RC process. Returns true if there is one to send to the FC.
+bool _check_rc_uplink_slot()
+{
+   if ( ! s_bRCUplinkSlotOpened )
+      return false;
+   rc_uplink_slot_mark_reader_alive(&s_RCUplinkSlot, g_TimeNow);
+
+   u32 uTimeReceivedMicros = 0;
+   int iLength = rc_uplink_slot_read(&s_RCUplinkSlot, s_BufferRCUplinkSlot, &uTimeReceivedMicros);
+   if ( iLength >= (int)(sizeof(t_packet_header) + sizeof(t_packet_header_rc_full_frame_upstream)) )
+   {
+      t_packet_header_rc_full_frame_upstream* pPHRCF = (t_packet_header_rc_full_frame_upstream*)(s_BufferRCUplinkSlot + sizeof(t_packet_header));
+      // A newer frame replaces one not sent yet; the latency is measured for the one sent
+      s_bRCFramePendingToFC = true;
+      s_uTimePendingRCFrameReceivedMicros = uTimeReceivedMicros;
+      s_uPendingRCFrameFlags = pPHRCF->flags;
+      s_uPendingRCFrameInputAge = pPHRCF->extra_info1;
+   }
+
+   static u32 s_uTimeLastRCLatencyLog = 0;
+   if ( (NULL != s_pSMRCLatency) && (g_TimeNow > s_uTimeLastRCLatencyLog + 20000) )
+   {
+      s_uTimeLastRCLatencyLog = g_TimeNow;
+      rc_latency_histogram_log(&s_pSMRCLatency->radioToFC, "RC radio to FC");
+      rc_latency_histogram_log(&s_pSMRCLatency->inputToFC, "RC input to FC (without air time)");
+   }
+   return s_bRCFramePendingToFC;
 }
 
 
@@ -1245,6 +1300,15 @@ void check_send_telemetry_to_controller()
 
       memcpy(buffer, &sPH, sizeof(t_packet_header));
       memcpy(buffer+sizeof(t_packet_header), (u8*)s_pPHDownstreamInfoRC, sizeof(t_packet_header_rc_info_downstream));
+
+      t_packet_header_rc_info_downstream* pRCInfo = (t_packet_header_rc_info_downstream*)(buffer+sizeof(t_packet_header));
+      pRCInfo->extra_flags = 0;
+      if ( (NULL != s_pSMRCLatency) && (0 != s_pSMRCLatency->inputToFC.uSamples) )
+      {
+         pRCInfo->extra_flags = RC_INFO_EXTRA_FLAGS_HAS_LATENCY;
+         pRCInfo->extra_flags |= rc_latency_to_age_units(rc_latency_histogram_get_percentile(&s_pSMRCLatency->inputToFC, 50));
+         pRCInfo->extra_flags |= ((u32)rc_latency_to_age_units(rc_latency_histogram_get_percentile(&s_pSMRCLatency->inputToFC, 95))) << 8;
+      }
       
       if ( g_bRouterReady && (! g_bLongTaskStarted) && (! s_bRadioInterfacesReinitIsInProgress) )
       {
@@ -1312,6 +1376,11 @@ void check_open_datalink_serial_port()
 
 void open_shared_mem_objects()
 {
+   s_pSMRCLatency = shared_mem_rc_latency_open_for_write();
+   if ( NULL == s_pSMRCLatency )
+      log_softerror_and_alarm("Failed to open shared mem for RC latency stats for writing: %s", SHARED_MEM_RC_LATENCY);
+   s_bRCUplinkSlotOpened = (1 == rc_uplink_slot_open(&s_RCUplinkSlot, RC_UPLINK_SLOT_VEHICLE, 1));
+
    g_pProcessStats = shared_mem_process_stats_open_write(SHARED_MEM_WATCHDOG_TELEMETRY_TX);
    if ( NULL == g_pProcessStats)
       log_softerror_and_alarm("Failed to open shared mem for telemetry tx process watchdog stats for writing: %s", SHARED_MEM_WATCHDOG_TELEMETRY_TX);
@@ -1514,6 +1583,11 @@ int main(int argc, char *argv[])
    #ifdef FEATURE_ENABLE_RC
    shared_mem_rc_downstream_info_close(s_pPHDownstreamInfoRC);
    #endif
+   if ( s_bRCUplinkSlotOpened )
+      rc_uplink_slot_close(&s_RCUplinkSlot);
+   s_bRCUplinkSlotOpened = false;
+   shared_mem_rc_latency_close(s_pSMRCLatency);
+   s_pSMRCLatency = NULL;
    
    ruby_close_ipc_channel(s_fIPCToRouter);
    ruby_close_ipc_channel(s_fIPCFromRouter);
@@ -1543,7 +1617,8 @@ void _main_loop()
 
    while ( !g_bQuit )
    {
-      hardware_sleep_ms(iSleepTime);
+      // Wakes up early on a new RC frame to send to the FC
+      rc_uplink_slot_wait(&s_RCUplinkSlot, iSleepTime);
       g_uLoopCounter++;
       g_TimeNow = get_current_timestamp_ms();
       u32 tTime0 = g_TimeNow;
@@ -1614,13 +1689,31 @@ void _main_loop()
       while ( (maxMsgToRead > 0) && try_read_messages_from_router() )
          maxMsgToRead--;
 
+      bool bReadRCUplinkSlot = false;
       if ( g_pCurrentModel->telemetry_params.fc_telemetry_type == TELEMETRY_TYPE_MAVLINK )
       if ( g_pCurrentModel->rc_params.rc_enabled && g_bReceivedPairingRequest )
       if ( g_pCurrentModel->rc_params.flags & RC_FLAGS_OUTPUT_ENABLED )
       {
          if ( iSleepTime > 10 )
             iSleepTime = 10;
+         bReadRCUplinkSlot = true;
+         _check_rc_uplink_slot();
          _send_rc_data_to_FC();
+         // Still pending: wait for the minimum interval between sends, or drop it if it can't be sent now
+         if ( s_bRCFramePendingToFC )
+         {
+            if ( g_TimeNow < g_TimeLastRCSentToFC + RC_TO_FC_MIN_INTERVAL_MS )
+               iSleepTime = 1;
+            else
+               s_bRCFramePendingToFC = false;
+         }
+      }
+      // Not sending RC to the FC: the RC process goes back to the IPC channel, and the loop wait
+      // must not be woken up by frames in the slot that are never read
+      if ( s_bRCUplinkSlotOpened && (! bReadRCUplinkSlot) )
+      {
+         rc_uplink_slot_mark_reader_gone(&s_RCUplinkSlot);
+         s_bRCFramePendingToFC = false;
       }
 
       if ( dataLinkSerialBufferCount >= AUXILIARY_DATA_LINK_MIN_SEND_LENGTH || 
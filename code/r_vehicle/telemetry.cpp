@@ -413,6 +413,7 @@ int telemetry_try_read_serial_port()
    s_uRawTelemetryTotalReadFromFCSerial += iReadLength;
    s_iFCSerialTelemetryReadBytesTempLastSecond += iReadLength;
 
+   // The serial data is forwarded as it is (all of it, not only the MAVLink frames the parser uses)
    if ( _telemetry_must_send_raw_telemetry_to_controller() )
       _telemetry_addSerialDataFromFCToTelemetryBuffer(uReadBuffer, iReadLength);
 
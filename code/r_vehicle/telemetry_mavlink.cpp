@@ -281,6 +281,8 @@ void _telemetry_mavlink_send_setup()
 
 void telemetry_mavlink_on_open_port(int iSerialPortFile)
 {
+   // Drop the partial frame left from the previous port session
+   parse_telemetry_reset_mavlink_scanner();
    _telemetry_mavlink_send_setup();
 }
 
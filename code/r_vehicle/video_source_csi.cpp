@@ -416,6 +416,11 @@ void video_source_csi_flush_discard()
    log_line("[VideoSourceCSI] Flushed video stream input buffer (pipe) in %d reads, total %d bytes", iCount, iBytes);
 }
 
+int video_source_csi_get_input_fd()
+{
+   return s_fInputVideoStreamCSIPipe;
+}
+
 int video_source_csi_get_buffer_size()
 {
    return sizeof(s_uInputVideoCSIPipeBuffer)/sizeof(s_uInputVideoCSIPipeBuffer[0]);
@@ -1089,6 +1094,7 @@ void video_source_csi_log_input_data() {}
 u32 video_source_csi_get_debug_videobitrate() {return 0;}
 void video_source_csi_flush_discard() {}
 int video_source_csi_get_buffer_size() {return 0;}
+int video_source_csi_get_input_fd() {return -1;}
 u8* video_source_csi_read(int* piReadSize, u32* puOutTimeDataAvailable)
 {
    if ( NULL != piReadSize )
@@ -3,6 +3,8 @@
 
 void video_source_csi_flush_discard();
 int video_source_csi_get_buffer_size();
+// Input pipe fd, -1 if not opened
+int video_source_csi_get_input_fd();
 void video_source_csi_log_input_data();
 u32 video_source_csi_get_debug_videobitrate();
 
@@ -871,6 +871,11 @@ void video_source_majestic_clear_audio_buffers()
    s_iInputMajAudioBufferBytes = 0;
 }
 
+int video_source_majestic_get_input_fd()
+{
+   return s_fInputVideoStreamUDPSocket;
+}
+
 void video_source_majestic_clear_input_buffers()
 {
    // Clear majestic buffers
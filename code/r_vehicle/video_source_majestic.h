@@ -15,6 +15,8 @@ u8* video_source_majestic_read(int* piReadSize, bool bAsync, u32* puOutTimeDataA
 int video_source_majestic_get_audio_data(u8* pOutputBuffer, int iMaxToRead);
 void video_source_majestic_clear_audio_buffers();
 void video_source_majestic_clear_input_buffers();
+// Input UDP socket, -1 if not opened
+int video_source_majestic_get_input_fd();
 
 bool video_source_majestic_last_read_is_single_nal();
 bool video_source_majestic_last_read_is_start_nal();
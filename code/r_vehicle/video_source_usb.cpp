@@ -31,6 +31,7 @@
 #endif
 
 #include "video_source_usb.h"
+#include "video_source_usb_v4l2.h"
 #include "video_sources.h"
 #include "shared_vars.h"
 #include "timers.h"
@@ -64,6 +65,9 @@ static volatile bool s_bUSBCaptureThreadStop = false;
 static pid_t s_iFFMpegPid = -1;
 static int s_iFFMpegPipeReadFd = -1;
 
+static usb_camera_backend_t s_USBCameraBackend = USB_CAMERA_BACKEND_NONE;
+static usb_v4l2_capture_t s_USBV4L2Capture;
+
 static usb_ring_buffer_t s_RingBuffer;
 static u8 s_uTempReadBuffer[USB_CAMERA_BUFFER_SIZE];
 
@@ -454,8 +458,64 @@ static void _stop_ffmpeg_process()
     }
 }
 
+static void _video_source_usb_get_video_size(int* piWidth, int* piHeight, int* piFPS)
+{
+    *piWidth = USB_CAMERA_DEFAULT_WIDTH;
+    *piHeight = USB_CAMERA_DEFAULT_HEIGHT;
+    *piFPS = USB_CAMERA_DEFAULT_FPS;
+    if (NULL == g_pCurrentModel)
+        return;
+    if (g_pCurrentModel->video_params.iVideoWidth > 0)
+        *piWidth = g_pCurrentModel->video_params.iVideoWidth;
+    if (g_pCurrentModel->video_params.iVideoHeight > 0)
+        *piHeight = g_pCurrentModel->video_params.iVideoHeight;
+    if (g_pCurrentModel->video_params.iVideoFPS > 0)
+        *piFPS = g_pCurrentModel->video_params.iVideoFPS;
+}
+
+static int _video_source_usb_get_keyframe_frames()
+{
+    int iWidth, iHeight, iFPS;
+    _video_source_usb_get_video_size(&iWidth, &iHeight, &iFPS);
+    int iKeyframeFrames = (s_iCurrentKeyframeMs * iFPS) / 1000;
+    if (iKeyframeFrames < 1)
+        iKeyframeFrames = iFPS * 2; // Default 2 seconds
+    return iKeyframeFrames;
+}
+
+static bool _video_source_usb_is_v4l2_backend()
+{
+    return (s_USBCameraBackend == USB_CAMERA_BACKEND_V4L2_PASSTHROUGH) ||
+           (s_USBCameraBackend == USB_CAMERA_BACKEND_V4L2_ENCODER);
+}
+
 // ============ CAPTURE THREAD ============
 
+// V4L2 encoder backend: moves the raw camera frames to the encoder.
+// The encoded frames are read in place by video_source_usb_read, on the router main thread.
+static void* _video_source_usb_encoder_feed_thread(void* arg)
+{
+    log_line("[VideoSourceUSB] Encoder feed thread started");
+    hw_log_current_thread_attributes("usb encoder feed");
+
+    while (!s_bUSBCaptureThreadStop)
+    {
+        int iFed = usb_v4l2_feed_encoder(&s_USBV4L2Capture, 20);
+        if (iFed < 0)
+        {
+            log_error_and_alarm("[VideoSourceUSB] Camera or encoder error");
+            s_USBCameraState = USB_CAMERA_STATE_ERROR;
+            break;
+        }
+        if (iFed > 0)
+            s_iConsecutiveReadErrors = 0;
+    }
+
+    s_bUSBCaptureThreadRunning = false;
+    log_line("[VideoSourceUSB] Encoder feed thread ended");
+    return NULL;
+}
+
 static void* _video_source_usb_capture_thread(void* arg)
 {
     log_line("[VideoSourceUSB] Capture thread started");
@@ -597,6 +657,36 @@ static void* _video_source_usb_capture_thread(void* arg)
     return NULL;
 }
 
+static u32 _video_source_usb_start_v4l2(int* pInitialKFSet)
+{
+    s_bUSBCaptureThreadStop = false;
+    s_bUSBCaptureThreadRunning = false;
+    if (s_USBCameraBackend == USB_CAMERA_BACKEND_V4L2_ENCODER)
+    {
+        s_bUSBCaptureThreadRunning = true;
+        if (pthread_create(&s_pThreadUSBCapture, NULL, _video_source_usb_encoder_feed_thread, NULL) != 0)
+        {
+            log_error_and_alarm("[VideoSourceUSB] Failed to create encoder feed thread");
+            s_bUSBCaptureThreadRunning = false;
+            usb_v4l2_close(&s_USBV4L2Capture);
+            s_USBCameraBackend = USB_CAMERA_BACKEND_NONE;
+            s_USBCameraState = USB_CAMERA_STATE_ERROR;
+            return 0;
+        }
+    }
+
+    s_uUSBStartTime = get_current_timestamp_ms();
+    s_USBCameraState = USB_CAMERA_STATE_RUNNING;
+    s_iConsecutiveReadErrors = 0;
+
+    if (pInitialKFSet)
+        *pInitialKFSet = s_iCurrentKeyframeMs;
+
+    log_line("[VideoSourceUSB] USB camera started successfully (V4L2 %s)",
+             (s_USBCameraBackend == USB_CAMERA_BACKEND_V4L2_PASSTHROUGH) ? "passthrough" : "encoder");
+    return s_uCurrentBitrate;
+}
+
 // ============ PUBLIC FUNCTIONS ============
 
 u32 video_source_usb_start_program(u32 uOverwriteInitialBitrate, 
@@ -628,9 +718,26 @@ u32 video_source_usb_start_program(u32 uOverwriteInitialBitrate,
     // Initialize ring buffer
     _ring_buffer_init();
     s_ParserH264USB.init();
+    s_USBCameraState = USB_CAMERA_STATE_STARTING;
+    
+    // Native V4L2 capture first: camera encoded stream passthrough, or in process encoder
+    int iWidth, iHeight, iFPS;
+    _video_source_usb_get_video_size(&iWidth, &iHeight, &iFPS);
+    const char* szDevicePath = (s_szDetectedUSBDevice[0] != '\0') ? 
+                                s_szDetectedUSBDevice : USB_CAMERA_DEFAULT_DEVICE;
+    bool bPreferH265 = (NULL != g_pCurrentModel) && (g_pCurrentModel->video_params.uVideoExtraFlags & VIDEO_FLAG_GENERATE_H265);
+    if (usb_v4l2_open(&s_USBV4L2Capture, szDevicePath, iWidth, iHeight, iFPS, bPreferH265, s_uCurrentBitrate, _video_source_usb_get_keyframe_frames()))
+    {
+        if (s_USBV4L2Capture.mode == USB_V4L2_MODE_PASSTHROUGH)
+            s_USBCameraBackend = USB_CAMERA_BACKEND_V4L2_PASSTHROUGH;
+        else
+            s_USBCameraBackend = USB_CAMERA_BACKEND_V4L2_ENCODER;
+        return _video_source_usb_start_v4l2(pInitialKFSet);
+    }
     
     // Start FFmpeg process
-    s_USBCameraState = USB_CAMERA_STATE_STARTING;
+    log_line("[VideoSourceUSB] No native V4L2 H264/H265 capture available, using FFmpeg transcode");
+    s_USBCameraBackend = USB_CAMERA_BACKEND_FFMPEG;
     s_iFFMpegPid = _start_ffmpeg_process(&s_iFFMpegPipeReadFd);
     
     if (s_iFFMpegPid < 0)
@@ -701,6 +808,9 @@ void video_source_usb_stop_program()
     }
     
     _stop_ffmpeg_process();
+    if (_video_source_usb_is_v4l2_backend())
+        usb_v4l2_close(&s_USBV4L2Capture);
+    s_USBCameraBackend = USB_CAMERA_BACKEND_NONE;
     _ring_buffer_clear();
     _ring_buffer_destroy();
     
@@ -723,6 +833,38 @@ u8* video_source_usb_read(int* piReadSize, bool bAsync, u32* puOutTimeDataAvaila
     if (s_USBCameraState != USB_CAMERA_STATE_RUNNING)
         return NULL;
     
+    if (_video_source_usb_is_v4l2_backend())
+    {
+        int iSize = 0;
+        bool bStart = false;
+        bool bEnd = false;
+        u32 uNALType = 0;
+        u32 uTime = 0;
+        u8* pNAL = usb_v4l2_read_nal(&s_USBV4L2Capture, &iSize, &bStart, &bEnd, &uNALType, &uTime);
+        if (iSize < 0)
+        {
+            log_error_and_alarm("[VideoSourceUSB] V4L2 read error");
+            s_iConsecutiveReadErrors++;
+            s_USBCameraState = USB_CAMERA_STATE_ERROR;
+            return NULL;
+        }
+        if ((NULL == pNAL) || (0 == iSize))
+            return NULL;
+
+        s_iConsecutiveReadErrors = 0;
+        s_uDebugUSBInputBytes += iSize;
+        s_uDebugUSBInputReads++;
+        s_uLastNALType = uNALType;
+        s_bLastReadIsStartNAL = bStart;
+        s_bLastReadIsEndNAL = bEnd;
+        s_bLastReadIsSingleNAL = true;
+        if (piReadSize)
+            *piReadSize = iSize;
+        if (puOutTimeDataAvailable)
+            *puOutTimeDataAvailable = uTime;
+        return pNAL;
+    }
+    
     usb_nal_buffer_t* pBuf = _ring_buffer_read();
     if (NULL == pBuf || !pBuf->bValid)
         return NULL;
@@ -744,6 +886,8 @@ u8* video_source_usb_read(int* piReadSize, bool bAsync, u32* puOutTimeDataAvaila
 void video_source_usb_clear_input_buffers()
 {
     log_line("[VideoSourceUSB] Clearing input buffers");
+    if (_video_source_usb_is_v4l2_backend())
+        usb_v4l2_discard_pending(&s_USBV4L2Capture);
     _ring_buffer_clear();
     s_ParserH264USB.init();
 }
@@ -770,15 +914,45 @@ u32 video_source_usb_get_last_nal_type()
 
 void video_source_usb_apply_all_parameters()
 {
-    log_line("[VideoSourceUSB] Applying all parameters (restart required for changes)");
-    
-    // For USB camera, changing parameters requires restarting FFmpeg
-    // This is called when settings change
-    if (s_USBCameraState == USB_CAMERA_STATE_RUNNING)
+    if (_video_source_usb_is_v4l2_backend())
     {
-        // Could implement restart logic here if dynamic changes needed
-        // For now, just log that a restart would be required
+        log_line("[VideoSourceUSB] Applying all parameters (bitrate: %u kbps, keyframe: %d ms)", s_uCurrentBitrate/1000, s_iCurrentKeyframeMs);
+        usb_v4l2_set_bitrate(&s_USBV4L2Capture, s_uCurrentBitrate);
+        usb_v4l2_set_keyframe_interval(&s_USBV4L2Capture, _video_source_usb_get_keyframe_frames());
+        return;
     }
+    // For the FFmpeg backend, changing parameters requires restarting FFmpeg
+    log_line("[VideoSourceUSB] Applying all parameters (restart required for changes)");
+}
+
+void video_source_usb_set_video_bitrate(u32 uBitrateBPS)
+{
+    if ((0 == uBitrateBPS) || (uBitrateBPS == s_uCurrentBitrate))
+        return;
+    s_uCurrentBitrate = uBitrateBPS;
+    if (_video_source_usb_is_v4l2_backend())
+        usb_v4l2_set_bitrate(&s_USBV4L2Capture, s_uCurrentBitrate);
+}
+
+void video_source_usb_set_keyframe(int iKeyframeMs)
+{
+    if ((iKeyframeMs <= 0) || (iKeyframeMs == s_iCurrentKeyframeMs))
+        return;
+    s_iCurrentKeyframeMs = iKeyframeMs;
+    if (_video_source_usb_is_v4l2_backend())
+        usb_v4l2_set_keyframe_interval(&s_USBV4L2Capture, _video_source_usb_get_keyframe_frames());
+}
+
+int video_source_usb_get_input_fd()
+{
+    if ((s_USBCameraState != USB_CAMERA_STATE_RUNNING) || (!_video_source_usb_is_v4l2_backend()))
+        return -1;
+    return usb_v4l2_get_wait_fd(&s_USBV4L2Capture);
+}
+
+usb_camera_backend_t video_source_usb_get_backend()
+{
+    return s_USBCameraBackend;
 }
 
 int video_source_usb_get_audio_data(u8* pOutputBuffer, int iMaxToRead)
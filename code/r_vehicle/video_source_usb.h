@@ -11,6 +11,14 @@ typedef enum {
     USB_CAMERA_STATE_DEVICE_LOST
 } usb_camera_state_t;
 
+// Capture backends, in the order they are tried
+typedef enum {
+    USB_CAMERA_BACKEND_NONE = 0,
+    USB_CAMERA_BACKEND_V4L2_PASSTHROUGH,  // Camera encodes H264/H265, read in place from the V4L2 buffers
+    USB_CAMERA_BACKEND_V4L2_ENCODER,      // Raw camera frames to a V4L2 memory to memory encoder
+    USB_CAMERA_BACKEND_FFMPEG             // MJPEG transcoded by an ffmpeg process
+} usb_camera_backend_t;
+
 // Buffer sizes
 #define USB_CAMERA_BUFFER_SIZE (256 * 1024)       // 256KB per buffer
 #define USB_CAMERA_RING_BUFFER_COUNT 8            // Ring buffer slots
@@ -44,6 +52,13 @@ u32 video_source_usb_get_last_nal_type();
 
 // Parameters
 void video_source_usb_apply_all_parameters();
+// Applied live on the V4L2 backends; the ffmpeg backend uses them on its next start
+void video_source_usb_set_video_bitrate(u32 uBitrateBPS);
+void video_source_usb_set_keyframe(int iKeyframeMs);
+
+// Fd that becomes readable when there is video data to read, -1 for the ffmpeg backend
+int video_source_usb_get_input_fd();
+usb_camera_backend_t video_source_usb_get_backend();
 
 // Audio (thermal cameras typically have no audio)
 int video_source_usb_get_audio_data(u8* pOutputBuffer, int iMaxToRead);
@@ -0,0 +1,832 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "../base/base.h"
+#include "../base/config.h"
+
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/videodev2.h>
+
+#include "video_source_usb_v4l2.h"
+
+// Raw formats accepted from the camera in encoder mode, in order of preference
+static const u32 s_uUSBV4L2RawFormats[] = { V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_YUV420, V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_UYVY };
+
+static const char* _usb_v4l2_fourcc_str(u32 uPixelFormat)
+{
+   static char s_szFourCC[8];
+   s_szFourCC[0] = (char)(uPixelFormat & 0xFF);
+   s_szFourCC[1] = (char)((uPixelFormat >> 8) & 0xFF);
+   s_szFourCC[2] = (char)((uPixelFormat >> 16) & 0xFF);
+   s_szFourCC[3] = (char)((uPixelFormat >> 24) & 0xFF);
+   s_szFourCC[4] = 0;
+   return s_szFourCC;
+}
+
+static int _usb_v4l2_ioctl(int iFd, unsigned long uRequest, void* pArg)
+{
+   int iRes;
+   do
+   {
+      iRes = ioctl(iFd, uRequest, pArg);
+   } while ( (iRes < 0) && (errno == EINTR) );
+   return iRes;
+}
+
+static bool _usb_v4l2_has_format(int iFd, u32 uBufType, u32 uPixelFormat)
+{
+   struct v4l2_fmtdesc fmtDesc;
+   for( int i=0; i<64; i++ )
+   {
+      memset(&fmtDesc, 0, sizeof(fmtDesc));
+      fmtDesc.index = i;
+      fmtDesc.type = uBufType;
+      if ( _usb_v4l2_ioctl(iFd, VIDIOC_ENUM_FMT, &fmtDesc) < 0 )
+         break;
+      if ( fmtDesc.pixelformat == uPixelFormat )
+         return true;
+   }
+   return false;
+}
+
+// Returns false if the driver did not accept the pixel format
+static bool _usb_v4l2_set_format(int iFd, u32 uBufType, bool bMPlane, u32 uPixelFormat, int iWidth, int iHeight, u32 uBytesPerLine, u32 uSizeImage, u32* puOutBytesPerLine, u32* puOutSizeImage)
+{
+   struct v4l2_format fmt;
+   memset(&fmt, 0, sizeof(fmt));
+   fmt.type = uBufType;
+   if ( bMPlane )
+   {
+      fmt.fmt.pix_mp.width = iWidth;
+      fmt.fmt.pix_mp.height = iHeight;
+      fmt.fmt.pix_mp.pixelformat = uPixelFormat;
+      fmt.fmt.pix_mp.field = V4L2_FIELD_NONE;
+      fmt.fmt.pix_mp.num_planes = 1;
+      fmt.fmt.pix_mp.plane_fmt[0].bytesperline = uBytesPerLine;
+      fmt.fmt.pix_mp.plane_fmt[0].sizeimage = uSizeImage;
+   }
+   else
+   {
+      fmt.fmt.pix.width = iWidth;
+      fmt.fmt.pix.height = iHeight;
+      fmt.fmt.pix.pixelformat = uPixelFormat;
+      fmt.fmt.pix.field = V4L2_FIELD_NONE;
+      fmt.fmt.pix.bytesperline = uBytesPerLine;
+      fmt.fmt.pix.sizeimage = uSizeImage;
+   }
+   if ( _usb_v4l2_ioctl(iFd, VIDIOC_S_FMT, &fmt) < 0 )
+      return false;
+
+   u32 uPixelFormatSet = bMPlane?fmt.fmt.pix_mp.pixelformat:fmt.fmt.pix.pixelformat;
+   if ( uPixelFormatSet != uPixelFormat )
+      return false;
+   if ( NULL != puOutBytesPerLine )
+      *puOutBytesPerLine = bMPlane?fmt.fmt.pix_mp.plane_fmt[0].bytesperline:fmt.fmt.pix.bytesperline;
+   if ( NULL != puOutSizeImage )
+      *puOutSizeImage = bMPlane?fmt.fmt.pix_mp.plane_fmt[0].sizeimage:fmt.fmt.pix.sizeimage;
+   return true;
+}
+
+static void _usb_v4l2_set_fps(int iFd, u32 uBufType, int iFPS)
+{
+   struct v4l2_streamparm parm;
+   memset(&parm, 0, sizeof(parm));
+   parm.type = uBufType;
+   parm.parm.capture.timeperframe.numerator = 1;
+   parm.parm.capture.timeperframe.denominator = iFPS;
+   if ( _usb_v4l2_ioctl(iFd, VIDIOC_S_PARM, &parm) < 0 )
+      log_line("[VideoSourceUSBV4L2] Can't set %d FPS (%s), using device default.", iFPS, strerror(errno));
+}
+
+static bool _usb_v4l2_set_control(int iFd, u32 uControlId, int iValue, const char* szName)
+{
+   struct v4l2_control ctrl;
+   memset(&ctrl, 0, sizeof(ctrl));
+   ctrl.id = uControlId;
+   ctrl.value = iValue;
+   if ( _usb_v4l2_ioctl(iFd, VIDIOC_S_CTRL, &ctrl) < 0 )
+   {
+      log_line("[VideoSourceUSBV4L2] Device does not support setting %s to %d (%s)", szName, iValue, strerror(errno));
+      return false;
+   }
+   return true;
+}
+
+static void _usb_v4l2_reset_queue(usb_v4l2_queue_t* pQueue)
+{
+   memset(pQueue, 0, sizeof(usb_v4l2_queue_t));
+   pQueue->iFd = -1;
+}
+
+static bool _usb_v4l2_queue_buffer(usb_v4l2_queue_t* pQueue, int iIndex, u32 uBytesUsed)
+{
+   struct v4l2_buffer buf;
+   struct v4l2_plane planes[1];
+   memset(&buf, 0, sizeof(buf));
+   memset(planes, 0, sizeof(planes));
+   buf.type = pQueue->uBufType;
+   buf.memory = V4L2_MEMORY_MMAP;
+   buf.index = iIndex;
+   if ( pQueue->bMPlane )
+   {
+      planes[0].bytesused = uBytesUsed;
+      buf.m.planes = planes;
+      buf.length = 1;
+   }
+   else
+      buf.bytesused = uBytesUsed;
+
+   if ( _usb_v4l2_ioctl(pQueue->iFd, VIDIOC_QBUF, &buf) < 0 )
+   {
+      log_softerror_and_alarm("[VideoSourceUSBV4L2] Failed to queue buffer %d, error: %s", iIndex, strerror(errno));
+      return false;
+   }
+   pQueue->bBufferQueued[iIndex] = true;
+   return true;
+}
+
+// Returns the buffer index, -1 if no buffer is ready, -2 on error
+static int _usb_v4l2_dequeue_buffer(usb_v4l2_queue_t* pQueue, u32* puBytesUsed)
+{
+   struct v4l2_buffer buf;
+   struct v4l2_plane planes[1];
+   memset(&buf, 0, sizeof(buf));
+   memset(planes, 0, sizeof(planes));
+   buf.type = pQueue->uBufType;
+   buf.memory = V4L2_MEMORY_MMAP;
+   if ( pQueue->bMPlane )
+   {
+      buf.m.planes = planes;
+      buf.length = 1;
+   }
+   if ( _usb_v4l2_ioctl(pQueue->iFd, VIDIOC_DQBUF, &buf) < 0 )
+   {
+      if ( errno == EAGAIN )
+         return -1;
+      log_softerror_and_alarm("[VideoSourceUSBV4L2] Failed to dequeue buffer, error: %s", strerror(errno));
+      return -2;
+   }
+   if ( (int)buf.index >= pQueue->iBuffersCount )
+      return -2;
+   pQueue->bBufferQueued[buf.index] = false;
+   if ( NULL != puBytesUsed )
+      *puBytesUsed = pQueue->bMPlane?planes[0].bytesused:buf.bytesused;
+   if ( (NULL != puBytesUsed) && (*puBytesUsed > pQueue->uBuffersLength[buf.index]) )
+      *puBytesUsed = pQueue->uBuffersLength[buf.index];
+   return (int)buf.index;
+}
+
+static void _usb_v4l2_release_queue(usb_v4l2_queue_t* pQueue)
+{
+   if ( pQueue->iFd < 0 )
+      return;
+   for( int i=0; i<pQueue->iBuffersCount; i++ )
+   {
+      if ( NULL != pQueue->pBuffers[i] )
+         munmap(pQueue->pBuffers[i], pQueue->uBuffersLength[i]);
+   }
+   if ( pQueue->iBuffersCount > 0 )
+   {
+      struct v4l2_requestbuffers req;
+      memset(&req, 0, sizeof(req));
+      req.count = 0;
+      req.type = pQueue->uBufType;
+      req.memory = V4L2_MEMORY_MMAP;
+      _usb_v4l2_ioctl(pQueue->iFd, VIDIOC_REQBUFS, &req);
+   }
+   _usb_v4l2_reset_queue(pQueue);
+}
+
+static bool _usb_v4l2_setup_queue(usb_v4l2_queue_t* pQueue, int iFd, u32 uBufType, bool bMPlane, int iCount, bool bQueueAll)
+{
+   _usb_v4l2_reset_queue(pQueue);
+   pQueue->iFd = iFd;
+   pQueue->uBufType = uBufType;
+   pQueue->bMPlane = bMPlane;
+
+   struct v4l2_requestbuffers req;
+   memset(&req, 0, sizeof(req));
+   req.count = iCount;
+   req.type = uBufType;
+   req.memory = V4L2_MEMORY_MMAP;
+   if ( (_usb_v4l2_ioctl(iFd, VIDIOC_REQBUFS, &req) < 0) || (req.count < 2) )
+   {
+      log_softerror_and_alarm("[VideoSourceUSBV4L2] Failed to request %d mmap buffers (type %u), error: %s", iCount, uBufType, strerror(errno));
+      return false;
+   }
+   if ( req.count > USB_V4L2_MAX_BUFFERS )
+      req.count = USB_V4L2_MAX_BUFFERS;
+   pQueue->iBuffersCount = req.count;
+
+   for( int i=0; i<pQueue->iBuffersCount; i++ )
+   {
+      struct v4l2_buffer buf;
+      struct v4l2_plane planes[1];
+      memset(&buf, 0, sizeof(buf));
+      memset(planes, 0, sizeof(planes));
+      buf.type = uBufType;
+      buf.memory = V4L2_MEMORY_MMAP;
+      buf.index = i;
+      if ( bMPlane )
+      {
+         buf.m.planes = planes;
+         buf.length = 1;
+      }
+      if ( _usb_v4l2_ioctl(iFd, VIDIOC_QUERYBUF, &buf) < 0 )
+      {
+         log_softerror_and_alarm("[VideoSourceUSBV4L2] Failed to query buffer %d, error: %s", i, strerror(errno));
+         _usb_v4l2_release_queue(pQueue);
+         return false;
+      }
+      u32 uLength = bMPlane?planes[0].length:buf.length;
+      u32 uOffset = bMPlane?planes[0].m.mem_offset:buf.m.offset;
+      void* pMem = mmap(NULL, uLength, PROT_READ | PROT_WRITE, MAP_SHARED, iFd, uOffset);
+      if ( MAP_FAILED == pMem )
+      {
+         log_softerror_and_alarm("[VideoSourceUSBV4L2] Failed to mmap buffer %d, error: %s", i, strerror(errno));
+         _usb_v4l2_release_queue(pQueue);
+         return false;
+      }
+      pQueue->pBuffers[i] = (u8*)pMem;
+      pQueue->uBuffersLength[i] = uLength;
+      if ( bQueueAll )
+      if ( ! _usb_v4l2_queue_buffer(pQueue, i, 0) )
+      {
+         _usb_v4l2_release_queue(pQueue);
+         return false;
+      }
+   }
+   return true;
+}
+
+static bool _usb_v4l2_stream(usb_v4l2_queue_t* pQueue, bool bOn)
+{
+   int iType = (int)pQueue->uBufType;
+   if ( _usb_v4l2_ioctl(pQueue->iFd, bOn?VIDIOC_STREAMON:VIDIOC_STREAMOFF, &iType) < 0 )
+   {
+      log_softerror_and_alarm("[VideoSourceUSBV4L2] Failed to turn stream %s (type %u), error: %s", bOn?"on":"off", pQueue->uBufType, strerror(errno));
+      return false;
+   }
+   return true;
+}
+
+// Finds a memory to memory encoder producing uCodecPixelFormat from one of the raw formats the camera has
+static int _usb_v4l2_find_encoder(int iCameraFd, u32 uCodecPixelFormat, u32* puOutRawFormat, bool* pbOutMPlane)
+{
+   for( int i=0; i<32; i++ )
+   {
+      char szDevPath[32];
+      snprintf(szDevPath, sizeof(szDevPath), "/dev/video%d", i);
+      int iFd = open(szDevPath, O_RDWR | O_NONBLOCK);
+      if ( iFd < 0 )
+         continue;
+
+      struct v4l2_capability cap;
+      memset(&cap, 0, sizeof(cap));
+      if ( _usb_v4l2_ioctl(iFd, VIDIOC_QUERYCAP, &cap) < 0 )
+      {
+         close(iFd);
+         continue;
+      }
+      u32 uCaps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS)?cap.device_caps:cap.capabilities;
+      bool bMPlane = (uCaps & V4L2_CAP_VIDEO_M2M_MPLANE)?true:false;
+      if ( (!bMPlane) && (!(uCaps & V4L2_CAP_VIDEO_M2M)) )
+      {
+         close(iFd);
+         continue;
+      }
+      u32 uTypeEncoded = bMPlane?V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE:V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      u32 uTypeRaw = bMPlane?V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE:V4L2_BUF_TYPE_VIDEO_OUTPUT;
+      if ( ! _usb_v4l2_has_format(iFd, uTypeEncoded, uCodecPixelFormat) )
+      {
+         close(iFd);
+         continue;
+      }
+      for( int k=0; k<(int)(sizeof(s_uUSBV4L2RawFormats)/sizeof(s_uUSBV4L2RawFormats[0])); k++ )
+      {
+         if ( ! _usb_v4l2_has_format(iFd, uTypeRaw, s_uUSBV4L2RawFormats[k]) )
+            continue;
+         if ( ! _usb_v4l2_has_format(iCameraFd, V4L2_BUF_TYPE_VIDEO_CAPTURE, s_uUSBV4L2RawFormats[k]) )
+            continue;
+         log_line("[VideoSourceUSBV4L2] Found %s encoder %s (%s), raw format: %s", _usb_v4l2_fourcc_str(uCodecPixelFormat), szDevPath, cap.card, _usb_v4l2_fourcc_str(s_uUSBV4L2RawFormats[k]));
+         *puOutRawFormat = s_uUSBV4L2RawFormats[k];
+         *pbOutMPlane = bMPlane;
+         return iFd;
+      }
+      close(iFd);
+   }
+   return -1;
+}
+
+static void _usb_v4l2_set_encoder_controls(usb_v4l2_capture_t* pCapture, int iFd, u32 uBitrateBPS, int iKeyframeIntervalFrames)
+{
+   _usb_v4l2_set_control(iFd, V4L2_CID_MPEG_VIDEO_BITRATE_MODE, V4L2_MPEG_VIDEO_BITRATE_MODE_CBR, "bitrate mode");
+   _usb_v4l2_set_control(iFd, V4L2_CID_MPEG_VIDEO_BITRATE, (int)uBitrateBPS, "bitrate");
+   // Keyframes must carry the SPS/PPS, the receiver can start decoding on any of them
+   _usb_v4l2_set_control(iFd, V4L2_CID_MPEG_VIDEO_REPEAT_SEQ_HEADER, 1, "repeat sequence header");
+   if ( pCapture->uCodecPixelFormat == V4L2_PIX_FMT_H264 )
+   {
+      _usb_v4l2_set_control(iFd, V4L2_CID_MPEG_VIDEO_H264_PROFILE, V4L2_MPEG_VIDEO_H264_PROFILE_BASELINE, "H264 profile");
+      _usb_v4l2_set_control(iFd, V4L2_CID_MPEG_VIDEO_H264_I_PERIOD, iKeyframeIntervalFrames, "H264 I period");
+   }
+   else
+      _usb_v4l2_set_control(iFd, V4L2_CID_MPEG_VIDEO_GOP_SIZE, iKeyframeIntervalFrames, "GOP size");
+}
+
+static bool _usb_v4l2_open_passthrough(usb_v4l2_capture_t* pCapture, u32 uCodecPixelFormat, u32 uBitrateBPS, int iKeyframeIntervalFrames)
+{
+   if ( ! _usb_v4l2_has_format(pCapture->iCameraFd, V4L2_BUF_TYPE_VIDEO_CAPTURE, uCodecPixelFormat) )
+      return false;
+   if ( ! _usb_v4l2_set_format(pCapture->iCameraFd, V4L2_BUF_TYPE_VIDEO_CAPTURE, false, uCodecPixelFormat, pCapture->iWidth, pCapture->iHeight, 0, 0, NULL, NULL) )
+   {
+      log_line("[VideoSourceUSBV4L2] Camera lists %s but did not accept it for %dx%d", _usb_v4l2_fourcc_str(uCodecPixelFormat), pCapture->iWidth, pCapture->iHeight);
+      return false;
+   }
+   pCapture->uCodecPixelFormat = uCodecPixelFormat;
+   _usb_v4l2_set_fps(pCapture->iCameraFd, V4L2_BUF_TYPE_VIDEO_CAPTURE, pCapture->iFPS);
+   // UVC 1.5 cameras map their encoding unit to these; older ones don't have them
+   _usb_v4l2_set_encoder_controls(pCapture, pCapture->iCameraFd, uBitrateBPS, iKeyframeIntervalFrames);
+
+   if ( ! _usb_v4l2_setup_queue(&pCapture->cameraQueue, pCapture->iCameraFd, V4L2_BUF_TYPE_VIDEO_CAPTURE, false, USB_V4L2_CAMERA_BUFFERS, true) )
+      return false;
+   if ( ! _usb_v4l2_stream(&pCapture->cameraQueue, true) )
+   {
+      _usb_v4l2_release_queue(&pCapture->cameraQueue);
+      return false;
+   }
+   pCapture->mode = USB_V4L2_MODE_PASSTHROUGH;
+   pCapture->pReadQueue = &pCapture->cameraQueue;
+   log_line("[VideoSourceUSBV4L2] Started camera %s passthrough, %d buffers.", _usb_v4l2_fourcc_str(uCodecPixelFormat), pCapture->cameraQueue.iBuffersCount);
+   return true;
+}
+
+static bool _usb_v4l2_open_encoder(usb_v4l2_capture_t* pCapture, u32 uCodecPixelFormat, u32 uBitrateBPS, int iKeyframeIntervalFrames)
+{
+   bool bMPlane = false;
+   u32 uRawFormat = 0;
+   int iEncoderFd = _usb_v4l2_find_encoder(pCapture->iCameraFd, uCodecPixelFormat, &uRawFormat, &bMPlane);
+   if ( iEncoderFd < 0 )
+      return false;
+
+   pCapture->iEncoderFd = iEncoderFd;
+   pCapture->uCodecPixelFormat = uCodecPixelFormat;
+   pCapture->uRawPixelFormat = uRawFormat;
+
+   u32 uCameraFrameSize = 0;
+   if ( ! _usb_v4l2_set_format(pCapture->iCameraFd, V4L2_BUF_TYPE_VIDEO_CAPTURE, false, uRawFormat, pCapture->iWidth, pCapture->iHeight, 0, 0, &pCapture->uCameraBytesPerLine, &uCameraFrameSize) )
+   {
+      log_softerror_and_alarm("[VideoSourceUSBV4L2] Camera did not accept raw format %s for %dx%d", _usb_v4l2_fourcc_str(uRawFormat), pCapture->iWidth, pCapture->iHeight);
+      return false;
+   }
+   _usb_v4l2_set_fps(pCapture->iCameraFd, V4L2_BUF_TYPE_VIDEO_CAPTURE, pCapture->iFPS);
+
+   u32 uTypeRaw = bMPlane?V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE:V4L2_BUF_TYPE_VIDEO_OUTPUT;
+   u32 uTypeEncoded = bMPlane?V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE:V4L2_BUF_TYPE_VIDEO_CAPTURE;
+   if ( ! _usb_v4l2_set_format(iEncoderFd, uTypeRaw, bMPlane, uRawFormat, pCapture->iWidth, pCapture->iHeight, pCapture->uCameraBytesPerLine, uCameraFrameSize, &pCapture->uEncoderBytesPerLine, &pCapture->uEncoderFrameSize) )
+   {
+      log_softerror_and_alarm("[VideoSourceUSBV4L2] Encoder did not accept raw format %s for %dx%d", _usb_v4l2_fourcc_str(uRawFormat), pCapture->iWidth, pCapture->iHeight);
+      return false;
+   }
+   if ( ! _usb_v4l2_set_format(iEncoderFd, uTypeEncoded, bMPlane, uCodecPixelFormat, pCapture->iWidth, pCapture->iHeight, 0, USB_V4L2_ENCODED_FRAME_MAX_SIZE, NULL, NULL) )
+   {
+      log_softerror_and_alarm("[VideoSourceUSBV4L2] Encoder did not accept %s output", _usb_v4l2_fourcc_str(uCodecPixelFormat));
+      return false;
+   }
+   _usb_v4l2_set_fps(iEncoderFd, uTypeRaw, pCapture->iFPS);
+   _usb_v4l2_set_encoder_controls(pCapture, iEncoderFd, uBitrateBPS, iKeyframeIntervalFrames);
+
+   if ( ! _usb_v4l2_setup_queue(&pCapture->encoderInputQueue, iEncoderFd, uTypeRaw, bMPlane, USB_V4L2_ENCODER_BUFFERS, false) )
+      return false;
+   if ( ! _usb_v4l2_setup_queue(&pCapture->encoderOutputQueue, iEncoderFd, uTypeEncoded, bMPlane, USB_V4L2_ENCODER_BUFFERS, true) )
+      return false;
+   if ( ! _usb_v4l2_setup_queue(&pCapture->cameraQueue, pCapture->iCameraFd, V4L2_BUF_TYPE_VIDEO_CAPTURE, false, USB_V4L2_CAMERA_BUFFERS, true) )
+      return false;
+
+   if ( ! _usb_v4l2_stream(&pCapture->encoderInputQueue, true) )
+      return false;
+   if ( ! _usb_v4l2_stream(&pCapture->encoderOutputQueue, true) )
+      return false;
+   if ( ! _usb_v4l2_stream(&pCapture->cameraQueue, true) )
+      return false;
+
+   pCapture->mode = USB_V4L2_MODE_ENCODER;
+   pCapture->pReadQueue = &pCapture->encoderOutputQueue;
+   log_line("[VideoSourceUSBV4L2] Started camera %s capture (line: %u bytes) to %s encoder (line: %u bytes, frame: %u bytes).",
+      _usb_v4l2_fourcc_str(uRawFormat), pCapture->uCameraBytesPerLine, _usb_v4l2_fourcc_str(uCodecPixelFormat), pCapture->uEncoderBytesPerLine, pCapture->uEncoderFrameSize);
+   return true;
+}
+
+// Releases the queues and the encoder, keeps the camera opened
+static void _usb_v4l2_stop_streaming(usb_v4l2_capture_t* pCapture)
+{
+   if ( pCapture->cameraQueue.iFd >= 0 )
+      _usb_v4l2_stream(&pCapture->cameraQueue, false);
+   if ( pCapture->encoderInputQueue.iFd >= 0 )
+      _usb_v4l2_stream(&pCapture->encoderInputQueue, false);
+   if ( pCapture->encoderOutputQueue.iFd >= 0 )
+      _usb_v4l2_stream(&pCapture->encoderOutputQueue, false);
+   _usb_v4l2_release_queue(&pCapture->cameraQueue);
+   _usb_v4l2_release_queue(&pCapture->encoderInputQueue);
+   _usb_v4l2_release_queue(&pCapture->encoderOutputQueue);
+   if ( pCapture->iEncoderFd >= 0 )
+      close(pCapture->iEncoderFd);
+   pCapture->iEncoderFd = -1;
+   pCapture->pReadQueue = NULL;
+   pCapture->iReadBufferIndex = -1;
+   pCapture->mode = USB_V4L2_MODE_NONE;
+}
+
+bool usb_v4l2_open(usb_v4l2_capture_t* pCapture, const char* szDevice, int iWidth, int iHeight, int iFPS, bool bPreferH265, u32 uBitrateBPS, int iKeyframeIntervalFrames)
+{
+   if ( (NULL == pCapture) || (NULL == szDevice) )
+      return false;
+
+   memset(pCapture, 0, sizeof(usb_v4l2_capture_t));
+   pCapture->iCameraFd = -1;
+   pCapture->iEncoderFd = -1;
+   pCapture->iReadBufferIndex = -1;
+   _usb_v4l2_reset_queue(&pCapture->cameraQueue);
+   _usb_v4l2_reset_queue(&pCapture->encoderInputQueue);
+   _usb_v4l2_reset_queue(&pCapture->encoderOutputQueue);
+   pCapture->iWidth = iWidth;
+   pCapture->iHeight = iHeight;
+   pCapture->iFPS = (iFPS > 0)?iFPS:30;
+   if ( iKeyframeIntervalFrames < 1 )
+      iKeyframeIntervalFrames = pCapture->iFPS * 2;
+
+   pCapture->iCameraFd = open(szDevice, O_RDWR | O_NONBLOCK);
+   if ( pCapture->iCameraFd < 0 )
+   {
+      log_softerror_and_alarm("[VideoSourceUSBV4L2] Failed to open %s, error: %s", szDevice, strerror(errno));
+      return false;
+   }
+
+   struct v4l2_capability cap;
+   memset(&cap, 0, sizeof(cap));
+   u32 uCaps = 0;
+   if ( _usb_v4l2_ioctl(pCapture->iCameraFd, VIDIOC_QUERYCAP, &cap) >= 0 )
+      uCaps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS)?cap.device_caps:cap.capabilities;
+   if ( (!(uCaps & V4L2_CAP_VIDEO_CAPTURE)) || (!(uCaps & V4L2_CAP_STREAMING)) )
+   {
+      log_softerror_and_alarm("[VideoSourceUSBV4L2] %s is not a single plane streaming capture device.", szDevice);
+      usb_v4l2_close(pCapture);
+      return false;
+   }
+
+   u32 uCodecs[2] = { V4L2_PIX_FMT_H264, V4L2_PIX_FMT_HEVC };
+   if ( bPreferH265 )
+   {
+      uCodecs[0] = V4L2_PIX_FMT_HEVC;
+      uCodecs[1] = V4L2_PIX_FMT_H264;
+   }
+
+   bool bStarted = false;
+   for( int i=0; (i<2) && (!bStarted); i++ )
+      bStarted = _usb_v4l2_open_passthrough(pCapture, uCodecs[i], uBitrateBPS, iKeyframeIntervalFrames);
+   for( int i=0; (i<2) && (!bStarted); i++ )
+   {
+      bStarted = _usb_v4l2_open_encoder(pCapture, uCodecs[i], uBitrateBPS, iKeyframeIntervalFrames);
+      if ( ! bStarted )
+         _usb_v4l2_stop_streaming(pCapture);
+   }
+   if ( ! bStarted )
+   {
+      log_line("[VideoSourceUSBV4L2] %s (%s) has no H264/H265 output and no usable encoder was found.", szDevice, cap.card);
+      usb_v4l2_close(pCapture);
+      return false;
+   }
+
+   u32 uMaxEncodedFrame = 0;
+   for( int i=0; i<pCapture->pReadQueue->iBuffersCount; i++ )
+   {
+      if ( pCapture->pReadQueue->uBuffersLength[i] > uMaxEncodedFrame )
+         uMaxEncodedFrame = pCapture->pReadQueue->uBuffersLength[i];
+   }
+   pCapture->uStagingBufferSize = uMaxEncodedFrame + 4;
+   pCapture->pStagingBuffer = (u8*) malloc(pCapture->uStagingBufferSize);
+   if ( NULL == pCapture->pStagingBuffer )
+   {
+      log_error_and_alarm("[VideoSourceUSBV4L2] Failed to allocate %u bytes staging buffer.", pCapture->uStagingBufferSize);
+      usb_v4l2_close(pCapture);
+      return false;
+   }
+   return true;
+}
+
+void usb_v4l2_close(usb_v4l2_capture_t* pCapture)
+{
+   if ( NULL == pCapture )
+      return;
+   if ( pCapture->iCameraFd >= 0 )
+   {
+      _usb_v4l2_stop_streaming(pCapture);
+      close(pCapture->iCameraFd);
+      log_line("[VideoSourceUSBV4L2] Closed. Frames: %u, dropped: %u, NALs copied: %u", pCapture->uStatsFrames, pCapture->uStatsDroppedFrames, pCapture->uStatsCopiedNALs);
+   }
+   pCapture->iCameraFd = -1;
+   if ( NULL != pCapture->pStagingBuffer )
+      free(pCapture->pStagingBuffer);
+   pCapture->pStagingBuffer = NULL;
+   pCapture->mode = USB_V4L2_MODE_NONE;
+}
+
+int usb_v4l2_get_wait_fd(usb_v4l2_capture_t* pCapture)
+{
+   if ( (NULL == pCapture) || (NULL == pCapture->pReadQueue) )
+      return -1;
+   return pCapture->pReadQueue->iFd;
+}
+
+// Copies a raw frame between buffers that can have different line strides (and planes offsets)
+static u32 _usb_v4l2_copy_raw_frame(usb_v4l2_capture_t* pCapture, u8* pDst, u32 uDstSize, const u8* pSrc, u32 uSrcBytes)
+{
+   u32 uSrcBPL = pCapture->uCameraBytesPerLine;
+   u32 uDstBPL = pCapture->uEncoderBytesPerLine;
+   if ( (0 == uSrcBPL) || (0 == uDstBPL) )
+      return 0;
+
+   // The layout comes from the encoder format (sizeimage), not from the mmap length, that drivers can pad
+   u32 uDstFrameSize = pCapture->uEncoderFrameSize;
+   if ( (0 == uDstFrameSize) || (uDstFrameSize > uDstSize) )
+      return 0;
+
+   u32 uLineBytes = (uSrcBPL < uDstBPL)?uSrcBPL:uDstBPL;
+   u32 uHeight = (u32)pCapture->iHeight;
+   bool bPlanar = (pCapture->uRawPixelFormat == V4L2_PIX_FMT_NV12) || (pCapture->uRawPixelFormat == V4L2_PIX_FMT_YUV420);
+   // Encoders can align the planes heights (i.e. bcm2835 pads 1080 to 1088 lines); get it from the frame size (4:2:0 is 1.5 bytes per pixel)
+   u32 uDstHeight = bPlanar?((uDstFrameSize * 2) / (3 * uDstBPL)):uHeight;
+
+   // Same layout: one copy. The chroma planes start at the same offset only if the heights match too.
+   if ( (uSrcBPL == uDstBPL) && (uDstHeight == uHeight) && (uSrcBytes <= uDstFrameSize) )
+   {
+      memcpy(pDst, pSrc, uSrcBytes);
+      return uSrcBytes;
+   }
+   if ( (uDstHeight < uHeight) || (uSrcBPL * uHeight > uSrcBytes) || (uDstBPL * uHeight > uDstFrameSize) )
+      return 0;
+
+   for( u32 y=0; y<uHeight; y++ )
+      memcpy(pDst + y*uDstBPL, pSrc + y*uSrcBPL, uLineBytes);
+   if ( ! bPlanar )
+      return uDstBPL * uHeight;
+
+   const u8* pSrcChroma = pSrc + uSrcBPL * uHeight;
+   u8* pDstChroma = pDst + uDstBPL * uDstHeight;
+   if ( pCapture->uRawPixelFormat == V4L2_PIX_FMT_NV12 )
+   {
+      // Interleaved UV plane, half height
+      for( u32 y=0; y<uHeight/2; y++ )
+         memcpy(pDstChroma + y*uDstBPL, pSrcChroma + y*uSrcBPL, uLineBytes);
+   }
+   else
+   {
+      // U then V planes, half width and half height each
+      for( int iPlane=0; iPlane<2; iPlane++ )
+      {
+         const u8* pSrcPlane = pSrcChroma + iPlane * (uSrcBPL/2) * (uHeight/2);
+         u8* pDstPlane = pDstChroma + iPlane * (uDstBPL/2) * (uDstHeight/2);
+         for( u32 y=0; y<uHeight/2; y++ )
+            memcpy(pDstPlane + y*(uDstBPL/2), pSrcPlane + y*(uSrcBPL/2), uLineBytes/2);
+      }
+   }
+   return uDstFrameSize;
+}
+
+int usb_v4l2_feed_encoder(usb_v4l2_capture_t* pCapture, int iTimeoutMs)
+{
+   if ( (NULL == pCapture) || (pCapture->mode != USB_V4L2_MODE_ENCODER) )
+      return -1;
+
+   struct pollfd pfd;
+   pfd.fd = pCapture->iCameraFd;
+   pfd.events = POLLIN;
+   pfd.revents = 0;
+   int iRes = poll(&pfd, 1, iTimeoutMs);
+   if ( (iRes < 0) && (errno != EINTR) )
+      return -1;
+   if ( pfd.revents & (POLLERR | POLLHUP | POLLNVAL) )
+      return -1;
+
+   // Take back the raw frames the encoder is done with
+   while ( _usb_v4l2_dequeue_buffer(&pCapture->encoderInputQueue, NULL) >= 0 )
+   {
+   }
+
+   int iCountFed = 0;
+   while ( true )
+   {
+      u32 uBytes = 0;
+      int iCameraIndex = _usb_v4l2_dequeue_buffer(&pCapture->cameraQueue, &uBytes);
+      if ( -1 == iCameraIndex )
+         break;
+      if ( iCameraIndex < 0 )
+         return -1;
+
+      pCapture->uStatsFrames++;
+      int iEncoderIndex = -1;
+      for( int i=0; i<pCapture->encoderInputQueue.iBuffersCount; i++ )
+      {
+         if ( ! pCapture->encoderInputQueue.bBufferQueued[i] )
+         {
+            iEncoderIndex = i;
+            break;
+         }
+      }
+      if ( iEncoderIndex < 0 )
+         pCapture->uStatsDroppedFrames++;
+      else
+      {
+         u32 uCopied = _usb_v4l2_copy_raw_frame(pCapture, pCapture->encoderInputQueue.pBuffers[iEncoderIndex], pCapture->encoderInputQueue.uBuffersLength[iEncoderIndex],
+                          pCapture->cameraQueue.pBuffers[iCameraIndex], uBytes);
+         if ( 0 == uCopied )
+            pCapture->uStatsDroppedFrames++;
+         else if ( _usb_v4l2_queue_buffer(&pCapture->encoderInputQueue, iEncoderIndex, uCopied) )
+            iCountFed++;
+      }
+      if ( ! _usb_v4l2_queue_buffer(&pCapture->cameraQueue, iCameraIndex, 0) )
+         return -1;
+   }
+   return iCountFed;
+}
+
+// Returns the offset of the next start code (00 00 01 or 00 00 00 01) at or after uFrom, or uEnd
+static u32 _usb_v4l2_find_start_code(const u8* pData, u32 uFrom, u32 uEnd, int* piCodeLength)
+{
+   u32 uPos = uFrom;
+   while ( uPos + 3 <= uEnd )
+   {
+      const u8* pOne = (const u8*) memchr(pData + uPos + 2, 0x01, uEnd - uPos - 2);
+      if ( NULL == pOne )
+         break;
+      u32 uOne = (u32)(pOne - pData);
+      if ( (pData[uOne-1] == 0) && (pData[uOne-2] == 0) )
+      {
+         if ( (uOne >= uFrom + 3) && (pData[uOne-3] == 0) )
+         {
+            *piCodeLength = 4;
+            return uOne - 3;
+         }
+         *piCodeLength = 3;
+         return uOne - 2;
+      }
+      uPos = uOne - 1;
+   }
+   *piCodeLength = 0;
+   return uEnd;
+}
+
+// H265 NAL types mapped to the H264 ones the video pipeline looks at
+static u32 _usb_v4l2_map_h265_nal_type(u32 uType)
+{
+   if ( (uType >= 16) && (uType <= 21) )
+      return 5;
+   if ( uType <= 9 )
+      return 1;
+   return 7;
+}
+
+static void _usb_v4l2_requeue_read_buffer(usb_v4l2_capture_t* pCapture)
+{
+   if ( (NULL == pCapture->pReadQueue) || (pCapture->iReadBufferIndex < 0) )
+      return;
+   _usb_v4l2_queue_buffer(pCapture->pReadQueue, pCapture->iReadBufferIndex, 0);
+   pCapture->iReadBufferIndex = -1;
+}
+
+u8* usb_v4l2_read_nal(usb_v4l2_capture_t* pCapture, int* piSize, bool* pbIsFrameStart, bool* pbIsFrameEnd, u32* puNALType, u32* puTimeAvailable)
+{
+   *piSize = 0;
+   if ( (NULL == pCapture) || (NULL == pCapture->pReadQueue) )
+      return NULL;
+
+   int iCodeLength = 0;
+   u32 uNALStart = 0;
+   while ( true )
+   {
+      if ( pCapture->iReadBufferIndex < 0 )
+      {
+         u32 uBytes = 0;
+         int iIndex = _usb_v4l2_dequeue_buffer(pCapture->pReadQueue, &uBytes);
+         if ( -1 == iIndex )
+            return NULL;
+         if ( iIndex < 0 )
+         {
+            *piSize = -1;
+            return NULL;
+         }
+         pCapture->iReadBufferIndex = iIndex;
+         pCapture->uReadBufferBytes = uBytes;
+         pCapture->uReadOffset = 0;
+         pCapture->uReadBufferTime = get_current_timestamp_ms();
+         pCapture->bReadAnyVCLFromBuffer = false;
+         if ( pCapture->mode == USB_V4L2_MODE_PASSTHROUGH )
+            pCapture->uStatsFrames++;
+      }
+      uNALStart = _usb_v4l2_find_start_code(pCapture->pReadQueue->pBuffers[pCapture->iReadBufferIndex], pCapture->uReadOffset, pCapture->uReadBufferBytes, &iCodeLength);
+      if ( (uNALStart + iCodeLength < pCapture->uReadBufferBytes) && (iCodeLength > 0) )
+         break;
+      // Done with this buffer
+      _usb_v4l2_requeue_read_buffer(pCapture);
+   }
+
+   u8* pBuffer = pCapture->pReadQueue->pBuffers[pCapture->iReadBufferIndex];
+   u32 uPayload = uNALStart + iCodeLength;
+   int iNextCodeLength = 0;
+   u32 uNALEnd = _usb_v4l2_find_start_code(pBuffer, uPayload, pCapture->uReadBufferBytes, &iNextCodeLength);
+   pCapture->uReadOffset = uNALEnd;
+
+   u32 uNALType = 0;
+   if ( pCapture->uCodecPixelFormat == V4L2_PIX_FMT_HEVC )
+      uNALType = _usb_v4l2_map_h265_nal_type((pBuffer[uPayload] >> 1) & 0x3F);
+   else
+      uNALType = pBuffer[uPayload] & 0x1F;
+   bool bIsVCL = (uNALType == 1) || (uNALType == 5);
+
+   *pbIsFrameStart = bIsVCL && (!pCapture->bReadAnyVCLFromBuffer);
+   *pbIsFrameEnd = (uNALEnd >= pCapture->uReadBufferBytes);
+   *puNALType = uNALType;
+   if ( bIsVCL )
+      pCapture->bReadAnyVCLFromBuffer = true;
+   if ( NULL != puTimeAvailable )
+      *puTimeAvailable = pCapture->uReadBufferTime;
+
+   if ( 4 == iCodeLength )
+   {
+      *piSize = (int)(uNALEnd - uNALStart);
+      return pBuffer + uNALStart;
+   }
+
+   // 3 bytes start code: the video pipeline expects 4 bytes ones
+   u32 uSize = uNALEnd - uPayload;
+   if ( uSize + 4 > pCapture->uStagingBufferSize )
+      return NULL;
+   pCapture->pStagingBuffer[0] = 0;
+   pCapture->pStagingBuffer[1] = 0;
+   pCapture->pStagingBuffer[2] = 0;
+   pCapture->pStagingBuffer[3] = 0x01;
+   memcpy(pCapture->pStagingBuffer + 4, pBuffer + uPayload, uSize);
+   pCapture->uStatsCopiedNALs++;
+   *piSize = (int)(uSize + 4);
+   return pCapture->pStagingBuffer;
+}
+
+void usb_v4l2_discard_pending(usb_v4l2_capture_t* pCapture)
+{
+   if ( (NULL == pCapture) || (NULL == pCapture->pReadQueue) )
+      return;
+   _usb_v4l2_requeue_read_buffer(pCapture);
+   int iIndex;
+   while ( (iIndex = _usb_v4l2_dequeue_buffer(pCapture->pReadQueue, NULL)) >= 0 )
+      _usb_v4l2_queue_buffer(pCapture->pReadQueue, iIndex, 0);
+}
+
+bool usb_v4l2_set_bitrate(usb_v4l2_capture_t* pCapture, u32 uBitrateBPS)
+{
+   if ( (NULL == pCapture) || (pCapture->mode == USB_V4L2_MODE_NONE) )
+      return false;
+   int iFd = (pCapture->mode == USB_V4L2_MODE_ENCODER)?pCapture->iEncoderFd:pCapture->iCameraFd;
+   return _usb_v4l2_set_control(iFd, V4L2_CID_MPEG_VIDEO_BITRATE, (int)uBitrateBPS, "bitrate");
+}
+
+bool usb_v4l2_set_keyframe_interval(usb_v4l2_capture_t* pCapture, int iKeyframeIntervalFrames)
+{
+   if ( (NULL == pCapture) || (pCapture->mode == USB_V4L2_MODE_NONE) || (iKeyframeIntervalFrames < 1) )
+      return false;
+   int iFd = (pCapture->mode == USB_V4L2_MODE_ENCODER)?pCapture->iEncoderFd:pCapture->iCameraFd;
+   if ( pCapture->uCodecPixelFormat == V4L2_PIX_FMT_H264 )
+      return _usb_v4l2_set_control(iFd, V4L2_CID_MPEG_VIDEO_H264_I_PERIOD, iKeyframeIntervalFrames, "H264 I period");
+   return _usb_v4l2_set_control(iFd, V4L2_CID_MPEG_VIDEO_GOP_SIZE, iKeyframeIntervalFrames, "GOP size");
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "../base/base.h"
+
+// Native V4L2 capture for USB (UVC) cameras, used by the USB video source:
+//  * passthrough: the camera encodes H264/H265 itself; its mmap-ed capture buffers (one access unit each)
+//    are read in place, NAL by NAL, and given back to the driver once all their NAL units were read;
+//  * encoder: the camera gives raw frames, fed to a V4L2 memory to memory encoder (i.e. bcm2835-codec
+//    on Raspberry Pi); the encoded buffers are read in place the same way. Bitrate and keyframe interval
+//    are encoder controls, changed live.
+// Can be tested with the vivid driver or v4l2loopback.
+
+#define USB_V4L2_MAX_BUFFERS 8
+#define USB_V4L2_CAMERA_BUFFERS 4
+#define USB_V4L2_ENCODER_BUFFERS 4
+#define USB_V4L2_ENCODED_FRAME_MAX_SIZE (1024*1024)
+
+typedef enum
+{
+   USB_V4L2_MODE_NONE = 0,
+   USB_V4L2_MODE_PASSTHROUGH,
+   USB_V4L2_MODE_ENCODER
+} usb_v4l2_mode_t;
+
+typedef struct
+{
+   int iFd;
+   u32 uBufType;
+   bool bMPlane;
+   int iBuffersCount;
+   u8* pBuffers[USB_V4L2_MAX_BUFFERS];
+   u32 uBuffersLength[USB_V4L2_MAX_BUFFERS];
+   bool bBufferQueued[USB_V4L2_MAX_BUFFERS];
+} usb_v4l2_queue_t;
+
+typedef struct
+{
+   usb_v4l2_mode_t mode;
+   u32 uCodecPixelFormat; // V4L2_PIX_FMT_H264 or V4L2_PIX_FMT_HEVC
+   u32 uRawPixelFormat; // encoder mode only
+   int iWidth;
+   int iHeight;
+   int iFPS;
+
+   int iCameraFd;
+   int iEncoderFd;
+   usb_v4l2_queue_t cameraQueue;
+   usb_v4l2_queue_t encoderInputQueue; // raw frames to the encoder (the V4L2 output queue)
+   usb_v4l2_queue_t encoderOutputQueue; // encoded frames from the encoder (the V4L2 capture queue)
+   u32 uCameraBytesPerLine;
+   u32 uEncoderBytesPerLine;
+   u32 uEncoderFrameSize;
+
+   // Encoded buffer being read (from the camera queue or the encoder output queue)
+   usb_v4l2_queue_t* pReadQueue;
+   int iReadBufferIndex;
+   u32 uReadBufferBytes;
+   u32 uReadOffset;
+   u32 uReadBufferTime;
+   bool bReadAnyVCLFromBuffer;
+   // NAL units that don't start with a 4 bytes start code are copied here, with one
+   u8* pStagingBuffer;
+   u32 uStagingBufferSize;
+
+   u32 uStatsFrames;
+   u32 uStatsDroppedFrames;
+   u32 uStatsCopiedNALs;
+} usb_v4l2_capture_t;
+
+// Tries passthrough first (bPreferH265 selects the codec tried first), then a raw format + memory to memory encoder.
+// Returns true if the capture was started.
+bool usb_v4l2_open(usb_v4l2_capture_t* pCapture, const char* szDevice, int iWidth, int iHeight, int iFPS, bool bPreferH265, u32 uBitrateBPS, int iKeyframeIntervalFrames);
+void usb_v4l2_close(usb_v4l2_capture_t* pCapture);
+
+// Fd that is readable when there is an encoded frame to read
+int usb_v4l2_get_wait_fd(usb_v4l2_capture_t* pCapture);
+
+// Encoder mode: moves the captured raw frames to the encoder. Waits up to iTimeoutMs for a camera frame.
+// Returns the number of frames moved, -1 on device error
+int usb_v4l2_feed_encoder(usb_v4l2_capture_t* pCapture, int iTimeoutMs);
+
+// Returns the next NAL unit (starting with a 4 bytes start code), or NULL if no encoded data is available now.
+// The data is valid until the next call. *piSize is -1 on device error.
+// puNALType gets the H264 NAL type (H265 types are mapped to the H264 ones: 5 - I, 1 - P, 7 - signaling)
+u8* usb_v4l2_read_nal(usb_v4l2_capture_t* pCapture, int* piSize, bool* pbIsFrameStart, bool* pbIsFrameEnd, u32* puNALType, u32* puTimeAvailable);
+// Gives back to the driver all the encoded buffers not read yet
+void usb_v4l2_discard_pending(usb_v4l2_capture_t* pCapture);
+
+// Live changes; return false if the device does not support them
+bool usb_v4l2_set_bitrate(usb_v4l2_capture_t* pCapture, u32 uBitrateBPS);
+bool usb_v4l2_set_keyframe_interval(usb_v4l2_capture_t* pCapture, int iKeyframeIntervalFrames);
@@ -560,6 +560,19 @@ usb_read_section:  // TEST MODE label
    return true;
 }
 
+int video_sources_get_input_fd()
+{
+   if ( (NULL == g_pCurrentModel) || (! g_pCurrentModel->hasCamera()) )
+      return -1;
+   if ( g_pCurrentModel->isActiveCameraCSICompatible() || g_pCurrentModel->isActiveCameraVeye() )
+      return video_source_csi_get_input_fd();
+   if ( g_pCurrentModel->isActiveCameraOpenIPC() )
+      return video_source_majestic_get_input_fd();
+   if ( g_pCurrentModel->isActiveCameraUSB() )
+      return video_source_usb_get_input_fd();
+   return -1;
+}
+
 bool video_sources_has_stream_data()
 {
    return (s_uTotalVideoSourceReadBytes > 0)?true:false;
@@ -937,6 +950,8 @@ void video_sources_set_video_bitrate(u32 uVideoBitrateBPS, int iIPQDelta, const
       else if ( hardware_camera_maj_get_current_qpdelta() != iIPQDelta )
          hardware_camera_maj_set_qpdelta(iIPQDelta);
    }
+   else if ( g_pCurrentModel->isActiveCameraUSB() )
+      video_source_usb_set_video_bitrate(uVideoBitrateBPS);
 }
 
 u32 video_sources_get_last_set_video_bitrate()
@@ -971,6 +986,8 @@ void video_sources_set_keyframe(int iKeyframeMs)
    }
    if ( g_pCurrentModel->isActiveCameraOpenIPC() )
       hardware_camera_maj_set_keyframe(s_iLastSetVideoKeyframeMs);                
+   if ( g_pCurrentModel->isActiveCameraUSB() )
+      video_source_usb_set_keyframe(s_iLastSetVideoKeyframeMs);
 }
 
 int video_sources_get_last_set_keyframe()
@@ -15,6 +15,8 @@ bool video_sources_is_caputure_process_running();
 u32  video_sources_get_capture_start_time();
 void video_sources_flush_discard_all_pending_data();
 bool video_sources_try_read_camera_frame(bool* pbOutEndOfFrameDetected);
+// Fd that becomes readable when there is new camera data, -1 if the active camera has none
+int  video_sources_get_input_fd();
 bool video_sources_has_stream_data();
 u32  video_sources_last_stream_data();
 
@@ -69,15 +69,18 @@ VideoTxPacketsBuffer::VideoTxPacketsBuffer(int iVideoStreamIndex, int iCameraInd
    m_iVideoStreamIndex = iVideoStreamIndex;
    m_iCameraIndex = iCameraIndex;
 
+   memset(&m_PacketsSlab, 0, sizeof(t_packets_slab));
    for( int i=0; i<MAX_RXTX_BLOCKS_BUFFER; i++ )
-   for( int k=0; k<MAX_TOTAL_PACKETS_IN_BLOCK; k++ )
    {
-      m_VideoPackets[i][k].pRawData = NULL;
-      m_VideoPackets[i][k].pVideoData = NULL;
-      m_VideoPackets[i][k].pPH = NULL;
-      m_VideoPackets[i][k].pPHVS = NULL;
-      m_VideoPackets[i][k].pPHVSImp = NULL;
-      m_VideoPackets[i][k].bEmpty = true;
+      m_uVideoPacketsFilledMask[i] = 0;
+      for( int k=0; k<MAX_TOTAL_PACKETS_IN_BLOCK; k++ )
+      {
+         m_VideoPackets[i][k].pRawData = NULL;
+         m_VideoPackets[i][k].pVideoData = NULL;
+         m_VideoPackets[i][k].pPH = NULL;
+         m_VideoPackets[i][k].pPHVS = NULL;
+         m_VideoPackets[i][k].pPHVSImp = NULL;
+      }
    }
    m_uCurrentH264FrameIndex = 0;
    m_iCurrentBufferIndexToSend = 0;
@@ -109,6 +112,8 @@ VideoTxPacketsBuffer::VideoTxPacketsBuffer(int iVideoStreamIndex, int iCameraInd
    m_iCurrentRealFPS = 0;
    m_uLastTimeSentVideoPacketMicros = 0;
    m_uLastSentVideoPacketDurationMicros = 0;
+   m_uTxBatchDurationMicros = 0;
+   m_uLastTxBatchDurationMicros = 0;
    m_uLastSentVideoPacketDatarateBPS = 0;
    m_uLastSentVideoPacketDatarateMinBPS = 0;
    m_uLastSentVideoPacketDatarateMaxBPS = 0;
@@ -121,18 +126,19 @@ VideoTxPacketsBuffer::~VideoTxPacketsBuffer()
 {
    uninit();
 
+   packets_slab_free(&m_PacketsSlab);
+
    for( int i=0; i<MAX_RXTX_BLOCKS_BUFFER; i++ )
-   for( int k=0; k<MAX_TOTAL_PACKETS_IN_BLOCK; k++ )
    {
-      if ( NULL != m_VideoPackets[i][k].pRawData )
-         free(m_VideoPackets[i][k].pRawData);
-
-      m_VideoPackets[i][k].pRawData = NULL;
-      m_VideoPackets[i][k].pVideoData = NULL;
-      m_VideoPackets[i][k].pPH = NULL;
-      m_VideoPackets[i][k].pPHVS = NULL;
-      m_VideoPackets[i][k].pPHVSImp = NULL;
-      m_VideoPackets[i][k].bEmpty = true;
+      m_uVideoPacketsFilledMask[i] = 0;
+      for( int k=0; k<MAX_TOTAL_PACKETS_IN_BLOCK; k++ )
+      {
+         m_VideoPackets[i][k].pRawData = NULL;
+         m_VideoPackets[i][k].pVideoData = NULL;
+         m_VideoPackets[i][k].pPH = NULL;
+         m_VideoPackets[i][k].pPHVS = NULL;
+         m_VideoPackets[i][k].pPHVSImp = NULL;
+      }
    }
 
    if ( NULL != m_pTempVideoFrameBuffer )
@@ -152,6 +158,25 @@ bool VideoTxPacketsBuffer::init(Model* pModel)
    }
    log_line("[VideoTxBuffer] Initialize video Tx buffer instance number %d.", m_iInstanceIndex+1);
 
+   if ( NULL == m_PacketsSlab.pMemory )
+   {
+      if ( ! packets_slab_alloc(&m_PacketsSlab, MAX_RXTX_BLOCKS_BUFFER * MAX_TOTAL_PACKETS_IN_BLOCK, MAX_PACKET_TOTAL_SIZE, 1) )
+      {
+         log_error_and_alarm("[VideoTxBuffer] Failed to allocate video packets buffer.");
+         return false;
+      }
+      for( int i=0; i<MAX_RXTX_BLOCKS_BUFFER; i++ )
+      for( int k=0; k<MAX_TOTAL_PACKETS_IN_BLOCK; k++ )
+      {
+         u8* pRawData = packets_slab_get_slot(&m_PacketsSlab, i*MAX_TOTAL_PACKETS_IN_BLOCK + k);
+         m_VideoPackets[i][k].pRawData = pRawData;
+         m_VideoPackets[i][k].pVideoData = pRawData + sizeof(t_packet_header) + sizeof(t_packet_header_video_segment);
+         m_VideoPackets[i][k].pPH = (t_packet_header*)pRawData;
+         m_VideoPackets[i][k].pPHVS = (t_packet_header_video_segment*)(pRawData + sizeof(t_packet_header));
+         m_VideoPackets[i][k].pPHVSImp = (t_packet_header_video_segment_important*)(pRawData + sizeof(t_packet_header) + sizeof(t_packet_header_video_segment));
+      }
+   }
+
    if ( NULL == m_pTempVideoFrameBuffer )
    {
       m_pTempVideoFrameBuffer = (u8*)malloc(m_iTempVideoFrameBufferSize);
@@ -205,30 +230,9 @@ void VideoTxPacketsBuffer::discardBuffer()
 }
 
 
-void VideoTxPacketsBuffer::_checkAllocatePacket(int iBufferIndex, int iPacketIndex)
-{
-   if ( (iBufferIndex < 0) || (iBufferIndex >= MAX_RXTX_BLOCKS_BUFFER) || (iPacketIndex < 0) || (iPacketIndex >= MAX_TOTAL_PACKETS_IN_BLOCK) )
-      return;
-   if ( NULL != m_VideoPackets[iBufferIndex][iPacketIndex].pRawData )
-      return;
-
-   u8* pRawData = (u8*)malloc(MAX_PACKET_TOTAL_SIZE);
-   if ( NULL == pRawData )
-   {
-      log_error_and_alarm("Failed to allocate video buffer at index: [%d/%d]", iPacketIndex, iBufferIndex);
-      return;
-   }
-   m_VideoPackets[iBufferIndex][iPacketIndex].pRawData = pRawData;
-   m_VideoPackets[iBufferIndex][iPacketIndex].pVideoData = pRawData + sizeof(t_packet_header) + sizeof(t_packet_header_video_segment);
-   m_VideoPackets[iBufferIndex][iPacketIndex].pPH = (t_packet_header*)pRawData;
-   m_VideoPackets[iBufferIndex][iPacketIndex].pPHVS = (t_packet_header_video_segment*)(pRawData + sizeof(t_packet_header));
-   m_VideoPackets[iBufferIndex][iPacketIndex].pPHVSImp = (t_packet_header_video_segment_important*)(pRawData + sizeof(t_packet_header) + sizeof(t_packet_header_video_segment));
-   m_VideoPackets[iBufferIndex][iPacketIndex].bEmpty = true;
-}
-
 void VideoTxPacketsBuffer::_fillVideoPacketHeaders(int iBufferIndex, int iPacketIndex, bool bIsECPacket, int iRawVideoDataSize, bool bIsLastPacket)
 {
-   m_VideoPackets[iBufferIndex][iPacketIndex].bEmpty = false;
+   m_uVideoPacketsFilledMask[iBufferIndex] |= ((u32)1) << iPacketIndex;
 
    //------------------------------------
    // Update packet header
@@ -649,15 +653,10 @@ int VideoTxPacketsBuffer::_addNewVideoPacket(u8* pRawVideoData, int iRawVideoDat
       return 0;
    int iCountPacketsAdded = 0;
 
-   _checkAllocatePacket(m_iNextBufferIndexToFill, m_iNextBufferPacketIndexToFill);
-
    // Started a new video block? Clear the block state
    if ( 0 == m_iNextBufferPacketIndexToFill )
    {
-      for(int i=0; i<(int)(m_PacketHeaderVideo.uCurrentBlockDataPackets + m_PacketHeaderVideo.uCurrentBlockECPackets); i++)
-         _checkAllocatePacket(m_iNextBufferIndexToFill, i);
-      for(int i=0; i<MAX_TOTAL_PACKETS_IN_BLOCK; i++)
-         m_VideoPackets[m_iNextBufferIndexToFill][i].bEmpty = true;
+      m_uVideoPacketsFilledMask[m_iNextBufferIndexToFill] = 0;
 
       m_PacketHeaderVideo.uCurrentBlockPacketSize = m_uNextBlockPacketSize;
       m_PacketHeaderVideo.uCurrentBlockDataPackets = m_uNextBlockDataPackets;
@@ -718,16 +717,10 @@ int VideoTxPacketsBuffer::_addNewVideoPacket(u8* pRawVideoData, int iRawVideoDat
       u8* p_fec_data_fecs[MAX_FECS_PACKETS_IN_BLOCK];
 
       for( int i=0; i<pCurrentVideoPacketHeader->uCurrentBlockDataPackets; i++ )
-      {
-         _checkAllocatePacket(m_iNextBufferIndexToFill, i);
          p_fec_data_packets[i] = m_VideoPackets[m_iNextBufferIndexToFill][i].pVideoData;
-      }
       int iECDelta = pCurrentVideoPacketHeader->uCurrentBlockDataPackets;
       for( int i=0; i<pCurrentVideoPacketHeader->uCurrentBlockECPackets; i++ )
-      {
-         _checkAllocatePacket(m_iNextBufferIndexToFill, i+iECDelta);
          p_fec_data_fecs[i] = m_VideoPackets[m_iNextBufferIndexToFill][i+iECDelta].pVideoData;
-      }
 
       u32 tTemp = get_current_timestamp_micros();
       fec_encode(pCurrentVideoPacketHeader->uCurrentBlockPacketSize, p_fec_data_packets, pCurrentVideoPacketHeader->uCurrentBlockDataPackets, p_fec_data_fecs, pCurrentVideoPacketHeader->uCurrentBlockECPackets);
@@ -775,17 +768,14 @@ int VideoTxPacketsBuffer::_addNewVideoPacket(u8* pRawVideoData, int iRawVideoDat
          iCountPacketsAdded = 0;
       }
 
-      for(int i=0; i<(int)(m_PacketHeaderVideo.uCurrentBlockDataPackets + m_PacketHeaderVideo.uCurrentBlockECPackets); i++)
-         _checkAllocatePacket(m_iNextBufferIndexToFill, i);
-      for(int i=0; i<MAX_TOTAL_PACKETS_IN_BLOCK; i++)
-         m_VideoPackets[m_iNextBufferIndexToFill][i].bEmpty = true;
+      m_uVideoPacketsFilledMask[m_iNextBufferIndexToFill] = 0;
    }
    return iCountPacketsAdded;
 }
 
 void VideoTxPacketsBuffer::_sendPacket(int iBufferIndex, int iPacketIndex, u32 uRetransmissionId, int iCountPacketsAferVideo)
 {
-   if ( m_VideoPackets[iBufferIndex][iPacketIndex].bEmpty )
+   if ( ! (m_uVideoPacketsFilledMask[iBufferIndex] & (((u32)1) << iPacketIndex)) )
       return;
 
    t_packet_header* pCurrentPacketHeader = m_VideoPackets[iBufferIndex][iPacketIndex].pPH;
@@ -859,16 +849,21 @@ void VideoTxPacketsBuffer::_sendPacket(int iBufferIndex, int iPacketIndex, u32 u
           (pPHVS->uVideoStatusFlags2 & VIDEO_STATUS_FLAGS2_IS_END_OF_FRAME)?1:0);
    */
 
-   u32 uTimeMicros = get_current_timestamp_micros();
-
-   if ( uTimeMicros > m_uLastTimeSentVideoPacketMicros )
-   if ( (uTimeMicros - m_uLastTimeSentVideoPacketMicros) < m_uLastSentVideoPacketDurationMicros)
+   // When batching, pacing is done per batch, on flush
+   bool bBatched = radio_tx_batch_is_active();
+   if ( ! bBatched )
    {
-      // Don't spam the driver with packets while it's sending a packet;
-      // Better yield that time to other processes.
-      hardware_sleep_micros(((m_uLastSentVideoPacketDurationMicros - (uTimeMicros - m_uLastTimeSentVideoPacketMicros))*3)/4 );
+      u32 uTimeMicros = get_current_timestamp_micros();
+
+      if ( uTimeMicros > m_uLastTimeSentVideoPacketMicros )
+      if ( (uTimeMicros - m_uLastTimeSentVideoPacketMicros) < m_uLastSentVideoPacketDurationMicros)
+      {
+         // Don't spam the driver with packets while it's sending a packet;
+         // Better yield that time to other processes.
+         hardware_sleep_micros(((m_uLastSentVideoPacketDurationMicros - (uTimeMicros - m_uLastTimeSentVideoPacketMicros))*3)/4 );
+      }
+      m_uLastTimeSentVideoPacketMicros = uTimeMicros;
    }
-   m_uLastTimeSentVideoPacketMicros = uTimeMicros;
 
    packet_utils_reset_last_used_video_datarate();
    send_packet_to_radio_interfaces((u8*)pCurrentPacketHeader, pCurrentPacketHeader->total_length, -1);
@@ -885,6 +880,8 @@ void VideoTxPacketsBuffer::_sendPacket(int iBufferIndex, int iPacketIndex, u32 u
 
    if ( 0 == uRetransmissionId )
       m_uExpectedFrameTransmissionTimeMicros += m_uLastSentVideoPacketDurationMicros;
+   if ( bBatched )
+      m_uTxBatchDurationMicros += m_uLastSentVideoPacketDurationMicros;
 
    static u32 s_uLastTimeCheckTxTimes = 0;
    static u32 s_uTotalTxTimeMicros = 0;
@@ -899,6 +896,28 @@ void VideoTxPacketsBuffer::_sendPacket(int iBufferIndex, int iPacketIndex, u32 u
    }
 }
 
+// Sends the queued video block(s) in one go, after the previous batch had time to get on air
+
+void VideoTxPacketsBuffer::_flushTxBatch()
+{
+   if ( 0 == m_uTxBatchDurationMicros )
+   {
+      radio_tx_batch_flush();
+      return;
+   }
+
+   u32 uTimeMicros = get_current_timestamp_micros();
+   if ( uTimeMicros > m_uLastTimeSentVideoPacketMicros )
+   if ( (uTimeMicros - m_uLastTimeSentVideoPacketMicros) < m_uLastTxBatchDurationMicros )
+      hardware_sleep_micros(((m_uLastTxBatchDurationMicros - (uTimeMicros - m_uLastTimeSentVideoPacketMicros))*3)/4 );
+   m_uLastTimeSentVideoPacketMicros = uTimeMicros;
+   m_uLastTxBatchDurationMicros = m_uTxBatchDurationMicros;
+   m_uLastSentVideoPacketDurationMicros = m_uTxBatchDurationMicros;
+   m_uTxBatchDurationMicros = 0;
+
+   radio_tx_batch_flush();
+}
+
 bool VideoTxPacketsBuffer::hasPendingPacketsToSend()
 {
    if ( m_iCurrentBufferIndexToSend == m_iNextBufferIndexToFill )
@@ -918,6 +937,10 @@ int VideoTxPacketsBuffer::sendAvailablePackets(int iCountPacketsAferVideo)
    if ( m_iCurrentBufferPacketIndexToSend == m_iNextBufferPacketIndexToFill )
       return 0;
 
+   // Queue each video block and hand it to the radio in one batch
+   radio_tx_batch_begin();
+   m_uTxBatchDurationMicros = 0;
+
    int iCountSent = 0;
    while ( true )
    {
@@ -928,7 +951,7 @@ int VideoTxPacketsBuffer::sendAvailablePackets(int iCountPacketsAferVideo)
       if ( NULL == m_VideoPackets[m_iCurrentBufferIndexToSend][m_iCurrentBufferPacketIndexToSend].pPH )
          log_softerror_and_alarm("Invalid packet [%d/%d], video next to gen: [%u/%u], header: %X", m_iCurrentBufferIndexToSend, m_iCurrentBufferPacketIndexToSend,
             m_uNextVideoBlockIndexToGenerate, m_uNextVideoBlockPacketIndexToGenerate, m_VideoPackets[m_iCurrentBufferIndexToSend][m_iCurrentBufferPacketIndexToSend].pPH);
-      else if ( m_VideoPackets[m_iCurrentBufferIndexToSend][m_iCurrentBufferPacketIndexToSend].bEmpty )
+      else if ( ! (m_uVideoPacketsFilledMask[m_iCurrentBufferIndexToSend] & (((u32)1) << m_iCurrentBufferPacketIndexToSend)) )
          log_softerror_and_alarm("Try to send empty packet [%d/%d], video next to gen: [%u/%u], ready to send: %d, header: %X", m_iCurrentBufferIndexToSend, m_iCurrentBufferPacketIndexToSend,
             m_uNextVideoBlockIndexToGenerate, m_uNextVideoBlockPacketIndexToGenerate, m_VideoPackets[m_iCurrentBufferIndexToSend][m_iCurrentBufferPacketIndexToSend].pPH);
       else
@@ -944,6 +967,7 @@ int VideoTxPacketsBuffer::sendAvailablePackets(int iCountPacketsAferVideo)
 
       if ( NULL == m_VideoPackets[m_iCurrentBufferIndexToSend][m_iCurrentBufferPacketIndexToSend].pPHVS )
       {
+         _flushTxBatch();
          m_iCurrentBufferPacketIndexToSend = 0;
          m_iCurrentBufferIndexToSend++;
          if ( m_iCurrentBufferIndexToSend >= MAX_RXTX_BLOCKS_BUFFER )
@@ -956,12 +980,15 @@ int VideoTxPacketsBuffer::sendAvailablePackets(int iCountPacketsAferVideo)
 
       if ( m_iCurrentBufferPacketIndexToSend >= pCurrentVideoPacketHeader->uCurrentBlockDataPackets + pCurrentVideoPacketHeader->uCurrentBlockECPackets )
       {
+         _flushTxBatch();
          m_iCurrentBufferPacketIndexToSend = 0;
          m_iCurrentBufferIndexToSend++;
          if ( m_iCurrentBufferIndexToSend >= MAX_RXTX_BLOCKS_BUFFER )
             m_iCurrentBufferIndexToSend = 0;
       }
    }
+   _flushTxBatch();
+   radio_tx_batch_end();
    return iCountSent;
 }
 
@@ -1000,6 +1027,11 @@ void VideoTxPacketsBuffer::resendVideoPacket(u32 uRetransmissionId, u32 uVideoBl
       log_softerror_and_alarm("[VideoTxBuffer] Recv request for retr for block index still out of range: %d ", iBufferIndex);
       return;
    }
+   if ( (uVideoBlockPacketIndex != 0xFF) && (uVideoBlockPacketIndex >= MAX_TOTAL_PACKETS_IN_BLOCK) )
+   {
+      log_softerror_and_alarm("[VideoTxBuffer] Recv request for retr of invalid video block packet index [%u/%u]", uVideoBlockIndex, uVideoBlockPacketIndex);
+      return;
+   }
    if ( (uVideoBlockPacketIndex != 0xFF) && (NULL == m_VideoPackets[iBufferIndex][uVideoBlockPacketIndex].pPH) )
    {
       log_softerror_and_alarm("[VideoTxBuffer] Recv request for retr of empty video block index [%u/%u]", uVideoBlockIndex, uVideoBlockPacketIndex);
@@ -1023,7 +1055,7 @@ void VideoTxPacketsBuffer::resendVideoPacket(u32 uRetransmissionId, u32 uVideoBl
    {
       for( u8 u=0; u<m_VideoPackets[iBufferIndex][0].pPHVS->uCurrentBlockDataPackets; u++ )
       {
-         if ( m_VideoPackets[iBufferIndex][u].bEmpty )
+         if ( ! (m_uVideoPacketsFilledMask[iBufferIndex] & (((u32)1) << u)) )
          {
             log_softerror_and_alarm("[VideoTxBuffer] Recv request for retr of full block [%u/%u], but buffer has empty video block [%u/%u] at that position (%d), next video packet to generate now is: [%u/%u]",
                uVideoBlockIndex, uVideoBlockPacketIndex, m_VideoPackets[iBufferIndex][u].pPHVS->uCurrentBlockIndex, m_VideoPackets[iBufferIndex][u].pPHVS->uCurrentBlockPacketIndex, iBufferIndex,
@@ -1035,7 +1067,7 @@ void VideoTxPacketsBuffer::resendVideoPacket(u32 uRetransmissionId, u32 uVideoBl
    }
    else
    {
-      if ( m_VideoPackets[iBufferIndex][uVideoBlockPacketIndex].bEmpty )
+      if ( ! (m_uVideoPacketsFilledMask[iBufferIndex] & (((u32)1) << uVideoBlockPacketIndex)) )
       {
          log_softerror_and_alarm("[VideoTxBuffer] Recv request for retr of empty video packet [%u/%u], buffer has video block [%u/%u] at that position (%d), next video packet to generate now is: [%u/%u]",
             uVideoBlockIndex, uVideoBlockPacketIndex, m_VideoPackets[iBufferIndex][uVideoBlockPacketIndex].pPHVS->uCurrentBlockIndex, m_VideoPackets[iBufferIndex][uVideoBlockPacketIndex].pPHVS->uCurrentBlockPacketIndex, iBufferIndex,
@@ -1076,7 +1108,7 @@ void VideoTxPacketsBuffer::resendVideoPacketsFromFrameEnd(u32 uRetransmissionId,
       if ( iBufferIndex < 0 )
          iBufferIndex += MAX_RXTX_BLOCKS_BUFFER;
 
-      if ( m_VideoPackets[iBufferIndex][0].bEmpty )
+      if ( ! (m_uVideoPacketsFilledMask[iBufferIndex] & 0x01) )
          break;
       if ( iBufferIndex == m_iNextBufferIndexToFill )
          break;
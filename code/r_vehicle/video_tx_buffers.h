@@ -4,6 +4,7 @@
 #include "../base/config.h"
 #include "../base/models.h"
 #include "../base/parser_h264.h"
+#include "../base/packets_slab.h"
 #include "../radio/radiopackets2.h"
 
 //  [packet header][video segment header][video seg header important][video data][0000  ][dbg]
@@ -12,14 +13,16 @@
 //                                       [     <- video block packet size   ->          ]
 //                                                                   [-vid size-]
 
+// Packets raw data is in the buffer slab: packet k of buffer block i is slot i*MAX_TOTAL_PACKETS_IN_BLOCK + k.
+// The pointers are set once, when the slab is allocated.
+
 typedef struct
 {
-   u8* pRawData;
+   u8* pRawData; // pointer inside the buffer slab
    u8* pVideoData; // pointer inside pRawData
    t_packet_header* pPH; // pointer inside pRawData
    t_packet_header_video_segment* pPHVS; // pointer inside pRawData
    t_packet_header_video_segment_important* pPHVSImp; // pointer inside pRawData
-   bool bEmpty;
 }
 type_tx_video_packet_info;
 
@@ -58,10 +61,10 @@ class VideoTxPacketsBuffer
 
    protected:
 
-      void _checkAllocatePacket(int iBufferIndex, int iPacketIndex);
       void _fillVideoPacketHeaders(int iBufferIndex, int iPacketIndex, bool bIsECPacket, int iRawVideoDataSize, bool bIsLastPacket);
       int _addNewVideoPacket(u8* pRawVideoData, int iRawVideoDataSize, int iRemainingVideoPackets, bool bIsLastPacket);
       void _sendPacket(int iBufferIndex, int iPacketIndex, u32 uRetransmissionId, int iCountPacketsAferVideo);
+      void _flushTxBatch();
       static int m_siVideoBuffersInstancesCount;
       bool m_bInitialized;
       bool m_bOverflowFlag;
@@ -99,13 +102,17 @@ class VideoTxPacketsBuffer
       int m_iTempVideoFrameBufferSize;
       int m_iTempVideoBufferFilledBytes;
       u32 m_uTempNALPresenceFlags;
+      t_packets_slab m_PacketsSlab;
       type_tx_video_packet_info m_VideoPackets[MAX_RXTX_BLOCKS_BUFFER][MAX_TOTAL_PACKETS_IN_BLOCK];
+      u32 m_uVideoPacketsFilledMask[MAX_RXTX_BLOCKS_BUFFER]; // bit k set: block packet k is filled in
 
       u32 m_uRadioStreamPacketIndex;
       u32 m_uExpectedFrameTransmissionTimeMicros;
 
       u32 m_uLastTimeSentVideoPacketMicros;
       u32 m_uLastSentVideoPacketDurationMicros;
+      u32 m_uTxBatchDurationMicros; // air time of the packets queued in the current tx batch
+      u32 m_uLastTxBatchDurationMicros;
       u32 m_uLastSentVideoPacketDatarateBPS;
       u32 m_uLastSentVideoPacketDatarateMinBPS;
       u32 m_uLastSentVideoPacketDatarateMaxBPS;
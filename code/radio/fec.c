@@ -212,6 +212,13 @@ __attribute__((aligned (256)))
 
 #define gf_mul(x,y) gf_mul_table[(x<<8)+y]
 
+/*
+ * Split-nibble tables used by the vector kernels:
+ * gf_mul_lo[c][i] = c * i, gf_mul_hi[c][i] = c * (i << 4)
+ */
+static gf gf_mul_lo[GF_SIZE + 1][16] __attribute__((aligned (16)));
+static gf gf_mul_hi[GF_SIZE + 1][16] __attribute__((aligned (16)));
+
 #define USE_GF_MULC register gf * __gf_mulc_
 #define GF_MULC0(c) __gf_mulc_ = &gf_mul_table[(c)<<8]
 #define GF_ADDMULC(dst, x) dst ^= __gf_mulc_[x]
@@ -227,6 +234,12 @@ init_mul_table(void)
 
     for (j=0; j< GF_SIZE+1; j++)
 	gf_mul_table[j] = gf_mul_table[j<<8] = 0;
+
+    for (i=0; i< GF_SIZE+1; i++)
+	for (j=0; j< 16; j++) {
+	    gf_mul_lo[i][j] = gf_mul(i, j);
+	    gf_mul_hi[i][j] = gf_mul(i, (j<<4));
+	}
 }
 
 /*
@@ -367,78 +380,6 @@ slow_addmul1(gf *dst1, gf *src1, gf c, int sz)
 	GF_ADDMULC( *dst , *src );
 }
 
-#if defined i386 && defined USE_ASSEMBLER
-
-#define LOOPSIZE 8
-
-static void
-addmul1(gf *dst1, gf *src1, gf c, int sz)
-{
-    USE_GF_MULC ;
-
-    GF_MULC0(c) ;
-
-    if(((unsigned long)dst1 % LOOPSIZE) || 
-       ((unsigned long)src1 % LOOPSIZE) || 
-       (sz % LOOPSIZE)) {
-	slow_addmul1(dst1, src1, c, sz);
-	return;
-    }
-
-    asm volatile("xorl %%eax,%%eax;\n"
-		 "	xorl %%edx,%%edx;\n"
-		 ".align 32;\n"
-		 "1:"
-		 "	addl  $8, %%edi;\n"
-		 
-		 "	movb  (%%esi), %%al;\n"
-		 "	movb 4(%%esi), %%dl;\n"
-		 "	movb  (%%ebx,%%eax), %%al;\n"
-		 "	movb  (%%ebx,%%edx), %%dl;\n"
-		 "	xorb  %%al,  (%%edi);\n"
-		 "	xorb  %%dl, 4(%%edi);\n"
-		 
-		 "	movb 1(%%esi), %%al;\n"
-		 "	movb 5(%%esi), %%dl;\n"
-		 "	movb  (%%ebx,%%eax), %%al;\n"
-		 "	movb  (%%ebx,%%edx), %%dl;\n"
-		 "	xorb  %%al, 1(%%edi);\n"
-		 "	xorb  %%dl, 5(%%edi);\n"
-		 
-		 "	movb 2(%%esi), %%al;\n"
-		 "	movb 6(%%esi), %%dl;\n"
-		 "	movb  (%%ebx,%%eax), %%al;\n"
-		 "	movb  (%%ebx,%%edx), %%dl;\n"
-		 "	xorb  %%al, 2(%%edi);\n"
-		 "	xorb  %%dl, 6(%%edi);\n"
-		 
-		 "	movb 3(%%esi), %%al;\n"
-		 "	movb 7(%%esi), %%dl;\n"
-		 "	addl  $8, %%esi;\n"
-		 "	movb  (%%ebx,%%eax), %%al;\n"
-		 "	movb  (%%ebx,%%edx), %%dl;\n"
-		 "	xorb  %%al, 3(%%edi);\n"
-		 "	xorb  %%dl, 7(%%edi);\n"
-		 
-		 "	cmpl  %%ecx, %%esi;\n"
-		 "	jb 1b;"
-		 : : 
-		 
-		 "b" (__gf_mulc_),
-		 "D" (dst1-8),
-		 "S" (src1),
-		 "c" (sz+src1) :
-		 "memory", "eax", "edx"
-	);
-}
-#else
-# define addmul1 slow_addmul1
-#endif
-
-static void addmul(gf *dst, gf *src, gf c, int sz) {
-    // fprintf(stderr, "Dst=%p Src=%p, gf=%02x sz=%d\n", dst, src, c, sz);
-    if (c != 0) addmul1(dst, src, c, sz);
-}
 
 /*
  * mul() computes dst[] = c * src[]
@@ -493,74 +434,143 @@ slow_mul1(gf *dst1, gf *src1, gf c, int sz)
 	GF_MULC( *dst , *src );
 }
 
-#if defined i386 && defined USE_ASSEMBLER
+/*
+ * Vector kernels, using the split-nibble multiplication:
+ *    c * x = (c * (x & 0x0f)) ^ (c * (x & 0xf0))
+ * Each half is a 16 entries lookup, done for 16 bytes at once with
+ * pshufb (SSSE3) or vtbl/tbl (NEON). Tails shorter than 16 bytes go
+ * through the scalar table code above.
+ */
+#define SIMD_BLOCK 16
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FEC_HAS_SSSE3 1
+
+__attribute__((target("ssse3")))
 static void
-mul1(gf *dst1, gf *src1, gf c, int sz)
+ssse3_addmul1(gf *dst, gf *src, gf c, int sz)
 {
-    USE_GF_MULC ;
+    const __m128i tlo = _mm_load_si128((const __m128i*)gf_mul_lo[c]);
+    const __m128i thi = _mm_load_si128((const __m128i*)gf_mul_hi[c]);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    int i = 0;
+
+    for (; i + SIMD_BLOCK <= sz; i += SIMD_BLOCK) {
+	__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+	__m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+	__m128i l = _mm_shuffle_epi8(tlo, _mm_and_si128(s, mask));
+	__m128i h = _mm_shuffle_epi8(thi, _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+	_mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(d, _mm_xor_si128(l, h)));
+    }
+    if (i < sz)
+	slow_addmul1(dst + i, src + i, c, sz - i);
+}
 
-    GF_MULC0(c) ;
+__attribute__((target("ssse3")))
+static void
+ssse3_mul1(gf *dst, gf *src, gf c, int sz)
+{
+    const __m128i tlo = _mm_load_si128((const __m128i*)gf_mul_lo[c]);
+    const __m128i thi = _mm_load_si128((const __m128i*)gf_mul_hi[c]);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    int i = 0;
+
+    for (; i + SIMD_BLOCK <= sz; i += SIMD_BLOCK) {
+	__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+	__m128i l = _mm_shuffle_epi8(tlo, _mm_and_si128(s, mask));
+	__m128i h = _mm_shuffle_epi8(thi, _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+	_mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(l, h));
+    }
+    if (i < sz)
+	slow_mul1(dst + i, src + i, c, sz - i);
+}
+#endif
 
-    if(((unsigned long)dst1 % LOOPSIZE) || 
-       ((unsigned long)src1 % LOOPSIZE) || 
-       (sz % LOOPSIZE)) {
-	slow_mul1(dst1, src1, c, sz);
-	return;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FEC_HAS_NEON 1
+
+static inline uint8x16_t
+neon_gf_mul16(uint8x16_t tlo, uint8x16_t thi, uint8x16_t s)
+{
+    uint8x16_t ilo = vandq_u8(s, vdupq_n_u8(0x0f));
+    uint8x16_t ihi = vshrq_n_u8(s, 4);
+#if defined(__aarch64__)
+    return veorq_u8(vqtbl1q_u8(tlo, ilo), vqtbl1q_u8(thi, ihi));
+#else
+    uint8x8x2_t lo2 = { { vget_low_u8(tlo), vget_high_u8(tlo) } };
+    uint8x8x2_t hi2 = { { vget_low_u8(thi), vget_high_u8(thi) } };
+    uint8x8_t rl = veor_u8(vtbl2_u8(lo2, vget_low_u8(ilo)), vtbl2_u8(hi2, vget_low_u8(ihi)));
+    uint8x8_t rh = veor_u8(vtbl2_u8(lo2, vget_high_u8(ilo)), vtbl2_u8(hi2, vget_high_u8(ihi)));
+    return vcombine_u8(rl, rh);
+#endif
+}
+
+static void
+neon_addmul1(gf *dst, gf *src, gf c, int sz)
+{
+    const uint8x16_t tlo = vld1q_u8(gf_mul_lo[c]);
+    const uint8x16_t thi = vld1q_u8(gf_mul_hi[c]);
+    int i = 0;
+
+    for (; i + SIMD_BLOCK <= sz; i += SIMD_BLOCK) {
+	uint8x16_t p = neon_gf_mul16(tlo, thi, vld1q_u8(src + i));
+	vst1q_u8(dst + i, veorq_u8(vld1q_u8(dst + i), p));
     }
+    if (i < sz)
+	slow_addmul1(dst + i, src + i, c, sz - i);
+}
 
-    asm volatile("pushl %%eax;\n"
-		 "pushl %%edx;\n"
-		 "xorl %%eax,%%eax;\n"
-		 "	xorl %%edx,%%edx;\n"
-		 "1:"
-		 "	addl  $8, %%edi;\n"
-		 
-		 "	movb  (%%esi), %%al;\n"
-		 "	movb 4(%%esi), %%dl;\n"
-		 "	movb  (%%ebx,%%eax), %%al;\n"
-		 "	movb  (%%ebx,%%edx), %%dl;\n"
-		 "	movb  %%al,  (%%edi);\n"
-		 "	movb  %%dl, 4(%%edi);\n"
-		 
-		 "	movb 1(%%esi), %%al;\n"
-		 "	movb 5(%%esi), %%dl;\n"
-		 "	movb  (%%ebx,%%eax), %%al;\n"
-		 "	movb  (%%ebx,%%edx), %%dl;\n"
-		 "	movb  %%al, 1(%%edi);\n"
-		 "	movb  %%dl, 5(%%edi);\n"
-		 
-		 "	movb 2(%%esi), %%al;\n"
-		 "	movb 6(%%esi), %%dl;\n"
-		 "	movb  (%%ebx,%%eax), %%al;\n"
-		 "	movb  (%%ebx,%%edx), %%dl;\n"
-		 "	movb  %%al, 2(%%edi);\n"
-		 "	movb  %%dl, 6(%%edi);\n"
-		 
-		 "	movb 3(%%esi), %%al;\n"
-		 "	movb 7(%%esi), %%dl;\n"
-		 "	addl  $8, %%esi;\n"
-		 "	movb  (%%ebx,%%eax), %%al;\n"
-		 "	movb  (%%ebx,%%edx), %%dl;\n"
-		 "	movb  %%al, 3(%%edi);\n"
-		 "	movb  %%dl, 7(%%edi);\n"
-		 
-		 "	cmpl  %%ecx, %%esi;\n"
-		 "	jb 1b;\n"
-		 "	popl %%edx;\n"
-		 "	popl %%eax;"
-		 : : 
-		 
-		 "b" (__gf_mulc_),
-		 "D" (dst1-8),
-		 "S" (src1),
-		 "c" (sz+src1) :
-		 "memory", "eax", "edx"
-	);
+static void
+neon_mul1(gf *dst, gf *src, gf c, int sz)
+{
+    const uint8x16_t tlo = vld1q_u8(gf_mul_lo[c]);
+    const uint8x16_t thi = vld1q_u8(gf_mul_hi[c]);
+    int i = 0;
+
+    for (; i + SIMD_BLOCK <= sz; i += SIMD_BLOCK)
+	vst1q_u8(dst + i, neon_gf_mul16(tlo, thi, vld1q_u8(src + i)));
+    if (i < sz)
+	slow_mul1(dst + i, src + i, c, sz - i);
 }
-#else
-# define mul1 slow_mul1
 #endif
 
+/*
+ * Kernels in use, selected at init time by select_kernels()
+ */
+static void (*addmul1)(gf *dst1, gf *src1, gf c, int sz) = slow_addmul1;
+static void (*mul1)(gf *dst1, gf *src1, gf c, int sz) = slow_mul1;
+static const char *s_szKernelsName = "scalar";
+
+static void
+select_kernels(int iUseSIMD)
+{
+    addmul1 = slow_addmul1;
+    mul1 = slow_mul1;
+    s_szKernelsName = "scalar";
+    if (!iUseSIMD)
+	return;
+#if defined(FEC_HAS_SSSE3)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) {
+	addmul1 = ssse3_addmul1;
+	mul1 = ssse3_mul1;
+	s_szKernelsName = "ssse3";
+    }
+#elif defined(FEC_HAS_NEON)
+    addmul1 = neon_addmul1;
+    mul1 = neon_mul1;
+    s_szKernelsName = "neon";
+#endif
+}
+
+static void addmul(gf *dst, gf *src, gf c, int sz) {
+    // fprintf(stderr, "Dst=%p Src=%p, gf=%02x sz=%d\n", dst, src, c, sz);
+    if (c != 0) addmul1(dst, src, c, sz);
+}
+
+
 static inline void mul(gf *dst, gf *src, gf c, int sz) {
     /*fprintf(stderr, "%p = %02x * %p\n", dst, c, src);*/
     if (c != 0) mul1(dst, src, c, sz); else memset(dst, 0, sz);
@@ -706,9 +716,24 @@ void fec_init(void)
     init_mul_table();
     TOCK(ticks[0]);
     DDB(fprintf(stderr, "init_mul_table took %ldus\n", ticks[0]);)
+    select_kernels(1);
    	fec_initialized = 1 ;
 }
 
+void fec_set_use_simd(int iUseSIMD)
+{
+    if ( 0 == fec_initialized )
+       fec_init();
+    select_kernels(iUseSIMD);
+}
+
+const char* fec_get_kernels_name(void)
+{
+    if ( 0 == fec_initialized )
+       fec_init();
+    return s_szKernelsName;
+}
+
 
 /**
  * Simplified re-implementation of Fec-Bourbon
@@ -871,22 +896,80 @@ static inline void reduce(unsigned int blockSize,
        s_iAssertion = -2;
 }
 
-/**
- * Resolves reduced system. Constructs "mini" encoding matrix, inverts
- * it, and multiply reduced vector by it.
+/*
+ * Small LRU cache of inverted decode matrices. On a real link the same few
+ * erasure patterns (which FEC blocks are present, which data blocks are
+ * missing) repeat all the time, so the matrix inversion is done only once
+ * per pattern and recovery only costs the multiply-accumulate.
  */
-static inline void resolve(int blockSize,
-			   unsigned char **data_blocks,
-			   unsigned char **fec_blocks,
-			   unsigned int *fec_block_nos,
-			   unsigned int *erased_blocks,
-			   short nr_fec_blocks)
+#define DECODE_CACHE_ENTRIES 16
+#define DECODE_CACHE_MAX_K 32
+
+typedef struct {
+    int k;			/* 0: unused entry */
+    unsigned int uHash;
+    unsigned int uLastUsed;
+    unsigned char fec_nos[DECODE_CACHE_MAX_K];
+    unsigned char erased[DECODE_CACHE_MAX_K];
+    gf matrix[DECODE_CACHE_MAX_K*DECODE_CACHE_MAX_K];
+} decode_cache_entry;
+
+static decode_cache_entry s_DecodeCache[DECODE_CACHE_ENTRIES];
+static unsigned int s_uDecodeCacheUseCounter = 0;
+static unsigned int s_uDecodeCacheHits = 0;
+static unsigned int s_uDecodeCacheMisses = 0;
+
+static unsigned int
+decode_cache_hash(unsigned int *fec_block_nos, unsigned int *erased_blocks, int k)
 {
-    /* construct matrix */
-    int row;
-    unsigned char matrix[nr_fec_blocks*nr_fec_blocks];
-    int ptr;
-    int r;
+    unsigned int uHash = 2166136261u ^ (unsigned int)k;
+    int i;
+    for (i = 0; i < k; i++) {
+	uHash = (uHash ^ (fec_block_nos[i] & 0xFF)) * 16777619u;
+	uHash = (uHash ^ (erased_blocks[i] & 0xFF)) * 16777619u;
+    }
+    return uHash;
+}
+
+static decode_cache_entry *
+decode_cache_find(unsigned int uHash, unsigned int *fec_block_nos, unsigned int *erased_blocks, int k)
+{
+    int i, j;
+    for (i = 0; i < DECODE_CACHE_ENTRIES; i++) {
+	decode_cache_entry *e = &s_DecodeCache[i];
+	if (e->k != k || e->uHash != uHash)
+	    continue;
+	for (j = 0; j < k; j++)
+	    if (e->fec_nos[j] != fec_block_nos[j] || e->erased[j] != erased_blocks[j])
+		break;
+	if (j == k)
+	    return e;
+    }
+    return NULL;
+}
+
+static decode_cache_entry *
+decode_cache_get_lru(void)
+{
+    decode_cache_entry *lru = &s_DecodeCache[0];
+    int i;
+    for (i = 0; i < DECODE_CACHE_ENTRIES; i++) {
+	if (s_DecodeCache[i].k == 0)
+	    return &s_DecodeCache[i];
+	if (s_DecodeCache[i].uLastUsed < lru->uLastUsed)
+	    lru = &s_DecodeCache[i];
+    }
+    return lru;
+}
+
+/* Builds the decode matrix for the given pattern and inverts it in place */
+static int
+build_decode_matrix(gf *matrix,
+		    unsigned int *fec_block_nos,
+		    unsigned int *erased_blocks,
+		    int nr_fec_blocks)
+{
+    int row, ptr;
 
     /* we pick the submatrix of code that keeps colums corresponding to
      * the erased data blocks, and rows corresponding to the present FEC
@@ -902,10 +985,53 @@ static inline void resolve(int blockSize,
 	}
     }
 
-    r=invert_mat(matrix, nr_fec_blocks);
+    return invert_mat(matrix, nr_fec_blocks);
+}
 
-    if(r)
-	      s_iAssertion = -1;
+/**
+ * Resolves reduced system. Constructs "mini" encoding matrix, inverts
+ * it (or gets it from the cache), and multiply reduced vector by it.
+ */
+static inline void resolve(int blockSize,
+			   unsigned char **data_blocks,
+			   unsigned char **fec_blocks,
+			   unsigned int *fec_block_nos,
+			   unsigned int *erased_blocks,
+			   short nr_fec_blocks)
+{
+    int row;
+    unsigned char tmp_matrix[nr_fec_blocks*nr_fec_blocks];
+    gf *matrix = tmp_matrix;
+    int ptr;
+
+    if (nr_fec_blocks > 0 && nr_fec_blocks <= DECODE_CACHE_MAX_K) {
+	unsigned int uHash = decode_cache_hash(fec_block_nos, erased_blocks, nr_fec_blocks);
+	decode_cache_entry *e = decode_cache_find(uHash, fec_block_nos, erased_blocks, nr_fec_blocks);
+	if (e) {
+	    s_uDecodeCacheHits++;
+	} else {
+	    s_uDecodeCacheMisses++;
+	    /* build into the local matrix first, so a failed inversion does
+	     * not evict a good cached entry */
+	    if (build_decode_matrix(matrix, fec_block_nos, erased_blocks, nr_fec_blocks)) {
+		s_iAssertion = -1;
+	    } else {
+		e = decode_cache_get_lru();
+		memcpy(e->matrix, matrix, nr_fec_blocks*nr_fec_blocks);
+		e->k = nr_fec_blocks;
+		e->uHash = uHash;
+		for (row = 0; row < nr_fec_blocks; row++) {
+		    e->fec_nos[row] = (unsigned char)fec_block_nos[row];
+		    e->erased[row] = (unsigned char)erased_blocks[row];
+		}
+	    }
+	}
+	if (e) {
+	    e->uLastUsed = ++s_uDecodeCacheUseCounter;
+	    matrix = e->matrix;
+	}
+    } else if (build_decode_matrix(matrix, fec_block_nos, erased_blocks, nr_fec_blocks))
+	s_iAssertion = -1;
 
     /* do the multiplication with the reduced code vector */
     for(row = 0, ptr=0; row < nr_fec_blocks; row++) {
@@ -918,6 +1044,14 @@ static inline void resolve(int blockSize,
     }
 }
 
+void fec_get_decode_cache_stats(unsigned int *puHits, unsigned int *puMisses)
+{
+    if (puHits)
+	*puHits = s_uDecodeCacheHits;
+    if (puMisses)
+	*puMisses = s_uDecodeCacheMisses;
+}
+
 int fec_decode(unsigned int blockSize,
 		unsigned char **data_blocks,
 		unsigned int nr_data_blocks,
@@ -28,6 +28,20 @@ int fec_decode(unsigned int blockSize,
 
 void fec_print(fec_code_t code, int width);
 
+/*
+ * Selects the GF(256) multiply kernels used by fec_encode/fec_decode:
+ * 1 = fastest vector kernels supported by this CPU (SSSE3/NEON), 0 = scalar tables.
+ * fec_init() selects the vector kernels by default.
+ */
+void fec_set_use_simd(int iUseSIMD);
+const char* fec_get_kernels_name(void);
+
+/*
+ * fec_decode keeps a small LRU cache of inverted decode matrices, keyed by
+ * the erasure pattern. Returns the total cache hits/misses since start.
+ */
+void fec_get_decode_cache_stats(unsigned int *puHits, unsigned int *puMisses);
+
 void fec_license(void);
 #ifdef __cplusplus
 }
@@ -39,15 +39,21 @@
 #include "radiolink.h"
 
 
-#define PACKETS_INDEX_HASH_SIZE 512
-#define PACKETS_INDEX_HASH_MASK 0x01FF
+// Received packets are tracked with a sliding bitmap window per stream, ending at the max received packet index.
+// Packets older than the window are not considered duplicates.
+#define PACKETS_INDEX_WINDOW_BITS 1024
+#define PACKETS_INDEX_WINDOW_WORDS (PACKETS_INDEX_WINDOW_BITS/32)
+
+// Vehicle id to vehicle slot lookup (open addressing, entries are verified against the vehicles list)
+#define VEHICLES_SLOTS_HASH_SIZE 16
+#define VEHICLES_SLOTS_HASH_MASK 0x0F
 
 typedef struct
 {
    u32 uMaxReceivedPacketIndex;
-   u32 uLastReceivedPacketIndex;
+   u32 uLastReceivedPacketIndex; // MAX_U32 if nothing received yet
    u32 uLastTimeReceivedPacket;
-   u32 packetsHashIndexes[PACKETS_INDEX_HASH_SIZE];
+   u32 uReceivedWindow[PACKETS_INDEX_WINDOW_WORDS];
 } ALIGN_STRUCT_SPEC_INFO t_stream_history_packets_indexes;
 
 typedef struct
@@ -59,6 +65,10 @@ typedef struct
 
 t_vehicle_history_packets_indexes s_ListHistoryRxPacketsVehicles[MAX_CONCURENT_VEHICLES];
 
+u32 s_uDupDetectionVehiclesHashIds[VEHICLES_SLOTS_HASH_SIZE];
+int s_iDupDetectionVehiclesHashSlots[VEHICLES_SLOTS_HASH_SIZE];
+int s_iDupDetectionLastVehicleSlot = 0;
+
 extern u32 s_uRadioRxTimeNow;
 
 shared_mem_radio_stats* s_pSMRadioStatsDuplicateDetection = NULL;
@@ -78,13 +88,109 @@ void _radio_dd_reset_duplication_stats_for_vehicle(int iVehicleIndex, int iReaso
       s_ListHistoryRxPacketsVehicles[iVehicleIndex].streamsPacketsHistory[k].uMaxReceivedPacketIndex = 0;
       s_ListHistoryRxPacketsVehicles[iVehicleIndex].streamsPacketsHistory[k].uLastReceivedPacketIndex = MAX_U32;
       s_ListHistoryRxPacketsVehicles[iVehicleIndex].streamsPacketsHistory[k].uLastTimeReceivedPacket = 0;
-      memset((u8*)s_ListHistoryRxPacketsVehicles[iVehicleIndex].streamsPacketsHistory[k].packetsHashIndexes, 0xFF, PACKETS_INDEX_HASH_SIZE * sizeof(u32));
+      memset((u8*)s_ListHistoryRxPacketsVehicles[iVehicleIndex].streamsPacketsHistory[k].uReceivedWindow, 0, PACKETS_INDEX_WINDOW_WORDS * sizeof(u32));
    }
 }
 
+static int _radio_dd_window_is_received(t_stream_history_packets_indexes* pStream, u32 uPacketIndex)
+{
+   if ( MAX_U32 == pStream->uLastReceivedPacketIndex )
+      return 0;
+   if ( uPacketIndex > pStream->uMaxReceivedPacketIndex )
+      return 0;
+   if ( pStream->uMaxReceivedPacketIndex - uPacketIndex >= PACKETS_INDEX_WINDOW_BITS )
+      return 0;
+   u32 uBit = uPacketIndex & (PACKETS_INDEX_WINDOW_BITS-1);
+   return (pStream->uReceivedWindow[uBit >> 5] >> (uBit & 0x1F)) & 0x01;
+}
+
+// Must be called before updating the stream max received packet index
+static void _radio_dd_window_set_received(t_stream_history_packets_indexes* pStream, u32 uPacketIndex)
+{
+   if ( MAX_U32 == pStream->uLastReceivedPacketIndex )
+      memset((u8*)pStream->uReceivedWindow, 0, sizeof(pStream->uReceivedWindow));
+   else if ( uPacketIndex > pStream->uMaxReceivedPacketIndex )
+   {
+      // Slide the window: clear the bits of the skipped (not yet received) packets
+      u32 uDelta = uPacketIndex - pStream->uMaxReceivedPacketIndex;
+      if ( uDelta >= PACKETS_INDEX_WINDOW_BITS )
+         memset((u8*)pStream->uReceivedWindow, 0, sizeof(pStream->uReceivedWindow));
+      else
+      {
+         for( u32 u=pStream->uMaxReceivedPacketIndex+1; u<uPacketIndex; u++ )
+         {
+            u32 uBit = u & (PACKETS_INDEX_WINDOW_BITS-1);
+            pStream->uReceivedWindow[uBit >> 5] &= ~(((u32)1) << (uBit & 0x1F));
+         }
+      }
+   }
+   else if ( pStream->uMaxReceivedPacketIndex - uPacketIndex >= PACKETS_INDEX_WINDOW_BITS )
+      return;
+
+   u32 uBit = uPacketIndex & (PACKETS_INDEX_WINDOW_BITS-1);
+   pStream->uReceivedWindow[uBit >> 5] |= ((u32)1) << (uBit & 0x1F);
+}
+
+static int _radio_dd_find_vehicle_slot(u32 uVehicleId)
+{
+   if ( (s_iDupDetectionLastVehicleSlot >= 0) && (s_ListHistoryRxPacketsVehicles[s_iDupDetectionLastVehicleSlot].uVehicleId == uVehicleId) )
+      return s_iDupDetectionLastVehicleSlot;
+
+   u32 uHash = (uVehicleId * 2654435761u) >> 28;
+   for( int i=0; i<VEHICLES_SLOTS_HASH_SIZE; i++ )
+   {
+      int iPos = (uHash + i) & VEHICLES_SLOTS_HASH_MASK;
+      if ( s_iDupDetectionVehiclesHashSlots[iPos] < 0 )
+         break;
+      if ( s_uDupDetectionVehiclesHashIds[iPos] != uVehicleId )
+         continue;
+      int iSlot = s_iDupDetectionVehiclesHashSlots[iPos];
+      if ( s_ListHistoryRxPacketsVehicles[iSlot].uVehicleId == uVehicleId )
+      {
+         s_iDupDetectionLastVehicleSlot = iSlot;
+         return iSlot;
+      }
+   }
+
+   // Not in hash or stale entry: look it up in the list and rebuild the hash
+   int iSlot = -1;
+   for( int i=0; i<MAX_CONCURENT_VEHICLES; i++ )
+   {
+      if ( uVehicleId == s_ListHistoryRxPacketsVehicles[i].uVehicleId )
+      {
+         iSlot = i;
+         break;
+      }
+   }
+   if ( -1 == iSlot )
+      return -1;
+
+   for( int i=0; i<VEHICLES_SLOTS_HASH_SIZE; i++ )
+      s_iDupDetectionVehiclesHashSlots[i] = -1;
+   for( int k=0; k<MAX_CONCURENT_VEHICLES; k++ )
+   {
+      if ( 0 == s_ListHistoryRxPacketsVehicles[k].uVehicleId )
+         continue;
+      u32 uHashK = (s_ListHistoryRxPacketsVehicles[k].uVehicleId * 2654435761u) >> 28;
+      for( int i=0; i<VEHICLES_SLOTS_HASH_SIZE; i++ )
+      {
+         int iPos = (uHashK + i) & VEHICLES_SLOTS_HASH_MASK;
+         if ( s_iDupDetectionVehiclesHashSlots[iPos] >= 0 )
+            continue;
+         s_uDupDetectionVehiclesHashIds[iPos] = s_ListHistoryRxPacketsVehicles[k].uVehicleId;
+         s_iDupDetectionVehiclesHashSlots[iPos] = k;
+         break;
+      }
+   }
+   s_iDupDetectionLastVehicleSlot = iSlot;
+   return iSlot;
+}
+
 
 void radio_duplicate_detection_init()
 {
+   for( int i=0; i<VEHICLES_SLOTS_HASH_SIZE; i++ )
+      s_iDupDetectionVehiclesHashSlots[i] = -1;
    for( int i=0; i<MAX_CONCURENT_VEHICLES; i++ )
       _radio_dd_reset_duplication_stats_for_vehicle(i, 0);
 }
@@ -113,16 +219,7 @@ void radio_duplicate_detection_log_info()
 
 int _radio_dup_detection_get_runtime_index_for_vid(u32 uVehicleId, u8* pPacketBuffer, int iPacketLength)
 {
-   int iStatsIndex = -1;
-
-   for( int i=0; i<MAX_CONCURENT_VEHICLES; i++ )
-   {
-      if ( uVehicleId == s_ListHistoryRxPacketsVehicles[i].uVehicleId )
-      {
-         iStatsIndex = i;
-         break;
-      }
-   }
+   int iStatsIndex = _radio_dd_find_vehicle_slot(uVehicleId);
    if ( iStatsIndex != -1 )
       return iStatsIndex;
 
@@ -198,22 +295,14 @@ int _radio_dup_detection_get_runtime_index_for_vid(u32 uVehicleId, u8* pPacketBu
 
 // return 1 if packet is duplicate, 0 if it's not duplicate
 
-int radio_dup_detection_is_duplicate_on_stream(int iRadioInterfaceIndex, u8* pPacketBuffer, int iPacketLength, u32 uTimeNow)
+static int _radio_dup_detection_check_packet(int iRadioInterfaceIndex, int iStatsIndex, u8* pPacketBuffer, u32 uTimeNow, u32 uMaxDeltaForDataStream)
 {
-   if ( (NULL == pPacketBuffer) || (iPacketLength <= 0) )
-      return 1;
-
    t_packet_header* pPH = (t_packet_header*)pPacketBuffer;
    
    u32 uVehicleId = pPH->vehicle_id_src;
    u32 uStreamPacketIndex = (pPH->stream_packet_idx) & PACKET_FLAGS_MASK_STREAM_PACKET_IDX;
    u32 uStreamIndex = (pPH->stream_packet_idx)>>PACKET_FLAGS_MASK_SHIFT_STREAM_INDEX; 
    u8 uPacketType = pPH->packet_type;   
-   int iStatsIndex = -1;
-
-   iStatsIndex = _radio_dup_detection_get_runtime_index_for_vid(uVehicleId, pPacketBuffer, iPacketLength);
-   if ( -1 == iStatsIndex )
-      return 1;
 
    t_vehicle_history_packets_indexes* pDupInfo = &s_ListHistoryRxPacketsVehicles[iStatsIndex];
    pDupInfo->uVehicleId = uVehicleId;
@@ -221,9 +310,16 @@ int radio_dup_detection_is_duplicate_on_stream(int iRadioInterfaceIndex, u8* pPa
    static u32 s_TimeLastLogAlarmStreamPacketsVariation = 0;
 
    u32 uMaxDeltaForVideoStream = 2000;
-   u32 uMaxDeltaForDataStream = 50;
-   if ( hardware_radio_index_is_serial_radio(iRadioInterfaceIndex) )
-      uMaxDeltaForDataStream = 200;
+   int bIsDataStream = ((uStreamIndex != STREAM_ID_AUDIO) && (uStreamIndex < STREAM_ID_VIDEO_1))?1:0;
+
+   // Fast path: copies of a packet already received on another radio interface.
+   // Only for packets that can't be part of a stream restart (checked below).
+   t_stream_history_packets_indexes* pStream = &pDupInfo->streamsPacketsHistory[uStreamIndex];
+   if ( (uPacketType != PACKET_TYPE_RUBY_PING_CLOCK) && (uPacketType != PACKET_TYPE_RUBY_PING_CLOCK_REPLY) )
+   if ( _radio_dd_window_is_received(pStream, uStreamPacketIndex) )
+   if ( pStream->uMaxReceivedPacketIndex - uStreamPacketIndex <= (bIsDataStream?uMaxDeltaForDataStream:uMaxDeltaForVideoStream) )
+   if ( uTimeNow - pStream->uLastTimeReceivedPacket < 8000 )
+      return 1;
 
    if ( (uStreamIndex != STREAM_ID_AUDIO) && (uStreamIndex < STREAM_ID_VIDEO_1) )
    if ((pDupInfo->streamsPacketsHistory[uStreamIndex].uMaxReceivedPacketIndex > uMaxDeltaForDataStream ) && 
@@ -292,10 +388,7 @@ int radio_dup_detection_is_duplicate_on_stream(int iRadioInterfaceIndex, u8* pPa
    // ---------------------------------------------------
    // Check for packet duplication on stream for vehicle
 
-   int bIsDuplicatePacket = 0;
-   int iHashIndex = uStreamPacketIndex & PACKETS_INDEX_HASH_MASK;
-   if ( uStreamPacketIndex == pDupInfo->streamsPacketsHistory[uStreamIndex].packetsHashIndexes[iHashIndex] )
-      bIsDuplicatePacket = 1;
+   int bIsDuplicatePacket = _radio_dd_window_is_received(pStream, uStreamPacketIndex);
 
    if ( (uPacketType == PACKET_TYPE_RUBY_PING_CLOCK) || (uPacketType == PACKET_TYPE_RUBY_PING_CLOCK_REPLY) )
       bIsDuplicatePacket = 0;
@@ -303,8 +396,7 @@ int radio_dup_detection_is_duplicate_on_stream(int iRadioInterfaceIndex, u8* pPa
    if ( bIsDuplicatePacket )
       return 1;
 
-   
-   pDupInfo->streamsPacketsHistory[uStreamIndex].packetsHashIndexes[iHashIndex] = uStreamPacketIndex;
+   _radio_dd_window_set_received(pStream, uStreamPacketIndex);
    pDupInfo->streamsPacketsHistory[uStreamIndex].uLastReceivedPacketIndex = uStreamPacketIndex;
    if ( uStreamPacketIndex > pDupInfo->streamsPacketsHistory[uStreamIndex].uMaxReceivedPacketIndex )
       pDupInfo->streamsPacketsHistory[uStreamIndex].uMaxReceivedPacketIndex = uStreamPacketIndex;
@@ -317,6 +409,46 @@ int radio_dup_detection_is_duplicate_on_stream(int iRadioInterfaceIndex, u8* pPa
    return 0;
 }
 
+int radio_dup_detection_is_duplicate_on_stream(int iRadioInterfaceIndex, u8* pPacketBuffer, int iPacketLength, u32 uTimeNow)
+{
+   u8 uIsDuplicate = 1;
+   radio_dup_detection_check_batch(iRadioInterfaceIndex, &pPacketBuffer, &iPacketLength, 1, uTimeNow, &uIsDuplicate);
+   return uIsDuplicate;
+}
+
+// Checks, in order, a batch of packets received on a radio interface.
+// Sets pOutIsDuplicate[i] to 1 if packet i is a duplicate (or can't be tracked), 0 otherwise.
+// Returns the number of unique packets.
+
+int radio_dup_detection_check_batch(int iRadioInterfaceIndex, u8** pPackets, int* piPacketsLengths, int iCount, u32 uTimeNow, u8* pOutIsDuplicate)
+{
+   u32 uMaxDeltaForDataStream = 50;
+   if ( hardware_radio_index_is_serial_radio(iRadioInterfaceIndex) )
+      uMaxDeltaForDataStream = 200;
+
+   int iCountUnique = 0;
+   u32 uLastVehicleId = MAX_U32;
+   int iLastStatsIndex = -1;
+   for( int i=0; i<iCount; i++ )
+   {
+      pOutIsDuplicate[i] = 1;
+      if ( (NULL == pPackets[i]) || (piPacketsLengths[i] <= 0) )
+         continue;
+      u32 uVehicleId = ((t_packet_header*)pPackets[i])->vehicle_id_src;
+      if ( (uVehicleId != uLastVehicleId) || (-1 == iLastStatsIndex) || (s_ListHistoryRxPacketsVehicles[iLastStatsIndex].uVehicleId != uVehicleId) )
+      {
+         iLastStatsIndex = _radio_dup_detection_get_runtime_index_for_vid(uVehicleId, pPackets[i], piPacketsLengths[i]);
+         uLastVehicleId = uVehicleId;
+      }
+      if ( -1 == iLastStatsIndex )
+         continue;
+      pOutIsDuplicate[i] = (u8)_radio_dup_detection_check_packet(iRadioInterfaceIndex, iLastStatsIndex, pPackets[i], uTimeNow, uMaxDeltaForDataStream);
+      if ( ! pOutIsDuplicate[i] )
+         iCountUnique++;
+   }
+   return iCountUnique;
+}
+
 void radio_duplicate_detection_remove_data_for_all_except(u32 uVehicleId)
 {
    for( int i=0; i<MAX_CONCURENT_VEHICLES; i++ )
@@ -13,6 +13,7 @@ void radio_duplicate_detection_init();
 void radio_duplicate_detection_log_info();
 
 int radio_dup_detection_is_duplicate_on_stream(int iRadioInterfaceIndex, u8* pPacketBuffer, int iPacketLength, u32 uTimeNow);
+int radio_dup_detection_check_batch(int iRadioInterfaceIndex, u8** pPackets, int* piPacketsLengths, int iCount, u32 uTimeNow, u8* pOutIsDuplicate);
 void radio_duplicate_detection_remove_data_for_all_except(u32 uVehicleId);
 void radio_duplicate_detection_remove_data_for_vid(u32 uVehicleId);
 int radio_dup_detection_is_vehicle_restarted(u32 uVehicleId);
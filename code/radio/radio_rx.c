@@ -40,6 +40,7 @@
 #include "radiolink.h"
 #include "radio_duplicate_det.h"
 #include <poll.h>
+#include <sys/eventfd.h>
 
 
 int s_iRadioRxInitialized = 0;
@@ -63,6 +64,7 @@ int s_iSearchMode = 0;
 u32 s_uRadioRxTimeNow = 0;
 u32 s_uRadioRxMaxTimeRead = 0;
 u32 s_uRadioRxLastTimeQueue = 0;
+int s_iRadioRxEventFdsCreated = 0;
 u32 s_uRadioRxLastReceivedPacket =0;
 
 u32 s_uRadioRxLoopTimeMin = 10000;
@@ -84,8 +86,6 @@ int s_iRadioRxCountFDs = 0;
 int s_iRadioRxMaxFD = 0;
 struct timeval s_iRadioRxReadTimeInterval;
 
-u8 s_tmpLastProcessedRadioRxPacket[MAX_PACKET_TOTAL_SIZE];
-
 u32 s_uLastRxShortPacketsVehicleIds[MAX_RADIO_INTERFACES];
 
 // Pointers to array of int-s (max radio cards, for each card)
@@ -261,61 +261,81 @@ void _radio_rx_update_fd_sets()
 
 
 
-u8* _radio_rx_wait_get_queue_packet(t_radio_rx_state_packets_queue* pQueue, int iHighPriorityQueue, u32 uTimeoutMicroSec, int* pLength, int* pIsShortPacket, int* pRadioInterfaceIndex)
+// Single producer (rx thread) / single consumer (router loop) lock-free ring.
+// The producer only moves iCurrentPacketIndexToWrite, the consumer only moves iCurrentPacketIndexToConsume.
+// The returned packet is not copied: the consumer borrows the slot in place, and the slot is
+// released (given back to the producer) on the next read from the same queue.
+
+static void _radio_rx_queue_release_borrowed_packet(t_radio_rx_state_packets_queue* pQueue)
 {
-   int iRes = -1;
-   /*
-   if ( 0 == uTimeoutMicroSec )
-      iRes = sem_trywait(pQueue->pSemaphoreRead);
-   else
+   if ( pQueue->iBorrowedPacketIndex < 0 )
+      return;
+   __atomic_store_n(&pQueue->iCurrentPacketIndexToConsume, (pQueue->iBorrowedPacketIndex + 1) % pQueue->iQueueSize, __ATOMIC_RELEASE);
+   pQueue->iBorrowedPacketIndex = -1;
+}
+
+static int _radio_rx_queue_has_packets(t_radio_rx_state_packets_queue* pQueue)
+{
+   return (__atomic_load_n(&pQueue->iCurrentPacketIndexToWrite, __ATOMIC_ACQUIRE) != pQueue->iCurrentPacketIndexToConsume);
+}
+
+// Blocks until the producer signals a new packet or the timeout expires
+static void _radio_rx_queue_wait_for_packet(t_radio_rx_state_packets_queue* pQueue, u32 uTimeoutMicroSec)
+{
+   if ( pQueue->iEventFd < 0 )
    {
-      struct timespec ts;
-      clock_gettime(CLOCK_REALTIME, &ts);
-      ts.tv_nsec += 1000LL*(long long)uTimeoutMicroSec*1000LL;
-      if ( ts.tv_nsec >= 1000000000LL )
-      {
-         ts.tv_sec++;
-         ts.tv_nsec -= 1000000000L;
-      }
-      iRes = sem_timedwait(pQueue->pSemaphoreRead, &ts);
+      hardware_sleep_micros(uTimeoutMicroSec);
+      return;
    }
-   if ( 0 != iRes )
+
+   __atomic_store_n(&pQueue->iConsumerWaiting, 1, __ATOMIC_SEQ_CST);
+   // Check again after publishing the waiting flag, so that a packet added right now is not missed
+   if ( __atomic_load_n(&pQueue->iCurrentPacketIndexToWrite, __ATOMIC_SEQ_CST) == pQueue->iCurrentPacketIndexToConsume )
    {
-      if ( errno != ETIMEDOUT )
-         log_softerror_and_alarm("[RadioRx] Failed to timewait on %s semaphore for %u micros. Error: %d, %d, %s", iHighPriorityQueue?"high prio":"reg prio", uTimeoutMicroSec, iRes, errno, strerror(errno));
-      return NULL;
+      struct pollfd pfd;
+      pfd.fd = pQueue->iEventFd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      // Returns as soon as a packet is added; the timeout only matters when idle
+      poll(&pfd, 1, (int)((uTimeoutMicroSec + 999) / 1000));
    }
-   */
-   iRes = sem_trywait(pQueue->pSemaphoreRead);
-   if ( (0 != iRes) && (0 != uTimeoutMicroSec) )
+   __atomic_store_n(&pQueue->iConsumerWaiting, 0, __ATOMIC_SEQ_CST);
+
+   // Clear any pending signal (non blocking eventfd)
+   eventfd_t uValue = 0;
+   eventfd_read(pQueue->iEventFd, &uValue);
+}
+
+u8* _radio_rx_wait_get_queue_packet(t_radio_rx_state_packets_queue* pQueue, int iHighPriorityQueue, u32 uTimeoutMicroSec, int* pLength, int* pIsShortPacket, int* pRadioInterfaceIndex)
+{
+   _radio_rx_queue_release_borrowed_packet(pQueue);
+
+   if ( ! _radio_rx_queue_has_packets(pQueue) )
    {
-      hardware_sleep_micros(200);
-      iRes = sem_trywait(pQueue->pSemaphoreRead);
+      if ( 0 == uTimeoutMicroSec )
+         return NULL;
+      _radio_rx_queue_wait_for_packet(pQueue, uTimeoutMicroSec);
+      if ( ! _radio_rx_queue_has_packets(pQueue) )
+         return NULL;
    }
-   if ( 0 != iRes )
-      return NULL;
-   int iIndexToCopy = -1;
-   pthread_mutex_lock(&pQueue->mutexLock);
-   iIndexToCopy = pQueue->iCurrentPacketIndexToConsume;
-   if ( (iIndexToCopy != pQueue->iCurrentPacketIndexToWrite) && (NULL != pQueue->pPacketsBuffers[iIndexToCopy]) && (pQueue->iPacketsLengths[iIndexToCopy] > 0) && (pQueue->iPacketsLengths[iIndexToCopy] < MAX_PACKET_TOTAL_SIZE) )
-      pQueue->iCurrentPacketIndexToConsume = (pQueue->iCurrentPacketIndexToConsume + 1 ) % pQueue->iQueueSize;
-   else
-       iIndexToCopy = -1;
-   pthread_mutex_unlock(&pQueue->mutexLock);
 
-   if ( -1 == iIndexToCopy )
+   int iIndex = pQueue->iCurrentPacketIndexToConsume;
+   if ( (NULL == pQueue->pPacketsBuffers[iIndex]) || (pQueue->iPacketsLengths[iIndex] <= 0) || (pQueue->iPacketsLengths[iIndex] >= MAX_PACKET_TOTAL_SIZE) )
+   {
+      __atomic_store_n(&pQueue->iCurrentPacketIndexToConsume, (iIndex + 1) % pQueue->iQueueSize, __ATOMIC_RELEASE);
       return NULL;
+   }
+
+   pQueue->iBorrowedPacketIndex = iIndex;
 
    if ( NULL != pLength )
-      *pLength = pQueue->iPacketsLengths[iIndexToCopy];
+      *pLength = pQueue->iPacketsLengths[iIndex];
    if ( NULL != pIsShortPacket )
-      *pIsShortPacket = pQueue->uPacketsAreShort[iIndexToCopy];
+      *pIsShortPacket = pQueue->uPacketsAreShort[iIndex];
    if ( NULL != pRadioInterfaceIndex )
-      *pRadioInterfaceIndex = pQueue->uPacketsRxInterface[iIndexToCopy];
-
-   memcpy(s_tmpLastProcessedRadioRxPacket, pQueue->pPacketsBuffers[iIndexToCopy], pQueue->iPacketsLengths[iIndexToCopy]);
+      *pRadioInterfaceIndex = pQueue->uPacketsRxInterface[iIndex];
 
-   return s_tmpLastProcessedRadioRxPacket;
+   return pQueue->pPacketsBuffers[iIndex];
 }
 
 u32 radio_rx_get_current_frame_start_time()
@@ -373,6 +393,55 @@ u8* radio_rx_wait_get_next_received_reg_prio_packet(u32 uTimeoutMicroSec, int* p
    return _radio_rx_wait_get_queue_packet(&(s_RadioRxState.queue_reg_priority), 0, uTimeoutMicroSec, pLength, pIsShortPacket, pRadioInterfaceIndex);
 }
 
+// For callers that wait on several sources at once (i.e. epoll): the queue eventfd becomes readable when a packet
+// is added while the consumer is between radio_rx_begin_wait() and radio_rx_end_wait()
+int radio_rx_get_wait_event_fd(int iHighPriority)
+{
+   if ( ! s_iRadioRxEventFdsCreated )
+      return -1;
+   if ( iHighPriority )
+      return s_RadioRxState.queue_high_priority.iEventFd;
+   return s_RadioRxState.queue_reg_priority.iEventFd;
+}
+
+static int _radio_rx_queue_begin_wait(t_radio_rx_state_packets_queue* pQueue)
+{
+   // The caller is done with the last returned packet
+   _radio_rx_queue_release_borrowed_packet(pQueue);
+   if ( pQueue->iEventFd < 0 )
+      return _radio_rx_queue_has_packets(pQueue);
+   __atomic_store_n(&pQueue->iConsumerWaiting, 1, __ATOMIC_SEQ_CST);
+   // Check again after publishing the waiting flag, so that a packet added right now is not missed
+   return (__atomic_load_n(&pQueue->iCurrentPacketIndexToWrite, __ATOMIC_SEQ_CST) != pQueue->iCurrentPacketIndexToConsume);
+}
+
+static void _radio_rx_queue_end_wait(t_radio_rx_state_packets_queue* pQueue)
+{
+   if ( pQueue->iEventFd < 0 )
+      return;
+   __atomic_store_n(&pQueue->iConsumerWaiting, 0, __ATOMIC_SEQ_CST);
+   eventfd_t uValue = 0;
+   eventfd_read(pQueue->iEventFd, &uValue);
+}
+
+// Returns 1 if there are received packets already (the caller should not block then)
+int radio_rx_begin_wait()
+{
+   if ( 0 == s_iRadioRxInitialized )
+      return 0;
+   int iHasPackets = _radio_rx_queue_begin_wait(&(s_RadioRxState.queue_high_priority));
+   iHasPackets |= _radio_rx_queue_begin_wait(&(s_RadioRxState.queue_reg_priority));
+   return iHasPackets;
+}
+
+void radio_rx_end_wait()
+{
+   if ( 0 == s_iRadioRxInitialized )
+      return;
+   _radio_rx_queue_end_wait(&(s_RadioRxState.queue_high_priority));
+   _radio_rx_queue_end_wait(&(s_RadioRxState.queue_reg_priority));
+}
+
 void _radio_rx_add_packet_to_rx_queue(u8* pPacket, int iLength, int iRadioInterface)
 {
    if ( (NULL == pPacket) || (iLength <= 0) || s_iRadioRxMarkedForQuit )
@@ -385,29 +454,35 @@ void _radio_rx_add_packet_to_rx_queue(u8* pPacket, int iLength, int iRadioInterf
    if ( uPacketFlags & PACKET_FLAGS_BIT_HIGH_PRIORITY )
       pQueue = &s_RadioRxState.queue_high_priority;
 
-   int iIndexToWriteTo = -1;
-   pthread_mutex_lock(&pQueue->mutexLock);
-   iIndexToWriteTo = pQueue->iCurrentPacketIndexToWrite;
-   // No more room? Discard oldest packet
-   if ( ((pQueue->iCurrentPacketIndexToWrite+1) % pQueue->iQueueSize) == pQueue->iCurrentPacketIndexToConsume )
-       pQueue->iCurrentPacketIndexToConsume = (pQueue->iCurrentPacketIndexToConsume+1) % pQueue->iQueueSize;
+   int iIndexToWriteTo = pQueue->iCurrentPacketIndexToWrite;
+   int iIndexNext = (iIndexToWriteTo + 1) % pQueue->iQueueSize;
+   int iIndexToConsume = __atomic_load_n(&pQueue->iCurrentPacketIndexToConsume, __ATOMIC_ACQUIRE);
 
-   pQueue->iCurrentPacketIndexToWrite = (pQueue->iCurrentPacketIndexToWrite + 1) % pQueue->iQueueSize;
-   pthread_mutex_unlock(&pQueue->mutexLock);
+   // No more room? Discard the new packet (the consumer owns the older ones)
+   if ( iIndexNext == iIndexToConsume )
+   {
+      pQueue->uStatsDroppedPackets++;
+      return;
+   }
 
    // Add the packet to the queue
    pQueue->uPacketsRxInterface[iIndexToWriteTo] = iRadioInterface;
    pQueue->uPacketsAreShort[iIndexToWriteTo] = 0;
    pQueue->iPacketsLengths[iIndexToWriteTo] = iLength;
    memcpy(pQueue->pPacketsBuffers[iIndexToWriteTo], pPacket, iLength);
-      
-   if ( (NULL != pQueue->pSemaphoreWrite) && (0 != sem_post(pQueue->pSemaphoreWrite)) )
-      log_softerror_and_alarm("Failed to set semaphore for packet ready.");
- 
-   iIndexToWriteTo = (iIndexToWriteTo + 1) % pQueue->iQueueSize;
-   int iCountPackets = iIndexToWriteTo - pQueue->iCurrentPacketIndexToConsume;
-   if ( iIndexToWriteTo < pQueue->iCurrentPacketIndexToConsume )
-      iCountPackets = iIndexToWriteTo + (pQueue->iQueueSize - pQueue->iCurrentPacketIndexToConsume);
+
+   // Publish it
+   __atomic_store_n(&pQueue->iCurrentPacketIndexToWrite, iIndexNext, __ATOMIC_SEQ_CST);
+
+   if ( (pQueue->iEventFd >= 0) && __atomic_load_n(&pQueue->iConsumerWaiting, __ATOMIC_SEQ_CST) )
+   {
+      if ( 0 != eventfd_write(pQueue->iEventFd, 1) )
+         log_softerror_and_alarm("[RadioRx] Failed to signal packet ready.");
+   }
+
+   int iCountPackets = iIndexNext - iIndexToConsume;
+   if ( iIndexNext < iIndexToConsume )
+      iCountPackets = iIndexNext + (pQueue->iQueueSize - iIndexToConsume);
 
    if ( iCountPackets > pQueue->iStatsMaxPacketsInQueueLastMinute )
       pQueue->iStatsMaxPacketsInQueueLastMinute = iCountPackets;
@@ -428,6 +503,28 @@ void _radio_rx_check_add_packet_to_rx_queue(u8* pPacket, int iLength, int iRadio
    _radio_rx_add_packet_to_rx_queue(pPacket, iLength, iRadioInterfaceIndex);
 }
 
+// Runs duplicate detection on a batch of packets received on the same radio interface and queues the unique ones.
+// The packets must still be valid (burst frames are valid only until the next read on the interface).
+
+void _radio_rx_check_add_packets_batch_to_rx_queue(u8** pPackets, int* piLengths, int iCount, int iRadioInterfaceIndex)
+{
+   if ( iCount <= 0 )
+      return;
+
+   u8 uIsDuplicate[RADIO_RX_BURST_SIZE];
+   if ( 0 == radio_dup_detection_check_batch(iRadioInterfaceIndex, pPackets, piLengths, iCount, s_uRadioRxTimeNow, uIsDuplicate) )
+      return;
+
+   for( int i=0; i<iCount; i++ )
+   {
+      if ( uIsDuplicate[i] )
+         continue;
+      if ( NULL != s_pSMRadioStats )
+        radio_stats_update_on_unique_packet_received(s_pSMRadioStats, s_uRadioRxTimeNow, iRadioInterfaceIndex, pPackets[i], piLengths[i]);
+      _radio_rx_add_packet_to_rx_queue(pPackets[i], piLengths[i], iRadioInterfaceIndex);
+   }
+}
+
 void _radio_rx_update_frame_times(u8* pPacketBuffer, int iRxDatarate)
 {
    if ( (NULL == pPacketBuffer) || (0 == iRxDatarate) )
@@ -665,11 +762,24 @@ int _radio_rx_parse_received_wifi_radio_data(int iInterfaceIndex, int iMaxReads)
    u8* pPacketBuffer = NULL;
    int iCountParsed = 0;
 
+   // Valid packets are checked for duplicates in batches, one batch per received burst of frames
+   u8* pBatchPackets[RADIO_RX_BURST_SIZE];
+   int iBatchLengths[RADIO_RX_BURST_SIZE];
+   int iBatchCount = 0;
+
    //static int sdebugCountParser = 0;
    //sdebugCountParser++;
 
    for( int iCountReads=0; iCountReads<iMaxReads; iCountReads++ )
    {
+      // Next read would reuse the burst buffers? Then process the batch first
+      if ( iBatchCount > 0 )
+      if ( (iBatchCount >= RADIO_RX_BURST_SIZE) || (! radio_has_pending_rx_frames(iInterfaceIndex)) )
+      {
+         _radio_rx_check_add_packets_batch_to_rx_queue(pBatchPackets, iBatchLengths, iBatchCount, iInterfaceIndex);
+         iBatchCount = 0;
+      }
+
       iBufferLength = 0;
       iRxDatarate = 0;
       pPacketBuffer = radio_process_wlan_data_in(iInterfaceIndex, &iBufferLength, &iRxDatarate, s_uRadioRxTimeNow);
@@ -719,7 +829,9 @@ int _radio_rx_parse_received_wifi_radio_data(int iInterfaceIndex, int iMaxReads)
 
       if ( iPacketLength <= 0 )
       {
-         log_softerror_and_alarm("[RadioRxThread] Process and check packet of %d bytes failed, error: %d", iBufferLength, get_last_processing_error_code());
+         // Not authenticated packets are expected (from other vehicles or controllers) when authentication is required
+         if ( get_last_processing_error_code() != RADIO_PROCESSING_ERROR_CODE_AUTHENTICATION_FAILED )
+            log_softerror_and_alarm("[RadioRxThread] Process and check packet of %d bytes failed, error: %d", iBufferLength, get_last_processing_error_code());
          iDataIsOk = 0;
          s_RadioRxState.iRadioInterfacesRxBadPackets[iInterfaceIndex] = get_last_processing_error_code();
          continue;
@@ -765,7 +877,9 @@ int _radio_rx_parse_received_wifi_radio_data(int iInterfaceIndex, int iMaxReads)
       /**/
       }
 
-      _radio_rx_check_add_packet_to_rx_queue(pPacketBuffer, iPacketLength, iInterfaceIndex);
+      pBatchPackets[iBatchCount] = pPacketBuffer;
+      iBatchLengths[iBatchCount] = iPacketLength;
+      iBatchCount++;
 
       if ( NULL != s_pRxAirGapTracking )
       {
@@ -791,6 +905,8 @@ int _radio_rx_parse_received_wifi_radio_data(int iInterfaceIndex, int iMaxReads)
          radio_stats_update_on_new_radio_packet_received(s_pSMRadioStats, s_uRadioRxTimeNow, iInterfaceIndex, pPacketBuffer, iBufferLength, 0, iDataIsOk);
    }
 
+   _radio_rx_check_add_packets_batch_to_rx_queue(pBatchPackets, iBatchLengths, iBatchCount, iInterfaceIndex);
+
    if ( iReturn < 0 )
       return iReturn;
 
@@ -849,11 +965,13 @@ void _radio_rx_update_stats(u32 uTimeNow)
 
       radio_duplicate_detection_log_info();
 
-      log_line("[RadioRxThread] Max packets in queues (high/reg prio): %d/%d. Max packets in queue in last 10 sec: %d/%d",
+      log_line("[RadioRxThread] Max packets in queues (high/reg prio): %d/%d. Max packets in queue in last 10 sec: %d/%d, total dropped (queue full): %u/%u",
          s_RadioRxState.queue_high_priority.iStatsMaxPacketsInQueue,
          s_RadioRxState.queue_reg_priority.iStatsMaxPacketsInQueue,
          s_RadioRxState.queue_high_priority.iStatsMaxPacketsInQueueLastMinute,
-         s_RadioRxState.queue_reg_priority.iStatsMaxPacketsInQueueLastMinute);
+         s_RadioRxState.queue_reg_priority.iStatsMaxPacketsInQueueLastMinute,
+         s_RadioRxState.queue_high_priority.uStatsDroppedPackets,
+         s_RadioRxState.queue_reg_priority.uStatsDroppedPackets);
       s_RadioRxState.queue_high_priority.iStatsMaxPacketsInQueueLastMinute = 0;
       s_RadioRxState.queue_reg_priority.iStatsMaxPacketsInQueueLastMinute = 0;
 
@@ -1016,6 +1134,8 @@ void * _thread_radio_rx(void *argument)
       iLoopParsedPackets = 0;
       struct pollfd fds[MAX_RADIO_INTERFACES];
       int iRadioInterfacesWherePaused[MAX_RADIO_INTERFACES];
+      int iRadioInterfacesWithPendingFrames[MAX_RADIO_INTERFACES];
+      int iAnyPendingFrames = 0;
       s_iRadioRxCountFDs = 0;
       for( int i=0; i<hardware_get_radio_interfaces_count(); i++ )
       {
@@ -1030,6 +1150,10 @@ void * _thread_radio_rx(void *argument)
          fds[s_iRadioRxCountFDs].fd = pRadioHWInfo->runtimeInterfaceInfoRx.selectable_fd;
          fds[s_iRadioRxCountFDs].revents = 0;
          fds[s_iRadioRxCountFDs].events = POLLIN;
+         // Frames left over from the last batched read are not signaled by poll
+         iRadioInterfacesWithPendingFrames[s_iRadioRxCountFDs] = radio_has_pending_rx_frames(i);
+         if ( iRadioInterfacesWithPendingFrames[s_iRadioRxCountFDs] )
+            iAnyPendingFrames = 1;
          s_iRadioRxCountFDs++;
       }
 
@@ -1042,8 +1166,19 @@ void * _thread_radio_rx(void *argument)
 
       //s_bCanDoExternalOperations = 1;
       //int nResult = select(s_iRadioRxMaxFD, &s_RadioRxReadSet, NULL, NULL, &s_iRadioRxReadTimeInterval);
-      int nResult = poll(fds, s_iRadioRxCountFDs, iPollTimeoutMs);
+      int nResult = poll(fds, s_iRadioRxCountFDs, iAnyPendingFrames?0:iPollTimeoutMs);
       //s_bCanDoExternalOperations = 0;
+      if ( iAnyPendingFrames && (nResult >= 0) )
+      {
+         for( int i=0; i<s_iRadioRxCountFDs; i++ )
+         {
+            if ( iRadioInterfacesWithPendingFrames[i] && (0 == (fds[i].revents & POLLIN)) )
+            {
+               fds[i].revents |= POLLIN;
+               nResult++;
+            }
+         }
+      }
       s_uRadioRxTimeNow = get_current_timestamp_ms();
       s_uRadioRxLastTimeQueue = 0;
 
@@ -1212,85 +1347,24 @@ int _radio_rx_init_queues()
    s_RadioRxState.queue_reg_priority.iStatsMaxPacketsInQueue = 0;
    s_RadioRxState.queue_reg_priority.iStatsMaxPacketsInQueueLastMinute = 0;
 
-   sem_unlink(RUBY_SEM_RX_RADIO_HIGH_PRIORITY);
-   sem_unlink(RUBY_SEM_RX_RADIO_REG_PRIORITY);
+   s_RadioRxState.queue_high_priority.iBorrowedPacketIndex = -1;
+   s_RadioRxState.queue_reg_priority.iBorrowedPacketIndex = -1;
+   s_RadioRxState.queue_high_priority.iConsumerWaiting = 0;
+   s_RadioRxState.queue_reg_priority.iConsumerWaiting = 0;
+   s_RadioRxState.queue_high_priority.uStatsDroppedPackets = 0;
+   s_RadioRxState.queue_reg_priority.uStatsDroppedPackets = 0;
 
-   pthread_mutexattr_t mutexAttr;
-   if ( 0 != pthread_mutexattr_init(&mutexAttr) )
+   // The eventfds are kept across rx thread restarts, so that callers waiting on them (see radio_rx_get_wait_event_fd) stay valid
+   if ( ! s_iRadioRxEventFdsCreated )
    {
-      log_error_and_alarm("[RadioRx] Failed to initialize rx queues mutex attributes.");
-      return -1;
+      s_iRadioRxEventFdsCreated = 1;
+      s_RadioRxState.queue_high_priority.iEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      if ( s_RadioRxState.queue_high_priority.iEventFd < 0 )
+         log_error_and_alarm("[RadioRx] Failed to create high prio rx queue eventfd, error: %d, %s. Will poll the queue.", errno, strerror(errno));
+      s_RadioRxState.queue_reg_priority.iEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      if ( s_RadioRxState.queue_reg_priority.iEventFd < 0 )
+         log_error_and_alarm("[RadioRx] Failed to create reg prio rx queue eventfd, error: %d, %s. Will poll the queue.", errno, strerror(errno));
    }
-   if ( 0 != pthread_mutex_init(&s_RadioRxState.queue_high_priority.mutexLock, &mutexAttr) )
-   {
-      log_error_and_alarm("[RadioRx] Failed to initialize high prio rx queue mutex.");
-      return -1;
-   }
-   if ( 0 != pthread_mutex_init(&s_RadioRxState.queue_reg_priority.mutexLock, &mutexAttr) )
-   {
-      log_error_and_alarm("[RadioRx] Failed to initialize reg prio rx queue mutex.");
-      return -1;
-   }
-
-   if ( 0 != pthread_mutexattr_destroy(&mutexAttr) )
-      log_error_and_alarm("[RadioRx] Failed to cleanup radio rx queues mutex attributes");
-
-   s_RadioRxState.queue_high_priority.pSemaphoreWrite = sem_open(RUBY_SEM_RX_RADIO_HIGH_PRIORITY, O_CREAT | O_RDWR, S_IWUSR | S_IRUSR, 0);
-   if ( (NULL == s_RadioRxState.queue_high_priority.pSemaphoreWrite) || (SEM_FAILED == s_RadioRxState.queue_high_priority.pSemaphoreWrite) )
-   {
-      log_error_and_alarm("[RadioRx] Failed to create write semaphore: %s, try alternative.", RUBY_SEM_RX_RADIO_HIGH_PRIORITY);
-      s_RadioRxState.queue_high_priority.pSemaphoreWrite = sem_open(RUBY_SEM_RX_RADIO_HIGH_PRIORITY, O_CREAT, S_IWUSR | S_IRUSR, 0); 
-      if ( (NULL == s_RadioRxState.queue_high_priority.pSemaphoreWrite) || (SEM_FAILED == s_RadioRxState.queue_high_priority.pSemaphoreWrite) )
-      {
-         log_error_and_alarm("[RadioRx] Failed to create write semaphore: %s", RUBY_SEM_RX_RADIO_HIGH_PRIORITY);
-         return -1;
-      }
-   }
-   s_RadioRxState.queue_high_priority.pSemaphoreRead = sem_open(RUBY_SEM_RX_RADIO_HIGH_PRIORITY, O_RDWR);
-   if ( (NULL == s_RadioRxState.queue_high_priority.pSemaphoreRead) || (SEM_FAILED == s_RadioRxState.queue_high_priority.pSemaphoreRead) )
-   {
-      log_error_and_alarm("[RadioRx] Failed to create read semaphore: %s, try alternative.", RUBY_SEM_RX_RADIO_HIGH_PRIORITY);
-      s_RadioRxState.queue_high_priority.pSemaphoreRead = sem_open(RUBY_SEM_RX_RADIO_HIGH_PRIORITY, O_CREAT, S_IWUSR | S_IRUSR, 0); 
-      if ( (NULL == s_RadioRxState.queue_high_priority.pSemaphoreRead) || (SEM_FAILED == s_RadioRxState.queue_high_priority.pSemaphoreRead) )
-      {
-         log_error_and_alarm("[RadioRx] Failed to create read semaphore: %s", RUBY_SEM_RX_RADIO_HIGH_PRIORITY);
-         return -1;
-      }
-   }
-   int iSemVal = 0;
-   if ( 0 == sem_getvalue(s_RadioRxState.queue_high_priority.pSemaphoreRead, &iSemVal) )
-      log_line("[RadioRx] High priority queue semaphore initial value: %d", iSemVal);
-   else
-      log_softerror_and_alarm("[RadioRx] Failed to get high priority queue sem value.");
-
-   s_RadioRxState.queue_reg_priority.pSemaphoreWrite = sem_open(RUBY_SEM_RX_RADIO_REG_PRIORITY, O_CREAT | O_RDWR, S_IWUSR | S_IRUSR, 0);
-   if ( (NULL == s_RadioRxState.queue_reg_priority.pSemaphoreWrite) || (SEM_FAILED == s_RadioRxState.queue_reg_priority.pSemaphoreWrite) )
-   {
-      log_error_and_alarm("[RadioRx] Failed to create write semaphore: %s, try alternative.", RUBY_SEM_RX_RADIO_REG_PRIORITY);
-      s_RadioRxState.queue_reg_priority.pSemaphoreWrite = sem_open(RUBY_SEM_RX_RADIO_REG_PRIORITY, O_CREAT, S_IWUSR | S_IRUSR, 0); 
-      if ( (NULL == s_RadioRxState.queue_reg_priority.pSemaphoreWrite) || (SEM_FAILED == s_RadioRxState.queue_reg_priority.pSemaphoreWrite) )
-      {
-         log_error_and_alarm("[RadioRx] Failed to create write semaphore: %s", RUBY_SEM_RX_RADIO_REG_PRIORITY);
-         return -1;
-      }
-   }
-   s_RadioRxState.queue_reg_priority.pSemaphoreRead = sem_open(RUBY_SEM_RX_RADIO_REG_PRIORITY, O_RDWR);
-   if ( (NULL == s_RadioRxState.queue_reg_priority.pSemaphoreRead) || (SEM_FAILED == s_RadioRxState.queue_reg_priority.pSemaphoreRead) )
-   {
-      log_error_and_alarm("[RadioRx] Failed to create read semaphore: %s, try alternative", RUBY_SEM_RX_RADIO_REG_PRIORITY);
-      s_RadioRxState.queue_reg_priority.pSemaphoreRead = sem_open(RUBY_SEM_RX_RADIO_REG_PRIORITY, O_CREAT, S_IWUSR | S_IRUSR, 0); 
-      if ( (NULL == s_RadioRxState.queue_reg_priority.pSemaphoreRead) || (SEM_FAILED == s_RadioRxState.queue_reg_priority.pSemaphoreRead) )
-      {
-         log_error_and_alarm("[RadioRx] Failed to create read semaphore: %s", RUBY_SEM_RX_RADIO_REG_PRIORITY);
-         return -1;
-      }
-   }
-
-   iSemVal = 0;
-   if ( 0 == sem_getvalue(s_RadioRxState.queue_reg_priority.pSemaphoreRead, &iSemVal) )
-      log_line("[RadioRx] Reg priority queue semaphore initial value: %d", iSemVal);
-   else
-      log_softerror_and_alarm("[RadioRx] Failed to get reg priority queue sem value.");
 
    return 0;
 }
@@ -1383,25 +1457,6 @@ void radio_rx_stop_rx_thread()
       pthread_cancel(s_pThreadRadioRx);
    }
 
-   if ( NULL != s_RadioRxState.queue_high_priority.pSemaphoreWrite )
-      sem_close(s_RadioRxState.queue_high_priority.pSemaphoreWrite);
-   if ( NULL != s_RadioRxState.queue_high_priority.pSemaphoreRead )
-      sem_close(s_RadioRxState.queue_high_priority.pSemaphoreRead);
-   if ( NULL != s_RadioRxState.queue_reg_priority.pSemaphoreWrite )
-      sem_close(s_RadioRxState.queue_reg_priority.pSemaphoreWrite);
-   if ( NULL != s_RadioRxState.queue_reg_priority.pSemaphoreRead )
-      sem_close(s_RadioRxState.queue_reg_priority.pSemaphoreRead);
-   s_RadioRxState.queue_high_priority.pSemaphoreWrite = NULL;
-   s_RadioRxState.queue_high_priority.pSemaphoreRead = NULL;
-   s_RadioRxState.queue_reg_priority.pSemaphoreWrite = NULL;
-   s_RadioRxState.queue_reg_priority.pSemaphoreRead = NULL;
-
-   pthread_mutex_destroy(&s_RadioRxState.queue_high_priority.mutexLock);
-   pthread_mutex_destroy(&s_RadioRxState.queue_reg_priority.mutexLock);
-
-   sem_unlink(RUBY_SEM_RX_RADIO_HIGH_PRIORITY);
-   sem_unlink(RUBY_SEM_RX_RADIO_REG_PRIORITY);
-
    log_line("[RadioRx] Finished stopping rx thread.");
 }
 
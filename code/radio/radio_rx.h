@@ -37,14 +37,15 @@ typedef struct
    u8  uPacketsAreShort[MAX_RX_PACKETS_QUEUE_REG];
    u8  uPacketsRxInterface[MAX_RX_PACKETS_QUEUE_REG];
    int iQueueSize;
-   _ATOMIC_PREFIX int iCurrentPacketIndexToWrite; // Where next packet will be added
-   _ATOMIC_PREFIX int iCurrentPacketIndexToConsume; // Where the first packet to read/consume is
+   // Lock-free single producer (rx thread) / single consumer (router) ring
+   _ATOMIC_PREFIX int iCurrentPacketIndexToWrite; // Where next packet will be added. Moved only by the producer
+   _ATOMIC_PREFIX int iCurrentPacketIndexToConsume; // Where the first packet to read/consume is. Moved only by the consumer
+   int iBorrowedPacketIndex; // Slot currently handed to the consumer (read in place), -1 if none
+   _ATOMIC_PREFIX int iConsumerWaiting; // Consumer is blocked on iEventFd
+   int iEventFd; // Wakes up the consumer when a packet is added
+   u32 uStatsDroppedPackets;
    int iStatsMaxPacketsInQueue;
    int iStatsMaxPacketsInQueueLastMinute;
-
-   pthread_mutex_t mutexLock;
-   sem_t* pSemaphoreWrite;
-   sem_t* pSemaphoreRead;
 } ALIGN_STRUCT_SPEC_INFO t_radio_rx_state_packets_queue;
 
 typedef struct
@@ -107,9 +108,15 @@ u32 radio_rx_get_and_reset_max_loop_time_queue();
 u32 radio_rx_get_current_frame_start_time();
 u32 radio_rx_get_current_frame_end_time();
 u16 radio_rx_get_current_frame_number();
+// The returned packet buffer is valid until the next call for the same queue
 u8* radio_rx_wait_get_next_received_high_prio_packet(u32 uTimeoutMicroSec, int* pLength, int* pIsShortPacket, int* pRadioInterfaceIndex);
 u8* radio_rx_wait_get_next_received_reg_prio_packet(u32 uTimeoutMicroSec, int* pLength, int* pIsShortPacket, int* pRadioInterfaceIndex);
 
+// Waiting on the rx queues together with other fds (see base/reactor.h)
+int radio_rx_get_wait_event_fd(int iHighPriority);
+int radio_rx_begin_wait();
+void radio_rx_end_wait();
+
 #ifdef __cplusplus
 }  
 #endif
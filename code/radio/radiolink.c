@@ -30,8 +30,13 @@
     SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <sys/ioctl.h>
+#include <sys/socket.h>
 #include <netpacket/packet.h>
+#include <linux/filter.h>
 #include <net/if.h>
 #include <netinet/ether.h>
 #include <string.h>
@@ -57,6 +62,7 @@
 int s_bRadioDebugFlag = 0;
 int s_iUsePCAPForTx = DEFAULT_USE_PPCAP_FOR_TX;
 int s_iBypassSocketBuffers = DEFAULT_BYPASS_SOCKET_BUFFERS;
+int s_iUseBatchedRx = DEFAULT_USE_BATCHED_RX_SOCKET;
 int s_iRadioInterfacesBroken = 0;
 int s_iRadioLastReadErrorCode = RADIO_READ_ERROR_NO_ERROR;
 int s_iVehicleBehindMilisec = 0;
@@ -73,6 +79,10 @@ u32 sRadioReceivedFramesType = RADIO_FLAGS_FRAME_TYPE_DATA;
 u32 sRadioLastReceivedHeadersLength = 0;
 
 int s_iLastProcessingErrorCode = 0;
+int s_iRequireAuthEncryption = 0;
+u32 s_uRequireAuthExemptVehicleId = 0;
+u32 s_uAuthOversizePacketsDropped = 0;
+u32 s_uTimeLastLogAuthOversizePackets = 0;
 
 int s_iLogCount_RadioRate = 0;
 int s_iLogCount_RadioFlags = 0;
@@ -99,6 +109,39 @@ pthread_mutex_t s_pMutexRadioSyncRxTxThreads;
 int s_iMutexRadioSyncRxTxThreadsInitialized = 0;
 
 u8 s_uLastPacketBuilt[MAX_PACKET_TOTAL_SIZE];
+
+// Batched rx: one recvmmsg() drains up to RADIO_RX_BURST_SIZE frames from a raw
+// packet socket; frames are then handed out (and parsed) in place, one per call.
+typedef struct
+{
+   int iSocketFd;
+   int iCountFrames; // frames received on last recvmmsg
+   int iNextFrame; // next frame to hand out from the last burst
+   u32 uTotalBursts;
+   u32 uTotalFrames;
+   u32 uTotalTruncatedFrames;
+   struct mmsghdr msgs[RADIO_RX_BURST_SIZE];
+   struct iovec iovecs[RADIO_RX_BURST_SIZE];
+   u8 uFrames[RADIO_RX_BURST_SIZE][MAX_PACKET_LENGTH_PCAP];
+} type_radio_rx_burst;
+
+type_radio_rx_burst* s_pRadioRxBursts[MAX_RADIO_INTERFACES];
+
+// Batched tx: while a tx batch is open, frames written to socket tx interfaces are queued
+// here and handed to the kernel with one sendmmsg() per interface on flush.
+typedef struct
+{
+   int iCountFrames;
+   u32 uTotalBatches;
+   u32 uTotalFrames;
+   u32 uTotalFailedFrames;
+   struct mmsghdr msgs[RADIO_TX_BATCH_SIZE];
+   struct iovec iovecs[RADIO_TX_BATCH_SIZE];
+   u8 uFrames[RADIO_TX_BATCH_SIZE][MAX_PACKET_TOTAL_SIZE];
+} type_radio_tx_batch;
+
+type_radio_tx_batch* s_pRadioTxBatches[MAX_RADIO_INTERFACES];
+int s_iRadioTxBatchActive = 0;
 u32 s_uLastRadioPingSentTime = 0;
 u8 s_uLastRadioPingId = 0;
 
@@ -293,6 +336,25 @@ void radio_set_use_pcap_for_tx(int iEnablePCAPTx)
       log_line("[Radio] Set using sockets for radio tx");
 }
 
+void radio_set_use_batched_rx(int iEnableBatchedRx)
+{
+   s_iUseBatchedRx = iEnableBatchedRx;
+   if ( s_iUseBatchedRx )
+      log_line("[Radio] Set using batched raw sockets for radio rx");
+   else
+      log_line("[Radio] Set using ppcap for radio rx");
+}
+
+void radio_set_require_auth_encryption(int iRequire, u32 uExemptVehicleId)
+{
+   s_iRequireAuthEncryption = iRequire;
+   s_uRequireAuthExemptVehicleId = uExemptVehicleId;
+   if ( s_iRequireAuthEncryption )
+      log_line("[Radio] Set require authenticated encryption on received packets (not required from vehicle id: %u).", uExemptVehicleId);
+   else
+      log_line("[Radio] Unset require authenticated encryption on received packets.");
+}
+
 void radio_set_bypass_socket_buffers(int iBypass)
 {
    s_iBypassSocketBuffers = iBypass;
@@ -566,6 +628,159 @@ int radio_get_last_read_error_code()
    return s_iRadioLastReadErrorCode; 
 }
 
+void _radio_close_rx_burst_socket(int interfaceIndex)
+{
+   if ( (interfaceIndex < 0) || (interfaceIndex >= MAX_RADIO_INTERFACES) )
+      return;
+   type_radio_rx_burst* pBurst = s_pRadioRxBursts[interfaceIndex];
+   if ( NULL == pBurst )
+      return;
+   log_line("[Radio] Closed batched rx socket fd %d for radio interface %d: %u bursts, %u frames (%u per burst), %u truncated frames.",
+      pBurst->iSocketFd, interfaceIndex+1, pBurst->uTotalBursts, pBurst->uTotalFrames,
+      (pBurst->uTotalBursts > 0)?(pBurst->uTotalFrames/pBurst->uTotalBursts):0, pBurst->uTotalTruncatedFrames);
+   if ( pBurst->iSocketFd >= 0 )
+      close(pBurst->iSocketFd);
+   free(pBurst);
+   s_pRadioRxBursts[interfaceIndex] = NULL;
+}
+
+// Opens a raw packet socket on the interface, with the same (already compiled) filter as the pcap handle.
+// Returns the socket fd or -1 if batched rx can't be used on this interface.
+
+int _radio_open_rx_burst_socket(int interfaceIndex, radio_hw_info_t* pRadioHWInfo, struct bpf_program* pBPFProgram)
+{
+   if ( (interfaceIndex < 0) || (interfaceIndex >= MAX_RADIO_INTERFACES) )
+      return -1;
+
+   _radio_close_rx_burst_socket(interfaceIndex);
+
+   int iIfIndex = (int)if_nametoindex(pRadioHWInfo->szName);
+   if ( iIfIndex <= 0 )
+   {
+      log_softerror_and_alarm("[Radio] Batched rx: failed to get interface index for [%s], error: %s", pRadioHWInfo->szName, strerror(errno));
+      return -1;
+   }
+
+   // Protocol 0 so nothing gets queued until the filter is attached and the socket is bound to the interface
+   int iSocket = socket(AF_PACKET, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+   if ( iSocket < 0 )
+   {
+      log_softerror_and_alarm("[Radio] Batched rx: failed to create raw socket for [%s], error: %s", pRadioHWInfo->szName, strerror(errno));
+      return -1;
+   }
+
+   // pcap compiled bpf instructions have the same layout as the kernel socket filter instructions
+   struct sock_fprog filterProgram;
+   filterProgram.len = (unsigned short)pBPFProgram->bf_len;
+   filterProgram.filter = (struct sock_filter*)pBPFProgram->bf_insns;
+   if ( 0 != setsockopt(iSocket, SOL_SOCKET, SO_ATTACH_FILTER, &filterProgram, sizeof(filterProgram)) )
+   {
+      log_softerror_and_alarm("[Radio] Batched rx: failed to attach filter on [%s], error: %s", pRadioHWInfo->szName, strerror(errno));
+      close(iSocket);
+      return -1;
+   }
+
+   struct sockaddr_ll ll_addr;
+   memset(&ll_addr, 0, sizeof(ll_addr));
+   ll_addr.sll_family = AF_PACKET;
+   ll_addr.sll_protocol = htons(ETH_P_ALL);
+   ll_addr.sll_ifindex = iIfIndex;
+   if ( 0 != bind(iSocket, (struct sockaddr*)&ll_addr, sizeof(ll_addr)) )
+   {
+      log_softerror_and_alarm("[Radio] Batched rx: failed to bind raw socket to [%s], error: %s", pRadioHWInfo->szName, strerror(errno));
+      close(iSocket);
+      return -1;
+   }
+
+   // Room for a few video frames worth of packets while the rx thread is busy
+   int iRcvBuf = 2*1024*1024;
+   if ( 0 != setsockopt(iSocket, SOL_SOCKET, SO_RCVBUFFORCE, &iRcvBuf, sizeof(iRcvBuf)) )
+      setsockopt(iSocket, SOL_SOCKET, SO_RCVBUF, &iRcvBuf, sizeof(iRcvBuf));
+
+   type_radio_rx_burst* pBurst = (type_radio_rx_burst*) malloc(sizeof(type_radio_rx_burst));
+   if ( NULL == pBurst )
+   {
+      log_softerror_and_alarm("[Radio] Batched rx: failed to allocate burst buffers for [%s]", pRadioHWInfo->szName);
+      close(iSocket);
+      return -1;
+   }
+   memset(pBurst, 0, sizeof(type_radio_rx_burst) - sizeof(pBurst->uFrames));
+   pBurst->iSocketFd = iSocket;
+   for( int i=0; i<RADIO_RX_BURST_SIZE; i++ )
+   {
+      pBurst->iovecs[i].iov_base = pBurst->uFrames[i];
+      pBurst->iovecs[i].iov_len = MAX_PACKET_LENGTH_PCAP;
+      pBurst->msgs[i].msg_hdr.msg_iov = &(pBurst->iovecs[i]);
+      pBurst->msgs[i].msg_hdr.msg_iovlen = 1;
+   }
+   s_pRadioRxBursts[interfaceIndex] = pBurst;
+   log_line("[Radio] Opened batched rx socket fd %d for radio interface %d [%s], burst size: %d frames", iSocket, interfaceIndex+1, pRadioHWInfo->szName, RADIO_RX_BURST_SIZE);
+   return iSocket;
+}
+
+// Returns the next received frame from the current burst, reading a new burst if the current one is consumed.
+// Returns NULL if there is nothing to read or on read error (s_iRadioLastReadErrorCode is set)
+
+u8* _radio_rx_burst_next_frame(int interfaceIndex, radio_hw_info_t* pRadioHWInfo, int* piFrameLength)
+{
+   type_radio_rx_burst* pBurst = s_pRadioRxBursts[interfaceIndex];
+
+   while ( 1 )
+   {
+      if ( pBurst->iNextFrame >= pBurst->iCountFrames )
+      {
+         pBurst->iNextFrame = 0;
+         pBurst->iCountFrames = 0;
+         for( int i=0; i<RADIO_RX_BURST_SIZE; i++ )
+            pBurst->msgs[i].msg_hdr.msg_flags = 0;
+
+         int iRes = recvmmsg(pBurst->iSocketFd, pBurst->msgs, RADIO_RX_BURST_SIZE, MSG_DONTWAIT, NULL);
+         if ( iRes <= 0 )
+         {
+            if ( (iRes < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR) )
+            {
+               pRadioHWInfo->runtimeInterfaceInfoRx.iErrorCount++;
+               if ( (errno == ENETDOWN) || (errno == ENXIO) || (errno == ENODEV) )
+               {
+                  s_iRadioLastReadErrorCode = RADIO_READ_ERROR_INTERFACE_BROKEN;
+                  log_softerror_and_alarm("[Radio] Batched rx ERROR: Radio interface %d (%s) went down. Error count: %d, fd = %d",
+                     interfaceIndex+1, pRadioHWInfo->szName, pRadioHWInfo->runtimeInterfaceInfoRx.iErrorCount, pBurst->iSocketFd);
+               }
+               else
+               {
+                  s_iRadioLastReadErrorCode = RADIO_READ_ERROR_READ_ERROR;
+                  log_softerror_and_alarm("[Radio] Batched rx ERROR on radio interface %d: %s, error count: %d", interfaceIndex+1, strerror(errno), pRadioHWInfo->runtimeInterfaceInfoRx.iErrorCount);
+               }
+            }
+            return NULL;
+         }
+         pBurst->iCountFrames = iRes;
+         pBurst->uTotalBursts++;
+         pBurst->uTotalFrames += (u32)iRes;
+      }
+
+      int iFrame = pBurst->iNextFrame;
+      pBurst->iNextFrame++;
+      if ( pBurst->msgs[iFrame].msg_hdr.msg_flags & MSG_TRUNC )
+      {
+         pBurst->uTotalTruncatedFrames++;
+         continue;
+      }
+      *piFrameLength = (int)pBurst->msgs[iFrame].msg_len;
+      return pBurst->uFrames[iFrame];
+   }
+   return NULL;
+}
+
+int radio_has_pending_rx_frames(int interfaceIndex)
+{
+   if ( (interfaceIndex < 0) || (interfaceIndex >= MAX_RADIO_INTERFACES) )
+      return 0;
+   if ( NULL == s_pRadioRxBursts[interfaceIndex] )
+      return 0;
+   return (s_pRadioRxBursts[interfaceIndex]->iNextFrame < s_pRadioRxBursts[interfaceIndex]->iCountFrames)?1:0;
+}
+
 int _radio_open_interface_for_read_with_filter(int interfaceIndex, char* szFilter, char* szFilterPrism)
 {
    s_iRadioInterfacesBroken = 0;
@@ -656,14 +871,30 @@ int _radio_open_interface_for_read_with_filter(int interfaceIndex, char* szFilte
    }
    else
    {
-      if (pcap_setfilter(pRadioHWInfo->runtimeInterfaceInfoRx.ppcap, &bpfprogram) == -1)
+      int iBurstSocket = -1;
+      if ( s_iUseBatchedRx )
+         iBurstSocket = _radio_open_rx_burst_socket(interfaceIndex, pRadioHWInfo, &bpfprogram);
+
+      if ( iBurstSocket >= 0 )
       {
-         log_softerror_and_alarm("Failed to set pcap filter: %s", szProgram);
-         log_softerror_and_alarm("Failed to set pacp filter: %s", pcap_geterr(pRadioHWInfo->runtimeInterfaceInfoRx.ppcap));
+         // The raw socket gets the same frames; don't keep the pcap ring around too
+         pcap_freecode(&bpfprogram);
+         pcap_close(pRadioHWInfo->runtimeInterfaceInfoRx.ppcap);
+         pRadioHWInfo->runtimeInterfaceInfoRx.ppcap = NULL;
+         pRadioHWInfo->runtimeInterfaceInfoRx.selectable_fd = iBurstSocket;
+      }
+      else
+      {
+         if (pcap_setfilter(pRadioHWInfo->runtimeInterfaceInfoRx.ppcap, &bpfprogram) == -1)
+         {
+            log_softerror_and_alarm("Failed to set pcap filter: %s", szProgram);
+            log_softerror_and_alarm("Failed to set pacp filter: %s", pcap_geterr(pRadioHWInfo->runtimeInterfaceInfoRx.ppcap));
+         }
+         pcap_freecode(&bpfprogram);
       }
-      pcap_freecode(&bpfprogram);
    }
-   pRadioHWInfo->runtimeInterfaceInfoRx.selectable_fd = pcap_get_selectable_fd(pRadioHWInfo->runtimeInterfaceInfoRx.ppcap);
+   if ( NULL != pRadioHWInfo->runtimeInterfaceInfoRx.ppcap )
+      pRadioHWInfo->runtimeInterfaceInfoRx.selectable_fd = pcap_get_selectable_fd(pRadioHWInfo->runtimeInterfaceInfoRx.ppcap);
    reset_runtime_radio_rx_info(&(pRadioHWInfo->runtimeInterfaceInfoRx.radioHwRxInfo));
 
    pRadioHWInfo->openedForRead = 1;
@@ -807,6 +1038,24 @@ int radio_open_interface_for_write(int interfaceIndex)
           return -1;
       }
       log_line("Opened socket for write fd=%d.", pRadioHWInfo->runtimeInterfaceInfoTx.selectable_fd);
+
+      if ( (interfaceIndex >= 0) && (interfaceIndex < MAX_RADIO_INTERFACES) && (NULL == s_pRadioTxBatches[interfaceIndex]) )
+      {
+         type_radio_tx_batch* pBatch = (type_radio_tx_batch*) malloc(sizeof(type_radio_tx_batch));
+         if ( NULL == pBatch )
+            log_softerror_and_alarm("[Radio] Failed to allocate tx batch buffers for radio interface %d. Will send frames one by one.", interfaceIndex+1);
+         else
+         {
+            memset(pBatch, 0, sizeof(type_radio_tx_batch) - sizeof(pBatch->uFrames));
+            for( int i=0; i<RADIO_TX_BATCH_SIZE; i++ )
+            {
+               pBatch->iovecs[i].iov_base = pBatch->uFrames[i];
+               pBatch->msgs[i].msg_hdr.msg_iov = &(pBatch->iovecs[i]);
+               pBatch->msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            s_pRadioTxBatches[interfaceIndex] = pBatch;
+         }
+      }
    }
 
    pRadioHWInfo->openedForWrite = 1;
@@ -830,9 +1079,13 @@ void radio_close_interface_for_read(int interfaceIndex)
       log_line("Closed radio interface %d [%s] that was used for read, selectable read fd was: %d, ppcap was: %d", interfaceIndex+1, pRadioHWInfo->szName, pRadioHWInfo->runtimeInterfaceInfoRx.selectable_fd, pRadioHWInfo->runtimeInterfaceInfoRx.ppcap);
       pcap_close(pRadioHWInfo->runtimeInterfaceInfoRx.ppcap);
    }
+   else if ( (interfaceIndex < MAX_RADIO_INTERFACES) && (NULL != s_pRadioRxBursts[interfaceIndex]) )
+      log_line("Closed radio interface %d [%s] that was used for read, selectable read fd was: %d (batched rx)", interfaceIndex+1, pRadioHWInfo->szName, pRadioHWInfo->runtimeInterfaceInfoRx.selectable_fd);
    else
       log_line("Radio interface %d was not opened for read.", interfaceIndex+1);
 
+   _radio_close_rx_burst_socket(interfaceIndex);
+
    pRadioHWInfo->runtimeInterfaceInfoRx.ppcap = NULL;
    pRadioHWInfo->runtimeInterfaceInfoRx.selectable_fd = -1;
    pRadioHWInfo->runtimeInterfaceInfoRx.iErrorCount = 0;
@@ -878,6 +1131,15 @@ void radio_close_interface_for_write(int interfaceIndex)
          log_line("Radio interface %d was not opened for write.", interfaceIndex+1);
    }
 
+   if ( (interfaceIndex >= 0) && (interfaceIndex < MAX_RADIO_INTERFACES) && (NULL != s_pRadioTxBatches[interfaceIndex]) )
+   {
+      type_radio_tx_batch* pBatch = s_pRadioTxBatches[interfaceIndex];
+      log_line("[Radio] Tx batches on radio interface %d: %u batches, %u frames, %u failed frames, %d frames discarded on close.",
+         interfaceIndex+1, pBatch->uTotalBatches, pBatch->uTotalFrames, pBatch->uTotalFailedFrames, pBatch->iCountFrames);
+      free(pBatch);
+      s_pRadioTxBatches[interfaceIndex] = NULL;
+   }
+
    pRadioHWInfo->runtimeInterfaceInfoTx.ppcap = NULL;
    pRadioHWInfo->runtimeInterfaceInfoTx.selectable_fd = -1;
    pRadioHWInfo->runtimeInterfaceInfoTx.iErrorCount = 0;
@@ -973,9 +1235,28 @@ u8* radio_process_wlan_data_in(int interfaceNumber, int* piOutPacketLength, int*
    */
    struct pcap_pkthdr pcapHeader;
    ppcapPacketHeader = &pcapHeader;
-   pRadioPayload = (u8*) pcap_next(pRadioHWInfo->runtimeInterfaceInfoRx.ppcap, ppcapPacketHeader); 
+   int iFromBurst = 0;
+   if ( (interfaceNumber >= 0) && (interfaceNumber < MAX_RADIO_INTERFACES) && (NULL != s_pRadioRxBursts[interfaceNumber]) )
+   {
+      int iFrameLength = 0;
+      pRadioPayload = _radio_rx_burst_next_frame(interfaceNumber, pRadioHWInfo, &iFrameLength);
+      pcapHeader.caplen = (u32)iFrameLength;
+      pcapHeader.len = (u32)iFrameLength;
+      iFromBurst = 1;
+   }
+   else if ( NULL != pRadioHWInfo->runtimeInterfaceInfoRx.ppcap )
+      pRadioPayload = (u8*) pcap_next(pRadioHWInfo->runtimeInterfaceInfoRx.ppcap, ppcapPacketHeader); 
+   else
+      pRadioPayload = NULL;
+
    if ( NULL == pRadioPayload )
+   {
+      #ifdef FEATURE_RADIO_SYNCHRONIZE_RXTX_THREADS
+      if ( 1 == s_iMutexRadioSyncRxTxThreadsInitialized )
+         pthread_mutex_unlock(&s_pMutexRadioSyncRxTxThreads);
+      #endif
       return NULL;
+   }
    #ifdef DEBUG_PACKET_RECEIVED
    log_line("RX Buffer: caplen: %d bytes, len: %d", ppcapPacketHeader->caplen, ppcapPacketHeader->len);
    #endif
@@ -1282,7 +1563,9 @@ u8* radio_process_wlan_data_in(int interfaceNumber, int* piOutPacketLength, int*
    }
    #endif
 
-   //return pRadioPayload;
+   // Burst frames stay valid until the next read on this interface, so hand them out in place
+   if ( iFromBurst )
+      return pRadioPayload;
    memcpy(sPayloadBufferRead, pRadioPayload, payloadLength);
    return sPayloadBufferRead;
 }
@@ -1332,7 +1615,31 @@ int packet_process_and_check(int interfaceNb, u8* pPacketBuffer, int iBufferLeng
       return 0;
    }
 
-   if ( uPacketFlags & PACKET_FLAGS_BIT_HAS_ENCRYPTION )
+   if ( uPacketFlags & PACKET_FLAGS_BIT_HAS_AUTH_ENCRYPTION )
+   {
+      // The header is authenticated as sent (with the trailer included in the total length),
+      // then the trailer is removed so that the CRC, computed by the sender before encryption, matches.
+      int dx = sizeof(t_packet_header);
+      int l = iPacketLength - dx - ENC_AUTH_TRAILER_SIZE;
+      if ( (l < 0) || (! dppa(pPH->vehicle_id_src, pPacketBuffer, dx, pPacketBuffer + dx, l, pPacketBuffer + dx + l)) )
+      {
+         s_iLastProcessingErrorCode = RADIO_PROCESSING_ERROR_CODE_AUTHENTICATION_FAILED;
+         #ifdef DEBUG_PACKET_RECEIVED
+         log_line("Received packet failed authentication, packet length: %d bytes", iPacketLength);
+         #endif
+         return 0;
+      }
+      iPacketLength -= ENC_AUTH_TRAILER_SIZE;
+      pPH->total_length = iPacketLength;
+      pPH->packet_flags &= ~PACKET_FLAGS_BIT_HAS_AUTH_ENCRYPTION;
+   }
+   else if ( s_iRequireAuthEncryption && ((0 == s_uRequireAuthExemptVehicleId) || (pPH->vehicle_id_src != s_uRequireAuthExemptVehicleId)) )
+   {
+      // Obfuscated or plain packets could be forged by anyone; only the authenticated ones are accepted
+      s_iLastProcessingErrorCode = RADIO_PROCESSING_ERROR_CODE_AUTHENTICATION_FAILED;
+      return 0;
+   }
+   else if ( uPacketFlags & PACKET_FLAGS_BIT_HAS_ENCRYPTION )
    {
       #ifdef DEBUG_PACKET_RECEIVED
       log_line("enc detected");
@@ -1463,7 +1770,25 @@ int radio_build_new_raw_ieee_packet(int iLocalRadioLinkId, u8* pRawPacket, u8* p
   
    t_packet_header* pPH = (t_packet_header*)pRawPacket;
    pPH->radio_link_packet_index = uRadioLinkPacketIndex;
-   if ( bEncrypt )
+
+   // The authenticated mode adds a trailer after the packet; a packet it does not fit in is not sent
+   // (the receiver would drop it anyway, it requires authentication)
+   if ( bEncrypt == ENC_MODE_AUTHENTICATED )
+   if ( totalRadioLength - nInputLength + pPH->total_length + ENC_AUTH_TRAILER_SIZE > MAX_PACKET_TOTAL_SIZE )
+   {
+      s_uAuthOversizePacketsDropped++;
+      u32 uTimeNow = get_current_timestamp_ms();
+      if ( uTimeNow > s_uTimeLastLogAuthOversizePackets + 5000 )
+      {
+         log_line("[RadioLink] Dropped %u packets too big for authenticated encryption (last one: %d bytes, type: %s).",
+            s_uAuthOversizePacketsDropped, pPH->total_length, str_get_packet_type(pPH->packet_type));
+         s_uTimeLastLogAuthOversizePackets = uTimeNow;
+         s_uAuthOversizePacketsDropped = 0;
+      }
+      return 0;
+   }
+
+   if ( bEncrypt && (bEncrypt != ENC_MODE_AUTHENTICATED) )
       pPH->packet_flags |= PACKET_FLAGS_BIT_HAS_ENCRYPTION;
 
    if ( pPH->packet_flags & PACKET_FLAGS_BIT_HEADERS_ONLY_CRC )
@@ -1471,7 +1796,21 @@ int radio_build_new_raw_ieee_packet(int iLocalRadioLinkId, u8* pRawPacket, u8* p
    else
       radio_packet_compute_crc((u8*)pPH, pPH->total_length);
 
-   if ( bEncrypt )
+   // The CRC is computed on the packet as the receiver sees it after decryption: without the trailer and flag
+   if ( bEncrypt == ENC_MODE_AUTHENTICATED )
+   {
+      int dx = sizeof(t_packet_header);
+      int iLength = pPH->total_length;
+      pPH->total_length += ENC_AUTH_TRAILER_SIZE;
+      pPH->packet_flags |= PACKET_FLAGS_BIT_HAS_AUTH_ENCRYPTION;
+      if ( ! eppa(pPH->vehicle_id_src, pRawPacket, dx, pRawPacket+dx, iLength-dx, pRawPacket+iLength) )
+      {
+         log_softerror_and_alarm("[RadioLink] No pass phrase for authenticated encryption, packet not sent.");
+         return 0;
+      }
+      totalRadioLength += pPH->total_length - nInputLength;
+   }
+   else if ( bEncrypt )
    {
       int dx = sizeof(t_packet_header);
       epp(pRawPacket+dx, pPH->total_length-dx);
@@ -1480,6 +1819,106 @@ int radio_build_new_raw_ieee_packet(int iLocalRadioLinkId, u8* pRawPacket, u8* p
 }
 
 
+// Returns the number of frames that failed to send
+
+int _radio_tx_batch_flush_interface(int interfaceIndex, radio_hw_info_t* pRadioHWInfo)
+{
+   type_radio_tx_batch* pBatch = s_pRadioTxBatches[interfaceIndex];
+   if ( (NULL == pBatch) || (0 == pBatch->iCountFrames) )
+      return 0;
+
+   #ifdef FEATURE_RADIO_SYNCHRONIZE_RXTX_THREADS
+   if ( 1 == s_iMutexRadioSyncRxTxThreadsInitialized )
+      pthread_mutex_lock(&s_pMutexRadioSyncRxTxThreads);
+   #endif
+
+   int iFailed = 0;
+   int iFirstError = 0;
+   int iStart = 0;
+   while ( iStart < pBatch->iCountFrames )
+   {
+      int iRes = sendmmsg(pRadioHWInfo->runtimeInterfaceInfoTx.selectable_fd, &(pBatch->msgs[iStart]), (unsigned int)(pBatch->iCountFrames - iStart), 0);
+      if ( iRes <= 0 )
+      {
+         // The frame at iStart was rejected; account it and go on with the rest of the batch
+         if ( 0 == iFailed )
+            iFirstError = errno;
+         iFailed++;
+         iStart++;
+         continue;
+      }
+      for( int i=iStart; i<iStart+iRes; i++ )
+      {
+         if ( pBatch->msgs[i].msg_len < pBatch->iovecs[i].iov_len )
+            iFailed++;
+      }
+      iStart += iRes;
+   }
+
+   #ifdef FEATURE_RADIO_SYNCHRONIZE_RXTX_THREADS
+   if ( 1 == s_iMutexRadioSyncRxTxThreadsInitialized )
+      pthread_mutex_unlock(&s_pMutexRadioSyncRxTxThreads);
+   #endif
+
+   pBatch->uTotalBatches++;
+   pBatch->uTotalFrames += (u32)pBatch->iCountFrames;
+   pBatch->uTotalFailedFrames += (u32)iFailed;
+
+   if ( iFailed > 0 )
+   {
+      log_softerror_and_alarm("RadioError: Failed to send %d of %d radio messages on radio interface %d, fd=%d, error: %s",
+         iFailed, pBatch->iCountFrames, interfaceIndex+1, pRadioHWInfo->runtimeInterfaceInfoTx.selectable_fd, (0 != iFirstError)?strerror(iFirstError):"partial write");
+      pRadioHWInfo->runtimeInterfaceInfoTx.iErrorCount += iFailed;
+   }
+   else
+      pRadioHWInfo->runtimeInterfaceInfoTx.iErrorCount = 0;
+
+   pBatch->iCountFrames = 0;
+   return iFailed;
+}
+
+// Returns 1 if batching is used (tx is done using sockets), 0 if frames will still be sent one by one
+
+int radio_tx_batch_begin()
+{
+   if ( s_iUsePCAPForTx )
+      return 0;
+   s_iRadioTxBatchActive = 1;
+   return 1;
+}
+
+int radio_tx_batch_is_active()
+{
+   return s_iRadioTxBatchActive;
+}
+
+// Sends all queued frames, keeps the batch open. Returns the number of frames that failed to send
+
+int radio_tx_batch_flush()
+{
+   int iFailed = 0;
+   for( int i=0; i<hardware_get_radio_interfaces_count() && i<MAX_RADIO_INTERFACES; i++ )
+   {
+      if ( (NULL == s_pRadioTxBatches[i]) || (0 == s_pRadioTxBatches[i]->iCountFrames) )
+         continue;
+      radio_hw_info_t* pRadioHWInfo = hardware_get_radio_info(i);
+      if ( (NULL == pRadioHWInfo) || (0 == pRadioHWInfo->openedForWrite) || (pRadioHWInfo->runtimeInterfaceInfoTx.selectable_fd < 0) )
+      {
+         s_pRadioTxBatches[i]->iCountFrames = 0;
+         continue;
+      }
+      iFailed += _radio_tx_batch_flush_interface(i, pRadioHWInfo);
+   }
+   return iFailed;
+}
+
+int radio_tx_batch_end()
+{
+   int iFailed = radio_tx_batch_flush();
+   s_iRadioTxBatchActive = 0;
+   return iFailed;
+}
+
 int radio_write_raw_ieee_packet(int interfaceIndex, u8* pData, int dataLength, int iRepeatCount)
 {
    radio_hw_info_t* pRadioHWInfo = hardware_get_radio_info(interfaceIndex);
@@ -1516,6 +1955,26 @@ int radio_write_raw_ieee_packet(int interfaceIndex, u8* pData, int dataLength, i
      pPH = NULL;
    */
 
+   type_radio_tx_batch* pBatch = NULL;
+   if ( (interfaceIndex >= 0) && (interfaceIndex < MAX_RADIO_INTERFACES) && (! s_iUsePCAPForTx) )
+      pBatch = s_pRadioTxBatches[interfaceIndex];
+
+   if ( (NULL != pBatch) && s_iRadioTxBatchActive && (0 == iRepeatCount) && (dataLength <= MAX_PACKET_TOTAL_SIZE) )
+   {
+      if ( pBatch->iCountFrames >= RADIO_TX_BATCH_SIZE )
+         _radio_tx_batch_flush_interface(interfaceIndex, pRadioHWInfo);
+      memcpy(pBatch->uFrames[pBatch->iCountFrames], pData, dataLength);
+      pBatch->iovecs[pBatch->iCountFrames].iov_len = (size_t)dataLength;
+      pBatch->iCountFrames++;
+      s_uPacketsSentUsingCurrent_RadioRate++;
+      s_uPacketsSentUsingCurrent_RadioFlags++;
+      return 1;
+   }
+
+   // Keep frames order: anything queued on this interface goes out first
+   if ( (NULL != pBatch) && (pBatch->iCountFrames > 0) )
+      _radio_tx_batch_flush_interface(interfaceIndex, pRadioHWInfo);
+
    #ifdef FEATURE_RADIO_SYNCHRONIZE_RXTX_THREADS
    if ( 1 == s_iMutexRadioSyncRxTxThreadsInitialized )
       pthread_mutex_lock(&s_pMutexRadioSyncRxTxThreads);
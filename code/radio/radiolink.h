@@ -41,10 +41,13 @@
 #include <sys/resource.h>
 
 #define MAX_PACKET_LENGTH_PCAP 4096
+#define RADIO_RX_BURST_SIZE 16
+#define RADIO_TX_BATCH_SIZE MAX_TOTAL_PACKETS_IN_BLOCK
 
 #define RADIO_PROCESSING_ERROR_NO_ERROR 0x00
 #define RADIO_PROCESSING_ERROR_CODE_INVALID_CRC_RECEIVED 0x01
 #define RADIO_PROCESSING_ERROR_CODE_PACKET_RECEIVED_TOO_SMALL 0x02
+#define RADIO_PROCESSING_ERROR_CODE_AUTHENTICATION_FAILED 0x03
 #define RADIO_PROCESSING_ERROR_INVALID_PARAMETERS 0x0E
 #define RADIO_PROCESSING_ERROR_INVALID_RECEIVED_PACKET 0x0F
 
@@ -65,7 +68,11 @@ void radio_set_debug_flag(int iDebugFlag);
 void radio_set_link_clock_delta(int iVehicleBehindMilisec);
 int  radio_get_link_clock_delta();
 void radio_set_use_pcap_for_tx(int iEnablePCAPTx);
+void radio_set_use_batched_rx(int iEnableBatchedRx);
 void radio_set_bypass_socket_buffers(int iBypass);
+// Drop the received packets that are not authenticated (for models with MODEL_ENC_FLAG_AUTHENTICATED),
+// except the ones from uExemptVehicleId (a relayed vehicle, it has its own encryption settings; 0 for none)
+void radio_set_require_auth_encryption(int iRequire, u32 uExemptVehicleId);
 int  radio_set_out_datarate(int rate_bps, u8 uPacketType, u32 uTimeNow); // positive: classic in bps, negative: MCS; returns 1 if it was changed
 u32  radio_get_current_frames_flags();
 u32  radio_get_current_frames_flags_datarate();
@@ -88,6 +95,8 @@ void radio_close_interface_for_write(int interfaceIndex);
 
 u8* radio_process_wlan_data_in(int interfaceNumber, int* piOutPacketLength, int* piOutRxDatarate, u32 uTimeNow);
 int radio_get_last_read_error_code();
+// Frames already read from the interface in the last burst and not yet processed (poll won't report them)
+int radio_has_pending_rx_frames(int interfaceIndex);
 
 // returns 0 for failure, total length of packet for success
 int packet_process_and_check(int interfaceNb, u8* pPacketBuffer, int iBufferLength, int* pbCRCOk);
@@ -96,6 +105,14 @@ int get_last_processing_error_code();
 u32 radio_get_next_radio_link_packet_index(int iLocalRadioLinkId);
 int radio_build_new_raw_ieee_packet(int iLocalRadioLinkId, u8* pRawPacket, u8* pPacketData, int nInputLength, int portNb, int bEncrypt);
 int radio_write_raw_ieee_packet(int interfaceIndex, u8* pData, int dataLength, int iRepeatCount);
+
+// Tx batching (socket tx only): while a batch is open, radio_write_raw_ieee_packet() queues
+// the frames and flush sends them with one syscall per radio interface.
+// Flush/end return the number of queued frames that failed to send.
+int radio_tx_batch_begin();
+int radio_tx_batch_is_active();
+int radio_tx_batch_flush();
+int radio_tx_batch_end();
 int radio_write_serial_packet(int interfaceIndex, u8* pData, int dataLength, u32 uTimeNow);
 int radio_write_sik_packet(int interfaceIndex, u8* pData, int dataLength, u32 uTimeNow);
 
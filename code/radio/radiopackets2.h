@@ -84,6 +84,8 @@
 #define PACKET_FLAGS_BIT_RETRANSMITED     ((u8)(1<<4))
 // Deprecated in 9.7 (inclusive)
 // #define _FLAGS_BIT_EXTRA_DATA       ((u8)(1<<5))
+// Reused: payload encrypted with ChaCha20-Poly1305, followed by ENC_AUTH_TRAILER_SIZE bytes (nonce and tag)
+#define PACKET_FLAGS_BIT_HAS_AUTH_ENCRYPTION ((u8)(1<<5))
 #define PACKET_FLAGS_BIT_HAS_ENCRYPTION   ((u8)(1<<6))
 #define PACKET_FLAGS_BIT_HIGH_PRIORITY    ((u8)(1<<7))
 
@@ -273,8 +275,12 @@ typedef struct
 //         bit 0: contains re-requested packets
 //         bit 1: contains request for start of video frame packets at the end
 //         bit 2: contains request for end of video frame packets at the end
-//   u8: number of individual video packets requested
+//         bit 3: requests are packet ranges (from build 11705)
+//   u8: number of individual video packets (or packet ranges) requested
 //   (u32+u8)*n = each (video block index + video packet index) requested
+//   or, for packet ranges:
+//   (u32+u8+u8)*n = each (video block index + first video packet index + packets count) requested
+//   for both, video packet index 0xFF requests the full video block
 //   (u16+u8) frame id and frame packets from start to get
 //   (u16+u8) frame id and frame packets to EOF to get
 
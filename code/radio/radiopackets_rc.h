@@ -11,14 +11,16 @@
 // packet_header_rc_full_frame_upstream
 //
 #define RC_FULL_FRAME_FLAGS_HAS_INPUT 0x01
+#define RC_FULL_FRAME_FLAGS_HAS_INPUT_AGE 0x02 // extra_info1 is the time from reading the input to sending the frame
+#define RC_FULL_FRAME_INPUT_AGE_UNIT_MICROS 100 // 255 means 25.5 ms or more
 
 typedef struct
 {
    u8 rc_frame_index;
    u8 ch_lowBits[MAX_RC_CHANNELS]; // Channels lower part, values from 0 to 255.
    u8 ch_highBits[MAX_RC_CHANNELS/2];  // 4 extra most significant bits for each channel, channel 0 are the lowest bits,  making the channel final range from 0 to 4096, 1000 to 2000 used
-   u8 flags; // bit 0 - has input (on the controller side)
-   u8 extra_info1; // not used, for future use
+   u8 flags; // bit 0 - has input (on the controller side), bit 1 - has input age
+   u8 extra_info1; // input age, in RC_FULL_FRAME_INPUT_AGE_UNIT_MICROS units
    u8 extra_info2; // not used, for future use
    u8 extra_info3; // not used, for future use
 } ALIGN_STRUCT_SPEC_INFO t_packet_header_rc_full_frame_upstream;
@@ -26,6 +28,10 @@ typedef struct
 
 #define RC_INFO_HISTORY_SIZE 50 // every 50ms
 
+// extra_flags: RC input to FC latency on the vehicle side (air time not included), in RC_FULL_FRAME_INPUT_AGE_UNIT_MICROS units:
+// bits 0..7 - median, bits 8..15 - 95th percentile, bit 31 - latency info is present
+#define RC_INFO_EXTRA_FLAGS_HAS_LATENCY ((u32)1<<31)
+
 //----------------------------------------------
 // packet_header_rc_info_downstream
 //
@@ -39,7 +45,7 @@ typedef struct
    u8 history[RC_INFO_HISTORY_SIZE]; // bit 0..3 - count received, bit 4..7 - frames gap
    u8 last_history_slice;
    u8 rc_rssi;
-   u32 extra_flags; // not used now. for future use
+   u32 extra_flags; // see RC_INFO_EXTRA_FLAGS_*
 } ALIGN_STRUCT_SPEC_INFO t_packet_header_rc_info_downstream;
 
 
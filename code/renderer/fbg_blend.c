@@ -0,0 +1,386 @@
+/*
+    Copyright (c) 2018, 2019, 2020 THE AUTHOR (PETRU SOROAGA)
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string.h>
+#include "fbg_blend.h"
+
+#define FBG_BLEND_SKIP_THRESHOLD 120
+
+static void scalar_blend_row_tinted(unsigned char* pDest, const unsigned char* pSrc, int iCount, const unsigned char* pMixColor, int iUpdateAlpha, int iSkipMode) {
+    int i = 0;
+    for (i = 0; i < iCount; i += 1, pDest += 4, pSrc += 4) {
+        if (iSkipMode == FBG_BLEND_SKIP_LOW_ALPHA && pSrc[3] < FBG_BLEND_SKIP_THRESHOLD) {
+            continue;
+        }
+        if (iSkipMode == FBG_BLEND_SKIP_DARK && (pSrc[0] + pSrc[1] + pSrc[2]) < FBG_BLEND_SKIP_THRESHOLD) {
+            continue;
+        }
+        unsigned int r = (pSrc[0] * pMixColor[0]) >> 8;
+        unsigned int g = (pSrc[1] * pMixColor[1]) >> 8;
+        unsigned int b = (pSrc[2] * pMixColor[2]) >> 8;
+        unsigned int a = (pSrc[3] * pMixColor[3]) >> 8;
+        pDest[0] = (a * r + (255 - a) * pDest[0]) >> 8;
+        pDest[1] = (a * g + (255 - a) * pDest[1]) >> 8;
+        pDest[2] = (a * b + (255 - a) * pDest[2]) >> 8;
+        if (iUpdateAlpha) {
+            pDest[3] = pDest[3] + (((255 - pDest[3]) * a) >> 8);
+        }
+    }
+}
+
+static void scalar_blend_row_tinted_opaque(unsigned char* pDest, const unsigned char* pSrc, int iCount, const unsigned char* pMixColor) {
+    int i = 0;
+    for (i = 0; i < iCount; i += 1, pDest += 4, pSrc += 4) {
+        if (pSrc[3] < FBG_BLEND_SKIP_THRESHOLD) {
+            continue;
+        }
+        pDest[0] = (pSrc[0] * pMixColor[0]) >> 8;
+        pDest[1] = (pSrc[1] * pMixColor[1]) >> 8;
+        pDest[2] = (pSrc[2] * pMixColor[2]) >> 8;
+        pDest[3] = 0xFF;
+    }
+}
+
+static void scalar_blend_row_color(unsigned char* pDest, int iCount, unsigned char r, unsigned char g, unsigned char b, unsigned char a, int iUpdateAlpha) {
+    unsigned int ar = a * r, ag = a * g, ab = a * b, na = 255 - a;
+    int i = 0;
+    for (i = 0; i < iCount; i += 1, pDest += 4) {
+        pDest[0] = (ar + na * pDest[0]) >> 8;
+        pDest[1] = (ag + na * pDest[1]) >> 8;
+        pDest[2] = (ab + na * pDest[2]) >> 8;
+        if (iUpdateAlpha) {
+            pDest[3] = pDest[3] + (((255 - pDest[3]) * a) >> 8);
+        }
+    }
+}
+
+static void scalar_fill_row(unsigned char* pDest, int iCount, unsigned int uColor) {
+    int i = 0;
+    for (i = 0; i < iCount; i += 1, pDest += 4) {
+        memcpy(pDest, &uColor, 4);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FBG_BLEND_HAS_SSE2 1
+
+// 4 pixels per 128 bit register; the math is done on 16 bit lanes, two pixels per half.
+// All intermediate sums are at most 255*255, so they fit in unsigned 16 bits.
+
+__attribute__((target("sse2")))
+static inline __m128i sse2_blend_half(__m128i s16, __m128i d16, __m128i mix16, __m128i alphaLanes, int iUpdateAlpha) {
+    const __m128i c255 = _mm_set1_epi16(255);
+    __m128i t = _mm_srli_epi16(_mm_mullo_epi16(s16, mix16), 8);
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(t, 0xFF), 0xFF);
+    __m128i c = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(a, t), _mm_mullo_epi16(_mm_sub_epi16(c255, a), d16)), 8);
+    __m128i da = d16;
+    if (iUpdateAlpha) {
+        da = _mm_add_epi16(d16, _mm_srli_epi16(_mm_mullo_epi16(_mm_sub_epi16(c255, d16), a), 8));
+    }
+    return _mm_or_si128(_mm_andnot_si128(alphaLanes, c), _mm_and_si128(alphaLanes, da));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i sse2_keep_mask(__m128i s, int iSkipMode) {
+    const __m128i threshold = _mm_set1_epi32(FBG_BLEND_SKIP_THRESHOLD - 1);
+    const __m128i lowByte = _mm_set1_epi32(0xFF);
+    if (iSkipMode == FBG_BLEND_SKIP_LOW_ALPHA) {
+        return _mm_cmpgt_epi32(_mm_srli_epi32(s, 24), threshold);
+    }
+    __m128i sum = _mm_add_epi32(_mm_and_si128(s, lowByte), _mm_and_si128(_mm_srli_epi32(s, 8), lowByte));
+    sum = _mm_add_epi32(sum, _mm_and_si128(_mm_srli_epi32(s, 16), lowByte));
+    return _mm_cmpgt_epi32(sum, threshold);
+}
+
+__attribute__((target("sse2")))
+static void sse2_blend_row_tinted(unsigned char* pDest, const unsigned char* pSrc, int iCount, const unsigned char* pMixColor, int iUpdateAlpha, int iSkipMode) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mix16 = _mm_set_epi16(pMixColor[3], pMixColor[2], pMixColor[1], pMixColor[0], pMixColor[3], pMixColor[2], pMixColor[1], pMixColor[0]);
+    const __m128i alphaLanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    int i = 0;
+
+    for (; i + 4 <= iCount; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(pSrc + i * 4));
+        __m128i d = _mm_loadu_si128((const __m128i*)(pDest + i * 4));
+        __m128i lo = sse2_blend_half(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), mix16, alphaLanes, iUpdateAlpha);
+        __m128i hi = sse2_blend_half(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), mix16, alphaLanes, iUpdateAlpha);
+        __m128i res = _mm_packus_epi16(lo, hi);
+        if (iSkipMode != FBG_BLEND_SKIP_NONE) {
+            __m128i keep = sse2_keep_mask(s, iSkipMode);
+            res = _mm_or_si128(_mm_and_si128(keep, res), _mm_andnot_si128(keep, d));
+        }
+        _mm_storeu_si128((__m128i*)(pDest + i * 4), res);
+    }
+    if (i < iCount) {
+        scalar_blend_row_tinted(pDest + i * 4, pSrc + i * 4, iCount - i, pMixColor, iUpdateAlpha, iSkipMode);
+    }
+}
+
+__attribute__((target("sse2")))
+static void sse2_blend_row_tinted_opaque(unsigned char* pDest, const unsigned char* pSrc, int iCount, const unsigned char* pMixColor) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mix16 = _mm_set_epi16(255, pMixColor[2], pMixColor[1], pMixColor[0], 255, pMixColor[2], pMixColor[1], pMixColor[0]);
+    const __m128i alphaOpaque = _mm_set1_epi32((int)0xFF000000);
+    int i = 0;
+
+    for (; i + 4 <= iCount; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(pSrc + i * 4));
+        __m128i d = _mm_loadu_si128((const __m128i*)(pDest + i * 4));
+        __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), mix16), 8);
+        __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), mix16), 8);
+        __m128i res = _mm_or_si128(_mm_packus_epi16(lo, hi), alphaOpaque);
+        __m128i keep = sse2_keep_mask(s, FBG_BLEND_SKIP_LOW_ALPHA);
+        res = _mm_or_si128(_mm_and_si128(keep, res), _mm_andnot_si128(keep, d));
+        _mm_storeu_si128((__m128i*)(pDest + i * 4), res);
+    }
+    if (i < iCount) {
+        scalar_blend_row_tinted_opaque(pDest + i * 4, pSrc + i * 4, iCount - i, pMixColor);
+    }
+}
+
+__attribute__((target("sse2")))
+static void sse2_blend_row_color(unsigned char* pDest, int iCount, unsigned char r, unsigned char g, unsigned char b, unsigned char a, int iUpdateAlpha) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c255 = _mm_set1_epi16(255);
+    const __m128i a16 = _mm_set1_epi16(a);
+    const __m128i na16 = _mm_set1_epi16(255 - a);
+    const __m128i color16 = _mm_set_epi16(0, a * b, a * g, a * r, 0, a * b, a * g, a * r);
+    const __m128i alphaLanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    int i = 0;
+
+    for (; i + 4 <= iCount; i += 4) {
+        __m128i d = _mm_loadu_si128((const __m128i*)(pDest + i * 4));
+        __m128i half[2];
+        half[0] = _mm_unpacklo_epi8(d, zero);
+        half[1] = _mm_unpackhi_epi8(d, zero);
+        int k = 0;
+        for (k = 0; k < 2; k += 1) {
+            __m128i c = _mm_srli_epi16(_mm_add_epi16(color16, _mm_mullo_epi16(na16, half[k])), 8);
+            __m128i da = half[k];
+            if (iUpdateAlpha) {
+                da = _mm_add_epi16(half[k], _mm_srli_epi16(_mm_mullo_epi16(_mm_sub_epi16(c255, half[k]), a16), 8));
+            }
+            half[k] = _mm_or_si128(_mm_andnot_si128(alphaLanes, c), _mm_and_si128(alphaLanes, da));
+        }
+        _mm_storeu_si128((__m128i*)(pDest + i * 4), _mm_packus_epi16(half[0], half[1]));
+    }
+    if (i < iCount) {
+        scalar_blend_row_color(pDest + i * 4, iCount - i, r, g, b, a, iUpdateAlpha);
+    }
+}
+
+__attribute__((target("sse2")))
+static void sse2_fill_row(unsigned char* pDest, int iCount, unsigned int uColor) {
+    const __m128i color = _mm_set1_epi32((int)uColor);
+    int i = 0;
+    for (; i + 4 <= iCount; i += 4) {
+        _mm_storeu_si128((__m128i*)(pDest + i * 4), color);
+    }
+    if (i < iCount) {
+        scalar_fill_row(pDest + i * 4, iCount - i, uColor);
+    }
+}
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FBG_BLEND_HAS_NEON 1
+
+// 8 pixels at a time, deinterleaved into one register per channel by vld4
+
+static inline uint8x8_t neon_keep_mask(uint8x8x4_t s, int iSkipMode) {
+    if (iSkipMode == FBG_BLEND_SKIP_LOW_ALPHA) {
+        return vcgt_u8(s.val[3], vdup_n_u8(FBG_BLEND_SKIP_THRESHOLD - 1));
+    }
+    uint16x8_t sum = vaddw_u8(vaddl_u8(s.val[0], s.val[1]), s.val[2]);
+    return vmovn_u16(vcgtq_u16(sum, vdupq_n_u16(FBG_BLEND_SKIP_THRESHOLD - 1)));
+}
+
+static void neon_blend_row_tinted(unsigned char* pDest, const unsigned char* pSrc, int iCount, const unsigned char* pMixColor, int iUpdateAlpha, int iSkipMode) {
+    const uint8x8_t c255 = vdup_n_u8(255);
+    uint8x8_t mix[4];
+    int i = 0, k = 0;
+    for (k = 0; k < 4; k += 1) {
+        mix[k] = vdup_n_u8(pMixColor[k]);
+    }
+
+    for (; i + 8 <= iCount; i += 8) {
+        uint8x8x4_t s = vld4_u8(pSrc + i * 4);
+        uint8x8x4_t d = vld4_u8(pDest + i * 4);
+        uint8x8x4_t res;
+        uint8x8_t a = vshrn_n_u16(vmull_u8(s.val[3], mix[3]), 8);
+        uint8x8_t na = vsub_u8(c255, a);
+        for (k = 0; k < 3; k += 1) {
+            uint8x8_t t = vshrn_n_u16(vmull_u8(s.val[k], mix[k]), 8);
+            res.val[k] = vshrn_n_u16(vmlal_u8(vmull_u8(a, t), na, d.val[k]), 8);
+        }
+        res.val[3] = d.val[3];
+        if (iUpdateAlpha) {
+            res.val[3] = vadd_u8(d.val[3], vshrn_n_u16(vmull_u8(vsub_u8(c255, d.val[3]), a), 8));
+        }
+        if (iSkipMode != FBG_BLEND_SKIP_NONE) {
+            uint8x8_t keep = neon_keep_mask(s, iSkipMode);
+            for (k = 0; k < 4; k += 1) {
+                res.val[k] = vbsl_u8(keep, res.val[k], d.val[k]);
+            }
+        }
+        vst4_u8(pDest + i * 4, res);
+    }
+    if (i < iCount) {
+        scalar_blend_row_tinted(pDest + i * 4, pSrc + i * 4, iCount - i, pMixColor, iUpdateAlpha, iSkipMode);
+    }
+}
+
+static void neon_blend_row_tinted_opaque(unsigned char* pDest, const unsigned char* pSrc, int iCount, const unsigned char* pMixColor) {
+    uint8x8_t mix[3];
+    int i = 0, k = 0;
+    for (k = 0; k < 3; k += 1) {
+        mix[k] = vdup_n_u8(pMixColor[k]);
+    }
+
+    for (; i + 8 <= iCount; i += 8) {
+        uint8x8x4_t s = vld4_u8(pSrc + i * 4);
+        uint8x8x4_t d = vld4_u8(pDest + i * 4);
+        uint8x8_t keep = neon_keep_mask(s, FBG_BLEND_SKIP_LOW_ALPHA);
+        uint8x8x4_t res;
+        for (k = 0; k < 3; k += 1) {
+            res.val[k] = vbsl_u8(keep, vshrn_n_u16(vmull_u8(s.val[k], mix[k]), 8), d.val[k]);
+        }
+        res.val[3] = vbsl_u8(keep, vdup_n_u8(255), d.val[3]);
+        vst4_u8(pDest + i * 4, res);
+    }
+    if (i < iCount) {
+        scalar_blend_row_tinted_opaque(pDest + i * 4, pSrc + i * 4, iCount - i, pMixColor);
+    }
+}
+
+static void neon_blend_row_color(unsigned char* pDest, int iCount, unsigned char r, unsigned char g, unsigned char b, unsigned char a, int iUpdateAlpha) {
+    const uint8x8_t c255 = vdup_n_u8(255);
+    const uint8x8_t a8 = vdup_n_u8(a);
+    const uint8x8_t na8 = vdup_n_u8(255 - a);
+    uint16x8_t color[3];
+    int i = 0, k = 0;
+    color[0] = vdupq_n_u16(a * r);
+    color[1] = vdupq_n_u16(a * g);
+    color[2] = vdupq_n_u16(a * b);
+
+    for (; i + 8 <= iCount; i += 8) {
+        uint8x8x4_t d = vld4_u8(pDest + i * 4);
+        for (k = 0; k < 3; k += 1) {
+            d.val[k] = vshrn_n_u16(vmlal_u8(color[k], na8, d.val[k]), 8);
+        }
+        if (iUpdateAlpha) {
+            d.val[3] = vadd_u8(d.val[3], vshrn_n_u16(vmull_u8(vsub_u8(c255, d.val[3]), a8), 8));
+        }
+        vst4_u8(pDest + i * 4, d);
+    }
+    if (i < iCount) {
+        scalar_blend_row_color(pDest + i * 4, iCount - i, r, g, b, a, iUpdateAlpha);
+    }
+}
+
+static void neon_fill_row(unsigned char* pDest, int iCount, unsigned int uColor) {
+    const uint32x4_t color = vdupq_n_u32(uColor);
+    int i = 0;
+    for (; i + 4 <= iCount; i += 4) {
+        vst1q_u8(pDest + i * 4, vreinterpretq_u8_u32(color));
+    }
+    if (i < iCount) {
+        scalar_fill_row(pDest + i * 4, iCount - i, uColor);
+    }
+}
+#endif
+
+/*
+ * Kernels in use, selected by fbg_blend_set_use_simd()
+ */
+static void (*s_pBlendRowTinted)(unsigned char*, const unsigned char*, int, const unsigned char*, int, int) = NULL;
+static void (*s_pBlendRowTintedOpaque)(unsigned char*, const unsigned char*, int, const unsigned char*) = NULL;
+static void (*s_pBlendRowColor)(unsigned char*, int, unsigned char, unsigned char, unsigned char, unsigned char, int) = NULL;
+static void (*s_pFillRow)(unsigned char*, int, unsigned int) = NULL;
+static const char *s_szBlendKernelsName = "scalar";
+
+void fbg_blend_set_use_simd(int iUseSIMD) {
+    s_pBlendRowTinted = scalar_blend_row_tinted;
+    s_pBlendRowTintedOpaque = scalar_blend_row_tinted_opaque;
+    s_pBlendRowColor = scalar_blend_row_color;
+    s_pFillRow = scalar_fill_row;
+    s_szBlendKernelsName = "scalar";
+    if (!iUseSIMD) {
+        return;
+    }
+#if defined(FBG_BLEND_HAS_SSE2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        s_pBlendRowTinted = sse2_blend_row_tinted;
+        s_pBlendRowTintedOpaque = sse2_blend_row_tinted_opaque;
+        s_pBlendRowColor = sse2_blend_row_color;
+        s_pFillRow = sse2_fill_row;
+        s_szBlendKernelsName = "sse2";
+    }
+#elif defined(FBG_BLEND_HAS_NEON)
+    s_pBlendRowTinted = neon_blend_row_tinted;
+    s_pBlendRowTintedOpaque = neon_blend_row_tinted_opaque;
+    s_pBlendRowColor = neon_blend_row_color;
+    s_pFillRow = neon_fill_row;
+    s_szBlendKernelsName = "neon";
+#endif
+}
+
+const char* fbg_blend_get_kernels_name(void) {
+    return s_szBlendKernelsName;
+}
+
+void fbg_blend_row_tinted(unsigned char* pDest, const unsigned char* pSrc, int iCount, const unsigned char* pMixColor, int iUpdateAlpha, int iSkipMode) {
+    if (s_pBlendRowTinted == NULL) {
+        fbg_blend_set_use_simd(1);
+    }
+    s_pBlendRowTinted(pDest, pSrc, iCount, pMixColor, iUpdateAlpha, iSkipMode);
+}
+
+void fbg_blend_row_tinted_opaque(unsigned char* pDest, const unsigned char* pSrc, int iCount, const unsigned char* pMixColor) {
+    if (s_pBlendRowTintedOpaque == NULL) {
+        fbg_blend_set_use_simd(1);
+    }
+    s_pBlendRowTintedOpaque(pDest, pSrc, iCount, pMixColor);
+}
+
+void fbg_blend_row_color(unsigned char* pDest, int iCount, unsigned char r, unsigned char g, unsigned char b, unsigned char a, int iUpdateAlpha) {
+    if (s_pBlendRowColor == NULL) {
+        fbg_blend_set_use_simd(1);
+    }
+    s_pBlendRowColor(pDest, iCount, r, g, b, a, iUpdateAlpha);
+}
+
+void fbg_fill_row(unsigned char* pDest, int iCount, unsigned int uColor) {
+    if (s_pFillRow == NULL) {
+        fbg_blend_set_use_simd(1);
+    }
+    s_pFillRow(pDest, iCount, uColor);
+}
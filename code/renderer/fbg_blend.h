@@ -0,0 +1,61 @@
+/*
+    Copyright (c) 2018, 2019, 2020 THE AUTHOR (PETRU SOROAGA)
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Row kernels used by the fbgraphics alpha blending hot paths (text glyphs, images, filled rects).
+    // All pixels are RGBA, 4 bytes; the blending math is the one of fbg_pixela_fast():
+    //    dest.rgb = (a * src.rgb + (255 - a) * dest.rgb) >> 8
+    //    dest.a   = dest.a + (((255 - dest.a) * a) >> 8)  (only if iUpdateAlpha)
+    // The vector kernels give the exact same output as the scalar ones.
+
+    #define FBG_BLEND_SKIP_NONE 0
+    //! skip source pixels with alpha < 120
+    #define FBG_BLEND_SKIP_LOW_ALPHA 1
+    //! skip source pixels with r+g+b < 120 (font outline pixels)
+    #define FBG_BLEND_SKIP_DARK 2
+
+    //! selects the kernels: 1 = fastest vector kernels supported by this CPU (SSE2/NEON), 0 = scalar. Vector kernels are used by default.
+    extern void fbg_blend_set_use_simd(int iUseSIMD);
+    extern const char* fbg_blend_get_kernels_name(void);
+
+    //! tints the source pixels ((c * mix_color.c) >> 8, for all 4 channels) then blends them over the destination
+    extern void fbg_blend_row_tinted(unsigned char* pDest, const unsigned char* pSrc, int iCount, const unsigned char* pMixColor, int iUpdateAlpha, int iSkipMode);
+    //! source pixels with alpha < 120 are skipped, the others are tinted and written opaque (alpha blending disabled)
+    extern void fbg_blend_row_tinted_opaque(unsigned char* pDest, const unsigned char* pSrc, int iCount, const unsigned char* pMixColor);
+    //! blends a constant color over the destination
+    extern void fbg_blend_row_color(unsigned char* pDest, int iCount, unsigned char r, unsigned char g, unsigned char b, unsigned char a, int iUpdateAlpha);
+    //! fills with a constant RGBA color (r in the low byte)
+    extern void fbg_fill_row(unsigned char* pDest, int iCount, unsigned int uColor);
+
+#ifdef __cplusplus
+}
+#endif
@@ -117,6 +117,9 @@ struct _fbg *fbg_dispmanxSetup(uint32_t displayNumber, VC_IMAGE_TYPE_T image_typ
     }
 
     dispmanx_context->pitch = info.width * 4;
+    dispmanx_context->draw_rows_start[0] = 0;
+    dispmanx_context->draw_rows_end[0] = info.height;
+    dispmanx_context->draw_rows_count = 1;
 
     vc_dispmanx_rect_set(dispmanx_context->src_rect, 0, 0, info.width << 16, info.height << 16);
     vc_dispmanx_rect_set(dispmanx_context->dst_rect, 0, 0, info.width, info.height);
@@ -222,6 +225,41 @@ void fbg_dispmanxOnFlip(struct _fbg *fbg, void (*opt_flip)(struct _fbg *fbg)) {
     dispmanx_context->opt_flip = opt_flip;
 }
 
+void fbg_dispmanxSetDrawRows(struct _fbg *fbg, int row_start, int row_end) {
+    struct _fbg_dispmanx_context *dispmanx_context = fbg->user_context;
+
+    dispmanx_context->draw_rows_count = 0;
+    fbg_dispmanxAddDrawRows(fbg, row_start, row_end);
+}
+
+void fbg_dispmanxAddDrawRows(struct _fbg *fbg, int row_start, int row_end) {
+    struct _fbg_dispmanx_context *dispmanx_context = fbg->user_context;
+
+    if (row_start < 0) {
+        row_start = 0;
+    }
+    if (row_end > fbg->height) {
+        row_end = fbg->height;
+    }
+    if (row_end <= row_start) {
+        return;
+    }
+    // No more room: extend the last range
+    if (dispmanx_context->draw_rows_count >= FBG_DISPMANX_MAX_DRAW_ROWS_RANGES) {
+        int i = FBG_DISPMANX_MAX_DRAW_ROWS_RANGES - 1;
+        if (row_start < dispmanx_context->draw_rows_start[i]) {
+            dispmanx_context->draw_rows_start[i] = row_start;
+        }
+        if (row_end > dispmanx_context->draw_rows_end[i]) {
+            dispmanx_context->draw_rows_end[i] = row_end;
+        }
+        return;
+    }
+    dispmanx_context->draw_rows_start[dispmanx_context->draw_rows_count] = row_start;
+    dispmanx_context->draw_rows_end[dispmanx_context->draw_rows_count] = row_end;
+    dispmanx_context->draw_rows_count++;
+}
+
 void fbg_dispmanxDraw(struct _fbg *fbg) {
     struct _fbg_dispmanx_context *dispmanx_context = fbg->user_context;
 
@@ -233,7 +271,20 @@ void fbg_dispmanxDraw(struct _fbg *fbg) {
     buffer->length = buffer->alloc_size;
     mmal_port_send_buffer(dispmanx_context->input, buffer);
 #else
-    vc_dispmanx_resource_write_data(dispmanx_context->back_resource, dispmanx_context->resource_type, dispmanx_context->pitch, fbg->back_buffer, dispmanx_context->dst_rect);
+    int i = 0;
+    for (i = 0; i < dispmanx_context->draw_rows_count; i += 1) {
+        int row_start = dispmanx_context->draw_rows_start[i];
+        int row_end = dispmanx_context->draw_rows_end[i];
+        if ((row_start == 0) && (row_end >= fbg->height)) {
+            vc_dispmanx_resource_write_data(dispmanx_context->back_resource, dispmanx_context->resource_type, dispmanx_context->pitch, fbg->back_buffer, dispmanx_context->dst_rect);
+            continue;
+        }
+
+        // Only full rows are transferred (the rect x is not used); the source address is the start of the buffer, the rect y selects the first row
+        VC_RECT_T rows_rect;
+        vc_dispmanx_rect_set(&rows_rect, 0, row_start, fbg->width, row_end - row_start);
+        vc_dispmanx_resource_write_data(dispmanx_context->back_resource, dispmanx_context->resource_type, dispmanx_context->pitch, fbg->back_buffer, &rows_rect);
+    }
 #endif
 }
 
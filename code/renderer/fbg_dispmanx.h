@@ -52,6 +52,8 @@ extern "C" {
     #include <interface/mmal/util/mmal_util_params.h>
 #endif
 
+    #define FBG_DISPMANX_MAX_DRAW_ROWS_RANGES 32
+
     //! dispmanx wrapper data structure
     struct _fbg_dispmanx_context {
 #ifdef FBG_MMAL
@@ -85,6 +87,11 @@ extern "C" {
 
       //! fbg->width * 3
       int pitch;
+
+      //! rows ranges [draw_rows_start, draw_rows_end) written to the back resource on the next fbg_draw() call
+      int draw_rows_start[FBG_DISPMANX_MAX_DRAW_ROWS_RANGES];
+      int draw_rows_end[FBG_DISPMANX_MAX_DRAW_ROWS_RANGES];
+      int draw_rows_count;
     };
 
     //! initialize a FB Graphics dispmanx context
@@ -101,6 +108,22 @@ extern "C" {
     */
     extern void fbg_dispmanxOnFlip(struct _fbg *fbg, void (*opt_flip)(struct _fbg *fbg));
 
+    //! set the rows range to be written to the back resource on the next fbg_draw() call (the rest of the resource is left as is)
+    /*!
+      \param fbg FBG data structure pointer
+      \param row_start first row
+      \param row_end last row + 1 (row_end <= row_start: nothing is written)
+    */
+    extern void fbg_dispmanxSetDrawRows(struct _fbg *fbg, int row_start, int row_end);
+
+    //! add a rows range to be written to the back resource on the next fbg_draw() call (each range is written separately)
+    /*!
+      \param fbg FBG data structure pointer
+      \param row_start first row
+      \param row_end last row + 1 (row_end <= row_start: ignored)
+    */
+    extern void fbg_dispmanxAddDrawRows(struct _fbg *fbg, int row_start, int row_end);
+
 #endif
 
 #ifdef __cplusplus
@@ -40,6 +40,7 @@
 #endif
 
 #include "fbgraphics.h"
+#include "fbg_blend.h"
 
 #ifdef FBG_PARALLEL
     void fbg_terminateFragments(struct _fbg *fbg);
@@ -802,22 +803,9 @@ void fbg_hline(struct _fbg *fbg, int x, int y, int w, unsigned char r, unsigned
     unsigned char *pix_pointer = (unsigned char *)(fbg->back_buffer + (y * fbg->line_length + x * fbg->components));
 
     if ( fbg->s_iEnableAlpha )
-    {
-       for (int xx = 0; xx < w; xx++)
-       {
-         fbg_pixela_fast(fbg, pix_pointer, r,g,b,a);
-         pix_pointer += 4;
-       }
-    }
+       fbg_blend_row_color(pix_pointer, w, r,g,b,a, 1);
     else
-    {
-       u32 uColor = (((u32)a) << 24) | (((u32)b) << 16) | (((u32)g) << 8) | ((u32)r);
-       u32* pDest = (u32*)pix_pointer;
-       for (int xx = 0; xx < w; xx++)
-       {
-         *pDest++ = uColor;
-       }
-    }
+       fbg_fill_row(pix_pointer, w, (((u32)a) << 24) | (((u32)b) << 16) | (((u32)g) << 8) | ((u32)r));
 }
 
 void fbg_vline(struct _fbg *fbg, int x, int y, int h, unsigned char r, unsigned char g, unsigned char b, unsigned char a)
@@ -945,83 +933,42 @@ void fbg_polygon(struct _fbg *fbg, int num_vertices, int *vertices, unsigned cha
 
 void fbg_recta(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b, unsigned char a)
 {
-    int xx = 0, yy = 0, w4 = w * fbg->components;
+    int yy = 0;
 
     unsigned char *pix_pointer = (unsigned char *)(fbg->back_buffer + (y * fbg->line_length + x * fbg->components));
 
     for (yy = 0; yy < h; yy += 1)
     {
-        for (xx = 0; xx < w; xx += 1)
-        {
-           fbg_pixela_fast(fbg, pix_pointer, r,g,b,a);
-           //fbg_pixela(fbg, x + xx, y + yy, r,g,b,a);
-           pix_pointer += 4;
-        }
-
-        pix_pointer += (fbg->line_length - w4);
+        fbg_blend_row_color(pix_pointer, w, r,g,b,a, fbg->s_iEnableAlpha);
+        pix_pointer += fbg->line_length;
     }
 }
 
 void fbg_rect(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b, unsigned char a)
 {
-    int xx = 0, yy = 0, w3 = w * fbg->components;
+    int yy = 0;
 
     unsigned char *pix_pointer = (unsigned char *)(fbg->back_buffer + (y * fbg->line_length + x * fbg->components));
-    u32* pDest = NULL;
     u32 uColor = (((u32)a) << 24) | (((u32)b) << 16) | (((u32)g) << 8) | ((u32)r);
 
+    // First and last rows skip the corner pixels
     int dy = 0;
     if ( (h > 2) && (w > 2) )
     {
-       pix_pointer += fbg->components;
-       pDest = (u32*)pix_pointer;
-       for (xx = 1; xx < w-1; xx++)
-       {
-           //*pix_pointer++ = r;
-           //*pix_pointer++ = g;
-           //*pix_pointer++ = b;
-           //*pix_pointer++ = a;
-           //pix_pointer += fbg->comp_offset;
-           *pDest++ = uColor;
-       }
-       pix_pointer += (w-2)*fbg->components;
-       pix_pointer += fbg->components;
-       pix_pointer += (fbg->line_length - w3);
+       fbg_fill_row(pix_pointer + fbg->components, w-2, uColor);
+       pix_pointer += fbg->line_length;
        yy++;
        dy++;
     }
 
     for (; yy < h-dy; yy++)
     {
-       pDest = (u32*)pix_pointer;
-       for (xx = 0; xx < w; xx++)
-       {
-           //*pix_pointer++ = r;
-           //*pix_pointer++ = g;
-           //*pix_pointer++ = b;
-           //*pix_pointer++ = a;
-           //pix_pointer += fbg->comp_offset;
-           *pDest++ = uColor;
-       }
-       pix_pointer += w*fbg->components;
-
-       pix_pointer += (fbg->line_length - w3);
+       fbg_fill_row(pix_pointer, w, uColor);
+       pix_pointer += fbg->line_length;
     }
 
     if ( (h > 2) && (w > 2) )
-    {
-       pix_pointer += fbg->components;
-       pDest = (u32*)pix_pointer;
-       for (xx = 1; xx < w-1; xx++)
-       {
-           //*pix_pointer++ = r;
-           //*pix_pointer++ = g;
-           //*pix_pointer++ = b;
-           //*pix_pointer++ = a;
-           //pix_pointer += fbg->comp_offset;
-           *pDest++ = uColor;
-       }
-    }
+       fbg_fill_row(pix_pointer + fbg->components, w-2, uColor);
 }
 
 void fbg_frect(struct _fbg *fbg, int x, int y, int w, int h) {
@@ -1152,6 +1099,37 @@ void fbg_clear(struct _fbg *fbg, unsigned char color) {
     memset(fbg->back_buffer, color, fbg->size);
 }
 
+void fbg_clearRect(struct _fbg *fbg, int x, int y, int w, int h, unsigned char color) {
+    if (x < 0) {
+        w += x;
+        x = 0;
+    }
+    if (y < 0) {
+        h += y;
+        y = 0;
+    }
+    if (x + w > fbg->width) {
+        w = fbg->width - x;
+    }
+    if (y + h > fbg->height) {
+        h = fbg->height - y;
+    }
+    if (w <= 0 || h <= 0) {
+        return;
+    }
+
+    unsigned char *pointer = fbg->back_buffer + y * fbg->line_length + x * fbg->components;
+    if (x == 0 && w == fbg->width) {
+        memset(pointer, color, h * fbg->line_length);
+        return;
+    }
+    int i = 0;
+    for (i = 0; i < h; i += 1) {
+        memset(pointer, color, w * fbg->components);
+        pointer += fbg->line_length;
+    }
+}
+
 void fbg_enable_alpha(struct _fbg *fbg, int iEnable)
 {
    fbg->s_iEnableAlpha = iEnable;
@@ -1671,91 +1649,21 @@ void fbg_imageClipAColor(struct _fbg *fbg, struct _fbg_img *img, int x, int y, i
 {
     unsigned char *pDestPointer = (unsigned char *)(fbg->back_buffer + (y * fbg->line_length + x * fbg->components));
     unsigned char *pSrcPointer = (unsigned char *)(img->data + (cy * img->width * fbg->components + cx * fbg->components));
+    unsigned char mix[4] = { fbg->mix_color.r, fbg->mix_color.g, fbg->mix_color.b, fbg->mix_color.a };
 
     int i = 0;
-    //int w4 = _FBG_MIN(cw * fbg->components, (fbg->width - x) * fbg->components);
     int h = ch;
 
-    char r,g,b,a;
-
-    if ( ! fbg->s_iEnableAlpha )
-    {
-       for (i = 0; i < h; i += 1) 
-       {
-          for (int j=0; j<cw; j++ )
-          {
-            if ( *(pSrcPointer+3) < 120 )
-            {
-               pDestPointer += fbg->components;
-               pSrcPointer += fbg->components;
-               continue;
-            }
-            r = *pSrcPointer;
-            g = *(pSrcPointer+1);
-            b = *(pSrcPointer+2);
-            r = (r*fbg->mix_color.r)>>8;
-            g = (g*fbg->mix_color.g)>>8;
-            b = (b*fbg->mix_color.b)>>8;
-            //fbg_pixela_fast(fbg, pDestPointer, r,g,b,a);
-            *pDestPointer++ = r;
-            *pDestPointer++ = g;
-            *pDestPointer++ = b;
-            *pDestPointer++ = 0xFF;
-            pSrcPointer += fbg->components;
-          }
-          pDestPointer += fbg->line_length - cw*fbg->components;
-          pSrcPointer += img->width * fbg->components - cw*fbg->components;
-       }
-    }
-    else if ( fbg->disableFontOutline )
-    {
-       for (i = 0; i < h; i += 1) 
-       {
-          for (int j=0; j<cw; j++ )
-          {
-            if ( (*(pSrcPointer)) + (*(pSrcPointer+1)) + (*(pSrcPointer+2)) < 120 )
-            {
-               pDestPointer += 4;
-               pSrcPointer += 4;
-               continue;
-            }
-            r = *pSrcPointer;
-            g = *(pSrcPointer+1);
-            b = *(pSrcPointer+2);
-            a = *(pSrcPointer+3);
-            r = (r*fbg->mix_color.r)>>8;
-            g = (g*fbg->mix_color.g)>>8;
-            b = (b*fbg->mix_color.b)>>8;
-            a = (a*fbg->mix_color.a)>>8;
-            fbg_pixela_fast(fbg, pDestPointer, r,g,b,a);
-            pDestPointer += 4;
-            pSrcPointer += 4;
-          }
-          pDestPointer += fbg->line_length - cw*4;
-          pSrcPointer += img->width * fbg->components - cw*4;
-       }
-    }
-    else
+    for (i = 0; i < h; i += 1) 
     {
-       for (i = 0; i < h; i += 1) 
-       {
-          for (int j=0; j<cw; j++ )
-          {
-            r = *pSrcPointer;
-            g = *(pSrcPointer+1);
-            b = *(pSrcPointer+2);
-            a = *(pSrcPointer+3);
-            r = (r*fbg->mix_color.r)>>8;
-            g = (g*fbg->mix_color.g)>>8;
-            b = (b*fbg->mix_color.b)>>8;
-            a = (a*fbg->mix_color.a)>>8;
-            fbg_pixela_fast(fbg, pDestPointer, r,g,b,a);
-            pDestPointer += 4;
-            pSrcPointer += 4;
-          }
-          pDestPointer += fbg->line_length - cw*4;
-          pSrcPointer += img->width * fbg->components - cw*4;
-       }
+       if ( ! fbg->s_iEnableAlpha )
+          fbg_blend_row_tinted_opaque(pDestPointer, pSrcPointer, cw, mix);
+       else if ( fbg->disableFontOutline )
+          fbg_blend_row_tinted(pDestPointer, pSrcPointer, cw, mix, 1, FBG_BLEND_SKIP_DARK);
+       else
+          fbg_blend_row_tinted(pDestPointer, pSrcPointer, cw, mix, 1, FBG_BLEND_SKIP_NONE);
+       pDestPointer += fbg->line_length;
+       pSrcPointer += img->width * fbg->components;
     }
 }
 
@@ -1838,13 +1746,14 @@ void fbg_imageDraw(struct _fbg *fbg, struct _fbg_img *img, int x, int y, int w,
 void fbg_imageDrawAlpha(struct _fbg *fbg, struct _fbg_img *img, int x, int y, int w, int h, int cx, int cy, int cw, int ch)
 {
     unsigned char *scr_pointer = (unsigned char *)(fbg->back_buffer + (y * fbg->line_length + x * fbg->components));
-    char r,g,b,a;
+    unsigned char r,g,b,a;
 
     float dxImg = (float)cw/(float)w;
     float dyImg = (float)ch/(float)h;
 
     float yImg = cy;
     int iyImg = (int)yImg;
+    unsigned char mix[4] = { fbg->mix_color.r, fbg->mix_color.g, fbg->mix_color.b, fbg->mix_color.a };
     for( int sy=0; sy<h; sy++ )
     {
        iyImg = (int)yImg;
@@ -1852,7 +1761,13 @@ void fbg_imageDrawAlpha(struct _fbg *fbg, struct _fbg_img *img, int x, int y, in
           break;
        int yImgOffset = iyImg * img->width;
        float xImg = cx;
-       if ( fbg->s_iEnableAlpha )
+       if ( fbg->s_iEnableAlpha && (w == cw) )
+       {
+          // Not scaled horizontally: blend the whole row at once
+          fbg_blend_row_tinted(scr_pointer, img->data + (cx + yImgOffset) * fbg->components, w, mix, 1, FBG_BLEND_SKIP_NONE);
+          scr_pointer += w * fbg->components;
+       }
+       else if ( fbg->s_iEnableAlpha )
        {
           for( int sx=0; sx<w; sx++ )
           {
@@ -1903,7 +1818,8 @@ void fbg_imageDrawAlpha(struct _fbg *fbg, struct _fbg_img *img, int x, int y, in
 void fbg_imageDrawAlphaMask(struct _fbg *fbg, struct _fbg_img *img, int x, int y, int w, int h, int cx, int cy, int cw, int ch)
 {
     unsigned char *scr_pointer = (unsigned char *)(fbg->back_buffer + (y * fbg->line_length + x * fbg->components));
-    char r,g,b,a;
+    unsigned char r,g,b,a;
+    unsigned char mix[4] = { fbg->mix_color.r, fbg->mix_color.g, fbg->mix_color.b, fbg->mix_color.a };
 
     float dxImg = (float)cw/(float)w;
     float dyImg = (float)ch/(float)h;
@@ -1917,6 +1833,14 @@ void fbg_imageDrawAlphaMask(struct _fbg *fbg, struct _fbg_img *img, int x, int y
           break;
        int yImgOffset = iyImg * img->width;
        float xImg = cx;
+       if ( w == cw )
+       {
+          // Not scaled horizontally: blend the whole row at once
+          fbg_blend_row_tinted(scr_pointer, img->data + (cx + yImgOffset) * fbg->components, w, mix, fbg->s_iEnableAlpha, FBG_BLEND_SKIP_LOW_ALPHA);
+          scr_pointer += fbg->line_length;
+          yImg += dyImg;
+          continue;
+       }
        for( int sx=0; sx<w; sx++ )
        {
            unsigned char *img_pointer = (unsigned char *)(img->data + ((((int)xImg) + yImgOffset) * fbg->components));
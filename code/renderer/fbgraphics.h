@@ -386,6 +386,18 @@ extern "C" {
     */
     extern void fbg_clear(struct _fbg *fbg, unsigned char brightness);
 
+    //! grayscale clearing of a rectangle of the back buffer (clipped to the buffer)
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param x
+      \param y
+      \param w
+      \param h
+      \param brightness pixel brightness (grayscale)
+      \sa fbg_clear()
+    */
+    extern void fbg_clearRect(struct _fbg *fbg, int x, int y, int w, int h, unsigned char brightness);
+
     //! set the filling color for fast drawing operations
     /*!
       \param fbg pointer to a FBG context / data structure
@@ -126,11 +126,17 @@ RenderEngine::RenderEngine()
 
    m_CurrentRawFontId = 0;
    m_iCountRawFonts = 0;
+
+   m_pTextRuns = (type_text_run*) malloc(TEXT_RUNS_CACHE_SIZE * sizeof(type_text_run));
+   _invalidateTextRuns();
 }
 
 
 RenderEngine::~RenderEngine()
 {
+   if ( NULL != m_pTextRuns )
+      free(m_pTextRuns);
+   m_pTextRuns = NULL;
 }
 
 bool RenderEngine::initEngine()
@@ -603,6 +609,7 @@ int RenderEngine::loadRawFont(int iFamilyId, const char* szFontFile, int iBold)
    m_pRawFonts[m_iCountRawFonts]->dxLetters = 0.0;
    m_CurrentRawFontId++;
    m_RawFontIds[m_iCountRawFonts] = m_CurrentRawFontId;
+   _invalidateTextRuns();
 
    log_line("[RenderEngineRaw] Loaded font %s, id: %u (%d of max %d)",
        szFile, m_RawFontIds[m_iCountRawFonts], m_iCountRawFonts+1, MAX_RAW_FONTS);
@@ -634,6 +641,7 @@ void RenderEngine::freeRawFont(u32 idFont)
       m_RawFontIds[i] = m_RawFontIds[i+1];
    }
    m_iCountRawFonts--;
+   _invalidateTextRuns();
    log_line("[RenderEngineRaw] Unloaded font id %u, remaining fonts: %d", idFont, m_iCountRawFonts);
 }
 
@@ -777,6 +785,10 @@ float RenderEngine::textRawWidthScaled(u32 fontId, float fScale, const char* szT
    if ( NULL == pFont )
       return 0.0;
 
+   type_text_run* pRun = _getRawTextRun(pFont, szText);
+   if ( NULL != pRun )
+      return pRun->fWidth * fScale;
+
    float fWidth = 0.0;
    char* p = (char*)szText;
 
@@ -789,6 +801,86 @@ float RenderEngine::textRawWidthScaled(u32 fontId, float fScale, const char* szT
    return fWidth * fScale;
 }
 
+void RenderEngine::_invalidateTextRuns()
+{
+   if ( NULL == m_pTextRuns )
+      return;
+   for( int i=0; i<TEXT_RUNS_CACHE_SIZE; i++ )
+      m_pTextRuns[i].pFont = NULL;
+}
+
+static u32 _text_run_hash(RenderEngineRawFont* pFont, float fScale, const char* szText, int* piLength)
+{
+   // FNV-1a
+   u32 uHash = 2166136261U ^ (u32)(uintptr_t)pFont;
+   u32 uScale = 0;
+   memcpy(&uScale, &fScale, sizeof(u32));
+   uHash = (uHash ^ uScale) * 16777619U;
+   const char* p = szText;
+   while ( *p )
+   {
+      uHash = (uHash ^ (u8)(*p)) * 16777619U;
+      p++;
+   }
+   *piLength = (int)(p - szText);
+   return uHash;
+}
+
+type_text_run* RenderEngine::_findTextRun(RenderEngineRawFont* pFont, float fScale, const char* szText)
+{
+   if ( (NULL == m_pTextRuns) || (NULL == pFont) || (NULL == szText) )
+      return NULL;
+   int iLength = 0;
+   u32 uHash = _text_run_hash(pFont, fScale, szText, &iLength);
+   if ( iLength >= TEXT_RUN_MAX_LENGTH )
+      return NULL;
+   type_text_run* pRun = &m_pTextRuns[uHash & (TEXT_RUNS_CACHE_SIZE-1)];
+   if ( (pRun->pFont != pFont) || (pRun->uHash != uHash) || (pRun->fScale != fScale) )
+      return NULL;
+   if ( 0 != strcmp(pRun->szText, szText) )
+      return NULL;
+   return pRun;
+}
+
+type_text_run* RenderEngine::_addTextRun(RenderEngineRawFont* pFont, float fScale, const char* szText)
+{
+   if ( (NULL == m_pTextRuns) || (NULL == pFont) || (NULL == szText) )
+      return NULL;
+   int iLength = 0;
+   u32 uHash = _text_run_hash(pFont, fScale, szText, &iLength);
+   if ( iLength >= TEXT_RUN_MAX_LENGTH )
+      return NULL;
+   type_text_run* pRun = &m_pTextRuns[uHash & (TEXT_RUNS_CACHE_SIZE-1)];
+   pRun->pFont = pFont;
+   pRun->fScale = fScale;
+   pRun->uHash = uHash;
+   memcpy(pRun->szText, szText, iLength+1);
+   pRun->fWidth = 0.0;
+   pRun->bHasGlyphsAdvances = false;
+   return pRun;
+}
+
+type_text_run* RenderEngine::_getRawTextRun(RenderEngineRawFont* pFont, const char* szText)
+{
+   type_text_run* pRun = _findTextRun(pFont, 1.0, szText);
+   if ( (NULL != pRun) && pRun->bHasGlyphsAdvances )
+      return pRun;
+   if ( NULL == pRun )
+      pRun = _addTextRun(pFont, 1.0, szText);
+   if ( NULL == pRun )
+      return NULL;
+
+   float fWidth = 0.0;
+   for( int i=0; szText[i] != 0; i++ )
+   {
+      pRun->fGlyphsAdvances[i] = _get_raw_char_width(pFont, szText[i]);
+      fWidth += pRun->fGlyphsAdvances[i];
+   }
+   pRun->fWidth = fWidth;
+   pRun->bHasGlyphsAdvances = true;
+   return pRun;
+}
+
 void RenderEngine::_drawSimpleTextBoundingBox(RenderEngineRawFont* pFont, const char* szText, float xPos, float yPos, float fScale)
 {
    u32 uFontId = _getRawFontId(pFont);
@@ -8,6 +8,10 @@
 #define MAX_RAW_IMAGES 100
 #define MAX_RAW_ICONS 100
 
+// Cache of measured text runs (strings drawn or measured over and over by the OSD and menus)
+#define TEXT_RUNS_CACHE_SIZE 512 // power of 2
+#define TEXT_RUN_MAX_LENGTH 48
+
 
 typedef struct
 {
@@ -42,6 +46,17 @@ typedef struct
 
 } RenderEngineRawFont;
 
+typedef struct
+{
+   RenderEngineRawFont* pFont;
+   float fScale;
+   u32 uHash;
+   char szText[TEXT_RUN_MAX_LENGTH];
+   float fWidth; // scaled
+   bool bHasGlyphsAdvances;
+   float fGlyphsAdvances[TEXT_RUN_MAX_LENGTH]; // unscaled, one for each char
+} type_text_run;
+
 
 class RenderEngine
 {
@@ -155,6 +170,14 @@ class RenderEngine
       virtual void _drawSimpleText(RenderEngineRawFont* pFont, const char* szText, float xPos, float yPos);
       virtual void _drawSimpleTextScaled(RenderEngineRawFont* pFont, const char* szText, float xPos, float yPos, float fScale);
 
+      // Returns the cached run or NULL
+      type_text_run* _findTextRun(RenderEngineRawFont* pFont, float fScale, const char* szText);
+      // Returns a cache slot for the run (replacing an older run), or NULL if the text is too long to be cached
+      type_text_run* _addTextRun(RenderEngineRawFont* pFont, float fScale, const char* szText);
+      // Width and chars advances of a raw font text, unscaled. NULL if the text is too long to be cached
+      type_text_run* _getRawTextRun(RenderEngineRawFont* pFont, const char* szText);
+      void _invalidateTextRuns();
+
       bool m_bStartedFrame;
       int m_iRenderDepth;
       int m_iRenderWidth;
@@ -187,6 +210,8 @@ class RenderEngine
       u32 m_RawFontIds[MAX_RAW_FONTS];
       u32 m_CurrentRawFontId;
       int m_iCountRawFonts;
+
+      type_text_run* m_pTextRuns;
 };
 
 
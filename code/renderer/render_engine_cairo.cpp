@@ -1599,6 +1599,11 @@ float RenderEngineCairo::textRawWidthScaled(u32 fontId, float fScale, const char
    if ( (NULL == pFont) || (NULL == szText) || (0 == szText[0]) )
       return 0.0;
 
+   // Measuring with cairo is expensive and the same strings are measured each frame
+   type_text_run* pRun = _findTextRun(pFont, fScale, szText);
+   if ( NULL != pRun )
+      return pRun->fWidth;
+
    cairo_t* pCairoCtx = _getActiveCairoContext();
    if ( NULL == pCairoCtx )
        pCairoCtx = _createTempDrawContext();
@@ -1667,6 +1672,9 @@ float RenderEngineCairo::textRawWidthScaled(u32 fontId, float fScale, const char
    if ( fWidthPixelsGlyphs <= 1.0 )
       return 0.0;
 
+   pRun = _addTextRun(pFont, fScale, szText);
+   if ( NULL != pRun )
+      pRun->fWidth = fWidthPixelsGlyphs * m_fPixelWidth * fScale;
    return fWidthPixelsGlyphs * m_fPixelWidth * fScale;
    
    /*
@@ -53,6 +53,14 @@ RenderEngineRaw::RenderEngineRaw()
    m_CurrentImageId = 1;
    m_CurrentIconId = 1;
 
+   m_DirtyRectsCurrentFrame.iCount = 0;
+   m_DirtyRectsPrevFrame.iCount = 0;
+   m_DirtyRectsResources[0].iCount = 0;
+   m_DirtyRectsResources[1].iCount = 0;
+   m_iCurrentBackResource = 0;
+   m_bForceFullClear = true;
+   m_uLastClearBufferByte = m_uClearBufferByte;
+
    log_line("RendererRAW: Render init done.");
 }
 
@@ -369,16 +377,198 @@ void RenderEngineRaw::_buildMipImage(struct _fbg_img* pSrc, struct _fbg_img* pDe
 
 }
 
+static void _dirty_rects_union(type_render_dirty_rect* pDest, const type_render_dirty_rect* pRect)
+{
+   if ( pRect->x1 < pDest->x1 ) pDest->x1 = pRect->x1;
+   if ( pRect->y1 < pDest->y1 ) pDest->y1 = pRect->y1;
+   if ( pRect->x2 > pDest->x2 ) pDest->x2 = pRect->x2;
+   if ( pRect->y2 > pDest->y2 ) pDest->y2 = pRect->y2;
+}
+
+static void _dirty_rects_remove(type_render_dirty_rects* pList, int iIndex)
+{
+   pList->iCount--;
+   pList->rects[iIndex] = pList->rects[pList->iCount];
+}
+
+static void _dirty_rects_add(type_render_dirty_rects* pList, const type_render_dirty_rect* pRect)
+{
+   type_render_dirty_rect rect = *pRect;
+
+   // Merge with the rects it overlaps or touches; the merged rect can then reach other rects
+   bool bMerged = true;
+   while ( bMerged )
+   {
+      bMerged = false;
+      for( int i=0; i<pList->iCount; i++ )
+      {
+         type_render_dirty_rect* pOther = &pList->rects[i];
+         if ( (rect.x1 > pOther->x2) || (pOther->x1 > rect.x2) || (rect.y1 > pOther->y2) || (pOther->y1 > rect.y2) )
+            continue;
+         _dirty_rects_union(&rect, pOther);
+         _dirty_rects_remove(pList, i);
+         bMerged = true;
+         break;
+      }
+   }
+
+   if ( pList->iCount < RENDER_RAW_MAX_DIRTY_RECTS )
+   {
+      pList->rects[pList->iCount] = rect;
+      pList->iCount++;
+      return;
+   }
+
+   // List full: merge it with the rect that grows the least
+   int iBest = 0;
+   long lBestGrowth = -1;
+   for( int i=0; i<pList->iCount; i++ )
+   {
+      type_render_dirty_rect merged = pList->rects[i];
+      _dirty_rects_union(&merged, &rect);
+      long lGrowth = (long)(merged.x2 - merged.x1) * (long)(merged.y2 - merged.y1) -
+                     (long)(pList->rects[i].x2 - pList->rects[i].x1) * (long)(pList->rects[i].y2 - pList->rects[i].y1);
+      if ( (lBestGrowth < 0) || (lGrowth < lBestGrowth) )
+      {
+         lBestGrowth = lGrowth;
+         iBest = i;
+      }
+   }
+   _dirty_rects_union(&rect, &pList->rects[iBest]);
+   _dirty_rects_remove(pList, iBest);
+   _dirty_rects_add(pList, &rect);
+}
+
+void RenderEngineRaw::_addDirtyRectPixels(int x1, int y1, int x2, int y2)
+{
+   if ( x1 < 0 )
+      x1 = 0;
+   if ( y1 < 0 )
+      y1 = 0;
+   if ( x2 > m_iRenderWidth )
+      x2 = m_iRenderWidth;
+   if ( y2 > m_iRenderHeight )
+      y2 = m_iRenderHeight;
+   if ( (x2 <= x1) || (y2 <= y1) )
+      return;
+
+   type_render_dirty_rect rect;
+   rect.x1 = x1; rect.y1 = y1;
+   rect.x2 = x2; rect.y2 = y2;
+   _dirty_rects_add(&m_DirtyRectsCurrentFrame, &rect);
+}
+
+void RenderEngineRaw::_addDirtyRect(float xPos, float yPos, float fWidth, float fHeight)
+{
+   if ( fWidth < 0 )
+   {
+      xPos += fWidth;
+      fWidth = -fWidth;
+   }
+   if ( fHeight < 0 )
+   {
+      yPos += fHeight;
+      fHeight = -fHeight;
+   }
+   // Thick strokes and outlines go a few pixels outside of the shape
+   int iMargin = 2 + (int)m_fStrokeSizePx;
+   int x1 = xPos*m_iRenderWidth;
+   int y1 = yPos*m_iRenderHeight;
+   int x2 = (xPos+fWidth)*m_iRenderWidth;
+   int y2 = (yPos+fHeight)*m_iRenderHeight;
+   _addDirtyRectPixels(x1 - iMargin, y1 - iMargin, x2 + iMargin + 1, y2 + iMargin + 1);
+}
+
+void RenderEngineRaw::_addDirtyPoints(float x1, float y1, float x2, float y2, float x3, float y3)
+{
+   float xMin = x1, xMax = x1, yMin = y1, yMax = y1;
+   if ( x2 < xMin ) xMin = x2;
+   if ( x3 < xMin ) xMin = x3;
+   if ( x2 > xMax ) xMax = x2;
+   if ( x3 > xMax ) xMax = x3;
+   if ( y2 < yMin ) yMin = y2;
+   if ( y3 < yMin ) yMin = y3;
+   if ( y2 > yMax ) yMax = y2;
+   if ( y3 > yMax ) yMax = y3;
+   _addDirtyRect(xMin, yMin, xMax - xMin, yMax - yMin);
+}
+
 void RenderEngineRaw::startFrame()
 {
    RenderEngine::startFrame();
-   fbg_clear(m_pFBG, m_uClearBufferByte);
+
+   if ( m_bForceFullClear || (m_uLastClearBufferByte != m_uClearBufferByte) )
+   {
+      fbg_clear(m_pFBG, m_uClearBufferByte);
+      // Both dispmanx resources have stale background everywhere
+      m_DirtyRectsResources[0].rects[0].x1 = m_DirtyRectsResources[0].rects[0].y1 = 0;
+      m_DirtyRectsResources[0].rects[0].x2 = m_iRenderWidth;
+      m_DirtyRectsResources[0].rects[0].y2 = m_iRenderHeight;
+      m_DirtyRectsResources[0].iCount = 1;
+      m_DirtyRectsResources[1] = m_DirtyRectsResources[0];
+      m_bForceFullClear = false;
+      m_uLastClearBufferByte = m_uClearBufferByte;
+   }
+   else
+   {
+      // The rest of the back buffer is still clear from the previous frames
+      for( int i=0; i<m_DirtyRectsPrevFrame.iCount; i++ )
+      {
+         type_render_dirty_rect* pRect = &m_DirtyRectsPrevFrame.rects[i];
+         fbg_clearRect(m_pFBG, pRect->x1, pRect->y1, pRect->x2 - pRect->x1, pRect->y2 - pRect->y1, m_uClearBufferByte);
+      }
+   }
+   m_DirtyRectsCurrentFrame.iCount = 0;
 }
 
 void RenderEngineRaw::endFrame()
 {
+   // Rows to upload: what this frame drew, plus what the back resource still shows from two frames ago.
+   // dispmanx transfers full rows, so the rects are reduced to rows bands, sorted, and the overlapping or touching bands joined.
+   type_render_dirty_rects* pResourceRects = &m_DirtyRectsResources[m_iCurrentBackResource];
+   int iRowsStart[2*RENDER_RAW_MAX_DIRTY_RECTS];
+   int iRowsEnd[2*RENDER_RAW_MAX_DIRTY_RECTS];
+   int iCountBands = 0;
+   for( int k=0; k<2; k++ )
+   {
+      type_render_dirty_rects* pList = (0 == k)?&m_DirtyRectsCurrentFrame:pResourceRects;
+      for( int i=0; i<pList->iCount; i++ )
+      {
+         int iPos = iCountBands;
+         while ( (iPos > 0) && (iRowsStart[iPos-1] > pList->rects[i].y1) )
+         {
+            iRowsStart[iPos] = iRowsStart[iPos-1];
+            iRowsEnd[iPos] = iRowsEnd[iPos-1];
+            iPos--;
+         }
+         iRowsStart[iPos] = pList->rects[i].y1;
+         iRowsEnd[iPos] = pList->rects[i].y2;
+         iCountBands++;
+      }
+   }
+
+   fbg_dispmanxSetDrawRows(m_pFBG, 0, 0);
+   int iBand = 0;
+   while ( iBand < iCountBands )
+   {
+      int iStart = iRowsStart[iBand];
+      int iEnd = iRowsEnd[iBand];
+      iBand++;
+      while ( (iBand < iCountBands) && (iRowsStart[iBand] <= iEnd) )
+      {
+         if ( iRowsEnd[iBand] > iEnd )
+            iEnd = iRowsEnd[iBand];
+         iBand++;
+      }
+      fbg_dispmanxAddDrawRows(m_pFBG, iStart, iEnd);
+   }
+
    fbg_draw(m_pFBG);
    fbg_flip(m_pFBG);
+
+   *pResourceRects = m_DirtyRectsCurrentFrame;
+   m_DirtyRectsPrevFrame = m_DirtyRectsCurrentFrame;
+   m_iCurrentBackResource = 1 - m_iCurrentBackResource;
    RenderEngine::endFrame();
 }
 
@@ -395,10 +585,16 @@ void RenderEngineRaw::rotate180()
        memcpy(scr_pointer1, scr_pointer2, 4);
        memcpy(scr_pointer2, pixel, 4);
    }
+
+   type_render_dirty_rects rects = m_DirtyRectsCurrentFrame;
+   for( int i=0; i<rects.iCount; i++ )
+      _addDirtyRectPixels(m_iRenderWidth - rects.rects[i].x2, m_iRenderHeight - rects.rects[i].y2,
+         m_iRenderWidth - rects.rects[i].x1, m_iRenderHeight - rects.rects[i].y1);
 }
 
 void RenderEngineRaw::drawImage(float xPos, float yPos, float fWidth, float fHeight, u32 imageId)
 {
+   _addDirtyRect(xPos, yPos, fWidth, fHeight);
    if ( imageId < 1 )
       return;
 
@@ -429,6 +625,7 @@ void RenderEngineRaw::drawImage(float xPos, float yPos, float fWidth, float fHei
 
 void RenderEngineRaw::drawImageAlpha(float xPos, float yPos, float fWidth, float fHeight, u32 imageId, u8 uAlpha)
 {
+   _addDirtyRect(xPos, yPos, fWidth, fHeight);
    if ( imageId < 1 )
       return;
 
@@ -459,6 +656,7 @@ void RenderEngineRaw::drawImageAlpha(float xPos, float yPos, float fWidth, float
 
 void RenderEngineRaw::bltImage(float xPosDest, float yPosDest, float fWidthDest, float fHeightDest, int iSrcX, int iSrcY, int iSrcWidth, int iSrcHeight, u32 uImageId)
 {
+   _addDirtyRect(xPosDest, yPosDest, fWidthDest, fHeightDest);
    if ( uImageId < 1 )
       return;
 
@@ -524,12 +722,14 @@ void RenderEngineRaw::bltSprite(float xPosDest, float yPosDest, int iSrcX, int i
    m_pFBG->mix_color.g = 255;
    m_pFBG->mix_color.b = 255;
    m_pFBG->mix_color.a = 255;
+   _addDirtyRectPixels(xDest, yDest, xDest+wDest, yDest+hDest);
    fbg_imageDraw(m_pFBG, m_pImages[indexImage], xDest,yDest,wDest,hDest, iSrcX, iSrcY, iSrcWidth, iSrcHeight);
 }
 
      
 void RenderEngineRaw::drawIcon(float xPos, float yPos, float fWidth, float fHeight, u32 iconId)
 {
+   _addDirtyRect(xPos, yPos, fWidth, fHeight);
    if ( iconId < 1 )
       return;
 
@@ -606,10 +806,16 @@ void RenderEngineRaw::_drawSimpleText(RenderEngineRawFont* pFont, const char* sz
       }
    }
 
+   // Chars advances of the text are cached, as the same strings are drawn each frame
+   type_text_run* pRun = _getRawTextRun(pFont, szText);
+   const char* szStart = szText;
+
    float xTmp = xPos;
+   int iDirtyX1 = -1, iDirtyX2 = 0;
+   int iDirtyHeight = pFont->lineHeight;
    while ( *szText )
    {
-      float fWidthCh = _get_raw_char_width(pFont, *szText);
+      float fWidthCh = (NULL != pRun)?pRun->fGlyphsAdvances[szText-szStart]:_get_raw_char_width(pFont, *szText);
       if ( (fWidthCh < 0.0001) || ( (*szText) < pFont->charIdFirst || (*szText) > pFont->charIdLast ) )
       {
          szText++;
@@ -631,12 +837,26 @@ void RenderEngineRaw::_drawSimpleText(RenderEngineRawFont* pFont, const char* sz
       //unsigned char *img_pointer = (unsigned char *)(pFont->pImage->data + (yImg * pFont->pImage->width * m_pFBG->components + xImg * m_pFBG->components));
 
       if ( (*szText) != ' ' )
-         fbg_imageClipAColor(m_pFBG, (struct _fbg_img*) pFont->pImageObject, xTmp*m_iRenderWidth, yPos*m_iRenderHeight, xImg, yImg, wImg, hImg);
+      {
+         int xDest = xTmp*m_iRenderWidth;
+         fbg_imageClipAColor(m_pFBG, (struct _fbg_img*) pFont->pImageObject, xDest, yPos*m_iRenderHeight, xImg, yImg, wImg, hImg);
+         if ( iDirtyX1 < 0 )
+            iDirtyX1 = xDest;
+         if ( xDest + wImg > iDirtyX2 )
+            iDirtyX2 = xDest + wImg;
+         if ( hImg > iDirtyHeight )
+            iDirtyHeight = hImg;
+      }
 
       xTmp += fWidthCh;
       szText++;
    }
 
+   if ( iDirtyX1 >= 0 )
+   {
+      int yDest = yPos*m_iRenderHeight;
+      _addDirtyRectPixels(iDirtyX1 - 2, yDest - 2, iDirtyX2 + 2, yDest + iDirtyHeight + 2);
+   }
    m_pFBG->disableFontOutline = tmp;
 }
 
@@ -656,9 +876,14 @@ void RenderEngineRaw::_drawSimpleTextScaled(RenderEngineRawFont* pFont, const ch
    m_pFBG->mix_color.b = m_uTextFontMixColor[2];
    m_pFBG->mix_color.a = m_uTextFontMixColor[3];
 
+   type_text_run* pRun = _getRawTextRun(pFont, szText);
+   const char* szStart = szText;
+
+   int iDirtyX1 = -1, iDirtyX2 = 0;
+   int iDirtyHeight = pFont->lineHeight * fScale;
    while ( *szText )
    {
-      float fWidthCh = _get_raw_char_width(pFont, *szText);
+      float fWidthCh = (NULL != pRun)?pRun->fGlyphsAdvances[szText-szStart]:_get_raw_char_width(pFont, *szText);
       if ( (fWidthCh < 0.0001) || ( (*szText) < pFont->charIdFirst || (*szText) > pFont->charIdLast ) )
       {
          szText++;
@@ -683,14 +908,29 @@ void RenderEngineRaw::_drawSimpleTextScaled(RenderEngineRawFont* pFont, const ch
          fbg_imageDrawAlpha(m_pFBG, (struct _fbg_img*) pFont->pImageObject, xPos * m_iRenderWidth, yPos * m_iRenderHeight, wImg*fScale, hImg*fScale, xImg, yImg, wImg, hImg);
       else
          fbg_imageDrawAlphaMask(m_pFBG, (struct _fbg_img*) pFont->pImageObject, xPos * m_iRenderWidth, yPos * m_iRenderHeight, wImg*fScale, hImg*fScale, xImg, yImg, wImg, hImg);
+
+      int xDest = xPos * m_iRenderWidth;
+      if ( iDirtyX1 < 0 )
+         iDirtyX1 = xDest;
+      if ( xDest + (int)(wImg*fScale) > iDirtyX2 )
+         iDirtyX2 = xDest + (int)(wImg*fScale);
+      if ( (int)(hImg*fScale) > iDirtyHeight )
+         iDirtyHeight = hImg*fScale;
       xPos += fWidthCh;
       szText++;
    }
+
+   if ( iDirtyX1 >= 0 )
+   {
+      int yDest = yPos*m_iRenderHeight;
+      _addDirtyRectPixels(iDirtyX1 - 2, yDest - 2, iDirtyX2 + 2, yDest + iDirtyHeight + 2);
+   }
 }
 
 
 void RenderEngineRaw::drawLine(float x1, float y1, float x2, float y2)
 {
+   _addDirtyPoints(x1, y1, x2, y2, x2, y2);
    fbg_enable_alpha(m_pFBG, m_bEnableAlphaBlending?1:0);
    // Clip horizontal or vertical lines
    if ( fabs(x2-x1) < 0.0001 )
@@ -851,6 +1091,7 @@ void RenderEngineRaw::drawLine(float x1, float y1, float x2, float y2)
 
 void RenderEngineRaw::drawRect(float xPos, float yPos, float fWidth, float fHeight)
 {
+   _addDirtyRect(xPos, yPos, fWidth, fHeight);
    int x = xPos*m_iRenderWidth;
    int y = yPos*m_iRenderHeight;
    int w = fWidth*m_iRenderWidth;
@@ -915,6 +1156,7 @@ void RenderEngineRaw::drawRect(float xPos, float yPos, float fWidth, float fHeig
 
 void RenderEngineRaw::drawRoundRect(float xPos, float yPos, float fWidth, float fHeight, float fCornerRadius)
 {
+   _addDirtyRect(xPos, yPos, fWidth, fHeight);
    int x = xPos*m_iRenderWidth;
    int y = yPos*m_iRenderHeight;
    int w = fWidth*m_iRenderWidth;
@@ -1003,6 +1245,7 @@ void RenderEngineRaw::drawTriangle(float x1, float y1, float x2, float y2, float
 
 void RenderEngineRaw::fillTriangle(float x1, float y1, float x2, float y2, float x3, float y3)
 {
+   _addDirtyPoints(x1, y1, x2, y2, x3, y3);
    fbg_enable_alpha(m_pFBG, m_bEnableAlphaBlending?1:0);
    int ix1 = x1 * m_iRenderWidth;
    int ix2 = x2 * m_iRenderWidth;
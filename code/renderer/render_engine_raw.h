@@ -2,6 +2,21 @@
 
 #include "render_engine.h"
 
+#define RENDER_RAW_MAX_DIRTY_RECTS 16
+
+// Pixels rectangle [x1,x2) x [y1,y2); empty when x2 <= x1
+typedef struct
+{
+   int x1, y1, x2, y2;
+} type_render_dirty_rect;
+
+// Disjoint dirty rectangles: a rectangle added is merged only with the ones it overlaps or touches
+typedef struct
+{
+   type_render_dirty_rect rects[RENDER_RAW_MAX_DIRTY_RECTS];
+   int iCount;
+} type_render_dirty_rects;
+
 class RenderEngineRaw: public RenderEngine
 {
    public:
@@ -49,8 +64,22 @@ class RenderEngineRaw: public RenderEngine
       void _drawSimpleText(RenderEngineRawFont* pFont, const char* szText, float xPos, float yPos);
       void _drawSimpleTextScaled(RenderEngineRawFont* pFont, const char* szText, float xPos, float yPos, float fScale);
 
+      void _addDirtyRectPixels(int x1, int y1, int x2, int y2);
+      void _addDirtyRect(float xPos, float yPos, float fWidth, float fHeight);
+      void _addDirtyPoints(float x1, float y1, float x2, float y2, float x3, float y3);
+
       struct _fbg* m_pFBG;
 
+      // Dirty regions: the back buffer is cleared only where the previous frame drew, and only the
+      // rows touched by the current frame or by the frame previously displayed from the same dispmanx
+      // resource (there are two of them, flipped each frame) are uploaded, each rows band separately.
+      type_render_dirty_rects m_DirtyRectsCurrentFrame;
+      type_render_dirty_rects m_DirtyRectsPrevFrame;
+      type_render_dirty_rects m_DirtyRectsResources[2];
+      int m_iCurrentBackResource;
+      bool m_bForceFullClear;
+      u8 m_uLastClearBufferByte;
+
       struct _fbg_img* m_pImages[MAX_RAW_IMAGES];
       u32 m_ImageIds[MAX_RAW_IMAGES];
       u32 m_CurrentImageId;